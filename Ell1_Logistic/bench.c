@@ -0,0 +1,310 @@
+/** \file   bench.c
+ *  \brief  Latency benchmark of batched scoring.
+ *
+ *  Commandline executable that scores batches of examples against a model
+ *  file (one model from train, or all the models of a regpath file),
+ *  once with compiled models (l1_model_score) and once with
+ *  l1_logreg_classify per model. It checks that both give the same
+ *  scores and reports the latency distribution per batch.
+ */
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+#include "pkgdef.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unistd.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#include "def.h"
+#include "l1_logreg.h"
+#include "util.h"
+
+#define MAX_SIZES       16
+
+
+static void usage(char *package, char *version)
+{
+    static const char *help[] =
+    {
+"\n%s version %s\n",
+"\nUsage: %s_bench [options] model_file feature_file\n",
+"Measure the latency of scoring batches of examples.\n\n",
+"   Arguments:\n",
+"       model_file          - model found by %s_train or %s_regpath\n",
+"       feature_file        - examples to score\n",
+"   Options:\n",
+"       -b <int>            - batch size, can be repeated\n",
+"                             (default 1, 10, 100 and 1000)\n",
+"       -r <int>            - number of batches per size (default 1000)\n",
+"       -d                  - build the feature bitmap of compiled models\n",
+"       -m <mode>           - score: m = margin, s = sign, p = probability\n",
+"                             (default p)\n",
+"       -q                  - quiet mode\n",
+"\n",
+"   For each batch size, the median, 99th percentile and minimum latency\n",
+"   (microseconds per batch) of compiled models and of\n",
+"   %s_classify are reported.\n",
+"\n",
+NULL,
+    };
+
+    const char **p;
+    for (p = help; *p != NULL; p++)
+        fprintf(stderr,*p, package, version);
+    exit(EXIT_SUCCESS);
+}
+
+
+static void parse_command_line_args(int argc, char *argv[], int *nsize,
+                                    int *sizes, int *reps, int *bflag,
+                                    int *mode, int *quiet,
+                                    char **ifile_model, char **ifile_x)
+{
+    int c;
+
+    /* default values */
+    *nsize = 0;
+    *reps  = 1000;
+    *bflag = FALSE;
+    *mode  = SCORE_PROB;
+    *quiet = FALSE;
+
+    while ((c = getopt(argc, argv, "b:r:dm:q")) != -1)
+    {
+        switch (c)
+        {
+        case 'b':
+            if (*nsize < MAX_SIZES) sizes[(*nsize)++] = max(atoi(optarg), 1);
+            break;
+        case 'r': *reps  = max(atoi(optarg), 1); break;
+        case 'd': *bflag = TRUE; break;
+        case 'm':
+            if (optarg[0] == 'm')      *mode = SCORE_MARGIN;
+            else if (optarg[0] == 's') *mode = SCORE_SIGN;
+            else                       *mode = SCORE_PROB;
+            break;
+        case 'q': *quiet = TRUE; break;
+        case '?':
+        default : abort();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 2)
+    {
+        usage(PACKAGE_NAME, VERSION);
+        exit (EXIT_SUCCESS);
+    }
+    *ifile_model = argv[0];
+    *ifile_x     = argv[1];
+
+    if (*nsize == 0)
+    {
+        sizes[0] = 1; sizes[1] = 10; sizes[2] = 100; sizes[3] = 1000;
+        *nsize = 4;
+    }
+}
+
+
+/* wall clock time in seconds */
+static double wall_time(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (double)t.QuadPart/(double)f.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1e-9*t.tv_nsec;
+#endif
+}
+
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+
+/* view of rows r0 <= i < r1 of X, sharing its storage */
+static void row_view(const dmatrix *X, const int r0, const int r1,
+                     dmatrix *V)
+{
+    memset(V, 0, sizeof(dmatrix));
+    V->m  = r1-r0;
+    V->n  = X->n;
+    if (X->nz >= 0)
+    {
+        V->nz  = X->rdx[r1]-X->rdx[r0];
+        V->val = X->val;
+        V->jdx = X->jdx;
+        V->rdx = X->rdx+r0;
+    }
+    else
+    {
+        V->nz  = -1;
+        V->val = X->val+(size_t)r0*X->n;
+    }
+}
+
+
+/* scores of one batch with l1_logreg_classify, one model at a time */
+static void score_reference(dmatrix *V, const int nmodel, double **sol,
+                            const int mode, double *res, double *tmp)
+{
+    int i, k, error_count;
+
+    for (k = 0; k < nmodel; k++)
+    {
+        if (mode == SCORE_MARGIN)
+        {
+            dmat_yAx(V, sol[k]+1, tmp);
+            for (i = 0; i < V->m; i++)
+                tmp[i] += sol[k][0];
+        }
+        else
+            l1_logreg_classify(V, NULL, sol[k], (mode == SCORE_PROB),
+                               tmp, &error_count);
+        for (i = 0; i < V->m; i++)
+            res[(size_t)i*nmodel+k] = tmp[i];
+    }
+}
+
+
+int mainBench(int argc, char *argv[])
+{
+    dmatrix *matX, *mat_model, view;
+    l1_model *model;
+    char    *ifile_model, *ifile_x;
+    double  **sol, *res, *ref, *tmp, *tc, *tr;
+    double  t0, maxdiff;
+    int     sizes[MAX_SIZES];
+    int     nsize, reps, bflag, mode, quiet;
+    int     model_m, model_n, model_nz;
+    int     nmodel, n, s, r, i, k, bs, r0;
+
+    parse_command_line_args(argc, argv, &nsize, sizes, &reps, &bflag,
+                            &mode, &quiet, &ifile_model, &ifile_x);
+
+    read_mm_new_matrix(ifile_x, &matX);
+    n = matX->n;
+
+    get_mm_info(ifile_model, &model_m, &model_n, &model_nz);
+    if (n != model_m-1)
+    {
+        fprintf(stderr, "ERROR: number of features are different\n");
+        fprintf(stderr, "       %d features in examples, but %d in model.\n",
+                        n, model_m-1);
+        exit(1);
+    }
+
+    /* models as solution vectors (reference) and compiled */
+    t0 = wall_time();
+    if (model_n == 1)
+    {
+        nmodel = 1;
+        sol = malloc(sizeof(double *));
+        read_mm_new_vector(ifile_model, &sol[0]);
+        model = l1_model_compile_vec(1, n, sol, bflag);
+    }
+    else
+    {
+        read_mm_new_matrix_transpose(ifile_model, &mat_model);
+        nmodel = mat_model->m;
+        sol = malloc(sizeof(double *)*nmodel);
+        for (k = 0; k < nmodel; k++)
+        {
+            sol[k] = malloc(sizeof(double)*(n+1));
+            dmat_get_row(mat_model, k, sol[k]);
+        }
+        model = l1_model_compile(mat_model, bflag);
+        dmat_free(mat_model);
+    }
+    t0 = wall_time()-t0;
+
+    if (!quiet)
+    {
+        fprintf(stderr,"    [examples]          %d x %d", matX->m, n);
+        if (matX->nz >= 0)
+            fprintf(stderr,", %d non-zeros\n", matX->nz);
+        else
+            fprintf(stderr,", dense\n");
+        fprintf(stderr,"    [models]            %d, %d stored coefficients"
+                " on %d features\n", nmodel, model->nz, model->nfeat);
+        fprintf(stderr,"    [bitmap]            %s\n",
+                (bflag == TRUE) ? "yes" : "no");
+        fprintf(stderr,"    [read and compile]  %10.3g (sec)\n\n", t0);
+    }
+
+    /* check the compiled models on all the examples */
+    res = malloc(sizeof(double)*(size_t)matX->m*nmodel);
+    ref = malloc(sizeof(double)*(size_t)matX->m*nmodel);
+    tmp = malloc(sizeof(double)*matX->m);
+    l1_model_score(model, matX, 0, matX->m, mode, res);
+    row_view(matX, 0, matX->m, &view);
+    score_reference(&view, nmodel, sol, mode, ref, tmp);
+    maxdiff = 0.0;
+    for (i = 0; i < matX->m*nmodel; i++)
+        maxdiff = max(maxdiff, fabs(res[i]-ref[i]));
+    fprintf(stderr,"    [max difference]    %g\n\n", maxdiff);
+
+    /* latency per batch */
+    tc = malloc(sizeof(double)*reps);
+    tr = malloc(sizeof(double)*reps);
+    fprintf(stderr,"    %8s %30s %30s\n", "",
+            "compiled (usec/batch)", "classify (usec/batch)");
+    fprintf(stderr,"    %8s %10s%10s%10s %10s%10s%10s\n", "batch",
+            "median", "p99", "min", "median", "p99", "min");
+    for (s = 0; s < nsize; s++)
+    {
+        bs = min(sizes[s], matX->m);
+        for (r = 0, r0 = 0; r < reps; r++)
+        {
+            if (r0+bs > matX->m) r0 = 0;
+
+            t0 = wall_time();
+            l1_model_score(model, matX, r0, r0+bs, mode, res);
+            tc[r] = 1e6*(wall_time()-t0);
+
+            row_view(matX, r0, r0+bs, &view);
+            t0 = wall_time();
+            score_reference(&view, nmodel, sol, mode, ref, tmp);
+            tr[r] = 1e6*(wall_time()-t0);
+
+            r0 += bs;
+        }
+        qsort(tc, reps, sizeof(double), compare_double);
+        qsort(tr, reps, sizeof(double), compare_double);
+        fprintf(stderr,"    %8d %10.2f%10.2f%10.2f %10.2f%10.2f%10.2f\n", bs,
+                tc[reps/2], tc[(int)(0.99*(reps-1))], tc[0],
+                tr[reps/2], tr[(int)(0.99*(reps-1))], tr[0]);
+    }
+    fprintf(stderr,"\n");
+
+    for (k = 0; k < nmodel; k++)
+        free(sol[k]);
+    free(sol);
+    free(res);
+    free(ref);
+    free(tmp);
+    free(tc);
+    free(tr);
+    l1_model_free(model);
+    dmat_free(matX);
+
+    return EXIT_SUCCESS;
+}
@@ -22,6 +22,7 @@
 #include "util.h"
 
 #define BUFFER_SIZE     1024
+#define PATH_ROWS       1024    /* rows scored at a time in path mode */
 
 static const char comment1[] = {
     "%% \n"
@@ -57,35 +58,93 @@ static void summary_prob(const dmatrix *M, const int tflag)
 }
 
 
+static void summary_count(const int m, const int positive_count,
+        const int error_count)
+{
+    fprintf(stderr,"\n");
+    fprintf(stderr,"Classification result:\n");
+
+    if (error_count >= 0)
+    {
+        fprintf(stderr,"    [right predic. count]   %d\n", positive_count);
+        fprintf(stderr,"    [wrong predic. count]   %d\n", m-positive_count);
+        fprintf(stderr,"    [test error]            %d / %d = %g\n\n",
+                error_count, m, (double)error_count/m);
+    }
+    else
+    {
+        fprintf(stderr,"    [positive class count]  %d\n", positive_count);
+        fprintf(stderr,"    [negative class count]  %d\n", m-positive_count);
+        fprintf(stderr,"\n");
+    }
+}
+
+
 static void summary_result(const dmatrix *M, const double *res, 
         const int error_count)
 {
     int i;
     int positive_count = 0;
 
-    fprintf(stderr,"\n");
-    fprintf(stderr,"Classification result:\n");
-
     for (i = 0; i < M->m; i++)
     {
         /* use 0.5 since res[i] can be either binary outcome [+1,-1]
            or probability in (0,1) */
         if (res[i] > 0.5) positive_count++;
     }
+    summary_count(M->m, positive_count, error_count);
+}
 
-    if (error_count >= 0)
+
+/*
+ *  Classifies the data with all the models of a regularization path
+ *  (rows of mat_model) at once, using compiled models, and stores the
+ *  number of errors of each model in error_vec (-1 if b is not given).
+ */
+static void classify_path(const dmatrix *matX, const double *b,
+                          const dmatrix *mat_model, const double *lambda_vec,
+                          const int qflag, double *error_vec)
+{
+    int i, k, r0, r1, nmodel;
+    int *positive_count;
+    double *res, r;
+    l1_model *model;
+
+    nmodel = mat_model->m;
+    model  = l1_model_compile(mat_model, TRUE);
+    res    = malloc(sizeof(double)*PATH_ROWS*nmodel);
+    positive_count = calloc(nmodel, sizeof(int));
+
+    for (r0 = 0; r0 < matX->m; r0 = r1)
     {
-        fprintf(stderr,"    [right predic. count]   %d\n", positive_count);
-        fprintf(stderr,"    [wrong predic. count]   %d\n", M->m-positive_count);
-        fprintf(stderr,"    [test error]            %d / %d = %g\n\n",
-                error_count, M->m, (double)error_count/M->m);
+        r1 = min(r0+PATH_ROWS, matX->m);
+        l1_model_score(model, matX, r0, r1, SCORE_MARGIN, res);
+
+        /* right predictions if b is given, positive class otherwise
+           (a zero margin is in the positive class, as in score.c) */
+        for (i = r0; i < r1; i++)
+        for (k = 0; k < nmodel; k++)
+        {
+            r = res[(i-r0)*nmodel+k];
+            if (b != NULL)
+                positive_count[k] += (r > 0 && b[i] > 0) || (r < 0 && b[i] < 0);
+            else
+                positive_count[k] += (r >= 0);
+        }
     }
-    else
+
+    for (k = 0; k < nmodel; k++)
     {
-        fprintf(stderr,"    [positive class count]  %d\n", positive_count);
-        fprintf(stderr,"    [negative class count]  %d\n", M->m-positive_count);
-        fprintf(stderr,"\n");
+        error_vec[k] = (b != NULL) ? matX->m-positive_count[k] : -1;
+        if (!qflag)
+        {
+            fprintf(stderr,"    lambda = %e\n",lambda_vec[k]);
+            summary_count(matX->m, positive_count[k], (int)error_vec[k]);
+        }
     }
+    l1_model_free(model);
+    free(positive_count);
+    free(res);
 }
 
 
@@ -232,6 +291,7 @@ static void convert_Rdata(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         X->jdx = NULL;
         X->rdx = NULL;
     }
+    dmat_init_aux(X);
     *matX = X;
     if (*tflag == TRUE)
         *b = REAL(pb);
@@ -342,7 +402,6 @@ SEXP classifyR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
     }
     else    /* model for multiple lambdas */
     {
-        int i;
         double *lambda_vec, *error_vec;
         dmatrix *mat_model;
 
@@ -355,22 +414,9 @@ SEXP classifyR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         read_mm_new_matrix_transpose(ifile_model, &mat_model);
         /* each row is intercept+coefficients */
 
-        res = malloc(sizeof(double)*(matX->m));
         error_vec = malloc(sizeof(double)*mat_model->m);
+        classify_path(matX, b, mat_model, lambda_vec, qflag, error_vec);
 
-        solution = malloc(sizeof(double)*mat_model->n);
-        for (i = 0; i < mat_model->m; i++)
-        {
-            if (!qflag) fprintf(stderr,"    lambda = %e\n",lambda_vec[i]);
-
-            dmat_get_row(mat_model, i, solution);
-
-            ret = l1_logreg_classify(matX, b, solution, pflag,
-                                     res, &error_count);
-            if (!qflag) summary_result(matX, res, error_count);
-            error_vec[i] = error_count;
-
-        }
         /* write solution */
         clock_wri = clock();
         if (ofile != NULL)
@@ -384,8 +430,6 @@ SEXP classifyR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         dmat_free(matX);
         dmat_free(mat_model);
         free(b);
-        free(res);
-        free(solution);
         free(error_vec);
         free(lambda_vec);
         return EXIT_SUCCESS;
@@ -431,6 +475,7 @@ SEXP classifyR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         mat_model->idx  = malloc(sizeof(int)*mat_model->nz);
         mat_model->jdx  = malloc(sizeof(int)*mat_model->nz);
         mat_model->rdx  = malloc(sizeof(int)*(mat_model->m+1));
+        dmat_init_aux(mat_model);
         lambda_vec      = REAL(VECTOR_ELT(psolution,6));
 
         if (mat_model->nz >= 0)
@@ -450,30 +495,16 @@ SEXP classifyR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         }
         /* each row is intercept+coefficients */
 
-        res = malloc(sizeof(double)*(matX->m));
         //error_vec = malloc(sizeof(double)*mat_model->m);
         PROTECT(Rerror_vec = allocVector(REALSXP,mat_model->m));
         error_vec = REAL(Rerror_vec);
 
-        solution = malloc(sizeof(double)*mat_model->n);
-        for (i = 0; i < mat_model->m; i++)
-        {
-            if (!qflag) fprintf(stderr,"    lambda = %e\n",lambda_vec[i]);
-
-            dmat_get_row(mat_model, i, solution);
-
-            ret = l1_logreg_classify(matX, b, solution, pflag, res,
-                                                        &error_count);
-            if (!qflag) summary_result(matX, res, error_count);
-            error_vec[i] = error_count;
+        classify_path(matX, b, mat_model, lambda_vec, qflag, error_vec);
 
-        }
         free(mat_model->idx);
         free(mat_model->jdx);
         free(mat_model->rdx);
         free(mat_model);
-        free(res);
-        free(solution);
         if (matX->nz >= 0) {
             free(matX->idx);
             free(matX->jdx);
@@ -0,0 +1,130 @@
+/** \file   convert.c
+ *  \brief  Converts Matrix Market data to a binary feature file.
+ *
+ *  Commandline executable that reads a feature matrix (and optionally
+ *  a class vector) in Matrix Market format and writes them as one
+ *  binary feature file, which train, classify and regpath map into
+ *  memory instead of parsing.
+ *
+ */
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+#include "pkgdef.h"
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "unistd.h"
+
+#include "def.h"
+#include "util.h"
+
+
+static void usage(char *package, char *version)
+{
+    static const char *help[] =
+    {
+"\n%s version %s\n",
+"\nUsage: %s_convert [options] feature_file [class_file] binary_file\n",
+"Convert Matrix Market data to a binary feature file.\n\n",
+"   Arguments:\n",
+"       feature_file        - feature matrix (\"-\" for standard input)\n",
+"       class_file          - output vector, stored with the matrix\n",
+"       binary_file         - binary feature file (\"-\" for standard output)\n",
+"   Options:\n",
+"       -q                  - quiet mode\n",
+"\n",
+"   A binary feature file can be given wherever a feature_file is\n",
+"   expected. If it contains the class vector, it can also be given as\n",
+"   class_file (or \"-\" when the feature_file is read from standard input).\n",
+"\n",
+NULL,
+    };
+
+    const char **p;
+    for (p = help; *p != NULL; p++)
+        fprintf(stderr,*p, package, version);
+    exit(EXIT_SUCCESS);
+}
+
+
+static void parse_command_line_args(int argc, char *argv[], int *quiet,
+                                    char **ifile_x, char **ifile_y,
+                                    char **ofile)
+{
+    int c;
+
+    /* default values */
+    *quiet = FALSE;
+
+    while ((c = getopt(argc, argv, "q")) != -1)
+    {
+        switch (c)
+        {
+        case 'q': *quiet = TRUE; break;
+        case '?':
+        default : abort();
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    switch (argc)
+    {
+    case 2:
+        *ofile   = argv[1];
+        *ifile_y = NULL;
+        *ifile_x = argv[0];
+        break;
+    case 3:
+        *ofile   = argv[2];
+        *ifile_y = argv[1];
+        *ifile_x = argv[0];
+        break;
+    default:
+        usage(PACKAGE_NAME, VERSION);
+        exit (EXIT_SUCCESS);
+    }
+}
+
+
+int mainConvert(int argc, char *argv[])
+{
+    dmatrix *matX;          /* feature matrix */
+    double  *b;             /* class vector   */
+    char    *ifile_x, *ifile_y, *ofile;
+    int     quiet;
+    clock_t clock_pre, clock_wri, clock_end;
+
+    parse_command_line_args(argc, argv, &quiet, &ifile_x, &ifile_y, &ofile);
+
+    clock_pre = clock();
+    read_mm_new_matrix(ifile_x, &matX);
+    b = NULL;
+    if (ifile_y != NULL) read_mm_new_vector(ifile_y, &b);
+
+    clock_wri = clock();
+    write_bin_matrix(ofile, matX, b);
+    clock_end = clock();
+
+    if (!quiet)
+    {
+        if (matX->nz >= 0)
+            fprintf(stderr,"    [feature matrix]    sparse matrix of "
+                "(%d examples x %d features), %d non-zeros\n",
+                matX->m, matX->n, matX->nz);
+        else
+            fprintf(stderr,"    [feature matrix]    dense matrix of "
+                "(%d examples x %d features)\n", matX->m, matX->n);
+        fprintf(stderr,"    [read data]         %10.3g (sec)\n",
+            (double)(clock_wri-clock_pre)/CLOCKS_PER_SEC);
+        fprintf(stderr,"    [write binary]      %10.3g (sec)\n",
+            (double)(clock_end-clock_wri)/CLOCKS_PER_SEC);
+    }
+    if (b) free(b);
+    dmat_free(matX);
+
+    return EXIT_SUCCESS;
+}
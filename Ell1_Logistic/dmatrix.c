@@ -15,6 +15,14 @@
 #include "def.h"
 #include "dmatrix.h"
 
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+#endif
+
 #ifndef Rpackage
     #include "blas.h"
     #include "lapack.h"
@@ -25,6 +33,9 @@
 
 #define PROFILING   FALSE
 
+/* sparse kernels run serially below this number of non-zeros */
+#define OMP_MIN_NZ  32768
+
 #if PROFILING
 static long int time_yAx        = 0.0;
 static long int time_yATx       = 0.0;
@@ -360,6 +371,65 @@ void dmat_elemdivi(const int n, const double *x, const double *y, double *z)
 /****************************************************************************/
 
 
+/** \brief Returns the first row whose start index reaches a given share.
+ *
+ *  The work of a row is taken as its number of non-zeros plus one,
+ *  so that empty rows are not free.
+ *
+ *  @param  ptr     row (or column) start indices, length len+1.
+ *  @param  len     number of rows (or columns).
+ *  @param  nparts  number of parts.
+ *  @param  part    part index (0 <= part <= nparts).
+ *  @return         first row of the part.
+ */
+static int dmat_split(const int *ptr, const int len,
+                      const int nparts, const int part)
+{
+    int lo, hi, mid;
+    double target;
+
+    if (part >= nparts) return len;
+
+    target = ((double)ptr[len]-ptr[0]+len)*part/nparts + ptr[0];
+    lo = 0;
+    hi = len;
+    while (lo < hi)
+    {
+        mid = (lo+hi)/2;
+        if ((double)ptr[mid]+mid < target) lo = mid+1;
+        else                               hi = mid;
+    }
+    return lo;
+}
+
+
+/** \brief Assigns a block of rows to the calling thread.
+ *
+ *  Rows are split into contiguous blocks of about the same number
+ *  of non-zeros, one block per thread of the current team.
+ *  Outside of a parallel region the whole range is returned.
+ *
+ *  @param  ptr     row (or column) start indices, length len+1.
+ *  @param  len     number of rows (or columns).
+ *  @param  lo      first row of the block.
+ *  @param  hi      one past the last row of the block.
+ */
+static void dmat_partition(const int *ptr, const int len, int *lo, int *hi)
+{
+#ifdef _OPENMP
+    int nt, id;
+
+    nt  = omp_get_num_threads();
+    id  = omp_get_thread_num();
+    *lo = dmat_split(ptr, len, nt, id);
+    *hi = dmat_split(ptr, len, nt, id+1);
+#else
+    *lo = 0;
+    *hi = len;
+#endif
+}
+
+
 /** \brief \f$ y = Ax \f$
  *
  *  Computes matrix-vector product.
@@ -370,11 +440,9 @@ void dmat_elemdivi(const int n, const double *x, const double *y, double *z)
  */
 void dmat_yAx(const dmatrix *A, const double *x, double *y)
 {
-    int k, l;
     int m, n, nz;
     int *jdx, *rdx;
     double *val;
-    double tmp;
 #if PROFILING
     PROFILE_START
 #endif
@@ -388,14 +456,21 @@ void dmat_yAx(const dmatrix *A, const double *x, double *y)
 
     if (nz >= 0)    /* sparse matrix */
     {
-        for (k = 0; k < m ; k++)
+#pragma omp parallel if (nz >= OMP_MIN_NZ)
         {
-            tmp = 0.0;
-            for (l = rdx[k]; l < rdx[k+1]; l++)
+            int k, l, k0, k1;
+            double tmp;
+
+            dmat_partition(rdx, m, &k0, &k1);
+            for (k = k0; k < k1; k++)
             {
-                tmp += val[l]*x[jdx[l]];
+                tmp = 0.0;
+                for (l = rdx[k]; l < rdx[k+1]; l++)
+                {
+                    tmp += val[l]*x[jdx[l]];
+                }
+                y[k] = tmp;
             }
-            y[k] = tmp;
         }
     }
     else            /* dense matrix */
@@ -413,17 +488,19 @@ void dmat_yAx(const dmatrix *A, const double *x, double *y)
  *
  *  Computes transposed matrixr-vector product.
  *
+ *  If the csc copy of A exists, each y_j is gathered from column j
+ *  and the columns are split among threads; otherwise the rows of
+ *  A are scattered into y serially.
+ *
  *  @param  A   pointer to a matrix.
  *  @param  x   pointer to a vector x.
  *  @param  y   pointer to a result vector y.
  */
 void dmat_yATx(const dmatrix *A, const double *x, double *y)
 {
-    int k, l;
     int m, n, nz;
     int *jdx, *rdx;
     double *val;
-    double tmp;
 #if PROFILING
     PROFILE_START
 #endif
@@ -435,9 +512,38 @@ void dmat_yATx(const dmatrix *A, const double *x, double *y)
     jdx = A->jdx;
     rdx = A->rdx;
 
-    dmat_vset(n, 0, y);
-    if (nz >= 0)    /* sparse matrix */
+    if (nz >= 0 && A->cdx != NULL)  /* sparse matrix, csc copy */
     {
+        int *cdx, *tidx;
+        double *tval;
+
+        cdx  = A->cdx;
+        tidx = A->tidx;
+        tval = A->tval;
+
+#pragma omp parallel if (nz >= OMP_MIN_NZ)
+        {
+            int j, l, j0, j1;
+            double tmp;
+
+            dmat_partition(cdx, n, &j0, &j1);
+            for (j = j0; j < j1; j++)
+            {
+                tmp = 0.0;
+                for (l = cdx[j]; l < cdx[j+1]; l++)
+                {
+                    tmp += tval[l]*x[tidx[l]];
+                }
+                y[j] = tmp;
+            }
+        }
+    }
+    else if (nz >= 0)               /* sparse matrix */
+    {
+        int k, l;
+        double tmp;
+
+        dmat_vset(n, 0, y);
         for (k = 0; k < m ; k++)
         {
             tmp = x[k];
@@ -447,7 +553,7 @@ void dmat_yATx(const dmatrix *A, const double *x, double *y)
             }
         }
     }
-    else            /* dense matrix */
+    else                            /* dense matrix */
     {
         F77_CALL(dgemv)("N",&n,&m,&done,val,&n,x,&ione,&dzero,y,&ione);
     }
@@ -469,11 +575,9 @@ void dmat_yATx(const dmatrix *A, const double *x, double *y)
 void dmat_yAmpqx(const dmatrix *A, const double *p, const double *q,
                  const double *x, double *y)
 {
-    int k, l;
     int m, n, nz;
     int *jdx, *rdx;
     double *val;
-    double tmp;
     double qx;
 #if PROFILING
     PROFILE_START
@@ -493,14 +597,21 @@ void dmat_yAmpqx(const dmatrix *A, const double *p, const double *q,
 
     if (nz >= 0)    /* sparse matrix */
     {
-        for (k = 0; k < m ; k++)
+#pragma omp parallel if (nz >= OMP_MIN_NZ)
         {
-            tmp = 0.0;
-            for (l = rdx[k]; l < rdx[k+1]; l++)
+            int k, l, k0, k1;
+            double tmp;
+
+            dmat_partition(rdx, m, &k0, &k1);
+            for (k = k0; k < k1; k++)
             {
-                tmp += val[l]*x[jdx[l]];
+                tmp = 0.0;
+                for (l = rdx[k]; l < rdx[k+1]; l++)
+                {
+                    tmp += val[l]*x[jdx[l]];
+                }
+                y[k] = tmp - p[k]*qx;
             }
-            y[k] = tmp - p[k]*qx;
         }
     }
     else
@@ -529,11 +640,9 @@ void dmat_yAmpqx(const dmatrix *A, const double *p, const double *q,
 void dmat_yAmpqTx(const dmatrix *A, const double *p, const double *q,
                  const double *x, double *y)
 {
-    int k, l;
     int m, n, nz;
     int *jdx, *rdx;
     double *val;
-    double tmp;
     double px;
 #if PROFILING
     PROFILE_START
@@ -551,12 +660,42 @@ void dmat_yAmpqTx(const dmatrix *A, const double *p, const double *q,
         return;
     }
 
-    dmat_vset(n, 0, y);
     px = -F77_CALL(ddot)(&m, p, &ione, x, &ione);
-    F77_CALL(daxpy)(&n, &px, q, &ione, y, &ione);
 
-    if (nz >= 0)    /* sparse matrix */
+    if (nz >= 0 && A->cdx != NULL)  /* sparse matrix, csc copy */
+    {
+        int *cdx, *tidx;
+        double *tval;
+
+        cdx  = A->cdx;
+        tidx = A->tidx;
+        tval = A->tval;
+
+#pragma omp parallel if (nz >= OMP_MIN_NZ)
+        {
+            int j, l, j0, j1;
+            double tmp;
+
+            dmat_partition(cdx, n, &j0, &j1);
+            for (j = j0; j < j1; j++)
+            {
+                tmp = px*q[j];
+                for (l = cdx[j]; l < cdx[j+1]; l++)
+                {
+                    tmp += tval[l]*x[tidx[l]];
+                }
+                y[j] = tmp;
+            }
+        }
+    }
+    else if (nz >= 0)               /* sparse matrix */
     {
+        int k, l;
+        double tmp;
+
+        dmat_vset(n, 0, y);
+        F77_CALL(daxpy)(&n, &px, q, &ione, y, &ione);
+
         for (k = 0; k < m ; k++)
         {
             tmp = x[k];
@@ -578,6 +717,101 @@ void dmat_yAmpqTx(const dmatrix *A, const double *p, const double *q,
 }
 
 
+/** \brief Fused \f$ y = Hx \f$ over the csc copy of A.
+ *
+ *  Computes the same product as dmat_yHx (p and q may be NULL) in two
+ *  passes: a row-parallel pass stores \f$ D_0(bv+\tilde{A}w) \f$ in
+ *  A->work together with the scalar terms, and a column-parallel pass
+ *  gathers \f$ \tilde{A}^T \f$ times it with the diagonal blocks added
+ *  on the fly. Hence there is no scatter and no separate pass over n.
+ *
+ *  @param  A   pointer to a matrix with a csc copy.
+ *  @param  p   pointer to a column vector (or NULL).
+ *  @param  q   pointer to a row vector (or NULL).
+ *  @param  b   pointer to a vector.
+ *  @param  d0  pointer to a vector.
+ *  @param  d1  pointer to a vector.
+ *  @param  d2  pointer to a vector.
+ *  @param  x   pointer to a vector.
+ *  @param  y   pointer to a result vector.
+ */
+static void dmat_yHx_csc(const dmatrix *A, const double *p, const double *q,
+                         const double *b, const double *d0,
+                         const double *d1, const double *d2,
+                         const double *x, double *y)
+{
+    int m, n, nz;
+    int *jdx, *rdx, *cdx, *tidx;
+    double *val, *tval, *s;
+    const double *v, *w, *u;
+    double *vv, *ww, *uu;
+    double qw, sb, sp;
+
+    m    = A->m;
+    n    = A->n;
+    nz   = A->nz;
+    val  = A->val;
+    jdx  = A->jdx;
+    rdx  = A->rdx;
+    tval = A->tval;
+    tidx = A->tidx;
+    cdx  = A->cdx;
+    s    = A->work;
+    v   = &x[0]; w   = &x[1]; u   = &x[n+1];
+    vv  = &y[0]; ww  = &y[1]; uu  = &y[n+1];
+
+    qw = (p != NULL) ? F77_CALL(ddot)(&n, q, &ione, w, &ione) : 0.0;
+    sb = 0.0;   /* b^T*s */
+    sp = 0.0;   /* p^T*s */
+
+    /* s = D0*(b*v + (A-pq)*w) */
+#pragma omp parallel if (nz >= OMP_MIN_NZ) reduction(+:sb,sp)
+    {
+        int k, l, k0, k1;
+        double tmp;
+
+        dmat_partition(rdx, m, &k0, &k1);
+        for (k = k0; k < k1; k++)
+        {
+            tmp = 0.0;
+            for (l = rdx[k]; l < rdx[k+1]; l++)
+            {
+                tmp += val[l]*w[jdx[l]];
+            }
+            if (p != NULL) tmp -= p[k]*qw;
+
+            tmp  = (tmp+b[k]*v[0])*d0[k];
+            s[k] = tmp;
+            sb  += b[k]*tmp;
+            if (p != NULL) sp += p[k]*tmp;
+        }
+    }
+
+    /* ww = (A-pq)^T*s + D1*w + D2*u, uu = D2*w + D1*u */
+#pragma omp parallel if (nz >= OMP_MIN_NZ)
+    {
+        int j, l, j0, j1;
+        double tmp;
+
+        dmat_partition(cdx, n, &j0, &j1);
+        for (j = j0; j < j1; j++)
+        {
+            tmp = 0.0;
+            for (l = cdx[j]; l < cdx[j+1]; l++)
+            {
+                tmp += tval[l]*s[tidx[l]];
+            }
+            if (q != NULL) tmp -= sp*q[j];
+
+            ww[j] = tmp + d1[j]*w[j] + d2[j]*u[j];
+            uu[j] = d2[j]*w[j] + d1[j]*u[j];
+        }
+    }
+    /* vv = b^T*D0*(b*v + (A-pq)*w) */
+    vv[0] = sb;
+}
+
+
 /** \brief \f$ y = A^TDAx \f$
  *
  *  Computes triple-matrix product.
@@ -642,6 +876,11 @@ void dmat_yATDAx(const dmatrix *A, const double *d, const double *x, double *y)
  *
  *  Computes complex matrix-vector product.
  *
+ *  NOTE: With a csc copy the product goes through A->work, so it is not
+ *  reentrant: two threads must not apply the same matrix at once.
+ *  Callers running concurrently have to work on their own copy of A,
+ *  as l1_logreg_train does.
+ *
  *  @param  A   pointer to a matrix.
  *  @param  b   pointer to a vector.
  *  @param  d0  pointer to a vector.
@@ -670,7 +909,11 @@ void dmat_yHx_(const dmatrix *A, const double *b, const double *d0,
     v   = &x[0]; w   = &x[1]; u   = &x[n+1];
     vv  = &y[0]; ww  = &y[1]; uu  = &y[n+1];
 
-    if (nz >= 0)    /* sparse matrix */
+    if (nz >= 0 && A->cdx != NULL)  /* sparse matrix, csc copy */
+    {
+        dmat_yHx_csc(A,NULL,NULL,b,d0,d1,d2,x,y);
+    }
+    else if (nz >= 0)               /* sparse matrix */
     {
         /* tmp0 = b^T*D0*b*v */
         tmp0 = 0.0;
@@ -730,6 +973,8 @@ void dmat_yHx_(const dmatrix *A, const double *b, const double *d0,
  *
  *  Computes complex matrix-vector product.
  *
+ *  NOTE: Not reentrant for a matrix with a csc copy, see dmat_yHx_.
+ *
  *  @param  A   pointer to a matrix.
  *  @param  p   pointer to a column vector.
  *  @param  q   pointer to a row vector.
@@ -771,11 +1016,15 @@ void dmat_yHx(const dmatrix *A, const double *p, const double *q,
     v   = &x[0]; w   = &x[1]; u   = &x[n+1];
     vv  = &y[0]; ww  = &y[1]; uu  = &y[n+1];
 
-    qw = F77_CALL(ddot)(&n, q, &ione, w, &ione);
-
-    if (nz >= 0)    /* sparse matrix */
+    if (nz >= 0 && A->cdx != NULL)  /* sparse matrix, csc copy */
+    {
+        dmat_yHx_csc(A,p,q,b,d0,d1,d2,x,y);
+    }
+    else if (nz >= 0)               /* sparse matrix */
     {
         double mtmp2;
+
+        qw = F77_CALL(ddot)(&n, q, &ione, w, &ione);
         /* tmp0 = b^T*D0*b*v */
         tmp0 = 0.0;
         tmp2 = 0.0;
@@ -857,6 +1106,7 @@ void dmat_elemAA(const dmatrix *A, dmatrix **B)
     memcpy(tmp->idx, A->idx, sizeof(int)*nz);
     memcpy(tmp->jdx, A->jdx, sizeof(int)*nz);
     memcpy(tmp->rdx, A->rdx, sizeof(int)*(m+1));
+    dmat_init_aux(tmp);
     for (i = 0; i < nz; i++)
     {
         tmp->val[i] = val[i]*val[i];
@@ -905,6 +1155,9 @@ void dmat_diagscale(dmatrix *M, const double *dl, const int invl,
     idx = M->idx;
     jdx = M->jdx;
 
+    /* values change, csc copy is out of date */
+    dmat_free_csc(M);
+
     if (nz >= 0)    /* sparse matrix */
     {
         if (dl != NULL && dr != NULL)
@@ -1231,6 +1484,7 @@ void dmat_duplicate(const dmatrix* M, dmatrix** dst)
         mcp->jdx = NULL;
         mcp->rdx = NULL;
     }
+    dmat_init_aux(mcp);
     *dst = mcp;
 }
 
@@ -1251,6 +1505,7 @@ void dmat_copy(const dmatrix* M, dmatrix* dst)
     dst->m  = m;
     dst->n  = n;
     dst->nz = nz;
+    dmat_free_csc(dst);
     if (nz >= 0)
     {
         memcpy(dst->val, M->val, sizeof(double)*nz);
@@ -1268,6 +1523,100 @@ void dmat_copy(const dmatrix* M, dmatrix* dst)
 }
 
 
+/** \brief Extracts a subset of columns of a matrix.
+ *
+ *  Allocates a new matrix made of the columns cols[0..ncol-1] of M
+ *  (in this order) and copies the contents.
+ *
+ *  @param  M       pointer to a source matrix.
+ *  @param  ncol    number of columns to extract.
+ *  @param  cols    indices of the columns to extract.
+ *  @param  dst     pointer to a destination matrix.
+ */
+void dmat_select_cols(const dmatrix *M, const int ncol, const int *cols,
+                      dmatrix **dst)
+{
+    int i, j, k, l, m, n, nz;
+    dmatrix *sub;
+
+    m   = M->m;
+    n   = M->n;
+    nz  = M->nz;
+    sub = malloc(sizeof(dmatrix));
+    sub->m  = m;
+    sub->n  = ncol;
+    dmat_init_aux(sub);
+
+    if (nz >= 0)
+    {
+        int *map;
+
+        /* map[j] = new index of column j, or -1 if not selected */
+        map = malloc(sizeof(int)*n);
+        for (j = 0; j < n; j++)    map[j] = -1;
+        for (j = 0; j < ncol; j++) map[cols[j]] = j;
+
+        k = 0;
+        for (l = 0; l < nz; l++)
+            if (map[M->jdx[l]] >= 0) k++;
+
+        sub->nz  = k;
+        sub->val = malloc(sizeof(double)*k);
+        sub->idx = malloc(sizeof(int)*k);
+        sub->jdx = malloc(sizeof(int)*k);
+        sub->rdx = malloc(sizeof(int)*(m+1));
+
+        k = 0;
+        for (i = 0; i < m; i++)
+        {
+            sub->rdx[i] = k;
+            for (l = M->rdx[i]; l < M->rdx[i+1]; l++)
+            {
+                j = map[M->jdx[l]];
+                if (j < 0) continue;
+
+                sub->val[k] = M->val[l];
+                sub->idx[k] = i;
+                sub->jdx[k] = j;
+                k++;
+            }
+        }
+        sub->rdx[m] = k;
+        free(map);
+    }
+    else
+    {
+        sub->nz  = -1;
+        sub->val = malloc(sizeof(double)*m*ncol);
+        sub->idx = NULL;
+        sub->jdx = NULL;
+        sub->rdx = NULL;
+
+        for (i = 0; i < m; i++)
+            for (j = 0; j < ncol; j++)
+                sub->val[i*ncol+j] = M->val[i*n+cols[j]];
+    }
+    *dst = sub;
+}
+
+
+/** \brief Clear the auxiliary fields of a newly allocated matrix.
+ *
+ *  Sets the transposed copy, the workspace and the mapping to empty,
+ *  so that dmat_free releases only what the caller allocated.
+ *
+ *  @param  M       pointer to a matrix.
+ */
+void dmat_init_aux(dmatrix *M)
+{
+    M->tval   = NULL;
+    M->tidx   = NULL;
+    M->cdx    = NULL;
+    M->work   = NULL;
+    M->map    = NULL;
+    M->maplen = 0;
+}
+
 /** \brief Allocate memory for a dense matrix.
  *
  *  @param  M       pointer to an allocated matrix.
@@ -1285,6 +1634,7 @@ void dmat_new_dense(dmatrix** M, const int m, const int n)
     dmat->idx = NULL;
     dmat->jdx = NULL;
     dmat->rdx = NULL;
+    dmat_init_aux(dmat);
     *M = dmat;
 }
 
@@ -1296,10 +1646,23 @@ void dmat_free(dmatrix* M)
 {
     if (M)
     {
-        if (M->val) free(M->val);
+        if (M->map)
+        {
+            /* val, jdx and rdx live in one block */
+#ifndef _WIN32
+            if (M->maplen > 0) munmap(M->map, M->maplen);
+            else
+#endif
+            free(M->map);
+        }
+        else
+        {
+            if (M->val) free(M->val);
+            if (M->jdx) free(M->jdx);
+            if (M->rdx) free(M->rdx);
+        }
         if (M->idx) free(M->idx);
-        if (M->jdx) free(M->jdx);
-        if (M->rdx) free(M->rdx);
+        dmat_free_csc(M);
         free(M);
     }
 }
@@ -1460,6 +1823,76 @@ void dmat_build_idx(dmatrix *M)
 }
 
 
+/** \brief Build the transposed (csc) copy from csr info.
+ *
+ *  Stores the columns of a sparse matrix in tval, tidx and cdx, and
+ *  allocates the workspace of dmat_yHx. Transposed products use the
+ *  copy from then on. The copy mirrors the current values, so it has
+ *  to be rebuilt once the matrix is modified.
+ *
+ *  @param  M       pointer to a matrix.
+ */
+void dmat_build_csc(dmatrix *M)
+{
+    int j, k, l, m, n, nz;
+    int *jdx, *rdx, *cdx, *pos;
+    double *val;
+
+    if (M->nz < 0) return;  /* skip if dense matrix */
+
+    dmat_free_csc(M);
+
+    m   = M->m;
+    n   = M->n;
+    nz  = M->nz;
+    val = M->val;
+    jdx = M->jdx;
+    rdx = M->rdx;
+
+    cdx     = malloc(sizeof(int)*(n+1));
+    pos     = malloc(sizeof(int)*(n+1));
+    M->tidx = malloc(sizeof(int)*nz);
+    M->tval = malloc(sizeof(double)*nz);
+    M->work = malloc(sizeof(double)*m);
+    M->cdx  = cdx;
+
+    /* count entries of each column */
+    memset(cdx, 0, sizeof(int)*(n+1));
+    for (l = 0; l < nz; l++) cdx[jdx[l]+1]++;
+    for (j = 0; j < n; j++)  cdx[j+1] += cdx[j];
+
+    /* rows are visited in order, so row indices are sorted per column */
+    memcpy(pos, cdx, sizeof(int)*(n+1));
+    for (k = 0; k < m; k++)
+    {
+        for (l = rdx[k]; l < rdx[k+1]; l++)
+        {
+            j = pos[jdx[l]]++;
+            M->tidx[j] = k;
+            M->tval[j] = val[l];
+        }
+    }
+    free(pos);
+}
+
+
+/** \brief Free the transposed (csc) copy of a matrix.
+ *
+ *  @param  M       pointer to a matrix.
+ */
+void dmat_free_csc(dmatrix *M)
+{
+    if (M->tval) free(M->tval);
+    if (M->tidx) free(M->tidx);
+    if (M->cdx ) free(M->cdx );
+    if (M->work) free(M->work);
+    M->tval = NULL;
+    M->tidx = NULL;
+    M->cdx  = NULL;
+    M->work = NULL;
+}
+
+
 /* BLAS LEVEL 2, 3 */
 
 /** \brief \f$ B = AA^T \f$
@@ -4,6 +4,8 @@
  *  \brief  Header file for matrix and vector manipulation functions.
  */
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -20,6 +22,16 @@ extern "C" {
  *  For computational efficiency, it also store the row indices
  *  as well as row start indices.
  *
+ *  A sparse matrix may additionally keep a transposed copy in compressed
+ *  sparse column (CSC) format, built once by dmat_build_csc.
+ *  Transposed products then become row-parallel gathers instead of
+ *  scatters. The copy is dropped whenever the values change
+ *  (dmat_diagscale, dmat_copy), so it has to be rebuilt afterwards.
+ *
+ *  A matrix read from a binary file (see read_bin_new_matrix) keeps val,
+ *  jdx and rdx inside a single memory-mapped block given by map.
+ *  The mapping is private, so in-place scaling does not touch the file.
+ *
  *  NOTE: As for sparse matrix, the matrix indices are not modified
  *  throughout the whole program. It is possible since
  *  matrix-matrix multiplication (except diagonal matrix) is
@@ -38,6 +50,18 @@ typedef struct
     int     *jdx;   /**< column indices    (for both csr and coord) */
     int     *idx;   /**< row indices       (for coordinate) */
     int     *rdx;   /**< row start indices (for csr) */
+
+    /* fields for the transposed copy (csc), see dmat_build_csc */
+
+    double  *tval;  /**< entry values      (for csc) */
+    int     *tidx;  /**< row indices       (for csc) */
+    int     *cdx;   /**< column start indices (for csc) */
+    double  *work;  /**< m-vector workspace of dmat_yHx_ */
+
+    /* block holding val, jdx and rdx when read from a binary file */
+
+    void    *map;   /**< mapped (or allocated) block, NULL otherwise */
+    size_t  maplen; /**< length of the mapping, 0 if allocated */
     
 } dmatrix;
 
@@ -93,6 +117,8 @@ void dmat_colstd(const dmatrix *M, const double *vavg, double *vstd);
 
 void dmat_diagadd(dmatrix *M, const double *d);
 
+void dmat_init_aux(dmatrix *M);
+
 void dmat_new_dense(dmatrix** M, const int m, const int n);
 
 void dmat_free(dmatrix *M);
@@ -100,6 +126,8 @@ void dmat_free(dmatrix *M);
 void dmat_duplicate(const dmatrix* M, dmatrix** Mcopy);
 void dmat_copy(const dmatrix* M, dmatrix* dst);
 void dmat_get_row(const dmatrix *M, const int rowidx, double *dst);
+void dmat_select_cols(const dmatrix *M, const int ncol, const int *cols,
+                      dmatrix **dst);
 
 /* print for debugging */
 void dmat_vprint(const int n, const double *v);
@@ -107,6 +135,8 @@ void dmat_vprint(const int n, const double *v);
 void dmat_print(const dmatrix *mat);
 void dmat_summary(dmatrix *M);
 void dmat_build_idx(dmatrix *M);
+void dmat_build_csc(dmatrix *M);
+void dmat_free_csc(dmatrix *M);
 
 void dmat_B_AAT(dmatrix *A, dmatrix *B);
 void dmat_B_ATA(dmatrix *A, dmatrix *B);
@@ -57,6 +57,8 @@ typedef struct
 
     double *avg_x;
     double *std_x;
+
+    double pcgtol_factor;   /* pcg tolerance adjustment of this solve */
 } problem_data_t;
 
 void set_problem_data(problem_data_t * pdat, dmatrix * matX1, dmatrix * matX2,
@@ -71,6 +73,7 @@ void set_problem_data(problem_data_t * pdat, dmatrix * matX1, dmatrix * matX2,
     pdat->lambda = lambda;
     pdat->avg_x  = avg_x;
     pdat->std_x  = std_x;
+    pdat->pcgtol_factor = 1.0;
 }
 
 void get_problem_data(problem_data_t * pdat, dmatrix ** matX1, dmatrix ** matX2,
@@ -554,8 +557,7 @@ void compute_searchdir_pcg(problem_data_t * pdat, variables_t * vars,
     double lambda, tinv;
     double *g, *h, *z, *expz, *expmz, *ac, *ar, *b, *d1, *d2, *Aw;
     double *x, *v, *w, *u, *dx, *dv, *dw, *du, *gv, *gw, *gu, *gx;
-
-    static double pcgtol_factor = 1.0;
+    double *pcgtol_factor;
 
 
     get_problem_data(pdat, &matX1, &matX2, &ac, &ar, &b, &lambda);
@@ -566,6 +568,12 @@ void compute_searchdir_pcg(problem_data_t * pdat, variables_t * vars,
     nz = matX1->nz;
     tinv = 1.0 / t;
 
+    /* kept per problem (not static) so that solves can run concurrently.
+       the schedule is that of the former static: every solve starts with
+       s = 1, which resets the factor on its first Newton step, so no value
+       was ever carried from one path step to the next. */
+    pcgtol_factor = &pdat->pcgtol_factor;
+
     p0 = &precond[0];
     p1 = &precond[1];
     p2 = &precond[1+n];
@@ -634,13 +642,13 @@ void compute_searchdir_pcg(problem_data_t * pdat, variables_t * vars,
     pcgmaxi = MAX_PCG_ITER;
     if (s < 1e-5)
     {
-        pcgtol_factor *= 0.5;
+        *pcgtol_factor *= 0.5;
     }
     else
     {
-        pcgtol_factor = 1.0;
+        *pcgtol_factor = 1.0;
     }
-     pcgtol = pcgtol*pcgtol_factor;
+     pcgtol = pcgtol*(*pcgtol_factor);
 
     dmat_waxpby(n+n+1, -1, gx, 0, NULL, tmp_x1);
 
@@ -1150,6 +1158,10 @@ int l1_logreg_train(dmatrix *X, double *b, double lambda, train_opts to,
     if (matX1->nz >= 0)                /* only for pcg */
     {
         dmat_elemAA(matX1, &matX2);
+
+        /* csc copies turn the transposed products in pcg into gathers */
+        dmat_build_csc(matX1);
+        dmat_build_csc(matX2);
     }
     else
     {
@@ -11,6 +11,7 @@ extern "C" {
 #define STATUS_SOLUTION_FOUND        0
 #define STATUS_MAX_NT_ITER_EXCEEDED -1
 #define STATUS_MAX_LS_ITER_EXCEEDED -2
+#define STATUS_MAX_EPOCH_EXCEEDED   -3
 
 typedef struct {
     int     sflag;          /* standardization flag */
@@ -25,6 +26,17 @@ l1_logreg_train(dmatrix *X, double *b, double lambda, train_opts to,
                 double *initial_x, double *initial_t, double *sol,
                 int *total_ntiter, int *total_pcgiter);
 
+/* mini-batch proximal SAGA solver (saga.c) */
+int
+l1_logreg_train_saga(dmatrix *X, double *b, double lambda, train_opts to,
+                     int batch, double *initial_x, double *sol,
+                     int *total_epochs);
+
+int
+l1_logreg_train_stream(const char *file, double lambda, int rflag,
+                       train_opts to, int batch, double *sol,
+                       double *lambda_max, int *total_epochs);
+
 /* l1_logreg_classify return values */
 #define STATUS_OK                   0
 #define STATUS_ERROR               -1
@@ -33,6 +45,41 @@ int
 l1_logreg_classify(dmatrix * matX, double *b, double *sol,
                    int pflag, double *result, int *error_count);
 
+/* compiled models for batched scoring (score.c) */
+typedef struct {
+    int     n;              /* number of features */
+    int     nmodel;         /* number of models */
+    int     nfeat;          /* number of features used by any model */
+    int     nz;             /* number of stored coefficients */
+    double  *bias;          /* intercepts (nmodel) */
+    int     *feat;          /* used features, increasing (nfeat) */
+    int     *fdx;           /* start indices of used features (nfeat+1),
+                               nmodel entries if stored densely */
+    int     *mdx;           /* model indices of coefficients (nz) */
+    double  *val;           /* coefficients (nz) */
+    unsigned int *bits;     /* bitmap of used features, or NULL */
+    int     *rank;          /* used features before each bitmap word */
+} l1_model;
+
+/* l1_model_score modes */
+#define SCORE_MARGIN                0
+#define SCORE_SIGN                  1
+#define SCORE_PROB                  2
+
+l1_model *
+l1_model_compile(const dmatrix *S, const int bflag);
+
+l1_model *
+l1_model_compile_vec(const int nmodel, const int n, double *const *sol,
+                     const int bflag);
+
+void
+l1_model_free(l1_model *M);
+
+int
+l1_model_score(const l1_model *M, const dmatrix *X, const int r0,
+               const int r1, const int mode, double *result);
+
 
 #ifdef __cplusplus
 }
@@ -138,6 +138,11 @@ static void usage(char *package, char *version)
 "       -k <double>         - set tolerance for zero coefficients from KKT\n",
 "                             condition\n",
 "       -t <double>         - set tolerance for duality gap\n",
+"       -a                  - solve over all features at every lambda\n",
+"                             (no strong-rule screening)\n",
+"       -p <int>            - split the path into <int> segments and solve\n",
+"                             them concurrently (each one warm started\n",
+"                             from a serial pass over segment boundaries)\n",
 "\n",
 NULL,
     };
@@ -151,9 +156,10 @@ NULL,
 
 static void parse_command_line_args(int argc, char *argv[], double *lambda, 
                                  int *lambda_count, train_opts *to, int *rflag,
+                                 int *screen, int *nseg,
                                  char **ifile_x, char **ifile_y, char **ofile)
 {
-    int c;
+    int c, i;
     int quiet = FALSE;
         
     /* default values */
@@ -163,6 +169,8 @@ static void parse_command_line_args(int argc, char *argv[], double *lambda,
     to->tolerance     = 1.0e-8;
     to->ktolerance    = 0.999;
     *rflag            = FALSE;
+    *screen           = TRUE;
+    *nseg             = 1;
        
 	//bbcrevisit  getargs is busted we have to do this by hand >(
 	//  -r -s  ========>
@@ -197,6 +205,15 @@ static void parse_command_line_args(int argc, char *argv[], double *lambda,
     *ifile_y      = argv[4];
     *ifile_x      = argv[3];
 
+    /* options following the arguments above, also scanned by hand */
+    for (i = 8; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-a") == 0)
+            *screen = FALSE;
+        else if (strcmp(argv[i], "-p") == 0 && i+1 < argc)
+            *nseg = atoi(argv[++i]);
+    }
+
   /*  switch (argc)
     {
     case 5:
@@ -262,6 +279,7 @@ static void convert_Rdata(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         X->jdx = NULL;
         X->rdx = NULL;
     }
+    dmat_init_aux(X);
     *matX = X;
 }
 
@@ -313,6 +331,340 @@ static SEXP create_Rdata_to_return(int count, int lambda_count, int n,
 
 #endif
 
+/*
+ *  Point of the regularization path: solver state after solving for
+ *  lambda, from which the next lambda is warm started.
+ */
+typedef struct
+{
+    double  lambda;
+    double  t;              /* barrier parameter */
+    double  *x;             /* (v, w, u) */
+    double  *grad;          /* loss gradient (used by screening) */
+    double  *solution;      /* intercept + coefficients */
+} path_point_t;
+
+
+/*
+ *  Data shared by the segments of a regularization path.
+ */
+typedef struct
+{
+    dmatrix *matX;          /* feature matrix */
+    double  *b;             /* class vector */
+    train_opts to;
+    int     screen;         /* strong-rule screening on/off */
+    double  *lambda_vec;
+    double  lambda_max;
+    double  *avg;           /* column average   (NULL if not standardized) */
+    double  *std;           /* column std. dev. (NULL if not standardized) */
+    path_point_t *seed;     /* starting point of each segment */
+
+    /* output and counters, updated inside a critical section */
+#ifndef Rpackage
+    FILE    *fp;
+#else
+    buffer_t *buf_val;
+    buffer_t *buf_jdx;
+    buffer_t *buf_rdx;
+    int     *index;
+#endif
+    int     count;
+    int     total_nt;
+    int     total_pcg;
+    int     failed;         /* lambdas whose solve did not converge */
+} path_data_t;
+
+
+/*
+ *  Calls l1_logreg_train(), trying again if BLS error occurs.
+ */
+static int solve_lambda(dmatrix *X, double *b, const double lambda,
+                        const train_opts to, double *x0, double *t0,
+                        double *solution, int *count_nt, int *count_pcg)
+{
+    int trial, ret;
+
+    ret = STATUS_SOLUTION_FOUND;
+    for (trial = 0; trial < MAX_TRIAL; trial++)
+    {
+        double tin = *t0;
+        ret = l1_logreg_train(X, b, lambda, to, x0, t0,
+                              solution, count_nt, count_pcg);
+        if (ret == STATUS_SOLUTION_FOUND) break;
+
+        *t0 = tin/2;
+    }
+    return ret;
+}
+
+
+static void path_point_new(path_point_t *pp, const int n)
+{
+    pp->x        = malloc(sizeof(double)*(2*n+1));
+    pp->grad     = malloc(sizeof(double)*n);
+    pp->solution = malloc(sizeof(double)*(n+1));
+}
+
+
+static void path_point_copy(const path_point_t *src, path_point_t *dst,
+                            const int n)
+{
+    dst->lambda = src->lambda;
+    dst->t      = src->t;
+    dmat_vcopy(2*n+1, src->x, dst->x);
+    dmat_vcopy(n, src->grad, dst->grad);
+    dmat_vcopy(n+1, src->solution, dst->solution);
+}
+
+
+static void path_point_free(path_point_t *pp)
+{
+    free(pp->x);
+    free(pp->grad);
+    free(pp->solution);
+}
+
+
+/*
+ *  Solves the problem for lambda, warm started from the point pp of the
+ *  path (solved for a larger lambda), and moves pp to lambda.
+ *  Returns the status of l1_logreg_train (the first failure, if any).
+ *
+ *  With screening, the strong rule
+ *      |grad_j| >= 2*lambda - lambda_prev   (lambda_prev = pp->lambda)
+ *  selects the features (plus the active ones) passed to l1_logreg_train.
+ *  The discarded features are then checked against the KKT condition
+ *  |grad_j| <= lambda, and the problem is re-solved with the violators
+ *  added until there are none.
+ */
+static int solve_path_point(path_data_t *pd, const double lambda,
+                            path_point_t *pp, int *count_nt, int *count_pcg)
+{
+    int j, n, ns, nv, jmax, ret, status;
+    int sub_nt, sub_pcg;
+    int *keep, *cols;
+    double *x0, *w, *u, *xs, *sol, *grad, *solution;
+    dmatrix *matS;
+    train_opts to;
+
+    to = pd->to;
+    n  = pd->matX->n;
+
+    x0       = pp->x;
+    w        = x0+1;
+    u        = x0+1+n;
+    grad     = pp->grad;
+    solution = pp->solution;
+
+    /* if t0 is too high, make it smaller and adjust u */
+    if (pp->t > 2.0*n/to.tolerance)
+    {
+        double alpha, alpha2;
+
+        pp->t  = 2.0*n/to.tolerance;
+        alpha  = 1.0/(pp->t*lambda);
+        alpha2 = alpha*alpha;
+        for (j = 0; j < n; j++)
+            u[j] = alpha + sqrt(alpha2+w[j]*w[j]);
+    }
+
+    if (!pd->screen)
+    {
+        status = solve_lambda(pd->matX, pd->b, lambda, to, x0, &pp->t,
+                              solution, count_nt, count_pcg);
+        pp->lambda = lambda;
+        return status;
+    }
+
+    xs   = malloc(sizeof(double)*(2*n+1));
+    sol  = malloc(sizeof(double)*(n+1));
+    keep = malloc(sizeof(int)*n);
+    cols = malloc(sizeof(int)*n);
+
+    /* strong set: active features and those passing the rule */
+    ns   = 0;
+    jmax = 0;
+    for (j = 0; j < n; j++)
+    {
+        keep[j] = (solution[j+1] != 0.0 ||
+                   fabs(grad[j]) >= 2*lambda - pp->lambda);
+        if (keep[j]) ns++;
+        if (fabs(grad[j]) > fabs(grad[jmax])) jmax = j;
+    }
+    if (ns == 0) keep[jmax] = TRUE;
+
+    status     = STATUS_SOLUTION_FOUND;
+    *count_nt  = 0;
+    *count_pcg = 0;
+    while (TRUE)
+    {
+        double alpha;
+
+        /* reduced problem, warm started from x0 */
+        ns = 0;
+        for (j = 0; j < n; j++)
+            if (keep[j]) cols[ns++] = j;
+
+        dmat_select_cols(pd->matX, ns, cols, &matS);
+        xs[0] = x0[0];
+        for (j = 0; j < ns; j++)
+        {
+            xs[1+j]    = w[cols[j]];
+            xs[1+ns+j] = u[cols[j]];
+        }
+        ret = solve_lambda(matS, pd->b, lambda, to, xs, &pp->t,
+                           sol, &sub_nt, &sub_pcg);
+        dmat_free(matS);
+        if (status == STATUS_SOLUTION_FOUND) status = ret;
+        *count_nt  += sub_nt;
+        *count_pcg += sub_pcg;
+
+        /* scatter back; discarded features stay at w = 0 */
+        alpha = 1.0/(pp->t*lambda);
+        x0[0] = xs[0];
+        dmat_vset(n, 0.0, w);
+        dmat_vset(n, 2*alpha, u);
+        dmat_vset(n+1, 0.0, solution);
+        solution[0] = sol[0];
+        for (j = 0; j < ns; j++)
+        {
+            w[cols[j]] = xs[1+j];
+            u[cols[j]] = xs[1+ns+j];
+            solution[cols[j]+1] = sol[1+j];
+        }
+
+        /* KKT check over the discarded features */
+        find_gradient(pd->matX, pd->b, pd->avg, pd->std, x0, grad);
+        nv = 0;
+        for (j = 0; j < n; j++)
+        {
+            if (!keep[j] && fabs(grad[j]) > lambda)
+            {
+                keep[j] = TRUE;
+                nv++;
+            }
+        }
+        if (nv == 0) break;
+
+        if (to.verbose_level>=2)
+            fprintf(stderr,"    [KKT violations]    %10d\n",nv);
+    }
+    if (to.verbose_level>=2)
+        fprintf(stderr,"    [screened features] %10d\n",ns);
+
+    pp->lambda = lambda;
+
+    free(cols);
+    free(keep);
+    free(sol);
+    free(xs);
+    return status;
+}
+
+
+/*
+ *  Solves the problem for lambda_vec[i0] ... lambda_vec[i1-1], warm starting
+ *  each lambda from the previous one and the first one from the seed of
+ *  the segment. Coefficients of the lambdas whose solve did not converge
+ *  are not written.
+ */
+static void solve_path_segment(path_data_t *pd, const int seg,
+                               const int i0, const int i1, double *solution)
+{
+    int i, n, status;
+    int count_nt, count_pcg;
+    double lambda;
+    double *sol;
+    path_point_t pp;
+    clock_t t_solve_start, t_solve_end;
+    train_opts to;
+
+    to = pd->to;
+    n  = pd->matX->n;
+
+    sol = malloc(sizeof(double)*(n+1));
+    path_point_new(&pp, n);
+    path_point_copy(&pd->seed[seg], &pp, n);
+
+    for (i = i0; i < i1; i++)
+    {
+        lambda = pd->lambda_vec[i];
+
+        if (to.verbose_level>=2) fprintf(stderr,"    lambda = %e\n",lambda);
+        t_solve_start = clock();
+
+        status = solve_path_point(pd, lambda, &pp, &count_nt, &count_pcg);
+        dmat_vcopy(n+1, pp.solution, solution);
+
+        t_solve_end = clock();
+
+        /*
+         *  write coefficients
+         */
+        #pragma omp critical (regpath_write)
+        {
+            if (status != STATUS_SOLUTION_FOUND)
+            {
+                fprintf(stderr,"WARNING: no convergence at lambda = %e "
+                        "(status %d), coefficients are not written.\n",
+                        lambda, status);
+                pd->failed++;
+            }
+            else if (to.cflag)
+            {
+                /* only coefficients */
+                #ifndef Rpackage
+                pd->count += write_mm_matrix_crd_column(pd->fp, n, i,
+                                                        solution+1);
+                #else
+                int cur_len;
+                int rowidx = pd->count+1;
+                dmat_vcopy(n+1, solution, sol);
+                cur_len = condense_solution(n, sol, pd->index);
+                buffer_write(pd->buf_rdx, &rowidx   , 1      );
+                buffer_write(pd->buf_jdx, pd->index , cur_len);
+                buffer_write(pd->buf_val, sol       , cur_len);
+                pd->count += cur_len;
+                #endif
+            }
+            else
+            {
+                /* intercept + coefficients(/std.dev.) */
+                #ifndef Rpackage
+                pd->count += write_mm_matrix_crd_column(pd->fp, n+1, i,
+                                                        solution);
+                #else
+                int cur_len;
+                int rowidx = pd->count+1;
+                dmat_vcopy(n+1, solution, sol);
+                cur_len = condense_solution(n+1, sol, pd->index);
+                buffer_write(pd->buf_rdx, &rowidx   , 1      );
+                buffer_write(pd->buf_jdx, pd->index , cur_len);
+                buffer_write(pd->buf_val, sol       , cur_len);
+                pd->count += cur_len;
+                #endif
+            }
+            pd->total_nt  += count_nt;
+            pd->total_pcg += count_pcg;
+        }
+
+        if (to.verbose_level>=2)
+        {
+            fprintf(stderr,"    [NT  iterations]    %10d\n",count_nt);
+            if (pd->matX->nz >= 0)
+                fprintf(stderr,"    [PCG iterations]    %10d\n",count_pcg);
+            fprintf(stderr,"    [execution time]    %10.3g (sec)\n",
+                    (double)(t_solve_end-t_solve_start)/CLOCKS_PER_SEC);
+            fprintf(stderr,"\n");
+        }
+    }
+
+    path_point_free(&pp);
+    free(sol);
+}
+
+
 /*
  *  Standardize data and solve l_1-regularized logistic regression problems
  *  by calling l1_logreg_train() repeatedly.
@@ -339,19 +691,19 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
 
     train_opts to;
     int     rflag;
+    int     screen;     /* strong-rule screening */
+    int     nseg;       /* number of path segments */
     char    *ifile_x, *ifile_y, *ofile;
     double  lambda_max, lambda_min, *lambda_vec;
-    clock_t t_start, t_end, t_read, t_write, 
-            t_solve, t_solve_start, t_solve_end;
+    clock_t t_start, t_end, t_read, t_write, t_solve, t_solve_start;
 
-    int count_nt, count_pcg, total_nt, total_pcg;
-    int i, m, n, ret;
+    int i, j, m, n;
     int pos_count;
     int lambda_count;
-    int count;
     double alpha;
-    double t0;
-    double *x0;
+    double *x0, *grad0, *avg, *std;
+    path_point_t *seed;
+    path_data_t pd;
 
     /* output file */
     FILE *fp;
@@ -375,7 +727,8 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
     /* read data */
 #ifndef Rpackage
     parse_command_line_args(argc, argv, &lambda, &lambda_count, &to,
-                            &rflag, &ifile_x, &ifile_y, &ofile);
+                            &rflag, &screen, &nseg,
+                            &ifile_x, &ifile_y, &ofile);
 
     if (to.verbose_level>=2) fprintf(stderr,"\nReading data...\n\n");
     read_mm_new_matrix(ifile_x, &matX);
@@ -384,6 +737,8 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
     convert_Rdata(pm,pn,pnz,pval,pjdx,prdx,pb,plambda,prflag,
                   psflag,pcflag,pqflag,pvval,ptol,pktol,plambda_count,
                   &matX,&b,&lambda,&lambda_count,&to,&rflag );
+    screen = TRUE;
+    nseg   = 1;         /* results are buffered in lambda order */
 #endif
     m = matX->m;
     n = matX->n;
@@ -425,12 +780,45 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
     for (i = 0; i < m; i++) 
         if (b[i] > 0) pos_count++;
 
-    t0 = 2.0*n/to.tolerance;
-    x0 = malloc(sizeof(double)*(2*n+1));
+    if (nseg < 1) nseg = 1;
+    if (nseg > lambda_count) nseg = lambda_count;
+    seed = malloc(sizeof(path_point_t)*nseg);
+    for (i = 0; i < nseg; i++)
+        path_point_new(&seed[i], n);
+
+    /* starting point at lambda_max */
+    seed[0].lambda = lambda_max;
+    seed[0].t      = 2.0*n/to.tolerance;
+    x0    = seed[0].x;
+    grad0 = seed[0].grad;
     x0[0] = log(((double)(m-pos_count))/pos_count); /* initialize v */
     dmat_vset(n, 0.0, x0+1);                        /* initialize w */
-    alpha = 1.0/(t0*lambda_max);
+    alpha = 1.0/(seed[0].t*lambda_max);
     dmat_vset(n, 2*alpha, x0+1+n);                  /* initialize u */
+    dmat_vset(n, 0.0, grad0);
+    dmat_vset(n+1, 0.0, seed[0].solution);
+
+    /* loss gradient at lambda_max (w = 0, optimal intercept) */
+    avg   = NULL;
+    std   = NULL;
+    if (screen)
+    {
+        if (to.sflag)
+        {
+            avg = malloc(sizeof(double)*n);
+            std = malloc(sizeof(double)*n);
+            dmat_colavg(matX, avg);
+            dmat_colstd(matX, avg, std);
+            for (j = 0; j < n; j++)
+                if (std[j] < 1.0e-20) std[j] = 1;
+        }
+        /* X'*r is computed at every lambda */
+        dmat_build_csc(matX);
+
+        x0[0] = log(((double)pos_count)/(m-pos_count));
+        find_gradient(matX, b, avg, std, x0, grad0);
+        x0[0] = log(((double)(m-pos_count))/pos_count);
+    }
 
 #ifndef Rpackage
     /* run solver and write solution */
@@ -449,96 +837,87 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         write_mm_matrix_crd_header(fp, n+1, lambda_count, 999999999, line);
 #endif
 
-    count       = 0;
-    t_solve     = 0;
-    total_nt    = 0;
-    total_pcg   = 0;
-
-    for (i = 0; i < lambda_count; i++)
+    pd.matX         = matX;
+    pd.b            = b;
+    pd.to           = to;
+    pd.screen       = screen;
+    pd.lambda_vec   = lambda_vec;
+    pd.lambda_max   = lambda_max;
+    pd.avg          = avg;
+    pd.std          = std;
+    pd.seed         = seed;
+#ifndef Rpackage
+    pd.fp           = fp;
+#else
+    pd.buf_val      = buf_val;
+    pd.buf_jdx      = buf_jdx;
+    pd.buf_rdx      = buf_rdx;
+    pd.index        = index;
+#endif
+    pd.count        = 0;
+    pd.total_nt     = 0;
+    pd.total_pcg    = 0;
+    pd.failed       = 0;
+
+    t_solve_start = clock();
+
+    /*
+     *  A segment is warm started from the solution at the lambda before
+     *  its first one, as on the serial path (a cold start from lambda_max
+     *  may not converge at small lambdas). These seeds are computed by a
+     *  serial pass over the segment boundaries, after which the segments
+     *  are independent.
+     */
+    for (i = 1; i < nseg; i++)
     {
-        int trial;
+        int count_nt, count_pcg;
+        double lambda_seed;
 
-        if (to.verbose_level>=2) fprintf(stderr,"    lambda = %e\n",lambda_vec[i]);
-        t_solve_start = clock();
-
-        /* solve problem for each lambda */
-        /* if t0 is too high, make it smaller and adjust u */
-        if (t0 > 2.0*n/to.tolerance)
-        {
-            int j;
-            double *w, *u;
-            double alpha, alpha2;
-
-            w  = x0+1;
-            u  = x0+1+n;
-            t0 = 2.0*n/to.tolerance;
-            alpha  = 1.0/(t0*lambda_vec[i]);
-            alpha2 = alpha*alpha;
-            for (j = 0; j < n; j++)
-                u[j] = alpha + sqrt(alpha2+w[j]*w[j]);
-        }
-
-        /* try again if BLS error occurs */
-        for (trial = 0; trial < MAX_TRIAL; trial++)
-        {
-            double tin = t0;
-            ret = l1_logreg_train(matX, b, lambda_vec[i], to , x0, &t0,
-                                  solution, &count_nt, &count_pcg);
-            if (ret == STATUS_SOLUTION_FOUND) break;
+        lambda_seed = lambda_vec[(int)((long)lambda_count*i/nseg)-1];
+        if (to.verbose_level>=2)
+            fprintf(stderr,"    seed of segment %d, lambda = %e\n",
+                    i, lambda_seed);
+
+        path_point_copy(&seed[i-1], &seed[i], n);
+        if (solve_path_point(&pd, lambda_seed, &seed[i],
+                             &count_nt, &count_pcg) != STATUS_SOLUTION_FOUND
+            && to.verbose_level>=2)
+            fprintf(stderr,"    [seed not converged]\n");
+        pd.total_nt  += count_nt;
+        pd.total_pcg += count_pcg;
+        if (to.verbose_level>=2)
+            fprintf(stderr,"    [NT  iterations]    %10d\n\n",count_nt);
+    }
 
-            t0 = tin/2;
-        }
+    #pragma omp parallel for schedule(dynamic,1) if (nseg > 1)
+    for (i = 0; i < nseg; i++)
+    {
+        int i0, i1;
+        double *seg_solution;
 
-        t_solve_end = clock();
-        t_solve += t_solve_end - t_solve_start;
+        i0 = (int)((long)lambda_count*i/nseg);
+        i1 = (int)((long)lambda_count*(i+1)/nseg);
 
-        /*
-         *  write coefficients
-         */
-        if (to.cflag)
-        {
-            /* only coefficients */
-            #ifndef Rpackage
-            count += write_mm_matrix_crd_column(fp, n, i, solution+1);
-            #else
-            int cur_len;
-            int rowidx = count+1;
-            cur_len = condense_solution(n, solution, index);
-            buffer_write(buf_rdx, &rowidx , 1      );
-            buffer_write(buf_jdx, index   , cur_len);
-            buffer_write(buf_val, solution, cur_len);
-            count += cur_len;
-            #endif
-        }
+        /* the last segment keeps its final solution for the summary */
+        if (i1 == lambda_count)
+            seg_solution = solution;
         else
-        {
-            /* intercept + coefficients(/std.dev.) */
-            #ifndef Rpackage
-            count += write_mm_matrix_crd_column(fp, n+1, i, solution);
-            #else
-            int cur_len;
-            int rowidx = count+1;
-            cur_len = condense_solution(n+1, solution, index);
-            buffer_write(buf_rdx, &rowidx , 1      );
-            buffer_write(buf_jdx, index   , cur_len);
-            buffer_write(buf_val, solution, cur_len);
-            count += cur_len;
-            #endif
-        }
+            seg_solution = malloc(sizeof(double)*(n+1));
 
+        solve_path_segment(&pd, i, i0, i1, seg_solution);
 
-        if (to.verbose_level>=2)
-        {
-            fprintf(stderr,"    [NT  iterations]    %10d\n",count_nt);
-            if (matX->nz >= 0)
-                fprintf(stderr,"    [PCG iterations]    %10d\n",count_pcg);
-            fprintf(stderr,"    [execution time]    %10.3g (sec)\n",
-                    (double)(t_solve_end-t_solve_start)/CLOCKS_PER_SEC);
-            fprintf(stderr,"\n");
-        }
-        total_nt  += count_nt;
-        total_pcg += count_pcg;
+        if (seg_solution != solution) free(seg_solution);
     }
+    t_solve = clock() - t_solve_start;
+
+    for (i = 0; i < nseg; i++)
+        path_point_free(&seed[i]);
+    free(seed);
+
+    if (pd.failed > 0)
+        fprintf(stderr,"ERROR: %d of %d lambdas did not converge.\n",
+                pd.failed, lambda_count);
+
 #ifndef Rpackage
     fflush(fp);
     rewind(fp);
@@ -549,7 +928,7 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
     fseek(fp, -1, SEEK_CUR);
     fscanf(fp, "%d %d %d", &tmp_int1, &tmp_int2, &tmp_int3);
     fseek(fp, -9, SEEK_CUR);
-    fprintf(fp, "%9d", count);
+    fprintf(fp, "%9d", pd.count);
     fclose(fp);
 
     /* write lambda vector */
@@ -569,31 +948,33 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
 #else
     /* write final row index */
     {
-        int rowidx = count+1;
+        int rowidx = pd.count+1;
         buffer_write(buf_rdx, &rowidx, 1);
     }
 #endif
 
     if (to.verbose_level==1)
         summary_all(m, n, lambda_count, lambda_min, lambda_max,
-                    t_solve, total_nt, total_pcg, solution+1);
+                    t_solve, pd.total_nt, pd.total_pcg, solution+1);
 
 #ifdef Rpackage
-    if (i < lambda_count)
+    if (pd.failed > 0)
         return R_NilValue; /* error */
     else
     {
         SEXP res;
-        res = create_Rdata_to_return(count, lambda_count, n, lambda_vec,
+        res = create_Rdata_to_return(pd.count, lambda_count, n, lambda_vec,
                                      buf_val, buf_jdx, buf_rdx);
         /* do not free matX->val */
+        dmat_free_csc(matX);
         if (matX->nz >= 0) {
             free(matX->idx);
             free(matX->jdx);
             free(matX->rdx);
         }
         free(matX);
-        free(x0);
+        if (avg) free(avg);
+        if (std) free(std);
         free(index);
         free(solution);
         free(lambda_vec);
@@ -605,10 +986,11 @@ SEXP regpathR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
 #else
     dmat_free(matX);
     free(b);
-    free(x0);
+    if (avg) free(avg);
+    if (std) free(std);
     free(solution);
     free(lambda_vec);
 
-    return EXIT_SUCCESS;
+    return (pd.failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
 #endif
 }
@@ -0,0 +1,1057 @@
+/** \file   saga.c
+ *  \brief  Mini-batch proximal SAGA solver for l1-regularized logistic
+ *          regression.
+ *
+ *  Solves the same problem as l1_logreg_train,
+ *  \f[
+ *      \mbox{minimize} \quad (1/m)\sum_i f(b_i(x_i^Tw+v)) + \lambda\|w\|_1,
+ *  \f]
+ *  but only touches the rows of the feature matrix in chunks, in order.
+ *  The rows come either from a matrix in memory or from a binary feature
+ *  file that is streamed from disk, so the data need not fit in memory.
+ *  While a chunk is processed, the next one is read by a second thread.
+ *
+ *  Each epoch makes two passes over the data:
+ *  - a full pass at the current point, which evaluates the objective and
+ *    the duality gap (stopping criterion, as in l1_logreg_train) and
+ *    refreshes the table of stored gradients,
+ *  - a SAGA pass, with one proximal step per mini-batch.
+ *
+ *  The SAGA pass works on the scaled but uncentered features X*diag(std)^-1
+ *  and the intercept c of X*ws + c, which describe the same model. Then the
+ *  gradient difference of a batch is as sparse as its rows. A coefficient
+ *  is only brought up to date when a batch touches it: the steps it missed
+ *  all had the same stored gradient, so they are applied in closed form.
+ *
+ *  First-order steps find the support but converge slowly in the flat
+ *  directions of the loss, and the duality gap only closes at the rate of
+ *  the coefficients. Hence every SAGA pass is followed by a damped Newton
+ *  step on the support (signs fixed) while the support is small; its
+ *  Hessian is accumulated in one more pass over the rows.
+ *
+ *  Only scalars are stored per example (linear model), i.e., the memory
+ *  use is O(m+n) plus two chunks, and O(k^2) for a support of size k.
+ */
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#include "def.h"
+#include "dmatrix.h"
+#include "l1_logreg.h"
+#include "util.h"
+
+#define MAX_EPOCH       1000    /* terminates when epoch > MAX_EPOCH    */
+#define CHUNK_ROWS      4096    /* minimum number of rows per chunk     */
+#define POWER_ITER      20      /* power iterations to estimate L       */
+#define L_SAFETY        1.5     /* safety factor on the estimated L     */
+#define STEP_GROW       1.2     /* step increase after a good epoch     */
+#define NEWTON_MAX      1000    /* largest support for a Newton step    */
+#define MAX_LS_ITER     20      /* backtracking steps of a Newton step  */
+#define ALPHA           0.01    /* minimum fraction of decrease         */
+#define BETA            0.5     /* step reduction of the line search    */
+
+
+/*
+ *  Row source: a matrix in memory or a binary feature file.
+ */
+typedef struct
+{
+    int     m, n;
+    const double  *b;       /* class vector */
+    const dmatrix *X;       /* matrix in memory, or NULL */
+    bin_stream_t  *bs;      /* streamed file, or NULL */
+} row_source_t;
+
+/*
+ *  Rows r0,...,r1-1. The entries of row i are jdx[k],val[k] for
+ *  k = rdx[i]-off,...,rdx[i+1]-off-1 (sparse), or val[i*n+j] (dense).
+ */
+typedef struct
+{
+    int     r0, r1;
+    int     nz;             /* -1 if dense */
+    const int    *rdx;
+    int     off;
+    const int    *jdx;
+    const double *val;
+
+    /* buffers of a streamed chunk */
+    int     *jbuf;
+    double  *vbuf;
+    size_t  cap;
+} chunk_t;
+
+/*
+ *  Solver state. Coefficients are in standardized coordinates when
+ *  avg and std are given (as the variables of l1_logreg_train).
+ */
+typedef struct
+{
+    int     m, n;
+    const double *b;
+    double  lambda;
+    double  gamma;          /* step size */
+
+    double  *avg, *std;     /* column statistics (NULL if not standardized) */
+    double  *colsum;        /* column sums, for the dual point */
+
+    double  v, *w;          /* intercept and coefficients */
+    double  v_prev, *w_prev;/* point of the last accepted epoch */
+    double  c, *ws;         /* X_std*w + v = X*ws + c */
+
+    double  *alpha;         /* stored loss derivatives, m-vector */
+    double  gbar_v, *gbar;  /* average of the stored gradients (uncentered) */
+    double  *raw;           /* n-vector accumulator */
+    double  sum, loss;      /* pass accumulators */
+
+    int     step;           /* steps taken in the current SAGA pass */
+    int     *last;          /* step up to which w[j] is up to date */
+
+    int     ns;             /* size of the support (Newton step) */
+    int     *pos;           /* position of a feature in it, or -1 */
+    double  *hess;          /* (ns+1)x(ns+1) Hessian on (w_S, c) */
+    int     *hk;            /* entries of a row in the support */
+    double  *hx;
+} saga_t;
+
+typedef void (*chunk_func)(const chunk_t *, saga_t *);
+
+
+static void chunk_fetch(const row_source_t *src, const int r0, const int r1,
+                        chunk_t *c)
+{
+    int n;
+    size_t len;
+
+    n = src->n;
+    c->r0 = r0;
+    c->r1 = r1;
+
+    if (src->X != NULL)
+    {
+        const dmatrix *X = src->X;
+
+        c->nz = X->nz;
+        if (X->nz >= 0)
+        {
+            c->rdx = X->rdx + r0;
+            c->off = X->rdx[r0];
+            c->jdx = X->jdx + c->off;
+            c->val = X->val + c->off;
+        }
+        else
+        {
+            c->val = X->val + (size_t)r0*n;
+        }
+        return;
+    }
+
+    c->nz = src->bs->nz;
+    if (c->nz >= 0)
+    {
+        c->rdx = src->bs->rdx + r0;
+        c->off = src->bs->rdx[r0];
+        len = (size_t)(src->bs->rdx[r1] - c->off);
+    }
+    else
+    {
+        len = (size_t)(r1-r0)*n;
+    }
+    if (len > c->cap)
+    {
+        c->cap  = len;
+        c->jbuf = realloc(c->jbuf, sizeof(int)*len);
+        c->vbuf = realloc(c->vbuf, sizeof(double)*len);
+    }
+    bin_stream_read_rows(src->bs, r0, r1, c->jbuf, c->vbuf);
+    c->jdx = c->jbuf;
+    c->val = c->vbuf;
+}
+
+
+/*
+ *  Calls func for every chunk of rows, in order. The next chunk of a
+ *  streamed source is read while func works on the current one.
+ */
+static void scan_rows(const row_source_t *src, const int rows, chunk_t *cbuf,
+                      chunk_func func, saga_t *s)
+{
+    int r0, cur;
+    int m = src->m;
+
+    cur = 0;
+    chunk_fetch(src, 0, min(rows, m), &cbuf[0]);
+    for (r0 = 0; r0 < m; r0 += rows)
+    {
+        int r1 = min(r0+rows, m);
+        int r2 = min(r1+rows, m);
+
+        #pragma omp parallel sections num_threads(2) if (src->bs != NULL)
+        {
+            #pragma omp section
+            {
+                if (r1 < m) chunk_fetch(src, r1, r2, &cbuf[1-cur]);
+            }
+            #pragma omp section
+            {
+                func(&cbuf[cur], s);
+            }
+        }
+        cur = 1-cur;
+    }
+}
+
+
+/* x_i'*y, i-th row of chunk */
+static double row_dot(const chunk_t *c, const int n, const int i,
+                      const double *y)
+{
+    int k;
+    double ret = 0.0;
+
+    if (c->nz >= 0)
+    {
+        for (k = c->rdx[i]-c->off; k < c->rdx[i+1]-c->off; k++)
+            ret += c->val[k]*y[c->jdx[k]];
+    }
+    else
+    {
+        const double *x = c->val + (size_t)i*n;
+        for (k = 0; k < n; k++)
+            ret += x[k]*y[k];
+    }
+    return ret;
+}
+
+
+/* y += a*x_i, i-th row of chunk */
+static void row_axpy(const chunk_t *c, const int n, const int i,
+                     const double a, double *y)
+{
+    int k;
+
+    if (c->nz >= 0)
+    {
+        for (k = c->rdx[i]-c->off; k < c->rdx[i+1]-c->off; k++)
+            y[c->jdx[k]] += a*c->val[k];
+    }
+    else
+    {
+        const double *x = c->val + (size_t)i*n;
+        for (k = 0; k < n; k++)
+            y[k] += a*x[k];
+    }
+}
+
+
+/* s->raw = colsum, s->gbar = sum of squares (statistics pass) */
+static void pass_stats(const chunk_t *c, saga_t *s)
+{
+    int i, k;
+
+    for (i = 0; i < c->r1-c->r0; i++)
+    {
+        if (c->nz >= 0)
+        {
+            for (k = c->rdx[i]-c->off; k < c->rdx[i+1]-c->off; k++)
+            {
+                s->raw [c->jdx[k]] += c->val[k];
+                s->gbar[c->jdx[k]] += c->val[k]*c->val[k];
+            }
+        }
+        else
+        {
+            const double *x = c->val + (size_t)(i)*s->n;
+            for (k = 0; k < s->n; k++)
+            {
+                s->raw [k] += x[k];
+                s->gbar[k] += x[k]*x[k];
+            }
+        }
+    }
+}
+
+
+/* ws = w./std, c = v - avg'*ws */
+static void update_scaled(saga_t *s)
+{
+    if (s->std) dmat_elemdivi(s->n, s->w, s->std, s->ws);
+    else        dmat_vcopy(s->n, s->w, s->ws);
+
+    s->c = s->v;
+    if (s->avg) s->c -= dmat_dot(s->n, s->avg, s->ws);
+}
+
+
+/* standardizes the accumulated X'*y into y := (X'*y - avg*sum(y))./std */
+static void scale_raw(saga_t *s, const double sum, double *y)
+{
+    int j;
+
+    for (j = 0; j < s->n; j++)
+    {
+        double d = s->raw[j];
+        if (s->avg) d -= s->avg[j]*sum;
+        if (s->std) d /= s->std[j];
+        y[j] = d;
+    }
+}
+
+
+/*
+ *  Full pass at the current point: loss, exact derivatives and
+ *  raw = X'*alpha, sum = sum(alpha).
+ */
+static void pass_full(const chunk_t *c, saga_t *s)
+{
+    int i;
+
+    for (i = 0; i < c->r1-c->r0; i++)
+    {
+        int    r  = c->r0+i;
+        double bi = s->b[r];
+        double z  = bi*(row_dot(c, s->n, i, s->ws) + s->c);
+
+        /* f(z) = log(1+exp(-z)), f'(z) = -1/(1+exp(z)) */
+        s->loss += (z > 0) ? log1p(exp(-z)) : log1p(exp(z)) - z;
+        s->alpha[r] = -bi/(1.0+exp(z));
+        s->sum += s->alpha[r];
+        row_axpy(c, s->n, i, s->alpha[r], s->raw);
+    }
+}
+
+
+/*
+ *  k steps of w := soft_threshold(w - p, tau) with fixed p and tau.
+ *  The iterate moves linearly while it keeps its sign, so at most three
+ *  pieces are needed: towards zero, the step across it, and beyond.
+ */
+static double prox_repeat(double w, double p, const double tau, int k)
+{
+    double y, q, sgn;
+
+    sgn = 1.0;
+    while (k > 0)
+    {
+        if (w == 0.0)
+        {
+            if (fabs(p) <= tau) return 0.0;
+            w = (p > 0.0) ? tau-p : -tau-p;
+            k--;
+            continue;
+        }
+        if (w < 0.0)
+        {
+            w = -w;
+            p = -p;
+            sgn = -sgn;
+        }
+        /* w > 0 decreases by p+tau per step while it stays positive */
+        if (p+tau <= 0.0) return sgn*(w - k*(p+tau));
+
+        q = ceil(w/(p+tau)) - 1.0;
+        if (q >= k) return sgn*(w - k*(p+tau));
+        if (q > 0.0)
+        {
+            w -= q*(p+tau);
+            k -= (int)q;
+        }
+
+        /* the step that reaches zero or crosses it */
+        y = w - p;
+        w = (y > tau) ? y-tau : ((y < -tau) ? y+tau : 0.0);
+        k--;
+    }
+    return sgn*w;
+}
+
+
+/* brings w[j] (and ws[j]) up to step t of the SAGA pass */
+static void catch_up(saga_t *s, const int j, const int t)
+{
+    if (s->last[j] < t)
+    {
+        s->w[j] = prox_repeat(s->w[j], s->gamma*s->gbar[j],
+                              s->gamma*s->lambda, t-s->last[j]);
+        s->ws[j] = (s->std) ? s->w[j]/s->std[j] : s->w[j];
+        s->last[j] = t;
+    }
+}
+
+
+/*
+ *  SAGA pass: one proximal step per chunk (mini-batch).
+ *  Only the features of the batch are updated, see catch_up.
+ */
+static void pass_saga(const chunk_t *c, saga_t *s)
+{
+    int i, k, kn, rows, t;
+    double sd, gl, dv;
+
+    rows = c->r1-c->r0;
+    t    = s->step;
+    kn   = (c->nz >= 0) ? c->rdx[rows]-c->off : s->n;
+
+    /* the rows see the point of step t */
+    for (k = 0; k < kn; k++)
+        catch_up(s, (c->nz >= 0) ? c->jdx[k] : k, t);
+
+    sd = 0.0;
+    for (i = 0; i < rows; i++)
+    {
+        int    r  = c->r0+i;
+        double bi = s->b[r];
+        double z  = bi*(row_dot(c, s->n, i, s->ws) + s->c);
+        double a  = -bi/(1.0+exp(z));
+
+        sd += a - s->alpha[r];
+        row_axpy(c, s->n, i, a - s->alpha[r], s->raw);
+        s->alpha[r] = a;
+    }
+
+    /* w = soft_threshold(w - gamma*g, gamma*lambda) on the batch, where
+       g = d/rows + gbar and d is the gradient difference of the batch */
+    gl = s->gamma*s->lambda;
+    for (k = 0; k < kn; k++)
+    {
+        int j = (c->nz >= 0) ? c->jdx[k] : k;
+        double d, g, wj;
+
+        if (s->last[j] != t) continue;  /* repeated index */
+
+        d  = (s->std) ? s->raw[j]/s->std[j] : s->raw[j];
+        g  = d/rows + s->gbar[j];
+        s->gbar[j] += d/s->m;
+
+        wj = s->w[j] - s->gamma*g;
+        s->w[j]  = (wj > gl) ? wj-gl : ((wj < -gl) ? wj+gl : 0.0);
+        s->ws[j] = (s->std) ? s->w[j]/s->std[j] : s->w[j];
+        s->raw[j]  = 0.0;
+        s->last[j] = t+1;
+    }
+    dv = sd/rows + s->gbar_v;
+    s->gbar_v += sd/s->m;
+    s->c -= s->gamma*dv;
+
+    s->step = t+1;
+}
+
+
+/*
+ *  Ends a SAGA pass: brings all coefficients up to date and
+ *  recovers the intercept v of the standardized model.
+ */
+static void saga_flush(saga_t *s)
+{
+    int j;
+
+    for (j = 0; j < s->n; j++)
+    {
+        catch_up(s, j, s->step);
+        s->last[j] = 0;
+    }
+    s->step = 0;
+
+    s->v = s->c;
+    if (s->avg) s->v += dmat_dot(s->n, s->avg, s->ws);
+
+    /* the point is (w, v) from here on, as after a rejected epoch */
+    update_scaled(s);
+}
+
+
+/* s->loss += loss of the rows at the current point */
+static void pass_loss(const chunk_t *c, saga_t *s)
+{
+    int i;
+
+    for (i = 0; i < c->r1-c->r0; i++)
+    {
+        double z = s->b[c->r0+i]*(row_dot(c, s->n, i, s->ws) + s->c);
+        s->loss += (z > 0) ? log1p(exp(-z)) : log1p(exp(z)) - z;
+    }
+}
+
+
+/*
+ *  s->hess += [x_S/std 1]'*diag(f''(z))*[x_S/std 1] over the rows,
+ *  with the derivatives alpha of the last full pass.
+ */
+static void pass_hess(const chunk_t *c, saga_t *s)
+{
+    int i, k, l, cnt, ns1;
+    double p, h;
+
+    ns1 = s->ns+1;
+    for (i = 0; i < c->r1-c->r0; i++)
+    {
+        /* f''(z) = p*(1-p), p = 1/(1+exp(z)) = -b*alpha */
+        p = -s->b[c->r0+i]*s->alpha[c->r0+i];
+        h = p*(1.0-p);
+
+        cnt = 0;
+        if (c->nz >= 0)
+        {
+            for (k = c->rdx[i]-c->off; k < c->rdx[i+1]-c->off; k++)
+            {
+                int j = c->jdx[k];
+                if (s->pos[j] < 0) continue;
+                s->hk[cnt] = s->pos[j];
+                s->hx[cnt] = (s->std) ? c->val[k]/s->std[j] : c->val[k];
+                cnt++;
+            }
+        }
+        else
+        {
+            const double *x = c->val + (size_t)i*s->n;
+            for (k = 0; k < s->n; k++)
+            {
+                if (s->pos[k] < 0) continue;
+                s->hk[cnt] = s->pos[k];
+                s->hx[cnt] = (s->std) ? x[k]/s->std[k] : x[k];
+                cnt++;
+            }
+        }
+        s->hk[cnt] = s->ns;     /* intercept */
+        s->hx[cnt] = 1.0;
+        cnt++;
+
+        for (k = 0; k < cnt; k++)
+        {
+            double hxk = h*s->hx[k];
+            double *col = s->hess + (size_t)s->hk[k]*ns1;
+            for (l = 0; l < cnt; l++)
+                col[s->hk[l]] += hxk*s->hx[l];
+        }
+    }
+}
+
+
+/*
+ *  Newton step on the support with the signs of w fixed, i.e., on
+ *      (1/m)sum_i f(b_i(x_i'*ws+c)) + lambda*sign(w_S)'*w_S,
+ *  followed by a backtracking line search in which a coefficient that
+ *  changes sign is set to zero. The Hessian is damped by |g|*I, which
+ *  keeps the step short on a nearly singular support and vanishes at the
+ *  solution. Uses the table of the last full pass.
+ *
+ *  Returns TRUE if the objective pobj has been decreased.
+ */
+static int newton_step(const row_source_t *src, const int rows,
+                       chunk_t *cbuf, saga_t *s, const double pobj)
+{
+    int j, k, ns, ns1, it, ret;
+    double t, gd, mu, pnew, c0;
+    double *d, *w0;
+    dmatrix *H;
+
+    ns = 0;
+    for (j = 0; j < s->n; j++)
+        s->pos[j] = (s->w[j] != 0.0) ? ns++ : -1;
+    if (ns > NEWTON_MAX) return FALSE;
+    ns1 = ns+1;
+
+    dmat_new_dense(&H, ns1, ns1);
+    dmat_vset(ns1*ns1, 0.0, H->val);
+    d  = malloc(sizeof(double)*ns1);
+    w0 = malloc(sizeof(double)*ns1);
+    s->ns   = ns;
+    s->hess = H->val;
+    s->hk   = malloc(sizeof(int)*ns1);
+    s->hx   = malloc(sizeof(double)*ns1);
+
+    scan_rows(src, rows, cbuf, pass_hess, s);
+    for (k = 0; k < ns1*ns1; k++)
+        H->val[k] /= s->m;
+
+    /* d = -(H+|g|*I)\g, g = gradient on the support and the intercept */
+    for (j = 0; j < s->n; j++)
+    {
+        if ((k = s->pos[j]) < 0) continue;
+        w0[k] = s->w[j];
+        d[k]  = -(s->gbar[j] + ((s->w[j] > 0) ? s->lambda : -s->lambda));
+    }
+    d[ns] = -s->gbar_v;
+    mu = dmat_norm2(ns1, d);
+    for (k = 0; k < ns1; k++)
+        H->val[k*ns1+k] += mu;
+    dmat_posv(H, d);
+    gd = 0.0;
+    for (j = 0; j < s->n; j++)
+        if ((k = s->pos[j]) >= 0)
+            gd += (s->gbar[j] + ((w0[k] > 0) ? s->lambda : -s->lambda))*d[k];
+    gd += s->gbar_v*d[ns];
+
+    c0  = s->c;
+    ret = FALSE;
+    t   = 1.0;
+    for (it = 0; it < MAX_LS_ITER && gd < 0.0; it++)
+    {
+        for (j = 0; j < s->n; j++)
+        {
+            double wj;
+
+            if ((k = s->pos[j]) < 0) continue;
+            wj = w0[k] + t*d[k];
+            if ((wj > 0.0) != (w0[k] > 0.0)) wj = 0.0;
+            s->w[j]  = wj;
+            s->ws[j] = (s->std) ? wj/s->std[j] : wj;
+        }
+        s->c = c0 + t*d[ns];
+
+        s->loss = 0.0;
+        scan_rows(src, rows, cbuf, pass_loss, s);
+        pnew = s->loss/s->m + s->lambda*dmat_norm1(s->n, s->w);
+        if (pnew <= pobj + ALPHA*t*gd)
+        {
+            ret = TRUE;
+            break;
+        }
+        t *= BETA;
+    }
+    if (ret)
+    {
+        s->v = s->c;
+        if (s->avg) s->v += dmat_dot(s->n, s->avg, s->ws);
+    }
+    else
+    {
+        for (j = 0; j < s->n; j++)
+            if ((k = s->pos[j]) >= 0) s->w[j] = w0[k];
+    }
+    update_scaled(s);
+
+    free(s->hk);
+    free(s->hx);
+    free(w0);
+    free(d);
+    dmat_free(H);
+    s->hess = NULL;
+
+    return ret;
+}
+
+
+/*
+ *  Estimates the Lipschitz constant of the average loss gradient
+ *  by power iteration on the scaled rows of one chunk, in the
+ *  coordinates of the SAGA pass.
+ */
+static double estimate_lipschitz(const chunk_t *c, saga_t *s)
+{
+    int i, it, rows;
+    double nrm, u0, y, sum;
+    double *u, *tmp;
+
+    rows = c->r1-c->r0;
+    u    = malloc(sizeof(double)*s->n);
+    tmp  = malloc(sizeof(double)*s->n);
+    dmat_vset(s->n, 1.0/sqrt(s->n+1.0), u);
+    u0   = 1.0/sqrt(s->n+1.0);
+    nrm  = 0.0;
+
+    for (it = 0; it < POWER_ITER; it++)
+    {
+        /* tmp = u./std */
+        if (s->std) dmat_elemdivi(s->n, u, s->std, tmp);
+        else        dmat_vcopy(s->n, u, tmp);
+
+        /* (u, u0) := [X/std 1]'*[X/std 1]*(u, u0) */
+        dmat_vset(s->n, 0.0, s->raw);
+        sum = 0.0;
+        for (i = 0; i < rows; i++)
+        {
+            y = row_dot(c, s->n, i, tmp) + u0;
+            row_axpy(c, s->n, i, y, s->raw);
+            sum += y;
+        }
+        if (s->std) dmat_elemdivi(s->n, s->raw, s->std, u);
+        else        dmat_vcopy(s->n, s->raw, u);
+        u0  = sum;
+
+        nrm = sqrt(dmat_dot(s->n, u, u) + u0*u0);
+        if (nrm == 0.0) break;
+        dmat_waxpby(s->n, 1.0/nrm, u, 0.0, NULL, u);
+        u0 /= nrm;
+    }
+    dmat_vset(s->n, 0.0, s->raw);
+    free(tmp);
+    free(u);
+
+    /* f'' <= 1/4 */
+    return nrm/(4.0*rows);
+}
+
+
+static void print_progress(const int epoch, const double gap,
+                           const double pobj, const double dobj,
+                           const double gamma)
+{
+    fprintf(stderr,"%5d %15.5e %15.5e %15.5e %11.3e\n",
+            epoch, gap, pobj, dobj, gamma);
+}
+
+
+/*
+ *  Common part of l1_logreg_train_saga and l1_logreg_train_stream.
+ */
+static int train_saga(const row_source_t *src, double lambda, const int rflag,
+                      train_opts to, const int batch, double *initial_x,
+                      double *sol, double *lambda_max, int *total_epochs)
+{
+    int i, j, m, n, epoch, rows, pos, status;
+    int changed, failed, newton;
+    int *supp;
+    double pobj, dobj, pobj_prev, gap, lrow, lbatch, lfull, maxAnu, bnu, scale;
+    chunk_t cbuf[2];
+    saga_t  s;
+
+    m    = src->m;
+    n    = src->n;
+    rows = max(1, min(batch, m));
+
+    memset(cbuf, 0, sizeof(cbuf));
+    memset(&s, 0, sizeof(s));
+    s.m      = m;
+    s.n      = n;
+    s.b      = src->b;
+    s.w      = malloc(sizeof(double)*n);
+    s.ws     = malloc(sizeof(double)*n);
+    s.w_prev = malloc(sizeof(double)*n);
+    s.gbar   = malloc(sizeof(double)*n);
+    s.raw    = malloc(sizeof(double)*n);
+    s.colsum = malloc(sizeof(double)*n);
+    s.alpha  = malloc(sizeof(double)*m);
+    s.last   = calloc(n, sizeof(int));
+    s.pos    = malloc(sizeof(int)*n);
+    supp     = calloc(n, sizeof(int));
+
+    /*
+     *  Column statistics (same as standardize_data).
+     */
+    dmat_vset(n, 0.0, s.raw);
+    dmat_vset(n, 0.0, s.gbar);
+    scan_rows(src, max(rows, CHUNK_ROWS), cbuf, pass_stats, &s);
+    dmat_vcopy(n, s.raw, s.colsum);
+    if (to.sflag == TRUE)
+    {
+        s.avg = malloc(sizeof(double)*n);
+        s.std = malloc(sizeof(double)*n);
+        for (j = 0; j < n; j++)
+        {
+            s.avg[j] = s.colsum[j]/m;
+            s.std[j] = sqrt(max(0.0, s.gbar[j] - m*s.avg[j]*s.avg[j])/(m-1));
+            if (s.std[j] < 1.0e-20) s.std[j] = 1;
+        }
+    }
+
+    /*
+     *  Step size 1/(3L) for mini-batch SAGA, where L interpolates between
+     *  the row norms and the curvature of the full average. The average
+     *  row norm is used instead of the largest one, which is far too
+     *  conservative for rare features; the step is adapted during the
+     *  iterations anyway.
+     */
+    lrow = 1.0;
+    for (j = 0; j < n; j++)
+    {
+        /* gbar holds the column sums of squares here */
+        if (s.std)
+            lrow += s.gbar[j]/(s.std[j]*s.std[j]*m);
+        else
+            lrow += s.gbar[j]/m;
+    }
+    lrow /= 4.0;
+
+    dmat_vset(n, 0.0, s.raw);
+    chunk_fetch(src, 0, min(m, max(rows, CHUNK_ROWS)), &cbuf[0]);
+    lfull  = min(lrow, L_SAFETY*estimate_lipschitz(&cbuf[0], &s));
+    lbatch = (m > 1) ? ((double)(m-rows)/(rows*(m-1.0)))*lrow
+                     + ((double)m*(rows-1)/(rows*(m-1.0)))*lfull
+                     : lrow;
+    s.gamma = 1.0/(3.0*lbatch);
+
+    /*
+     *  Initial point: w = 0 and the optimal intercept,
+     *  where lambda_max is also found.
+     */
+    pos = 0;
+    for (i = 0; i < m; i++)
+        if (s.b[i] > 0) pos++;
+
+    if (initial_x != NULL)
+    {
+        s.v = initial_x[0];
+        dmat_vcopy(n, initial_x+1, s.w);
+    }
+    else
+    {
+        s.v = log((double)pos/(m-pos));
+        dmat_vset(n, 0.0, s.w);
+    }
+
+    if (lambda_max != NULL || rflag)
+    {
+        double v0, lmax;
+
+        /* gradient at w = 0 (w is kept in gbar meanwhile) */
+        v0  = s.v;
+        dmat_vcopy(n, s.w, s.gbar);
+        s.v = log((double)pos/(m-pos));
+        dmat_vset(n, 0.0, s.w);
+        update_scaled(&s);
+
+        s.sum = s.loss = 0.0;
+        dmat_vset(n, 0.0, s.raw);
+        scan_rows(src, max(rows, CHUNK_ROWS), cbuf, pass_full, &s);
+        scale_raw(&s, s.sum, s.raw);
+        lmax = dmat_norminf(n, s.raw)/m;
+
+        s.v = v0;
+        dmat_vcopy(n, s.gbar, s.w);
+        if (lambda_max != NULL) *lambda_max = lmax;
+        if (rflag) lambda = lambda*lmax;
+    }
+    s.lambda = lambda;
+    update_scaled(&s);
+
+    if (to.verbose_level>=2)
+    {
+        fprintf(stderr,"%s%s\n",
+                "epoch      gap          primal obj      dual obj",
+                "      step");
+    }
+
+    /*
+     *  MAIN LOOP
+     */
+    status    = STATUS_MAX_EPOCH_EXCEEDED;
+    pobj_prev = DBL_MAX;
+    failed    = FALSE;
+    newton    = FALSE;
+    dobj      = -DBL_MAX;
+    for (epoch = 0; epoch < MAX_EPOCH; epoch++)
+    {
+        /*
+         *  Full pass: objective, dual point, and fresh gradient table.
+         */
+        s.sum = s.loss = 0.0;
+        dmat_vset(n, 0.0, s.raw);
+        scan_rows(src, max(rows, CHUNK_ROWS), cbuf, pass_full, &s);
+        for (j = 0; j < n; j++)
+            s.gbar[j] = (s.std) ? s.raw[j]/(s.std[j]*m) : s.raw[j]/m;
+        s.gbar_v = s.sum/m;
+        dmat_vset(n, 0.0, s.raw);
+
+        pobj = s.loss/m + lambda*dmat_norm1(n, s.w);
+
+        /* on an increase, go back to the last epoch with a smaller step */
+        if (pobj > pobj_prev)
+        {
+            s.v = s.v_prev;
+            dmat_vcopy(n, s.w_prev, s.w);
+            update_scaled(&s);
+            s.gamma *= 0.5;
+            continue;
+        }
+        s.v_prev  = s.v;
+        dmat_vcopy(n, s.w, s.w_prev);
+        pobj_prev = pobj;
+        s.gamma  *= STEP_GROW;
+
+        /*
+         *  Dual point nu = -f'(z)/m, shifted to b'*nu = 0
+         *  and scaled to |A'*nu|_inf <= lambda (see l1_logreg_train).
+         */
+        bnu = -s.gbar_v;
+        for (j = 0; j < n; j++)
+        {
+            /* A'*nu -= (b'*nu/m)*(X/std)'*1, gbar being uncentered */
+            s.raw[j] = -s.gbar[j] - ((s.std) ? bnu*s.colsum[j]/(s.std[j]*m)
+                                             : bnu*s.colsum[j]/m);
+        }
+        maxAnu = dmat_norminf(n, s.raw);
+        dmat_vset(n, 0.0, s.raw);
+        scale  = (maxAnu > lambda) ? lambda/maxAnu : 1.0;
+        {
+            double ent = 0.0;
+            int feasible = TRUE;
+
+            for (i = 0; i < m && feasible; i++)
+            {
+                double y1, y2;
+
+                /* y1 = m*nu_i */
+                y1 = scale*(-s.b[i]*s.alpha[i] - bnu*s.b[i]);
+                y2 = 1.0 - y1;
+                if (y1 < 0.0 || y2 < 0.0)
+                    feasible = FALSE;
+                else
+                    ent -= (y1 > 0.0 && y2 > 0.0) ?
+                           y1*log(y1) + y2*log(y2) : 0.0;
+            }
+            if (feasible) dobj = max(ent/m, dobj);
+        }
+        gap = pobj - dobj;
+
+        if (to.verbose_level>=2)
+            print_progress(epoch, gap, pobj, dobj, s.gamma);
+
+        if (gap < to.tolerance)
+        {
+            status = STATUS_SOLUTION_FOUND;
+            break;
+        }
+
+        /*
+         *  Newton step after a SAGA pass, unless the last one failed
+         *  on the same support; SAGA pass otherwise.
+         */
+        changed = FALSE;
+        for (j = 0; j < n; j++)
+        {
+            if ((s.w[j] != 0.0) != supp[j]) changed = TRUE;
+            supp[j] = (s.w[j] != 0.0);
+        }
+        if (changed) failed = FALSE;
+        if (!failed && !newton)
+        {
+            newton = newton_step(src, max(rows, CHUNK_ROWS), cbuf, &s, pobj);
+            if (newton) continue;
+            failed = TRUE;
+        }
+        newton = FALSE;
+
+        scan_rows(src, rows, cbuf, pass_saga, &s);
+        saga_flush(&s);
+    }
+
+    if (sol != NULL)
+    {
+        sol[0] = s.v;
+        dmat_vcopy(n, s.w, sol+1);
+
+        /* if standardized, sol = coeff/std */
+        if (to.sflag == TRUE && to.cflag == FALSE)
+        {
+            dmat_elemdivi(n, sol+1, s.std, sol+1);
+            sol[0] -= dmat_dot(n, s.avg, sol+1);
+        }
+    }
+    if (initial_x != NULL)
+    {
+        initial_x[0] = s.v;
+        dmat_vcopy(n, s.w, initial_x+1);
+    }
+    if (total_epochs) *total_epochs = epoch;
+
+    /* free memory */
+    if (src->bs != NULL)
+    {
+        free(cbuf[0].jbuf); free(cbuf[0].vbuf);
+        free(cbuf[1].jbuf); free(cbuf[1].vbuf);
+    }
+    if (s.avg) free(s.avg);
+    if (s.std) free(s.std);
+    free(s.w);
+    free(s.ws);
+    free(s.w_prev);
+    free(s.gbar);
+    free(s.raw);
+    free(s.colsum);
+    free(s.alpha);
+    free(s.last);
+    free(s.pos);
+    free(supp);
+
+    return status;
+}
+
+
+/** \brief Solve an l1-regularized logistic regression problem with the
+ *         mini-batch proximal SAGA method.
+ *
+ *  Same problem and options as l1_logreg_train. The rows of X are
+ *  visited in order, batch rows at a time.
+ *
+ *  @param  X               feature matrix
+ *  @param  b               class vector
+ *  @param  lambda          regularization parameter
+ *  @param  to              training options (tolerance: duality gap)
+ *  @param  batch           number of rows per mini-batch
+ *  @param  initial_x       initial point (v, w) of length n+1, updated
+ *                          with the solution in internal coordinates
+ *                          (NULL: w = 0 and the optimal intercept)
+ *  @param  sol             solution (intercept + coefficients)
+ *  @param  total_epochs    number of epochs
+ *
+ *  @return                 STATUS_SOLUTION_FOUND or
+ *                          STATUS_MAX_EPOCH_EXCEEDED
+ */
+int l1_logreg_train_saga(dmatrix *X, double *b, double lambda, train_opts to,
+                         int batch, double *initial_x, double *sol,
+                         int *total_epochs)
+{
+    row_source_t src;
+
+    src.m  = X->m;
+    src.n  = X->n;
+    src.b  = b;
+    src.X  = X;
+    src.bs = NULL;
+
+    return train_saga(&src, lambda, FALSE, to, batch, initial_x, sol,
+                      NULL, total_epochs);
+}
+
+
+/** \brief Solve an l1-regularized logistic regression problem with the
+ *         mini-batch proximal SAGA method, streaming the rows from a
+ *         binary feature file.
+ *
+ *  Only O(m+n) memory and two chunks of rows are used, so the file may be
+ *  larger than the memory. The file must contain the class vector.
+ *
+ *  @param  file            binary feature file
+ *  @param  lambda          regularization parameter
+ *  @param  rflag           if TRUE, lambda := lambda*lambda_max
+ *  @param  to              training options (tolerance: duality gap)
+ *  @param  batch           number of rows per mini-batch
+ *  @param  sol             solution (intercept + coefficients), length n+1
+ *  @param  lambda_max      lambda_max of the problem (may be NULL)
+ *  @param  total_epochs    number of epochs
+ *
+ *  @return                 STATUS_SOLUTION_FOUND or
+ *                          STATUS_MAX_EPOCH_EXCEEDED
+ */
+int l1_logreg_train_stream(const char *file, double lambda, int rflag,
+                           train_opts to, int batch, double *sol,
+                           double *lambda_max, int *total_epochs)
+{
+    row_source_t src;
+    int ret;
+
+    bin_stream_open(file, &src.bs);
+    src.m  = src.bs->m;
+    src.n  = src.bs->n;
+    src.b  = src.bs->b;
+    src.X  = NULL;
+
+    ret = train_saga(&src, lambda, rflag, to, batch, NULL, sol,
+                     lambda_max, total_epochs);
+
+    bin_stream_close(src.bs);
+    return ret;
+}
@@ -0,0 +1,450 @@
+/** \file   score.c
+ *  \brief  Compiled models and batched scoring.
+ *
+ *  l1_logreg_classify scores a whole data set against one model with
+ *  dmat_yAx. For online use the situation is the opposite: a small batch
+ *  of examples has to be scored against many sparse models at once.
+ *
+ *  A compiled model set keeps only the non-zero coefficients of all
+ *  models, grouped by feature (feature-major). Each non-zero entry of an
+ *  example is looked up once and then updates the scores of all models
+ *  that use the feature. Features are reindexed to the features used by
+ *  any model; the lookup is a binary search in that list, or, when the
+ *  optional bitmap is built, a bit test plus a rank count (O(1), n/8
+ *  bytes of memory). A feature used by a good part of the models
+ *  (DENSE_RATIO) is stored densely, with zeros, so that its update is a
+ *  contiguous axpy over all the models instead of a scatter.
+ *
+ *  The scores of a block of rows are turned into probabilities by a
+ *  branch-free sigmoid that the compiler can vectorize.
+ */
+
+#if HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#if defined(_MSC_VER)
+    typedef unsigned __int64 u64_t;
+#else
+    #include <stdint.h>
+    typedef uint64_t u64_t;
+#endif
+
+#include "def.h"
+#include "dmatrix.h"
+#include "l1_logreg.h"
+
+#define SCORE_BLOCK     64      /* rows per block (sigmoid, threads)    */
+#define OMP_MIN_WORK    65536   /* rows*models to go multithreaded      */
+#define DENSE_RATIO     4       /* dense if used by 1/DENSE_RATIO models */
+
+/* constants of the logistic function, see vsigmoid */
+#define ABS_MASK        0x7FFFFFFFFFFFFFFFULL
+#define ONE_BITS        0x3FF0000000000000ULL   /* 1.0   */
+#define EXP_MAX_BITS    0x4086200000000000ULL   /* 708.0 */
+#define INF_BITS        0x7FF0000000000000ULL   /* inf   */
+#define LOG2E           1.4426950408889634
+#define LN2_HI          6.93147180369123816490e-01
+#define LN2_LO          1.90821492927058770002e-10
+
+
+/*
+ *  Row of the model source: either a row of a matrix (sparse or dense)
+ *  or one of the solution vectors. jdx == NULL means dense (len = n+1).
+ */
+static void model_row(const dmatrix *S, double *const *sol, const int n,
+                      const int k, int *len, const int **jdx,
+                      const double **val)
+{
+    if (S == NULL)
+    {
+        *len = n+1;
+        *jdx = NULL;
+        *val = sol[k];
+    }
+    else if (S->nz >= 0)
+    {
+        *len = S->rdx[k+1]-S->rdx[k];
+        *jdx = S->jdx+S->rdx[k];
+        *val = S->val+S->rdx[k];
+    }
+    else
+    {
+        *len = n+1;
+        *jdx = NULL;
+        *val = S->val+(size_t)k*(n+1);
+    }
+}
+
+
+static int popcount32(unsigned int w)
+{
+#if defined(__GNUC__)
+    return __builtin_popcount(w);
+#else
+    w = w - ((w >> 1) & 0x55555555u);
+    w = (w & 0x33333333u) + ((w >> 2) & 0x33333333u);
+    w = (w + (w >> 4)) & 0x0F0F0F0Fu;
+    return (int)((w * 0x01010101u) >> 24);
+#endif
+}
+
+
+static l1_model *compile(const int nmodel, const int n, const dmatrix *S,
+                         double *const *sol, const int bflag)
+{
+    int i, j, k, l, len;
+    int *cnt, *pos;
+    const int *jdx;
+    const double *val;
+    l1_model *M;
+
+    M = malloc(sizeof(l1_model));
+    M->n      = n;
+    M->nmodel = nmodel;
+    M->bias   = malloc(sizeof(double)*(nmodel > 0 ? nmodel : 1));
+
+    /* count the non-zero coefficients of each feature */
+    cnt = calloc(n+1, sizeof(int));
+    for (k = 0; k < nmodel; k++)
+    {
+        M->bias[k] = 0.0;
+        model_row(S, sol, n, k, &len, &jdx, &val);
+        for (l = 0; l < len; l++)
+        {
+            j = (jdx != NULL) ? jdx[l] : l;
+            if (j == 0)
+                M->bias[k] = val[l];
+            else if (val[l] != 0.0)
+                cnt[j]++;
+        }
+    }
+
+    /* reindex to the used features */
+    M->nfeat = 0;
+    for (j = 1; j <= n; j++)
+    {
+        if (cnt[j] == 0) continue;
+        if (cnt[j]*DENSE_RATIO >= nmodel) cnt[j] = nmodel;
+        M->nfeat++;
+    }
+
+    M->feat = malloc(sizeof(int)*(M->nfeat > 0 ? M->nfeat : 1));
+    M->fdx  = malloc(sizeof(int)*(M->nfeat+1));
+    M->fdx[0] = 0;
+    for (i = 0, j = 1; j <= n; j++)
+    {
+        if (cnt[j] == 0) continue;
+        M->feat[i] = j-1;
+        M->fdx[i+1] = M->fdx[i]+cnt[j];
+        i++;
+    }
+    M->nz  = M->fdx[M->nfeat];
+    M->mdx = malloc(sizeof(int)*(M->nz > 0 ? M->nz : 1));
+    M->val = malloc(sizeof(double)*(M->nz > 0 ? M->nz : 1));
+
+    /* fill, in increasing model order within each feature */
+    pos = malloc(sizeof(int)*(n+1));
+    for (i = 0; i < M->nfeat; i++)
+    {
+        j = M->feat[i]+1;
+        pos[j] = M->fdx[i];
+        if (cnt[j] < nmodel) continue;
+        for (k = 0; k < nmodel; k++)
+        {
+            M->mdx[pos[j]+k] = k;
+            M->val[pos[j]+k] = 0.0;
+        }
+    }
+    for (k = 0; k < nmodel; k++)
+    {
+        model_row(S, sol, n, k, &len, &jdx, &val);
+        for (l = 0; l < len; l++)
+        {
+            j = (jdx != NULL) ? jdx[l] : l;
+            if (j == 0 || val[l] == 0.0) continue;
+            if (cnt[j] == nmodel)
+                M->val[pos[j]+k] = val[l];
+            else
+            {
+                M->mdx[pos[j]] = k;
+                M->val[pos[j]] = val[l];
+                pos[j]++;
+            }
+        }
+    }
+    free(pos);
+    free(cnt);
+
+    /* optional bitmap of the used features, with a rank directory */
+    M->bits = NULL;
+    M->rank = NULL;
+    if (bflag == TRUE)
+    {
+        int nw = (n+31)/32;
+
+        M->bits = calloc(nw > 0 ? nw : 1, sizeof(unsigned int));
+        M->rank = malloc(sizeof(int)*(nw > 0 ? nw : 1));
+        for (i = 0; i < M->nfeat; i++)
+            M->bits[M->feat[i] >> 5] |= 1u << (M->feat[i] & 31);
+        for (i = 0, l = 0; i < nw; i++)
+        {
+            M->rank[i] = l;
+            l += popcount32(M->bits[i]);
+        }
+    }
+    return M;
+}
+
+
+/** \brief  Compiles the models stored in the rows of a matrix.
+ *
+ *  Row k of S is the k-th model, i.e., intercept followed by the
+ *  n coefficients, as in the (transposed) model file of regpath.
+ *
+ *  @param  S       model matrix (sparse or dense), (nmodel x n+1).
+ *  @param  bflag   build the feature bitmap if TRUE.
+ *  @return compiled models, to be freed by l1_model_free.
+ */
+l1_model *l1_model_compile(const dmatrix *S, const int bflag)
+{
+    return compile(S->m, S->n-1, S, NULL, bflag);
+}
+
+
+/** \brief  Compiles models given as solution vectors.
+ *
+ *  @param  nmodel  number of models.
+ *  @param  n       number of features.
+ *  @param  sol     array of nmodel solutions (intercept+coefficients).
+ *  @param  bflag   build the feature bitmap if TRUE.
+ *  @return compiled models, to be freed by l1_model_free.
+ */
+l1_model *l1_model_compile_vec(const int nmodel, const int n,
+                               double *const *sol, const int bflag)
+{
+    return compile(nmodel, n, NULL, sol, bflag);
+}
+
+
+/** \brief  Frees compiled models. */
+void l1_model_free(l1_model *M)
+{
+    if (M == NULL) return;
+    free(M->bias);
+    free(M->feat);
+    free(M->fdx);
+    free(M->mdx);
+    free(M->val);
+    if (M->bits) free(M->bits);
+    if (M->rank) free(M->rank);
+    free(M);
+}
+
+
+/* index of feature j among the used features, -1 if unused */
+static int lookup(const l1_model *M, const int j)
+{
+    if (M->bits != NULL)
+    {
+        unsigned int w = M->bits[j >> 5];
+        unsigned int b = 1u << (j & 31);
+
+        if ((w & b) == 0) return -1;
+        return M->rank[j >> 5] + popcount32(w & (b-1));
+    }
+    else
+    {
+        int lo = 0, hi = M->nfeat-1, mid;
+
+        while (lo <= hi)
+        {
+            mid = (lo+hi)/2;
+            if (M->feat[mid] < j)
+                lo = mid+1;
+            else if (M->feat[mid] > j)
+                hi = mid-1;
+            else
+                return mid;
+        }
+        return -1;
+    }
+}
+
+
+/*
+ *  Logistic function, z <- 1/(1+exp(-z)), written without calls,
+ *  branches and floating point comparisons so that the loop vectorizes.
+ *  With e = exp(-|z|), it is 1/(1+e) for z >= 0 and e/(1+e) for z < 0.
+ *  e = 2^-k exp(-r) with k = round(|z|/log 2) and |r| <= log(2)/2,
+ *  exp(-r) by its Taylor polynomial of degree 12 (relative error < 1e-15)
+ *  and 2^-k built from the exponent bits. |z| is clipped to 708 (by its
+ *  bits, as the order of non-negative doubles is that of their bits),
+ *  where the logistic function is 0 or 1 up to 1e-307. A NaN (bits of
+ *  |z| above those of inf) is passed through, as by 1/(1+exp(-z)).
+ */
+static void vsigmoid(const int len, double *z)
+{
+    int i;
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+    #pragma omp simd
+#endif
+    for (i = 0; i < len; i++)
+    {
+        double a, k, r, p;
+        u64_t nan;
+        union { double d; u64_t u; } x, y, e, w, s;
+
+        x.d = z[i];
+        y.u = x.u & ABS_MASK;
+        nan = (u64_t)(y.u > INF_BITS);
+        y.u = (y.u < EXP_MAX_BITS) ? y.u : EXP_MAX_BITS;
+        a = y.d;
+        k = (double)(int)(a*LOG2E + 0.5);
+        r = (k*LN2_HI - a) + k*LN2_LO;
+
+        p = 1.0/479001600.0;
+        p = p*r + 1.0/39916800.0;
+        p = p*r + 1.0/3628800.0;
+        p = p*r + 1.0/362880.0;
+        p = p*r + 1.0/40320.0;
+        p = p*r + 1.0/5040.0;
+        p = p*r + 1.0/720.0;
+        p = p*r + 1.0/120.0;
+        p = p*r + 1.0/24.0;
+        p = p*r + 1.0/6.0;
+        p = p*r + 0.5;
+        p = p*r + 1.0;
+        p = p*r + 1.0;
+
+        e.u = (u64_t)(1023 - (int)k) << 52;
+        e.d *= p;
+
+        /* w = 1 if z >= 0, e otherwise */
+        w.u = ONE_BITS ^ ((x.u >> 63) * (ONE_BITS ^ e.u));
+        s.d = w.d/(1.0 + e.d);
+
+        /* z if z is NaN, s otherwise */
+        s.u ^= nan * (s.u ^ x.u);
+        z[i] = s.d;
+    }
+}
+
+
+/* acc += x*(coefficients of used feature k) */
+static void update(const l1_model *M, const int k, const double x,
+                   double *acc)
+{
+    int e, e0, e1;
+    const int    *mdx = M->mdx;
+    const double *val = M->val;
+
+    e0 = M->fdx[k];
+    e1 = M->fdx[k+1];
+    if (e1-e0 == M->nmodel)     /* dense */
+    {
+        val += e0;
+#if defined(_OPENMP) && _OPENMP >= 201307
+        #pragma omp simd
+#endif
+        for (e = 0; e < e1-e0; e++)
+            acc[e] += x*val[e];
+    }
+    else
+    {
+        for (e = e0; e < e1; e++)
+            acc[mdx[e]] += x*val[e];
+    }
+}
+
+
+/* scores of rows r0 <= i < r1, res is ((r1-r0) x nmodel) */
+static void score_block(const l1_model *M, const dmatrix *X,
+                        const int r0, const int r1, double *res)
+{
+    int i, k, l, nmodel;
+    double *acc, x;
+
+    nmodel = M->nmodel;
+    for (i = r0; i < r1; i++)
+    {
+        acc = res+(size_t)(i-r0)*nmodel;
+        memcpy(acc, M->bias, sizeof(double)*nmodel);
+
+        if (X->nz >= 0)
+        {
+            for (l = X->rdx[i]; l < X->rdx[i+1]; l++)
+            {
+                if ((k = lookup(M, X->jdx[l])) < 0) continue;
+                update(M, k, X->val[l], acc);
+            }
+        }
+        else
+        {
+            const double *row = X->val+(size_t)i*X->n;
+
+            for (k = 0; k < M->nfeat; k++)
+            {
+                if ((x = row[M->feat[k]]) == 0.0) continue;
+                update(M, k, x, acc);
+            }
+        }
+    }
+}
+
+
+/** \brief  Scores a batch of examples against compiled models.
+ *
+ *  @param  M       compiled models.
+ *  @param  X       feature matrix (sparse or dense).
+ *  @param  r0      first row of the batch.
+ *  @param  r1      one past the last row of the batch.
+ *  @param  mode    SCORE_MARGIN (intercept + x'w),
+ *                  SCORE_SIGN (predicted class, +1 or -1) or
+ *                  SCORE_PROB (probability of class +1).
+ *  @param  result  ((r1-r0) x nmodel) scores, row-major,
+ *                  i.e., result[(i-r0)*nmodel+k] for row i and model k.
+ *  @return STATUS_OK or STATUS_ERROR.
+ */
+int l1_model_score(const l1_model *M, const dmatrix *X, const int r0,
+                   const int r1, const int mode, double *result)
+{
+    int nblk, b;
+
+    if (M == NULL || X == NULL || result == NULL || X->n != M->n ||
+        r0 < 0 || r1 > X->m || r0 > r1)
+        return STATUS_ERROR;
+
+    nblk = (r1-r0+SCORE_BLOCK-1)/SCORE_BLOCK;
+
+#pragma omp parallel for schedule(static) \
+        if ((double)(r1-r0)*M->nmodel >= OMP_MIN_WORK && nblk > 1)
+    for (b = 0; b < nblk; b++)
+    {
+        int i0, i1, len, i;
+        double *res;
+
+        i0  = r0+b*SCORE_BLOCK;
+        i1  = min(i0+SCORE_BLOCK, r1);
+        len = (i1-i0)*M->nmodel;
+        res = result+(size_t)(i0-r0)*M->nmodel;
+
+        score_block(M, X, i0, i1, res);
+        if (mode == SCORE_PROB)
+            vsigmoid(len, res);
+        else if (mode == SCORE_SIGN)
+            for (i = 0; i < len; i++)
+                res[i] = (res[i] < 0) ? -1.0 : 1.0;
+    }
+    return STATUS_OK;
+}
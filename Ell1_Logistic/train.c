@@ -15,6 +15,7 @@
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "unistd.h"
 
 #ifdef Rpackage
@@ -121,6 +122,12 @@ static void usage(char *package, char *version)
 "       -k <double>         - set tolerance for zero coefficients from KKT\n",
 "                             condition\n",
 "       -t <double>         - set tolerance for duality gap\n",
+"       -m <int>            - use the mini-batch (proximal SAGA) solver with\n",
+"                             <int> rows per batch. If feature_file is a\n",
+"                             binary file with the class vector, its rows\n",
+"                             are streamed from disk (out-of-core) and\n",
+"                             class_file is not read.\n",
+"                             Best used with -s, and a larger -t.\n",
 "\n",
 NULL,
     };
@@ -134,6 +141,7 @@ NULL,
 
 static void parse_command_line_args(int argc, char *argv[], double *lambda,
                                     train_opts *to, int *rflag, int *hflag,
+                                    int *batch,
                                     char **ifile_x, char **ifile_y, char **ofile)
 {
     int  c;
@@ -147,8 +155,9 @@ static void parse_command_line_args(int argc, char *argv[], double *lambda,
     to->ktolerance    = 0.999;
     *rflag            = FALSE;
     *hflag            = FALSE;
+    *batch            = 0;
 
-    while ((c = getopt(argc, argv, "hk:qrst:v:")) != -1)
+    while ((c = getopt(argc, argv, "hk:m:qrst:v:")) != -1)
     {
         switch (c)
         {
@@ -156,6 +165,7 @@ static void parse_command_line_args(int argc, char *argv[], double *lambda,
         case 'r': *rflag            = TRUE;         break;
         case 's': to->sflag         = TRUE;         break;
         case 'k': to->ktolerance    = atof(optarg); break;
+        case 'm': *batch            = atoi(optarg); break;
         case 't': to->tolerance     = atof(optarg); break;
         case 'v': to->verbose_level = atoi(optarg); break;
         case 'q': quiet             = TRUE;         break;
@@ -183,7 +193,8 @@ static void parse_command_line_args(int argc, char *argv[], double *lambda,
 #endif
 
 
-void show_status(int verbose_level, int ret, int total_nt, int total_pcg)
+void show_status(int verbose_level, int ret, int total_nt, int total_pcg,
+                 int batch)
 {
 
     if (verbose_level>=2)
@@ -199,11 +210,17 @@ void show_status(int verbose_level, int ret, int total_nt, int total_pcg)
         case STATUS_MAX_LS_ITER_EXCEEDED:
             fprintf(stderr,"MAX_LS_ITER exceeded in linesearch.\n\n");
             break;
+        case STATUS_MAX_EPOCH_EXCEEDED:
+            fprintf(stderr,"MAX_EPOCH exceeded.\n\n");
+            break;
         default:
             fprintf(stderr,"no case.\n");
             exit(EXIT_SUCCESS);
         }
-        fprintf(stderr,"    [NT  iterations]    %10d\n",total_nt);
+        if (batch > 0)
+            fprintf(stderr,"    [epochs]            %10d\n",total_nt);
+        else
+            fprintf(stderr,"    [NT  iterations]    %10d\n",total_nt);
         if (total_pcg >= 0)
             fprintf(stderr,"    [PCG iterations]    %10d\n",total_pcg);
         fprintf(stderr,"\n");
@@ -257,6 +274,7 @@ static void convert_Rdata(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx,
         X->jdx = NULL;
         X->rdx = NULL;
     }
+    dmat_init_aux(X);
     *matX   = X;
 }
 
@@ -290,6 +308,60 @@ static SEXP create_Rdata_to_return(const int n, const double lambda, const doubl
 }
 #endif
 
+#ifndef Rpackage
+/*
+ *  Solves the problem with the mini-batch solver, streaming the rows
+ *  of a binary feature file instead of reading it into memory.
+ */
+static int train_stream(char *ifile_x, double lambda, int rflag,
+                        train_opts to, int batch, char *ofile)
+{
+    bin_stream_t *bs;
+    double  *solution;
+    double  lambda_max;
+    clock_t clock_sol, clock_wri, clock_end;
+    int     m, n, total_epochs, ret;
+
+    /* sizes only */
+    bin_stream_open(ifile_x, &bs);
+    m = bs->m;
+    n = bs->n;
+    bin_stream_close(bs);
+
+    if (to.verbose_level>=2)
+        fprintf(stderr,"\nStreaming data (%d examples x %d features)...\n\n",
+                m, n);
+
+    solution = malloc(sizeof(double)*(n+1));
+
+    clock_sol = clock();
+    ret = l1_logreg_train_stream(ifile_x, lambda, rflag, to, batch,
+                                 solution, &lambda_max, &total_epochs);
+    if (rflag) lambda = lambda*lambda_max;
+
+    show_status(to.verbose_level, ret, total_epochs, -1, batch);
+
+    clock_wri = clock();
+    if (ofile != NULL)
+    {
+        char linebf[BUFFER_SIZE];
+        sprintf(linebf, comment1,ifile_x, PACKAGE_NAME, VERSION);
+        write_mm_vector(ofile, n+1, solution, linebf, TYPE_E);
+    }
+    clock_end = clock();
+    if (to.verbose_level>=2)
+        summary_time(clock_sol,clock_sol,clock_wri,clock_end);
+
+    if (to.verbose_level==1)
+        summary_all(m, n, lambda, lambda_max, clock_wri-clock_sol,
+                    total_epochs, -1, solution+1);
+    free(solution);
+
+    return EXIT_SUCCESS;
+}
+#endif
+
+
 /*
  *  Standardize data and solve l_1-regularized logistic regression problem
  *  by calling l1_logreg().
@@ -315,6 +387,7 @@ SEXP trainR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx, SEXP prdx,
     char *ifile_x, *ifile_y, *ofile;
     int  rflag;             /* relative lambda flag */
     int  hflag;             /* histogram & threshold flag */
+    int  batch;             /* mini-batch size, 0: interior-point method */
 
     double  lambda_max;
     clock_t clock_pre, clock_sol, clock_wri, clock_end;
@@ -324,9 +397,15 @@ SEXP trainR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx, SEXP prdx,
     clock_pre = clock();
 
 #ifndef Rpackage
-    parse_command_line_args(argc, argv, &lambda, &to, &rflag, &hflag,
+    parse_command_line_args(argc, argv, &lambda, &to, &rflag, &hflag, &batch,
                                         &ifile_x, &ifile_y, &ofile);
 
+    /* stream only when the binary file carries its own class vector,
+       otherwise the class file is read and the matrix is kept in memory */
+    if (batch > 0 && strcmp(ifile_x, "-") != 0 &&
+        is_bin_file_labeled(ifile_x))
+        return train_stream(ifile_x, lambda, rflag, to, batch, ofile);
+
     /* read data file */
     if (to.verbose_level>=2) fprintf(stderr,"\nReading data...\n\n");
     read_mm_new_matrix(ifile_x, &matX);
@@ -334,6 +413,7 @@ SEXP trainR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx, SEXP prdx,
 #else
     convert_Rdata(pm,pn,pnz,pval,pjdx,prdx,pb,plambda,pqflag,prflag,psflag,
           phflag,pvval,ptol,pktol,&matX,&b,&lambda,&to,&hflag,&rflag);
+    batch = 0;
 #endif
 
     lambda_max = find_lambdamax(matX, b, to.sflag);
@@ -349,15 +429,24 @@ SEXP trainR(SEXP pm, SEXP pn, SEXP pnz, SEXP pval, SEXP pjdx, SEXP prdx,
     if (to.verbose_level>=2) fprintf(stderr,"Running solver...\n");
     clock_sol = clock();
 
-    ret = l1_logreg_train(matX, b, lambda, to, NULL, NULL,
-                          solution, &total_nt, &total_pcg);
+    if (batch > 0)
+    {
+        ret = l1_logreg_train_saga(matX, b, lambda, to, batch, NULL,
+                                   solution, &total_nt);
+        total_pcg = -1;
+    }
+    else
+    {
+        ret = l1_logreg_train(matX, b, lambda, to, NULL, NULL,
+                              solution, &total_nt, &total_pcg);
+    }
 
     //dmat_profile();
     
     /* show status */
     if (matX->nz < 0) total_pcg = -1;
 
-    show_status(to.verbose_level, ret, total_nt, total_pcg);
+    show_status(to.verbose_level, ret, total_nt, total_pcg, batch);
 
     /* write solution */
     clock_wri = clock();
@@ -13,6 +13,14 @@
 #include <limits.h>
 #include <float.h>
 
+#ifndef _WIN32
+    #include <sys/stat.h>
+    #include <sys/mman.h>
+#else
+    #include <io.h>
+    #include <fcntl.h>
+#endif
+
 #include "mmio.h"
 #include "def.h"
 #include "util.h"
@@ -20,6 +28,12 @@
 #include "l1_logreg.h"
 #include "dmatrix.h"
 
+#ifndef Rpackage
+    #include "blas.h"
+#else
+    #include <R_ext/BLAS.h>
+#endif
+
 
 /** \brief Returns the maximum value of the regularization parameter lambda
  *         that gives a non-zero solution.
@@ -92,6 +106,65 @@ double find_lambdamax(const dmatrix *X, const double *b, const int sflag)
 }
 
 
+/** \brief Computes the gradient of the average logistic loss with respect
+ *         to the coefficients.
+ *
+ *  The loss is evaluated at the solver variables x = (v, w) of
+ *  l1_logreg_train, i.e., w is expressed in standardized coordinates
+ *  when avg and std are given. For a coefficient w_j = 0 the
+ *  optimality (KKT) condition reads |grad_j| <= lambda.
+ *
+ *  @param  X       feature matrix (not standardized)
+ *  @param  b       class vector
+ *  @param  avg     column average (NULL if not standardized)
+ *  @param  std     column standard deviation (NULL if not standardized)
+ *  @param  x       intercept and coefficients (v, w), length n+1
+ *  @param  grad    gradient with respect to w, length n
+ */
+void find_gradient(const dmatrix *X, const double *b, const double *avg,
+                   const double *std, const double *x, double *grad)
+{
+    int i, m, n;
+    double c, sum;
+    double *tmp_m, *tmp_n;
+
+    m = X->m;
+    n = X->n;
+
+    tmp_m = malloc(m*sizeof(double));
+    tmp_n = malloc(n*sizeof(double));
+
+    /* X_std*w + v = X*(w./std) + (v - avg'*(w./std)) */
+    if (std != NULL) dmat_elemdivi(n, x+1, std, tmp_n);
+    else             dmat_vcopy(n, x+1, tmp_n);
+
+    c = x[0];
+    if (avg != NULL) c -= dmat_dot(n, avg, tmp_n);
+
+    dmat_yAx(X, tmp_n, tmp_m);
+
+    /* tmp_m = diag(b)*f'(z), z = diag(b)*(X_std*w + v) */
+    sum = 0.0;
+    for (i = 0; i < m; i++)
+    {
+        tmp_m[i] = -b[i] / (m*(1.0 + exp(b[i]*(tmp_m[i] + c))));
+        sum += tmp_m[i];
+    }
+
+    /* grad = X_std'*diag(b)*f'(z) = (X'*tmp_m - avg*sum)./std */
+    dmat_yATx(X, tmp_m, grad);
+    if (avg != NULL)
+    {
+        sum = -sum;
+        F77_CALL(daxpy)(&n, &sum, avg, &ione, grad, &ione);
+    }
+    if (std != NULL) dmat_elemdivi(n, grad, std, grad);
+
+    free(tmp_n);
+    free(tmp_m);
+}
+
+
 /** \brief Standardizes the data.
  *
  *  Standardizes the feature matrix.\n
@@ -165,9 +238,553 @@ void standardize_data(dmatrix *X, const double *b, double **average,
 }
 
 
+/*
+ *  Binary feature file.
+ *
+ *  A binary feature file holds a matrix in the layout of dmatrix so that it
+ *  can be memory-mapped instead of parsed:
+ *
+ *      header          64 bytes, see bin_header_t
+ *      rdx             (m+1) ints      (sparse only)
+ *      jdx             nz ints         (sparse only)
+ *      (padding to a multiple of 8 bytes)
+ *      val             nz doubles      (sparse), m*n doubles (dense, row major)
+ *      b               m doubles       (only if the labels flag is set)
+ *
+ *  Numbers are stored in the byte order of the machine that wrote the file.
+ *  Use mainConvert to create one from Matrix Market files.
+ */
+#define BIN_MAGIC       "L1LRBIN"
+#define BIN_VERSION     1
+
+/* 64-bit file offsets */
+#ifdef _WIN32
+    #define bin_fseek(fp, off, whence)  _fseeki64(fp, (__int64)(off), whence)
+#else
+    #define bin_fseek(fp, off, whence)  fseeko(fp, (off_t)(off), whence)
+#endif
+
+typedef struct
+{
+    char    magic[8];       /* BIN_MAGIC */
+    int     version;        /* BIN_VERSION */
+    int     m;              /* number of rows */
+    int     n;              /* number of columns */
+    int     nz;             /* number of non-zeros, -1 if dense */
+    int     labels;         /* TRUE if the class vector is stored */
+    int     reserved[9];    /* pads the header to 64 bytes */
+} bin_header_t;
+
+/* class vector of a binary file read from stdin, see read_mm_new_vector */
+static double *stdin_labels = NULL;
+
+
+/*
+ *  Computes the offsets of the arrays and returns the file size.
+ */
+static size_t bin_layout(const bin_header_t *h, size_t *off_rdx,
+                         size_t *off_jdx, size_t *off_val, size_t *off_b)
+{
+    size_t pos;
+
+    pos = sizeof(bin_header_t);
+    if (h->nz >= 0)
+    {
+        *off_rdx = pos;
+        pos += sizeof(int)*((size_t)h->m+1);
+        *off_jdx = pos;
+        pos += sizeof(int)*(size_t)h->nz;
+        pos  = (pos + 7) & ~(size_t)7;
+        *off_val = pos;
+        pos += sizeof(double)*(size_t)h->nz;
+    }
+    else
+    {
+        *off_rdx = 0;
+        *off_jdx = 0;
+        *off_val = pos;
+        pos += sizeof(double)*(size_t)h->m*(size_t)h->n;
+    }
+    *off_b = (h->labels) ? pos : 0;
+    if (h->labels) pos += sizeof(double)*(size_t)h->m;
+
+    return pos;
+}
+
+
+static void bin_check_header(const bin_header_t *h, const char *file)
+{
+    if (memcmp(h->magic, BIN_MAGIC, sizeof(BIN_MAGIC)) != 0)
+    {
+        fprintf(stderr,"ERROR: %s is not a binary feature file.\n",file);
+        exit(1);
+    }
+    if (h->version != BIN_VERSION || h->m < 0 || h->n < 0 || h->nz < -1)
+    {
+        fprintf(stderr,"ERROR: Unsupported binary feature file: %s\n"
+                "       (different version or byte order)\n",file);
+        exit(1);
+    }
+}
+
+
+/* rejects a file whose column indices are out of [0,n) */
+static void bin_check_jdx(const int *jdx, size_t len, const int n,
+                          const char *file)
+{
+    size_t k;
+
+    for (k = 0; k < len; k++)
+    {
+        if (jdx[k] < 0 || jdx[k] >= n)
+        {
+            fprintf(stderr,"ERROR: Wrong column indices in %s.\n",file);
+            exit(1);
+        }
+    }
+}
+
+
+/* rejects a file whose row start indices are not 0,...,nz increasing */
+static void bin_check_rdx(const int *rdx, const int m, const int nz,
+                          const char *file)
+{
+    int i;
+
+    if (rdx[0] != 0 || rdx[m] != nz)
+    {
+        fprintf(stderr,"ERROR: Wrong row indices in %s.\n",file);
+        exit(1);
+    }
+    for (i = 0; i < m; i++)
+    {
+        if (rdx[i] > rdx[i+1])
+        {
+            fprintf(stderr,"ERROR: Wrong row indices in %s.\n",file);
+            exit(1);
+        }
+    }
+}
+
+
+static void bin_read(FILE *fp, void *dst, size_t size, const char *file)
+{
+    if (size > 0 && fread(dst, 1, size, fp) != size)
+    {
+        fprintf(stderr,"ERROR: Unexpected end of file: %s\n",file);
+        exit(1);
+    }
+}
+
+
+static void bin_write(FILE *fp, const void *src, size_t size,
+                      const char *file)
+{
+    if (size > 0 && fwrite(src, 1, size, fp) != size)
+    {
+        fprintf(stderr,"ERROR: Could not write file: %s\n",file);
+        exit(1);
+    }
+}
+
+
+/** \brief Checks whether a file is a binary feature file.
+ *
+ *  For standard input ("-") only the first character is peeked,
+ *  so that the stream can still be read as Matrix Market text.
+ *
+ *  @param  file    file name, or "-" for standard input
+ *
+ *  @return         TRUE if the file starts with the binary file magic
+ */
+int is_bin_file(const char *file)
+{
+    char magic[sizeof(BIN_MAGIC)];
+    FILE *fp;
+    int  c, ret;
+
+    if (strcmp(file, "-") == 0)
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        c = getc(stdin);
+        if (c == EOF) return FALSE;
+        ungetc(c, stdin);
+        return (c == BIN_MAGIC[0]);
+    }
+    if ((fp = fopen(file, "rb")) == NULL) return FALSE;
+    ret = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+           memcmp(magic, BIN_MAGIC, sizeof(magic)) == 0);
+    fclose(fp);
+
+    return ret;
+}
+
+
+/** \brief Checks whether a binary feature file stores the class vector.
+ *
+ *  @param  file    binary feature file name (not standard input)
+ *
+ *  @return         TRUE if the labels flag of the header is set
+ */
+int is_bin_file_labeled(const char *file)
+{
+    bin_header_t h;
+    FILE *fp;
+    int  ret;
+
+    if ((fp = fopen(file, "rb")) == NULL) return FALSE;
+    ret = (fread(&h, 1, sizeof(h), fp) == sizeof(h) &&
+           memcmp(h.magic, BIN_MAGIC, sizeof(BIN_MAGIC)) == 0 &&
+           h.labels);
+    fclose(fp);
+
+    return ret;
+}
+
+
+/** \brief Reads a binary feature file.
+ *
+ *  The file is memory-mapped and the matrix points into the mapping,
+ *  so no parsing or copying takes place; only the row indices (idx)
+ *  are built. When the file is "-", the arrays are read from standard
+ *  input in a single sequential pass instead.
+ *
+ *  @param  file    binary feature file name, or "-" for standard input
+ *  @param  out_mat matrix data
+ *  @param  out_vec class vector stored in the file (allocated),
+ *                  NULL if the file has none. May be NULL.
+ *
+ *  @return         result
+ */
+int read_bin_new_matrix(const char *file, dmatrix **out_mat, double **out_vec)
+{
+    dmatrix *dmat;
+    bin_header_t h;
+    size_t size, off_rdx, off_jdx, off_val, off_b;
+    char *base;
+    int  i;
+    FILE *fp;
+
+    if (strcmp(file, "-") == 0)
+    {
+        fp = stdin;
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    }
+    else if ((fp = fopen(file, "rb")) == NULL)
+    {
+        fprintf(stderr,"ERROR: Could not open file: %s\n",file);
+        exit(1);
+    }
+    bin_read(fp, &h, sizeof(h), file);
+    bin_check_header(&h, file);
+    size = bin_layout(&h, &off_rdx, &off_jdx, &off_val, &off_b);
+
+    dmat = malloc(sizeof(dmatrix));
+    dmat_init_aux(dmat);
+
+#ifndef _WIN32
+    if (fp != stdin)
+    {
+        struct stat st;
+
+        if (fstat(fileno(fp), &st) != 0 || (size_t)st.st_size < size)
+        {
+            fprintf(stderr,"ERROR: Unexpected end of file: %s\n",file);
+            exit(1);
+        }
+        /* private mapping: in-place scaling does not reach the file */
+        base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+                    fileno(fp), 0);
+        if (base == MAP_FAILED)
+        {
+            fprintf(stderr,"ERROR: Could not map file: %s\n",file);
+            exit(1);
+        }
+        dmat->map    = base;
+        dmat->maplen = size;
+    }
+    else
+#endif
+    {
+        /* read everything after the header in one pass */
+        base = malloc(size);
+        bin_read(fp, base+sizeof(h), size-sizeof(h), file);
+        dmat->map    = base;
+        dmat->maplen = 0;
+    }
+    if (fp != stdin) fclose(fp);
+
+    dmat->m     = h.m;
+    dmat->n     = h.n;
+    dmat->nz    = h.nz;
+    dmat->val   = (double *)(base + off_val);
+
+    if (h.nz >= 0)
+    {
+        dmat->rdx = (int *)(base + off_rdx);
+        dmat->jdx = (int *)(base + off_jdx);
+
+        bin_check_rdx(dmat->rdx, h.m, h.nz, file);
+        bin_check_jdx(dmat->jdx, (size_t)h.nz, h.n, file);
+
+        /* row index of each entry */
+        dmat->idx = malloc(sizeof(int)*h.nz);
+        for (i = 0; i < h.m; i++)
+        {
+            int k;
+            for (k = dmat->rdx[i]; k < dmat->rdx[i+1]; k++)
+                dmat->idx[k] = i;
+        }
+    }
+    else
+    {
+        dmat->idx = NULL;
+        dmat->jdx = NULL;
+        dmat->rdx = NULL;
+    }
+
+    if (h.labels && (out_vec != NULL || fp == stdin))
+    {
+        double *b;
+
+        b = malloc(sizeof(double)*h.m);
+        dmat_vcopy(h.m, (double *)(base + off_b), b);
+
+        if (out_vec != NULL)
+            *out_vec = b;
+        else
+        {
+            /* keep it for a later read_mm_new_vector("-") */
+            if (stdin_labels) free(stdin_labels);
+            stdin_labels = b;
+        }
+    }
+    else if (out_vec != NULL)
+    {
+        *out_vec = NULL;
+    }
+    *out_mat = dmat;
+
+    return 0;
+}
+
+
+/*
+ *  Reads the class vector of a binary feature file, skipping the matrix.
+ */
+static int read_bin_new_vector(const char *file, double **out_vec)
+{
+    bin_header_t h;
+    size_t off_rdx, off_jdx, off_val, off_b;
+    double *val;
+    FILE *fp;
+
+    if ((fp = fopen(file, "rb")) == NULL)
+    {
+        fprintf(stderr,"ERROR: Could not open file: %s\n",file);
+        exit(1);
+    }
+    bin_read(fp, &h, sizeof(h), file);
+    bin_check_header(&h, file);
+    if (!h.labels)
+    {
+        fprintf(stderr,"ERROR: %s does not contain a class vector.\n",file);
+        exit(1);
+    }
+    bin_layout(&h, &off_rdx, &off_jdx, &off_val, &off_b);
+
+    val = malloc(sizeof(double)*h.m);
+    if (bin_fseek(fp, off_b, SEEK_SET) != 0)
+    {
+        fprintf(stderr,"ERROR: Unexpected end of file: %s\n",file);
+        exit(1);
+    }
+    bin_read(fp, val, sizeof(double)*h.m, file);
+    fclose(fp);
+
+    *out_vec = val;
+    return 0;
+}
+
+
+/** \brief Writes a binary feature file.
+ *
+ *  @param  file    binary feature file name, or "-" for standard output
+ *  @param  mat     matrix data (csr if sparse)
+ *  @param  vec     class vector (m-vector), NULL if not stored
+ *
+ *  @return         result
+ */
+int write_bin_matrix(const char *file, const dmatrix *mat, const double *vec)
+{
+    bin_header_t h;
+    size_t pos, off_rdx, off_jdx, off_val, off_b;
+    static const char zeros[8] = {0};
+    FILE *fp;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BIN_MAGIC, sizeof(BIN_MAGIC));
+    h.version = BIN_VERSION;
+    h.m       = mat->m;
+    h.n       = mat->n;
+    h.nz      = mat->nz;
+    h.labels  = (vec != NULL);
+    bin_layout(&h, &off_rdx, &off_jdx, &off_val, &off_b);
+
+    if (strcmp(file, "-") == 0)
+    {
+        fp = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else if ((fp = fopen(file, "wb")) == NULL)
+    {
+        fprintf(stderr,"ERROR: Could not open file: %s\n",file);
+        exit(1);
+    }
+    bin_write(fp, &h, sizeof(h), file);
+    if (mat->nz >= 0)
+    {
+        bin_write(fp, mat->rdx, sizeof(int)*((size_t)mat->m+1), file);
+        bin_write(fp, mat->jdx, sizeof(int)*(size_t)mat->nz, file);
+        pos = off_jdx + sizeof(int)*(size_t)mat->nz;
+        bin_write(fp, zeros, off_val - pos, file);
+        bin_write(fp, mat->val, sizeof(double)*(size_t)mat->nz, file);
+    }
+    else
+    {
+        bin_write(fp, mat->val,
+                  sizeof(double)*(size_t)mat->m*(size_t)mat->n, file);
+    }
+    if (vec != NULL)
+        bin_write(fp, vec, sizeof(double)*(size_t)mat->m, file);
+
+    if (fp != stdout) fclose(fp);
+    else              fflush(fp);
+
+    return 0;
+}
+
+
+/** \brief Opens a binary feature file for reading rows in chunks.
+ *
+ *  Only the header, the row start indices and the class vector are
+ *  loaded; the entries are read on demand by bin_stream_read_rows,
+ *  so the matrix does not have to fit in memory.
+ *
+ *  @param  file    binary feature file name (with class vector)
+ *  @param  out_bs  stream data
+ *
+ *  @return         result
+ */
+int bin_stream_open(const char *file, bin_stream_t **out_bs)
+{
+    bin_stream_t *bs;
+    bin_header_t h;
+    size_t off_rdx, off_b;
+
+    bs = malloc(sizeof(bin_stream_t));
+    if ((bs->fp = fopen(file, "rb")) == NULL)
+    {
+        fprintf(stderr,"ERROR: Could not open file: %s\n",file);
+        exit(1);
+    }
+    bin_read(bs->fp, &h, sizeof(h), file);
+    bin_check_header(&h, file);
+    if (!h.labels)
+    {
+        fprintf(stderr,"ERROR: %s does not contain a class vector.\n",file);
+        exit(1);
+    }
+    bin_layout(&h, &off_rdx, &bs->off_jdx, &bs->off_val, &off_b);
+
+    bs->m    = h.m;
+    bs->n    = h.n;
+    bs->nz   = h.nz;
+    bs->rdx  = NULL;
+    bs->b    = malloc(sizeof(double)*h.m);
+    bs->file = file;
+
+    if (h.nz >= 0)
+    {
+        bs->rdx = malloc(sizeof(int)*((size_t)h.m+1));
+        bin_read(bs->fp, bs->rdx, sizeof(int)*((size_t)h.m+1), file);
+        bin_check_rdx(bs->rdx, h.m, h.nz, file);
+    }
+    if (bin_fseek(bs->fp, off_b, SEEK_SET) != 0)
+    {
+        fprintf(stderr,"ERROR: Unexpected end of file: %s\n",file);
+        exit(1);
+    }
+    bin_read(bs->fp, bs->b, sizeof(double)*h.m, file);
+
+    *out_bs = bs;
+    return 0;
+}
+
+
+/** \brief Reads the entries of rows r0,...,r1-1 of a binary feature file.
+ *
+ *  For a sparse matrix, jdx and val receive rdx[r1]-rdx[r0] entries
+ *  (column indices and values); for a dense matrix, val receives
+ *  (r1-r0)*n values in row major order and jdx is not used.
+ *
+ *  @param  bs      stream data
+ *  @param  r0      first row
+ *  @param  r1      last row + 1
+ *  @param  jdx     column indices of the entries
+ *  @param  val     values of the entries
+ */
+void bin_stream_read_rows(bin_stream_t *bs, const int r0, const int r1,
+                          int *jdx, double *val)
+{
+    size_t k0, len;
+
+    if (bs->nz >= 0)
+    {
+        k0  = (size_t)bs->rdx[r0];
+        len = (size_t)bs->rdx[r1] - k0;
+        if (bin_fseek(bs->fp, bs->off_jdx + sizeof(int)*k0, SEEK_SET) != 0)
+        {
+            fprintf(stderr,"ERROR: Unexpected end of file: %s\n",bs->file);
+            exit(1);
+        }
+        bin_read(bs->fp, jdx, sizeof(int)*len, bs->file);
+        bin_check_jdx(jdx, len, bs->n, bs->file);
+    }
+    else
+    {
+        k0  = (size_t)r0*bs->n;
+        len = (size_t)(r1-r0)*bs->n;
+    }
+    if (bin_fseek(bs->fp, bs->off_val + sizeof(double)*k0, SEEK_SET) != 0)
+    {
+        fprintf(stderr,"ERROR: Unexpected end of file: %s\n",bs->file);
+        exit(1);
+    }
+    bin_read(bs->fp, val, sizeof(double)*len, bs->file);
+}
+
+
+void bin_stream_close(bin_stream_t *bs)
+{
+    fclose(bs->fp);
+    if (bs->rdx) free(bs->rdx);
+    free(bs->b);
+    free(bs);
+}
+
+
 /** \brief Read a matrix file.
  *
  *  Reads a Matrix Market formatted matrix from a file.
+ *  Binary feature files are recognized and mapped by read_bin_new_matrix,
+ *  and "-" reads either format from standard input.
  *
  *  @param  file    matrix file name
  *  @param  out_mat matrix data
@@ -182,7 +799,12 @@ int read_mm_new_matrix(const char *file, dmatrix **out_mat)
     FILE *fp;
     MM_typecode matcode;
 
-    if ((fp = fopen(file, "r")) == NULL)
+    if (is_bin_file(file))
+        return read_bin_new_matrix(file, out_mat, NULL);
+
+    if (strcmp(file, "-") == 0)
+        fp = stdin;
+    else if ((fp = fopen(file, "r")) == NULL)
     {
         fprintf(stderr,"ERROR: Could not open file: %s\n",file);
         exit(1);
@@ -268,6 +890,7 @@ int read_mm_new_matrix(const char *file, dmatrix **out_mat)
         dmat->idx   = idx;
         dmat->jdx   = jdx;
         dmat->rdx   = rdx;
+        dmat_init_aux(dmat);
 
         free(itmp);
         free(jtmp);
@@ -300,6 +923,7 @@ int read_mm_new_matrix(const char *file, dmatrix **out_mat)
         dmat->idx   = NULL;
         dmat->jdx   = NULL;
         dmat->rdx   = NULL;
+        dmat_init_aux(dmat);
     }
     *out_mat = dmat;
     if (fp !=stdin) fclose(fp);
@@ -388,6 +1012,7 @@ int read_mm_new_matrix_transpose(const char *file, dmatrix **out_mat)
         dmat->idx   = idx;
         dmat->jdx   = jdx;
         dmat->rdx   = rdx;
+        dmat_init_aux(dmat);
 
         free(itmp);
         free(jtmp);
@@ -417,6 +1042,7 @@ int read_mm_new_matrix_transpose(const char *file, dmatrix **out_mat)
         dmat->idx   = NULL;
         dmat->jdx   = NULL;
         dmat->rdx   = NULL;
+        dmat_init_aux(dmat);
     }
     *out_mat = dmat;
     if (fp !=stdin) fclose(fp);
@@ -427,6 +1053,8 @@ int read_mm_new_matrix_transpose(const char *file, dmatrix **out_mat)
  *
  *  Reads a Matrix Market formatted vector from a file.
  *  Returns pointer to dense vector.
+ *  For a binary feature file, the class vector stored in it is returned;
+ *  "-" returns the one of the binary file last read from standard input.
  *
  *  @param  file    vector file name
  *  @param  out_vec vector data
@@ -440,7 +1068,21 @@ int read_mm_new_vector(const char *file, double **out_vec)
     FILE *fp;
     MM_typecode matcode;
 
-    if ((fp = fopen(file, "r")) == NULL)
+    if (strcmp(file, "-") == 0)
+    {
+        if (stdin_labels != NULL)
+        {
+            *out_vec = stdin_labels;
+            stdin_labels = NULL;
+            return 0;
+        }
+        fp = stdin;
+    }
+    else if (is_bin_file(file))
+    {
+        return read_bin_new_vector(file, out_vec);
+    }
+    else if ((fp = fopen(file, "r")) == NULL)
     {
         fprintf(stderr,"ERROR: Could not open file: %s\n",file);
         exit(1);
@@ -4,6 +4,7 @@
  *  \brief  Header file for utility functions.
  */
 
+#include <stdio.h>
 #include "dmatrix.h"
 
 #ifdef __cplusplus
@@ -26,6 +27,21 @@ typedef struct {
     void *ptr;          /**< puffer starting position */
 } buffer_t;
 
+/** \struct bin_stream_t
+ *  \brief  binary feature file read in row chunks
+ */
+typedef struct {
+    FILE    *fp;        /**< file handle */
+    const char *file;   /**< file name */
+    int     m;          /**< number of rows */
+    int     n;          /**< number of columns */
+    int     nz;         /**< number of non-zeros, -1 if dense */
+    int     *rdx;       /**< row start indices (sparse only) */
+    double  *b;         /**< class vector */
+    size_t  off_jdx;    /**< file offset of the column indices */
+    size_t  off_val;    /**< file offset of the values */
+} bin_stream_t;
+
 void buffer_new(buffer_t **buf, int elemsize, int length);
 void buffer_free(buffer_t *buf);
 int  buffer_write(buffer_t *buf, void *src, int n);
@@ -35,6 +51,9 @@ int condense_solution(const int len, double *sol, int *idx);
 
 double find_lambdamax(const dmatrix *X, const double *b, const int sflag);
 
+void find_gradient(const dmatrix *X, const double *b, const double *avg,
+                   const double *std, const double *x, double *grad);
+
 
 void standardize_data(dmatrix *X, const double *b, double **average,
                       double **stddev, double **acol, double **arow);
@@ -45,6 +64,18 @@ int read_mm_new_matrix_transpose(const char *file, dmatrix **out_mat);
 
 int read_mm_new_vector(const char *file_x, double  **out_vec);
 
+int is_bin_file(const char *file);
+int is_bin_file_labeled(const char *file);
+
+int read_bin_new_matrix(const char *file, dmatrix **out_mat, double **out_vec);
+
+int write_bin_matrix(const char *file, const dmatrix *mat, const double *vec);
+
+int  bin_stream_open(const char *file, bin_stream_t **out_bs);
+void bin_stream_read_rows(bin_stream_t *bs, const int r0, const int r1,
+                          int *jdx, double *val);
+void bin_stream_close(bin_stream_t *bs);
+
 int write_mm_vector(const char *file, const int m, const double *vec,
                     const char *comments, const int type);
 int write_mm_matrix(const char *file, dmatrix *mat,
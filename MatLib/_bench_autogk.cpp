@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "autogk.h"
+
+//
+// NFunc related integrands F_J(x) = exp(-J*x/NFunc)*cos((1+J/10)*x) on
+// [0,10]: NFunc separate point-by-point integrations, NFunc separate
+// integrations in batch mode and one integration in vector mode with
+// shared subdivision. Number of integrand evaluations (points times
+// functions) and number of AutoGKIteration() calls are reported.
+//
+static double integrand(int j, int nfunc, double x)
+{
+    return exp(-j*x/nfunc)*cos((1+0.1*j)*x);
+}
+
+
+int main(int argc, char **argv)
+{
+    autogkstate state;
+    autogkreport rep;
+    ap::real_1d_array v1;
+    ap::real_1d_array v2;
+    ap::real_1d_array v3;
+    int nfunc;
+    int nrep;
+    int i;
+    int j;
+    int r;
+    double v;
+    double cnt;
+    double nevals;
+    double maxerr;
+    clock_t t0;
+    double tm;
+    double tbase;
+
+    nfunc = 200;
+    nrep = 20;
+    if( argc>=2 )
+        nfunc = atoi(argv[1]);
+    if( argc>=3 )
+        nrep = atoi(argv[2]);
+    v1.setlength(nfunc);
+    v2.setlength(nfunc);
+    printf("AUTOGK, %ld INTEGRANDS ON [0,10], %ld REPETITIONS\n\n", long(nfunc), long(nrep));
+    printf("  method              time,s   speedup    evaluations        calls  max.rel.diff\n");
+
+    nevals = 0;
+    cnt = 0;
+    t0 = clock();
+    for(r = 0; r <= nrep-1; r++)
+    {
+        nevals = 0;
+        cnt = 0;
+        for(j = 0; j <= nfunc-1; j++)
+        {
+            autogksmooth(0.0, 10.0, state);
+            while(autogkiteration(state))
+            {
+                state.f = integrand(j, nfunc, state.x);
+                cnt = cnt+1;
+            }
+            autogkresults(state, v1(j), rep);
+            nevals = nevals+rep.nfev;
+        }
+    }
+    tbase = double(clock()-t0)/CLOCKS_PER_SEC;
+    printf("  point-by-point  %10.3lf  %8.2lf  %13.0lf  %11.0lf\n", tbase, 1.0, nevals, cnt);
+
+    t0 = clock();
+    for(r = 0; r <= nrep-1; r++)
+    {
+        nevals = 0;
+        cnt = 0;
+        for(j = 0; j <= nfunc-1; j++)
+        {
+            autogksmooth(0.0, 10.0, state);
+            autogksetbatch(state, 1);
+            while(autogkiteration(state))
+            {
+                for(i = 0; i <= state.nx-1; i++)
+                {
+                    state.fb(i,0) = integrand(j, nfunc, state.xb(i));
+                }
+                cnt = cnt+1;
+            }
+            autogkresults(state, v, rep);
+            v2(j) = v;
+            nevals = nevals+rep.nfev;
+        }
+    }
+    tm = double(clock()-t0)/CLOCKS_PER_SEC;
+    maxerr = 0;
+    for(j = 0; j <= nfunc-1; j++)
+    {
+        maxerr = ap::maxreal(maxerr, fabs(v1(j)-v2(j))/ap::maxreal(fabs(v1(j)), 1.0E-300));
+    }
+    printf("  batch           %10.3lf  %8.2lf  %13.0lf  %11.0lf  %12.1le\n", tm, tbase/ap::maxreal(tm, 1.0E-6), nevals, cnt, maxerr);
+
+    t0 = clock();
+    for(r = 0; r <= nrep-1; r++)
+    {
+        cnt = 0;
+        autogksmooth(0.0, 10.0, state);
+        autogksetbatch(state, nfunc);
+        while(autogkiteration(state))
+        {
+            for(i = 0; i <= state.nx-1; i++)
+            {
+                for(j = 0; j <= nfunc-1; j++)
+                {
+                    state.fb(i,j) = integrand(j, nfunc, state.xb(i));
+                }
+            }
+            cnt = cnt+1;
+        }
+        autogkresultsv(state, v3, rep);
+    }
+    tm = double(clock()-t0)/CLOCKS_PER_SEC;
+    maxerr = 0;
+    for(j = 0; j <= nfunc-1; j++)
+    {
+        maxerr = ap::maxreal(maxerr, fabs(v1(j)-v3(j))/ap::maxreal(fabs(v1(j)), 1.0E-300));
+    }
+    printf("  vector          %10.3lf  %8.2lf  %13.0lf  %11.0lf  %12.1le\n", tm, tbase/ap::maxreal(tm, 1.0E-6), double(rep.nfev)*nfunc, cnt, maxerr);
+    return 0;
+}
+
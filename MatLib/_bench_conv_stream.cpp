@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "conv.h"
+
+//
+// Samples per second for the streaming convolver (overlap-add and
+// overlap-save) and for CONVR1D applied block by block with the tails
+// added by hand. Filter of M taps, signal passed in chunks of CHUNK samples.
+//
+static double streamtime(const ap::real_1d_array& h,
+     int m,
+     const ap::real_1d_array& x,
+     int n,
+     int chunk,
+     int method,
+     double& checksum)
+{
+    convr1dstream s;
+    ap::real_1d_array xc;
+    ap::real_1d_array yc;
+    clock_t t0;
+    int i;
+    int k;
+    int cnt;
+
+    xc.setlength(chunk);
+    yc.setlength(chunk);
+    convr1dstreamcreate(h, m, 0, method, s);
+    checksum = 0;
+    t0 = clock();
+    for(k = 0; k < n; k = k+chunk)
+    {
+        cnt = ap::minint(chunk, n-k);
+        ap::vmove(&xc(0), 1, &x(k), 1, ap::vlen(0,cnt-1));
+        convr1dstreamprocess(s, xc, cnt, yc);
+        for(i = 0; i <= cnt-1; i++)
+        {
+            checksum = checksum+yc(i);
+        }
+    }
+    return double(clock()-t0)/CLOCKS_PER_SEC;
+}
+
+
+static double blocktime(const ap::real_1d_array& h,
+     int m,
+     const ap::real_1d_array& x,
+     int n,
+     int chunk,
+     double& checksum)
+{
+    ap::real_1d_array xc;
+    ap::real_1d_array yc;
+    ap::real_1d_array tail;
+    clock_t t0;
+    int i;
+    int k;
+    int cnt;
+
+    xc.setlength(chunk);
+    tail.setlength(m-1+chunk);
+    for(i = 0; i <= m+chunk-2; i++)
+    {
+        tail(i) = 0;
+    }
+    checksum = 0;
+    t0 = clock();
+    for(k = 0; k < n; k = k+chunk)
+    {
+        cnt = ap::minint(chunk, n-k);
+        ap::vmove(&xc(0), 1, &x(k), 1, ap::vlen(0,cnt-1));
+        convr1d(h, m, xc, cnt, yc);
+        ap::vadd(&yc(0), 1, &tail(0), 1, ap::vlen(0,m-2));
+        for(i = 0; i <= cnt-1; i++)
+        {
+            checksum = checksum+yc(i);
+        }
+        for(i = 0; i <= m-2; i++)
+        {
+            tail(i) = yc(cnt+i);
+        }
+    }
+    return double(clock()-t0)/CLOCKS_PER_SEC;
+}
+
+
+int main(int argc, char **argv)
+{
+    ap::real_1d_array h;
+    ap::real_1d_array x;
+    int taps[] = {16, 64, 256, 1024, 4096, 8192};
+    int n;
+    int chunk;
+    int m;
+    int d;
+    int i;
+    double t0;
+    double t1;
+    double t2;
+    double c0;
+    double c1;
+    double c2;
+
+    n = 1<<20;
+    chunk = 512;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        chunk = atoi(argv[2]);
+    srand(0);
+    x.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        x(i) = 2*ap::randomreal()-1;
+    }
+    printf("STREAMING REAL CONVOLUTION, N=%ld, CHUNK=%ld\n\n", long(n), long(chunk));
+    printf("     M  convr1d,Ms/s  OLA,Ms/s  OLS,Ms/s\n");
+    for(d = 0; d < int(sizeof(taps)/sizeof(taps[0])); d++)
+    {
+        m = taps[d];
+        h.setlength(m);
+        for(i = 0; i <= m-1; i++)
+        {
+            h(i) = 2*ap::randomreal()-1;
+        }
+        t0 = blocktime(h, m, x, n, chunk, c0);
+        t1 = streamtime(h, m, x, n, chunk, 0, c1);
+        t2 = streamtime(h, m, x, n, chunk, 1, c2);
+        printf("%6ld  %12.2lf  %8.2lf  %8.2lf\n",
+            long(m),
+            double(n/ap::maxreal(t0, 1.0E-6)*1.0E-6),
+            double(n/ap::maxreal(t1, 1.0E-6)*1.0E-6),
+            double(n/ap::maxreal(t2, 1.0E-6)*1.0E-6));
+    }
+    return 0;
+}
+
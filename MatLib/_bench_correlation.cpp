@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "correlation.h"
+
+//
+// Correlation matrix of M variables, N observations: pairwise calls of
+// PearsonCorrelation/SpearmanRankCorrelation (time is measured for the
+// first R rows of the matrix and extrapolated to the whole upper triangle),
+// PearsonCorrM/SpearmanCorrM, and top-10 per variable.
+//
+int main(int argc, char **argv)
+{
+    ap::real_2d_array x;
+    ap::real_2d_array c;
+    ap::real_2d_array ck;
+    ap::integer_2d_array idx;
+    ap::real_1d_array x1;
+    ap::real_1d_array x2;
+    ap::real_1d_array f;
+    int n;
+    int m;
+    int r;
+    int i;
+    int j;
+    int pass;
+    double t1;
+    double t2;
+    double t3;
+    double v;
+    double maxerr;
+    clock_t t0;
+
+    n = 1000;
+    m = 2000;
+    r = 10;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        m = atoi(argv[2]);
+    srand(0);
+    x.setlength(n, m);
+    f.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        f(i) = ap::randomreal();
+    }
+    for(j = 0; j <= m-1; j++)
+    {
+        v = ap::randomreal();
+        for(i = 0; i <= n-1; i++)
+        {
+            x(i,j) = v*f(i)+ap::randomreal();
+        }
+    }
+    x1.setlength(n);
+    x2.setlength(n);
+    printf("CORRELATION MATRIX, N=%ld, M=%ld\n\n", long(n), long(m));
+    printf("              pairwise,s    matrix,s   speedup   top-10,s  (max.diff)\n");
+    for(pass = 0; pass <= 1; pass++)
+    {
+        maxerr = 0;
+        if( pass==0 )
+        {
+            t0 = clock();
+            pearsoncorrm(x, n, m, c);
+            t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+            t0 = clock();
+            pearsoncorrtopk(x, n, m, 10, idx, ck);
+            t3 = double(clock()-t0)/CLOCKS_PER_SEC;
+        }
+        else
+        {
+            t0 = clock();
+            spearmancorrm(x, n, m, c);
+            t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+            t0 = clock();
+            spearmancorrtopk(x, n, m, 10, idx, ck);
+            t3 = double(clock()-t0)/CLOCKS_PER_SEC;
+        }
+        t0 = clock();
+        for(i = 0; i <= r-1; i++)
+        {
+            for(j = i; j <= m-1; j++)
+            {
+                ap::vmove(&x1(0), 1, &x(0, i), x.getstride(), ap::vlen(0,n-1));
+                ap::vmove(&x2(0), 1, &x(0, j), x.getstride(), ap::vlen(0,n-1));
+                if( pass==0 )
+                {
+                    v = pearsoncorrelation(x1, x2, n);
+                }
+                else
+                {
+                    v = spearmanrankcorrelation(x1, x2, n);
+                }
+                maxerr = ap::maxreal(maxerr, fabs(v-c(i,j)));
+            }
+        }
+        t1 = double(clock()-t0)/CLOCKS_PER_SEC;
+        t1 = t1*(0.5*double(m)*double(m+1))/(double(r)*double(m)-0.5*double(r)*double(r-1));
+        printf("  %-9s %12.2lf %11.2lf %9.1lf %10.2lf  (%.1le)\n", pass==0 ? "Pearson" : "Spearman", t1, t2, t1/ap::maxreal(t2, 1.0E-6), t3, maxerr);
+    }
+    return 0;
+}
+
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "descriptivestatistics.h"
+
+//
+// N random points: moments calculated with CalculateMoments (one pass over
+// memory, by chunks) and with the two-pass algorithm, percentiles with
+// CalculatePercentile (selection) and by sorting of the sample, quantiles
+// estimated by the t-digest sketch.
+//
+static double seconds(clock_t t0)
+{
+    return double(clock()-t0)/CLOCKS_PER_SEC;
+}
+
+
+static void twopassmoments(const ap::real_1d_array& x,
+     int n,
+     double& mean,
+     double& variance,
+     double& skewness,
+     double& kurtosis)
+{
+    int i;
+    double v;
+    double stddev;
+
+    mean = 0;
+    variance = 0;
+    skewness = 0;
+    kurtosis = 0;
+    for(i = 0; i <= n-1; i++)
+    {
+        mean = mean+x(i);
+    }
+    mean = mean/n;
+    for(i = 0; i <= n-1; i++)
+    {
+        variance = variance+ap::sqr(x(i)-mean);
+    }
+    variance = variance/(n-1);
+    stddev = sqrt(variance);
+    for(i = 0; i <= n-1; i++)
+    {
+        v = (x(i)-mean)/stddev;
+        skewness = skewness+v*v*v;
+        kurtosis = kurtosis+ap::sqr(v*v);
+    }
+    skewness = skewness/n;
+    kurtosis = kurtosis/n-3;
+}
+
+
+int main(int argc, char **argv)
+{
+    ap::real_1d_array x;
+    ap::real_1d_array xs;
+    tdigeststate td;
+    int n;
+    int i;
+    clock_t t0;
+    double t1;
+    double t2;
+    double m1;
+    double m2;
+    double v1;
+    double v2;
+    double s1;
+    double s2;
+    double k1;
+    double k2;
+    double q;
+
+    n = 100000000;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    srand(0);
+    x.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        x(i) = 1000-log(1-ap::randomreal());
+    }
+    printf("DESCRIPTIVE STATISTICS, N=%ld\n\n", long(n));
+    printf("                          new, s     reference, s\n");
+
+    t0 = clock();
+    calculatemoments(x, n, m1, v1, s1, k1);
+    t1 = seconds(t0);
+    t0 = clock();
+    twopassmoments(x, n, m2, v2, s2, k2);
+    t2 = seconds(t0);
+    printf("  moments           %12.2lf %12.2lf   (two-pass; kurtosis %.6lf vs %.6lf)\n", t1, t2, k1, k2);
+
+    t0 = clock();
+    calculatemedian(x, n, v1);
+    t1 = seconds(t0);
+    t0 = clock();
+    calculatepercentile(x, n, 0.99, v2);
+    t2 = seconds(t0);
+    xs.setlength(n);
+    t0 = clock();
+    ap::vmove(&xs(0), 1, &x(0), 1, ap::vlen(0,n-1));
+    tagsortfast(xs, n);
+    q = seconds(t0);
+    printf("  median            %12.2lf %12.2lf   (sorting)\n", t1, q);
+    printf("  percentile 0.99   %12.2lf %12.2lf   (sorting)\n", t2, q);
+
+    t0 = clock();
+    tdigestcreate(100, td);
+    tdigestupdate(td, x, n);
+    v1 = tdigestquantile(td, 0.5);
+    v2 = tdigestquantile(td, 0.99);
+    t1 = seconds(t0);
+    printf("  t-digest          %12.2lf                (median %.6lf vs %.6lf, 0.99 %.6lf vs %.6lf)\n",
+        t1, v1, 0.5*(xs((n-1)/2)+xs(n/2)), v2, xs(ap::ifloor(0.99*(n-1))));
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "dforest.h"
+
+//
+// Random forest on N points with NX variables (two classes separated by
+// a noisy hyperplane): build time, then scoring of M points with DFProcess
+// called row by row and with DFProcessBatch.
+//
+int main(int argc, char **argv)
+{
+    ap::real_2d_array xy;
+    ap::real_2d_array q;
+    ap::real_2d_array yb;
+    ap::real_1d_array x;
+    ap::real_1d_array y;
+    decisionforest df;
+    dfreport rep;
+    int n;
+    int m;
+    int nx;
+    int ntrees;
+    int info;
+    int i;
+    int j;
+    bool same;
+    double v;
+    clock_t t0;
+    double tbuild;
+    double t1;
+    double t2;
+
+    n = 20000;
+    m = 100000;
+    nx = 10;
+    ntrees = 100;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        m = atoi(argv[2]);
+    if( argc>=4 )
+        ntrees = atoi(argv[3]);
+    srand(0);
+    xy.setlength(n, nx+1);
+    for(i = 0; i <= n-1; i++)
+    {
+        v = 0;
+        for(j = 0; j <= nx-1; j++)
+        {
+            xy(i,j) = 2*ap::randomreal()-1;
+            v = v+xy(i,j);
+        }
+        xy(i,nx) = v+0.3*(2*ap::randomreal()-1)>0 ? 1 : 0;
+    }
+    q.setlength(m, nx);
+    for(i = 0; i <= m-1; i++)
+    {
+        for(j = 0; j <= nx-1; j++)
+        {
+            q(i,j) = 2*ap::randomreal()-1;
+        }
+    }
+    printf("RANDOM FOREST, N=%ld, NX=%ld, %ld TREES, %ld QUERIES\n\n", long(n), long(nx), long(ntrees), long(m));
+    
+    t0 = clock();
+    dfbuildrandomdecisionforest(xy, n, nx, 2, ntrees, 0.66, info, df, rep);
+    tbuild = double(clock()-t0)/CLOCKS_PER_SEC;
+    printf("  build, s              %10.2lf   (OOB error %.4lf)\n", tbuild, rep.oobrelclserror);
+    
+    x.setlength(nx);
+    y.setlength(2);
+    t0 = clock();
+    for(i = 0; i <= m-1; i++)
+    {
+        ap::vmove(&x(0), 1, &q(i, 0), 1, ap::vlen(0,nx-1));
+        dfprocess(df, x, y);
+    }
+    t1 = double(clock()-t0)/CLOCKS_PER_SEC;
+    t0 = clock();
+    dfprocessbatch(df, q, m, yb);
+    t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+    same = true;
+    for(i = 0; i <= m-1; i++)
+    {
+        ap::vmove(&x(0), 1, &q(i, 0), 1, ap::vlen(0,nx-1));
+        dfprocess(df, x, y);
+        same = same&&yb(i,0)==y(0)&&yb(i,1)==y(1);
+    }
+    printf("  dfprocess, rows/s     %10.0lf\n", double(m/ap::maxreal(t1, 1.0E-6)));
+    printf("  batch, rows/s         %10.0lf   speedup %.2lf%s\n",
+        double(m/ap::maxreal(t2, 1.0E-6)),
+        double(t1/ap::maxreal(t2, 1.0E-6)),
+        same ? "" : "  (results differ!)");
+    return 0;
+}
+
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "ablas.h"
+
+//
+// GFLOP/s of the real level 3 ABLAS subroutines for NxN matrices:
+// RMatrixGEMM (A*B, A*B', A'*B), RMatrixSYRK and RMatrixLeftTRSM.
+// Each operation is repeated until at least 0.2 second is spent.
+//
+static double gflops(int op, int n, ap::real_2d_array& a, ap::real_2d_array& b, ap::real_2d_array& c)
+{
+    clock_t t0;
+    double t;
+    double flop;
+    int cnt;
+
+    if( op<=2 )
+        flop = 2.0*n*n*n;
+    else if( op==3 )
+        flop = 1.0*n*n*n;
+    else
+        flop = 1.0*n*n*n;
+    cnt = 0;
+    t0 = clock();
+    do
+    {
+        if( op==0 )
+            rmatrixgemm(n, n, n, 1.0, a, 0, 0, 0, b, 0, 0, 0, 0.0, c, 0, 0);
+        if( op==1 )
+            rmatrixgemm(n, n, n, 1.0, a, 0, 0, 0, b, 0, 0, 1, 0.0, c, 0, 0);
+        if( op==2 )
+            rmatrixgemm(n, n, n, 1.0, a, 0, 0, 1, b, 0, 0, 0, 0.0, c, 0, 0);
+        if( op==3 )
+            rmatrixsyrk(n, n, 1.0, a, 0, 0, 0, 0.0, c, 0, 0, true);
+        if( op==4 )
+        {
+            rmatrixcopy(n, n, b, 0, 0, c, 0, 0);
+            rmatrixlefttrsm(n, n, a, 0, 0, true, false, 0, c, 0, 0);
+        }
+        cnt = cnt+1;
+        t = double(clock()-t0)/CLOCKS_PER_SEC;
+    }
+    while(t<0.2);
+    return cnt*flop/t*1.0E-9;
+}
+
+
+int main(int argc, char **argv)
+{
+    ap::real_2d_array a;
+    ap::real_2d_array b;
+    ap::real_2d_array c;
+    int sizes[] = {32, 64, 128, 256, 512, 1024};
+    int maxsize;
+    int n;
+    int d;
+    int i;
+    int j;
+
+    maxsize = 1024;
+    if( argc>=2 )
+        maxsize = atoi(argv[1]);
+    srand(0);
+    printf("REAL LEVEL 3 ABLAS, GFLOP/S (CPU TIME OF ALL THREADS)\n\n");
+    printf("     N      A*B     A*B'     A'*B     SYRK     TRSM\n");
+    for(d = 0; d < int(sizeof(sizes)/sizeof(sizes[0])); d++)
+    {
+        n = sizes[d];
+        if( n>maxsize )
+            break;
+        a.setlength(n, n);
+        b.setlength(n, n);
+        c.setlength(n, n);
+        for(i = 0; i <= n-1; i++)
+        {
+            for(j = 0; j <= n-1; j++)
+            {
+                a(i,j) = 2*ap::randomreal()-1;
+                b(i,j) = 2*ap::randomreal()-1;
+            }
+            a(i,i) = a(i,i)+n;
+        }
+        printf("%6ld  %7.2lf  %7.2lf  %7.2lf  %7.2lf  %7.2lf\n",
+            long(n),
+            gflops(0, n, a, b, c),
+            gflops(1, n, a, b, c),
+            gflops(2, n, a, b, c),
+            gflops(3, n, a, b, c),
+            gflops(4, n, a, b, c));
+    }
+    return 0;
+}
+
@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "nearestneighbor.h"
+
+//
+// Queries per second for the default and the flat layout of the KD-tree,
+// N points uniformly distributed in [-1,+1]^NX, K-NN queries with random
+// points from the same hypercube.
+//
+static double querytime(kdtree& kdt,
+     const ap::real_2d_array& q,
+     int m,
+     int nx,
+     int k,
+     double& checksum)
+{
+    ap::real_1d_array x;
+    ap::real_1d_array r;
+    clock_t t0;
+    int i;
+    int j;
+    int cnt;
+
+    x.setlength(nx);
+    r.setlength(k);
+    checksum = 0;
+    t0 = clock();
+    for(i = 0; i <= m-1; i++)
+    {
+        ap::vmove(&x(0), 1, &q(i, 0), 1, ap::vlen(0,nx-1));
+        kdtreequeryknn(kdt, x, k, true);
+        kdtreequeryresultsdistances(kdt, r, cnt);
+        for(j = 0; j <= cnt-1; j++)
+        {
+            checksum = checksum+r(j);
+        }
+    }
+    return double(clock()-t0)/CLOCKS_PER_SEC;
+}
+
+
+int main(int argc, char **argv)
+{
+    ap::real_2d_array xy;
+    ap::real_2d_array q;
+    ap::integer_1d_array tags;
+    kdtree kdt0;
+    kdtree kdt1;
+    int dims[] = {2, 3, 4, 8, 16, 32};
+    int n;
+    int m;
+    int k;
+    int d;
+    int nx;
+    int i;
+    int j;
+    double t0;
+    double t1;
+    double c0;
+    double c1;
+
+    n = 50000;
+    m = 2000;
+    k = 10;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        m = atoi(argv[2]);
+    srand(0);
+    printf("KD-TREE K-NN QUERIES, N=%ld, K=%ld, %ld QUERIES\n\n", long(n), long(k), long(m));
+    printf("  NX   default,q/s      flat,q/s   speedup\n");
+    for(d = 0; d < int(sizeof(dims)/sizeof(dims[0])); d++)
+    {
+        nx = dims[d];
+        xy.setlength(n, nx);
+        q.setlength(m, nx);
+        tags.setlength(n);
+        for(i = 0; i <= n-1; i++)
+        {
+            for(j = 0; j <= nx-1; j++)
+            {
+                xy(i,j) = 2*ap::randomreal()-1;
+            }
+            tags(i) = i;
+        }
+        for(i = 0; i <= m-1; i++)
+        {
+            for(j = 0; j <= nx-1; j++)
+            {
+                q(i,j) = 2*ap::randomreal()-1;
+            }
+        }
+        kdtreebuildtagged(xy, tags, n, nx, 0, 2, kdt0);
+        kdtreebuildtaggedflat(xy, tags, n, nx, 0, 2, kdt1);
+        t0 = querytime(kdt0, q, m, nx, k, c0);
+        t1 = querytime(kdt1, q, m, nx, k, c1);
+        printf("%4ld  %12.0lf  %12.0lf  %8.2lf%s\n",
+            long(nx),
+            double(m/ap::maxreal(t0, 1.0E-6)),
+            double(m/ap::maxreal(t1, 1.0E-6)),
+            double(t0/ap::maxreal(t1, 1.0E-6)),
+            c0==c1 ? "" : "  (results differ!)");
+    }
+    return 0;
+}
+
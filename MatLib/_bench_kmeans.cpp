@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "kmeans.h"
+
+//
+// Energy of the partition of XY by the closest of the centers stored in
+// the columns of C.
+//
+static double energy(const ap::real_2d_array& xy,
+     int n,
+     int nx,
+     const ap::real_2d_array& c,
+     int k)
+{
+    double result;
+    double v;
+    double d;
+    double dbest;
+    int i;
+    int j;
+    int t;
+
+    result = 0;
+    for(i = 0; i <= n-1; i++)
+    {
+        dbest = ap::maxrealnumber;
+        for(j = 0; j <= k-1; j++)
+        {
+            d = 0;
+            for(t = 0; t <= nx-1; t++)
+            {
+                v = xy(i,t)-c(t,j);
+                d = d+v*v;
+            }
+            dbest = ap::minreal(dbest, d);
+        }
+        result = result+dbest;
+    }
+    return result;
+}
+
+
+//
+// K-means on N points in NX dimensions: K gaussian clusters with random
+// means in [-1,+1]^NX and standard deviation 0.3. Full k-means with one
+// and with 4 restarts, mini-batch k-means with one pass over the data.
+// Energy is relative to the one of the single full k-means run.
+//
+int main(int argc, char **argv)
+{
+    ap::real_2d_array xy;
+    ap::real_2d_array batch;
+    ap::real_2d_array means;
+    ap::real_2d_array c;
+    ap::integer_1d_array xyc;
+    kmeansminibatchstate state;
+    int n;
+    int nx;
+    int k;
+    int bs;
+    int i;
+    int j;
+    int t;
+    int info;
+    clock_t t0;
+    double tm;
+    double e0;
+    double e;
+
+    n = 200000;
+    nx = 64;
+    k = 64;
+    bs = 1024;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        nx = atoi(argv[2]);
+    if( argc>=4 )
+        k = atoi(argv[3]);
+    srand(0);
+    means.setlength(k, nx);
+    for(i = 0; i <= k-1; i++)
+    {
+        for(j = 0; j <= nx-1; j++)
+        {
+            means(i,j) = 2*ap::randomreal()-1;
+        }
+    }
+    xy.setlength(n, nx);
+    for(i = 0; i <= n-1; i++)
+    {
+        t = ap::randominteger(k);
+        for(j = 0; j <= nx-1; j++)
+        {
+            xy(i,j) = means(t,j)+0.3*(ap::randomreal()+ap::randomreal()+ap::randomreal()-1.5)*2;
+        }
+    }
+    printf("K-MEANS, N=%ld, NX=%ld, K=%ld\n\n", long(n), long(nx), long(k));
+    printf("  method                  time,s   rel.energy\n");
+    
+    t0 = clock();
+    kmeansgenerate(xy, n, nx, k, 1, info, c, xyc);
+    tm = double(clock()-t0)/CLOCKS_PER_SEC;
+    e0 = energy(xy, n, nx, c, k);
+    printf("  full, 1 restart       %8.2lf   %10.4lf\n", tm, 1.0);
+    
+    t0 = clock();
+    kmeansgenerate(xy, n, nx, k, 4, info, c, xyc);
+    tm = double(clock()-t0)/CLOCKS_PER_SEC;
+    e = energy(xy, n, nx, c, k);
+    printf("  full, 4 restarts      %8.2lf   %10.4lf\n", tm, e/e0);
+    
+    t0 = clock();
+    kmeansminibatchcreate(nx, k, state);
+    batch.setlength(bs, nx);
+    for(i = 0; i+bs <= n; i += bs)
+    {
+        for(j = 0; j <= bs-1; j++)
+        {
+            ap::vmove(&batch(j, 0), 1, &xy(i+j, 0), 1, ap::vlen(0,nx-1));
+        }
+        kmeansminibatchupdate(state, batch, bs, info);
+    }
+    kmeansminibatchresults(state, c);
+    tm = double(clock()-t0)/CLOCKS_PER_SEC;
+    e = energy(xy, n, nx, c, k);
+    printf("  mini-batch, %5ld     %8.2lf   %10.4lf\n", long(bs), tm, e/e0);
+    return 0;
+}
+
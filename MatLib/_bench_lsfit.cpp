@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "lsfit.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+// Nonlinear fit of F(X,C) = C0*exp(-C1*X0)+C2*sin(C3*X1) to N noisy
+// points: point-by-point reverse communication, batch reverse
+// communication (model evaluated by user in a loop over State.XB) and
+// LSFitNonlinearFitParallel() with callbacks called from the thread pool.
+// Wall clock time is reported.
+//
+static double wallclock()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    return double(clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+
+static void modelfg(const double* c, const double* x, double& f, double* g)
+{
+    double e;
+    double s;
+
+    e = exp(-c[1]*x[0]);
+    s = sin(c[3]*x[1]);
+    f = c[0]*e+c[2]*s;
+    g[0] = e;
+    g[1] = -c[0]*x[0]*e;
+    g[2] = s;
+    g[3] = c[2]*x[1]*cos(c[3]*x[1]);
+}
+
+
+static void callbackfg(const ap::real_1d_array& c,
+     const ap::real_1d_array& x,
+     double& f,
+     ap::real_1d_array& g,
+     void* ptr)
+{
+    modelfg(&c(0), &x(0), f, &g(0));
+}
+
+
+static void report(const char* name,
+     double t,
+     double tbase,
+     const lsfitstate& state)
+{
+    int info;
+    ap::real_1d_array c;
+    lsfitreport rep;
+
+    lsfitnonlinearresults(state, info, c, rep);
+    printf("  %-22s %8.2lf  %8.2lf   info=%ld  rms=%.6lf  c=(%.4lf %.4lf %.4lf %.4lf)\n",
+        name, t, tbase/ap::maxreal(t, 1.0E-6), long(info), rep.rmserror, c(0), c(1), c(2), c(3));
+}
+
+
+int main(int argc, char **argv)
+{
+    lsfitstate state;
+    ap::real_2d_array x;
+    ap::real_1d_array y;
+    ap::real_1d_array c0;
+    ap::real_1d_array g;
+    int n;
+    int batchsize;
+    int i;
+    int t;
+    double t0;
+    double tbase;
+
+    n = 1000000;
+    batchsize = 16384;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        batchsize = atoi(argv[2]);
+    srand(0);
+    x.setlength(n, 2);
+    y.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        x(i,0) = 2*ap::randomreal();
+        x(i,1) = 2*ap::randomreal()-1;
+        y(i) = 1.5*exp(-0.7*x(i,0))+0.8*sin(2.0*x(i,1))+0.01*(2*ap::randomreal()-1);
+    }
+    c0.setlength(4);
+    c0(0) = 1;
+    c0(1) = 1;
+    c0(2) = 1;
+    c0(3) = 1.5;
+    g.setlength(4);
+    printf("NONLINEAR FIT, N=%ld, K=4, BATCH=%ld\n\n", long(n), long(batchsize));
+    printf("  method                   time,s   speedup\n");
+
+    lsfitnonlinearfg(x, y, c0, n, 2, 4, true, state);
+    t0 = wallclock();
+    while(lsfitnonlineariteration(state))
+    {
+        modelfg(&state.c(0), &state.x(0), state.f, &state.g(0));
+    }
+    tbase = wallclock()-t0;
+    report("point-by-point", tbase, tbase, state);
+
+    lsfitnonlinearfg(x, y, c0, n, 2, 4, true, state);
+    lsfitnonlinearsetbatch(state, batchsize);
+    t0 = wallclock();
+    while(lsfitnonlineariteration(state))
+    {
+        for(t = 0; t <= state.pointcount-1; t++)
+        {
+            modelfg(&state.c(0), &state.xb(t, 0), state.fb(t), &g(0));
+            if( state.needfgbatch )
+            {
+                ap::vmove(&state.gb(t, 0), 1, &g(0), 1, ap::vlen(0,3));
+            }
+        }
+    }
+    report("batch", wallclock()-t0, tbase, state);
+
+    lsfitnonlinearfg(x, y, c0, n, 2, 4, true, state);
+    lsfitnonlinearsetbatch(state, batchsize);
+    t0 = wallclock();
+    lsfitnonlinearfitparallel(state, NULL, callbackfg, NULL);
+    report("parallel callbacks", wallclock()-t0, tbase, state);
+    return 0;
+}
+
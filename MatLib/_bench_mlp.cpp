@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "mlpbase.h"
+
+//
+// Network with NIn inputs, two hidden layers of NHid neurons and NOut
+// linear outputs, N random samples: gradient over the whole set calculated
+// with MLPGrad called row by row and with MLPGradBatch, then processing of
+// the same set with MLPProcess and MLPProcessBatch.
+//
+int main(int argc, char **argv)
+{
+    multilayerperceptron network;
+    ap::real_2d_array xy;
+    ap::real_2d_array yb;
+    ap::real_1d_array x;
+    ap::real_1d_array y;
+    ap::real_1d_array g;
+    ap::real_1d_array grad1;
+    ap::real_1d_array grad2;
+    int n;
+    int nin;
+    int nhid;
+    int nout;
+    int nin2;
+    int nout2;
+    int wcount;
+    int i;
+    int j;
+    double e1;
+    double e2;
+    double v;
+    double maxerr;
+    clock_t t0;
+    double t1;
+    double t2;
+
+    n = 100000;
+    nin = 32;
+    nhid = 64;
+    nout = 8;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        nhid = atoi(argv[2]);
+    srand(0);
+    mlpcreate2(nin, nhid, nhid, nout, network);
+    mlpproperties(network, nin2, nout2, wcount);
+    xy.setlength(n, nin+nout);
+    for(i = 0; i <= n-1; i++)
+    {
+        for(j = 0; j <= nin+nout-1; j++)
+        {
+            xy(i,j) = 2*ap::randomreal()-1;
+        }
+    }
+    printf("MLP %ld-%ld-%ld-%ld (%ld WEIGHTS), N=%ld\n\n", long(nin), long(nhid), long(nhid), long(nout), long(wcount), long(n));
+    printf("                       by row, s     batch, s   speedup\n");
+
+    x.setlength(nin);
+    y.setlength(nout);
+    g.setlength(wcount);
+    grad1.setlength(wcount);
+    grad2.setlength(wcount);
+    for(j = 0; j <= wcount-1; j++)
+    {
+        grad1(j) = 0;
+    }
+    e1 = 0;
+    t0 = clock();
+    for(i = 0; i <= n-1; i++)
+    {
+        ap::vmove(&x(0), 1, &xy(i, 0), 1, ap::vlen(0,nin-1));
+        ap::vmove(&y(0), 1, &xy(i, nin), 1, ap::vlen(0,nout-1));
+        mlpgrad(network, x, y, v, g);
+        e1 = e1+v;
+        ap::vadd(&grad1(0), 1, &g(0), 1, ap::vlen(0,wcount-1));
+    }
+    t1 = double(clock()-t0)/CLOCKS_PER_SEC;
+    t0 = clock();
+    mlpgradbatch(network, xy, n, e2, grad2);
+    t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+    maxerr = fabs(e1-e2)/fabs(e1);
+    for(j = 0; j <= wcount-1; j++)
+    {
+        maxerr = ap::maxreal(maxerr, fabs(grad1(j)-grad2(j))/ap::maxreal(fabs(grad1(j)), 1.0));
+    }
+    printf("  gradient        %12.2lf %12.2lf  %8.2lf   (max.rel.diff %.1le)\n", t1, t2, t1/ap::maxreal(t2, 1.0E-6), maxerr);
+
+    t0 = clock();
+    for(i = 0; i <= n-1; i++)
+    {
+        ap::vmove(&x(0), 1, &xy(i, 0), 1, ap::vlen(0,nin-1));
+        mlpprocess(network, x, y);
+    }
+    t1 = double(clock()-t0)/CLOCKS_PER_SEC;
+    t0 = clock();
+    mlpprocessbatch(network, xy, n, yb);
+    t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+    maxerr = 0;
+    for(j = 0; j <= nout-1; j++)
+    {
+        maxerr = ap::maxreal(maxerr, fabs(y(j)-yb(n-1,j))/ap::maxreal(fabs(y(j)), 1.0));
+    }
+    printf("  processing      %12.2lf %12.2lf  %8.2lf   (max.rel.diff %.1le)\n", t1, t2, t1/ap::maxreal(t2, 1.0E-6), maxerr);
+    return 0;
+}
+
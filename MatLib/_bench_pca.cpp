@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "pca.h"
+
+//
+// N points in NVars-dimensional space, R latent factors with variances
+// decaying as 1/(k+1)^2 plus weak noise: NNeeded components calculated by
+// PCABuildBasis (full SVD) and by PCATruncatedSubspace with different
+// numbers of power iterations. Accuracy is relative error of variances
+// and 1-|cos| between exact and approximate vectors.
+//
+int main(int argc, char **argv)
+{
+    ap::real_2d_array x;
+    ap::real_2d_array f;
+    ap::real_2d_array l;
+    ap::real_2d_array v1;
+    ap::real_2d_array v2;
+    ap::real_1d_array s1;
+    ap::real_1d_array s2;
+    int n;
+    int nvars;
+    int r;
+    int nneeded;
+    int info;
+    int its;
+    int i;
+    int j;
+    int k;
+    double t1;
+    double t2;
+    double errs;
+    double errv;
+    double v;
+    clock_t t0;
+
+    n = 4000;
+    nvars = 1000;
+    r = 50;
+    nneeded = 10;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        nvars = atoi(argv[2]);
+    if( argc>=4 )
+        nneeded = atoi(argv[3]);
+    srand(0);
+    f.setlength(n, r);
+    l.setlength(r, nvars);
+    x.setlength(n, nvars);
+    for(i = 0; i <= n-1; i++)
+    {
+        for(k = 0; k <= r-1; k++)
+        {
+            f(i,k) = (2*ap::randomreal()-1)/(k+1);
+        }
+    }
+    for(k = 0; k <= r-1; k++)
+    {
+        for(j = 0; j <= nvars-1; j++)
+        {
+            l(k,j) = 2*ap::randomreal()-1;
+        }
+    }
+    rmatrixgemm(n, nvars, r, 1.0, f, 0, 0, 0, l, 0, 0, 0, 0.0, x, 0, 0);
+    for(i = 0; i <= n-1; i++)
+    {
+        for(j = 0; j <= nvars-1; j++)
+        {
+            x(i,j) = x(i,j)+0.01*(2*ap::randomreal()-1);
+        }
+    }
+    printf("PCA, N=%ld, NVARS=%ld, %ld COMPONENTS\n\n", long(n), long(nvars), long(nneeded));
+    printf("  method               time,s   speedup   var.err   vec.err\n");
+    t0 = clock();
+    pcabuildbasis(x, n, nvars, info, s1, v1);
+    t1 = double(clock()-t0)/CLOCKS_PER_SEC;
+    printf("  exact SVD          %8.2lf\n", t1);
+    for(its = 0; its <= 4; its++)
+    {
+        t0 = clock();
+        pcatruncatedsubspace(x, n, nvars, nneeded, its, info, s2, v2);
+        t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+        errs = 0;
+        errv = 0;
+        for(k = 0; k <= nneeded-1; k++)
+        {
+            errs = ap::maxreal(errs, fabs(s2(k)-s1(k))/s1(k));
+            v = ap::vdotproduct(&v1(0, k), v1.getstride(), &v2(0, k), v2.getstride(), ap::vlen(0,nvars-1));
+            errv = ap::maxreal(errv, 1-fabs(v));
+        }
+        printf("  truncated, q=%ld    %8.2lf  %8.2lf   %.1le   %.1le\n", long(its), t2, t1/ap::maxreal(t2, 1.0E-6), errs, errv);
+    }
+    return 0;
+}
+
@@ -0,0 +1,153 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "spline2d.h"
+
+//
+// Spline with N nodes (uniform or perturbed grid) evaluated at M points
+// (sorted or random) with Spline1DCalc called point by point and with
+// Spline1DCalcV; bicubic spline on the NxN grid evaluated at the scanlines
+// of the image with Spline2DCalc and Spline2DCalcV.
+//
+static void bench1d(int n, int m, bool uniform, bool sorted)
+{
+    ap::real_1d_array x;
+    ap::real_1d_array y;
+    ap::real_1d_array xc;
+    ap::real_1d_array yc;
+    spline1dinterpolant c;
+    clock_t t0;
+    double t1;
+    double t2;
+    double maxerr;
+    int i;
+
+    x.setlength(n);
+    y.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        x(i) = double(i)/double(n-1);
+        if( !uniform&&i>0&&i<n-1 )
+        {
+            x(i) = x(i)+0.4/(n-1)*(2*ap::randomreal()-1);
+        }
+        y(i) = 2*ap::randomreal()-1;
+    }
+    spline1dbuildcubic(x, y, n, 0, 0.0, 0, 0.0, c);
+    xc.setlength(m);
+    for(i = 0; i <= m-1; i++)
+    {
+        if( sorted )
+        {
+            xc(i) = double(i)/double(m);
+        }
+        else
+        {
+            xc(i) = ap::randomreal();
+        }
+    }
+    t0 = clock();
+    maxerr = 0;
+    for(i = 0; i <= m-1; i++)
+    {
+        maxerr = maxerr+spline1dcalc(c, xc(i));
+    }
+    t1 = double(clock()-t0)/CLOCKS_PER_SEC;
+    t0 = clock();
+    spline1dcalcv(c, xc, m, yc);
+    t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+    maxerr = 0;
+    for(i = 0; i <= m-1; i++)
+    {
+        maxerr = ap::maxreal(maxerr, fabs(yc(i)-spline1dcalc(c, xc(i))));
+    }
+    printf("  1D %-9s %-7s %12.3lf %12.3lf  %8.2lf   (max.diff %.1le)\n",
+        uniform ? "uniform" : "perturbed",
+        sorted ? "sorted" : "random",
+        t1, t2, t1/ap::maxreal(t2, 1.0E-6), maxerr);
+}
+
+
+int main(int argc, char **argv)
+{
+    ap::real_1d_array x;
+    ap::real_1d_array y;
+    ap::real_1d_array px;
+    ap::real_1d_array py;
+    ap::real_1d_array pf;
+    ap::real_2d_array f;
+    spline2dinterpolant c;
+    int n;
+    int m;
+    int k;
+    int i;
+    int j;
+    clock_t t0;
+    double t1;
+    double t2;
+    double v;
+    double maxerr;
+
+    n = 1000;
+    m = 4000000;
+    if( argc>=2 )
+        n = atoi(argv[1]);
+    if( argc>=3 )
+        m = atoi(argv[2]);
+    srand(0);
+    printf("SPLINES, N=%ld NODES, M=%ld POINTS\n\n", long(n), long(m));
+    printf("                           by point, s     batch, s   speedup\n");
+    bench1d(n, m, true, true);
+    bench1d(n, m, true, false);
+    bench1d(n, m, false, true);
+    bench1d(n, m, false, false);
+
+    //
+    // 2D: bicubic spline on the KxK grid, image with M pixels
+    //
+    k = 100;
+    x.setlength(k);
+    y.setlength(k);
+    f.setlength(k, k);
+    for(i = 0; i <= k-1; i++)
+    {
+        x(i) = double(i)/double(k-1);
+        y(i) = double(i)/double(k-1);
+    }
+    for(i = 0; i <= k-1; i++)
+    {
+        for(j = 0; j <= k-1; j++)
+        {
+            f(i,j) = 2*ap::randomreal()-1;
+        }
+    }
+    spline2dbuildbicubic(x, y, f, k, k, c);
+    n = int(sqrt(double(m)));
+    px.setlength(n*n);
+    py.setlength(n*n);
+    for(i = 0; i <= n-1; i++)
+    {
+        for(j = 0; j <= n-1; j++)
+        {
+            px(i*n+j) = double(j)/double(n);
+            py(i*n+j) = double(i)/double(n);
+        }
+    }
+    t0 = clock();
+    v = 0;
+    for(i = 0; i <= n*n-1; i++)
+    {
+        v = v+spline2dcalc(c, px(i), py(i));
+    }
+    t1 = double(clock()-t0)/CLOCKS_PER_SEC;
+    t0 = clock();
+    spline2dcalcv(c, px, py, n*n, pf);
+    t2 = double(clock()-t0)/CLOCKS_PER_SEC;
+    maxerr = 0;
+    for(i = 0; i <= n*n-1; i++)
+    {
+        maxerr = ap::maxreal(maxerr, fabs(pf(i)-spline2dcalc(c, px(i), py(i))));
+    }
+    printf("  2D bicubic, %ldx%ld image %12.3lf %12.3lf  %8.2lf   (max.diff %.1le)\n", long(n), long(n), t1, t2, t1/ap::maxreal(t2, 1.0E-6), maxerr);
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "tsort.h"
+#include "correlation.h"
+
+//
+// TagSortFastI and TagSortFastR on N uniformly distributed random numbers
+// (and on numbers with only 100 distinct values), time per element; then
+// Spearman's rank correlation of two arrays of size N.
+//
+static double sorttime(const ap::real_1d_array& a0, int n, bool realtags)
+{
+    ap::real_1d_array a;
+    ap::real_1d_array br;
+    ap::integer_1d_array bi;
+    clock_t t0;
+    int i;
+
+    a = a0;
+    bi.setlength(n);
+    br.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        bi(i) = i;
+        br(i) = i;
+    }
+    t0 = clock();
+    if( realtags )
+    {
+        tagsortfastr(a, br, n);
+    }
+    else
+    {
+        tagsortfasti(a, bi, n);
+    }
+    return double(clock()-t0)/CLOCKS_PER_SEC;
+}
+
+
+int main(int argc, char **argv)
+{
+    ap::real_1d_array x;
+    ap::real_1d_array y;
+    ap::real_1d_array z;
+    int sizes[] = {1000, 10000, 100000, 1000000, 10000000};
+    int maxn;
+    int n;
+    int s;
+    int i;
+    double t1;
+    double t2;
+    double t3;
+    double r;
+    clock_t t0;
+
+    maxn = 10000000;
+    if( argc>=2 )
+        maxn = atoi(argv[1]);
+    srand(0);
+    printf("TAGSORT, ns/element\n\n");
+    printf("         N    fasti,random  fastr,random  fasti,100 values\n");
+    for(s = 0; s < int(sizeof(sizes)/sizeof(sizes[0])); s++)
+    {
+        n = sizes[s];
+        if( n>maxn )
+        {
+            break;
+        }
+        x.setlength(n);
+        z.setlength(n);
+        for(i = 0; i <= n-1; i++)
+        {
+            x(i) = 2*ap::randomreal()-1;
+            z(i) = ap::randominteger(100);
+        }
+        t1 = sorttime(x, n, false);
+        t2 = sorttime(x, n, true);
+        t3 = sorttime(z, n, false);
+        printf("%10ld  %12.1lf  %12.1lf  %16.1lf\n", long(n), t1/n*1.0E9, t2/n*1.0E9, t3/n*1.0E9);
+    }
+    n = maxn;
+    x.setlength(n);
+    y.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        x(i) = ap::randomreal();
+        y(i) = x(i)+ap::randomreal();
+    }
+    t0 = clock();
+    r = spearmanrankcorrelation(x, y, n);
+    printf("\nSPEARMAN, N=%ld: %.2lf s (R=%.4lf)\n", long(n), double(clock()-t0)/CLOCKS_PER_SEC, r);
+    return 0;
+}
+
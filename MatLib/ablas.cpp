@@ -20,8 +20,15 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "ablas.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const double ablasparallelwork = 262144.0;
+static const int ablasparallelminsize = 64;
 
 static void ablasinternalsplitlength(int n, int nb, int& n1, int& n2);
+static int ablasparallelsplit(int n, double work, int& chunksize);
 static void cmatrixrighttrsm2(int m,
      int n,
      const ap::complex_2d_array& a,
@@ -980,6 +987,8 @@ void rmatrixrighttrsm(int m,
     int s1;
     int s2;
     int bs;
+    int i;
+    int cnt;
 
     bs = ablasblocksize(a);
     if( m<=bs&&n<=bs )
@@ -987,6 +996,21 @@ void rmatrixrighttrsm(int m,
         rmatrixrighttrsm2(m, n, a, i1, j1, isupper, isunit, optype, x, i2, j2);
         return;
     }
+    
+    //
+    // Large problem: rows of X are independent, they are split
+    // into panels which are processed in parallel
+    //
+    cnt = ablasparallelsplit(m, double(m)*double(n)*double(n), s1);
+    if( cnt>1 )
+    {
+        #pragma omp parallel for schedule(dynamic,1)
+        for(i = 0; i < cnt; i++)
+        {
+            rmatrixrighttrsm(ap::minint(s1, m-i*s1), n, a, i1, j1, isupper, isunit, optype, x, i2+i*s1, j2);
+        }
+        return;
+    }
     if( m>=n )
     {
         
@@ -1090,6 +1114,8 @@ void rmatrixlefttrsm(int m,
     int s1;
     int s2;
     int bs;
+    int i;
+    int cnt;
 
     bs = ablasblocksize(a);
     if( m<=bs&&n<=bs )
@@ -1097,6 +1123,21 @@ void rmatrixlefttrsm(int m,
         rmatrixlefttrsm2(m, n, a, i1, j1, isupper, isunit, optype, x, i2, j2);
         return;
     }
+    
+    //
+    // Large problem: columns of X are independent, they are split
+    // into panels which are processed in parallel
+    //
+    cnt = ablasparallelsplit(n, double(m)*double(m)*double(n), s1);
+    if( cnt>1 )
+    {
+        #pragma omp parallel for schedule(dynamic,1)
+        for(i = 0; i < cnt; i++)
+        {
+            rmatrixlefttrsm(m, ap::minint(s1, n-i*s1), a, i1, j1, isupper, isunit, optype, x, i2, j2+i*s1);
+        }
+        return;
+    }
     if( n>=m )
     {
         
@@ -1308,6 +1349,12 @@ void rmatrixsyrk(int n,
     int s1;
     int s2;
     int bs;
+    int nb;
+    int cnt;
+    int t;
+    int r;
+    int i;
+    int j;
 
     bs = ablasblocksize(a);
     if( n<=bs&&k<=bs )
@@ -1315,6 +1362,63 @@ void rmatrixsyrk(int n,
         rmatrixsyrk2(n, k, alpha, a, ia, ja, optypea, beta, c, ic, jc, isupper);
         return;
     }
+    
+    //
+    // Large problem: triangle of C is split into CntxCnt grid, diagonal
+    // blocks are updated by SYRK, off-diagonal ones by GEMM, all blocks
+    // are independent and processed in parallel
+    //
+    cnt = ablasparallelsplit(n, 0.5*double(n)*double(n)*double(k), nb);
+    if( cnt>1 )
+    {
+        #pragma omp parallel for schedule(dynamic,1) private(i, j, r, s1, s2)
+        for(t = 0; t < cnt*(cnt+1)/2; t++)
+        {
+            
+            //
+            // T-th block of the upper triangle is (I,J), J>=I
+            //
+            i = 0;
+            r = t;
+            while(r>=cnt-i)
+            {
+                r = r-(cnt-i);
+                i = i+1;
+            }
+            j = i+r;
+            if( !isupper )
+            {
+                r = i;
+                i = j;
+                j = r;
+            }
+            s1 = ap::minint(nb, n-i*nb);
+            s2 = ap::minint(nb, n-j*nb);
+            if( i==j )
+            {
+                if( optypea==0 )
+                {
+                    rmatrixsyrk(s1, k, alpha, a, ia+i*nb, ja, optypea, beta, c, ic+i*nb, jc+i*nb, isupper);
+                }
+                else
+                {
+                    rmatrixsyrk(s1, k, alpha, a, ia, ja+i*nb, optypea, beta, c, ic+i*nb, jc+i*nb, isupper);
+                }
+            }
+            else
+            {
+                if( optypea==0 )
+                {
+                    rmatrixgemm(s1, s2, k, alpha, a, ia+i*nb, ja, 0, a, ia+j*nb, ja, 1, beta, c, ic+i*nb, jc+j*nb);
+                }
+                else
+                {
+                    rmatrixgemm(s1, s2, k, alpha, a, ia, ja+i*nb, 1, a, ia, ja+j*nb, 0, beta, c, ic+i*nb, jc+j*nb);
+                }
+            }
+        }
+        return;
+    }
     if( k>=n )
     {
         
@@ -1538,6 +1642,8 @@ void rmatrixgemm(int m,
     int s1;
     int s2;
     int bs;
+    int i;
+    int cnt;
 
     bs = ablasblocksize(a);
     if( m<=bs&&n<=bs&&k<=bs )
@@ -1545,6 +1651,69 @@ void rmatrixgemm(int m,
         rmatrixgemmk(m, n, k, alpha, a, ia, ja, optypea, b, ib, jb, optypeb, beta, c, ic, jc);
         return;
     }
+    
+    //
+    // External BLAS, if available
+    //
+    if( rmatrixgemmextf(m, n, k, alpha, a, ia, ja, optypea, b, ib, jb, optypeb, beta, c, ic, jc) )
+    {
+        return;
+    }
+    
+    //
+    // Large problem: C is split into independent row (or column)
+    // panels which are processed in parallel
+    //
+    if( m>=n )
+    {
+        cnt = ablasparallelsplit(m, double(m)*double(n)*double(k), s1);
+        if( cnt>1 )
+        {
+            #pragma omp parallel for schedule(dynamic,1) private(s2)
+            for(i = 0; i < cnt; i++)
+            {
+                s2 = ap::minint(s1, m-i*s1);
+                if( optypea==0 )
+                {
+                    rmatrixgemm(s2, n, k, alpha, a, ia+i*s1, ja, optypea, b, ib, jb, optypeb, beta, c, ic+i*s1, jc);
+                }
+                else
+                {
+                    rmatrixgemm(s2, n, k, alpha, a, ia, ja+i*s1, optypea, b, ib, jb, optypeb, beta, c, ic+i*s1, jc);
+                }
+            }
+            return;
+        }
+    }
+    else
+    {
+        cnt = ablasparallelsplit(n, double(m)*double(n)*double(k), s1);
+        if( cnt>1 )
+        {
+            #pragma omp parallel for schedule(dynamic,1) private(s2)
+            for(i = 0; i < cnt; i++)
+            {
+                s2 = ap::minint(s1, n-i*s1);
+                if( optypeb==0 )
+                {
+                    rmatrixgemm(m, s2, k, alpha, a, ia, ja, optypea, b, ib, jb+i*s1, optypeb, beta, c, ic, jc+i*s1);
+                }
+                else
+                {
+                    rmatrixgemm(m, s2, k, alpha, a, ia, ja, optypea, b, ib+i*s1, jb, optypeb, beta, c, ic, jc+i*s1);
+                }
+            }
+            return;
+        }
+    }
+    
+    //
+    // Packed kernel, cache-oblivious recursion as fallback
+    //
+    if( rmatrixgemmpackedf(m, n, k, alpha, a, ia, ja, optypea, b, ib, jb, optypeb, beta, c, ic, jc) )
+    {
+        return;
+    }
     if( m>=n&&m>=k )
     {
         
@@ -1670,6 +1839,43 @@ static void ablasinternalsplitlength(int n, int nb, int& n1, int& n2)
 }
 
 
+/*************************************************************************
+Splits length N of the problem with WORK multiply-adds into panels for
+parallel processing.
+
+Returns number of panels, 1 when problem is too small, when OpenMP is
+not available or when we are already in the parallel region (nested
+calls are serial). ChunkSize is a panel length, last panel may be
+shorter.
+*************************************************************************/
+static int ablasparallelsplit(int n, double work, int& chunksize)
+{
+    int result;
+#ifdef _OPENMP
+    int nt;
+#endif
+
+    result = 1;
+    chunksize = n;
+#ifdef _OPENMP
+    if( omp_in_parallel()||ap::fp_less(work,ablasparallelwork)||n<2*ablasparallelminsize )
+    {
+        return result;
+    }
+    nt = omp_get_max_threads();
+    if( nt<2 )
+    {
+        return result;
+    }
+    result = ap::minint(4*nt, n/ablasparallelminsize);
+    chunksize = (n+result-1)/result;
+    chunksize = 8*((chunksize+7)/8);
+    result = (n+chunksize-1)/chunksize;
+#endif
+    return result;
+}
+
+
 /*************************************************************************
 Level 2 variant of CMatrixRightTRSM
 *************************************************************************/
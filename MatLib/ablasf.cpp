@@ -21,6 +21,22 @@ http://www.fsf.org/licensing/licenses
  
 #include "ablasf.h"
 
+#ifdef ALGLIB_EXTERNAL_BLAS
+extern "C" void dgemm_(const char *transa,
+     const char *transb,
+     const int *m,
+     const int *n,
+     const int *k,
+     const double *alpha,
+     const double *a,
+     const int *lda,
+     const double *b,
+     const int *ldb,
+     const double *beta,
+     double *c,
+     const int *ldc);
+#endif
+
 /*************************************************************************
 Fast kernel
 
@@ -379,5 +395,82 @@ bool cmatrixgemmf(int m,
 }
 
 
+/*************************************************************************
+Fast kernel for large real matrices
+*************************************************************************/
+bool rmatrixgemmpackedf(int m,
+     int n,
+     int k,
+     double alpha,
+     const ap::real_2d_array& a,
+     int ia,
+     int ja,
+     int optypea,
+     const ap::real_2d_array& b,
+     int ib,
+     int jb,
+     int optypeb,
+     double beta,
+     ap::real_2d_array& c,
+     int ic,
+     int jc)
+{
+#ifndef ALGLIB_INTERCEPTS_ABLAS
+    bool result;
+
+    result = false;
+    return result;
+#else
+    return ialglib::_i_rmatrixgemmpacked(m, n, k, alpha, a, ia, ja, optypea, b, ib, jb, optypeb, beta, c, ic, jc);
+#endif
+}
+
+
+/*************************************************************************
+External BLAS kernel
 
+Row-major C=op(A)*op(B) is column-major C'=op(B)'*op(A)', so A and B
+are passed to DGEMM in reverse order.
+*************************************************************************/
+bool rmatrixgemmextf(int m,
+     int n,
+     int k,
+     double alpha,
+     const ap::real_2d_array& a,
+     int ia,
+     int ja,
+     int optypea,
+     const ap::real_2d_array& b,
+     int ib,
+     int jb,
+     int optypeb,
+     double beta,
+     ap::real_2d_array& c,
+     int ic,
+     int jc)
+{
+#ifndef ALGLIB_EXTERNAL_BLAS
+    bool result;
 
+    result = false;
+    return result;
+#else
+    int lda;
+    int ldb;
+    int ldc;
+
+    if( m<=0||n<=0 )
+    {
+        return true;
+    }
+    if( k<=0||alpha==0 )
+    {
+        return false;
+    }
+    lda = a.getstride();
+    ldb = b.getstride();
+    ldc = c.getstride();
+    dgemm_(optypeb==0 ? "N" : "T", optypea==0 ? "N" : "T", &n, &m, &k, &alpha, &b(ib,jb), &ldb, &a(ia,ja), &lda, &beta, &c(ic,jc), &ldc);
+    return true;
+#endif
+}
@@ -270,5 +270,50 @@ bool cmatrixgemmf(int m,
      int jc);
 
 
+/*************************************************************************
+Fast kernel for large real matrices (packed blocks, register-blocked
+micro-kernel), any M/N/K.
+*************************************************************************/
+bool rmatrixgemmpackedf(int m,
+     int n,
+     int k,
+     double alpha,
+     const ap::real_2d_array& a,
+     int ia,
+     int ja,
+     int optypea,
+     const ap::real_2d_array& b,
+     int ib,
+     int jb,
+     int optypeb,
+     double beta,
+     ap::real_2d_array& c,
+     int ic,
+     int jc);
+
+
+/*************************************************************************
+External BLAS kernel: calls DGEMM when ALGLIB is compiled with
+ALGLIB_EXTERNAL_BLAS defined (and linked with BLAS library), returns
+False otherwise.
+*************************************************************************/
+bool rmatrixgemmextf(int m,
+     int n,
+     int k,
+     double alpha,
+     const ap::real_2d_array& a,
+     int ia,
+     int ja,
+     int optypea,
+     const ap::real_2d_array& b,
+     int ib,
+     int jb,
+     int optypeb,
+     double beta,
+     ap::real_2d_array& c,
+     int ic,
+     int jc);
+
+
 #endif
 
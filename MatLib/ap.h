@@ -25,6 +25,7 @@ http://www.fsf.org/licensing/licenses
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <new>
 #include <math.h>
 
 #ifdef __BORLANDC__
@@ -250,6 +251,33 @@ void vmul(complex *vdst, int N, double alpha);
 void vmul(complex *vdst, int N, complex alpha);
 
 
+/********************************************************************
+Arrays.
+
+Element access is not checked by default (zero overhead, the element is
+addressed just like in a plain C array); bounds checks are turned on by
+defining AP_ASSERT, see above.
+
+Storage of all arrays is aligned on ap::array_alignment boundary. Rows
+of the 2-dimensional arrays with Aligned=true are padded to a multiple
+of 16 bytes.
+
+Arrays may own their storage (default) or be attached to external
+buffer with attach() (see also the view templates below). In the latter
+case buffer is neither copied nor freed, and setlength()/setbounds()
+detach array from it.
+
+Copy constructor and assignment do deep copy, assignment reuses current
+storage when sizes are the same. With C++11 compilers arrays are also
+movable (storage is passed to the destination without copying).
+********************************************************************/
+const size_t array_alignment = 64;
+
+#if !defined(AP_NO_MOVE) && (__cplusplus>=201103L || (defined(_MSC_VER) && _MSC_VER>=1600))
+#define AP_MOVE_SEMANTICS
+#endif
+
+
 /********************************************************************
 Template of a dynamical one-dimensional array
 ********************************************************************/
@@ -260,6 +288,7 @@ public:
     template_1d_array()
     {
         m_Vec=0;
+        m_bOwner = true;
         m_iVecSize = 0;
         m_iLow = 0;
         m_iHigh = -1;
@@ -267,18 +296,13 @@ public:
 
     ~template_1d_array()
     {
-        if(m_Vec)
-        {
-            if( Aligned )
-                ap::afree(m_Vec);
-            else
-                delete[] m_Vec;
-        }
+        release();
     };
 
     template_1d_array(const template_1d_array &rhs)
     {
         m_Vec=0;
+        m_bOwner = true;
         m_iVecSize = 0;
         m_iLow = 0;
         m_iHigh = -1;
@@ -295,14 +319,35 @@ public:
         if( rhs.m_iVecSize!=0 )
             setcontent(rhs.m_iLow, rhs.m_iHigh, rhs.getcontent());
         else
+            release();
+        return *this;
+    };
+
+#ifdef AP_MOVE_SEMANTICS
+    template_1d_array(template_1d_array &&rhs)
+    {
+        m_Vec = rhs.m_Vec;
+        m_bOwner = rhs.m_bOwner;
+        m_iVecSize = rhs.m_iVecSize;
+        m_iLow = rhs.m_iLow;
+        m_iHigh = rhs.m_iHigh;
+        rhs.m_Vec = 0;
+        rhs.m_bOwner = true;
+        rhs.m_iVecSize = 0;
+        rhs.m_iLow = 0;
+        rhs.m_iHigh = -1;
+    };
+
+    const template_1d_array& operator=(template_1d_array &&rhs)
+    {
+        if( this!=&rhs )
         {
-            m_Vec=0;
-            m_iVecSize = 0;
-            m_iLow = 0;
-            m_iHigh = -1;
+            release();
+            swap(rhs);
         }
         return *this;
     };
+#endif
 
 
     const T& operator()(int i) const
@@ -325,20 +370,13 @@ public:
 
     void setbounds( int iLow, int iHigh )
     {
-        if(m_Vec)
-        {
-            if( Aligned )
-                ap::afree(m_Vec);
-            else
-                delete[] m_Vec;
-        }
+        release();
         m_iLow = iLow;
         m_iHigh = iHigh;
         m_iVecSize = iHigh-iLow+1;
-        if( Aligned )
-            m_Vec = (T*)ap::amalloc((size_t)(m_iVecSize*sizeof(T)), 16);
-        else
-            m_Vec = new T[(size_t)m_iVecSize];
+        m_Vec = (T*)ap::amalloc((size_t)(m_iVecSize*sizeof(T)), array_alignment);
+        for(long i=0; i<m_iVecSize; i++)
+            ::new((void*)(m_Vec+i)) T;
     };
 
 
@@ -350,12 +388,54 @@ public:
 
     void setcontent( int iLow, int iHigh, const T *pContent )
     {
-        setbounds(iLow, iHigh);
+        if( !m_bOwner || m_Vec==0 || iHigh-iLow!=m_iHigh-m_iLow )
+            setbounds(iLow, iHigh);
+        m_iLow = iLow;
+        m_iHigh = iHigh;
         for(int i=0; i<m_iVecSize; i++)
             m_Vec[i] = pContent[i];
     };
 
 
+    //
+    // Attaches array to external buffer pContent[0..iHigh-iLow],
+    // buffer is not copied and is not freed by the array.
+    //
+    void attach( int iLow, int iHigh, T *pContent )
+    {
+        release();
+        m_Vec = pContent;
+        m_bOwner = false;
+        m_iVecSize = iHigh-iLow+1;
+        m_iLow = iLow;
+        m_iHigh = iHigh;
+    };
+
+
+    bool isowner() const
+    {
+        return m_bOwner;
+    };
+
+
+    void swap(template_1d_array &rhs)
+    {
+        T *vec = m_Vec;
+        bool owner = m_bOwner;
+        long vecsize = m_iVecSize, low = m_iLow, high = m_iHigh;
+        m_Vec = rhs.m_Vec;
+        m_bOwner = rhs.m_bOwner;
+        m_iVecSize = rhs.m_iVecSize;
+        m_iLow = rhs.m_iLow;
+        m_iHigh = rhs.m_iHigh;
+        rhs.m_Vec = vec;
+        rhs.m_bOwner = owner;
+        rhs.m_iVecSize = vecsize;
+        rhs.m_iLow = low;
+        rhs.m_iHigh = high;
+    };
+
+
     T* getcontent()
     {
         return m_Vec;
@@ -397,7 +477,19 @@ public:
 private:
     bool wrongIdx(int i) const { return i<m_iLow || i>m_iHigh; };
 
+    void release()
+    {
+        if( m_Vec && m_bOwner )
+            ap::afree(m_Vec);
+        m_Vec = 0;
+        m_bOwner = true;
+        m_iVecSize = 0;
+        m_iLow = 0;
+        m_iHigh = -1;
+    };
+
     T         *m_Vec;
+    bool      m_bOwner;
     long      m_iVecSize;
     long      m_iLow, m_iHigh;
 };
@@ -414,40 +506,34 @@ public:
     template_2d_array()
     {
         m_Vec=0;
+        m_bOwner = true;
         m_iVecSize=0;
         m_iLow1 = 0;
         m_iHigh1 = -1;
         m_iLow2 = 0;
         m_iHigh2 = -1;
+        m_iConstOffset = 0;
+        m_iLinearMember = 0;
     };
 
     ~template_2d_array()
     {
-        if(m_Vec)
-        {
-            if( Aligned )
-                ap::afree(m_Vec);
-            else
-                delete[] m_Vec;
-        }
+        release();
     };
 
     template_2d_array(const template_2d_array &rhs)
     {
         m_Vec=0;
+        m_bOwner = true;
         m_iVecSize=0;
         m_iLow1 = 0;
         m_iHigh1 = -1;
         m_iLow2 = 0;
         m_iHigh2 = -1;
+        m_iConstOffset = 0;
+        m_iLinearMember = 0;
         if( rhs.m_iVecSize!=0 )
-        {
-            setbounds(rhs.m_iLow1, rhs.m_iHigh1, rhs.m_iLow2, rhs.m_iHigh2);
-            for(int i=m_iLow1; i<=m_iHigh1; i++)
-                for(int j=m_iLow2; j<=m_iHigh2; j++)
-                    operator()(i,j) = rhs(i,j);
-                //vmove(&(operator()(i,m_iLow2)), &(rhs(i,m_iLow2)), m_iHigh2-m_iLow2+1);
-        }
+            copyfrom(rhs);
     };
     const template_2d_array& operator=(const template_2d_array &rhs)
     {
@@ -455,31 +541,37 @@ public:
             return *this;
 
         if( rhs.m_iVecSize!=0 )
-        {
-            setbounds(rhs.m_iLow1, rhs.m_iHigh1, rhs.m_iLow2, rhs.m_iHigh2);
-            for(int i=m_iLow1; i<=m_iHigh1; i++)
-                for(int j=m_iLow2; j<=m_iHigh2; j++)
-                    operator()(i,j) = rhs(i,j);
-                //vmove(&(operator()(i,m_iLow2)), &(rhs(i,m_iLow2)), m_iHigh2-m_iLow2+1);
-        }
+            copyfrom(rhs);
         else
+            release();
+        return *this;
+    };
+
+#ifdef AP_MOVE_SEMANTICS
+    template_2d_array(template_2d_array &&rhs)
+    {
+        m_Vec=0;
+        m_bOwner = true;
+        m_iVecSize=0;
+        m_iLow1 = 0;
+        m_iHigh1 = -1;
+        m_iLow2 = 0;
+        m_iHigh2 = -1;
+        m_iConstOffset = 0;
+        m_iLinearMember = 0;
+        swap(rhs);
+    };
+
+    const template_2d_array& operator=(template_2d_array &&rhs)
+    {
+        if( this!=&rhs )
         {
-            if(m_Vec)
-            {
-                if( Aligned )
-                    ap::afree(m_Vec);
-                else
-                    delete[] m_Vec;
-            }
-            m_Vec=0;
-            m_iVecSize=0;
-            m_iLow1 = 0;
-            m_iHigh1 = -1;
-            m_iLow2 = 0;
-            m_iHigh2 = -1;
+            release();
+            swap(rhs);
         }
         return *this;
     };
+#endif
 
     const T& operator()(int i1, int i2) const
     {
@@ -501,13 +593,7 @@ public:
 
     void setbounds( int iLow1, int iHigh1, int iLow2, int iHigh2 )
     {
-        if(m_Vec)
-        {
-            if( Aligned )
-                ap::afree(m_Vec);
-            else
-                delete[] m_Vec;
-        }
+        release();
         int n1 = iHigh1-iLow1+1;
         int n2 = iHigh2-iLow2+1;
         m_iVecSize = n1*n2;
@@ -519,10 +605,10 @@ public:
                 n2++;
                 m_iVecSize += n1;
             }
-            m_Vec = (T*)ap::amalloc((size_t)(m_iVecSize*sizeof(T)), 16);
         }
-        else
-            m_Vec = new T[(size_t)m_iVecSize];
+        m_Vec = (T*)ap::amalloc((size_t)(m_iVecSize*sizeof(T)), array_alignment);
+        for(long i=0; i<m_iVecSize; i++)
+            ::new((void*)(m_Vec+i)) T;
         m_iLow1  = iLow1;
         m_iHigh1 = iHigh1;
         m_iLow2  = iLow2;
@@ -545,6 +631,57 @@ public:
             //vmove(&(operator()(i,m_iLow2)), pContent, m_iHigh2-m_iLow2+1);
     };
 
+    //
+    // Attaches array to external row-major buffer, element (i,j) is
+    // pContent[(i-iLow1)*iStride+(j-iLow2)]; buffer is not copied and
+    // is not freed by the array.
+    //
+    void attach( int iLow1, int iHigh1, int iLow2, int iHigh2, T *pContent, int iStride )
+    {
+        release();
+        m_Vec = pContent;
+        m_bOwner = false;
+        m_iVecSize = (iHigh1-iLow1+1)*iStride;
+        m_iLow1  = iLow1;
+        m_iHigh1 = iHigh1;
+        m_iLow2  = iLow2;
+        m_iHigh2 = iHigh2;
+        m_iConstOffset = -m_iLow2-m_iLow1*iStride;
+        m_iLinearMember = iStride;
+    };
+
+    bool isowner() const
+    {
+        return m_bOwner;
+    };
+
+    void swap(template_2d_array &rhs)
+    {
+        T *vec = m_Vec;
+        bool owner = m_bOwner;
+        long vecsize = m_iVecSize;
+        long low1 = m_iLow1, low2 = m_iLow2, high1 = m_iHigh1, high2 = m_iHigh2;
+        long constoffset = m_iConstOffset, linearmember = m_iLinearMember;
+        m_Vec = rhs.m_Vec;
+        m_bOwner = rhs.m_bOwner;
+        m_iVecSize = rhs.m_iVecSize;
+        m_iLow1 = rhs.m_iLow1;
+        m_iLow2 = rhs.m_iLow2;
+        m_iHigh1 = rhs.m_iHigh1;
+        m_iHigh2 = rhs.m_iHigh2;
+        m_iConstOffset = rhs.m_iConstOffset;
+        m_iLinearMember = rhs.m_iLinearMember;
+        rhs.m_Vec = vec;
+        rhs.m_bOwner = owner;
+        rhs.m_iVecSize = vecsize;
+        rhs.m_iLow1 = low1;
+        rhs.m_iLow2 = low2;
+        rhs.m_iHigh1 = high1;
+        rhs.m_iHigh2 = high2;
+        rhs.m_iConstOffset = constoffset;
+        rhs.m_iLinearMember = linearmember;
+    };
+
     int getlowbound(int iBoundNum) const
     {
         return iBoundNum==1 ? m_iLow1 : m_iLow2;
@@ -595,13 +732,104 @@ private:
     bool wrongRow(int i) const { return i<m_iLow1 || i>m_iHigh1; };
     bool wrongColumn(int j) const { return j<m_iLow2 || j>m_iHigh2; };
 
+    void release()
+    {
+        if( m_Vec && m_bOwner )
+            ap::afree(m_Vec);
+        m_Vec = 0;
+        m_bOwner = true;
+        m_iVecSize = 0;
+        m_iLow1 = 0;
+        m_iHigh1 = -1;
+        m_iLow2 = 0;
+        m_iHigh2 = -1;
+        m_iConstOffset = 0;
+        m_iLinearMember = 0;
+    };
+
+    //
+    // Deep copy, current storage is reused if it has the same shape
+    //
+    void copyfrom(const template_2d_array &rhs)
+    {
+        long n2 = rhs.m_iHigh2-rhs.m_iLow2+1;
+        if( !m_bOwner || m_Vec==0 || m_iHigh1-m_iLow1!=rhs.m_iHigh1-rhs.m_iLow1 || m_iHigh2-m_iLow2!=n2-1 )
+            setbounds(rhs.m_iLow1, rhs.m_iHigh1, rhs.m_iLow2, rhs.m_iHigh2);
+        m_iConstOffset = -rhs.m_iLow2-rhs.m_iLow1*m_iLinearMember;
+        m_iLow1  = rhs.m_iLow1;
+        m_iHigh1 = rhs.m_iHigh1;
+        m_iLow2  = rhs.m_iLow2;
+        m_iHigh2 = rhs.m_iHigh2;
+        for(long i=0; i<=m_iHigh1-m_iLow1; i++)
+        {
+            T *pdst = m_Vec+i*m_iLinearMember;
+            const T *psrc = rhs.m_Vec+i*rhs.m_iLinearMember;
+            for(long j=0; j<n2; j++)
+                pdst[j] = psrc[j];
+        }
+    };
+
     T           *m_Vec;
+    bool        m_bOwner;
     long        m_iVecSize;
     long        m_iLow1, m_iLow2, m_iHigh1, m_iHigh2;
     long        m_iConstOffset, m_iLinearMember;
 };
 
 
+/********************************************************************
+Non-owning views: arrays attached to external buffers on construction.
+They may be passed to any subroutine which takes arrays by reference.
+Copies of a view refer to the same buffer.
+********************************************************************/
+template<class T, bool Aligned = false>
+class template_1d_view : public template_1d_array<T,Aligned>
+{
+public:
+    template_1d_view(T *pContent, int iLen)
+    {
+        this->attach(0, iLen-1, pContent);
+    };
+
+    template_1d_view(T *pContent, int iLow, int iHigh)
+    {
+        this->attach(iLow, iHigh, pContent);
+    };
+
+    template_1d_view(const template_1d_view &rhs)
+        : template_1d_array<T,Aligned>()
+    {
+        this->attach(rhs.getlowbound(), rhs.gethighbound(), const_cast<T*>(rhs.getcontent()));
+    };
+private:
+    const template_1d_view& operator=(const template_1d_view &rhs);
+};
+
+template<class T, bool Aligned = false>
+class template_2d_view : public template_2d_array<T,Aligned>
+{
+public:
+    template_2d_view(T *pContent, int iLen1, int iLen2)
+    {
+        this->attach(0, iLen1-1, 0, iLen2-1, pContent, iLen2);
+    };
+
+    template_2d_view(T *pContent, int iLen1, int iLen2, int iStride)
+    {
+        this->attach(0, iLen1-1, 0, iLen2-1, pContent, iStride);
+    };
+
+    template_2d_view(const template_2d_view &rhs)
+        : template_2d_array<T,Aligned>()
+    {
+        this->attach(rhs.getlowbound(1), rhs.gethighbound(1), rhs.getlowbound(2), rhs.gethighbound(2),
+            const_cast<T*>(&rhs(rhs.getlowbound(1), rhs.getlowbound(2))), rhs.getstride());
+    };
+private:
+    const template_2d_view& operator=(const template_2d_view &rhs);
+};
+
+
 typedef template_1d_array<int>          integer_1d_array;
 typedef template_1d_array<double,true>  real_1d_array;
 typedef template_1d_array<complex>      complex_1d_array;
@@ -612,6 +840,16 @@ typedef template_2d_array<double,true>  real_2d_array;
 typedef template_2d_array<complex>      complex_2d_array;
 typedef template_2d_array<bool>         boolean_2d_array;
 
+typedef template_1d_view<int>           integer_1d_view;
+typedef template_1d_view<double,true>   real_1d_view;
+typedef template_1d_view<complex>       complex_1d_view;
+typedef template_1d_view<bool>          boolean_1d_view;
+
+typedef template_2d_view<int>           integer_2d_view;
+typedef template_2d_view<double,true>   real_2d_view;
+typedef template_2d_view<complex>       complex_2d_view;
+typedef template_2d_view<bool>          boolean_2d_view;
+
 
 /********************************************************************
 dataset information.
@@ -21,12 +21,33 @@ http://www.fsf.org/licensing/licenses
  
 #include "autogk.h"
 
+static void autogknode(int side,
+     double xi,
+     double a,
+     double b,
+     double s,
+     double alpha,
+     double beta,
+     double& x,
+     double& xminusa,
+     double& bminusx);
+static double autogkscalef(int side,
+     double f,
+     double xi,
+     double alpha,
+     double beta);
 static void autogkinternalprepare(double a,
      double b,
      double eps,
      double xwidth,
+     int nfunc,
      autogkinternalstate& state);
 static bool autogkinternaliteration(autogkinternalstate& state);
+static void autogkinternalrequest(autogkinternalstate& state, int j0, int cnt);
+static void autogkinternalsubinterval(autogkinternalstate& state,
+     int j,
+     int r0);
+static void autogkinternalkey(autogkinternalstate& state, int j);
 static void mheappop(ap::real_2d_array& heap, int heapsize, int heapwidth);
 static void mheappush(ap::real_2d_array& heap, int heapsize, int heapwidth);
 static void mheapresize(ap::real_2d_array& heap,
@@ -103,7 +124,9 @@ void autogksmoothw(double a, double b, double xwidth, autogkstate& state)
     state.a = a;
     state.b = b;
     state.xwidth = xwidth;
-    state.rstate.ra.setbounds(0, 10);
+    state.nfunc = 0;
+    state.rstate.ia.setbounds(0, 1);
+    state.rstate.ra.setbounds(0, 6);
     state.rstate.stage = -1;
 }
 
@@ -156,11 +179,47 @@ void autogksingular(double a,
     state.alpha = alpha;
     state.beta = beta;
     state.xwidth = 0.0;
-    state.rstate.ra.setbounds(0, 10);
+    state.nfunc = 0;
+    state.rstate.ia.setbounds(0, 1);
+    state.rstate.ra.setbounds(0, 6);
     state.rstate.stage = -1;
 }
 
 
+/*************************************************************************
+This function turns on batch mode of the integrator.
+
+In batch mode AutoGKIteration() requests all Gauss-Kronrod nodes  of  the
+subintervals being processed in one call (15 nodes per subinterval,  two
+subintervals after each bisection) instead of one node per call:
+* nodes are stored in State.XB[0..State.NX-1],  State.XMinusAB  and
+  State.BMinusXB contain X-A and B-X (see AutoGKIteration)
+* values of the integrands must be stored in
+  State.FB[0..State.NX-1,0..NFunc-1]
+
+NFunc>1 turns on vector mode: NFunc  related  integrands  are  integrated
+over the same adaptive subdivision of [A,B]. The interval with the largest
+error (relative to the integral of |F_k| over initial partition, maximum
+over all integrands) is bisected, process stops when all integrands  have
+converged. Use AutoGKResultsV() to get the integrals.
+
+Point-by-point mode and batch mode with NFunc=1 give identical results.
+
+INPUT PARAMETERS:
+    State   -   structure initialized with one of AutoGKXXX subroutines
+    NFunc   -   number of integrands, NFunc>=0. Zero turns batch mode off
+                (default).
+
+Must be called before the first call of AutoGKIteration().
+*************************************************************************/
+void autogksetbatch(autogkstate& state, int nfunc)
+{
+
+    ap::ap_error::make_assertion(nfunc>=0, "AutoGKSetBatch: NFunc<0");
+    state.nfunc = nfunc;
+}
+
+
 /*************************************************************************
 One step of adaptive integration process.
 
@@ -174,7 +233,8 @@ Input parameters:
 
 If suborutine returned False, iterative proces has converged. If subroutine
 returned True, caller should calculate function value State.F  at  State.X
-and call AutoGKIteration again.
+and call AutoGKIteration again. In batch mode (see AutoGKSetBatch) caller
+should calculate State.FB[I,K] at State.XB[I] for I=0..State.NX-1.
 
 NOTE:
 
@@ -207,12 +267,11 @@ bool autogkiteration(autogkstate& state)
     double eps;
     double a;
     double b;
-    double x;
-    double t;
     double alpha;
     double beta;
-    double v1;
-    double v2;
+    int side;
+    int i;
+    int k;
 
     
     //
@@ -227,31 +286,27 @@ bool autogkiteration(autogkstate& state)
     //
     if( state.rstate.stage>=0 )
     {
+        side = state.rstate.ia(0);
+        i = state.rstate.ia(1);
         s = state.rstate.ra(0);
         tmp = state.rstate.ra(1);
         eps = state.rstate.ra(2);
         a = state.rstate.ra(3);
         b = state.rstate.ra(4);
-        x = state.rstate.ra(5);
-        t = state.rstate.ra(6);
-        alpha = state.rstate.ra(7);
-        beta = state.rstate.ra(8);
-        v1 = state.rstate.ra(9);
-        v2 = state.rstate.ra(10);
+        alpha = state.rstate.ra(5);
+        beta = state.rstate.ra(6);
     }
     else
     {
+        side = 912;
+        i = 585;
         s = -983;
         tmp = -989;
         eps = -834;
         a = 900;
         b = -287;
-        x = 364;
-        t = 214;
         alpha = -338;
         beta = -686;
-        v1 = 912;
-        v2 = 585;
     }
     if( state.rstate.stage==0 )
     {
@@ -261,10 +316,6 @@ bool autogkiteration(autogkstate& state)
     {
         goto lbl_1;
     }
-    if( state.rstate.stage==2 )
-    {
-        goto lbl_2;
-    }
     
     //
     // Routine body
@@ -274,62 +325,48 @@ bool autogkiteration(autogkstate& state)
     b = state.b;
     alpha = state.alpha;
     beta = state.beta;
+    s = +1;
     state.terminationtype = -1;
     state.nfev = 0;
     state.nintervals = 0;
-    
-    //
-    // smooth function  at a finite interval
-    //
-    if( state.wrappermode!=0 )
+    state.v = 0;
+    state.vv.setlength(ap::maxint(state.nfunc, 1));
+    for(k = 0; k <= ap::maxint(state.nfunc, 1)-1; k++)
     {
-        goto lbl_3;
+        state.vv(k) = 0;
     }
     
     //
-    // special case
-    //
-    if( ap::fp_eq(a,b) )
-    {
-        state.terminationtype = 1;
-        state.v = 0;
-        result = false;
-        return result;
-    }
-    
-    //
-    // general case
+    // smooth function  at a finite interval
     //
-    autogkinternalprepare(a, b, eps, state.xwidth, state.internalstate);
-lbl_5:
-    if( !autogkinternaliteration(state.internalstate) )
+    if( state.wrappermode==0 )
     {
-        goto lbl_6;
+        
+        //
+        // special case
+        //
+        if( ap::fp_eq(a,b) )
+        {
+            state.terminationtype = 1;
+            result = false;
+            return result;
+        }
+        
+        //
+        // general case
+        //
+        side = 0;
+        autogkinternalprepare(a, b, eps, state.xwidth, ap::maxint(state.nfunc, 1), state.internalstate);
+        goto lbl_2;
     }
-    x = state.internalstate.x;
-    state.x = x;
-    state.xminusa = x-a;
-    state.bminusx = b-x;
-    state.rstate.stage = 0;
-    goto lbl_rcomm;
-lbl_0:
-    state.nfev = state.nfev+1;
-    state.internalstate.f = state.f;
-    goto lbl_5;
-lbl_6:
-    state.v = state.internalstate.r;
-    state.terminationtype = state.internalstate.info;
-    state.nintervals = state.internalstate.heapused;
-    result = false;
-    return result;
-lbl_3:
     
     //
     // function with power-law singularities at the ends of a finite interval
     //
     if( state.wrappermode!=1 )
     {
-        goto lbl_7;
+        result = false;
+        return result;
     }
     
     //
@@ -338,7 +375,6 @@ lbl_3:
     if( ap::fp_less_eq(alpha,-1)||ap::fp_less_eq(beta,-1) )
     {
         state.terminationtype = -1;
-        state.v = 0;
         result = false;
         return result;
     }
@@ -349,7 +385,6 @@ lbl_3:
     if( ap::fp_eq(a,b) )
     {
         state.terminationtype = 1;
-        state.v = 0;
         result = false;
         return result;
     }
@@ -379,120 +414,124 @@ lbl_3:
     //     integral(f(x)dx, a, (b+a)/2) =
     //     = 1/(1+alpha) * integral(t^(-alpha/(1+alpha))*f(a+t^(1/(1+alpha)))dt, 0, (0.5*(b-a))^(1+alpha))
     //
-    autogkinternalprepare(double(0), pow(0.5*(b-a), 1+alpha), eps, state.xwidth, state.internalstate);
-lbl_9:
+    // then (Side=2), integrate right half of [a,b]:
+    //     integral(f(x)dx, (b+a)/2, b) =
+    //     = 1/(1+beta) * integral(t^(-beta/(1+beta))*f(b-t^(1/(1+beta)))dt, 0, (0.5*(b-a))^(1+beta))
+    //
+    side = 1;
+    autogkinternalprepare(double(0), pow(0.5*(b-a), 1+alpha), eps, state.xwidth, ap::maxint(state.nfunc, 1), state.internalstate);
+    
+    //
+    // Integration: internal integrator requests nodes of one or several
+    // subintervals at once. They are passed to the caller in one batch or
+    // one by one, depending on mode.
+    //
+lbl_2:
     if( !autogkinternaliteration(state.internalstate) )
     {
-        goto lbl_10;
+        goto lbl_3;
+    }
+    if( state.nfunc==0 )
+    {
+        goto lbl_4;
     }
     
     //
-    // Fill State.X, State.XMinusA, State.BMinusX.
-    // Latter two are filled correctly even if B<A.
+    // batch request
     //
-    x = state.internalstate.x;
-    t = pow(x, 1/(1+alpha));
-    state.x = a+t;
-    if( ap::fp_greater(s,0) )
+    state.nx = state.internalstate.nx;
+    if( state.xb.gethighbound()<state.nx-1 )
     {
-        state.xminusa = t;
-        state.bminusx = b-(a+t);
+        state.xb.setlength(state.nx);
+        state.xminusab.setlength(state.nx);
+        state.bminusxb.setlength(state.nx);
     }
-    else
-    {
-        state.xminusa = a+t-b;
-        state.bminusx = -t;
-    }
-    state.rstate.stage = 1;
-    goto lbl_rcomm;
-lbl_1:
-    if( ap::fp_neq(alpha,0) )
+    if( state.fb.gethighbound(1)<state.nx-1||state.fb.gethighbound(2)!=state.nfunc-1 )
     {
-        state.internalstate.f = state.f*pow(x, -alpha/(1+alpha))/(1+alpha);
+        state.fb.setlength(state.nx, state.nfunc);
     }
-    else
+    for(i = 0; i <= state.nx-1; i++)
     {
-        state.internalstate.f = state.f;
+        autogknode(side, state.internalstate.xb(i), a, b, s, alpha, beta, state.xb(i), state.xminusab(i), state.bminusxb(i));
     }
-    state.nfev = state.nfev+1;
-    goto lbl_9;
-lbl_10:
-    v1 = state.internalstate.r;
-    state.nintervals = state.nintervals+state.internalstate.heapused;
-    
-    //
-    // then, integrate right half of [a,b]:
-    //     integral(f(x)dx, (b+a)/2, b) =
-    //     = 1/(1+beta) * integral(t^(-beta/(1+beta))*f(b-t^(1/(1+beta)))dt, 0, (0.5*(b-a))^(1+beta))
-    //
-    autogkinternalprepare(double(0), pow(0.5*(b-a), 1+beta), eps, state.xwidth, state.internalstate);
-lbl_11:
-    if( !autogkinternaliteration(state.internalstate) )
+    state.rstate.stage = 0;
+    goto lbl_rcomm;
+lbl_0:
+    for(i = 0; i <= state.nx-1; i++)
     {
-        goto lbl_12;
+        for(k = 0; k <= state.nfunc-1; k++)
+        {
+            state.internalstate.fb(i,k) = autogkscalef(side, state.fb(i,k), state.internalstate.xb(i), alpha, beta);
+        }
     }
+    state.nfev = state.nfev+state.nx;
+    goto lbl_2;
+lbl_4:
     
     //
-    // Fill State.X, State.XMinusA, State.BMinusX.
-    // Latter two are filled correctly (X-A, B-X) even if B<A.
+    // point-by-point requests.
+    // State.X, State.XMinusA, State.BMinusX are filled correctly even if B<A.
     //
-    x = state.internalstate.x;
-    t = pow(x, 1/(1+beta));
-    state.x = b-t;
-    if( ap::fp_greater(s,0) )
-    {
-        state.xminusa = b-t-a;
-        state.bminusx = t;
-    }
-    else
+    i = 0;
+lbl_5:
+    if( i>state.internalstate.nx-1 )
     {
-        state.xminusa = -t;
-        state.bminusx = a-(b-t);
+        goto lbl_2;
     }
-    state.rstate.stage = 2;
+    autogknode(side, state.internalstate.xb(i), a, b, s, alpha, beta, state.x, state.xminusa, state.bminusx);
+    state.rstate.stage = 1;
     goto lbl_rcomm;
-lbl_2:
-    if( ap::fp_neq(beta,0) )
+lbl_1:
+    state.internalstate.fb(i,0) = autogkscalef(side, state.f, state.internalstate.xb(i), alpha, beta);
+    state.nfev = state.nfev+1;
+    i = i+1;
+    goto lbl_5;
+lbl_3:
+    if( side==0 )
     {
-        state.internalstate.f = state.f*pow(x, -beta/(1+beta))/(1+beta);
+        ap::vmove(&state.vv(0), 1, &state.internalstate.rv(0), 1, ap::vlen(0,ap::maxint(state.nfunc, 1)-1));
+        state.v = state.internalstate.r;
+        state.terminationtype = state.internalstate.info;
+        state.nintervals = state.internalstate.heapused;
+        result = false;
+        return result;
     }
-    else
+    if( side==1 )
     {
-        state.internalstate.f = state.f;
+        ap::vmove(&state.vv(0), 1, &state.internalstate.rv(0), 1, ap::vlen(0,ap::maxint(state.nfunc, 1)-1));
+        state.nintervals = state.nintervals+state.internalstate.heapused;
+        side = 2;
+        autogkinternalprepare(double(0), pow(0.5*(b-a), 1+beta), eps, state.xwidth, ap::maxint(state.nfunc, 1), state.internalstate);
+        goto lbl_2;
     }
-    state.nfev = state.nfev+1;
-    goto lbl_11;
-lbl_12:
-    v2 = state.internalstate.r;
     state.nintervals = state.nintervals+state.internalstate.heapused;
     
     //
     // final result
     //
-    state.v = s*(v1+v2);
+    for(k = 0; k <= ap::maxint(state.nfunc, 1)-1; k++)
+    {
+        state.vv(k) = s*(state.vv(k)+state.internalstate.rv(k));
+    }
+    state.v = state.vv(0);
     state.terminationtype = 1;
     result = false;
     return result;
-lbl_7:
-    result = false;
-    return result;
     
     //
     // Saving state
     //
 lbl_rcomm:
     result = true;
+    state.rstate.ia(0) = side;
+    state.rstate.ia(1) = i;
     state.rstate.ra(0) = s;
     state.rstate.ra(1) = tmp;
     state.rstate.ra(2) = eps;
     state.rstate.ra(3) = a;
     state.rstate.ra(4) = b;
-    state.rstate.ra(5) = x;
-    state.rstate.ra(6) = t;
-    state.rstate.ra(7) = alpha;
-    state.rstate.ra(8) = beta;
-    state.rstate.ra(9) = v1;
-    state.rstate.ra(10) = v2;
+    state.rstate.ra(5) = alpha;
+    state.rstate.ra(6) = beta;
     return result;
 }
 
@@ -522,6 +561,121 @@ void autogkresults(const autogkstate& state, double& v, autogkreport& rep)
 }
 
 
+/*************************************************************************
+Adaptive integration results, vector mode
+
+Called after AutoGKIteration returned False.
+
+Input parameters:
+    State   -   algorithm state (used by AutoGKIteration).
+
+Output parameters:
+    V       -   array[0..NFunc-1], integral(f_k(x)dx,a,b).  In  point-by-
+                point mode array[0..0] is returned.
+    Rep     -   optimization report (see AutoGKReport description).
+                Rep.NFEV is a number of nodes, every integrand  was
+                calculated in each node.
+*************************************************************************/
+void autogkresultsv(const autogkstate& state,
+     ap::real_1d_array& v,
+     autogkreport& rep)
+{
+
+    v.setlength(ap::maxint(state.nfunc, 1));
+    ap::vmove(&v(0), 1, &state.vv(0), 1, ap::vlen(0,ap::maxint(state.nfunc, 1)-1));
+    rep.terminationtype = state.terminationtype;
+    rep.nfev = state.nfev;
+    rep.nintervals = state.nintervals;
+}
+
+
+/*************************************************************************
+Internal AutoGK subroutine: node of the original interval which corresponds
+to the node XI of the internal integrator.
+
+Side=0  -   smooth function, X=XI
+Side=1  -   left half of [A,B], X=A+XI^(1/(1+Alpha))
+Side=2  -   right half of [A,B], X=B-XI^(1/(1+Beta))
+
+XMinusA and BMinusX are filled correctly even if original B<A (S<0).
+*************************************************************************/
+static void autogknode(int side,
+     double xi,
+     double a,
+     double b,
+     double s,
+     double alpha,
+     double beta,
+     double& x,
+     double& xminusa,
+     double& bminusx)
+{
+    double t;
+
+    if( side==0 )
+    {
+        x = xi;
+        xminusa = x-a;
+        bminusx = b-x;
+    }
+    if( side==1 )
+    {
+        t = pow(xi, 1/(1+alpha));
+        x = a+t;
+        if( ap::fp_greater(s,0) )
+        {
+            xminusa = t;
+            bminusx = b-(a+t);
+        }
+        else
+        {
+            xminusa = a+t-b;
+            bminusx = -t;
+        }
+    }
+    if( side==2 )
+    {
+        t = pow(xi, 1/(1+beta));
+        x = b-t;
+        if( ap::fp_greater(s,0) )
+        {
+            xminusa = b-t-a;
+            bminusx = t;
+        }
+        else
+        {
+            xminusa = -t;
+            bminusx = a-(b-t);
+        }
+    }
+}
+
+
+/*************************************************************************
+Internal AutoGK subroutine: value of the integrand of the internal
+integrator, F is a value of the original function (see AutoGKNode).
+*************************************************************************/
+static double autogkscalef(int side,
+     double f,
+     double xi,
+     double alpha,
+     double beta)
+{
+    double result;
+
+    result = f;
+    if( side==1&&ap::fp_neq(alpha,0) )
+    {
+        result = f*pow(xi, -alpha/(1+alpha))/(1+alpha);
+    }
+    if( side==2&&ap::fp_neq(beta,0) )
+    {
+        result = f*pow(xi, -beta/(1+beta))/(1+beta);
+    }
+    return result;
+}
+
+
 /*************************************************************************
 Internal AutoGK subroutine
 eps<0   - error
@@ -529,13 +683,17 @@ eps=0   - automatic eps selection
 
 width<0 -   error
 width=0 -   no width requirements
+
+NFunc   -   number of integrands
 *************************************************************************/
 static void autogkinternalprepare(double a,
      double b,
      double eps,
      double xwidth,
+     int nfunc,
      autogkinternalstate& state)
 {
+    int k;
 
     
     //
@@ -545,79 +703,44 @@ static void autogkinternalprepare(double a,
     state.b = b;
     state.eps = eps;
     state.xwidth = xwidth;
+    state.nfunc = nfunc;
+    state.r = 0;
+    state.rv.setlength(nfunc);
+    for(k = 0; k <= nfunc-1; k++)
+    {
+        state.rv(k) = 0;
+    }
+    state.heapused = 0;
     
     //
     // Prepare RComm structure
     //
-    state.rstate.ia.setbounds(0, 3);
-    state.rstate.ra.setbounds(0, 8);
     state.rstate.stage = -1;
 }
 
 
 /*************************************************************************
 Internal AutoGK subroutine
+
+Values of the integrands are requested in State.NX nodes State.XB (all
+nodes of one or several subintervals) and returned in State.FB.
 *************************************************************************/
 static bool autogkinternaliteration(autogkinternalstate& state)
 {
     bool result;
-    double c1;
-    double c2;
     int i;
     int j;
-    double intg;
-    double intk;
-    double inta;
-    double v;
-    double ta;
-    double tb;
+    int k;
     int ns;
-    double qeps;
     int info;
+    double ta;
+    double tb;
+    bool converged;
 
     
     //
-    // Reverse communication preparations
-    // I know it looks ugly, but it works the same way
-    // anywhere from C++ to Python.
-    //
-    // This code initializes locals by:
-    // * random values determined during code
-    //   generation - on first subroutine call
-    // * values from previous call - on subsequent calls
+    // Reverse communication: no locals are kept between requests
     //
-    if( state.rstate.stage>=0 )
-    {
-        i = state.rstate.ia(0);
-        j = state.rstate.ia(1);
-        ns = state.rstate.ia(2);
-        info = state.rstate.ia(3);
-        c1 = state.rstate.ra(0);
-        c2 = state.rstate.ra(1);
-        intg = state.rstate.ra(2);
-        intk = state.rstate.ra(3);
-        inta = state.rstate.ra(4);
-        v = state.rstate.ra(5);
-        ta = state.rstate.ra(6);
-        tb = state.rstate.ra(7);
-        qeps = state.rstate.ra(8);
-    }
-    else
-    {
-        i = 497;
-        j = -271;
-        ns = -581;
-        info = 745;
-        c1 = -533;
-        c2 = -77;
-        intg = 678;
-        intk = -293;
-        inta = 316;
-        v = 647;
-        ta = -756;
-        tb = 830;
-        qeps = -871;
-    }
     if( state.rstate.stage==0 )
     {
         goto lbl_0;
@@ -626,10 +749,6 @@ static bool autogkinternaliteration(autogkinternalstate& state)
     {
         goto lbl_1;
     }
-    if( state.rstate.stage==2 )
-    {
-        goto lbl_2;
-    }
     
     //
     // Routine body
@@ -693,156 +812,87 @@ static bool autogkinternaliteration(autogkinternalstate& state)
     
     //
     // First, prepare heap
-    // * column 0   -   absolute error
-    // * column 1   -   integral of a F(x) (calculated using Kronrod extension nodes)
-    // * column 2   -   integral of a |F(x)| (calculated using modified rect. method)
-    // * column 3   -   left boundary of a subinterval
-    // * column 4   -   right boundary of a subinterval
-    //
-    if( ap::fp_neq(state.xwidth,0) )
+    // * column 0       -   key: absolute error (for several integrands -
+    //                      maximum of errors divided by Scale[K])
+    // * column 1       -   left boundary of a subinterval
+    // * column 2       -   right boundary of a subinterval
+    // * column 3+3*K   -   absolute error of K-th integrand
+    // * column 4+3*K   -   integral of a F(x) (calculated using Kronrod extension nodes)
+    // * column 5+3*K   -   integral of a |F(x)| (calculated using modified rect. method)
+    //
+    // With no maximum width requirements we start from one big subinterval,
+    // else maximum subinterval should be no more than XWidth, so we create
+    // Ceil((B-A)/XWidth)+1 small subintervals.
+    //
+    if( ap::fp_eq(state.xwidth,0) )
     {
-        goto lbl_3;
+        ns = 1;
     }
-    
-    //
-    // no maximum width requirements
-    // start from one big subinterval
-    //
-    state.heapwidth = 5;
-    state.heapsize = 1;
-    state.heapused = 1;
+    else
+    {
+        ns = ap::iceil(fabs(state.b-state.a)/state.xwidth)+1;
+    }
+    state.heapwidth = 3+3*state.nfunc;
+    state.heapsize = ns;
+    state.heapused = ns;
     state.heap.setlength(state.heapsize, state.heapwidth);
-    c1 = 0.5*(state.b-state.a);
-    c2 = 0.5*(state.b+state.a);
-    intg = 0;
-    intk = 0;
-    inta = 0;
-    i = 0;
-lbl_5:
-    if( i>state.n-1 )
+    state.sumerr.setlength(state.nfunc);
+    state.sumabs.setlength(state.nfunc);
+    state.scale.setlength(state.nfunc);
+    state.xb.setlength(ap::maxint(ns, 2)*state.n);
+    state.fb.setlength(ap::maxint(ns, 2)*state.n, state.nfunc);
+    if( ns==1 )
     {
-        goto lbl_7;
+        state.heap(0,1) = state.a;
+        state.heap(0,2) = state.b;
     }
-    
-    //
-    // obtain F
-    //
-    state.x = c1*state.qn(i)+c2;
+    else
+    {
+        for(j = 0; j <= ns-1; j++)
+        {
+            state.heap(j,1) = state.a+j*(state.b-state.a)/ns;
+            state.heap(j,2) = state.a+(j+1)*(state.b-state.a)/ns;
+        }
+    }
+    autogkinternalrequest(state, 0, ns);
     state.rstate.stage = 0;
     goto lbl_rcomm;
 lbl_0:
-    v = state.f;
-    
-    //
-    // Gauss-Kronrod formula
-    //
-    intk = intk+v*state.wk(i);
-    if( i%2==1 )
+    for(k = 0; k <= state.nfunc-1; k++)
     {
-        intg = intg+v*state.wg(i);
+        state.sumerr(k) = 0;
+        state.sumabs(k) = 0;
     }
-    
-    //
-    // Integral |F(x)|
-    // Use rectangles method
-    //
-    inta = inta+fabs(v)*state.wr(i);
-    i = i+1;
-    goto lbl_5;
-lbl_7:
-    intk = intk*(state.b-state.a)*0.5;
-    intg = intg*(state.b-state.a)*0.5;
-    inta = inta*(state.b-state.a)*0.5;
-    state.heap(0,0) = fabs(intg-intk);
-    state.heap(0,1) = intk;
-    state.heap(0,2) = inta;
-    state.heap(0,3) = state.a;
-    state.heap(0,4) = state.b;
-    state.sumerr = state.heap(0,0);
-    state.sumabs = fabs(inta);
-    goto lbl_4;
-lbl_3:
-    
-    //
-    // maximum subinterval should be no more than XWidth.
-    // so we create Ceil((B-A)/XWidth)+1 small subintervals
-    //
-    ns = ap::iceil(fabs(state.b-state.a)/state.xwidth)+1;
-    state.heapsize = ns;
-    state.heapused = ns;
-    state.heapwidth = 5;
-    state.heap.setlength(state.heapsize, state.heapwidth);
-    state.sumerr = 0;
-    state.sumabs = 0;
-    j = 0;
-lbl_8:
-    if( j>ns-1 )
+    for(j = 0; j <= state.heapused-1; j++)
     {
-        goto lbl_10;
+        autogkinternalsubinterval(state, j, j*state.n);
+        for(k = 0; k <= state.nfunc-1; k++)
+        {
+            state.sumerr(k) = state.sumerr(k)+state.heap(j,3+3*k);
+            state.sumabs(k) = state.sumabs(k)+fabs(state.heap(j,5+3*k));
+        }
     }
-    ta = state.a+j*(state.b-state.a)/ns;
-    tb = state.a+(j+1)*(state.b-state.a)/ns;
-    c1 = 0.5*(tb-ta);
-    c2 = 0.5*(tb+ta);
-    intg = 0;
-    intk = 0;
-    inta = 0;
-    i = 0;
-lbl_11:
-    if( i>state.n-1 )
+    for(k = 0; k <= state.nfunc-1; k++)
     {
-        goto lbl_13;
+        if( ap::fp_greater(state.sumabs(k),0) )
+        {
+            state.scale(k) = state.sumabs(k);
+        }
+        else
+        {
+            state.scale(k) = 1;
+        }
     }
-    
-    //
-    // obtain F
-    //
-    state.x = c1*state.qn(i)+c2;
-    state.rstate.stage = 1;
-    goto lbl_rcomm;
-lbl_1:
-    v = state.f;
-    
-    //
-    // Gauss-Kronrod formula
-    //
-    intk = intk+v*state.wk(i);
-    if( i%2==1 )
+    for(j = 0; j <= state.heapused-1; j++)
     {
-        intg = intg+v*state.wg(i);
+        autogkinternalkey(state, j);
+        mheappush(state.heap, j, state.heapwidth);
     }
     
-    //
-    // Integral |F(x)|
-    // Use rectangles method
-    //
-    inta = inta+fabs(v)*state.wr(i);
-    i = i+1;
-    goto lbl_11;
-lbl_13:
-    intk = intk*(tb-ta)*0.5;
-    intg = intg*(tb-ta)*0.5;
-    inta = inta*(tb-ta)*0.5;
-    state.heap(j,0) = fabs(intg-intk);
-    state.heap(j,1) = intk;
-    state.heap(j,2) = inta;
-    state.heap(j,3) = ta;
-    state.heap(j,4) = tb;
-    state.sumerr = state.sumerr+state.heap(j,0);
-    state.sumabs = state.sumabs+fabs(inta);
-    j = j+1;
-    goto lbl_8;
-lbl_10:
-lbl_4:
-    
     //
     // method iterations
     //
-lbl_14:
-    if( false )
-    {
-        goto lbl_15;
-    }
+lbl_2:
     
     //
     // additional memory if needed
@@ -856,13 +906,22 @@ lbl_14:
     // TODO: every 20 iterations recalculate errors/sums
     // TODO: one more criterion to prevent infinite loops with too strict Eps
     //
-    if( ap::fp_less_eq(state.sumerr,state.eps*state.sumabs) )
+    converged = true;
+    for(k = 0; k <= state.nfunc-1; k++)
     {
-        state.r = 0;
-        for(j = 0; j <= state.heapused-1; j++)
+        converged = converged&&ap::fp_less_eq(state.sumerr(k),state.eps*state.sumabs(k));
+    }
+    if( converged )
+    {
+        for(k = 0; k <= state.nfunc-1; k++)
         {
-            state.r = state.r+state.heap(j,1);
+            state.rv(k) = 0;
+            for(j = 0; j <= state.heapused-1; j++)
+            {
+                state.rv(k) = state.rv(k)+state.heap(j,4+3*k);
+            }
         }
+        state.r = state.rv(0);
         result = false;
         return result;
     }
@@ -871,103 +930,146 @@ lbl_14:
     // Exclude interval with maximum absolute error
     //
     mheappop(state.heap, state.heapused, state.heapwidth);
-    state.sumerr = state.sumerr-state.heap(state.heapused-1,0);
-    state.sumabs = state.sumabs-state.heap(state.heapused-1,2);
-    
-    //
-    // Divide interval, create subintervals
-    //
-    ta = state.heap(state.heapused-1,3);
-    tb = state.heap(state.heapused-1,4);
-    state.heap(state.heapused-1,3) = ta;
-    state.heap(state.heapused-1,4) = 0.5*(ta+tb);
-    state.heap(state.heapused,3) = 0.5*(ta+tb);
-    state.heap(state.heapused,4) = tb;
-    j = state.heapused-1;
-lbl_16:
-    if( j>state.heapused )
+    for(k = 0; k <= state.nfunc-1; k++)
     {
-        goto lbl_18;
-    }
-    c1 = 0.5*(state.heap(j,4)-state.heap(j,3));
-    c2 = 0.5*(state.heap(j,4)+state.heap(j,3));
-    intg = 0;
-    intk = 0;
-    inta = 0;
-    i = 0;
-lbl_19:
-    if( i>state.n-1 )
-    {
-        goto lbl_21;
+        state.sumerr(k) = state.sumerr(k)-state.heap(state.heapused-1,3+3*k);
+        state.sumabs(k) = state.sumabs(k)-state.heap(state.heapused-1,5+3*k);
     }
     
     //
-    // F(x)
+    // Divide interval, create subintervals
     //
-    state.x = c1*state.qn(i)+c2;
-    state.rstate.stage = 2;
+    ta = state.heap(state.heapused-1,1);
+    tb = state.heap(state.heapused-1,2);
+    state.heap(state.heapused-1,1) = ta;
+    state.heap(state.heapused-1,2) = 0.5*(ta+tb);
+    state.heap(state.heapused,1) = 0.5*(ta+tb);
+    state.heap(state.heapused,2) = tb;
+    autogkinternalrequest(state, state.heapused-1, 2);
+    state.rstate.stage = 1;
     goto lbl_rcomm;
-lbl_2:
-    v = state.f;
-    
-    //
-    // Gauss-Kronrod formula
-    //
-    intk = intk+v*state.wk(i);
-    if( i%2==1 )
+lbl_1:
+    for(j = state.heapused-1; j <= state.heapused; j++)
     {
-        intg = intg+v*state.wg(i);
+        autogkinternalsubinterval(state, j, (j-state.heapused+1)*state.n);
+        for(k = 0; k <= state.nfunc-1; k++)
+        {
+            state.sumerr(k) = state.sumerr(k)+state.heap(j,3+3*k);
+            state.sumabs(k) = state.sumabs(k)+state.heap(j,5+3*k);
+        }
+        autogkinternalkey(state, j);
     }
-    
-    //
-    // Integral |F(x)|
-    // Use rectangles method
-    //
-    inta = inta+fabs(v)*state.wr(i);
-    i = i+1;
-    goto lbl_19;
-lbl_21:
-    intk = intk*(state.heap(j,4)-state.heap(j,3))*0.5;
-    intg = intg*(state.heap(j,4)-state.heap(j,3))*0.5;
-    inta = inta*(state.heap(j,4)-state.heap(j,3))*0.5;
-    state.heap(j,0) = fabs(intg-intk);
-    state.heap(j,1) = intk;
-    state.heap(j,2) = inta;
-    state.sumerr = state.sumerr+state.heap(j,0);
-    state.sumabs = state.sumabs+state.heap(j,2);
-    j = j+1;
-    goto lbl_16;
-lbl_18:
     mheappush(state.heap, state.heapused-1, state.heapwidth);
     mheappush(state.heap, state.heapused, state.heapwidth);
     state.heapused = state.heapused+1;
-    goto lbl_14;
-lbl_15:
-    result = false;
-    return result;
+    goto lbl_2;
     
     //
     // Saving state
     //
 lbl_rcomm:
     result = true;
-    state.rstate.ia(0) = i;
-    state.rstate.ia(1) = j;
-    state.rstate.ia(2) = ns;
-    state.rstate.ia(3) = info;
-    state.rstate.ra(0) = c1;
-    state.rstate.ra(1) = c2;
-    state.rstate.ra(2) = intg;
-    state.rstate.ra(3) = intk;
-    state.rstate.ra(4) = inta;
-    state.rstate.ra(5) = v;
-    state.rstate.ra(6) = ta;
-    state.rstate.ra(7) = tb;
-    state.rstate.ra(8) = qeps;
     return result;
 }
 
 
+/*************************************************************************
+Internal AutoGK subroutine: requests Gauss-Kronrod nodes of Cnt
+subintervals starting from J0-th row of the heap.
+*************************************************************************/
+static void autogkinternalrequest(autogkinternalstate& state, int j0, int cnt)
+{
+    int i;
+    int j;
+    double c1;
+    double c2;
+
+    state.nx = cnt*state.n;
+    for(j = 0; j <= cnt-1; j++)
+    {
+        c1 = 0.5*(state.heap(j0+j,2)-state.heap(j0+j,1));
+        c2 = 0.5*(state.heap(j0+j,2)+state.heap(j0+j,1));
+        for(i = 0; i <= state.n-1; i++)
+        {
+            state.xb(j*state.n+i) = c1*state.qn(i)+c2;
+        }
+    }
+}
+
+
+/*************************************************************************
+Internal AutoGK subroutine: integrals and errors for J-th row of the heap,
+values of the integrands in its nodes are stored in rows R0..R0+N-1 of FB.
+*************************************************************************/
+static void autogkinternalsubinterval(autogkinternalstate& state,
+     int j,
+     int r0)
+{
+    int i;
+    int k;
+    double intg;
+    double intk;
+    double inta;
+    double v;
+
+    for(k = 0; k <= state.nfunc-1; k++)
+    {
+        intg = 0;
+        intk = 0;
+        inta = 0;
+        for(i = 0; i <= state.n-1; i++)
+        {
+            v = state.fb(r0+i,k);
+            
+            //
+            // Gauss-Kronrod formula
+            //
+            intk = intk+v*state.wk(i);
+            if( i%2==1 )
+            {
+                intg = intg+v*state.wg(i);
+            }
+            
+            //
+            // Integral |F(x)|
+            // Use rectangles method
+            //
+            inta = inta+fabs(v)*state.wr(i);
+        }
+        intk = intk*(state.heap(j,2)-state.heap(j,1))*0.5;
+        intg = intg*(state.heap(j,2)-state.heap(j,1))*0.5;
+        inta = inta*(state.heap(j,2)-state.heap(j,1))*0.5;
+        state.heap(j,3+3*k) = fabs(intg-intk);
+        state.heap(j,4+3*k) = intk;
+        state.heap(j,5+3*k) = inta;
+    }
+}
+
+
+/*************************************************************************
+Internal AutoGK subroutine: heap key for J-th row. Errors of the several
+integrands are scaled by estimates of integrals of |F|  calculated  over
+initial partition, so small integrands are not neglected.
+*************************************************************************/
+static void autogkinternalkey(autogkinternalstate& state, int j)
+{
+    int k;
+
+    if( state.nfunc==1 )
+    {
+        state.heap(j,0) = state.heap(j,3);
+    }
+    else
+    {
+        state.heap(j,0) = 0;
+        for(k = 0; k <= state.nfunc-1; k++)
+        {
+            state.heap(j,0) = ap::maxreal(state.heap(j,0), state.heap(j,3+3*k)/state.scale(k));
+        }
+    }
+}
+
+
 static void mheappop(ap::real_2d_array& heap, int heapsize, int heapwidth)
 {
     int i;
@@ -66,16 +66,20 @@ struct autogkinternalstate
     double b;
     double eps;
     double xwidth;
-    double x;
-    double f;
+    int nfunc;
+    int nx;
+    ap::real_1d_array xb;
+    ap::real_2d_array fb;
     int info;
     double r;
+    ap::real_1d_array rv;
     ap::real_2d_array heap;
     int heapsize;
     int heapwidth;
     int heapused;
-    double sumerr;
-    double sumabs;
+    ap::real_1d_array sumerr;
+    ap::real_1d_array sumabs;
+    ap::real_1d_array scale;
     ap::real_1d_array qn;
     ap::real_1d_array wg;
     ap::real_1d_array wk;
@@ -100,10 +104,17 @@ struct autogkstate
     double xminusa;
     double bminusx;
     double f;
+    int nfunc;
+    int nx;
+    ap::real_1d_array xb;
+    ap::real_1d_array xminusab;
+    ap::real_1d_array bminusxb;
+    ap::real_2d_array fb;
     int wrappermode;
     autogkinternalstate internalstate;
     ap::rcommstate rstate;
     double v;
+    ap::real_1d_array vv;
     int terminationtype;
     int nfev;
     int nintervals;
@@ -215,6 +226,35 @@ void autogksingular(double a,
      autogkstate& state);
 
 
+/*************************************************************************
+This function turns on batch mode of the integrator.
+
+In batch mode AutoGKIteration() requests all Gauss-Kronrod nodes  of  the
+subintervals being processed in one call (15 nodes per subinterval,  two
+subintervals after each bisection) instead of one node per call:
+* nodes are stored in State.XB[0..State.NX-1],  State.XMinusAB  and
+  State.BMinusXB contain X-A and B-X (see AutoGKIteration)
+* values of the integrands must be stored in
+  State.FB[0..State.NX-1,0..NFunc-1]
+
+NFunc>1 turns on vector mode: NFunc  related  integrands  are  integrated
+over the same adaptive subdivision of [A,B]. The interval with the largest
+error (relative to the integral of |F_k| over initial partition, maximum
+over all integrands) is bisected, process stops when all integrands  have
+converged. Use AutoGKResultsV() to get the integrals.
+
+Point-by-point mode and batch mode with NFunc=1 give identical results.
+
+INPUT PARAMETERS:
+    State   -   structure initialized with one of AutoGKXXX subroutines
+    NFunc   -   number of integrands, NFunc>=0. Zero turns batch mode off
+                (default).
+
+Must be called before the first call of AutoGKIteration().
+*************************************************************************/
+void autogksetbatch(autogkstate& state, int nfunc);
+
+
 /*************************************************************************
 One step of adaptive integration process.
 
@@ -228,7 +268,8 @@ Input parameters:
 
 If suborutine returned False, iterative proces has converged. If subroutine
 returned True, caller should calculate function value State.F  at  State.X
-and call AutoGKIteration again.
+and call AutoGKIteration again. In batch mode (see AutoGKSetBatch) caller
+should calculate State.FB[I,K] at State.XB[I] for I=0..State.NX-1.
 
 NOTE:
 
@@ -274,5 +315,25 @@ Output parameters:
 void autogkresults(const autogkstate& state, double& v, autogkreport& rep);
 
 
+/*************************************************************************
+Adaptive integration results, vector mode
+
+Called after AutoGKIteration returned False.
+
+Input parameters:
+    State   -   algorithm state (used by AutoGKIteration).
+
+Output parameters:
+    V       -   array[0..NFunc-1], integral(f_k(x)dx,a,b).  In  point-by-
+                point mode array[0..0] is returned.
+    Rep     -   optimization report (see AutoGKReport description).
+                Rep.NFEV is a number of nodes, every integrand  was
+                calculated in each node.
+*************************************************************************/
+void autogkresultsv(const autogkstate& state,
+     ap::real_1d_array& v,
+     autogkreport& rep);
+
+
 #endif
 
@@ -661,6 +661,267 @@ void convr1dcircularinv(const ap::real_1d_array& a,
 }
 
 
+/*************************************************************************
+Streaming real convolution with fixed filter.
+
+State of the convolver:
+* H         -   spectrum of the filter, zero-padded to P, in the format of
+                FFTR1DInternalEven()
+* InBuf     -   input block. Overlap-add stores new samples in InBuf[0..L-1].
+                Overlap-save stores M-1 previous samples in InBuf[0..M-2]
+                and new samples in InBuf[M-1..P-1].
+* OutBuf    -   L filtered samples from the previous block, returned while
+                the current block is filled
+* Tail      -   overlap-add only: last M-1 samples of the convolution of
+                the previous block, added to the head of the next one
+* Pos       -   number of samples in the current block
+*************************************************************************/
+void convr1dstreamcreate(const ap::real_1d_array& h,
+     int m,
+     int blocksize,
+     int method,
+     convr1dstream& s)
+{
+    int i;
+    int l;
+    int p;
+    double flop;
+    double flopbest;
+
+    ap::ap_error::make_assertion(m>0, "ConvR1DStreamCreate: incorrect M!");
+    ap::ap_error::make_assertion(blocksize>=0, "ConvR1DStreamCreate: incorrect BlockSize!");
+    ap::ap_error::make_assertion(method==0||method==1, "ConvR1DStreamCreate: incorrect Method!");
+    
+    //
+    // Choose FFT size P:
+    // * cost of the block is two real FFT's of size P  (forward  and
+    //   inverse, i.e. complex FFT's of size P/2) and product of spectra
+    // * automatic choice minimizes cost per output sample,  trying  block
+    //   lengths from M to 64*M
+    //
+    if( blocksize==0 )
+    {
+        p = 0;
+        flopbest = 0;
+        for(l = ap::maxint(m, 16); l <= 64*ap::maxint(m, 16); l = 2*l)
+        {
+            i = ftbasefindsmootheven(l+m-1);
+            flop = (2*ftbasegetflopestimate(i/2)+4*i)/(i-m+1);
+            if( p==0||ap::fp_less(flop,flopbest) )
+            {
+                p = i;
+                flopbest = flop;
+            }
+        }
+    }
+    else
+    {
+        p = ftbasefindsmootheven(blocksize+m-1);
+        flopbest = (2*ftbasegetflopestimate(p/2)+4*p)/(p-m+1);
+    }
+    s.m = m;
+    s.method = method;
+    s.fftsize = p;
+    s.blocksize = p-m+1;
+    
+    //
+    // Short filter: straightforward formula with reversed H,
+    // InBuf holds M-1 samples of history and block of L samples
+    //
+    if( ap::fp_less(0.15*m,flopbest) )
+    {
+        if( blocksize==0 )
+        {
+            blocksize = ap::maxint(m, 64);
+        }
+        s.fftsize = 0;
+        s.blocksize = blocksize;
+        s.inbuf.setlength(m-1+blocksize);
+        s.outbuf.setlength(blocksize);
+        s.tail.setlength(1);
+        s.h.setlength(m);
+        for(i = 0; i <= m-1; i++)
+        {
+            s.h(i) = h(m-1-i);
+        }
+        convr1dstreamreset(s);
+        return;
+    }
+    s.inbuf.setlength(p);
+    s.outbuf.setlength(s.blocksize);
+    s.tail.setlength(ap::maxint(m-1, 1));
+    s.buf.setlength(p);
+    s.buf3.setlength(p);
+    
+    //
+    // Spectrum of the filter
+    //
+    ftbasegeneratecomplexfftplan(p/2, s.plan);
+    s.h.setlength(p);
+    ap::vmove(&s.h(0), 1, &h(0), 1, ap::vlen(0,m-1));
+    for(i = m; i <= p-1; i++)
+    {
+        s.h(i) = 0;
+    }
+    fftr1dinternaleven(s.h, p, s.buf3, s.plan);
+    convr1dstreamreset(s);
+}
+
+
+/*************************************************************************
+Streaming real convolution: processing of the next chunk of the stream.
+*************************************************************************/
+void convr1dstreamprocess(convr1dstream& s,
+     const ap::real_1d_array& x,
+     int n,
+     ap::real_1d_array& y)
+{
+    int i;
+    int k;
+    int l;
+    int m;
+    int p;
+    int cnt;
+    int inoffs;
+    double ax;
+    double ay;
+    double bx;
+    double by;
+
+    ap::ap_error::make_assertion(n>=0, "ConvR1DStreamProcess: incorrect N!");
+    l = s.blocksize;
+    m = s.m;
+    p = s.fftsize;
+    if( s.method==0&&p>0 )
+    {
+        inoffs = 0;
+    }
+    else
+    {
+        inoffs = m-1;
+    }
+    k = 0;
+    while(k<n)
+    {
+        
+        //
+        // Samples of the current block come in, samples of the previous
+        // block go out: both positions are S.Pos
+        //
+        cnt = ap::minint(n-k, l-s.pos);
+        ap::vmove(&s.inbuf(inoffs+s.pos), 1, &x(k), 1, ap::vlen(inoffs+s.pos,inoffs+s.pos+cnt-1));
+        ap::vmove(&y(k), 1, &s.outbuf(s.pos), 1, ap::vlen(k,k+cnt-1));
+        s.pos = s.pos+cnt;
+        k = k+cnt;
+        if( s.pos<l )
+        {
+            break;
+        }
+        
+        //
+        // Block is full, short filter
+        //
+        if( p==0 )
+        {
+            for(i = 0; i <= l-1; i++)
+            {
+                s.outbuf(i) = ap::vdotproduct(&s.inbuf(i), 1, &s.h(0), 1, ap::vlen(i,i+m-1));
+            }
+            if( m>1 )
+            {
+                ap::vmove(&s.inbuf(0), 1, &s.inbuf(l), 1, ap::vlen(0,m-2));
+            }
+            s.pos = 0;
+            continue;
+        }
+        
+        //
+        // Block is full: circular convolution of InBuf with filter
+        //
+        if( s.method==0 )
+        {
+            ap::vmove(&s.buf(0), 1, &s.inbuf(0), 1, ap::vlen(0,l-1));
+            for(i = l; i <= p-1; i++)
+            {
+                s.buf(i) = 0;
+            }
+        }
+        else
+        {
+            ap::vmove(&s.buf(0), 1, &s.inbuf(0), 1, ap::vlen(0,p-1));
+        }
+        fftr1dinternaleven(s.buf, p, s.buf3, s.plan);
+        s.buf(0) = s.buf(0)*s.h(0);
+        s.buf(1) = s.buf(1)*s.h(1);
+        for(i = 1; i <= p/2-1; i++)
+        {
+            ax = s.buf(2*i+0);
+            ay = s.buf(2*i+1);
+            bx = s.h(2*i+0);
+            by = s.h(2*i+1);
+            s.buf(2*i+0) = ax*bx-ay*by;
+            s.buf(2*i+1) = ax*by+ay*bx;
+        }
+        fftr1dinvinternaleven(s.buf, p, s.buf3, s.plan);
+        if( s.method==0 )
+        {
+            
+            //
+            // overlap-add: add tail of the previous block to the head of
+            // this one, output first L samples, save last M-1 samples
+            //
+            if( m>1 )
+            {
+                ap::vadd(&s.buf(0), 1, &s.tail(0), 1, ap::vlen(0,m-2));
+                ap::vmove(&s.outbuf(0), 1, &s.buf(0), 1, ap::vlen(0,l-1));
+                ap::vmove(&s.tail(0), 1, &s.buf(l), 1, ap::vlen(0,m-2));
+            }
+            else
+            {
+                ap::vmove(&s.outbuf(0), 1, &s.buf(0), 1, ap::vlen(0,l-1));
+            }
+        }
+        else
+        {
+            
+            //
+            // overlap-save: first M-1 samples are wrapped around,  output
+            // last L samples, last M-1 input samples become history
+            //
+            ap::vmove(&s.outbuf(0), 1, &s.buf(m-1), 1, ap::vlen(0,l-1));
+            if( m>1 )
+            {
+                ap::vmove(&s.inbuf(0), 1, &s.inbuf(l), 1, ap::vlen(0,m-2));
+            }
+        }
+        s.pos = 0;
+    }
+}
+
+
+/*************************************************************************
+Streaming real convolution: reset to the initial state.
+*************************************************************************/
+void convr1dstreamreset(convr1dstream& s)
+{
+    int i;
+
+    s.pos = 0;
+    for(i = 0; i <= s.inbuf.gethighbound(); i++)
+    {
+        s.inbuf(i) = 0;
+    }
+    for(i = 0; i <= s.outbuf.gethighbound(); i++)
+    {
+        s.outbuf(i) = 0;
+    }
+    for(i = 0; i <= s.tail.gethighbound(); i++)
+    {
+        s.tail(i) = 0;
+    }
+}
+
+
 /*************************************************************************
 1-dimensional complex convolution.
 
@@ -27,6 +27,25 @@ http://www.fsf.org/licensing/licenses
 #include "ftbase.h"
 #include "fft.h"
 
+/*************************************************************************
+State of the streaming convolution, see ConvR1DStreamCreate()
+*************************************************************************/
+struct convr1dstream
+{
+    int m;
+    int method;
+    int blocksize;
+    int fftsize;
+    int pos;
+    ftplan plan;
+    ap::real_1d_array h;
+    ap::real_1d_array inbuf;
+    ap::real_1d_array outbuf;
+    ap::real_1d_array tail;
+    ap::real_1d_array buf;
+    ap::real_1d_array buf3;
+};
+
 
 /*************************************************************************
 1-dimensional complex convolution.
@@ -289,6 +308,68 @@ void convr1dcircularinv(const ap::real_1d_array& a,
      ap::real_1d_array& r);
 
 
+/*************************************************************************
+Streaming real convolution with fixed filter.
+
+Creates convolver which filters unbounded stream X[] with  filter  H[],
+Y[t] = SUM(H[k]*X[t-k], k=0..M-1), chunk by chunk. The stream is  split
+into blocks of length L, each block is processed with FFT of  size  P=L+M-1,
+using spectrum of H computed here once.  Short  filters,  for  which  the
+straightforward formula is cheaper (same criterion as in ConvR1D), are
+applied directly to each block; S.FFTSize=0 then, and Method is ignored.
+
+INPUT PARAMETERS
+    H           -   array[0..M-1], filter
+    M           -   filter length, M>=1
+    BlockSize   -   block length L, BlockSize>=0:
+                    * 0 means automatic choice (minimal cost per sample)
+                    * positive values are rounded up, so that FFT size  is
+                      even and has no prime factors larger than 5
+    Method      -   * 0 for overlap-add
+                    * 1 for overlap-save
+
+OUTPUT PARAMETERS
+    S           -   convolver, S.BlockSize is a block length actually used.
+                    Output is delayed by S.BlockSize samples, see
+                    ConvR1DStreamProcess().
+*************************************************************************/
+void convr1dstreamcreate(const ap::real_1d_array& h,
+     int m,
+     int blocksize,
+     int method,
+     convr1dstream& s);
+
+
+/*************************************************************************
+Streaming real convolution: processing of the next chunk of the stream.
+
+Chunks may have any length, there are no allocations.
+
+INPUT PARAMETERS
+    S       -   convolver created by ConvR1DStreamCreate()
+    X       -   array[0..N-1], next N samples of the stream
+    N       -   chunk length, N>=0
+    Y       -   preallocated array, at least N elements
+
+OUTPUT PARAMETERS
+    Y       -   next N samples of the filtered stream, delayed by L=S.BlockSize
+                samples: if X[] is the I-th..(I+N-1)-th samples  of  the
+                stream, then Y[J] = Conv(H,X)[I+J-L]. First L samples of the
+                filtered stream are zeros.
+*************************************************************************/
+void convr1dstreamprocess(convr1dstream& s,
+     const ap::real_1d_array& x,
+     int n,
+     ap::real_1d_array& y);
+
+
+/*************************************************************************
+Streaming real convolution: reset to the initial state (start of a  new
+stream), the filter is kept.
+*************************************************************************/
+void convr1dstreamreset(convr1dstream& s);
+
+
 /*************************************************************************
 1-dimensional complex convolution.
 
@@ -311,5 +311,25 @@ void corrr1dcircular(const ap::real_1d_array& signal,
 }
 
 
+/*************************************************************************
+Streaming real cross-correlation with fixed pattern.
+*************************************************************************/
+void corrr1dstreamcreate(const ap::real_1d_array& pattern,
+     int m,
+     int blocksize,
+     int method,
+     convr1dstream& s)
+{
+    ap::real_1d_array p;
+    int i;
+
+    ap::ap_error::make_assertion(m>0, "CorrR1DStreamCreate: incorrect M!");
+    p.setlength(m);
+    for(i = 0; i <= m-1; i++)
+    {
+        p(m-1-i) = pattern(i);
+    }
+    convr1dstreamcreate(p, m, blocksize, method, s);
+}
 
 
@@ -183,5 +183,23 @@ void corrr1dcircular(const ap::real_1d_array& signal,
      ap::real_1d_array& c);
 
 
+/*************************************************************************
+Streaming real cross-correlation with fixed pattern.
+
+Creates correlator which  computes  Z[t] = SUM(Pattern[j]*X[t-M+1+j]),
+j=0..M-1, for unbounded stream X[], i.e. correlation of the pattern with
+the last M samples of the stream. It is a streaming convolution with
+reversed pattern, see ConvR1DStreamCreate() for parameters.
+
+Stream is processed with ConvR1DStreamProcess(), output is delayed  by
+S.BlockSize samples.
+*************************************************************************/
+void corrr1dstreamcreate(const ap::real_1d_array& pattern,
+     int m,
+     int blocksize,
+     int method,
+     convr1dstream& s);
+
+
 #endif
 
@@ -20,8 +20,30 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "correlation.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const int corrtopkblocksize = 128;
+static const double corrparallelwork = 262144.0;
 
 static void rankx(ap::real_1d_array& x, int n);
+static void corrprepare(const ap::real_2d_array& x,
+     int n,
+     int m,
+     bool ranks,
+     ap::real_2d_array& z);
+static void corrmatrix(const ap::real_2d_array& z,
+     int n,
+     int m,
+     ap::real_2d_array& c);
+static void corrtopk(const ap::real_2d_array& z,
+     int n,
+     int m,
+     int k,
+     ap::integer_2d_array& idx,
+     ap::real_2d_array& c);
+static bool corrparallel(double work);
 
 /*************************************************************************
 Pearson product-moment correlation coefficient
@@ -125,6 +147,76 @@ double spearmanrankcorrelation(ap::real_1d_array x,
 }
 
 
+/*************************************************************************
+Pearson product-moment correlation matrix
+*************************************************************************/
+void pearsoncorrm(const ap::real_2d_array& x,
+     int n,
+     int m,
+     ap::real_2d_array& c)
+{
+    ap::real_2d_array z;
+
+    ap::ap_error::make_assertion(n>=0&&m>=1, "PearsonCorrM: incorrect N or M!");
+    corrprepare(x, n, m, false, z);
+    corrmatrix(z, ap::maxint(n, 1), m, c);
+}
+
+
+/*************************************************************************
+Spearman's rank correlation matrix
+*************************************************************************/
+void spearmancorrm(const ap::real_2d_array& x,
+     int n,
+     int m,
+     ap::real_2d_array& c)
+{
+    ap::real_2d_array z;
+
+    ap::ap_error::make_assertion(n>=0&&m>=1, "SpearmanCorrM: incorrect N or M!");
+    corrprepare(x, n, m, true, z);
+    corrmatrix(z, ap::maxint(n, 1), m, c);
+}
+
+
+/*************************************************************************
+K strongest Pearson correlations for each variable
+*************************************************************************/
+void pearsoncorrtopk(const ap::real_2d_array& x,
+     int n,
+     int m,
+     int k,
+     ap::integer_2d_array& idx,
+     ap::real_2d_array& c)
+{
+    ap::real_2d_array z;
+
+    ap::ap_error::make_assertion(n>=0&&m>=2, "PearsonCorrTopK: incorrect N or M!");
+    ap::ap_error::make_assertion(k>=1&&k<=m-1, "PearsonCorrTopK: incorrect K!");
+    corrprepare(x, n, m, false, z);
+    corrtopk(z, ap::maxint(n, 1), m, k, idx, c);
+}
+
+
+/*************************************************************************
+K strongest Spearman's rank correlations for each variable
+*************************************************************************/
+void spearmancorrtopk(const ap::real_2d_array& x,
+     int n,
+     int m,
+     int k,
+     ap::integer_2d_array& idx,
+     ap::real_2d_array& c)
+{
+    ap::real_2d_array z;
+
+    ap::ap_error::make_assertion(n>=0&&m>=2, "SpearmanCorrTopK: incorrect N or M!");
+    ap::ap_error::make_assertion(k>=1&&k<=m-1, "SpearmanCorrTopK: incorrect K!");
+    corrprepare(x, n, m, true, z);
+    corrtopk(z, ap::maxint(n, 1), m, k, idx, c);
+}
+
+
 /*************************************************************************
 Internal ranking subroutine
 *************************************************************************/
@@ -133,9 +225,6 @@ static void rankx(ap::real_1d_array& x, int n)
     int i;
     int j;
     int k;
-    int t;
-    double tmp;
-    int tmpi;
     ap::real_1d_array r;
     ap::integer_1d_array c;
 
@@ -159,79 +248,7 @@ static void rankx(ap::real_1d_array& x, int n)
     //
     // sort {R, C}
     //
-    if( n!=1 )
-    {
-        i = 2;
-        do
-        {
-            t = i;
-            while(t!=1)
-            {
-                k = t/2;
-                if( ap::fp_greater_eq(r(k-1),r(t-1)) )
-                {
-                    t = 1;
-                }
-                else
-                {
-                    tmp = r(k-1);
-                    r(k-1) = r(t-1);
-                    r(t-1) = tmp;
-                    tmpi = c(k-1);
-                    c(k-1) = c(t-1);
-                    c(t-1) = tmpi;
-                    t = k;
-                }
-            }
-            i = i+1;
-        }
-        while(i<=n);
-        i = n-1;
-        do
-        {
-            tmp = r(i);
-            r(i) = r(0);
-            r(0) = tmp;
-            tmpi = c(i);
-            c(i) = c(0);
-            c(0) = tmpi;
-            t = 1;
-            while(t!=0)
-            {
-                k = 2*t;
-                if( k>i )
-                {
-                    t = 0;
-                }
-                else
-                {
-                    if( k<i )
-                    {
-                        if( ap::fp_greater(r(k),r(k-1)) )
-                        {
-                            k = k+1;
-                        }
-                    }
-                    if( ap::fp_greater_eq(r(t-1),r(k-1)) )
-                    {
-                        t = 0;
-                    }
-                    else
-                    {
-                        tmp = r(k-1);
-                        r(k-1) = r(t-1);
-                        r(t-1) = tmp;
-                        tmpi = c(k-1);
-                        c(k-1) = c(t-1);
-                        c(t-1) = tmpi;
-                        t = k;
-                    }
-                }
-            }
-            i = i-1;
-        }
-        while(i>=1);
-    }
+    tagsortfasti(r, c, n);
     
     //
     // compute tied ranks
@@ -265,5 +282,197 @@ static void rankx(ap::real_1d_array& x, int n)
 }
 
 
+/*************************************************************************
+Centered and normalized variables: Z[J,0..N-1] is J-th column of X (or its
+ranks, if Ranks=True) minus its mean, divided by its norm; zero row for the
+constant variable or N<=1. Correlations are dot products of rows of Z.
+
+Z is array[0..M-1,0..max(N,1)-1]. Columns are processed in parallel.
+*************************************************************************/
+static void corrprepare(const ap::real_2d_array& x,
+     int n,
+     int m,
+     bool ranks,
+     ap::real_2d_array& z)
+{
+    double work;
+    int j;
+
+    z.setlength(m, ap::maxint(n, 1));
+    work = double(n)*double(m);
+    if( ranks )
+    {
+        work = work*ap::maxreal(log(double(ap::maxint(n, 2))), 1.0);
+    }
+    #pragma omp parallel if( corrparallel(work) )
+    {
+        ap::real_1d_array t;
+        double mean;
+        double v;
+        int i;
+
+        t.setlength(ap::maxint(n, 1));
+        #pragma omp for schedule(static)
+        for(j = 0; j <= m-1; j++)
+        {
+            for(i = 0; i <= n-1; i++)
+            {
+                t(i) = x(i,j);
+            }
+            if( ranks&&n>=1 )
+            {
+                rankx(t, n);
+            }
+            mean = 0;
+            for(i = 0; i <= n-1; i++)
+            {
+                mean = mean+t(i);
+            }
+            mean = mean/ap::maxint(n, 1);
+            v = 0;
+            for(i = 0; i <= n-1; i++)
+            {
+                t(i) = t(i)-mean;
+                v = v+ap::sqr(t(i));
+            }
+            if( n<=1||ap::fp_eq(v,0) )
+            {
+                for(i = 0; i <= ap::maxint(n, 1)-1; i++)
+                {
+                    z(j,i) = 0;
+                }
+                continue;
+            }
+            v = 1/sqrt(v);
+            for(i = 0; i <= n-1; i++)
+            {
+                z(j,i) = t(i)*v;
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+Full correlation matrix C = Z*Z' (upper triangle by RMatrixSYRK, then
+copied to the lower one)
+*************************************************************************/
+static void corrmatrix(const ap::real_2d_array& z,
+     int n,
+     int m,
+     ap::real_2d_array& c)
+{
+    int i;
+    int j;
+
+    c.setlength(m, m);
+    rmatrixsyrk(m, n, 1.0, z, 0, 0, 0, 0.0, c, 0, 0, true);
+    for(i = 0; i <= m-1; i++)
+    {
+        for(j = i+1; j <= m-1; j++)
+        {
+            c(j,i) = c(i,j);
+        }
+    }
+}
+
+
+/*************************************************************************
+K strongest correlations for each row of C = Z*Z'.
+
+C is calculated by blocks of CorrTopKBlockSize rows; blocks are processed
+in parallel (RMatrixGEMM is serial inside parallel region), each thread
+has its own block buffer. Row of the block is scanned with a heap of K
+elements with keys -|C[I,J]| (its top is the weakest of K strongest
+correlations found so far).
+*************************************************************************/
+static void corrtopk(const ap::real_2d_array& z,
+     int n,
+     int m,
+     int k,
+     ap::integer_2d_array& idx,
+     ap::real_2d_array& c)
+{
+    int nblocks;
+    int b;
+
+    idx.setlength(m, k);
+    c.setlength(m, k);
+    nblocks = (m+corrtopkblocksize-1)/corrtopkblocksize;
+    #pragma omp parallel if( nblocks>1&&corrparallel(double(m)*double(m)*double(n)) )
+    {
+        ap::real_2d_array cb;
+        ap::real_1d_array ha;
+        ap::integer_1d_array hb;
+        int i1;
+        int cnt;
+        int hn;
+        int i;
+        int j;
+        double v;
+
+        cb.setlength(ap::minint(corrtopkblocksize, m), m);
+        ha.setlength(k+1);
+        hb.setlength(k+1);
+        #pragma omp for schedule(dynamic,1)
+        for(b = 0; b <= nblocks-1; b++)
+        {
+            i1 = b*corrtopkblocksize;
+            cnt = ap::minint(corrtopkblocksize, m-i1);
+            rmatrixgemm(cnt, m, n, 1.0, z, i1, 0, 0, z, 0, 0, 1, 0.0, cb, 0, 0);
+            for(i = 0; i <= cnt-1; i++)
+            {
+                hn = 0;
+                for(j = 0; j <= m-1; j++)
+                {
+                    if( j==i1+i )
+                    {
+                        continue;
+                    }
+                    v = -fabs(cb(i,j));
+                    if( hn<k )
+                    {
+                        tagheappushi(ha, hb, hn, v, j);
+                        continue;
+                    }
+                    if( v<ha(0) )
+                    {
+                        tagheapreplacetopi(ha, hb, hn, v, j);
+                    }
+                }
+                
+                //
+                // Pop weakest elements to the end
+                //
+                while( hn>0 )
+                {
+                    tagheappopi(ha, hb, hn);
+                }
+                for(j = 0; j <= k-1; j++)
+                {
+                    idx(i1+i,j) = hb(j);
+                    c(i1+i,j) = cb(i,hb(j));
+                }
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool corrparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,corrparallelwork);
+#endif
+    return result;
+}
 
 
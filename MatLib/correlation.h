@@ -23,6 +23,9 @@ http://www.fsf.org/licensing/licenses
 
 #include "ap.h"
 #include "ialglib.h"
+#include "tsort.h"
+#include "ablasf.h"
+#include "ablas.h"
 
 /*************************************************************************
 Pearson product-moment correlation coefficient
@@ -62,5 +65,91 @@ double spearmanrankcorrelation(ap::real_1d_array x,
      int n);
 
 
+/*************************************************************************
+Pearson product-moment correlation matrix
+
+Correlations between all pairs of variables (columns of X). Each column
+is centered and normalized once, then matrix is calculated as Z'*Z by the
+symmetric rank-K update (RMatrixSYRK), which is blocked and parallel.
+
+Input parameters:
+    X       -   sample, array[0..N-1,0..M-1]: N observations (rows) of
+                M variables (columns)
+    N       -   sample size, N>=0
+    M       -   number of variables, M>=1
+
+Output parameters:
+    C       -   array[0..M-1,0..M-1], correlation matrix. Correlation with
+                the constant variable is zero (same as PearsonCorrelation).
+*************************************************************************/
+void pearsoncorrm(const ap::real_2d_array& x,
+     int n,
+     int m,
+     ap::real_2d_array& c);
+
+
+/*************************************************************************
+Spearman's rank correlation matrix
+
+Same as PearsonCorrM, but each column of X is replaced by its ranks
+(calculated once per column) before calculation of correlations.
+
+Input parameters:
+    X       -   sample, array[0..N-1,0..M-1]: N observations (rows) of
+                M variables (columns)
+    N       -   sample size, N>=0
+    M       -   number of variables, M>=1
+
+Output parameters:
+    C       -   array[0..M-1,0..M-1], correlation matrix
+*************************************************************************/
+void spearmancorrm(const ap::real_2d_array& x,
+     int n,
+     int m,
+     ap::real_2d_array& c);
+
+
+/*************************************************************************
+K strongest Pearson correlations for each variable
+
+For each variable (column of X) finds K other variables with largest
+absolute values of correlation. Full correlation matrix is not stored:
+it is calculated by blocks of rows (RMatrixGEMM), blocks are processed in
+parallel, each block is scanned immediately.
+
+Input parameters:
+    X       -   sample, array[0..N-1,0..M-1]: N observations (rows) of
+                M variables (columns)
+    N       -   sample size, N>=0
+    M       -   number of variables, M>=2
+    K       -   number of correlations per variable, 1<=K<=M-1
+
+Output parameters:
+    Idx     -   array[0..M-1,0..K-1], Idx[I,J] is a number of the J-th
+                strongest correlated with I-th variable
+    C       -   array[0..M-1,0..K-1], C[I,J] is a correlation between I-th
+                and Idx[I,J]-th variables. |C[I,0]|>=|C[I,1]|>=...
+*************************************************************************/
+void pearsoncorrtopk(const ap::real_2d_array& x,
+     int n,
+     int m,
+     int k,
+     ap::integer_2d_array& idx,
+     ap::real_2d_array& c);
+
+
+/*************************************************************************
+K strongest Spearman's rank correlations for each variable
+
+Same as PearsonCorrTopK, but for rank correlations.
+*************************************************************************/
+void spearmancorrtopk(const ap::real_2d_array& x,
+     int n,
+     int m,
+     int k,
+     ap::integer_2d_array& idx,
+     ap::real_2d_array& c);
+
+
 #endif
 
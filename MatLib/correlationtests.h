@@ -28,6 +28,9 @@ http://www.fsf.org/licensing/licenses
 #include "normaldistr.h"
 #include "ibetaf.h"
 #include "studenttdistr.h"
+#include "tsort.h"
+#include "ablasf.h"
+#include "ablas.h"
 #include "correlation.h"
 
 
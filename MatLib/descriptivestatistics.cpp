@@ -20,8 +20,34 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "descriptivestatistics.h"
-
-static void internalstatheapsort(ap::real_1d_array& arr, int n);
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const int statchunksize = 4096;
+static const int statselectsmall = 16;
+static const double statparallelwork = 262144.0;
+
+static void statmomentschunk(const ap::real_1d_array& x,
+     int i1,
+     int cnt,
+     statmomentsstate& s);
+static void statmomentsmergeinternal(double& na,
+     double& meana,
+     double& m2a,
+     double& m3a,
+     double& m4a,
+     double nb,
+     double meanb,
+     double m2b,
+     double m3b,
+     double m4b);
+static void internalstatselect(ap::real_1d_array& x, int l, int r, int k);
+static double internalstatmedianofmedians(ap::real_1d_array& x, int l, int r);
+static void internalstatinssort(ap::real_1d_array& x, int l, int r);
+static void tdigestflush(tdigeststate& state);
+static void tdigestappend(tdigeststate& state, double v, double w);
+static bool statparallel(double work);
 
 /*************************************************************************
 Calculation of the distribution moments: mean, variance, slewness, kurtosis.
@@ -46,69 +72,176 @@ void calculatemoments(const ap::real_1d_array& x,
      double& skewness,
      double& kurtosis)
 {
-    int i;
-    double v;
-    double v1;
-    double v2;
-    double stddev;
+    statmomentsstate state;
+
+    
+    //
+    // Single pass over X, see StatMomentsUpdate()
+    //
+    statmomentscreate(state);
+    statmomentsupdate(state, x, n);
+    statmomentsresults(state, mean, variance, skewness, kurtosis);
+}
+
+
+/*************************************************************************
+Initialization of the moments accumulator.
+
+OUTPUT PARAMETERS:
+    State   -   empty accumulator
+*************************************************************************/
+void statmomentscreate(statmomentsstate& state)
+{
+    state.n = 0;
+    state.mean = 0;
+    state.m2 = 0;
+    state.m3 = 0;
+    state.m4 = 0;
+}
+
+
+/*************************************************************************
+Adds one point to the moments accumulator.
+*************************************************************************/
+void statmomentsadd(statmomentsstate& state, double v)
+{
+    double n1;
+    double delta;
+    double dn;
+    double dn2;
+    double t;
+
+    n1 = state.n;
+    state.n = state.n+1;
+    delta = v-state.mean;
+    dn = delta/state.n;
+    dn2 = dn*dn;
+    t = delta*dn*n1;
+    state.mean = state.mean+dn;
+    state.m4 = state.m4+t*dn2*(state.n*state.n-3*state.n+3)+6*dn2*state.m2-4*dn*state.m3;
+    state.m3 = state.m3+t*dn*(state.n-2)-3*dn*state.m2;
+    state.m2 = state.m2+t;
+}
+
+
+/*************************************************************************
+Adds points X[0..N-1] to the moments accumulator.
+
+Points are processed by chunks of fixed size: moments of each chunk are
+calculated with two passes over the chunk (which is in the cache), then
+chunks are merged pairwise. Chunks are distributed between threads when
+OpenMP is on; result does not depend on the number of threads.
+*************************************************************************/
+void statmomentsupdate(statmomentsstate& state,
+     const ap::real_1d_array& x,
+     int n)
+{
+    statmomentsstate s;
+    ap::real_2d_array part;
+    int nchunks;
+    int c;
+    int step;
 
-    mean = 0;
-    variance = 0;
-    skewness = 0;
-    kurtosis = 0;
-    stddev = 0;
     if( n<=0 )
     {
         return;
     }
+    nchunks = (n+statchunksize-1)/statchunksize;
+    if( nchunks==1 )
+    {
+        statmomentschunk(x, 0, n, s);
+        statmomentsmerge(state, s);
+        return;
+    }
     
     //
-    // Mean
+    // Moments of chunks
     //
-    for(i = 0; i <= n-1; i++)
+    part.setlength(nchunks, 5);
+    #pragma omp parallel for schedule(static) if( statparallel(double(n)) )
+    for(c = 0; c <= nchunks-1; c++)
     {
-        mean = mean+x(i);
+        statmomentsstate cs;
+
+        statmomentschunk(x, c*statchunksize, ap::minint(statchunksize, n-c*statchunksize), cs);
+        part(c,0) = cs.n;
+        part(c,1) = cs.mean;
+        part(c,2) = cs.m2;
+        part(c,3) = cs.m3;
+        part(c,4) = cs.m4;
     }
-    mean = mean/n;
     
     //
-    // Variance (using corrected two-pass algorithm)
+    // Pairwise merge: errors grow as O(log(NChunks)), not O(NChunks)
     //
-    if( n!=1 )
+    for(step = 1; step <= nchunks-1; step = 2*step)
     {
-        v1 = 0;
-        for(i = 0; i <= n-1; i++)
+        for(c = 0; c+step <= nchunks-1; c = c+2*step)
         {
-            v1 = v1+ap::sqr(x(i)-mean);
+            statmomentsmergeinternal(part(c,0), part(c,1), part(c,2), part(c,3), part(c,4), part(c+step,0), part(c+step,1), part(c+step,2), part(c+step,3), part(c+step,4));
         }
-        v2 = 0;
-        for(i = 0; i <= n-1; i++)
-        {
-            v2 = v2+(x(i)-mean);
-        }
-        v2 = ap::sqr(v2)/n;
-        variance = (v1-v2)/(n-1);
+    }
+    s.n = part(0,0);
+    s.mean = part(0,1);
+    s.m2 = part(0,2);
+    s.m3 = part(0,3);
+    s.m4 = part(0,4);
+    statmomentsmerge(state, s);
+}
+
+
+/*************************************************************************
+Merges accumulator State2 into State: result is the same as if all points
+added to State2 were added to State.
+*************************************************************************/
+void statmomentsmerge(statmomentsstate& state,
+     const statmomentsstate& state2)
+{
+    statmomentsmergeinternal(state.n, state.mean, state.m2, state.m3, state.m4, state2.n, state2.mean, state2.m2, state2.m3, state2.m4);
+}
+
+
+/*************************************************************************
+Moments of the accumulated sample, same definitions as in
+CalculateMoments().
+
+OUTPUT PARAMETERS:
+    Mean    -   mean.
+    Variance-   variance.
+    Skewness-   skewness (if variance<>0; zero otherwise).
+    Kurtosis-   kurtosis (if variance<>0; zero otherwise).
+*************************************************************************/
+void statmomentsresults(const statmomentsstate& state,
+     double& mean,
+     double& variance,
+     double& skewness,
+     double& kurtosis)
+{
+    double stddev;
+
+    mean = 0;
+    variance = 0;
+    skewness = 0;
+    kurtosis = 0;
+    stddev = 0;
+    if( ap::fp_less_eq(state.n,0) )
+    {
+        return;
+    }
+    mean = state.mean;
+    if( ap::fp_greater(state.n,1) )
+    {
+        variance = state.m2/(state.n-1);
         if( ap::fp_less(variance,0) )
         {
             variance = 0;
         }
         stddev = sqrt(variance);
     }
-    
-    //
-    // Skewness and kurtosis
-    //
     if( ap::fp_neq(stddev,0) )
     {
-        for(i = 0; i <= n-1; i++)
-        {
-            v = (x(i)-mean)/stddev;
-            v2 = ap::sqr(v);
-            skewness = skewness+v2*v;
-            kurtosis = kurtosis+ap::sqr(v2);
-        }
-        skewness = skewness/n;
-        kurtosis = kurtosis/n-3;
+        skewness = state.m3/state.n/(stddev*stddev*stddev);
+        kurtosis = state.m4/state.n/ap::sqr(variance)-3;
     }
 }
 
@@ -128,8 +261,11 @@ Output parameters:
 *************************************************************************/
 void calculateadev(const ap::real_1d_array& x, int n, double& adev)
 {
-    int i;
+    statmomentsstate state;
+    ap::real_1d_array part;
     double mean;
+    int nchunks;
+    int c;
 
     mean = 0;
     adev = 0;
@@ -141,18 +277,34 @@ void calculateadev(const ap::real_1d_array& x, int n, double& adev)
     //
     // Mean
     //
-    for(i = 0; i <= n-1; i++)
-    {
-        mean = mean+x(i);
-    }
-    mean = mean/n;
+    statmomentscreate(state);
+    statmomentsupdate(state, x, n);
+    mean = state.mean;
     
     //
-    // ADev
+    // ADev: sums over chunks are added in the fixed order, so result
+    // does not depend on the number of threads
     //
-    for(i = 0; i <= n-1; i++)
+    nchunks = (n+statchunksize-1)/statchunksize;
+    part.setlength(nchunks);
+    #pragma omp parallel for schedule(static) if( nchunks>1&&statparallel(double(n)) )
+    for(c = 0; c <= nchunks-1; c++)
     {
-        adev = adev+fabs(x(i)-mean);
+        double v;
+        int i;
+        int i2;
+
+        v = 0;
+        i2 = ap::minint(c*statchunksize+statchunksize, n)-1;
+        for(i = c*statchunksize; i <= i2; i++)
+        {
+            v = v+fabs(x(i)-mean);
+        }
+        part(c) = v;
+    }
+    for(c = 0; c <= nchunks-1; c++)
+    {
+        adev = adev+part(c);
     }
     adev = adev/n;
 }
@@ -161,6 +313,10 @@ void calculateadev(const ap::real_1d_array& x, int n, double& adev)
 /*************************************************************************
 Median calculation.
 
+Median is found by selection (introselect: quickselect with median-of-3
+pivot, switching to median-of-medians when partitioning degrades), which
+is O(N) in the worst case.
+
 Input parameters:
     X   -   sample (array indexes: [0..N-1])
     N   -   sample size
@@ -174,13 +330,8 @@ Output parameters:
 void calculatemedian(ap::real_1d_array x, int n, double& median)
 {
     int i;
-    int ir;
-    int j;
-    int l;
-    int midp;
     int k;
     double a;
-    double tval;
 
     
     //
@@ -206,84 +357,8 @@ void calculatemedian(ap::real_1d_array x, int n, double& median)
     // Common case, N>=3.
     // Choose X[(N-1)/2]
     //
-    l = 0;
-    ir = n-1;
     k = (n-1)/2;
-    while(true)
-    {
-        if( ir<=l+1 )
-        {
-            
-            //
-            // 1 or 2 elements in partition
-            //
-            if( ir==l+1&&ap::fp_less(x(ir),x(l)) )
-            {
-                tval = x(l);
-                x(l) = x(ir);
-                x(ir) = tval;
-            }
-            break;
-        }
-        else
-        {
-            midp = (l+ir)/2;
-            tval = x(midp);
-            x(midp) = x(l+1);
-            x(l+1) = tval;
-            if( ap::fp_greater(x(l),x(ir)) )
-            {
-                tval = x(l);
-                x(l) = x(ir);
-                x(ir) = tval;
-            }
-            if( ap::fp_greater(x(l+1),x(ir)) )
-            {
-                tval = x(l+1);
-                x(l+1) = x(ir);
-                x(ir) = tval;
-            }
-            if( ap::fp_greater(x(l),x(l+1)) )
-            {
-                tval = x(l);
-                x(l) = x(l+1);
-                x(l+1) = tval;
-            }
-            i = l+1;
-            j = ir;
-            a = x(l+1);
-            while(true)
-            {
-                do
-                {
-                    i = i+1;
-                }
-                while(ap::fp_less(x(i),a));
-                do
-                {
-                    j = j-1;
-                }
-                while(ap::fp_greater(x(j),a));
-                if( j<i )
-                {
-                    break;
-                }
-                tval = x(i);
-                x(i) = x(j);
-                x(j) = tval;
-            }
-            x(l+1) = x(j);
-            x(j) = a;
-            if( j>=k )
-            {
-                ir = j-1;
-            }
-            if( j<=k )
-            {
-                l = i;
-            }
-        }
-    }
+    internalstatselect(x, 0, n-1, k);
     
     //
     // If N is odd, return result
@@ -308,6 +383,9 @@ void calculatemedian(ap::real_1d_array x, int n, double& median)
 /*************************************************************************
 Percentile calculation.
 
+Order statistics are found by selection (see CalculateMedian()), which is
+O(N) instead of O(N*logN) for sorting.
+
 Input parameters:
     X   -   sample (array indexes: [0..N-1])
     N   -   sample size, N>1
@@ -321,103 +399,609 @@ Output parameters:
 *************************************************************************/
 void calculatepercentile(ap::real_1d_array x, int n, double p, double& v)
 {
+    int i;
     int i1;
     double t;
+    double a;
 
     ap::ap_error::make_assertion(n>1, "CalculatePercentile: N<=1!");
     ap::ap_error::make_assertion(ap::fp_greater_eq(p,0)&&ap::fp_less_eq(p,1), "CalculatePercentile: incorrect P!");
-    internalstatheapsort(x, n);
     if( ap::fp_eq(p,0) )
     {
         v = x(0);
+        for(i = 1; i <= n-1; i++)
+        {
+            if( ap::fp_less(x(i),v) )
+            {
+                v = x(i);
+            }
+        }
         return;
     }
     if( ap::fp_eq(p,1) )
     {
-        v = x(n-1);
+        v = x(0);
+        for(i = 1; i <= n-1; i++)
+        {
+            if( ap::fp_greater(x(i),v) )
+            {
+                v = x(i);
+            }
+        }
         return;
     }
     t = p*(n-1);
-    i1 = ap::ifloor(t);
-    t = t-ap::ifloor(t);
-    v = x(i1)*(1-t)+x(i1+1)*t;
+    i1 = ap::minint(ap::ifloor(t), n-2);
+    t = t-i1;
+    
+    //
+    // X[I1] and the smallest element to the right of it are
+    // order statistics number I1 and I1+1
+    //
+    internalstatselect(x, 0, n-1, i1);
+    a = x(i1+1);
+    for(i = i1+2; i <= n-1; i++)
+    {
+        if( ap::fp_less(x(i),a) )
+        {
+            a = x(i);
+        }
+    }
+    v = x(i1)*(1-t)+a*t;
+}
+
+
+/*************************************************************************
+Creation of the streaming quantile sketch (t-digest).
+
+INPUT PARAMETERS:
+    Compression -   accuracy parameter, Compression>=10 (or zero for the
+                    default value, 100). Sketch keeps about Compression
+                    centroids, rank error of the median is about
+                    1/Compression, of the extreme quantiles - much less.
+
+OUTPUT PARAMETERS:
+    State       -   empty sketch
+*************************************************************************/
+void tdigestcreate(double compression, tdigeststate& state)
+{
+    ap::ap_error::make_assertion(ap::fp_eq(compression,0)||ap::fp_greater_eq(compression,10), "TDigestCreate: incorrect Compression!");
+    if( ap::fp_eq(compression,0) )
+    {
+        compression = 100;
+    }
+    state.compression = compression;
+    state.total = 0;
+    state.minv = 0;
+    state.maxv = 0;
+    state.ncentroids = 0;
+    state.nbuf = 0;
+    state.bufsize = 5*ap::iceil(compression);
+    state.cmean.setlength(2*ap::iceil(compression)+state.bufsize);
+    state.cweight.setlength(2*ap::iceil(compression)+state.bufsize);
+    state.tmean.setlength(2*ap::iceil(compression)+state.bufsize);
+    state.tweight.setlength(2*ap::iceil(compression)+state.bufsize);
+    state.bmean.setlength(state.bufsize);
+    state.bweight.setlength(state.bufsize);
 }
 
 
-static void internalstatheapsort(ap::real_1d_array& arr, int n)
+/*************************************************************************
+Adds one point to the sketch.
+*************************************************************************/
+void tdigestadd(tdigeststate& state, double v)
+{
+    tdigestappend(state, v, 1.0);
+}
+
+
+/*************************************************************************
+Adds points X[0..N-1] to the sketch.
+*************************************************************************/
+void tdigestupdate(tdigeststate& state, const ap::real_1d_array& x, int n)
 {
     int i;
-    int k;
-    int t;
-    double tmp;
 
-    if( n==1 )
+    for(i = 0; i <= n-1; i++)
+    {
+        tdigestappend(state, x(i), 1.0);
+    }
+}
+
+
+/*************************************************************************
+Merges sketch State2 into State.
+*************************************************************************/
+void tdigestmerge(tdigeststate& state, const tdigeststate& state2)
+{
+    double minv;
+    double maxv;
+    int i;
+
+    if( ap::fp_eq(state2.total,0) )
+    {
+        return;
+    }
+    minv = state2.minv;
+    maxv = state2.maxv;
+    if( ap::fp_greater(state.total,0) )
+    {
+        minv = ap::minreal(minv, state.minv);
+        maxv = ap::maxreal(maxv, state.maxv);
+    }
+    
+    //
+    // Centroids and pending points of State2 are added as weighted
+    // points, exact minimum and maximum are restored after it.
+    //
+    for(i = 0; i <= state2.ncentroids-1; i++)
+    {
+        tdigestappend(state, state2.cmean(i), state2.cweight(i));
+    }
+    for(i = 0; i <= state2.nbuf-1; i++)
+    {
+        tdigestappend(state, state2.bmean(i), state2.bweight(i));
+    }
+    state.minv = minv;
+    state.maxv = maxv;
+}
+
+
+/*************************************************************************
+Quantile estimate.
+
+INPUT PARAMETERS:
+    State   -   sketch, at least one point must be added
+    P       -   quantile (0<=P<=1)
+
+Result:
+    estimate of the P-quantile: exact minimum for P=0 and maximum for
+    P=1, linear interpolation between centroids otherwise.
+
+NOTE: pending points are merged into centroids, so State is changed.
+*************************************************************************/
+double tdigestquantile(tdigeststate& state, double p)
+{
+    double result;
+    double r;
+    double c0;
+    double c1;
+    double wsofar;
+    int i;
+
+    ap::ap_error::make_assertion(ap::fp_greater(state.total,0), "TDigestQuantile: sketch is empty!");
+    ap::ap_error::make_assertion(ap::fp_greater_eq(p,0)&&ap::fp_less_eq(p,1), "TDigestQuantile: incorrect P!");
+    tdigestflush(state);
+    if( ap::fp_eq(p,0) )
+    {
+        result = state.minv;
+        return result;
+    }
+    if( ap::fp_eq(p,1) )
+    {
+        result = state.maxv;
+        return result;
+    }
+    
+    //
+    // Centroid I is at rank WSoFar+CWeight[I]/2; minimum is at rank 0,
+    // maximum is at rank Total. Rank R=P*Total is interpolated between
+    // the neighbors.
+    //
+    r = p*state.total;
+    c0 = 0.5*state.cweight(0);
+    if( ap::fp_less(r,c0) )
+    {
+        result = state.minv+(state.cmean(0)-state.minv)*(r/c0);
+        return result;
+    }
+    wsofar = 0;
+    for(i = 0; i <= state.ncentroids-2; i++)
+    {
+        c0 = wsofar+0.5*state.cweight(i);
+        c1 = wsofar+state.cweight(i)+0.5*state.cweight(i+1);
+        if( ap::fp_less(r,c1) )
+        {
+            result = state.cmean(i)+(state.cmean(i+1)-state.cmean(i))*((r-c0)/(c1-c0));
+            return result;
+        }
+        wsofar = wsofar+state.cweight(i);
+    }
+    c0 = wsofar+0.5*state.cweight(state.ncentroids-1);
+    result = state.cmean(state.ncentroids-1)+(state.maxv-state.cmean(state.ncentroids-1))*((r-c0)/(state.total-c0));
+    return result;
+}
+
+
+/*************************************************************************
+Moments of X[I1..I1+Cnt-1], two passes over the chunk.
+*************************************************************************/
+static void statmomentschunk(const ap::real_1d_array& x,
+     int i1,
+     int cnt,
+     statmomentsstate& s)
+{
+    int i;
+    double d;
+    double d2;
+    double v;
+
+    s.n = cnt;
+    s.mean = 0;
+    s.m2 = 0;
+    s.m3 = 0;
+    s.m4 = 0;
+    for(i = i1; i <= i1+cnt-1; i++)
+    {
+        s.mean = s.mean+x(i);
+    }
+    s.mean = s.mean/cnt;
+    
+    //
+    // Central sums, M2 is corrected like in the two-pass algorithm
+    //
+    v = 0;
+    for(i = i1; i <= i1+cnt-1; i++)
+    {
+        d = x(i)-s.mean;
+        d2 = d*d;
+        v = v+d;
+        s.m2 = s.m2+d2;
+        s.m3 = s.m3+d2*d;
+        s.m4 = s.m4+d2*d2;
+    }
+    s.m2 = s.m2-v*v/cnt;
+    if( s.m2<0 )
     {
+        s.m2 = 0;
+    }
+}
+
+
+/*************************************************************************
+Merge of the moments (NA,MeanA,M2A..M4A) and (NB,MeanB,M2B..M4B), result
+is stored to the first set.
+*************************************************************************/
+static void statmomentsmergeinternal(double& na,
+     double& meana,
+     double& m2a,
+     double& m3a,
+     double& m4a,
+     double nb,
+     double meanb,
+     double m2b,
+     double m3b,
+     double m4b)
+{
+    double n;
+    double d;
+    double d2;
+    double nab;
+
+    if( nb==0 )
+    {
+        return;
+    }
+    if( na==0 )
+    {
+        na = nb;
+        meana = meanb;
+        m2a = m2b;
+        m3a = m3b;
+        m4a = m4b;
         return;
     }
-    i = 2;
-    do
+    n = na+nb;
+    d = meanb-meana;
+    d2 = d*d;
+    nab = na*nb;
+    m4a = m4a+m4b+d2*d2*nab*(na*na-nab+nb*nb)/(n*n*n)+6*d2*(na*na*m2b+nb*nb*m2a)/(n*n)+4*d*(na*m3b-nb*m3a)/n;
+    m3a = m3a+m3b+d2*d*nab*(na-nb)/(n*n)+3*d*(na*m2b-nb*m2a)/n;
+    m2a = m2a+m2b+d2*nab/n;
+    meana = meana+d*nb/n;
+    na = n;
+}
+
+
+/*************************************************************************
+Selection: reorders X[L..R] so that X[K] is the (K-L)-th order statistic
+of X[L..R], elements to the left are not greater, to the right - not less.
+
+Introselect: quickselect with median-of-3 pivot; after 2*log2(R-L+1)
+partitions median-of-medians pivot is used, so worst case is O(N).
+*************************************************************************/
+static void internalstatselect(ap::real_1d_array& x, int l, int r, int k)
+{
+    int i;
+    int j;
+    int depth;
+    double p;
+    double a;
+    double b;
+    double c;
+    double tmp;
+
+    depth = 0;
+    for(i = r-l+1; i>1; i = i/2)
+    {
+        depth = depth+2;
+    }
+    while(r-l>=statselectsmall)
     {
-        t = i;
-        while(t!=1)
+        
+        //
+        // Pivot
+        //
+        if( depth>0 )
         {
-            k = t/2;
-            if( ap::fp_greater_eq(arr(k-1),arr(t-1)) )
+            a = x(l);
+            b = x(l+(r-l)/2);
+            c = x(r);
+            if( ap::fp_greater(a,b) )
             {
-                t = 1;
+                tmp = a;
+                a = b;
+                b = tmp;
             }
-            else
+            if( ap::fp_greater(b,c) )
             {
-                tmp = arr(k-1);
-                arr(k-1) = arr(t-1);
-                arr(t-1) = tmp;
-                t = k;
+                b = c;
             }
+            if( ap::fp_greater(a,b) )
+            {
+                b = a;
+            }
+            p = b;
+            depth = depth-1;
         }
-        i = i+1;
-    }
-    while(i<=n);
-    i = n-1;
-    do
-    {
-        tmp = arr(i);
-        arr(i) = arr(0);
-        arr(0) = tmp;
-        t = 1;
-        while(t!=0)
+        else
+        {
+            p = internalstatmedianofmedians(x, l, r);
+        }
+        
+        //
+        // Hoare partition: [L,J]<=P, [I,R]>=P, elements between J and I
+        // are equal to P
+        //
+        i = l;
+        j = r;
+        while(i<=j)
         {
-            k = 2*t;
-            if( k>i )
+            while(ap::fp_less(x(i),p))
+            {
+                i = i+1;
+            }
+            while(ap::fp_greater(x(j),p))
             {
-                t = 0;
+                j = j-1;
+            }
+            if( i<=j )
+            {
+                tmp = x(i);
+                x(i) = x(j);
+                x(j) = tmp;
+                i = i+1;
+                j = j-1;
+            }
+        }
+        if( k<=j )
+        {
+            r = j;
+        }
+        else
+        {
+            if( k>=i )
+            {
+                l = i;
             }
             else
             {
-                if( k<i )
-                {
-                    if( ap::fp_greater(arr(k),arr(k-1)) )
-                    {
-                        k = k+1;
-                    }
-                }
-                if( ap::fp_greater_eq(arr(t-1),arr(k-1)) )
-                {
-                    t = 0;
-                }
-                else
-                {
-                    tmp = arr(k-1);
-                    arr(k-1) = arr(t-1);
-                    arr(t-1) = tmp;
-                    t = k;
-                }
+                return;
             }
         }
-        i = i-1;
     }
-    while(i>=1);
+    internalstatinssort(x, l, r);
+}
+
+
+/*************************************************************************
+Median of medians of 5-element groups of X[L..R] (value, X is reordered).
+*************************************************************************/
+static double internalstatmedianofmedians(ap::real_1d_array& x, int l, int r)
+{
+    double result;
+    int g;
+    int i;
+    int i2;
+    double tmp;
+
+    g = 0;
+    for(i = l; i <= r; i = i+5)
+    {
+        i2 = ap::minint(i+4, r);
+        internalstatinssort(x, i, i2);
+        tmp = x(l+g);
+        x(l+g) = x((i+i2)/2);
+        x((i+i2)/2) = tmp;
+        g = g+1;
+    }
+    internalstatselect(x, l, l+g-1, l+(g-1)/2);
+    result = x(l+(g-1)/2);
+    return result;
+}
+
+
+/*************************************************************************
+Insertion sort of X[L..R]
+*************************************************************************/
+static void internalstatinssort(ap::real_1d_array& x, int l, int r)
+{
+    int i;
+    int j;
+    double tmp;
+
+    for(i = l+1; i <= r; i++)
+    {
+        tmp = x(i);
+        j = i-1;
+        while(j>=l&&ap::fp_greater(x(j),tmp))
+        {
+            x(j+1) = x(j);
+            j = j-1;
+        }
+        x(j+1) = tmp;
+    }
+}
+
+
+/*************************************************************************
+Merges pending points of the sketch into centroids.
+
+Pending points are sorted and merged with the (sorted) centroids, then the
+list is scanned from left to right, neighbors are merged while the
+centroid spans no more than one unit of the scale function
+K(q)=Compression/(2*pi)*asin(2q-1), which limits the size of the
+centroids near q=0 and q=1.
+*************************************************************************/
+static void tdigestflush(tdigeststate& state)
+{
+    ap::real_1d_array t;
+    int cnt;
+    int i;
+    int j;
+    int k;
+    double wsofar;
+    double wlimit;
+    double q;
+    double w;
+
+    if( state.nbuf==0 )
+    {
+        return;
+    }
+    
+    //
+    // Make room for all centroids and points (normally there are no
+    // more than Compression centroids, it is just a safeguard)
+    //
+    cnt = state.ncentroids+state.nbuf;
+    if( cnt>state.tmean.gethighbound()+1 )
+    {
+        t.setlength(state.ncentroids);
+        ap::vmove(&t(0), 1, &state.cmean(0), 1, ap::vlen(0,state.ncentroids-1));
+        state.cmean.setlength(cnt);
+        ap::vmove(&state.cmean(0), 1, &t(0), 1, ap::vlen(0,state.ncentroids-1));
+        ap::vmove(&t(0), 1, &state.cweight(0), 1, ap::vlen(0,state.ncentroids-1));
+        state.cweight.setlength(cnt);
+        ap::vmove(&state.cweight(0), 1, &t(0), 1, ap::vlen(0,state.ncentroids-1));
+        state.tmean.setlength(cnt);
+        state.tweight.setlength(cnt);
+    }
+    
+    //
+    // Sorted list of centroids and points
+    //
+    tagsortfastr(state.bmean, state.bweight, state.nbuf);
+    i = 0;
+    j = 0;
+    for(k = 0; k <= cnt-1; k++)
+    {
+        if( j>=state.nbuf||(i<state.ncentroids&&ap::fp_less_eq(state.cmean(i),state.bmean(j))) )
+        {
+            state.tmean(k) = state.cmean(i);
+            state.tweight(k) = state.cweight(i);
+            i = i+1;
+        }
+        else
+        {
+            state.tmean(k) = state.bmean(j);
+            state.tweight(k) = state.bweight(j);
+            j = j+1;
+        }
+    }
+    
+    //
+    // Compression
+    //
+    k = 0;
+    wsofar = 0;
+    wlimit = 0;
+    for(i = 0; i <= cnt-1; i++)
+    {
+        w = state.tweight(i);
+        if( i>0&&ap::fp_less_eq(wsofar+state.cweight(k)+w,wlimit) )
+        {
+            state.cweight(k) = state.cweight(k)+w;
+            state.cmean(k) = state.cmean(k)+(state.tmean(i)-state.cmean(k))*w/state.cweight(k);
+            continue;
+        }
+        if( i>0 )
+        {
+            wsofar = wsofar+state.cweight(k);
+            k = k+1;
+        }
+        state.cmean(k) = state.tmean(i);
+        state.cweight(k) = w;
+        
+        //
+        // Limit for the new centroid: K(q_right)=K(q_left)+1
+        //
+        q = wsofar/state.total;
+        q = asin(2*q-1)+2*ap::pi()/state.compression;
+        if( ap::fp_greater_eq(q,0.5*ap::pi()) )
+        {
+            wlimit = state.total;
+        }
+        else
+        {
+            wlimit = 0.5*(sin(q)+1)*state.total;
+        }
+    }
+    state.ncentroids = k+1;
+    state.nbuf = 0;
+}
+
+
+/*************************************************************************
+Adds point V with weight W to the buffer of the sketch
+*************************************************************************/
+static void tdigestappend(tdigeststate& state, double v, double w)
+{
+    if( ap::fp_eq(state.total,0) )
+    {
+        state.minv = v;
+        state.maxv = v;
+    }
+    else
+    {
+        state.minv = ap::minreal(state.minv, v);
+        state.maxv = ap::maxreal(state.maxv, v);
+    }
+    state.bmean(state.nbuf) = v;
+    state.bweight(state.nbuf) = w;
+    state.nbuf = state.nbuf+1;
+    state.total = state.total+w;
+    if( state.nbuf==state.bufsize )
+    {
+        tdigestflush(state);
+    }
 }
 
 
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool statparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,statparallelwork);
+#endif
+    return result;
+}
 
 
@@ -24,6 +24,69 @@ http://www.fsf.org/licensing/licenses
 #include "ap.h"
 #include "ialglib.h"
 
+#include "tsort.h"
+
+
+/*************************************************************************
+Accumulator of the distribution moments.
+
+Points may be added one by one or by arrays, accumulators built on the
+different parts of the sample (chunks of the data stream, parts processed
+by different threads) may be merged. Single pass, numerically stable:
+central sums are updated by Welford's formulas (one point) and by Chan's
+pairwise formulas (merge).
+
+Fields:
+    N       -   number of points
+    Mean    -   mean
+    M2..M4  -   central sums: M2=SUM((X[i]-Mean)^2) and so on
+*************************************************************************/
+struct statmomentsstate
+{
+    double n;
+    double mean;
+    double m2;
+    double m3;
+    double m4;
+};
+
+
+/*************************************************************************
+Streaming quantile sketch (merging t-digest).
+
+Sample of any size is summarized by at most O(Compression) centroids
+(mean, weight); centroids are small near the minimum and maximum, so
+extreme quantiles are more precise than the median. Sketches built on the
+different parts of the sample may be merged.
+
+Fields:
+    Compression -   accuracy parameter
+    Total       -   number of points added (sum of weights)
+    MinV, MaxV  -   minimum and maximum
+    NCentroids  -   number of centroids, CMean[0..NCentroids-1] and
+                    CWeight[0..NCentroids-1], sorted by mean
+    NBuf        -   number of pending points, BMean[0..NBuf-1] and
+                    BWeight[0..NBuf-1]
+
+Other fields are temporaries.
+*************************************************************************/
+struct tdigeststate
+{
+    double compression;
+    double total;
+    double minv;
+    double maxv;
+    int ncentroids;
+    int nbuf;
+    int bufsize;
+    ap::real_1d_array cmean;
+    ap::real_1d_array cweight;
+    ap::real_1d_array bmean;
+    ap::real_1d_array bweight;
+    ap::real_1d_array tmean;
+    ap::real_1d_array tweight;
+};
+
 /*************************************************************************
 Calculation of the distribution moments: mean, variance, slewness, kurtosis.
 
@@ -48,6 +111,59 @@ void calculatemoments(const ap::real_1d_array& x,
      double& kurtosis);
 
 
+/*************************************************************************
+Initialization of the moments accumulator.
+
+OUTPUT PARAMETERS:
+    State   -   empty accumulator
+*************************************************************************/
+void statmomentscreate(statmomentsstate& state);
+
+
+/*************************************************************************
+Adds one point to the moments accumulator.
+*************************************************************************/
+void statmomentsadd(statmomentsstate& state, double v);
+
+
+/*************************************************************************
+Adds points X[0..N-1] to the moments accumulator.
+
+Points are processed by chunks of fixed size: moments of each chunk are
+calculated with two passes over the chunk (which is in the cache), then
+chunks are merged pairwise. Chunks are distributed between threads when
+OpenMP is on; result does not depend on the number of threads.
+*************************************************************************/
+void statmomentsupdate(statmomentsstate& state,
+     const ap::real_1d_array& x,
+     int n);
+
+
+/*************************************************************************
+Merges accumulator State2 into State: result is the same as if all points
+added to State2 were added to State.
+*************************************************************************/
+void statmomentsmerge(statmomentsstate& state,
+     const statmomentsstate& state2);
+
+
+/*************************************************************************
+Moments of the accumulated sample, same definitions as in
+CalculateMoments().
+
+OUTPUT PARAMETERS:
+    Mean    -   mean.
+    Variance-   variance.
+    Skewness-   skewness (if variance<>0; zero otherwise).
+    Kurtosis-   kurtosis (if variance<>0; zero otherwise).
+*************************************************************************/
+void statmomentsresults(const statmomentsstate& state,
+     double& mean,
+     double& variance,
+     double& skewness,
+     double& kurtosis);
+
+
 /*************************************************************************
 ADev
 
@@ -97,5 +213,54 @@ Output parameters:
 void calculatepercentile(ap::real_1d_array x, int n, double p, double& v);
 
 
+/*************************************************************************
+Creation of the streaming quantile sketch (t-digest).
+
+INPUT PARAMETERS:
+    Compression -   accuracy parameter, Compression>=10 (or zero for the
+                    default value, 100). Sketch keeps about Compression
+                    centroids, rank error of the median is about
+                    1/Compression, of the extreme quantiles - much less.
+
+OUTPUT PARAMETERS:
+    State       -   empty sketch
+*************************************************************************/
+void tdigestcreate(double compression, tdigeststate& state);
+
+
+/*************************************************************************
+Adds one point to the sketch.
+*************************************************************************/
+void tdigestadd(tdigeststate& state, double v);
+
+
+/*************************************************************************
+Adds points X[0..N-1] to the sketch.
+*************************************************************************/
+void tdigestupdate(tdigeststate& state, const ap::real_1d_array& x, int n);
+
+
+/*************************************************************************
+Merges sketch State2 into State.
+*************************************************************************/
+void tdigestmerge(tdigeststate& state, const tdigeststate& state2);
+
+
+/*************************************************************************
+Quantile estimate.
+
+INPUT PARAMETERS:
+    State   -   sketch, at least one point must be added
+    P       -   quantile (0<=P<=1)
+
+Result:
+    estimate of the P-quantile: exact minimum for P=0 and maximum for
+    P=1, linear interpolation between centroids otherwise.
+
+NOTE: pending points are merged into centroids, so State is changed.
+*************************************************************************/
+double tdigestquantile(tdigeststate& state, double p);
+
+
 #endif
 
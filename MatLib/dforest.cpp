@@ -20,12 +20,17 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "dforest.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static const int dfvnum = 8;
 static const int innernodewidth = 3;
 static const int leafnodewidth = 2;
 static const int dfusestrongsplits = 1;
 static const int dfuseevs = 2;
+static const int dfbatchblocksize = 128;
+static const double dfparallelwork = 262144.0;
 
 static int dfclserror(const decisionforest& df,
      const ap::real_2d_array& xy,
@@ -34,6 +39,23 @@ static void dfprocessinternal(const decisionforest& df,
      int offs,
      const ap::real_1d_array& x,
      ap::real_1d_array& y);
+static void dfcalcerrors(const ap::real_2d_array& xy,
+     int npoints,
+     int nvars,
+     int nclasses,
+     const ap::real_1d_array& buf,
+     const ap::integer_1d_array& cntbuf,
+     double& relclserror,
+     double& avgce,
+     double& rmserror,
+     double& avgerror,
+     double& avgrelerror);
+static int dfcompactlayout(const decisionforest& df,
+     ap::integer_1d_array& nodevar,
+     ap::real_1d_array& nodeval,
+     ap::integer_1d_array& noderight,
+     ap::integer_1d_array& treeroots);
+static bool dfparallel(double work);
 static void dfbuildtree(const ap::real_2d_array& xy,
      int npoints,
      int nvars,
@@ -107,6 +129,12 @@ OUTPUT PARAMETERS:
     Rep         -   training report, contains error on a training set
                     and out-of-bag estimates of generalization error.
 
+NOTES:
+    When OpenMP is enabled, trees are built in parallel. Each tree uses its
+    own random stream seeded from the standard RNG, so the forest does not
+    depend on the number of threads (out-of-bag estimates for regression
+    may differ in the last digits because of the summation order).
+
   -- ALGLIB --
      Copyright 19.02.2009 by Bochkanov Sergey
 *************************************************************************/
@@ -146,23 +174,18 @@ void dfbuildinternal(const ap::real_2d_array& xy,
 {
     int i;
     int j;
-    int k;
-    int tmpi;
-    int lasttreeoffs;
     int offs;
-    int ooboffs;
     int treesize;
     int nvarsinpool;
     bool useevs;
+    bool parallel;
     dfinternalbuffers bufs;
-    ap::integer_1d_array permbuf;
+    hqrndstate rs;
+    ap::integer_1d_array treesizes;
     ap::real_1d_array oobbuf;
     ap::integer_1d_array oobcntbuf;
-    ap::real_2d_array xys;
-    ap::real_1d_array x;
-    ap::real_1d_array y;
-    int oobcnt;
-    int oobrelcnt;
+    ap::boolean_2d_array oobflags;
+    ap::real_2d_array ytrn;
     double v;
     double vmin;
     double vmax;
@@ -199,26 +222,14 @@ void dfbuildinternal(const ap::real_2d_array& xy,
     // Allocate data, prepare header
     //
     treesize = 1+innernodewidth*(samplesize-1)+leafnodewidth*samplesize;
-    permbuf.setbounds(0, npoints-1);
-    bufs.treebuf.setbounds(0, treesize-1);
-    bufs.idxbuf.setbounds(0, npoints-1);
-    bufs.tmpbufr.setbounds(0, npoints-1);
-    bufs.tmpbufr2.setbounds(0, npoints-1);
-    bufs.tmpbufi.setbounds(0, npoints-1);
     bufs.varpool.setbounds(0, nvars-1);
     bufs.evsbin.setbounds(0, nvars-1);
     bufs.evssplits.setbounds(0, nvars-1);
-    bufs.classibuf.setbounds(0, 2*nclasses-1);
     oobbuf.setbounds(0, nclasses*npoints-1);
     oobcntbuf.setbounds(0, npoints-1);
+    oobflags.setbounds(0, ntrees-1, 0, npoints-1);
     df.trees.setbounds(0, ntrees*treesize-1);
-    xys.setbounds(0, samplesize-1, 0, nvars);
-    x.setbounds(0, nvars-1);
-    y.setbounds(0, nclasses-1);
-    for(i = 0; i <= npoints-1; i++)
-    {
-        permbuf(i) = i;
-    }
+    treesizes.setbounds(0, ntrees-1);
     for(i = 0; i <= npoints*nclasses-1; i++)
     {
         oobbuf(i) = 0;
@@ -319,50 +330,132 @@ void dfbuildinternal(const ap::real_2d_array& xy,
     df.ntrees = ntrees;
     
     //
-    // Build forest
+    // I-th tree uses I-th substream of the counter-based generator,
+    // so the forest does not depend on the order in which trees are built.
     //
-    offs = 0;
-    for(i = 0; i <= ntrees-1; i++)
+    hqrndphiloxrandomize(rs);
+    
+    //
+    // Build forest.
+    //
+    // I-th tree is built in the I-th slot of the DF.Trees (TreeSize elements
+    // is enough for any tree), so trees may be built by different threads.
+    // Each thread has its own buffers; variable pool and sample permutation
+    // are reset before each tree. Each tree only marks its OOB points;
+    // OOB sums are calculated after all trees are built, point by point
+    // with trees taken in order, so they do not depend on the number of
+    // threads either.
+    //
+    parallel = ntrees>1&&dfparallel(double(ntrees)*double(samplesize)*double(nfeatures));
+    #pragma omp parallel if( parallel )
     {
-        
-        //
-        // Prepare sample
-        //
-        for(k = 0; k <= samplesize-1; k++)
+        dfinternalbuffers tbufs;
+        ap::integer_1d_array permbuf;
+        ap::real_2d_array xys;
+        ap::real_1d_array x;
+        ap::real_1d_array y;
+        int t;
+        int ti;
+        int tj;
+        int tk;
+        int toffs;
+
+        tbufs.treebuf.setbounds(0, treesize-1);
+        tbufs.idxbuf.setbounds(0, npoints-1);
+        tbufs.tmpbufr.setbounds(0, npoints-1);
+        tbufs.tmpbufr2.setbounds(0, npoints-1);
+        tbufs.tmpbufi.setbounds(0, npoints-1);
+        tbufs.varpool.setbounds(0, nvars-1);
+        tbufs.evsbin = bufs.evsbin;
+        tbufs.evssplits = bufs.evssplits;
+        tbufs.classibuf.setbounds(0, 2*nclasses-1);
+        permbuf.setbounds(0, npoints-1);
+        xys.setbounds(0, samplesize-1, 0, nvars);
+        x.setbounds(0, nvars-1);
+        y.setbounds(0, nclasses-1);
+        #pragma omp for schedule(dynamic,1)
+        for(t = 0; t <= ntrees-1; t++)
         {
-            j = k+ap::randominteger(npoints-k);
-            tmpi = permbuf(k);
-            permbuf(k) = permbuf(j);
-            permbuf(j) = tmpi;
-            j = permbuf(k);
-            ap::vmove(&xys(k, 0), 1, &xy(j, 0), 1, ap::vlen(0,nvars));
+            hqrndsubstream(rs, t, tbufs.rs);
+            for(ti = 0; ti <= nvars-1; ti++)
+            {
+                tbufs.varpool(ti) = bufs.varpool(ti);
+            }
+            for(ti = 0; ti <= npoints-1; ti++)
+            {
+                permbuf(ti) = ti;
+            }
+            
+            //
+            // Prepare sample
+            //
+            for(tk = 0; tk <= samplesize-1; tk++)
+            {
+                tj = tk+hqrnduniformi(npoints-tk, tbufs.rs);
+                ti = permbuf(tk);
+                permbuf(tk) = permbuf(tj);
+                permbuf(tj) = ti;
+                tj = permbuf(tk);
+                ap::vmove(&xys(tk, 0), 1, &xy(tj, 0), 1, ap::vlen(0,nvars));
+            }
+            
+            //
+            // build tree, copy to its slot
+            //
+            dfbuildtree(xys, samplesize, nvars, nclasses, nfeatures, nvarsinpool, flags, tbufs);
+            toffs = t*treesize;
+            treesizes(t) = ap::round(tbufs.treebuf(0));
+            ap::vmove(&df.trees(toffs), 1, &tbufs.treebuf(0), 1, ap::vlen(toffs,toffs+treesizes(t)-1));
+            
+            //
+            // mark OOB points
+            //
+            for(tk = 0; tk <= samplesize-1; tk++)
+            {
+                oobflags(t, permbuf(tk)) = false;
+            }
+            for(tk = samplesize; tk <= npoints-1; tk++)
+            {
+                oobflags(t, permbuf(tk)) = true;
+            }
         }
         
         //
-        // build tree, copy
+        // OOB estimates (trees are still in their slots)
         //
-        dfbuildtree(xys, samplesize, nvars, nclasses, nfeatures, nvarsinpool, flags, bufs);
-        j = ap::round(bufs.treebuf(0));
-        ap::vmove(&df.trees(offs), 1, &bufs.treebuf(0), 1, ap::vlen(offs,offs+j-1));
-        lasttreeoffs = offs;
-        offs = offs+j;
-        
-        //
-        // OOB estimates
-        //
-        for(k = samplesize; k <= npoints-1; k++)
+        #pragma omp for schedule(static)
+        for(ti = 0; ti <= npoints-1; ti++)
         {
-            for(j = 0; j <= nclasses-1; j++)
+            ap::vmove(&x(0), 1, &xy(ti, 0), 1, ap::vlen(0,nvars-1));
+            for(t = 0; t <= ntrees-1; t++)
             {
-                y(j) = 0;
+                if( !oobflags(t, ti) )
+                {
+                    continue;
+                }
+                for(tj = 0; tj <= nclasses-1; tj++)
+                {
+                    y(tj) = 0;
+                }
+                dfprocessinternal(df, t*treesize, x, y);
+                ap::vadd(&oobbuf(ti*nclasses), 1, &y(0), 1, ap::vlen(ti*nclasses,ti*nclasses+nclasses-1));
+                oobcntbuf(ti) = oobcntbuf(ti)+1;
             }
-            j = permbuf(k);
-            ap::vmove(&x(0), 1, &xy(j, 0), 1, ap::vlen(0,nvars-1));
-            dfprocessinternal(df, lasttreeoffs, x, y);
-            ap::vadd(&oobbuf(j*nclasses), 1, &y(0), 1, ap::vlen(j*nclasses,(j+1)*nclasses-1));
-            oobcntbuf(j) = oobcntbuf(j)+1;
         }
     }
+    
+    //
+    // Pack trees (forward copy, slots never move to the right)
+    //
+    offs = 0;
+    for(i = 0; i <= ntrees-1; i++)
+    {
+        if( offs!=i*treesize )
+        {
+            ap::vmove(&df.trees(offs), 1, &df.trees(i*treesize), 1, ap::vlen(offs,offs+treesizes(i)-1));
+        }
+        offs = offs+treesizes(i);
+    }
     df.bufsize = offs;
     
     //
@@ -378,104 +471,23 @@ void dfbuildinternal(const ap::real_2d_array& xy,
     }
     
     //
-    // Calculate training set estimates
+    // Calculate OOB estimates.
     //
-    rep.relclserror = dfrelclserror(df, xy, npoints);
-    rep.avgce = dfavgce(df, xy, npoints);
-    rep.rmserror = dfrmserror(df, xy, npoints);
-    rep.avgerror = dfavgerror(df, xy, npoints);
-    rep.avgrelerror = dfavgrelerror(df, xy, npoints);
+    dfcalcerrors(xy, npoints, nvars, nclasses, oobbuf, oobcntbuf, rep.oobrelclserror, rep.oobavgce, rep.oobrmserror, rep.oobavgerror, rep.oobavgrelerror);
     
     //
-    // Calculate OOB estimates.
+    // Calculate training set estimates: same as DFRelClsError(), DFAvgCE(),
+    // DFRMSError(), DFAvgError(), DFAvgRelError() on XY, but the forest is
+    // applied to the training set only once (by batch) and OOB buffers are
+    // reused for its outputs.
     //
-    rep.oobrelclserror = 0;
-    rep.oobavgce = 0;
-    rep.oobrmserror = 0;
-    rep.oobavgerror = 0;
-    rep.oobavgrelerror = 0;
-    oobcnt = 0;
-    oobrelcnt = 0;
+    dfprocessbatch(df, xy, npoints, ytrn);
     for(i = 0; i <= npoints-1; i++)
     {
-        if( oobcntbuf(i)!=0 )
-        {
-            ooboffs = i*nclasses;
-            if( nclasses>1 )
-            {
-                
-                //
-                // classification-specific code
-                //
-                k = ap::round(xy(i,nvars));
-                tmpi = 0;
-                for(j = 1; j <= nclasses-1; j++)
-                {
-                    if( ap::fp_greater(oobbuf(ooboffs+j),oobbuf(ooboffs+tmpi)) )
-                    {
-                        tmpi = j;
-                    }
-                }
-                if( tmpi!=k )
-                {
-                    rep.oobrelclserror = rep.oobrelclserror+1;
-                }
-                if( ap::fp_neq(oobbuf(ooboffs+k),0) )
-                {
-                    rep.oobavgce = rep.oobavgce-log(oobbuf(ooboffs+k));
-                }
-                else
-                {
-                    rep.oobavgce = rep.oobavgce-log(ap::minrealnumber);
-                }
-                for(j = 0; j <= nclasses-1; j++)
-                {
-                    if( j==k )
-                    {
-                        rep.oobrmserror = rep.oobrmserror+ap::sqr(oobbuf(ooboffs+j)-1);
-                        rep.oobavgerror = rep.oobavgerror+fabs(oobbuf(ooboffs+j)-1);
-                        rep.oobavgrelerror = rep.oobavgrelerror+fabs(oobbuf(ooboffs+j)-1);
-                        oobrelcnt = oobrelcnt+1;
-                    }
-                    else
-                    {
-                        rep.oobrmserror = rep.oobrmserror+ap::sqr(oobbuf(ooboffs+j));
-                        rep.oobavgerror = rep.oobavgerror+fabs(oobbuf(ooboffs+j));
-                    }
-                }
-            }
-            else
-            {
-                
-                //
-                // regression-specific code
-                //
-                rep.oobrmserror = rep.oobrmserror+ap::sqr(oobbuf(ooboffs)-xy(i,nvars));
-                rep.oobavgerror = rep.oobavgerror+fabs(oobbuf(ooboffs)-xy(i,nvars));
-                if( ap::fp_neq(xy(i,nvars),0) )
-                {
-                    rep.oobavgrelerror = rep.oobavgrelerror+fabs((oobbuf(ooboffs)-xy(i,nvars))/xy(i,nvars));
-                    oobrelcnt = oobrelcnt+1;
-                }
-            }
-            
-            //
-            // update OOB estimates count.
-            //
-            oobcnt = oobcnt+1;
-        }
-    }
-    if( oobcnt>0 )
-    {
-        rep.oobrelclserror = rep.oobrelclserror/oobcnt;
-        rep.oobavgce = rep.oobavgce/oobcnt;
-        rep.oobrmserror = sqrt(rep.oobrmserror/(oobcnt*nclasses));
-        rep.oobavgerror = rep.oobavgerror/(oobcnt*nclasses);
-        if( oobrelcnt>0 )
-        {
-            rep.oobavgrelerror = rep.oobavgrelerror/oobrelcnt;
-        }
+        ap::vmove(&oobbuf(i*nclasses), 1, &ytrn(i, 0), 1, ap::vlen(i*nclasses,i*nclasses+nclasses-1));
+        oobcntbuf(i) = 1;
     }
+    dfcalcerrors(xy, npoints, nvars, nclasses, oobbuf, oobcntbuf, rep.relclserror, rep.avgce, rep.rmserror, rep.avgerror, rep.avgrelerror);
 }
 
 
@@ -531,6 +543,115 @@ void dfprocess(const decisionforest& df,
 }
 
 
+/*************************************************************************
+Batch processing
+
+Same as DFProcess() called for each row of X, result is the same too.
+Forest is converted to the compact layout (separate arrays of variable
+numbers, thresholds and ">=" branches, 16 bytes per node) and the rows are
+processed by blocks: each tree is applied to the whole block while it is
+in the cache. Blocks are distributed between threads when OpenMP is on.
+
+Conversion costs one pass over the forest, so this function should be
+used for batches (at least hundreds of rows), DFProcess() for single
+vectors.
+
+INPUT PARAMETERS:
+    DF      -   decision forest model
+    X       -   input vectors, array[0..NPoints-1,0..NVars-1].
+    NPoints -   number of vectors, NPoints>=0
+
+OUTPUT PARAMETERS:
+    Y       -   results, array[0..NPoints-1,0..NClasses-1]: regression
+                estimates or vectors of posterior probabilities (one row
+                per input vector). Allocated by the subroutine.
+*************************************************************************/
+void dfprocessbatch(const decisionforest& df,
+     const ap::real_2d_array& x,
+     int npoints,
+     ap::real_2d_array& y)
+{
+    ap::integer_1d_array nodevar;
+    ap::real_1d_array nodeval;
+    ap::integer_1d_array noderight;
+    ap::integer_1d_array treeroots;
+    int nblocks;
+    int b;
+    double v;
+
+    ap::ap_error::make_assertion(npoints>=0, "DFProcessBatch: NPoints<0!");
+    if( npoints==0 )
+    {
+        return;
+    }
+    y.setlength(npoints, df.nclasses);
+    dfcompactlayout(df, nodevar, nodeval, noderight, treeroots);
+    v = double(1)/double(df.ntrees);
+    nblocks = (npoints+dfbatchblocksize-1)/dfbatchblocksize;
+    #pragma omp parallel for schedule(dynamic,1) if( nblocks>1&&dfparallel(double(npoints)*double(df.ntrees)*16) )
+    for(b = 0; b <= nblocks-1; b++)
+    {
+        const int *pvar;
+        const double *pval;
+        const int *pright;
+        int i1;
+        int i2;
+        int i;
+        int j;
+        int t;
+        int k;
+
+        pvar = &nodevar(0);
+        pval = &nodeval(0);
+        pright = &noderight(0);
+        i1 = b*dfbatchblocksize;
+        i2 = ap::minint(i1+dfbatchblocksize, npoints)-1;
+        for(i = i1; i <= i2; i++)
+        {
+            for(j = 0; j <= df.nclasses-1; j++)
+            {
+                y(i,j) = 0;
+            }
+        }
+        for(t = 0; t <= df.ntrees-1; t++)
+        {
+            for(i = i1; i <= i2; i++)
+            {
+                
+                //
+                // Navigate through the tree: "<" branch is the next node
+                //
+                k = treeroots(t);
+                while(pvar[k]>=0)
+                {
+                    if( x(i,pvar[k])<pval[k] )
+                    {
+                        k = k+1;
+                    }
+                    else
+                    {
+                        k = pright[k];
+                    }
+                }
+                if( df.nclasses==1 )
+                {
+                    y(i,0) = y(i,0)+pval[k];
+                }
+                else
+                {
+                    j = int(pval[k]);
+                    y(i,j) = y(i,j)+1;
+                }
+            }
+        }
+        for(i = i1; i <= i2; i++)
+        {
+            ap::vmul(&y(i, 0), 1, ap::vlen(0,df.nclasses-1), v);
+        }
+    }
+}
+
+
 /*************************************************************************
 Relative classification error on the test set
 
@@ -1007,6 +1128,223 @@ static void dfprocessinternal(const decisionforest& df,
 }
 
 
+/*************************************************************************
+Errors of the model outputs stored in Buf (I-th output in Buf[I*NClasses..
+(I+1)*NClasses-1]) on the points of XY with non-zero CntBuf(I).
+
+See DFRelClsError(), DFAvgCE(), DFRMSError(), DFAvgError() and
+DFAvgRelError() for the meaning of errors.
+*************************************************************************/
+static void dfcalcerrors(const ap::real_2d_array& xy,
+     int npoints,
+     int nvars,
+     int nclasses,
+     const ap::real_1d_array& buf,
+     const ap::integer_1d_array& cntbuf,
+     double& relclserror,
+     double& avgce,
+     double& rmserror,
+     double& avgerror,
+     double& avgrelerror)
+{
+    int i;
+    int j;
+    int k;
+    int tmpi;
+    int offs;
+    int cnt;
+    int relcnt;
+
+    relclserror = 0;
+    avgce = 0;
+    rmserror = 0;
+    avgerror = 0;
+    avgrelerror = 0;
+    cnt = 0;
+    relcnt = 0;
+    for(i = 0; i <= npoints-1; i++)
+    {
+        if( cntbuf(i)!=0 )
+        {
+            offs = i*nclasses;
+            if( nclasses>1 )
+            {
+                
+                //
+                // classification-specific code
+                //
+                k = ap::round(xy(i,nvars));
+                tmpi = 0;
+                for(j = 1; j <= nclasses-1; j++)
+                {
+                    if( ap::fp_greater(buf(offs+j),buf(offs+tmpi)) )
+                    {
+                        tmpi = j;
+                    }
+                }
+                if( tmpi!=k )
+                {
+                    relclserror = relclserror+1;
+                }
+                if( ap::fp_neq(buf(offs+k),0) )
+                {
+                    avgce = avgce-log(buf(offs+k));
+                }
+                else
+                {
+                    avgce = avgce-log(ap::minrealnumber);
+                }
+                for(j = 0; j <= nclasses-1; j++)
+                {
+                    if( j==k )
+                    {
+                        rmserror = rmserror+ap::sqr(buf(offs+j)-1);
+                        avgerror = avgerror+fabs(buf(offs+j)-1);
+                        avgrelerror = avgrelerror+fabs(buf(offs+j)-1);
+                        relcnt = relcnt+1;
+                    }
+                    else
+                    {
+                        rmserror = rmserror+ap::sqr(buf(offs+j));
+                        avgerror = avgerror+fabs(buf(offs+j));
+                    }
+                }
+            }
+            else
+            {
+                
+                //
+                // regression-specific code
+                //
+                rmserror = rmserror+ap::sqr(buf(offs)-xy(i,nvars));
+                avgerror = avgerror+fabs(buf(offs)-xy(i,nvars));
+                if( ap::fp_neq(xy(i,nvars),0) )
+                {
+                    avgrelerror = avgrelerror+fabs((buf(offs)-xy(i,nvars))/xy(i,nvars));
+                    relcnt = relcnt+1;
+                }
+            }
+            
+            //
+            // update count
+            //
+            cnt = cnt+1;
+        }
+    }
+    if( cnt>0 )
+    {
+        relclserror = relclserror/cnt;
+        avgce = avgce/cnt;
+        rmserror = sqrt(rmserror/(cnt*nclasses));
+        avgerror = avgerror/(cnt*nclasses);
+        if( relcnt>0 )
+        {
+            avgrelerror = avgrelerror/relcnt;
+        }
+    }
+}
+
+
+/*************************************************************************
+Compact layout of the forest used by DFProcessBatch().
+
+Nodes of all trees are stored one after another in the same order as in
+DF.Trees. For I-th node NodeVar(I) is a variable number (-1 for a leaf),
+NodeVal(I) is a threshold (class number or value for a leaf), "<" branch
+is the next node and NodeRight(I) is the ">=" branch. TreeRoots(T) is the
+first node of T-th tree.
+
+Returns number of nodes.
+*************************************************************************/
+static int dfcompactlayout(const decisionforest& df,
+     ap::integer_1d_array& nodevar,
+     ap::real_1d_array& nodeval,
+     ap::integer_1d_array& noderight,
+     ap::integer_1d_array& treeroots)
+{
+    int result;
+    ap::integer_1d_array nodeidx;
+    int offs;
+    int t;
+    int k;
+    int n;
+
+    
+    //
+    // Node numbers for all positions of DF.Trees, then nodes
+    //
+    nodeidx.setbounds(0, df.bufsize-1);
+    treeroots.setbounds(0, df.ntrees-1);
+    n = 0;
+    offs = 0;
+    for(t = 0; t <= df.ntrees-1; t++)
+    {
+        treeroots(t) = n;
+        k = offs+1;
+        while(k<offs+ap::round(df.trees(offs)))
+        {
+            nodeidx(k) = n;
+            n = n+1;
+            if( ap::fp_eq(df.trees(k),-1) )
+            {
+                k = k+leafnodewidth;
+            }
+            else
+            {
+                k = k+innernodewidth;
+            }
+        }
+        offs = offs+ap::round(df.trees(offs));
+    }
+    nodevar.setbounds(0, n-1);
+    nodeval.setbounds(0, n-1);
+    noderight.setbounds(0, n-1);
+    n = 0;
+    offs = 0;
+    for(t = 0; t <= df.ntrees-1; t++)
+    {
+        k = offs+1;
+        while(k<offs+ap::round(df.trees(offs)))
+        {
+            nodeval(n) = df.trees(k+1);
+            if( ap::fp_eq(df.trees(k),-1) )
+            {
+                nodevar(n) = -1;
+                noderight(n) = -1;
+                k = k+leafnodewidth;
+            }
+            else
+            {
+                nodevar(n) = ap::round(df.trees(k));
+                noderight(n) = nodeidx(offs+ap::round(df.trees(k+2)));
+                k = k+innernodewidth;
+            }
+            n = n+1;
+        }
+        offs = offs+ap::round(df.trees(offs));
+    }
+    result = n;
+    return result;
+}
+
+
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool dfparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,dfparallelwork);
+#endif
+    return result;
+}
+
+
 /*************************************************************************
 Builds one decision tree. Just a wrapper for the DFBuildTreeRec.
 *************************************************************************/
@@ -1161,7 +1499,7 @@ static void dfbuildtreerec(const ap::real_2d_array& xy,
         //
         // select variables from pool
         //
-        j = i+ap::randominteger(nvarsinpool-i);
+        j = i+hqrnduniformi(nvarsinpool-i, bufs.rs);
         k = bufs.varpool(i);
         bufs.varpool(i) = bufs.varpool(j);
         bufs.varpool(j) = k;
@@ -1365,7 +1703,7 @@ static void dfbuildtreerec(const ap::real_2d_array& xy,
             // Select random class label (randomness allows us to
             // approximate distribution of the classes)
             //
-            bufs.treebuf(numprocessed+1) = ap::round(xy(bufs.idxbuf(idx1+ap::randominteger(idx2-idx1+1)),nvars));
+            bufs.treebuf(numprocessed+1) = ap::round(xy(bufs.idxbuf(idx1+hqrnduniformi(idx2-idx1+1, bufs.rs)),nvars));
         }
         else
         {
@@ -27,6 +27,7 @@ http://www.fsf.org/licensing/licenses
 #include "tsort.h"
 #include "descriptivestatistics.h"
 #include "bdss.h"
+#include "hqrnd.h"
 
 
 struct decisionforest
@@ -65,6 +66,7 @@ struct dfinternalbuffers
     ap::integer_1d_array varpool;
     ap::boolean_1d_array evsbin;
     ap::real_1d_array evssplits;
+    hqrndstate rs;
 };
 
 
@@ -100,6 +102,12 @@ OUTPUT PARAMETERS:
     Rep         -   training report, contains error on a training set
                     and out-of-bag estimates of generalization error.
 
+NOTES:
+    When OpenMP is enabled, trees are built in parallel. Each tree uses its
+    own random stream seeded from the standard RNG, so the forest does not
+    depend on the number of threads (out-of-bag estimates for regression
+    may differ in the last digits because of the summation order).
+
   -- ALGLIB --
      Copyright 19.02.2009 by Bochkanov Sergey
 *************************************************************************/
@@ -149,6 +157,35 @@ void dfprocess(const decisionforest& df,
      ap::real_1d_array& y);
 
 
+/*************************************************************************
+Batch processing
+
+Same as DFProcess() called for each row of X, result is the same too.
+Forest is converted to the compact layout (separate arrays of variable
+numbers, thresholds and ">=" branches, 16 bytes per node) and the rows are
+processed by blocks: each tree is applied to the whole block while it is
+in the cache. Blocks are distributed between threads when OpenMP is on.
+
+Conversion costs one pass over the forest, so this function should be
+used for batches (at least hundreds of rows), DFProcess() for single
+vectors.
+
+INPUT PARAMETERS:
+    DF      -   decision forest model
+    X       -   input vectors, array[0..NPoints-1,0..NVars-1].
+    NPoints -   number of vectors, NPoints>=0
+
+OUTPUT PARAMETERS:
+    Y       -   results, array[0..NPoints-1,0..NClasses-1]: regression
+                estimates or vectors of posterior probabilities (one row
+                per input vector). Allocated by the subroutine.
+*************************************************************************/
+void dfprocessbatch(const decisionforest& df,
+     const ap::real_2d_array& x,
+     int npoints,
+     ap::real_2d_array& y);
+
+
 /*************************************************************************
 Relative classification error on the test set
 
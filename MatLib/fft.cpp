@@ -21,6 +21,12 @@ http://www.fsf.org/licensing/licenses
  
 #include "fft.h"
 
+static void fftr1dsegment(fftplan& plan,
+     const ap::real_1d_array& a,
+     int aoffs,
+     ap::complex_1d_array& f,
+     int foffs);
+
 /*************************************************************************
 1-dimensional complex FFT.
 
@@ -334,6 +340,211 @@ void fftr1dinv(const ap::complex_1d_array& f, int n, ap::real_1d_array& a)
 }
 
 
+/*************************************************************************
+Plan for complex FFT of size N
+*************************************************************************/
+void fftc1dcreateplan(int n, fftplan& plan)
+{
+
+    ap::ap_error::make_assertion(n>0, "FFTC1DCreatePlan: incorrect N!");
+    plan.n = n;
+    plan.isreal = false;
+    if( n>1 )
+    {
+        ftbasegeneratecomplexfftplan(n, plan.plan);
+    }
+    plan.buf.setlength(2*n);
+}
+
+
+/*************************************************************************
+Plan for real FFT of size N
+
+Even N's are reduced to the complex FFT of size N/2,  twiddle  factors
+for the reduction are stored in Plan.TW. Odd N's use complex FFT of size N.
+Plan.Buf2 and Plan.CBuf are used by inverse transforms.
+*************************************************************************/
+void fftr1dcreateplan(int n, fftplan& plan)
+{
+    int i;
+    int n2;
+
+    ap::ap_error::make_assertion(n>0, "FFTR1DCreatePlan: incorrect N!");
+    plan.n = n;
+    plan.isreal = true;
+    if( n>2 )
+    {
+        if( n%2==0 )
+        {
+            n2 = n/2;
+            ftbasegeneratecomplexfftplan(n2, plan.plan);
+            plan.tw.setlength(2*(n2+1));
+            for(i = 0; i <= n2; i++)
+            {
+                plan.tw(2*i+0) = -sin(-2*ap::pi()*i/n);
+                plan.tw(2*i+1) = cos(-2*ap::pi()*i/n);
+            }
+        }
+        else
+        {
+            ftbasegeneratecomplexfftplan(n, plan.plan);
+        }
+    }
+    plan.buf.setlength(2*n);
+    plan.buf2.setlength(n);
+    plan.cbuf.setlength(n);
+}
+
+
+/*************************************************************************
+Batch of complex FFT's
+*************************************************************************/
+void fftc1dbatch(fftplan& plan, ap::complex_1d_array& a, int m)
+{
+    int i;
+    int k;
+    int n;
+    int offs;
+
+    ap::ap_error::make_assertion(!plan.isreal, "FFTC1DBatch: real FFT plan!");
+    ap::ap_error::make_assertion(m>=0, "FFTC1DBatch: incorrect M!");
+    n = plan.n;
+    if( n==1 )
+    {
+        return;
+    }
+    for(k = 0; k <= m-1; k++)
+    {
+        offs = k*n;
+        for(i = 0; i <= n-1; i++)
+        {
+            plan.buf(2*i+0) = a(offs+i).x;
+            plan.buf(2*i+1) = a(offs+i).y;
+        }
+        ftbaseexecuteplan(plan.buf, 0, n, plan.plan);
+        for(i = 0; i <= n-1; i++)
+        {
+            a(offs+i).x = plan.buf(2*i+0);
+            a(offs+i).y = plan.buf(2*i+1);
+        }
+    }
+}
+
+
+/*************************************************************************
+Batch of complex inverse FFT's
+*************************************************************************/
+void fftc1dinvbatch(fftplan& plan, ap::complex_1d_array& a, int m)
+{
+    int i;
+    int k;
+    int n;
+    int offs;
+
+    ap::ap_error::make_assertion(!plan.isreal, "FFTC1DInvBatch: real FFT plan!");
+    ap::ap_error::make_assertion(m>=0, "FFTC1DInvBatch: incorrect M!");
+    n = plan.n;
+    if( n==1 )
+    {
+        return;
+    }
+    
+    //
+    // invfft(x) = fft(x')'/N, see FFTC1DInv()
+    //
+    for(k = 0; k <= m-1; k++)
+    {
+        offs = k*n;
+        for(i = 0; i <= n-1; i++)
+        {
+            plan.buf(2*i+0) = a(offs+i).x;
+            plan.buf(2*i+1) = -a(offs+i).y;
+        }
+        ftbaseexecuteplan(plan.buf, 0, n, plan.plan);
+        for(i = 0; i <= n-1; i++)
+        {
+            a(offs+i).x = plan.buf(2*i+0)/n;
+            a(offs+i).y = -plan.buf(2*i+1)/n;
+        }
+    }
+}
+
+
+/*************************************************************************
+Batch of real FFT's
+*************************************************************************/
+void fftr1dbatch(fftplan& plan,
+     const ap::real_1d_array& a,
+     int m,
+     ap::complex_1d_array& f)
+{
+    int k;
+
+    ap::ap_error::make_assertion(plan.isreal, "FFTR1DBatch: complex FFT plan!");
+    ap::ap_error::make_assertion(m>=0, "FFTR1DBatch: incorrect M!");
+    f.setlength(ap::maxint(m*plan.n, 1));
+    for(k = 0; k <= m-1; k++)
+    {
+        fftr1dsegment(plan, a, k*plan.n, f, k*plan.n);
+    }
+}
+
+
+/*************************************************************************
+Batch of real inverse FFT's
+*************************************************************************/
+void fftr1dinvbatch(fftplan& plan,
+     const ap::complex_1d_array& f,
+     int m,
+     ap::real_1d_array& a)
+{
+    int i;
+    int k;
+    int n;
+    int n2;
+    int offs;
+
+    ap::ap_error::make_assertion(plan.isreal, "FFTR1DInvBatch: complex FFT plan!");
+    ap::ap_error::make_assertion(m>=0, "FFTR1DInvBatch: incorrect M!");
+    n = plan.n;
+    n2 = n/2;
+    a.setlength(ap::maxint(m*n, 1));
+    for(k = 0; k <= m-1; k++)
+    {
+        offs = k*n;
+        if( n==1 )
+        {
+            a(offs) = f(offs).x;
+            continue;
+        }
+        
+        //
+        // reduction to the forward real FFT, see FFTR1DInv()
+        //
+        plan.buf2(0) = f(offs).x;
+        for(i = 1; i <= n2-1; i++)
+        {
+            plan.buf2(i) = f(offs+i).x-f(offs+i).y;
+            plan.buf2(n-i) = f(offs+i).x+f(offs+i).y;
+        }
+        if( n%2==0 )
+        {
+            plan.buf2(n2) = f(offs+n2).x;
+        }
+        else
+        {
+            plan.buf2(n2) = f(offs+n2).x-f(offs+n2).y;
+            plan.buf2(n2+1) = f(offs+n2).x+f(offs+n2).y;
+        }
+        fftr1dsegment(plan, plan.buf2, 0, plan.cbuf, 0);
+        for(i = 0; i <= n-1; i++)
+        {
+            a(offs+i) = (plan.cbuf(i).x-plan.cbuf(i).y)/n;
+        }
+    }
+}
+
+
 /*************************************************************************
 Internal subroutine. Never call it directly!
 
@@ -463,5 +674,76 @@ void fftr1dinvinternaleven(ap::real_1d_array& a,
 }
 
 
+/*************************************************************************
+Real FFT of A[AOffs..AOffs+N-1] with plan created by FFTR1DCreatePlan(),
+result is stored in F[FOffs..FOffs+N-1]. Same algorithm as FFTR1D().
+*************************************************************************/
+static void fftr1dsegment(fftplan& plan,
+     const ap::real_1d_array& a,
+     int aoffs,
+     ap::complex_1d_array& f,
+     int foffs)
+{
+    int i;
+    int n;
+    int n2;
+    int idx;
+    ap::complex hn;
+    ap::complex hmnc;
+    ap::complex v;
+
+    n = plan.n;
+    if( n==1 )
+    {
+        f(foffs) = a(aoffs);
+        return;
+    }
+    if( n==2 )
+    {
+        f(foffs+0).x = a(aoffs+0)+a(aoffs+1);
+        f(foffs+0).y = 0;
+        f(foffs+1).x = a(aoffs+0)-a(aoffs+1);
+        f(foffs+1).y = 0;
+        return;
+    }
+    if( n%2==0 )
+    {
+        n2 = n/2;
+        ap::vmove(&plan.buf(0), 1, &a(aoffs), 1, ap::vlen(0,n-1));
+        ftbaseexecuteplan(plan.buf, 0, n2, plan.plan);
+        for(i = 0; i <= n2; i++)
+        {
+            idx = 2*(i%n2);
+            hn.x = plan.buf(idx+0);
+            hn.y = plan.buf(idx+1);
+            idx = 2*((n2-i)%n2);
+            hmnc.x = plan.buf(idx+0);
+            hmnc.y = -plan.buf(idx+1);
+            v.x = plan.tw(2*i+0);
+            v.y = plan.tw(2*i+1);
+            v = hn+hmnc-v*(hn-hmnc);
+            f(foffs+i).x = 0.5*v.x;
+            f(foffs+i).y = 0.5*v.y;
+        }
+        for(i = n2+1; i <= n-1; i++)
+        {
+            f(foffs+i) = ap::conj(f(foffs+n-i));
+        }
+    }
+    else
+    {
+        for(i = 0; i <= n-1; i++)
+        {
+            plan.buf(2*i+0) = a(aoffs+i);
+            plan.buf(2*i+1) = 0;
+        }
+        ftbaseexecuteplan(plan.buf, 0, n, plan.plan);
+        for(i = 0; i <= n-1; i++)
+        {
+            f(foffs+i).x = plan.buf(2*i+0);
+            f(foffs+i).y = plan.buf(2*i+1);
+        }
+    }
+}
 
 
@@ -26,6 +26,24 @@ http://www.fsf.org/licensing/licenses
 
 #include "ftbase.h"
 
+/*************************************************************************
+FFT plan for repeated transforms of size N.
+
+Holds the factorization of N, the precomputed twiddle factors and working
+buffers, so transforms made with a plan do no allocations and  no  plan
+generation. A plan may be used by one thread at a time.
+*************************************************************************/
+struct fftplan
+{
+    int n;
+    bool isreal;
+    ftplan plan;
+    ap::real_1d_array tw;
+    ap::real_1d_array buf;
+    ap::real_1d_array buf2;
+    ap::complex_1d_array cbuf;
+};
+
 
 /*************************************************************************
 1-dimensional complex FFT.
@@ -139,6 +157,96 @@ elements - subroutine will successfully transform both.
 void fftr1dinv(const ap::complex_1d_array& f, int n, ap::real_1d_array& a);
 
 
+/*************************************************************************
+Plan for complex FFT of size N
+
+Creates plan which is used by FFTC1DBatch() and FFTC1DInvBatch().
+
+INPUT PARAMETERS
+    N       -   problem size, N>=1
+
+OUTPUT PARAMETERS
+    Plan    -   plan
+*************************************************************************/
+void fftc1dcreateplan(int n, fftplan& plan);
+
+
+/*************************************************************************
+Plan for real FFT of size N
+
+Creates plan which is used by FFTR1DBatch() and FFTR1DInvBatch().
+
+INPUT PARAMETERS
+    N       -   problem size, N>=1
+
+OUTPUT PARAMETERS
+    Plan    -   plan
+*************************************************************************/
+void fftr1dcreateplan(int n, fftplan& plan);
+
+
+/*************************************************************************
+Batch of complex FFT's
+
+Transforms M signals of length N=Plan.N, stored one after another in A,
+with the same plan.
+
+INPUT PARAMETERS
+    Plan    -   plan created by FFTC1DCreatePlan()
+    A       -   array[0..M*N-1], K-th signal is stored in A[K*N..K*N+N-1]
+    M       -   number of signals, M>=0
+
+OUTPUT PARAMETERS
+    A       -   DFT's of the signals, stored in the same order
+*************************************************************************/
+void fftc1dbatch(fftplan& plan, ap::complex_1d_array& a, int m);
+
+
+/*************************************************************************
+Batch of complex inverse FFT's
+
+Same as FFTC1DBatch(), but inverse DFT's are calculated (see FFTC1DInv).
+*************************************************************************/
+void fftc1dinvbatch(fftplan& plan, ap::complex_1d_array& a, int m);
+
+
+/*************************************************************************
+Batch of real FFT's
+
+INPUT PARAMETERS
+    Plan    -   plan created by FFTR1DCreatePlan()
+    A       -   array[0..M*N-1], K-th signal is stored in A[K*N..K*N+N-1]
+    M       -   number of signals, M>=0
+
+OUTPUT PARAMETERS
+    F       -   array[0..M*N-1], F[K*N..K*N+N-1] contains DFT  of  K-th
+                signal (full array of frequencies, see FFTR1D)
+*************************************************************************/
+void fftr1dbatch(fftplan& plan,
+     const ap::real_1d_array& a,
+     int m,
+     ap::complex_1d_array& f);
+
+
+/*************************************************************************
+Batch of real inverse FFT's
+
+INPUT PARAMETERS
+    Plan    -   plan created by FFTR1DCreatePlan()
+    F       -   array[0..M*N-1], F[K*N..K*N+N-1] contains frequencies of
+                K-th signal. As in FFTR1DInv(), just elements from 0  to
+                floor(N/2) of each signal are used.
+    M       -   number of signals, M>=0
+
+OUTPUT PARAMETERS
+    A       -   array[0..M*N-1], inverse DFT's of the signals
+*************************************************************************/
+void fftr1dinvbatch(fftplan& plan,
+     const ap::complex_1d_array& f,
+     int m,
+     ap::real_1d_array& a);
+
+
 /*************************************************************************
 Internal subroutine. Never call it directly!
 
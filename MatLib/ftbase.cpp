@@ -38,6 +38,26 @@ static const int ftbasecodeletmax = 5;
 static const int ftbasecodeletrecommended = 5;
 static const double ftbaseinefficiencyfactor = 1.3;
 static const int ftbasemaxsmoothfactor = 5;
+static const int ftbaseplancachesize = 32;
+
+//
+// Plan cache: plans are copied out of the cache,  so  each  caller
+// gets its own working buffers and cached plans are never modified.
+// Entries are replaced in round-robin order when the cache is full.
+// Access is serialized by the ftbase_plan_cache critical section.
+//
+struct ftbaseplancacheentry
+{
+    int n;
+    int tasktype;
+    ap::integer_1d_array plan;
+    ap::real_1d_array precomputed;
+    int tmpbufsize;
+    int stackbufsize;
+};
+static ftbaseplancacheentry ftbaseplancache[ftbaseplancachesize];
+static int ftbaseplancachecount = 0;
+static int ftbaseplancachenext = 0;
 
 static void ftbasegenerateplanrec(int n,
      int tasktype,
@@ -81,6 +101,8 @@ static void fftirltrec(ap::real_1d_array& a,
 static void ftbasefindsmoothrec(int n, int seed, int leastfactor, int& best);
 static void fftarrayresize(ap::integer_1d_array& a, int& asize, int newasize);
 static void reffht(ap::real_1d_array& a, int n, int offs);
+static bool ftbaseloadcachedplan(int n, int tasktype, ftplan& plan);
+static void ftbasestorecachedplan(int n, int tasktype, const ftplan& plan);
 
 /*************************************************************************
 This subroutine generates FFT plan - a decomposition of a N-length FFT to
@@ -105,6 +127,10 @@ void ftbasegeneratecomplexfftplan(int n, ftplan& plan)
     int stackmemsize;
     int stackptr;
 
+    if( ftbaseloadcachedplan(n, ftbasecffttask, plan) )
+    {
+        return;
+    }
     planarraysize = 1;
     plansize = 0;
     precomputedsize = 0;
@@ -120,6 +146,7 @@ void ftbasegeneratecomplexfftplan(int n, ftplan& plan)
     stackptr = 0;
     ftbaseprecomputeplanrec(plan, 0, stackptr);
     ap::ap_error::make_assertion(stackptr==0, "Internal error in FTBaseGenerateComplexFFTPlan: stack ptr!");
+    ftbasestorecachedplan(n, ftbasecffttask, plan);
 }
 
 
@@ -135,6 +162,10 @@ void ftbasegeneraterealfftplan(int n, ftplan& plan)
     int stackmemsize;
     int stackptr;
 
+    if( ftbaseloadcachedplan(n, ftbaserffttask, plan) )
+    {
+        return;
+    }
     planarraysize = 1;
     plansize = 0;
     precomputedsize = 0;
@@ -150,6 +181,7 @@ void ftbasegeneraterealfftplan(int n, ftplan& plan)
     stackptr = 0;
     ftbaseprecomputeplanrec(plan, 0, stackptr);
     ap::ap_error::make_assertion(stackptr==0, "Internal error in FTBaseGenerateRealFFTPlan: stack ptr!");
+    ftbasestorecachedplan(n, ftbaserffttask, plan);
 }
 
 
@@ -165,6 +197,10 @@ void ftbasegeneraterealfhtplan(int n, ftplan& plan)
     int stackmemsize;
     int stackptr;
 
+    if( ftbaseloadcachedplan(n, ftbaserfhttask, plan) )
+    {
+        return;
+    }
     planarraysize = 1;
     plansize = 0;
     precomputedsize = 0;
@@ -180,6 +216,33 @@ void ftbasegeneraterealfhtplan(int n, ftplan& plan)
     stackptr = 0;
     ftbaseprecomputeplanrec(plan, 0, stackptr);
     ap::ap_error::make_assertion(stackptr==0, "Internal error in FTBaseGenerateRealFHTPlan: stack ptr!");
+    ftbasestorecachedplan(n, ftbaserfhttask, plan);
+}
+
+
+/*************************************************************************
+Clears the plan cache.
+
+Plans generated by FTBaseGenerateComplexFFTPlan(), FTBaseGenerateRealFFTPlan()
+and FTBaseGenerateRealFHTPlan() are cached (up to 32 plans), so repeated
+requests for the same N and task type copy the cached plan instead of
+generating a new one. This subroutine frees the memory held by the cache.
+*************************************************************************/
+void ftbaseclearplancache()
+{
+    int i;
+
+    #pragma omp critical (ftbase_plan_cache)
+    {
+        for(i = 0; i <= ftbaseplancachesize-1; i++)
+        {
+            ftbaseplancache[i].n = 0;
+            ftbaseplancache[i].plan.setlength(0);
+            ftbaseplancache[i].precomputed.setlength(0);
+        }
+        ftbaseplancachecount = 0;
+        ftbaseplancachenext = 0;
+    }
 }
 
 
@@ -1612,5 +1675,79 @@ static void reffht(ap::real_1d_array& a, int n, int offs)
 }
 
 
+/*************************************************************************
+Copies plan for task (N,TaskType) from the cache to Plan.
+Returns False when there is no such plan in the cache.
+*************************************************************************/
+static bool ftbaseloadcachedplan(int n, int tasktype, ftplan& plan)
+{
+    bool result;
+    int i;
+
+    result = false;
+    if( n<=ftbasecodeletmax )
+    {
+        return result;
+    }
+    #pragma omp critical (ftbase_plan_cache)
+    {
+        for(i = 0; i <= ftbaseplancachecount-1; i++)
+        {
+            if( ftbaseplancache[i].n==n&&ftbaseplancache[i].tasktype==tasktype )
+            {
+                plan.plan = ftbaseplancache[i].plan;
+                plan.precomputed = ftbaseplancache[i].precomputed;
+                plan.tmpbuf.setlength(ftbaseplancache[i].tmpbufsize);
+                plan.stackbuf.setlength(ftbaseplancache[i].stackbufsize);
+                result = true;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Stores copy of Plan for task (N,TaskType) in the cache.
+*************************************************************************/
+static void ftbasestorecachedplan(int n, int tasktype, const ftplan& plan)
+{
+    int i;
+
+    if( n<=ftbasecodeletmax )
+    {
+        return;
+    }
+    #pragma omp critical (ftbase_plan_cache)
+    {
+        
+        //
+        // Another thread may have stored the same plan
+        //
+        for(i = 0; i <= ftbaseplancachecount-1; i++)
+        {
+            if( ftbaseplancache[i].n==n&&ftbaseplancache[i].tasktype==tasktype )
+            {
+                break;
+            }
+        }
+        if( i==ftbaseplancachecount )
+        {
+            i = ftbaseplancachenext;
+            ftbaseplancachenext = (ftbaseplancachenext+1)%ftbaseplancachesize;
+            if( ftbaseplancachecount<ftbaseplancachesize )
+            {
+                ftbaseplancachecount = ftbaseplancachecount+1;
+            }
+            ftbaseplancache[i].n = n;
+            ftbaseplancache[i].tasktype = tasktype;
+            ftbaseplancache[i].plan = plan.plan;
+            ftbaseplancache[i].precomputed = plan.precomputed;
+            ftbaseplancache[i].tmpbufsize = plan.tmpbuf.gethighbound()+1;
+            ftbaseplancache[i].stackbufsize = plan.stackbuf.gethighbound()+1;
+        }
+    }
+}
 
 
@@ -64,6 +64,17 @@ Generates real FHT plan
 void ftbasegeneraterealfhtplan(int n, ftplan& plan);
 
 
+/*************************************************************************
+Clears the plan cache.
+
+Generated plans are cached (up to 32 plans), so repeated requests for the
+same N and task type copy the cached plan instead of generating  a  new
+one. Cache is shared by all threads, copies are private to the caller.
+This subroutine frees the memory held by the cache.
+*************************************************************************/
+void ftbaseclearplancache();
+
+
 /*************************************************************************
 This subroutine executes FFT/FHT plan.
 
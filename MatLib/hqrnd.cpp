@@ -22,13 +22,43 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "hqrnd.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static const int hqrndmax = 2147483563;
 static const int hqrndm1 = 2147483563;
 static const int hqrndm2 = 2147483399;
 static const int hqrndmagic = 1634357784;
+static const unsigned int hqrndphiloxm0 = 0xD2511F53;
+static const unsigned int hqrndphiloxm1 = 0xCD9E8D57;
+static const unsigned int hqrndphiloxw0 = 0x9E3779B9;
+static const unsigned int hqrndphiloxw1 = 0xBB67AE85;
+static const int hqrndfillchunk = 8192;
+static const double hqrndparallelwork = 65536.0;
 
 static int hqrndintegerbase(hqrndstate& state);
+static void hqrndphiloxblock(const hqrndstate& state,
+     unsigned int ctr0,
+     unsigned int ctr1,
+     double& u0,
+     double& u1);
+static double hqrndcounteruniform(hqrndstate& state);
+static double hqrndcounternormal(hqrndstate& state);
+static double hqrndcounternext(hqrndstate& state, int kind, double lambda);
+static unsigned long long hqrndcounterposition(const hqrndstate& state);
+static void hqrndcounterfill(hqrndstate& state,
+     int kind,
+     double lambda,
+     double* x,
+     int n);
+static void hqrndfill(hqrndstate& state,
+     int kind,
+     double lambda,
+     int n,
+     ap::real_1d_array& x);
+static int hqrndpowmod(int a, int n, int m);
+static bool hqrndparallel(double work);
 
 /*************************************************************************
 HQRNDState  initialization  with  random  values  which come from standard
@@ -57,6 +87,96 @@ void hqrndseed(int s1, int s2, hqrndstate& state)
     state.s2 = s2%(hqrndm2-1)+1;
     state.v = double(1)/double(hqrndmax);
     state.magicv = hqrndmagic;
+    state.counterbased = false;
+}
+
+
+/*************************************************************************
+HQRNDState initialization: counter-based generator (Philox4x32-10) with
+random key which comes from standard RNG.
+*************************************************************************/
+void hqrndphiloxrandomize(hqrndstate& state)
+{
+
+    hqrndphiloxseed(ap::randominteger(hqrndm1), ap::randominteger(hqrndm2), state);
+}
+
+
+/*************************************************************************
+HQRNDState initialization: counter-based generator (Philox4x32-10) with
+key (S1,S2), substream 0, position 0.
+*************************************************************************/
+void hqrndphiloxseed(int s1, int s2, hqrndstate& state)
+{
+
+    state.s1 = s1;
+    state.s2 = s2;
+    state.v = 0;
+    state.magicv = hqrndmagic;
+    state.counterbased = true;
+    state.key0 = (unsigned int)s1;
+    state.key1 = (unsigned int)s2;
+    state.ctr0 = 0;
+    state.ctr1 = 0;
+    state.stream = 0;
+    state.bufpos = 2;
+    state.buf0 = 0;
+    state.buf1 = 0;
+}
+
+
+/*************************************************************************
+K-th substream of the counter-based generator
+*************************************************************************/
+void hqrndsubstream(const hqrndstate& state, int k, hqrndstate& substate)
+{
+
+    ap::ap_error::make_assertion(state.magicv==hqrndmagic&&state.counterbased, "HQRNDSubstream: State is not a counter-based generator!");
+    ap::ap_error::make_assertion(k>=0, "HQRNDSubstream: K<0!");
+    substate = state;
+    substate.stream = (unsigned int)k;
+    substate.ctr0 = 0;
+    substate.ctr1 = 0;
+    substate.bufpos = 2;
+}
+
+
+/*************************************************************************
+Skip-ahead by N numbers
+*************************************************************************/
+void hqrndskip(hqrndstate& state, int n)
+{
+    unsigned long long pos;
+
+    ap::ap_error::make_assertion(state.magicv==hqrndmagic, "HQRNDSkip: State is not correctly initialized!");
+    ap::ap_error::make_assertion(n>=0, "HQRNDSkip: N<0!");
+    if( n==0 )
+    {
+        return;
+    }
+    if( !state.counterbased )
+    {
+        
+        //
+        // Both components are multiplicative congruential generators,
+        // S := A^N*S mod M
+        //
+        state.s1 = int((unsigned long long)hqrndpowmod(40014, n, hqrndm1)*(unsigned long long)state.s1%(unsigned long long)hqrndm1);
+        state.s2 = int((unsigned long long)hqrndpowmod(40692, n, hqrndm2)*(unsigned long long)state.s2%(unsigned long long)hqrndm2);
+        return;
+    }
+    
+    //
+    // Counter-based generator: block number and position in the block
+    //
+    pos = hqrndcounterposition(state)+(unsigned long long)n;
+    state.ctr0 = (unsigned int)(pos/2);
+    state.ctr1 = (unsigned int)(pos/2>>32);
+    state.bufpos = 2;
+    if( pos%2!=0 )
+    {
+        hqrndcounteruniform(state);
+    }
 }
 
 
@@ -73,6 +193,11 @@ double hqrnduniformr(hqrndstate& state)
 {
     double result;
 
+    if( state.counterbased )
+    {
+        result = hqrndcounteruniform(state);
+        return result;
+    }
     result = state.v*hqrndintegerbase(state);
     return result;
 }
@@ -99,6 +224,15 @@ int hqrnduniformi(int n, hqrndstate& state)
     //
     ap::ap_error::make_assertion(n>0, "HQRNDUniformI: N<=0!");
     ap::ap_error::make_assertion(n<hqrndmax-1, "HQRNDUniformI: N>=RNDBaseMax-1!");
+    if( state.counterbased )
+    {
+        
+        //
+        // 52-bit uniform number: bias is less than N/2^52
+        //
+        result = ap::minint(int(n*hqrndcounteruniform(state)), n-1);
+        return result;
+    }
     mx = hqrndmax-1-(hqrndmax-1)%n;
     do
     {
@@ -127,6 +261,11 @@ double hqrndnormal(hqrndstate& state)
     double v1;
     double v2;
 
+    if( state.counterbased )
+    {
+        result = hqrndcounternormal(state);
+        return result;
+    }
     hqrndnormal2(state, v1, v2);
     result = v1;
     return result;
@@ -177,6 +316,12 @@ void hqrndnormal2(hqrndstate& state, double& x1, double& x2)
     double v;
     double s;
 
+    if( state.counterbased )
+    {
+        x1 = hqrndcounternormal(state);
+        x2 = hqrndcounternormal(state);
+        return;
+    }
     while(true)
     {
         u = 2*hqrnduniformr(state)-1;
@@ -216,6 +361,40 @@ double hqrndexponential(double lambda, hqrndstate& state)
 }
 
 
+/*************************************************************************
+Bulk generation: N uniform numbers in (0,1)
+*************************************************************************/
+void hqrndfilluniform(hqrndstate& state, int n, ap::real_1d_array& x)
+{
+
+    hqrndfill(state, 0, 0.0, n, x);
+}
+
+
+/*************************************************************************
+Bulk generation: N normal numbers
+*************************************************************************/
+void hqrndfillnormal(hqrndstate& state, int n, ap::real_1d_array& x)
+{
+
+    hqrndfill(state, 1, 0.0, n, x);
+}
+
+
+/*************************************************************************
+Bulk generation: N numbers from the exponential distribution
+*************************************************************************/
+void hqrndfillexponential(hqrndstate& state,
+     double lambda,
+     int n,
+     ap::real_1d_array& x)
+{
+
+    ap::ap_error::make_assertion(ap::fp_greater(lambda,0), "HQRNDFillExponential: Lambda<=0!");
+    hqrndfill(state, 2, lambda, n, x);
+}
+
+
 /*************************************************************************
 
 L'Ecuyer, Efficient and portable combined random number generators
@@ -251,5 +430,345 @@ static int hqrndintegerbase(hqrndstate& state)
 }
 
 
+/*************************************************************************
+Philox4x32-10 block for the counter (Ctr0, Ctr1, Stream, 0): four 32-bit
+words are converted to two uniform numbers in (0,1) with 52 random bits.
+
+Salmon, Moraes, Dror, Shaw, "Parallel random numbers: as easy as 1, 2, 3"
+*************************************************************************/
+static void hqrndphiloxblock(const hqrndstate& state,
+     unsigned int ctr0,
+     unsigned int ctr1,
+     double& u0,
+     double& u1)
+{
+    unsigned int c0;
+    unsigned int c1;
+    unsigned int c2;
+    unsigned int c3;
+    unsigned int k0;
+    unsigned int k1;
+    unsigned long long p0;
+    unsigned long long p1;
+    int r;
+
+    c0 = ctr0;
+    c1 = ctr1;
+    c2 = state.stream;
+    c3 = 0;
+    k0 = state.key0;
+    k1 = state.key1;
+    for(r = 0; r <= 9; r++)
+    {
+        p0 = (unsigned long long)hqrndphiloxm0*c0;
+        p1 = (unsigned long long)hqrndphiloxm1*c2;
+        c0 = (unsigned int)(p1>>32)^c1^k0;
+        c2 = (unsigned int)(p0>>32)^c3^k1;
+        c1 = (unsigned int)p1;
+        c3 = (unsigned int)p0;
+        k0 = k0+hqrndphiloxw0;
+        k1 = k1+hqrndphiloxw1;
+    }
+    
+    //
+    // (K+0.5)/2^52 with 52-bit K is strictly inside (0,1)
+    //
+    u0 = (double(c0>>6)*67108864.0+double(c1>>6)+0.5)*2.220446049250313080847e-16;
+    u1 = (double(c2>>6)*67108864.0+double(c3>>6)+0.5)*2.220446049250313080847e-16;
+}
+
+
+/*************************************************************************
+Next uniform number of the counter-based generator
+*************************************************************************/
+static double hqrndcounteruniform(hqrndstate& state)
+{
+    double result;
+
+    if( state.bufpos==2 )
+    {
+        ap::ap_error::make_assertion(state.magicv==hqrndmagic, "HQRNDUniformR: State is not correctly initialized!");
+        hqrndphiloxblock(state, state.ctr0, state.ctr1, state.buf0, state.buf1);
+        state.ctr0 = state.ctr0+1;
+        if( state.ctr0==0 )
+        {
+            state.ctr1 = state.ctr1+1;
+        }
+        state.bufpos = 0;
+    }
+    if( state.bufpos==0 )
+    {
+        result = state.buf0;
+    }
+    else
+    {
+        result = state.buf1;
+    }
+    state.bufpos = state.bufpos+1;
+    return result;
+}
+
+
+/*************************************************************************
+Next normal number of the counter-based generator: Box-Muller transform of
+the pair of uniform numbers from the current block, first number of the
+block is R*cos(Phi), second one is R*sin(Phi).
+*************************************************************************/
+static double hqrndcounternormal(hqrndstate& state)
+{
+    double result;
+    double r;
+    double phi;
+
+    if( state.bufpos==2 )
+    {
+        hqrndcounteruniform(state);
+        state.bufpos = 0;
+    }
+    r = sqrt(-2*log(state.buf0));
+    phi = 2*ap::pi()*state.buf1;
+    if( state.bufpos==0 )
+    {
+        result = r*cos(phi);
+    }
+    else
+    {
+        result = r*sin(phi);
+    }
+    state.bufpos = state.bufpos+1;
+    return result;
+}
+
+
+/*************************************************************************
+Number of numbers generated by the counter-based generator
+*************************************************************************/
+static unsigned long long hqrndcounterposition(const hqrndstate& state)
+{
+    unsigned long long result;
+
+    result = 2*((unsigned long long)state.ctr1<<32|(unsigned long long)state.ctr0);
+    if( state.bufpos<2 )
+    {
+        result = result-2+state.bufpos;
+    }
+    return result;
+}
+
+
+/*************************************************************************
+N numbers of the counter-based generator (Kind=0 - uniform, 1 - normal,
+2 - exponential) are stored to X[0..N-1]. Whole blocks are converted
+directly, without the buffer of the State.
+*************************************************************************/
+static void hqrndcounterfill(hqrndstate& state,
+     int kind,
+     double lambda,
+     double* x,
+     int n)
+{
+    unsigned int ctr0;
+    unsigned int ctr1;
+    double u0;
+    double u1;
+    double r;
+    double phi;
+    int i;
+
+    
+    //
+    // Rest of the current block
+    //
+    i = 0;
+    if( n>0&&state.bufpos==1 )
+    {
+        x[0] = hqrndcounternext(state, kind, lambda);
+        i = 1;
+    }
+    
+    //
+    // Whole blocks
+    //
+    ctr0 = state.ctr0;
+    ctr1 = state.ctr1;
+    if( kind==0 )
+    {
+        for(; i+1 <= n-1; i = i+2)
+        {
+            hqrndphiloxblock(state, ctr0, ctr1, x[i], x[i+1]);
+            ctr0 = ctr0+1;
+            ctr1 = ctr0==0 ? ctr1+1 : ctr1;
+        }
+    }
+    if( kind==1 )
+    {
+        for(; i+1 <= n-1; i = i+2)
+        {
+            hqrndphiloxblock(state, ctr0, ctr1, u0, u1);
+            r = sqrt(-2*log(u0));
+            phi = 2*ap::pi()*u1;
+            x[i] = r*cos(phi);
+            x[i+1] = r*sin(phi);
+            ctr0 = ctr0+1;
+            ctr1 = ctr0==0 ? ctr1+1 : ctr1;
+        }
+    }
+    if( kind==2 )
+    {
+        for(; i+1 <= n-1; i = i+2)
+        {
+            hqrndphiloxblock(state, ctr0, ctr1, u0, u1);
+            x[i] = -log(u0)/lambda;
+            x[i+1] = -log(u1)/lambda;
+            ctr0 = ctr0+1;
+            ctr1 = ctr0==0 ? ctr1+1 : ctr1;
+        }
+    }
+    state.ctr0 = ctr0;
+    state.ctr1 = ctr1;
+    
+    //
+    // Last number (first one of the next block)
+    //
+    if( i<n )
+    {
+        x[i] = hqrndcounternext(state, kind, lambda);
+    }
+}
+
+
+/*************************************************************************
+Next number of the counter-based generator (Kind=0 - uniform, 1 - normal,
+2 - exponential)
+*************************************************************************/
+static double hqrndcounternext(hqrndstate& state, int kind, double lambda)
+{
+    double result;
+
+    if( kind==1 )
+    {
+        result = hqrndcounternormal(state);
+        return result;
+    }
+    result = hqrndcounteruniform(state);
+    if( kind==2 )
+    {
+        result = -log(result)/lambda;
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Bulk generation (Kind=0 - uniform, 1 - normal, 2 - exponential).
 
+Counter-based generator: I-th number depends only on the key and position,
+so X is split into chunks of HQRNDFillChunk numbers which may be generated
+by different threads, each one with its own copy of the State advanced to
+the beginning of the chunk.
+*************************************************************************/
+static void hqrndfill(hqrndstate& state,
+     int kind,
+     double lambda,
+     int n,
+     ap::real_1d_array& x)
+{
+    double v1;
+    double v2;
+    int nchunks;
+    int c;
+    int i;
+
+    ap::ap_error::make_assertion(n>=0, "HQRNDFill: N<0!");
+    ap::ap_error::make_assertion(state.magicv==hqrndmagic, "HQRNDFill: State is not correctly initialized!");
+    x.setlength(n);
+    if( n==0 )
+    {
+        return;
+    }
+    if( !state.counterbased )
+    {
+        if( kind==1 )
+        {
+            for(i = 0; i+1 <= n-1; i = i+2)
+            {
+                hqrndnormal2(state, v1, v2);
+                x(i) = v1;
+                x(i+1) = v2;
+            }
+            if( n%2!=0 )
+            {
+                x(n-1) = hqrndnormal(state);
+            }
+            return;
+        }
+        for(i = 0; i <= n-1; i++)
+        {
+            if( kind==0 )
+            {
+                x(i) = hqrnduniformr(state);
+            }
+            else
+            {
+                x(i) = hqrndexponential(lambda, state);
+            }
+        }
+        return;
+    }
+    if( !hqrndparallel(double(n)) )
+    {
+        hqrndcounterfill(state, kind, lambda, &x(0), n);
+        return;
+    }
+    nchunks = (n+hqrndfillchunk-1)/hqrndfillchunk;
+    #pragma omp parallel for schedule(static)
+    for(c = 0; c <= nchunks-1; c++)
+    {
+        hqrndstate cstate;
+
+        cstate = state;
+        hqrndskip(cstate, c*hqrndfillchunk);
+        hqrndcounterfill(cstate, kind, lambda, &x(c*hqrndfillchunk), ap::minint(hqrndfillchunk, n-c*hqrndfillchunk));
+    }
+    hqrndskip(state, n);
+}
 
+
+/*************************************************************************
+A^N mod M for 0<A<M<2^31
+*************************************************************************/
+static int hqrndpowmod(int a, int n, int m)
+{
+    unsigned long long r;
+    unsigned long long b;
+
+    r = 1;
+    b = (unsigned long long)a;
+    while( n>0 )
+    {
+        if( n%2!=0 )
+        {
+            r = r*b%(unsigned long long)m;
+        }
+        b = b*b%(unsigned long long)m;
+        n = n/2;
+    }
+    return int(r);
+}
+
+
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool hqrndparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,hqrndparallelwork);
+#endif
+    return result;
+}
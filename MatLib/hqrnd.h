@@ -28,13 +28,21 @@ http://www.fsf.org/licensing/licenses
 
 /*************************************************************************
 Portable high quality random number generator state.
-Initialized with HQRNDRandomize() or HQRNDSeed().
+Initialized with HQRNDRandomize() or HQRNDSeed() (L'Ecuyer generator), or
+with HQRNDPhiloxRandomize() or HQRNDPhiloxSeed() (counter-based generator).
 
 Fields:
     S1, S2      -   seed values
     V           -   precomputed value
     MagicV      -   'magic' value used to determine whether State structure
                     was correctly initialized.
+    CounterBased-   whether counter-based generator is used
+    Key0, Key1  -   Philox key (counter-based generator)
+    Ctr0, Ctr1  -   low and high words of the number of the next block
+    Stream      -   substream number
+    BufPos      -   number of values from Buf0/Buf1 which were used,
+                    2 means that buffer is empty
+    Buf0, Buf1  -   uniform numbers from the current block
 *************************************************************************/
 struct hqrndstate
 {
@@ -42,6 +50,15 @@ struct hqrndstate
     int s2;
     double v;
     int magicv;
+    bool counterbased;
+    unsigned int key0;
+    unsigned int key1;
+    unsigned int ctr0;
+    unsigned int ctr1;
+    unsigned int stream;
+    int bufpos;
+    double buf0;
+    double buf1;
 };
 
 
@@ -66,6 +83,66 @@ HQRNDState initialization with seed values
 void hqrndseed(int s1, int s2, hqrndstate& state);
 
 
+/*************************************************************************
+HQRNDState initialization: counter-based generator (Philox4x32-10) with
+random key which comes from standard RNG.
+
+Counter-based generator calculates I-th number of the sequence as a
+function of the key and I, so it supports skip-ahead (HQRNDSkip) and
+independent substreams (HQRNDSubstream), and bulk generation functions
+(HQRNDFillUniform and others) may split their work between threads with
+results which don't depend on the number of threads.
+
+With counter-based generator HQRNDNormal() and HQRNDNormal2() use Box-
+Muller transform instead of polar method.
+*************************************************************************/
+void hqrndphiloxrandomize(hqrndstate& state);
+
+
+/*************************************************************************
+HQRNDState initialization: counter-based generator (Philox4x32-10) with
+key (S1,S2), substream 0, position 0.
+*************************************************************************/
+void hqrndphiloxseed(int s1, int s2, hqrndstate& state);
+
+
+/*************************************************************************
+This function returns K-th substream of the counter-based generator:
+generator with the same key, but independent sequence of numbers (each
+substream has 2^65 numbers). Substream starts from the first number.
+
+Substreams may be used to give independent generators to the parts of
+the parallel computation, e.g. K-th substream to the K-th tree of the
+decision forest.
+
+INPUT PARAMETERS:
+    State       -   counter-based generator
+    K           -   substream number, K>=0
+
+OUTPUT PARAMETERS:
+    SubState    -   generator for the K-th substream
+*************************************************************************/
+void hqrndsubstream(const hqrndstate& state, int k, hqrndstate& substate);
+
+
+/*************************************************************************
+Skip-ahead: state is advanced as if N numbers were generated.
+
+For the counter-based generator one number is one call of HQRNDUniformR,
+HQRNDUniformI, HQRNDNormal or HQRNDExponential (HQRNDNormal2 generates two
+numbers), skip needs O(1) time.
+
+For the L'Ecuyer generator one number is one call of the base generator:
+HQRNDUniformR or HQRNDExponential. HQRNDUniformI and HQRNDNormal consume
+variable amount of numbers. Skip needs O(log(N)) time.
+
+INPUT PARAMETERS:
+    State       -   initialized generator
+    N           -   N>=0
+*************************************************************************/
+void hqrndskip(hqrndstate& state, int n);
+
+
 /*************************************************************************
 This function generates random real number in (0,1),
 not including interval boundaries
@@ -140,5 +217,61 @@ State structure must be initialized with HQRNDRandomize() or HQRNDSeed().
 double hqrndexponential(double lambda, hqrndstate& state);
 
 
+/*************************************************************************
+Bulk generation: N uniform numbers in (0,1).
+
+Results are equal to those of N calls of HQRNDUniformR(), State is
+advanced by N numbers. With counter-based generator large N are split
+between threads, results don't depend on the number of threads.
+
+INPUT PARAMETERS:
+    State       -   initialized generator
+    N           -   N>=0
+
+OUTPUT PARAMETERS:
+    X           -   array[0..N-1]
+*************************************************************************/
+void hqrndfilluniform(hqrndstate& state, int n, ap::real_1d_array& x);
+
+
+/*************************************************************************
+Bulk generation: N normal numbers.
+
+With counter-based generator results are equal to those of N calls of
+HQRNDNormal(); large N are split between threads, results don't depend on
+the number of threads. With L'Ecuyer generator numbers are generated in
+pairs by HQRNDNormal2().
+
+INPUT PARAMETERS:
+    State       -   initialized generator
+    N           -   N>=0
+
+OUTPUT PARAMETERS:
+    X           -   array[0..N-1]
+*************************************************************************/
+void hqrndfillnormal(hqrndstate& state, int n, ap::real_1d_array& x);
+
+
+/*************************************************************************
+Bulk generation: N numbers from the exponential distribution.
+
+Results are equal to those of N calls of HQRNDExponential(), State is
+advanced by N numbers. With counter-based generator large N are split
+between threads, results don't depend on the number of threads.
+
+INPUT PARAMETERS:
+    State       -   initialized generator
+    Lambda      -   Lambda>0
+    N           -   N>=0
+
+OUTPUT PARAMETERS:
+    X           -   array[0..N-1]
+*************************************************************************/
+void hqrndfillexponential(hqrndstate& state,
+     double lambda,
+     int n,
+     ap::real_1d_array& x);
+
+
 #endif
 
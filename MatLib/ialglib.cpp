@@ -6,6 +6,11 @@ optimized ALGLIB subroutines.
 #include "ialglib.h"
 //#include "emmintrin.h"
 //#include "mmintrin.h"
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#include <emmintrin.h>
+#endif
 
 static const int alglib_simd_alignment = 16;
 static const int alglib_r_block        = 32;
@@ -14,6 +19,11 @@ static const int alglib_half_r_block   = alglib_r_block/2;
 static const int alglib_half_c_block   = alglib_c_block/2;
 static const int alglib_twice_r_block  = alglib_r_block*2;
 static const int alglib_twice_c_block  = alglib_c_block*2;
+static const int alglib_gemm_mr        = 4;
+static const int alglib_gemm_nr        = 8;
+static const int alglib_gemm_mc        = 128;
+static const int alglib_gemm_kc        = 256;
+static const int alglib_gemm_nc        = 2048;
 //#define ABLAS_PREFETCH(x) _mm_prefetch((const char*)(x),_MM_HINT_T0)
 //#define ABLAS_PREFETCH(x)
 
@@ -780,6 +790,327 @@ bool ialglib::_i_rmatrixgemmf(int m,
 }
 
 
+/********************************************************************
+Register-blocked micro-kernel of the packed GEMM:
+
+    AB := PA*PB
+
+where PA is MR x KC sliver of A (packed by columns, MR elements per
+column), PB is KC x NR sliver of B (packed by rows, NR elements per
+row). AB is MR x NR matrix, row-major, stride NR.
+
+AVX2/FMA code is used when compiler targets it, SSE2 code on other x86
+and x64 targets, generic C code (which is simple enough to be vectorized
+by compiler) otherwise.
+********************************************************************/
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+static void gemm_micro_4x8(int kc, const double *pa, const double *pb, double *ab)
+{
+    int p;
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    __m256d b0, b1, a;
+    for(p=0; p<kc; p++, pa+=alglib_gemm_mr, pb+=alglib_gemm_nr)
+    {
+        b0 = _mm256_loadu_pd(pb);
+        b1 = _mm256_loadu_pd(pb+4);
+        a = _mm256_broadcast_sd(pa+0);
+        c00 = _mm256_fmadd_pd(a, b0, c00);
+        c01 = _mm256_fmadd_pd(a, b1, c01);
+        a = _mm256_broadcast_sd(pa+1);
+        c10 = _mm256_fmadd_pd(a, b0, c10);
+        c11 = _mm256_fmadd_pd(a, b1, c11);
+        a = _mm256_broadcast_sd(pa+2);
+        c20 = _mm256_fmadd_pd(a, b0, c20);
+        c21 = _mm256_fmadd_pd(a, b1, c21);
+        a = _mm256_broadcast_sd(pa+3);
+        c30 = _mm256_fmadd_pd(a, b0, c30);
+        c31 = _mm256_fmadd_pd(a, b1, c31);
+    }
+    _mm256_storeu_pd(ab+0,  c00);
+    _mm256_storeu_pd(ab+4,  c01);
+    _mm256_storeu_pd(ab+8,  c10);
+    _mm256_storeu_pd(ab+12, c11);
+    _mm256_storeu_pd(ab+16, c20);
+    _mm256_storeu_pd(ab+20, c21);
+    _mm256_storeu_pd(ab+24, c30);
+    _mm256_storeu_pd(ab+28, c31);
+}
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+static void gemm_micro_4x4_sse2(int kc, const double *pa, const double *pb, double *ab)
+{
+    int p;
+    __m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd();
+    __m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+    __m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd();
+    __m128d c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+    __m128d b0, b1, a;
+    for(p=0; p<kc; p++, pa+=alglib_gemm_mr, pb+=alglib_gemm_nr)
+    {
+        b0 = _mm_loadu_pd(pb);
+        b1 = _mm_loadu_pd(pb+2);
+        a = _mm_load1_pd(pa+0);
+        c00 = _mm_add_pd(c00, _mm_mul_pd(a, b0));
+        c01 = _mm_add_pd(c01, _mm_mul_pd(a, b1));
+        a = _mm_load1_pd(pa+1);
+        c10 = _mm_add_pd(c10, _mm_mul_pd(a, b0));
+        c11 = _mm_add_pd(c11, _mm_mul_pd(a, b1));
+        a = _mm_load1_pd(pa+2);
+        c20 = _mm_add_pd(c20, _mm_mul_pd(a, b0));
+        c21 = _mm_add_pd(c21, _mm_mul_pd(a, b1));
+        a = _mm_load1_pd(pa+3);
+        c30 = _mm_add_pd(c30, _mm_mul_pd(a, b0));
+        c31 = _mm_add_pd(c31, _mm_mul_pd(a, b1));
+    }
+    _mm_storeu_pd(ab+0*alglib_gemm_nr,   c00);
+    _mm_storeu_pd(ab+0*alglib_gemm_nr+2, c01);
+    _mm_storeu_pd(ab+1*alglib_gemm_nr,   c10);
+    _mm_storeu_pd(ab+1*alglib_gemm_nr+2, c11);
+    _mm_storeu_pd(ab+2*alglib_gemm_nr,   c20);
+    _mm_storeu_pd(ab+2*alglib_gemm_nr+2, c21);
+    _mm_storeu_pd(ab+3*alglib_gemm_nr,   c30);
+    _mm_storeu_pd(ab+3*alglib_gemm_nr+2, c31);
+}
+
+static void gemm_micro_4x8(int kc, const double *pa, const double *pb, double *ab)
+{
+    //
+    // 16 SSE registers are not enough for 4x8 block,
+    // it is processed as two 4x4 halves
+    //
+    gemm_micro_4x4_sse2(kc, pa, pb, ab);
+    gemm_micro_4x4_sse2(kc, pa, pb+4, ab+4);
+}
+#else
+static void gemm_micro_4x8(int kc, const double *pa, const double *pb, double *ab)
+{
+    int p, j;
+    double c0[alglib_gemm_nr], c1[alglib_gemm_nr], c2[alglib_gemm_nr], c3[alglib_gemm_nr];
+    for(j=0; j<alglib_gemm_nr; j++)
+    {
+        c0[j] = 0;
+        c1[j] = 0;
+        c2[j] = 0;
+        c3[j] = 0;
+    }
+    for(p=0; p<kc; p++, pa+=alglib_gemm_mr, pb+=alglib_gemm_nr)
+    {
+        double a0 = pa[0], a1 = pa[1], a2 = pa[2], a3 = pa[3];
+        for(j=0; j<alglib_gemm_nr; j++)
+        {
+            c0[j] += a0*pb[j];
+            c1[j] += a1*pb[j];
+            c2[j] += a2*pb[j];
+            c3[j] += a3*pb[j];
+        }
+    }
+    for(j=0; j<alglib_gemm_nr; j++)
+    {
+        ab[0*alglib_gemm_nr+j] = c0[j];
+        ab[1*alglib_gemm_nr+j] = c1[j];
+        ab[2*alglib_gemm_nr+j] = c2[j];
+        ab[3*alglib_gemm_nr+j] = c3[j];
+    }
+}
+#endif
+
+
+/********************************************************************
+Packs MxK block of op(A) into MR-row slivers, K elements of each
+column of sliver are stored contiguously. Rows past M are zero.
+
+A points to op(A)[0][0], op=0 for A, op=1 for A^T.
+********************************************************************/
+static void gemm_pack_a(int m, int k, const double *a, int op, int stride, double *buf)
+{
+    int i, i0, p, mr;
+    for(i0=0; i0<m; i0+=alglib_gemm_mr, buf+=alglib_gemm_mr*k)
+    {
+        mr = m-i0<alglib_gemm_mr ? m-i0 : alglib_gemm_mr;
+        if( op==0 )
+        {
+            for(i=0; i<mr; i++)
+            {
+                const double *src = a+(i0+i)*stride;
+                for(p=0; p<k; p++)
+                    buf[p*alglib_gemm_mr+i] = src[p];
+            }
+        }
+        else
+        {
+            for(p=0; p<k; p++)
+            {
+                const double *src = a+p*stride+i0;
+                for(i=0; i<mr; i++)
+                    buf[p*alglib_gemm_mr+i] = src[i];
+            }
+        }
+        for(i=mr; i<alglib_gemm_mr; i++)
+            for(p=0; p<k; p++)
+                buf[p*alglib_gemm_mr+i] = 0;
+    }
+}
+
+
+/********************************************************************
+Packs KxN block of op(B) into NR-column slivers, NR elements of each
+row of sliver are stored contiguously. Columns past N are zero.
+
+B points to op(B)[0][0], op=0 for B, op=1 for B^T.
+********************************************************************/
+static void gemm_pack_b(int k, int n, const double *b, int op, int stride, double *buf)
+{
+    int j, j0, p, nr;
+    for(j0=0; j0<n; j0+=alglib_gemm_nr, buf+=alglib_gemm_nr*k)
+    {
+        nr = n-j0<alglib_gemm_nr ? n-j0 : alglib_gemm_nr;
+        if( op==0 )
+        {
+            for(p=0; p<k; p++)
+            {
+                const double *src = b+p*stride+j0;
+                for(j=0; j<nr; j++)
+                    buf[p*alglib_gemm_nr+j] = src[j];
+            }
+        }
+        else
+        {
+            for(j=0; j<nr; j++)
+            {
+                const double *src = b+(j0+j)*stride;
+                for(p=0; p<k; p++)
+                    buf[p*alglib_gemm_nr+j] = src[p];
+            }
+        }
+        for(j=nr; j<alglib_gemm_nr; j++)
+            for(p=0; p<k; p++)
+                buf[p*alglib_gemm_nr+j] = 0;
+    }
+}
+
+
+/********************************************************************
+This is real GEMM for large matrices:
+
+    C := alpha*op(A)*op(B) + beta*C
+
+Blocks of op(B) (KC x NC) and op(A) (MC x KC) are packed into slivers
+which are multiplied by register-blocked MR x NR micro-kernel.
+Block sizes are chosen so that packed A fits into L2 cache and MR x NR
+sliver of C stays in registers.
+
+Beta=0 means that C is not referenced (not multiplied by zero).
+Alpha=0 means that A and B are not referenced.
+Always returns true.
+********************************************************************/
+bool ialglib::_i_rmatrixgemmpacked(int m,
+     int n,
+     int k,
+     double alpha,
+     const ap::real_2d_array& _a,
+     int ia,
+     int ja,
+     int optypea,
+     const ap::real_2d_array& _b,
+     int ib,
+     int jb,
+     int optypeb,
+     double beta,
+     ap::real_2d_array& _c,
+     int ic,
+     int jc)
+{
+    int i, j, i0, j0, p0, mb, nb, kb, mr, nr, astride, bstride, cstride;
+    double bb;
+    double *c, *crow;
+    const double *a, *b;
+    double ab[alglib_gemm_mr*alglib_gemm_nr];
+    ap::real_1d_array bufa, bufb;
+
+    if( m<=0 || n<=0 )
+        return true;
+    cstride = _c.getstride();
+    c = &_c(ic,jc);
+
+    //
+    // C := beta*C
+    //
+    if( k<=0 || alpha==0 )
+    {
+        for(i=0, crow=c; i<m; i++, crow+=cstride)
+        {
+            if( beta==0 )
+                vzero(n, crow, 1);
+            else
+                for(j=0; j<n; j++)
+                    crow[j] *= beta;
+        }
+        return true;
+    }
+
+    //
+    // General case
+    //
+    astride = _a.getstride();
+    bstride = _b.getstride();
+    a = &_a(ia,ja);
+    b = &_b(ib,jb);
+    nb = n<alglib_gemm_nc ? n : alglib_gemm_nc;
+    kb = k<alglib_gemm_kc ? k : alglib_gemm_kc;
+    mb = m<alglib_gemm_mc ? m : alglib_gemm_mc;
+    bufa.setlength(((mb+alglib_gemm_mr-1)/alglib_gemm_mr)*alglib_gemm_mr*kb);
+    bufb.setlength(((nb+alglib_gemm_nr-1)/alglib_gemm_nr)*alglib_gemm_nr*kb);
+    for(j0=0; j0<n; j0+=alglib_gemm_nc)
+    {
+        nb = n-j0<alglib_gemm_nc ? n-j0 : alglib_gemm_nc;
+        for(p0=0; p0<k; p0+=alglib_gemm_kc)
+        {
+            kb = k-p0<alglib_gemm_kc ? k-p0 : alglib_gemm_kc;
+            bb = p0==0 ? beta : 1.0;
+            if( optypeb==0 )
+                gemm_pack_b(kb, nb, b+p0*bstride+j0, 0, bstride, bufb.getcontent());
+            else
+                gemm_pack_b(kb, nb, b+j0*bstride+p0, 1, bstride, bufb.getcontent());
+            for(i0=0; i0<m; i0+=alglib_gemm_mc)
+            {
+                mb = m-i0<alglib_gemm_mc ? m-i0 : alglib_gemm_mc;
+                if( optypea==0 )
+                    gemm_pack_a(mb, kb, a+i0*astride+p0, 0, astride, bufa.getcontent());
+                else
+                    gemm_pack_a(mb, kb, a+p0*astride+i0, 1, astride, bufa.getcontent());
+                for(j=0; j<nb; j+=alglib_gemm_nr)
+                {
+                    nr = nb-j<alglib_gemm_nr ? nb-j : alglib_gemm_nr;
+                    for(i=0; i<mb; i+=alglib_gemm_mr)
+                    {
+                        int ii, jj;
+                        mr = mb-i<alglib_gemm_mr ? mb-i : alglib_gemm_mr;
+                        gemm_micro_4x8(kb, bufa.getcontent()+i*kb, bufb.getcontent()+j*kb, ab);
+                        crow = c+(i0+i)*cstride+j0+j;
+                        for(ii=0; ii<mr; ii++, crow+=cstride)
+                        {
+                            const double *pab = ab+ii*alglib_gemm_nr;
+                            if( bb==0 )
+                                for(jj=0; jj<nr; jj++)
+                                    crow[jj] = alpha*pab[jj];
+                            else if( bb==1 )
+                                for(jj=0; jj<nr; jj++)
+                                    crow[jj] += alpha*pab[jj];
+                            else
+                                for(jj=0; jj<nr; jj++)
+                                    crow[jj] = bb*crow[jj]+alpha*pab[jj];
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
 /********************************************************************
 complex GEMM kernel
 ********************************************************************/
@@ -41,6 +41,22 @@ bool _i_rmatrixgemmf(int m,
      ap::real_2d_array& c,
      int ic,
      int jc);
+bool _i_rmatrixgemmpacked(int m,
+     int n,
+     int k,
+     double alpha,
+     const ap::real_2d_array& a,
+     int ia,
+     int ja,
+     int optypea,
+     const ap::real_2d_array& b,
+     int ib,
+     int jb,
+     int optypeb,
+     double beta,
+     ap::real_2d_array& c,
+     int ic,
+     int jc);
 bool _i_cmatrixgemmf(int m,
      int n,
      int k,
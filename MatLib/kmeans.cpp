@@ -20,16 +20,49 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "kmeans.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
+//
+// Minimal amount of work (NPoints*K*NVars) which is worth starting threads
+//
+static const double kmeansparallelwork = 262144.0;
+
+static bool kmeansrun(const ap::real_2d_array& xy,
+     int npoints,
+     int nvars,
+     int k,
+     hqrndstate& rs,
+     ap::real_2d_array& ct,
+     ap::integer_1d_array& xyc,
+     double& e);
+static void kmeansassignpoint(const ap::real_2d_array& xy,
+     int i,
+     int nvars,
+     int k,
+     const ap::real_2d_array& ct,
+     const ap::real_1d_array& cs,
+     bool fullpass,
+     ap::integer_1d_array& xyc,
+     ap::real_1d_array& ub,
+     ap::real_1d_array& lb);
+static int kmeansnearest(const double* x,
+     const ap::real_2d_array& ct,
+     int nvars,
+     int k,
+     double& d1,
+     double& d2);
+static double kmeansdist2(const double* x, const double* y, int n);
+static bool kmeansparallel(double work);
 static bool selectcenterpp(const ap::real_2d_array& xy,
      int npoints,
      int nvars,
      ap::real_2d_array& centers,
-     ap::boolean_1d_array busycenters,
+     ap::boolean_1d_array& busycenters,
      int ccnt,
      ap::real_1d_array& d2,
-     ap::real_1d_array& p,
-     ap::real_1d_array& tmp);
+     hqrndstate& rs);
 
 /*************************************************************************
 k-means++ clusterization
@@ -52,6 +85,19 @@ OUTPUT PARAMETERS:
     XYC         -   array which contains number of clusters dataset points
                     belong to.
 
+NOTES:
+    Lloyd iterations use Hamerly's bounds (one upper bound and one lower
+    bound per point), so points which are known to stay in their cluster
+    are not compared against all K centers. Result is the same as the one
+    of the plain Lloyd algorithm.
+
+    When OpenMP is enabled, restarts are run in parallel (if there are at
+    least as many restarts as threads) or the assignment step is split
+    between threads. Each restart uses its own random stream seeded from
+    the standard RNG, and the partition with the lowest energy is returned
+    (the first one among equal ones), so result does not depend on the
+    number of threads.
+
   -- ALGLIB --
      Copyright 21.03.2009 by Bochkanov Sergey
 *************************************************************************/
@@ -64,24 +110,12 @@ void kmeansgenerate(const ap::real_2d_array& xy,
      ap::real_2d_array& c,
      ap::integer_1d_array& xyc)
 {
-    int i;
-    int j;
-    ap::real_2d_array ct;
     ap::real_2d_array ctbest;
-    double e;
+    hqrndstate rs;
     double ebest;
-    ap::real_1d_array x;
-    ap::real_1d_array tmp;
-    ap::real_1d_array d2;
-    ap::real_1d_array p;
-    ap::integer_1d_array csizes;
-    ap::boolean_1d_array cbusy;
-    double v;
-    int cclosest;
-    double dclosest;
-    ap::real_1d_array work;
-    bool waschanges;
-    bool zerosizeclusters;
+    int bestpass;
+    bool degenerate;
+    bool prestarts;
     int pass;
 
     
@@ -101,172 +135,618 @@ void kmeansgenerate(const ap::real_2d_array& xy,
     info = 1;
     
     //
-    // Multiple passes of k-means++ algorithm
+    // Pass-th restart uses Pass-th substream of the counter-based
+    // generator, so the results do not depend on the order in which
+    // restarts finish.
     //
-    ct.setbounds(0, k-1, 0, nvars-1);
-    ctbest.setbounds(0, k-1, 0, nvars-1);
-    xyc.setbounds(0, npoints-1);
-    d2.setbounds(0, npoints-1);
-    p.setbounds(0, npoints-1);
-    tmp.setbounds(0, nvars-1);
-    csizes.setbounds(0, k-1);
-    cbusy.setbounds(0, k-1);
+    hqrndphiloxrandomize(rs);
+    
+    //
+    // Multiple passes of k-means++ algorithm.
+    //
+    // Restarts are run in parallel only when there is enough of them to
+    // keep all threads busy; otherwise each restart splits its assignment
+    // step between threads (KMeansRun decides it by itself: it is serial
+    // when called from the parallel region).
+    //
+    prestarts = false;
+#ifdef _OPENMP
+    prestarts = restarts>=omp_get_max_threads()&&kmeansparallel(double(npoints)*double(k)*double(nvars));
+#endif
     ebest = ap::maxrealnumber;
-    for(pass = 1; pass <= restarts; pass++)
+    bestpass = -1;
+    degenerate = false;
+    #pragma omp parallel for schedule(dynamic,1) if( prestarts )
+    for(pass = 0; pass <= restarts-1; pass++)
     {
-        
-        //
-        // Select initial centers  using k-means++ algorithm
-        // 1. Choose first center at random
-        // 2. Choose next centers using their distance from centers already chosen
-        //
-        // Note that for performance reasons centers are stored in ROWS of CT, not
-        // in columns. We'll transpose CT in the end and store it in the C.
-        //
-        i = ap::randominteger(npoints);
-        ap::vmove(&ct(0, 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
-        cbusy(0) = true;
-        for(i = 1; i <= k-1; i++)
+        ap::real_2d_array ct;
+        ap::integer_1d_array cxyc;
+        hqrndstate prs;
+        double e;
+        bool ok;
+
+        hqrndsubstream(rs, pass, prs);
+        ok = kmeansrun(xy, npoints, nvars, k, prs, ct, cxyc, e);
+        #pragma omp critical (kmeans_best)
         {
-            cbusy(i) = false;
+            if( !ok )
+            {
+                degenerate = true;
+            }
+            else
+            {
+                if( bestpass<0||ap::fp_less(e,ebest)||(ap::fp_eq(e,ebest)&&pass<bestpass) )
+                {
+                    
+                    //
+                    // store partition
+                    //
+                    ebest = e;
+                    bestpass = pass;
+                    ctbest.swap(ct);
+                    xyc.swap(cxyc);
+                }
+            }
         }
-        if( !selectcenterpp(xy, npoints, nvars, ct, cbusy, k, d2, p, tmp) )
+    }
+    if( degenerate )
+    {
+        info = -3;
+        return;
+    }
+    
+    //
+    // Copy and transpose
+    //
+    c.setbounds(0, nvars-1, 0, k-1);
+    copyandtranspose(ctbest, 0, k-1, 0, nvars-1, c, 0, nvars-1, 0, k-1);
+}
+
+
+/*************************************************************************
+Mini-batch k-means: initialization of the state.
+
+Centers are fitted with the mini-batch algorithm of Sculley (2010): each
+batch is assigned to the current centers, then every center is moved
+towards its points with learning rate 1/(number of points assigned to
+this center so far). Dataset is never stored, so it may be much larger
+than the available memory: it is passed by parts to KMeansMiniBatchUpdate().
+Centers of the first batch are selected with k-means++ rule.
+
+INPUT PARAMETERS:
+    NVars       -   number of variables, NVars>=1
+    K           -   desired number of clusters, K>=1
+
+OUTPUT PARAMETERS:
+    State       -   structure which stores algorithm state
+*************************************************************************/
+void kmeansminibatchcreate(int nvars, int k, kmeansminibatchstate& state)
+{
+    int i;
+    int j;
+
+    ap::ap_error::make_assertion(nvars>=1, "KMeansMiniBatchCreate: NVars<1!");
+    ap::ap_error::make_assertion(k>=1, "KMeansMiniBatchCreate: K<1!");
+    state.nvars = nvars;
+    state.k = k;
+    state.initialized = false;
+    state.ct.setlength(k, nvars);
+    state.ccnt.setlength(k);
+    state.cbusy.setlength(k);
+    for(i = 0; i <= k-1; i++)
+    {
+        for(j = 0; j <= nvars-1; j++)
+        {
+            state.ct(i,j) = 0;
+        }
+        state.ccnt(i) = 0;
+    }
+    hqrndrandomize(state.rs);
+}
+
+
+/*************************************************************************
+Mini-batch k-means: next batch of the dataset.
+
+INPUT PARAMETERS:
+    State       -   structure created by KMeansMiniBatchCreate()
+    XY          -   batch, array [0..NPoints-1,0..NVars-1]. Batches should
+                    be drawn at random from the dataset (or the dataset
+                    should be shuffled before it is split into batches).
+    NPoints     -   batch size, NPoints>=1 (NPoints>=K for the first one)
+
+OUTPUT PARAMETERS:
+    Info        -   return code:
+                    * -3, if first batch is degenerate (number of distinct
+                          points is less than K), state is not changed
+                    * -1, if incorrect NPoints was passed
+                    *  1, if subroutine finished successfully
+*************************************************************************/
+void kmeansminibatchupdate(kmeansminibatchstate& state,
+     const ap::real_2d_array& xy,
+     int npoints,
+     int& info)
+{
+    int i;
+    int c;
+    double v;
+
+    if( npoints<1||(!state.initialized&&npoints<state.k) )
+    {
+        info = -1;
+        return;
+    }
+    if( state.d2.gethighbound()<npoints-1 )
+    {
+        state.d2.setlength(npoints);
+        state.xyc.setlength(npoints);
+    }
+    
+    //
+    // First batch: k-means++ initialization
+    //
+    if( !state.initialized )
+    {
+        i = hqrnduniformi(npoints, state.rs);
+        ap::vmove(&state.ct(0, 0), 1, &xy(i, 0), 1, ap::vlen(0,state.nvars-1));
+        state.cbusy(0) = true;
+        for(i = 1; i <= state.k-1; i++)
+        {
+            state.cbusy(i) = false;
+        }
+        if( !selectcenterpp(xy, npoints, state.nvars, state.ct, state.cbusy, state.k, state.d2, state.rs) )
         {
             info = -3;
             return;
         }
+        state.initialized = true;
+    }
+    info = 1;
+    
+    //
+    // Assign the batch to the current centers,
+    // then update centers with per-center learning rates.
+    //
+    #pragma omp parallel for schedule(static) private(v) if( kmeansparallel(double(npoints)*double(state.k)*double(state.nvars)) )
+    for(i = 0; i <= npoints-1; i++)
+    {
+        state.xyc(i) = kmeansnearest(&xy(i, 0), state.ct, state.nvars, state.k, state.d2(i), v);
+    }
+    for(i = 0; i <= npoints-1; i++)
+    {
+        c = state.xyc(i);
+        state.ccnt(c) = state.ccnt(c)+1;
+        v = 1/state.ccnt(c);
+        ap::vmul(&state.ct(c, 0), 1, ap::vlen(0,state.nvars-1), 1-v);
+        ap::vadd(&state.ct(c, 0), 1, &xy(i, 0), 1, ap::vlen(0,state.nvars-1), v);
+    }
+}
+
+
+/*************************************************************************
+Mini-batch k-means: current centers.
+
+INPUT PARAMETERS:
+    State       -   structure used by KMeansMiniBatchUpdate()
+
+OUTPUT PARAMETERS:
+    C           -   array[0..NVars-1,0..K-1].matrix whose columns store
+                    cluster's centers (zero if no batch was processed yet)
+*************************************************************************/
+void kmeansminibatchresults(const kmeansminibatchstate& state,
+     ap::real_2d_array& c)
+{
+
+    c.setbounds(0, state.nvars-1, 0, state.k-1);
+    copyandtranspose(state.ct, 0, state.k-1, 0, state.nvars-1, c, 0, state.nvars-1, 0, state.k-1);
+}
+
+
+/*************************************************************************
+One restart of k-means++ algorithm.
+
+Centers are stored in ROWS of CT, E is the energy of the final partition.
+Returns False for degenerate problem.
+
+Lloyd iterations maintain Hamerly's bounds: UB(i) is an upper bound for
+the distance from I-th point to its center, LB(i) is a lower bound for
+the distance to the second closest center. After the centers move, bounds
+are adjusted by the center shifts. I-th point can not change its cluster
+if UB(i) is less than LB(i) or than CS(XYC(i)), half the distance from its
+center to the closest other one; all K distances are computed only when
+both tests fail (first time with the old UB(i), then with the exact one).
+Sums of the clusters are updated only for points which moved.
+*************************************************************************/
+static bool kmeansrun(const ap::real_2d_array& xy,
+     int npoints,
+     int nvars,
+     int k,
+     hqrndstate& rs,
+     ap::real_2d_array& ct,
+     ap::integer_1d_array& xyc,
+     double& e)
+{
+    bool result;
+    int i;
+    int j;
+    int j1;
+    int c;
+    ap::real_2d_array csums;
+    ap::integer_1d_array csizes;
+    ap::integer_1d_array xycprev;
+    ap::boolean_1d_array cbusy;
+    ap::real_1d_array ub;
+    ap::real_1d_array lb;
+    ap::real_1d_array cs;
+    ap::real_1d_array cmove;
+    ap::real_1d_array d2;
+    ap::real_1d_array tmp;
+    double v;
+    double m1;
+    double m2;
+    bool waschanges;
+    bool zerosizeclusters;
+    bool fullpass;
+    bool parallel;
+
+    ct.setlength(k, nvars);
+    csums.setlength(k, nvars);
+    csizes.setlength(k);
+    cbusy.setlength(k);
+    cs.setlength(k);
+    cmove.setlength(k);
+    tmp.setlength(nvars);
+    xyc.setlength(npoints);
+    xycprev.setlength(npoints);
+    ub.setlength(npoints);
+    lb.setlength(npoints);
+    d2.setlength(npoints);
+    parallel = kmeansparallel(double(npoints)*double(k)*double(nvars));
+    
+    //
+    // Select initial centers  using k-means++ algorithm
+    // 1. Choose first center at random
+    // 2. Choose next centers using their distance from centers already chosen
+    //
+    // Note that for performance reasons centers are stored in ROWS of CT, not
+    // in columns. We'll transpose CT in the end and store it in the C.
+    //
+    i = hqrnduniformi(npoints, rs);
+    ap::vmove(&ct(0, 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
+    cbusy(0) = true;
+    for(i = 1; i <= k-1; i++)
+    {
+        cbusy(i) = false;
+    }
+    if( !selectcenterpp(xy, npoints, nvars, ct, cbusy, k, d2, rs) )
+    {
+        result = false;
+        return result;
+    }
+    
+    //
+    // Update centers:
+    // 1. assign points to centers (all distances are computed on the
+    //    full pass, which sets bounds from scratch)
+    // 2. update center positions and bounds
+    //
+    fullpass = true;
+    while(true)
+    {
         
         //
-        // Update centers:
-        // 2. update center positions
+        // Half distances to the closest other center
         //
-        while(true)
+        if( !fullpass )
         {
-            
-            //
-            // fill XYC with center numbers
-            //
-            waschanges = false;
-            for(i = 0; i <= npoints-1; i++)
+            for(i = 0; i <= k-1; i++)
             {
-                cclosest = -1;
-                dclosest = ap::maxrealnumber;
-                for(j = 0; j <= k-1; j++)
-                {
-                    ap::vmove(&tmp(0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
-                    ap::vsub(&tmp(0), 1, &ct(j, 0), 1, ap::vlen(0,nvars-1));
-                    v = ap::vdotproduct(&tmp(0), 1, &tmp(0), 1, ap::vlen(0,nvars-1));
-                    if( ap::fp_less(v,dclosest) )
-                    {
-                        cclosest = j;
-                        dclosest = v;
-                    }
-                }
-                if( xyc(i)!=cclosest )
-                {
-                    waschanges = true;
-                }
-                xyc(i) = cclosest;
+                cs(i) = ap::maxrealnumber;
             }
-            
-            //
-            // Update centers
-            //
-            for(j = 0; j <= k-1; j++)
+            for(i = 0; i <= k-1; i++)
             {
-                csizes(j) = 0;
+                for(j = i+1; j <= k-1; j++)
+                {
+                    v = 0.5*sqrt(kmeansdist2(&ct(i, 0), &ct(j, 0), nvars));
+                    cs(i) = ap::minreal(cs(i), v);
+                    cs(j) = ap::minreal(cs(j), v);
+                }
             }
+        }
+        
+        //
+        // fill XYC with center numbers
+        //
+        #pragma omp parallel for schedule(static) if( parallel )
+        for(i = 0; i <= npoints-1; i++)
+        {
+            kmeansassignpoint(xy, i, nvars, k, ct, cs, fullpass, xyc, ub, lb);
+        }
+        
+        //
+        // Update sums of the clusters
+        //
+        if( fullpass )
+        {
             for(i = 0; i <= k-1; i++)
             {
+                csizes(i) = 0;
                 for(j = 0; j <= nvars-1; j++)
                 {
-                    ct(i,j) = 0;
+                    csums(i,j) = 0;
                 }
             }
             for(i = 0; i <= npoints-1; i++)
             {
-                csizes(xyc(i)) = csizes(xyc(i))+1;
-                ap::vadd(&ct(xyc(i), 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
+                c = xyc(i);
+                csizes(c) = csizes(c)+1;
+                ap::vadd(&csums(c, 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
+                xycprev(i) = c;
             }
-            zerosizeclusters = false;
-            for(i = 0; i <= k-1; i++)
-            {
-                cbusy(i) = csizes(i)!=0;
-                zerosizeclusters = zerosizeclusters||csizes(i)==0;
-            }
-            if( zerosizeclusters )
+            waschanges = true;
+        }
+        else
+        {
+            waschanges = false;
+            for(i = 0; i <= npoints-1; i++)
             {
-                
-                //
-                // Some clusters have zero size - rare, but possible.
-                // We'll choose new centers for such clusters using k-means++ rule
-                // and restart algorithm
-                //
-                if( !selectcenterpp(xy, npoints, nvars, ct, cbusy, k, d2, p, tmp) )
+                c = xyc(i);
+                if( c!=xycprev(i) )
                 {
-                    info = -3;
-                    return;
+                    csizes(xycprev(i)) = csizes(xycprev(i))-1;
+                    ap::vsub(&csums(xycprev(i), 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
+                    csizes(c) = csizes(c)+1;
+                    ap::vadd(&csums(c, 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
+                    xycprev(i) = c;
+                    waschanges = true;
                 }
-                continue;
-            }
-            for(j = 0; j <= k-1; j++)
-            {
-                v = double(1)/double(csizes(j));
-                ap::vmul(&ct(j, 0), 1, ap::vlen(0,nvars-1), v);
             }
+        }
+        zerosizeclusters = false;
+        for(i = 0; i <= k-1; i++)
+        {
+            cbusy(i) = csizes(i)!=0;
+            zerosizeclusters = zerosizeclusters||csizes(i)==0;
+        }
+        if( zerosizeclusters )
+        {
             
             //
-            // if nothing has changed during iteration
+            // Some clusters have zero size - rare, but possible.
+            // We'll choose new centers for such clusters using k-means++ rule
+            // and restart algorithm (bounds are no longer valid)
             //
-            if( !waschanges )
+            for(i = 0; i <= k-1; i++)
+            {
+                if( cbusy(i) )
+                {
+                    v = double(1)/double(csizes(i));
+                    ap::vmove(&ct(i, 0), 1, &csums(i, 0), 1, ap::vlen(0,nvars-1), v);
+                }
+            }
+            if( !selectcenterpp(xy, npoints, nvars, ct, cbusy, k, d2, rs) )
             {
-                break;
+                result = false;
+                return result;
             }
+            fullpass = true;
+            continue;
         }
         
         //
-        // 3. Calculate E, compare with best centers found so far
+        // Update centers, remember their shifts
         //
-        e = 0;
-        for(i = 0; i <= npoints-1; i++)
+        for(i = 0; i <= k-1; i++)
         {
-            ap::vmove(&tmp(0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
-            ap::vsub(&tmp(0), 1, &ct(xyc(i), 0), 1, ap::vlen(0,nvars-1));
-            v = ap::vdotproduct(&tmp(0), 1, &tmp(0), 1, ap::vlen(0,nvars-1));
-            e = e+v;
+            v = double(1)/double(csizes(i));
+            ap::vmove(&tmp(0), 1, &csums(i, 0), 1, ap::vlen(0,nvars-1), v);
+            cmove(i) = sqrt(kmeansdist2(&tmp(0), &ct(i, 0), nvars));
+            ap::vmove(&ct(i, 0), 1, &tmp(0), 1, ap::vlen(0,nvars-1));
         }
-        if( ap::fp_less(e,ebest) )
+        
+        //
+        // if nothing has changed during iteration
+        //
+        if( !waschanges )
         {
-            
-            //
-            // store partition
-            //
-            copymatrix(ct, 0, k-1, 0, nvars-1, ctbest, 0, k-1, 0, nvars-1);
+            break;
+        }
+        
+        //
+        // Update bounds: UB grows by the shift of the own center,
+        // LB decreases by the largest shift of the other centers.
+        //
+        j1 = 0;
+        for(i = 1; i <= k-1; i++)
+        {
+            if( ap::fp_greater(cmove(i),cmove(j1)) )
+            {
+                j1 = i;
+            }
+        }
+        m1 = cmove(j1);
+        m2 = 0;
+        for(i = 0; i <= k-1; i++)
+        {
+            if( i!=j1 )
+            {
+                m2 = ap::maxreal(m2, cmove(i));
+            }
         }
+        for(i = 0; i <= npoints-1; i++)
+        {
+            c = xyc(i);
+            ub(i) = ub(i)+cmove(c);
+            if( c==j1 )
+            {
+                lb(i) = lb(i)-m2;
+            }
+            else
+            {
+                lb(i) = lb(i)-m1;
+            }
+        }
+        fullpass = false;
     }
     
     //
-    // Copy and transpose
+    // Calculate E
     //
-    c.setbounds(0, nvars-1, 0, k-1);
-    copyandtranspose(ctbest, 0, k-1, 0, nvars-1, c, 0, nvars-1, 0, k-1);
+    e = 0;
+    for(i = 0; i <= npoints-1; i++)
+    {
+        e = e+kmeansdist2(&xy(i, 0), &ct(xyc(i), 0), nvars);
+    }
+    result = true;
+    return result;
+}
+
+
+/*************************************************************************
+Assignment of I-th point, see KMeansRun() for the description of bounds.
+*************************************************************************/
+static void kmeansassignpoint(const ap::real_2d_array& xy,
+     int i,
+     int nvars,
+     int k,
+     const ap::real_2d_array& ct,
+     const ap::real_1d_array& cs,
+     bool fullpass,
+     ap::integer_1d_array& xyc,
+     ap::real_1d_array& ub,
+     ap::real_1d_array& lb)
+{
+    double m;
+    double d1;
+    double d2;
+    int c;
+
+    if( !fullpass )
+    {
+        c = xyc(i);
+        m = ap::maxreal(cs(c), lb(i));
+        if( ub(i)<m )
+        {
+            return;
+        }
+        ub(i) = sqrt(kmeansdist2(&xy(i, 0), &ct(c, 0), nvars));
+        if( ub(i)<m )
+        {
+            return;
+        }
+    }
+    xyc(i) = kmeansnearest(&xy(i, 0), ct, nvars, k, d1, d2);
+    ub(i) = sqrt(d1);
+    lb(i) = sqrt(d2);
+}
+
+
+/*************************************************************************
+Closest center (the first one among equally distant) for point X.
+D1 and D2 are squared distances to the closest and the second closest
+centers (MaxRealNumber when K=1).
+*************************************************************************/
+static int kmeansnearest(const double* x,
+     const ap::real_2d_array& ct,
+     int nvars,
+     int k,
+     double& d1,
+     double& d2)
+{
+    int result;
+    int j;
+    double v;
+
+    result = -1;
+    d1 = ap::maxrealnumber;
+    d2 = ap::maxrealnumber;
+    for(j = 0; j <= k-1; j++)
+    {
+        v = kmeansdist2(x, &ct(j, 0), nvars);
+        if( v<d1 )
+        {
+            d2 = d1;
+            d1 = v;
+            result = j;
+        }
+        else
+        {
+            if( v<d2 )
+            {
+                d2 = v;
+            }
+        }
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Squared distance between X and Y
+*************************************************************************/
+static double kmeansdist2(const double* x, const double* y, int n)
+{
+    double s0;
+    double s1;
+    double s2;
+    double s3;
+    int i;
+
+    s0 = 0;
+    s1 = 0;
+    s2 = 0;
+    s3 = 0;
+    for(i = 0; i+3 <= n-1; i += 4)
+    {
+        s0 = s0+(x[i+0]-y[i+0])*(x[i+0]-y[i+0]);
+        s1 = s1+(x[i+1]-y[i+1])*(x[i+1]-y[i+1]);
+        s2 = s2+(x[i+2]-y[i+2])*(x[i+2]-y[i+2]);
+        s3 = s3+(x[i+3]-y[i+3])*(x[i+3]-y[i+3]);
+    }
+    for(; i <= n-1; i++)
+    {
+        s0 = s0+(x[i]-y[i])*(x[i]-y[i]);
+    }
+    return (s0+s1)+(s2+s3);
+}
+
+
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool kmeansparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,kmeansparallelwork);
+#endif
+    return result;
 }
 
 
 /*************************************************************************
 Select center for a new cluster using k-means++ rule
+
+D2 (squared distance to the closest busy center) is computed once and then
+updated with each new center, so selection of K centers costs O(NPoints*K)
+distance evaluations.
 *************************************************************************/
 static bool selectcenterpp(const ap::real_2d_array& xy,
      int npoints,
      int nvars,
      ap::real_2d_array& centers,
-     ap::boolean_1d_array busycenters,
+     ap::boolean_1d_array& busycenters,
      int ccnt,
      ap::real_1d_array& d2,
-     ap::real_1d_array& p,
-     ap::real_1d_array& tmp)
+     hqrndstate& rs)
 {
     bool result;
+    bool d2valid;
+    bool parallel;
     int i;
     int j;
     int cc;
@@ -274,6 +754,8 @@ static bool selectcenterpp(const ap::real_2d_array& xy,
     double s;
 
     result = true;
+    d2valid = false;
+    parallel = kmeansparallel(double(npoints)*double(ccnt)*double(nvars));
     for(cc = 0; cc <= ccnt-1; cc++)
     {
         if( !busycenters(cc) )
@@ -282,26 +764,31 @@ static bool selectcenterpp(const ap::real_2d_array& xy,
             //
             // fill D2
             //
-            for(i = 0; i <= npoints-1; i++)
+            if( !d2valid )
             {
-                d2(i) = ap::maxrealnumber;
-                for(j = 0; j <= ccnt-1; j++)
+                #pragma omp parallel for schedule(static) private(j, v) if( parallel )
+                for(i = 0; i <= npoints-1; i++)
                 {
-                    if( busycenters(j) )
+                    d2(i) = ap::maxrealnumber;
+                    for(j = 0; j <= ccnt-1; j++)
                     {
-                        ap::vmove(&tmp(0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
-                        ap::vsub(&tmp(0), 1, &centers(j, 0), 1, ap::vlen(0,nvars-1));
-                        v = ap::vdotproduct(&tmp(0), 1, &tmp(0), 1, ap::vlen(0,nvars-1));
-                        if( ap::fp_less(v,d2(i)) )
+                        if( busycenters(j) )
                         {
-                            d2(i) = v;
+                            v = kmeansdist2(&xy(i, 0), &centers(j, 0), nvars);
+                            if( v<d2(i) )
+                            {
+                                d2(i) = v;
+                            }
                         }
                     }
                 }
+                d2valid = true;
             }
             
             //
-            // calculate P (non-cumulative)
+            // choose one of points with probability proportional to D2:
+            // random number within (0,S) is generated and
+            // inverse empirical CDF is used to randomly choose a point.
             //
             s = 0;
             for(i = 0; i <= npoints-1; i++)
@@ -313,19 +800,11 @@ static bool selectcenterpp(const ap::real_2d_array& xy,
                 result = false;
                 return result;
             }
-            s = 1/s;
-            ap::vmove(&p(0), 1, &d2(0), 1, ap::vlen(0,npoints-1), s);
-            
-            //
-            // choose one of points with probability P
-            // random number within (0,1) is generated and
-            // inverse empirical CDF is used to randomly choose a point.
-            //
+            v = s*hqrnduniformr(rs);
             s = 0;
-            v = ap::randomreal();
             for(i = 0; i <= npoints-1; i++)
             {
-                s = s+p(i);
+                s = s+d2(i);
                 if( ap::fp_less_eq(v,s)||i==npoints-1 )
                 {
                     ap::vmove(&centers(cc, 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
@@ -333,6 +812,19 @@ static bool selectcenterpp(const ap::real_2d_array& xy,
                     break;
                 }
             }
+            
+            //
+            // update D2 with the new center
+            //
+            #pragma omp parallel for schedule(static) private(v) if( parallel )
+            for(i = 0; i <= npoints-1; i++)
+            {
+                v = kmeansdist2(&xy(i, 0), &centers(cc, 0), nvars);
+                if( v<d2(i) )
+                {
+                    d2(i) = v;
+                }
+            }
         }
     }
     return result;
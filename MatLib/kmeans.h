@@ -25,6 +25,33 @@ http://www.fsf.org/licensing/licenses
 #include "ialglib.h"
 
 #include "blas.h"
+#include "hqrnd.h"
+
+
+/*************************************************************************
+State of the mini-batch k-means algorithm.
+
+Fields:
+    NVars, K    -   problem size
+    Initialized -   whether centers were selected (with the first batch)
+    CT          -   centers, array[0..K-1,0..NVars-1] (stored in rows)
+    CCnt        -   number of points assigned to each center so far
+    RS          -   random stream used by k-means++ initialization
+
+Other fields are temporaries.
+*************************************************************************/
+struct kmeansminibatchstate
+{
+    int nvars;
+    int k;
+    bool initialized;
+    ap::real_2d_array ct;
+    ap::real_1d_array ccnt;
+    ap::boolean_1d_array cbusy;
+    ap::real_1d_array d2;
+    ap::integer_1d_array xyc;
+    hqrndstate rs;
+};
 
 
 /*************************************************************************
@@ -48,6 +75,19 @@ OUTPUT PARAMETERS:
     XYC         -   array which contains number of clusters dataset points
                     belong to.
 
+NOTES:
+    Lloyd iterations use Hamerly's bounds (one upper bound and one lower
+    bound per point), so points which are known to stay in their cluster
+    are not compared against all K centers. Result is the same as the one
+    of the plain Lloyd algorithm.
+
+    When OpenMP is enabled, restarts are run in parallel (if there are at
+    least as many restarts as threads) or the assignment step is split
+    between threads. Each restart uses its own random stream seeded from
+    the standard RNG, and the partition with the lowest energy is returned
+    (the first one among equal ones), so result does not depend on the
+    number of threads.
+
   -- ALGLIB --
      Copyright 21.03.2009 by Bochkanov Sergey
 *************************************************************************/
@@ -61,5 +101,62 @@ void kmeansgenerate(const ap::real_2d_array& xy,
      ap::integer_1d_array& xyc);
 
 
+/*************************************************************************
+Mini-batch k-means: initialization of the state.
+
+Centers are fitted with the mini-batch algorithm of Sculley (2010): each
+batch is assigned to the current centers, then every center is moved
+towards its points with learning rate 1/(number of points assigned to
+this center so far). Dataset is never stored, so it may be much larger
+than the available memory: it is passed by parts to KMeansMiniBatchUpdate().
+Centers of the first batch are selected with k-means++ rule.
+
+INPUT PARAMETERS:
+    NVars       -   number of variables, NVars>=1
+    K           -   desired number of clusters, K>=1
+
+OUTPUT PARAMETERS:
+    State       -   structure which stores algorithm state
+*************************************************************************/
+void kmeansminibatchcreate(int nvars, int k, kmeansminibatchstate& state);
+
+
+/*************************************************************************
+Mini-batch k-means: next batch of the dataset.
+
+INPUT PARAMETERS:
+    State       -   structure created by KMeansMiniBatchCreate()
+    XY          -   batch, array [0..NPoints-1,0..NVars-1]. Batches should
+                    be drawn at random from the dataset (or the dataset
+                    should be shuffled before it is split into batches).
+    NPoints     -   batch size, NPoints>=1 (NPoints>=K for the first one)
+
+OUTPUT PARAMETERS:
+    Info        -   return code:
+                    * -3, if first batch is degenerate (number of distinct
+                          points is less than K), state is not changed
+                    * -1, if incorrect NPoints was passed
+                    *  1, if subroutine finished successfully
+*************************************************************************/
+void kmeansminibatchupdate(kmeansminibatchstate& state,
+     const ap::real_2d_array& xy,
+     int npoints,
+     int& info);
+
+
+/*************************************************************************
+Mini-batch k-means: current centers.
+
+INPUT PARAMETERS:
+    State       -   structure used by KMeansMiniBatchUpdate()
+
+OUTPUT PARAMETERS:
+    C           -   array[0..NVars-1,0..K-1].matrix whose columns store
+                    cluster's centers (zero if no batch was processed yet)
+*************************************************************************/
+void kmeansminibatchresults(const kmeansminibatchstate& state,
+     ap::real_2d_array& c);
+
+
 #endif
 
@@ -22,6 +22,51 @@ static void fitlinearnonlinear(int m,
      const ap::real_2d_array& xy,
      lsfitstate& state,
      bool& nlserrors);
+static void generatetask(ap::real_2d_array& x,
+     ap::real_1d_array& y,
+     ap::real_1d_array& w,
+     int n,
+     ap::real_1d_array& ctrue);
+static void modelfgh(const ap::real_1d_array& c,
+     const ap::real_1d_array& x,
+     double& f,
+     ap::real_1d_array& g,
+     ap::real_2d_array& h);
+static void fitrcomm(const ap::real_2d_array& x,
+     const ap::real_1d_array& y,
+     const ap::real_1d_array& w,
+     int n,
+     int scheme,
+     int batchsize,
+     bool& protocolerrors,
+     int& info,
+     ap::real_1d_array& c,
+     lsfitreport& rep);
+static void fitparallel(const ap::real_2d_array& x,
+     const ap::real_1d_array& y,
+     const ap::real_1d_array& w,
+     int n,
+     int scheme,
+     int batchsize,
+     bool usefunc,
+     int& info,
+     ap::real_1d_array& c,
+     lsfitreport& rep);
+static void callbackf(const ap::real_1d_array& c,
+     const ap::real_1d_array& x,
+     double& f,
+     void* ptr);
+static void callbackfg(const ap::real_1d_array& c,
+     const ap::real_1d_array& x,
+     double& f,
+     ap::real_1d_array& g,
+     void* ptr);
+static bool samefit(int info1,
+     const ap::real_1d_array& c1,
+     const lsfitreport& rep1,
+     int info2,
+     const ap::real_1d_array& c2,
+     const lsfitreport& rep2);
 
 bool testlls(bool silent)
 {
@@ -29,6 +74,8 @@ bool testlls(bool silent)
     bool waserrors;
     bool llserrors;
     bool nlserrors;
+    bool batcherrors;
+    bool parerrors;
     double threshold;
     double nlthreshold;
     int maxn;
@@ -40,6 +87,8 @@ bool testlls(bool silent)
     int j;
     int k;
     int pass;
+    int scheme;
+    int batchsize;
     double xscale;
     ap::real_1d_array x;
     ap::real_1d_array y;
@@ -47,6 +96,7 @@ bool testlls(bool silent)
     ap::real_1d_array w2;
     ap::real_1d_array c;
     ap::real_1d_array c2;
+    ap::real_1d_array ctrue;
     ap::real_2d_array a;
     ap::real_2d_array a2;
     ap::real_2d_array cm;
@@ -66,6 +116,8 @@ bool testlls(bool silent)
     waserrors = false;
     llserrors = false;
     nlserrors = false;
+    batcherrors = false;
+    parerrors = false;
     threshold = 10000*ap::machineepsilon;
     nlthreshold = 0.00001;
     maxn = 6;
@@ -539,10 +591,74 @@ bool testlls(bool silent)
         }
     }
     
+    //
+    // Nonlinear fitting of the model with three parameters: solution is
+    // recovered; batch mode and parallel driver give same results as
+    // point-by-point reverse communication
+    //
+    for(pass = 1; pass <= 10; pass++)
+    {
+        n = 2+ap::randominteger(300);
+        generatetask(a, y, w, n, ctrue);
+        for(scheme = 0; scheme <= 2; scheme++)
+        {
+            
+            //
+            // Point-by-point fit: solution is recovered
+            //
+            fitrcomm(a, y, w, n, scheme, 0, batcherrors, info, c, rep);
+            nlserrors = nlserrors||info<=0;
+            if( info>0 )
+            {
+                nlserrors = nlserrors||ap::fp_greater(fabs(c(0)-ctrue(0)),1.0E-4);
+                nlserrors = nlserrors||ap::fp_greater(fabs(c(1)-ctrue(1)),1.0E-4);
+                nlserrors = nlserrors||ap::fp_greater(fabs(c(2)-ctrue(2)),1.0E-4);
+                nlserrors = nlserrors||ap::fp_greater(rep.maxerror,1.0E-5);
+            }
+            
+            //
+            // Batch mode: same result bit for bit, batch size may be
+            // 1, less than N, equal to N or larger than N. Hessian-based
+            // scheme ignores batch mode.
+            //
+            for(batchsize = 1; batchsize <= 4; batchsize++)
+            {
+                if( batchsize==1 )
+                {
+                    fitrcomm(a, y, w, n, scheme, 1, batcherrors, info2, c2, rep2);
+                }
+                if( batchsize==2 )
+                {
+                    fitrcomm(a, y, w, n, scheme, 1+ap::randominteger(n), batcherrors, info2, c2, rep2);
+                }
+                if( batchsize==3 )
+                {
+                    fitrcomm(a, y, w, n, scheme, n, batcherrors, info2, c2, rep2);
+                }
+                if( batchsize==4 )
+                {
+                    fitrcomm(a, y, w, n, scheme, n+1+ap::randominteger(10), batcherrors, info2, c2, rep2);
+                }
+                batcherrors = batcherrors||!samefit(info, c, rep, info2, c2, rep2);
+            }
+            
+            //
+            // Parallel driver: same result as reverse communication
+            //
+            if( scheme!=2 )
+            {
+                fitparallel(a, y, w, n, scheme, 0, true, info2, c2, rep2);
+                parerrors = parerrors||!samefit(info, c, rep, info2, c2, rep2);
+                fitparallel(a, y, w, n, scheme, 1+ap::randominteger(n), false, info2, c2, rep2);
+                parerrors = parerrors||!samefit(info, c, rep, info2, c2, rep2);
+            }
+        }
+    }
+    
     //
     // report
     //
-    waserrors = llserrors||nlserrors;
+    waserrors = llserrors||nlserrors||batcherrors||parerrors;
     if( !silent )
     {
         printf("TESTING LEAST SQUARES\n");
@@ -564,6 +680,24 @@ bool testlls(bool silent)
         {
             printf("OK\n");
         }
+        printf("* BATCH MODE:                            ");
+        if( batcherrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("* PARALLEL DRIVER:                       ");
+        if( parerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
         if( waserrors )
         {
             printf("TEST FAILED\n");
@@ -810,6 +944,246 @@ static void fitlinearnonlinear(int m,
 }
 
 
+/*************************************************************************
+Task: N points (X0,X1) from [0,1]x[-1,+1], exact values of the model at
+random CTrue, random weights.
+*************************************************************************/
+static void generatetask(ap::real_2d_array& x,
+     ap::real_1d_array& y,
+     ap::real_1d_array& w,
+     int n,
+     ap::real_1d_array& ctrue)
+{
+    int i;
+    ap::real_1d_array xi;
+    ap::real_1d_array g;
+    ap::real_2d_array h;
+
+    x.setlength(n, 2);
+    y.setlength(n);
+    w.setlength(n);
+    ctrue.setlength(3);
+    xi.setlength(2);
+    g.setlength(3);
+    h.setlength(3, 3);
+    ctrue(0) = 1+ap::randomreal();
+    ctrue(1) = 0.5+ap::randomreal();
+    ctrue(2) = 2*ap::randomreal()-1;
+    for(i = 0; i <= n-1; i++)
+    {
+        x(i,0) = ap::randomreal();
+        x(i,1) = 2*ap::randomreal()-1;
+        w(i) = 0.5+ap::randomreal();
+        xi(0) = x(i,0);
+        xi(1) = x(i,1);
+        modelfgh(ctrue, xi, y(i), g, h);
+    }
+}
+
+
+/*************************************************************************
+Model F(X,C) = C0*exp(-C1*X0)+C2*X1, its gradient and Hessian
+*************************************************************************/
+static void modelfgh(const ap::real_1d_array& c,
+     const ap::real_1d_array& x,
+     double& f,
+     ap::real_1d_array& g,
+     ap::real_2d_array& h)
+{
+    double e;
+
+    e = exp(-c(1)*x(0));
+    f = c(0)*e+c(2)*x(1);
+    g(0) = e;
+    g(1) = -c(0)*x(0)*e;
+    g(2) = x(1);
+    h(0,0) = 0;
+    h(0,1) = -x(0)*e;
+    h(0,2) = 0;
+    h(1,0) = -x(0)*e;
+    h(1,1) = c(0)*ap::sqr(x(0))*e;
+    h(1,2) = 0;
+    h(2,0) = 0;
+    h(2,1) = 0;
+    h(2,2) = 0;
+}
+
+
+/*************************************************************************
+Fitting with reverse communication.
+
+Scheme: 0 - FG with CheapFG=True, 1 - FG with CheapFG=False, 2 - FGH.
+BatchSize=0 - point-by-point mode.
+
+ProtocolErrors is set when request does not match the mode.
+*************************************************************************/
+static void fitrcomm(const ap::real_2d_array& x,
+     const ap::real_1d_array& y,
+     const ap::real_1d_array& w,
+     int n,
+     int scheme,
+     int batchsize,
+     bool& protocolerrors,
+     int& info,
+     ap::real_1d_array& c,
+     lsfitreport& rep)
+{
+    lsfitstate state;
+    ap::real_1d_array c0;
+    ap::real_1d_array xi;
+    ap::real_2d_array h;
+    int t;
+    bool batch;
+
+    c0.setlength(3);
+    c0(0) = 1;
+    c0(1) = 1;
+    c0(2) = 0;
+    xi.setlength(2);
+    h.setlength(3, 3);
+    if( scheme==2 )
+    {
+        lsfitnonlinearwfgh(x, y, w, c0, n, 2, 3, state);
+    }
+    else
+    {
+        lsfitnonlinearwfg(x, y, w, c0, n, 2, 3, scheme==0, state);
+    }
+    lsfitnonlinearsetcond(state, 0.0, 1.0E-10, 0);
+    lsfitnonlinearsetbatch(state, batchsize);
+    batch = batchsize>0&&scheme!=2;
+    while(lsfitnonlineariteration(state))
+    {
+        if( state.needf||state.needfg||state.needfgh )
+        {
+            protocolerrors = protocolerrors||batch;
+            modelfgh(state.c, state.x, state.f, state.g, h);
+            if( state.needfgh )
+            {
+                for(t = 0; t <= 2; t++)
+                {
+                    ap::vmove(&state.h(t, 0), 1, &h(t, 0), 1, ap::vlen(0,2));
+                }
+            }
+        }
+        if( state.needfbatch||state.needfgbatch )
+        {
+            protocolerrors = protocolerrors||!batch;
+            protocolerrors = protocolerrors||state.pointcount<1||state.pointcount>batchsize;
+            protocolerrors = protocolerrors||state.pointindex+state.pointcount>n;
+            for(t = 0; t <= state.pointcount-1; t++)
+            {
+                protocolerrors = protocolerrors||ap::fp_neq(state.xb(t,0),x(state.pointindex+t,0));
+                xi(0) = state.xb(t,0);
+                xi(1) = state.xb(t,1);
+                modelfgh(state.c, xi, state.fb(t), state.g, h);
+                if( state.needfgbatch )
+                {
+                    ap::vmove(&state.gb(t, 0), 1, &state.g(0), 1, ap::vlen(0,2));
+                }
+            }
+        }
+    }
+    lsfitnonlinearresults(state, info, c, rep);
+}
+
+
+/*************************************************************************
+Fitting with LSFitNonlinearFitParallel()
+*************************************************************************/
+static void fitparallel(const ap::real_2d_array& x,
+     const ap::real_1d_array& y,
+     const ap::real_1d_array& w,
+     int n,
+     int scheme,
+     int batchsize,
+     bool usefunc,
+     int& info,
+     ap::real_1d_array& c,
+     lsfitreport& rep)
+{
+    lsfitstate state;
+    ap::real_1d_array c0;
+
+    c0.setlength(3);
+    c0(0) = 1;
+    c0(1) = 1;
+    c0(2) = 0;
+    lsfitnonlinearwfg(x, y, w, c0, n, 2, 3, scheme==0, state);
+    lsfitnonlinearsetcond(state, 0.0, 1.0E-10, 0);
+    if( batchsize>0 )
+    {
+        lsfitnonlinearsetbatch(state, batchsize);
+    }
+    if( usefunc )
+    {
+        lsfitnonlinearfitparallel(state, callbackf, callbackfg, NULL);
+    }
+    else
+    {
+        lsfitnonlinearfitparallel(state, NULL, callbackfg, NULL);
+    }
+    lsfitnonlinearresults(state, info, c, rep);
+}
+
+
+/*************************************************************************
+Callbacks for LSFitNonlinearFitParallel()
+*************************************************************************/
+static void callbackf(const ap::real_1d_array& c,
+     const ap::real_1d_array& x,
+     double& f,
+     void* ptr)
+{
+    f = c(0)*exp(-c(1)*x(0))+c(2)*x(1);
+}
+
+
+static void callbackfg(const ap::real_1d_array& c,
+     const ap::real_1d_array& x,
+     double& f,
+     ap::real_1d_array& g,
+     void* ptr)
+{
+    double e;
+
+    e = exp(-c(1)*x(0));
+    f = c(0)*e+c(2)*x(1);
+    g(0) = e;
+    g(1) = -c(0)*x(0)*e;
+    g(2) = x(1);
+}
+
+
+/*************************************************************************
+True if two fits are identical
+*************************************************************************/
+static bool samefit(int info1,
+     const ap::real_1d_array& c1,
+     const lsfitreport& rep1,
+     int info2,
+     const ap::real_1d_array& c2,
+     const lsfitreport& rep2)
+{
+    bool result;
+    int i;
+
+    result = info1==info2;
+    if( result&&info1>0 )
+    {
+        for(i = 0; i <= 2; i++)
+        {
+            result = result&&ap::fp_eq(c1(i),c2(i));
+        }
+        result = result&&ap::fp_eq(rep1.rmserror,rep2.rmserror);
+        result = result&&ap::fp_eq(rep1.avgerror,rep2.avgerror);
+        result = result&&ap::fp_eq(rep1.avgrelerror,rep2.avgrelerror);
+        result = result&&ap::fp_eq(rep1.maxerror,rep2.maxerror);
+    }
+    return result;
+}
+
+
 /*************************************************************************
 Silent unit test
 *************************************************************************/
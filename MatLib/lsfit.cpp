@@ -20,6 +20,18 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "lsfit.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//
+// Batch size used by LSFitNonlinearFitParallel() when it was not set by
+// user, minimal number of points which is worth starting threads and
+// number of points per one task of the thread pool.
+//
+static const int lsfitdefaultbatch = 16384;
+static const double lsfitparallelwork = 256.0;
+static const int lsfitparallelchunk = 64;
 
 static void lsfitlinearinternal(const ap::real_1d_array& y,
      const ap::real_1d_array& w,
@@ -30,6 +42,14 @@ static void lsfitlinearinternal(const ap::real_1d_array& y,
      ap::real_1d_array& c,
      lsfitreport& rep);
 static void lsfitclearrequestfields(lsfitstate& state);
+static int lsfitrequestpoints(lsfitstate& state, int i, bool needgrad);
+static double lsfitpointvalue(const lsfitstate& state, int t);
+static const double* lsfitpointgrad(const lsfitstate& state, int t);
+static void lsfitevaluatebatch(lsfitstate& state,
+     void (*func)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, void* ptr),
+     void (*grad)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, ap::real_1d_array& g, void* ptr),
+     void* ptr);
+static bool lsfitparallel(double work);
 
 /*************************************************************************
 Weighted linear least squares fitting.
@@ -405,7 +425,8 @@ void lsfitnonlinearwfg(const ap::real_2d_array& x,
             state.tasky(i) = y(i);
         }
     }
-    state.rstate.ia.setbounds(0, 4);
+    state.batchsize = 0;
+    state.rstate.ia.setbounds(0, 5);
     state.rstate.ra.setbounds(0, 1);
     state.rstate.stage = -1;
 }
@@ -450,7 +471,8 @@ void lsfitnonlinearfg(const ap::real_2d_array& x,
             state.w(i) = 1;
         }
     }
-    state.rstate.ia.setbounds(0, 4);
+    state.batchsize = 0;
+    state.rstate.ia.setbounds(0, 5);
     state.rstate.ra.setbounds(0, 1);
     state.rstate.stage = -1;
 }
@@ -510,7 +532,8 @@ void lsfitnonlinearwfgh(const ap::real_2d_array& x,
             state.tasky(i) = y(i);
         }
     }
-    state.rstate.ia.setbounds(0, 4);
+    state.batchsize = 0;
+    state.rstate.ia.setbounds(0, 5);
     state.rstate.ra.setbounds(0, 1);
     state.rstate.stage = -1;
 }
@@ -555,7 +578,8 @@ void lsfitnonlinearfgh(const ap::real_2d_array& x,
             state.w(i) = 1;
         }
     }
-    state.rstate.ia.setbounds(0, 4);
+    state.batchsize = 0;
+    state.rstate.ia.setbounds(0, 5);
     state.rstate.ra.setbounds(0, 1);
     state.rstate.stage = -1;
 }
@@ -630,6 +654,44 @@ void lsfitnonlinearsetstpmax(lsfitstate& state, double stpmax)
 }
 
 
+/*************************************************************************
+This function turns on batch mode of the nonlinear fitting.
+
+In batch mode LSFitNonlinearIteration() requests function values (and
+gradients) in up to BatchSize points at once instead  of  one  point  per
+call, so the user may vectorize  the  model  or  evaluate  the  block  in
+parallel:
+
+* State.NeedFBatch=True     values F(X[i],C) are required
+* State.NeedFGBatch=True    values F(X[i],C) and gradients dF/dC(X[i],C)
+                            are required
+
+Points are stored in State.XB[0..PointCount-1,0..M-1] (they are  rows
+PointIndex..PointIndex+PointCount-1 of the dataset), C is  stored  in
+State.C[0..K-1]. Results are stored:
+* function values           -   in State.FB[0..PointCount-1]
+* gradients                 -   in State.GB[0..PointCount-1,0..K-1]
+
+Results are accumulated in the same order as in the point-by-point  mode,
+so both modes give the same solution bit for bit.
+
+INPUT PARAMETERS:
+    State       -   structure initialized with  LSFitNonlinearWFG()  or
+                    LSFitNonlinearFG(). Hessian-based  schemes  ignore
+                    batch mode and always request points one by one.
+    BatchSize   -   maximum number of points per request, >=0. Zero turns
+                    batch mode off (default).
+
+Must be called before the first call of LSFitNonlinearIteration().
+*************************************************************************/
+void lsfitnonlinearsetbatch(lsfitstate& state, int batchsize)
+{
+
+    ap::ap_error::make_assertion(batchsize>=0, "LSFitNonlinearSetBatch: BatchSize<0");
+    state.batchsize = batchsize;
+}
+
+
 /*************************************************************************
 Nonlinear least squares fitting. Algorithm iteration.
 
@@ -650,7 +712,9 @@ RESULT
 * if State.NeedFGH=True     function value F(X,C), gradient dF/dC(X,C) and
                             Hessian are required
 
-One and only one of this fields can be set at time.
+One and only one of this fields can be set at time. In batch mode  NeedF
+and NeedFG are replaced by NeedFBatch and NeedFGBatch, see
+LSFitNonlinearSetBatch() for more information.
 
 Function, its gradient and Hessian are calculated at  (X,C),  where  X  is
 stored in State.X[0..M-1] and C is stored in State.C[0..K-1].
@@ -671,6 +735,7 @@ bool lsfitnonlineariteration(lsfitstate& state)
     int k;
     int i;
     int j;
+    int cnt;
     double v;
     double relcnt;
 
@@ -692,6 +757,7 @@ bool lsfitnonlineariteration(lsfitstate& state)
         k = state.rstate.ia(2);
         i = state.rstate.ia(3);
         j = state.rstate.ia(4);
+        cnt = state.rstate.ia(5);
         v = state.rstate.ra(0);
         relcnt = state.rstate.ra(1);
     }
@@ -702,6 +768,7 @@ bool lsfitnonlineariteration(lsfitstate& state)
         k = -834;
         i = 900;
         j = -287;
+        cnt = 629;
         v = 364;
         relcnt = 214;
     }
@@ -752,6 +819,12 @@ bool lsfitnonlineariteration(lsfitstate& state)
     {
         state.h.setlength(k, k);
     }
+    if( state.batchsize>0&&!state.havehess )
+    {
+        state.xb.setlength(ap::minint(state.batchsize, n), m);
+        state.fb.setlength(ap::minint(state.batchsize, n));
+        state.gb.setlength(ap::minint(state.batchsize, n), k);
+    }
     
     //
     // initialize LM optimizer
@@ -808,15 +881,15 @@ lbl_9:
         goto lbl_11;
     }
     ap::vmove(&state.c(0), 1, &state.optstate.x(0), 1, ap::vlen(0,k-1));
-    ap::vmove(&state.x(0), 1, &state.taskx(i, 0), 1, ap::vlen(0,m-1));
-    state.pointindex = i;
-    lsfitclearrequestfields(state);
-    state.needf = true;
+    cnt = lsfitrequestpoints(state, i, false);
     state.rstate.stage = 0;
     goto lbl_rcomm;
 lbl_0:
-    state.optstate.f = state.optstate.f+ap::sqr(state.w(i)*(state.f-state.tasky(i)));
-    i = i+1;
+    for(j = 0; j <= cnt-1; j++)
+    {
+        state.optstate.f = state.optstate.f+ap::sqr(state.w(i+j)*(lsfitpointvalue(state, j)-state.tasky(i+j)));
+    }
+    i = i+cnt;
     goto lbl_9;
 lbl_11:
     goto lbl_5;
@@ -841,17 +914,17 @@ lbl_14:
         goto lbl_16;
     }
     ap::vmove(&state.c(0), 1, &state.optstate.x(0), 1, ap::vlen(0,k-1));
-    ap::vmove(&state.x(0), 1, &state.taskx(i, 0), 1, ap::vlen(0,m-1));
-    state.pointindex = i;
-    lsfitclearrequestfields(state);
-    state.needfg = true;
+    cnt = lsfitrequestpoints(state, i, true);
     state.rstate.stage = 1;
     goto lbl_rcomm;
 lbl_1:
-    state.optstate.f = state.optstate.f+ap::sqr(state.w(i)*(state.f-state.tasky(i)));
-    v = ap::sqr(state.w(i))*2*(state.f-state.tasky(i));
-    ap::vadd(&state.optstate.g(0), 1, &state.g(0), 1, ap::vlen(0,k-1), v);
-    i = i+1;
+    for(j = 0; j <= cnt-1; j++)
+    {
+        state.optstate.f = state.optstate.f+ap::sqr(state.w(i+j)*(lsfitpointvalue(state, j)-state.tasky(i+j)));
+        v = ap::sqr(state.w(i+j))*2*(lsfitpointvalue(state, j)-state.tasky(i+j));
+        ap::vadd(&state.optstate.g(0), 1, lsfitpointgrad(state, j), 1, ap::vlen(0,k-1), v);
+    }
+    i = i+cnt;
     goto lbl_14;
 lbl_16:
     goto lbl_5;
@@ -871,17 +944,17 @@ lbl_19:
         goto lbl_21;
     }
     ap::vmove(&state.c(0), 1, &state.optstate.x(0), 1, ap::vlen(0,k-1));
-    ap::vmove(&state.x(0), 1, &state.taskx(i, 0), 1, ap::vlen(0,m-1));
-    state.pointindex = i;
-    lsfitclearrequestfields(state);
-    state.needfg = true;
+    cnt = lsfitrequestpoints(state, i, true);
     state.rstate.stage = 2;
     goto lbl_rcomm;
 lbl_2:
-    state.optstate.fi(i) = state.w(i)*(state.f-state.tasky(i));
-    v = state.w(i);
-    ap::vmove(&state.optstate.j(i, 0), 1, &state.g(0), 1, ap::vlen(0,k-1), v);
-    i = i+1;
+    for(j = 0; j <= cnt-1; j++)
+    {
+        state.optstate.fi(i+j) = state.w(i+j)*(lsfitpointvalue(state, j)-state.tasky(i+j));
+        v = state.w(i+j);
+        ap::vmove(&state.optstate.j(i+j, 0), 1, lsfitpointgrad(state, j), 1, ap::vlen(0,k-1), v);
+    }
+    i = i+cnt;
     goto lbl_19;
 lbl_21:
     goto lbl_5;
@@ -959,23 +1032,23 @@ lbl_29:
         goto lbl_31;
     }
     ap::vmove(&state.c(0), 1, &state.c(0), 1, ap::vlen(0,k-1));
-    ap::vmove(&state.x(0), 1, &state.taskx(i, 0), 1, ap::vlen(0,m-1));
-    state.pointindex = i;
-    lsfitclearrequestfields(state);
-    state.needf = true;
+    cnt = lsfitrequestpoints(state, i, false);
     state.rstate.stage = 4;
     goto lbl_rcomm;
 lbl_4:
-    v = state.f;
-    state.reprmserror = state.reprmserror+ap::sqr(v-state.tasky(i));
-    state.repavgerror = state.repavgerror+fabs(v-state.tasky(i));
-    if( ap::fp_neq(state.tasky(i),0) )
+    for(j = 0; j <= cnt-1; j++)
     {
-        state.repavgrelerror = state.repavgrelerror+fabs(v-state.tasky(i))/fabs(state.tasky(i));
-        relcnt = relcnt+1;
+        v = lsfitpointvalue(state, j);
+        state.reprmserror = state.reprmserror+ap::sqr(v-state.tasky(i+j));
+        state.repavgerror = state.repavgerror+fabs(v-state.tasky(i+j));
+        if( ap::fp_neq(state.tasky(i+j),0) )
+        {
+            state.repavgrelerror = state.repavgrelerror+fabs(v-state.tasky(i+j))/fabs(state.tasky(i+j));
+            relcnt = relcnt+1;
+        }
+        state.repmaxerror = ap::maxreal(state.repmaxerror, fabs(v-state.tasky(i+j)));
     }
-    state.repmaxerror = ap::maxreal(state.repmaxerror, fabs(v-state.tasky(i)));
-    i = i+1;
+    i = i+cnt;
     goto lbl_29;
 lbl_31:
     state.reprmserror = sqrt(state.reprmserror/n);
@@ -998,12 +1071,57 @@ lbl_rcomm:
     state.rstate.ia(2) = k;
     state.rstate.ia(3) = i;
     state.rstate.ia(4) = j;
+    state.rstate.ia(5) = cnt;
     state.rstate.ra(0) = v;
     state.rstate.ra(1) = relcnt;
     return result;
 }
 
 
+/*************************************************************************
+Nonlinear least squares fitting with user callbacks evaluated in parallel.
+
+This subroutine runs LSFitNonlinearIteration() in batch mode and evaluates
+every block of points by calling user-supplied functions from the OpenMP
+thread pool. It is an alternative to the reverse communication loop  for
+large datasets where a single evaluation of  the  model  is  cheap,  but
+there are a lot of points.
+
+INPUT PARAMETERS:
+    State   -   structure initialized with LSFitNonlinearWFG()  or
+                LSFitNonlinearFG(). If batch size was not set  with
+                LSFitNonlinearSetBatch(), default one is used.
+    Func    -   callback which calculates F(X,C), may be NULL  -  in
+                this case Grad is called and gradient is ignored.
+    Grad    -   callback which calculates F(X,C) and dF/dC(X,C).
+    Ptr     -   user pointer passed to callbacks.
+
+Callbacks are called concurrently from several threads, so  they must  be
+reentrant. Each thread has its own X/G arrays; C  is  shared  and  must
+not be modified. Results do not depend on the number of threads.
+
+After return use LSFitNonlinearResults() to get the solution.
+*************************************************************************/
+void lsfitnonlinearfitparallel(lsfitstate& state,
+     void (*func)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, void* ptr),
+     void (*grad)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, ap::real_1d_array& g, void* ptr),
+     void* ptr)
+{
+
+    ap::ap_error::make_assertion(grad!=NULL, "LSFitNonlinearFitParallel: Grad is NULL");
+    ap::ap_error::make_assertion(!state.havehess, "LSFitNonlinearFitParallel: Hessian-based schemes are not supported");
+    if( state.batchsize==0 )
+    {
+        state.batchsize = lsfitdefaultbatch;
+    }
+    while(lsfitnonlineariteration(state))
+    {
+        ap::ap_error::make_assertion(state.needfbatch||state.needfgbatch, "LSFitNonlinearFitParallel: unexpected request");
+        lsfitevaluatebatch(state, func, grad, ptr);
+    }
+}
+
+
 /*************************************************************************
 Nonlinear least squares fitting results.
 
@@ -1403,6 +1521,156 @@ static void lsfitclearrequestfields(lsfitstate& state)
     state.needf = false;
     state.needfg = false;
     state.needfgh = false;
+    state.needfbatch = false;
+    state.needfgbatch = false;
+}
+
+
+/*************************************************************************
+Internal subroutine: requests values (NeedGrad=False) or  values  and
+gradients (NeedGrad=True) starting from I-th point, returns  number  of
+points in request. Batch mode is used when it is turned on and  Hessian
+is not needed.
+*************************************************************************/
+static int lsfitrequestpoints(lsfitstate& state, int i, bool needgrad)
+{
+    int result;
+    int t;
+
+    lsfitclearrequestfields(state);
+    state.pointindex = i;
+    if( state.batchsize>0&&!state.havehess )
+    {
+        result = ap::minint(state.batchsize, state.n-i);
+        for(t = 0; t <= result-1; t++)
+        {
+            ap::vmove(&state.xb(t, 0), 1, &state.taskx(i+t, 0), 1, ap::vlen(0,state.m-1));
+        }
+        state.needfbatch = !needgrad;
+        state.needfgbatch = needgrad;
+    }
+    else
+    {
+        result = 1;
+        ap::vmove(&state.x(0), 1, &state.taskx(i, 0), 1, ap::vlen(0,state.m-1));
+        state.needf = !needgrad;
+        state.needfg = needgrad;
+    }
+    state.pointcount = result;
+    return result;
+}
+
+
+/*************************************************************************
+Internal subroutine: function value in T-th point of the last request
+*************************************************************************/
+static double lsfitpointvalue(const lsfitstate& state, int t)
+{
+    double result;
+
+    if( state.needfbatch||state.needfgbatch )
+    {
+        result = state.fb(t);
+    }
+    else
+    {
+        result = state.f;
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Internal subroutine: gradient in T-th point of the last request
+*************************************************************************/
+static const double* lsfitpointgrad(const lsfitstate& state, int t)
+{
+    const double* result;
+
+    if( state.needfgbatch )
+    {
+        result = &state.gb(t, 0);
+    }
+    else
+    {
+        result = &state.g(0);
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Internal subroutine: evaluates batch request of LSFitNonlinearIteration()
+with user callbacks. Points are split into chunks of  LSFitParallelChunk
+which are processed by the threads of the OpenMP pool.
+*************************************************************************/
+static void lsfitevaluatebatch(lsfitstate& state,
+     void (*func)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, void* ptr),
+     void (*grad)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, ap::real_1d_array& g, void* ptr),
+     void* ptr)
+{
+    int cnt;
+    int nchunks;
+    int m;
+    int k;
+    bool needgrad;
+
+    cnt = state.pointcount;
+    m = state.m;
+    k = state.k;
+    needgrad = state.needfgbatch;
+    nchunks = (cnt+lsfitparallelchunk-1)/lsfitparallelchunk;
+    #pragma omp parallel if( lsfitparallel(double(cnt)) )
+    {
+        ap::real_1d_array x;
+        ap::real_1d_array g;
+        double f;
+        int b;
+        int t;
+        int t1;
+
+        x.setlength(m);
+        g.setlength(k);
+        #pragma omp for schedule(dynamic,1)
+        for(b = 0; b <= nchunks-1; b++)
+        {
+            t1 = ap::minint((b+1)*lsfitparallelchunk, cnt);
+            for(t = b*lsfitparallelchunk; t <= t1-1; t++)
+            {
+                ap::vmove(&x(0), 1, &state.xb(t, 0), 1, ap::vlen(0,m-1));
+                if( needgrad||func==NULL )
+                {
+                    grad(state.c, x, f, g, ptr);
+                }
+                else
+                {
+                    func(state.c, x, f, ptr);
+                }
+                state.fb(t) = f;
+                if( needgrad )
+                {
+                    ap::vmove(&state.gb(t, 0), 1, &g(0), 1, ap::vlen(0,k-1));
+                }
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool lsfitparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,lsfitparallelwork);
+#endif
+    return result;
 }
 
 
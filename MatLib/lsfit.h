@@ -84,12 +84,19 @@ struct lsfitstate
     bool needf;
     bool needfg;
     bool needfgh;
+    bool needfbatch;
+    bool needfgbatch;
+    int batchsize;
     int pointindex;
+    int pointcount;
     ap::real_1d_array x;
     ap::real_1d_array c;
     double f;
     ap::real_1d_array g;
     ap::real_2d_array h;
+    ap::real_2d_array xb;
+    ap::real_1d_array fb;
+    ap::real_2d_array gb;
     int repterminationtype;
     double reprmserror;
     double repavgerror;
@@ -437,6 +444,39 @@ with limits on step size.
 void lsfitnonlinearsetstpmax(lsfitstate& state, double stpmax);
 
 
+/*************************************************************************
+This function turns on batch mode of the nonlinear fitting.
+
+In batch mode LSFitNonlinearIteration() requests function values (and
+gradients) in up to BatchSize points at once instead  of  one  point  per
+call, so the user may vectorize  the  model  or  evaluate  the  block  in
+parallel:
+
+* State.NeedFBatch=True     values F(X[i],C) are required
+* State.NeedFGBatch=True    values F(X[i],C) and gradients dF/dC(X[i],C)
+                            are required
+
+Points are stored in State.XB[0..PointCount-1,0..M-1] (they are  rows
+PointIndex..PointIndex+PointCount-1 of the dataset), C is  stored  in
+State.C[0..K-1]. Results are stored:
+* function values           -   in State.FB[0..PointCount-1]
+* gradients                 -   in State.GB[0..PointCount-1,0..K-1]
+
+Results are accumulated in the same order as in the point-by-point  mode,
+so both modes give the same solution bit for bit.
+
+INPUT PARAMETERS:
+    State       -   structure initialized with  LSFitNonlinearWFG()  or
+                    LSFitNonlinearFG(). Hessian-based  schemes  ignore
+                    batch mode and always request points one by one.
+    BatchSize   -   maximum number of points per request, >=0. Zero turns
+                    batch mode off (default).
+
+Must be called before the first call of LSFitNonlinearIteration().
+*************************************************************************/
+void lsfitnonlinearsetbatch(lsfitstate& state, int batchsize);
+
+
 /*************************************************************************
 Nonlinear least squares fitting. Algorithm iteration.
 
@@ -457,7 +497,9 @@ RESULT
 * if State.NeedFGH=True     function value F(X,C), gradient dF/dC(X,C) and
                             Hessian are required
 
-One and only one of this fields can be set at time.
+One and only one of this fields can be set at time. In batch mode  NeedF
+and NeedFG are replaced by NeedFBatch and NeedFGBatch, see
+LSFitNonlinearSetBatch() for more information.
 
 Function, its gradient and Hessian are calculated at  (X,C),  where  X  is
 stored in State.X[0..M-1] and C is stored in State.C[0..K-1].
@@ -473,6 +515,36 @@ Results are stored:
 bool lsfitnonlineariteration(lsfitstate& state);
 
 
+/*************************************************************************
+Nonlinear least squares fitting with user callbacks evaluated in parallel.
+
+This subroutine runs LSFitNonlinearIteration() in batch mode and evaluates
+every block of points by calling user-supplied functions from the OpenMP
+thread pool. It is an alternative to the reverse communication loop  for
+large datasets where a single evaluation of  the  model  is  cheap,  but
+there are a lot of points.
+
+INPUT PARAMETERS:
+    State   -   structure initialized with LSFitNonlinearWFG()  or
+                LSFitNonlinearFG(). If batch size was not set  with
+                LSFitNonlinearSetBatch(), default one is used.
+    Func    -   callback which calculates F(X,C), may be NULL  -  in
+                this case Grad is called and gradient is ignored.
+    Grad    -   callback which calculates F(X,C) and dF/dC(X,C).
+    Ptr     -   user pointer passed to callbacks.
+
+Callbacks are called concurrently from several threads, so  they must  be
+reentrant. Each thread has its own X/G arrays; C  is  shared  and  must
+not be modified. Results do not depend on the number of threads.
+
+After return use LSFitNonlinearResults() to get the solution.
+*************************************************************************/
+void lsfitnonlinearfitparallel(lsfitstate& state,
+     void (*func)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, void* ptr),
+     void (*grad)(const ap::real_1d_array& c, const ap::real_1d_array& x, double& f, ap::real_1d_array& g, void* ptr),
+     void* ptr);
+
+
 /*************************************************************************
 Nonlinear least squares fitting results.
 
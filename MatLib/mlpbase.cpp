@@ -20,10 +20,14 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "mlpbase.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static const int mlpvnum = 7;
 static const int nfieldwidth = 4;
-static const int chunksize = 32;
+static const int chunksize = 64;
+static const double mlpparallelwork = 262144.0;
 
 static void addinputlayer(int ncount,
      ap::integer_1d_array& lsizes,
@@ -75,13 +79,31 @@ static void mlpinternalcalculategradient(multilayerperceptron& network,
      ap::real_1d_array& derror,
      ap::real_1d_array& grad,
      bool naturalerrorfunc);
+static void mlpbatchinternal(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int ssize,
+     bool needgrad,
+     bool naturalerrorfunc,
+     double& e,
+     ap::real_1d_array& grad);
+static void mlpchunkedforward(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int cstart,
+     int csize,
+     ap::real_2d_array& chunks);
 static void mlpchunkedgradient(multilayerperceptron& network,
      const ap::real_2d_array& xy,
      int cstart,
      int csize,
+     ap::real_2d_array& chunks,
+     ap::real_1d_array& nwbuf,
      double& e,
      ap::real_1d_array& grad,
+     bool needgrad,
      bool naturalerrorfunc);
+static bool mlpsamesummators(const ap::integer_1d_array& structinfo,
+     int i);
+static bool mlpparallel(double work);
 static double safecrossentropy(double t, double z);
 
 /*************************************************************************
@@ -1218,52 +1240,118 @@ void mlpprocess(multilayerperceptron& network,
 
 
 /*************************************************************************
-Error function for neural network, internal subroutine.
+Batch processing
 
-  -- ALGLIB --
-     Copyright 04.11.2007 by Bochkanov Sergey
+Same as MLPProcess() called for each row of X. Rows are processed  by  the
+chunks: each layer of the network is applied to the whole chunk  as  one
+matrix-matrix product, so this function should be  used  for  batches  of
+vectors, MLPProcess() for single vectors. Chunks are distributed  between
+threads when OpenMP is on. Results may differ from MLPProcess() by few ULP
+because of different order of summation.
+
+INPUT PARAMETERS:
+    Network -   neural network
+    X       -   input vectors, array[0..NPoints-1,0..NIn-1].
+    NPoints -   number of vectors, NPoints>=0
+
+OUTPUT PARAMETERS:
+    Y       -   results, array[0..NPoints-1,0..NOut-1]: regression estimates
+                or vectors of posterior probabilities (one row  per  input
+                vector). Allocated by the subroutine.
 *************************************************************************/
-double mlperror(multilayerperceptron& network,
-     const ap::real_2d_array& xy,
-     int ssize)
+void mlpprocessbatch(multilayerperceptron& network,
+     const ap::real_2d_array& x,
+     int npoints,
+     ap::real_2d_array& y)
 {
-    double result;
-    int i;
-    int k;
     int nin;
     int nout;
     int wcount;
-    double e;
+    int ntotal;
+    int nchunks;
+    int c;
 
-    mlpproperties(network, nin, nout, wcount);
-    result = 0;
-    for(i = 0; i <= ssize-1; i++)
+    ap::ap_error::make_assertion(npoints>=0, "MLPProcessBatch: NPoints<0!");
+    if( npoints==0 )
     {
-        ap::vmove(&network.x(0), 1, &xy(i, 0), 1, ap::vlen(0,nin-1));
-        mlpprocess(network, network.x, network.y);
-        if( mlpissoftmax(network) )
+        return;
+    }
+    mlpproperties(network, nin, nout, wcount);
+    ntotal = network.structinfo(3);
+    y.setlength(npoints, nout);
+    nchunks = (npoints+chunksize-1)/chunksize;
+    #pragma omp parallel if( nchunks>1&&mlpparallel(double(npoints)*double(wcount)) )
+    {
+        ap::real_2d_array chunks;
+        int cstart;
+        int csize;
+        int i;
+        int k;
+        double mx;
+        double net;
+
+        chunks.setbounds(0, 2*ntotal-1, 0, chunksize-1);
+        #pragma omp for schedule(static)
+        for(c = 0; c <= nchunks-1; c++)
         {
-            
-            //
-            // class labels outputs
-            //
-            k = ap::round(xy(i,nin));
-            if( k>=0&&k<nout )
+            cstart = c*chunksize;
+            csize = ap::minint(npoints, cstart+chunksize)-cstart;
+            mlpchunkedforward(network, x, cstart, csize, chunks);
+            for(k = 0; k <= csize-1; k++)
             {
-                network.y(k) = network.y(k)-1;
+                if( network.structinfo(6)==1 )
+                {
+                    
+                    //
+                    // Softmax
+                    //
+                    mx = chunks(ntotal-nout,k);
+                    for(i = 1; i <= nout-1; i++)
+                    {
+                        mx = ap::maxreal(mx, chunks(ntotal-nout+i,k));
+                    }
+                    net = 0;
+                    for(i = 0; i <= nout-1; i++)
+                    {
+                        y(cstart+k,i) = exp(chunks(ntotal-nout+i,k)-mx);
+                        net = net+y(cstart+k,i);
+                    }
+                    for(i = 0; i <= nout-1; i++)
+                    {
+                        y(cstart+k,i) = y(cstart+k,i)/net;
+                    }
+                }
+                else
+                {
+                    
+                    //
+                    // Standardisation
+                    //
+                    for(i = 0; i <= nout-1; i++)
+                    {
+                        y(cstart+k,i) = chunks(ntotal-nout+i,k)*network.columnsigmas(nin+i)+network.columnmeans(nin+i);
+                    }
+                }
             }
         }
-        else
-        {
-            
-            //
-            // real outputs
-            //
-            ap::vsub(&network.y(0), 1, &xy(i, nin), 1, ap::vlen(0,nout-1));
-        }
-        e = ap::vdotproduct(&network.y(0), 1, &network.y(0), 1, ap::vlen(0,nout-1));
-        result = result+e/2;
     }
+}
+
+
+/*************************************************************************
+Error function for neural network, internal subroutine.
+
+  -- ALGLIB --
+     Copyright 04.11.2007 by Bochkanov Sergey
+*************************************************************************/
+double mlperror(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int ssize)
+{
+    double result;
+    ap::real_1d_array grad;
+
+    mlpbatchinternal(network, xy, ssize, false, false, result, grad);
     return result;
 }
 
@@ -1279,50 +1367,9 @@ double mlperrorn(multilayerperceptron& network,
      int ssize)
 {
     double result;
-    int i;
-    int k;
-    int nin;
-    int nout;
-    int wcount;
-    double e;
+    ap::real_1d_array grad;
 
-    mlpproperties(network, nin, nout, wcount);
-    result = 0;
-    for(i = 0; i <= ssize-1; i++)
-    {
-        
-        //
-        // Process vector
-        //
-        ap::vmove(&network.x(0), 1, &xy(i, 0), 1, ap::vlen(0,nin-1));
-        mlpprocess(network, network.x, network.y);
-        
-        //
-        // Update error function
-        //
-        if( network.structinfo(6)==0 )
-        {
-            
-            //
-            // Least squares error function
-            //
-            ap::vsub(&network.y(0), 1, &xy(i, nin), 1, ap::vlen(0,nout-1));
-            e = ap::vdotproduct(&network.y(0), 1, &network.y(0), 1, ap::vlen(0,nout-1));
-            result = result+e/2;
-        }
-        else
-        {
-            
-            //
-            // Cross-entropy error function
-            //
-            k = ap::round(xy(i,nin));
-            if( k>=0&&k<nout )
-            {
-                result = result+safecrossentropy(double(1), network.y(k));
-            }
-        }
-    }
+    mlpbatchinternal(network, xy, ssize, false, true, result, grad);
     return result;
 }
 
@@ -1768,23 +1815,8 @@ void mlpgradbatch(multilayerperceptron& network,
      double& e,
      ap::real_1d_array& grad)
 {
-    int i;
-    int nin;
-    int nout;
-    int wcount;
 
-    mlpproperties(network, nin, nout, wcount);
-    for(i = 0; i <= wcount-1; i++)
-    {
-        grad(i) = 0;
-    }
-    e = 0;
-    i = 0;
-    while(i<=ssize-1)
-    {
-        mlpchunkedgradient(network, xy, i, ap::minint(ssize, i+chunksize)-i, e, grad, false);
-        i = i+chunksize;
-    }
+    mlpbatchinternal(network, xy, ssize, true, false, e, grad);
 }
 
 
@@ -1800,23 +1832,8 @@ void mlpgradnbatch(multilayerperceptron& network,
      double& e,
      ap::real_1d_array& grad)
 {
-    int i;
-    int nin;
-    int nout;
-    int wcount;
 
-    mlpproperties(network, nin, nout, wcount);
-    for(i = 0; i <= wcount-1; i++)
-    {
-        grad(i) = 0;
-    }
-    e = 0;
-    i = 0;
-    while(i<=ssize-1)
-    {
-        mlpchunkedgradient(network, xy, i, ap::minint(ssize, i+chunksize)-i, e, grad, true);
-        i = i+chunksize;
-    }
+    mlpbatchinternal(network, xy, ssize, true, true, e, grad);
 }
 
 
@@ -2971,70 +2988,163 @@ static void mlpinternalcalculategradient(multilayerperceptron& network,
 
 
 /*************************************************************************
-Internal subroutine, chunked gradient
+Batch error and gradient, internal subroutine.
+
+XY is processed by chunks of ChunkSize rows. Large batches are split into
+contiguous ranges of chunks, one per thread; each thread has its own chunk
+buffers and accumulates its own partial error and gradient, partial sums
+are added in the order of threads. Thus results  do  not  depend  on  the
+scheduling, but may differ by few ULP for different numbers of threads.
+
+When NeedGrad is False, only error is calculated and Grad is not touched.
 *************************************************************************/
-static void mlpchunkedgradient(multilayerperceptron& network,
+static void mlpbatchinternal(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int ssize,
+     bool needgrad,
+     bool naturalerrorfunc,
+     double& e,
+     ap::real_1d_array& grad)
+{
+    int nin;
+    int nout;
+    int wcount;
+    int ntotal;
+    int nchunks;
+    int nt;
+    int c;
+    int i;
+    ap::real_2d_array pgrad;
+    ap::real_1d_array pe;
+
+    mlpproperties(network, nin, nout, wcount);
+    ntotal = network.structinfo(3);
+    if( needgrad )
+    {
+        for(i = 0; i <= wcount-1; i++)
+        {
+            grad(i) = 0;
+        }
+    }
+    e = 0;
+    nchunks = (ssize+chunksize-1)/chunksize;
+    nt = 1;
+    if( nchunks>1&&mlpparallel(double(ssize)*double(wcount)) )
+    {
+#ifdef _OPENMP
+        nt = ap::minint(omp_get_max_threads(), nchunks);
+#endif
+    }
+    if( nt==1 )
+    {
+        
+        //
+        // Serial code, network buffers are used
+        //
+        for(c = 0; c <= nchunks-1; c++)
+        {
+            mlpchunkedgradient(network, xy, c*chunksize, ap::minint(ssize, (c+1)*chunksize)-c*chunksize, network.chunks, network.nwbuf, e, grad, needgrad, naturalerrorfunc);
+        }
+        return;
+    }
+    
+    //
+    // Parallel code: thread T accumulates its sums in PE[T] and PGrad[T].
+    // Rows of threads which were not started remain zero.
+    //
+    pe.setlength(nt);
+    for(i = 0; i <= nt-1; i++)
+    {
+        pe(i) = 0;
+    }
+    if( needgrad )
+    {
+        pgrad.setlength(nt, wcount);
+        for(i = 0; i <= nt-1; i++)
+        {
+            for(c = 0; c <= wcount-1; c++)
+            {
+                pgrad(i,c) = 0;
+            }
+        }
+    }
+    #pragma omp parallel num_threads(nt)
+    {
+        ap::real_2d_array chunks;
+        ap::real_1d_array nwbuf;
+        ap::real_1d_array tgrad;
+        double te;
+        int t;
+
+        t = 0;
+#ifdef _OPENMP
+        t = omp_get_thread_num();
+#endif
+        chunks.setbounds(0, 3*ntotal, 0, chunksize-1);
+        nwbuf.setbounds(0, 2*nout-1);
+        if( needgrad )
+        {
+            tgrad.attach(0, wcount-1, &pgrad(t, 0));
+        }
+        te = 0;
+        #pragma omp for schedule(static)
+        for(c = 0; c <= nchunks-1; c++)
+        {
+            mlpchunkedgradient(network, xy, c*chunksize, ap::minint(ssize, (c+1)*chunksize)-c*chunksize, chunks, nwbuf, te, tgrad, needgrad, naturalerrorfunc);
+        }
+        pe(t) = te;
+    }
+    for(i = 0; i <= nt-1; i++)
+    {
+        e = e+pe(i);
+        if( needgrad )
+        {
+            ap::vadd(&grad(0), 1, &pgrad(i, 0), 1, ap::vlen(0,wcount-1));
+        }
+    }
+}
+
+
+/*************************************************************************
+Internal subroutine, chunked forward pass.
+
+Rows CStart..CStart+CSize-1 of XY are loaded  to  the  columns  of  Chunks,
+Chunks[I,K] is set to the output of the I-th neuron for the K-th row and
+Chunks[NTotal+I,K] to its dF/dNET. Consecutive summators of one layer are
+processed together: their weights form a row-major matrix,  so  the  layer
+is calculated as one matrix-matrix product.
+*************************************************************************/
+static void mlpchunkedforward(multilayerperceptron& network,
      const ap::real_2d_array& xy,
      int cstart,
      int csize,
-     double& e,
-     ap::real_1d_array& grad,
-     bool naturalerrorfunc)
+     ap::real_2d_array& chunks)
 {
     int i;
     int j;
     int k;
-    int kl;
     int n1;
-    int n2;
+    int nsyn;
     int w1;
-    int w2;
-    int c1;
-    int c2;
+    int cnt;
     int ntotal;
     int nin;
-    int nout;
     int offs;
+    int istart;
+    int idfdnet;
     double f;
     double df;
     double d2f;
-    double v;
-    double s;
-    double fown;
-    double deown;
-    double net;
-    double lnnet;
-    double mx;
     bool bflag;
-    int istart;
-    int ineurons;
-    int idfdnet;
-    int iderror;
-    int izeros;
+    ap::real_2d_array w;
 
-    
-    //
-    // Read network geometry, prepare data
-    //
     nin = network.structinfo(1);
-    nout = network.structinfo(2);
     ntotal = network.structinfo(3);
     istart = network.structinfo(5);
-    c1 = cstart;
-    c2 = cstart+csize-1;
-    ineurons = 0;
     idfdnet = ntotal;
-    iderror = 2*ntotal;
-    izeros = 3*ntotal;
-    for(j = 0; j <= csize-1; j++)
-    {
-        network.chunks(izeros,j) = 0;
-    }
     
     //
-    // Forward pass:
-    // 1. Load inputs from XY to Chunks[0:NIn-1,0:CSize-1]
-    // 2. Forward pass
+    // Load inputs from XY to Chunks[0:NIn-1,0:CSize-1]
     //
     for(i = 0; i <= nin-1; i++)
     {
@@ -3042,15 +3152,20 @@ static void mlpchunkedgradient(multilayerperceptron& network,
         {
             if( ap::fp_neq(network.columnsigmas(i),0) )
             {
-                network.chunks(i,j) = (xy(c1+j,i)-network.columnmeans(i))/network.columnsigmas(i);
+                chunks(i,j) = (xy(cstart+j,i)-network.columnmeans(i))/network.columnsigmas(i);
             }
             else
             {
-                network.chunks(i,j) = xy(c1+j,i)-network.columnmeans(i);
+                chunks(i,j) = xy(cstart+j,i)-network.columnmeans(i);
             }
         }
     }
-    for(i = 0; i <= ntotal-1; i++)
+    
+    //
+    // Forward pass
+    //
+    i = 0;
+    while(i<=ntotal-1)
     {
         offs = istart+i*nfieldwidth;
         if( network.structinfo(offs+0)>0 )
@@ -3061,77 +3176,147 @@ static void mlpchunkedgradient(multilayerperceptron& network,
             // * calculate F vector, F(i) = F(NET(i))
             //
             n1 = network.structinfo(offs+2);
-            ap::vmove(&network.chunks(i, 0), 1, &network.chunks(n1, 0), 1, ap::vlen(0,csize-1));
             for(j = 0; j <= csize-1; j++)
             {
-                mlpactivationfunction(network.chunks(i,j), network.structinfo(offs+0), f, df, d2f);
-                network.chunks(i,j) = f;
-                network.chunks(idfdnet+i,j) = df;
+                mlpactivationfunction(chunks(n1,j), network.structinfo(offs+0), f, df, d2f);
+                chunks(i,j) = f;
+                chunks(idfdnet+i,j) = df;
             }
+            i = i+1;
+            continue;
         }
         if( network.structinfo(offs+0)==0 )
         {
             
             //
-            // Adaptive summator:
-            // * calculate NET vector, NET(i) = SUM(W(j,i)*Neurons(j),j=N1..N2)
+            // Adaptive summators I..I+Cnt-1:
+            // * NET[I:I+Cnt-1,:] = W*Chunks[N1:N1+NSyn-1,:],
+            //   where W is Cnt x NSyn matrix of weights
             //
             n1 = network.structinfo(offs+2);
-            n2 = n1+network.structinfo(offs+1)-1;
+            nsyn = network.structinfo(offs+1);
             w1 = network.structinfo(offs+3);
-            w2 = w1+network.structinfo(offs+1)-1;
-            ap::vmove(&network.chunks(i, 0), 1, &network.chunks(izeros, 0), 1, ap::vlen(0,csize-1));
-            for(j = n1; j <= n2; j++)
+            cnt = 1;
+            while(i+cnt<=ntotal-1&&mlpsamesummators(network.structinfo, i+cnt-1))
             {
-                v = network.weights(w1+j-n1);
-                ap::vadd(&network.chunks(i, 0), 1, &network.chunks(j, 0), 1, ap::vlen(0,csize-1), v);
+                cnt = cnt+1;
             }
+            w.attach(0, cnt-1, 0, nsyn-1, &network.weights(w1), nsyn);
+            rmatrixgemm(cnt, csize, nsyn, 1.0, w, 0, 0, 0, chunks, n1, 0, 0, 0.0, chunks, i, 0);
+            i = i+cnt;
+            continue;
         }
-        if( network.structinfo(offs+0)<0 )
+        bflag = false;
+        if( network.structinfo(offs+0)==-2 )
         {
-            bflag = false;
-            if( network.structinfo(offs+0)==-2 )
+            
+            //
+            // input neuron, left unchanged
+            //
+            bflag = true;
+        }
+        if( network.structinfo(offs+0)==-3 )
+        {
+            
+            //
+            // "-1" neuron
+            //
+            for(k = 0; k <= csize-1; k++)
             {
-                
-                //
-                // input neuron, left unchanged
-                //
-                bflag = true;
+                chunks(i,k) = -1;
             }
-            if( network.structinfo(offs+0)==-3 )
-            {
-                
-                //
-                // "-1" neuron
-                //
-                for(k = 0; k <= csize-1; k++)
-                {
-                    network.chunks(i,k) = -1;
-                }
-                bflag = true;
-            }
-            if( network.structinfo(offs+0)==-4 )
+            bflag = true;
+        }
+        if( network.structinfo(offs+0)==-4 )
+        {
+            
+            //
+            // "0" neuron
+            //
+            for(k = 0; k <= csize-1; k++)
             {
-                
-                //
-                // "0" neuron
-                //
-                for(k = 0; k <= csize-1; k++)
-                {
-                    network.chunks(i,k) = 0;
-                }
-                bflag = true;
+                chunks(i,k) = 0;
             }
-            ap::ap_error::make_assertion(bflag, "MLPChunkedGradient: internal error - unknown neuron type!");
+            bflag = true;
         }
+        ap::ap_error::make_assertion(bflag, "MLPChunkedForward: internal error - unknown neuron type!");
+        i = i+1;
     }
+}
+
+
+/*************************************************************************
+Internal subroutine, chunked gradient.
+
+Error for rows CStart..CStart+CSize-1 of XY is added to E, gradient (when
+NeedGrad is True) - to Grad. Chunks (3*NTotal+1 rows, ChunkSize  columns)
+and NWBuf (at least 2*NOut elements) are work buffers, so  this  function
+may be called by several threads with different buffers.
+*************************************************************************/
+static void mlpchunkedgradient(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int cstart,
+     int csize,
+     ap::real_2d_array& chunks,
+     ap::real_1d_array& nwbuf,
+     double& e,
+     ap::real_1d_array& grad,
+     bool needgrad,
+     bool naturalerrorfunc)
+{
+    int i;
+    int i0;
+    int j;
+    int k;
+    int kl;
+    int n1;
+    int nsyn;
+    int w1;
+    int ntotal;
+    int nin;
+    int nout;
+    int offs;
+    double v;
+    double s;
+    double fown;
+    double deown;
+    double net;
+    double lnnet;
+    double mx;
+    bool bflag;
+    int istart;
+    int idfdnet;
+    int iderror;
+    int izeros;
+    ap::real_2d_array w;
+    ap::real_2d_array g;
+
+    
+    //
+    // Read network geometry, forward pass
+    //
+    nin = network.structinfo(1);
+    nout = network.structinfo(2);
+    ntotal = network.structinfo(3);
+    istart = network.structinfo(5);
+    idfdnet = ntotal;
+    iderror = 2*ntotal;
+    izeros = 3*ntotal;
+    mlpchunkedforward(network, xy, cstart, csize, chunks);
     
     //
     // Post-processing, error, dError/dOut
     //
-    for(i = 0; i <= ntotal-1; i++)
+    if( needgrad )
     {
-        ap::vmove(&network.chunks(iderror+i, 0), 1, &network.chunks(izeros, 0), 1, ap::vlen(0,csize-1));
+        for(j = 0; j <= csize-1; j++)
+        {
+            chunks(izeros,j) = 0;
+        }
+        for(i = 0; i <= ntotal-1; i++)
+        {
+            ap::vmove(&chunks(iderror+i, 0), 1, &chunks(izeros, 0), 1, ap::vlen(0,csize-1));
+        }
     }
     ap::ap_error::make_assertion(network.structinfo(6)==0||network.structinfo(6)==1, "MLPChunkedGradient: unknown normalization type!");
     if( network.structinfo(6)==1 )
@@ -3151,16 +3336,16 @@ static void mlpchunkedgradient(multilayerperceptron& network,
             //
             // Normalize
             //
-            mx = network.chunks(ntotal-nout,k);
+            mx = chunks(ntotal-nout,k);
             for(i = 1; i <= nout-1; i++)
             {
-                mx = ap::maxreal(mx, network.chunks(ntotal-nout+i,k));
+                mx = ap::maxreal(mx, chunks(ntotal-nout+i,k));
             }
             net = 0;
             for(i = 0; i <= nout-1; i++)
             {
-                network.nwbuf(i) = exp(network.chunks(ntotal-nout+i,k)-mx);
-                net = net+network.nwbuf(i);
+                nwbuf(i) = exp(chunks(ntotal-nout+i,k)-mx);
+                net = net+nwbuf(i);
             }
             
             //
@@ -3186,8 +3371,8 @@ static void mlpchunkedgradient(multilayerperceptron& network,
                     {
                         v = 0;
                     }
-                    network.chunks(iderror+ntotal-nout+i,k) = s*network.nwbuf(i)/net-v;
-                    e = e+safecrossentropy(v, network.nwbuf(i)/net);
+                    chunks(iderror+ntotal-nout+i,k) = s*nwbuf(i)/net-v;
+                    e = e+safecrossentropy(v, nwbuf(i)/net);
                 }
             }
             else
@@ -3202,25 +3387,25 @@ static void mlpchunkedgradient(multilayerperceptron& network,
                 {
                     if( i==kl )
                     {
-                        v = network.nwbuf(i)/net-1;
+                        v = nwbuf(i)/net-1;
                     }
                     else
                     {
-                        v = network.nwbuf(i)/net;
+                        v = nwbuf(i)/net;
                     }
-                    network.nwbuf(nout+i) = v;
+                    nwbuf(nout+i) = v;
                     e = e+ap::sqr(v)/2;
                 }
                 
                 //
                 // From dError/dOut(normalized) to dError/dOut(non-normalized)
                 //
-                v = ap::vdotproduct(&network.nwbuf(nout), 1, &network.nwbuf(0), 1, ap::vlen(nout,2*nout-1));
+                v = ap::vdotproduct(&nwbuf(nout), 1, &nwbuf(0), 1, ap::vlen(nout,2*nout-1));
                 for(i = 0; i <= nout-1; i++)
                 {
-                    fown = network.nwbuf(i);
-                    deown = network.nwbuf(nout+i);
-                    network.chunks(iderror+ntotal-nout+i,k) = (-v+deown*fown+deown*(net-fown))*fown/ap::sqr(net);
+                    fown = nwbuf(i);
+                    deown = nwbuf(nout+i);
+                    chunks(iderror+ntotal-nout+i,k) = (-v+deown*fown+deown*(net-fown))*fown/ap::sqr(net);
                 }
             }
         }
@@ -3238,17 +3423,22 @@ static void mlpchunkedgradient(multilayerperceptron& network,
         {
             for(j = 0; j <= csize-1; j++)
             {
-                v = network.chunks(ntotal-nout+i,j)*network.columnsigmas(nin+i)+network.columnmeans(nin+i)-xy(cstart+j,nin+i);
-                network.chunks(iderror+ntotal-nout+i,j) = v*network.columnsigmas(nin+i);
+                v = chunks(ntotal-nout+i,j)*network.columnsigmas(nin+i)+network.columnmeans(nin+i)-xy(cstart+j,nin+i);
+                chunks(iderror+ntotal-nout+i,j) = v*network.columnsigmas(nin+i);
                 e = e+ap::sqr(v)/2;
             }
         }
     }
+    if( !needgrad )
+    {
+        return;
+    }
     
     //
     // Backpropagation
     //
-    for(i = ntotal-1; i >= 0; i--)
+    i = ntotal-1;
+    while(i>=0)
     {
         
         //
@@ -3264,48 +3454,91 @@ static void mlpchunkedgradient(multilayerperceptron& network,
             n1 = network.structinfo(offs+2);
             for(k = 0; k <= csize-1; k++)
             {
-                network.chunks(iderror+i,k) = network.chunks(iderror+i,k)*network.chunks(idfdnet+i,k);
+                chunks(iderror+i,k) = chunks(iderror+i,k)*chunks(idfdnet+i,k);
             }
-            ap::vadd(&network.chunks(iderror+n1, 0), 1, &network.chunks(iderror+i, 0), 1, ap::vlen(0,csize-1));
+            ap::vadd(&chunks(iderror+n1, 0), 1, &chunks(iderror+i, 0), 1, ap::vlen(0,csize-1));
+            i = i-1;
+            continue;
         }
         if( network.structinfo(offs+0)==0 )
         {
             
             //
-            // "Normal" activation function
+            // Adaptive summators I0..I, W is (I-I0+1) x NSyn matrix of
+            // their weights, D is dError/dNET:
+            // * gradient: G = G + D*Chunks[N1:N1+NSyn-1,:]'
+            // * dError/dOut of the inputs: W'*D
             //
-            n1 = network.structinfo(offs+2);
-            n2 = n1+network.structinfo(offs+1)-1;
-            w1 = network.structinfo(offs+3);
-            w2 = w1+network.structinfo(offs+1)-1;
-            for(j = w1; j <= w2; j++)
-            {
-                v = ap::vdotproduct(&network.chunks(n1+j-w1, 0), 1, &network.chunks(iderror+i, 0), 1, ap::vlen(0,csize-1));
-                grad(j) = grad(j)+v;
-            }
-            for(j = n1; j <= n2; j++)
+            i0 = i;
+            while(i0>0&&mlpsamesummators(network.structinfo, i0-1))
             {
-                v = network.weights(w1+j-n1);
-                ap::vadd(&network.chunks(iderror+j, 0), 1, &network.chunks(iderror+i, 0), 1, ap::vlen(0,csize-1), v);
+                i0 = i0-1;
             }
+            offs = istart+i0*nfieldwidth;
+            n1 = network.structinfo(offs+2);
+            nsyn = network.structinfo(offs+1);
+            w1 = network.structinfo(offs+3);
+            w.attach(0, i-i0, 0, nsyn-1, &network.weights(w1), nsyn);
+            g.attach(0, i-i0, 0, nsyn-1, &grad(w1), nsyn);
+            rmatrixgemm(i-i0+1, nsyn, csize, 1.0, chunks, iderror+i0, 0, 0, chunks, n1, 0, 1, 1.0, g, 0, 0);
+            rmatrixgemm(nsyn, csize, i-i0+1, 1.0, w, 0, 0, 1, chunks, iderror+i0, 0, 0, 1.0, chunks, iderror+n1, 0);
+            i = i0-1;
+            continue;
         }
-        if( network.structinfo(offs+0)<0 )
+        bflag = false;
+        if( network.structinfo(offs+0)==-2||network.structinfo(offs+0)==-3||network.structinfo(offs+0)==-4 )
         {
-            bflag = false;
-            if( network.structinfo(offs+0)==-2||network.structinfo(offs+0)==-3||network.structinfo(offs+0)==-4 )
-            {
-                
-                //
-                // Special neuron type, no back-propagation required
-                //
-                bflag = true;
-            }
-            ap::ap_error::make_assertion(bflag, "MLPInternalCalculateGradient: unknown neuron type!");
+            
+            //
+            // Special neuron type, no back-propagation required
+            //
+            bflag = true;
         }
+        ap::ap_error::make_assertion(bflag, "MLPInternalCalculateGradient: unknown neuron type!");
+        i = i-1;
     }
 }
 
 
+/*************************************************************************
+True if summators I and I+1 belong to the same layer: they are connected
+to the same neurons, which precede summator I, and their weights are stored
+one after another.
+*************************************************************************/
+static bool mlpsamesummators(const ap::integer_1d_array& structinfo,
+     int i)
+{
+    bool result;
+    int offs1;
+    int offs2;
+
+    offs1 = structinfo(5)+i*nfieldwidth;
+    offs2 = offs1+nfieldwidth;
+    result = structinfo(offs1+0)==0&&structinfo(offs2+0)==0;
+    result = result&&structinfo(offs1+1)==structinfo(offs2+1)&&structinfo(offs1+2)==structinfo(offs2+2);
+    result = result&&structinfo(offs1+3)+structinfo(offs1+1)==structinfo(offs2+3);
+    result = result&&structinfo(offs1+2)+structinfo(offs1+1)<=i;
+    return result;
+}
+
+
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool mlpparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,mlpparallelwork);
+#endif
+    return result;
+}
+
+
 /*************************************************************************
 Returns T*Ln(T/Z), guarded against overflow/underflow.
 Internal subroutine.
@@ -23,6 +23,8 @@ http://www.fsf.org/licensing/licenses
 
 #include "ap.h"
 #include "ialglib.h"
+#include "ablasf.h"
+#include "ablas.h"
 
 struct multilayerperceptron
 {
@@ -333,6 +335,32 @@ void mlpprocess(multilayerperceptron& network,
      ap::real_1d_array& y);
 
 
+/*************************************************************************
+Batch processing
+
+Same as MLPProcess() called for each row of X. Rows are processed  by  the
+chunks: each layer of the network is applied to the whole chunk  as  one
+matrix-matrix product, so this function should be  used  for  batches  of
+vectors, MLPProcess() for single vectors. Chunks are distributed  between
+threads when OpenMP is on. Results may differ from MLPProcess() by few ULP
+because of different order of summation.
+
+INPUT PARAMETERS:
+    Network -   neural network
+    X       -   input vectors, array[0..NPoints-1,0..NIn-1].
+    NPoints -   number of vectors, NPoints>=0
+
+OUTPUT PARAMETERS:
+    Y       -   results, array[0..NPoints-1,0..NOut-1]: regression estimates
+                or vectors of posterior probabilities (one row  per  input
+                vector). Allocated by the subroutine.
+*************************************************************************/
+void mlpprocessbatch(multilayerperceptron& network,
+     const ap::real_2d_array& x,
+     int npoints,
+     ap::real_2d_array& y);
+
+
 /*************************************************************************
 Error function for neural network, internal subroutine.
 
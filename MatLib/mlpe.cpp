@@ -20,9 +20,13 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "mlpe.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static const int mlpntotaloffset = 3;
 static const int mlpevnum = 9;
+static const double mlpeparallelwork = 4096.0;
 
 static void mlpeallerrors(mlpensemble& ensemble,
      const ap::real_2d_array& xy,
@@ -43,6 +47,7 @@ static void mlpebagginginternal(mlpensemble& ensemble,
      int& info,
      mlpreport& rep,
      mlpcvreport& ooberrors);
+static bool mlpeparallel(double work);
 
 /*************************************************************************
 Like MLPCreate0, but for ensembles.
@@ -976,13 +981,13 @@ void mlpetraines(mlpensemble& ensemble,
     int k;
     int ccount;
     int pcount;
-    ap::real_2d_array trnxy;
-    ap::real_2d_array valxy;
     int trnsize;
     int valsize;
-    multilayerperceptron network;
-    int tmpinfo;
-    mlpreport tmprep;
+    bool parallel;
+    ap::boolean_2d_array trnflags;
+    ap::integer_1d_array infos;
+    ap::integer_2d_array reps;
+    hqrndstate rs;
 
     if( npoints<2||restarts<1||ap::fp_less(decay,0) )
     {
@@ -1015,69 +1020,113 @@ void mlpetraines(mlpensemble& ensemble,
         ccount = ensemble.nin+ensemble.nout;
         pcount = ensemble.nin+ensemble.nout;
     }
-    trnxy.setbounds(0, npoints-1, 0, ccount-1);
-    valxy.setbounds(0, npoints-1, 0, ccount-1);
-    mlpunserialize(ensemble.serializedmlp, network);
+    trnflags.setbounds(0, ensemble.ensemblesize-1, 0, npoints-1);
+    infos.setbounds(0, ensemble.ensemblesize-1);
+    reps.setbounds(0, ensemble.ensemblesize-1, 0, 2);
     rep.ngrad = 0;
     rep.nhess = 0;
     rep.ncholesky = 0;
     
     //
-    // train networks
+    // Split sets are generated before training and K-th network uses K-th
+    // substream of the counter-based generator, so the ensemble does not
+    // depend on the order in which its networks are trained.
     //
     for(k = 0; k <= ensemble.ensemblesize-1; k++)
     {
-        
-        //
-        // Split set
-        //
         do
         {
             trnsize = 0;
             valsize = 0;
             for(i = 0; i <= npoints-1; i++)
             {
-                if( ap::fp_less(ap::randomreal(),0.66) )
+                trnflags(k,i) = ap::fp_less(ap::randomreal(),0.66);
+                if( trnflags(k,i) )
                 {
-                    
-                    //
-                    // Assign sample to training set
-                    //
-                    ap::vmove(&trnxy(trnsize, 0), 1, &xy(i, 0), 1, ap::vlen(0,ccount-1));
                     trnsize = trnsize+1;
                 }
                 else
                 {
-                    
-                    //
-                    // Assign sample to validation set
-                    //
-                    ap::vmove(&valxy(valsize, 0), 1, &xy(i, 0), 1, ap::vlen(0,ccount-1));
                     valsize = valsize+1;
                 }
             }
         }
         while(!(trnsize!=0&&valsize!=0));
-        
-        //
-        // Train
-        //
-        mlptraines(network, trnxy, trnsize, valxy, valsize, decay, restarts, tmpinfo, tmprep);
-        if( tmpinfo<0 )
+    }
+    hqrndphiloxrandomize(rs);
+    
+    //
+    // train networks.
+    //
+    // K-th network is saved in the K-th slot of the ensemble, so networks
+    // may be trained by different threads. Each thread has its own copy of
+    // the network and its own training and validation sets.
+    //
+    parallel = ensemble.ensemblesize>1&&mlpeparallel(double(ensemble.ensemblesize)*double(npoints)*double(ensemble.wcount)*double(restarts));
+    #pragma omp parallel if( parallel )
+    {
+        multilayerperceptron network;
+        ap::real_2d_array trnxy;
+        ap::real_2d_array valxy;
+        hqrndstate trs;
+        mlpreport tmprep;
+        int tk;
+        int ti;
+        int ttrnsize;
+        int tvalsize;
+
+        mlpunserialize(ensemble.serializedmlp, network);
+        trnxy.setbounds(0, npoints-1, 0, ccount-1);
+        valxy.setbounds(0, npoints-1, 0, ccount-1);
+        #pragma omp for schedule(dynamic,1)
+        for(tk = 0; tk <= ensemble.ensemblesize-1; tk++)
         {
-            info = tmpinfo;
+            
+            //
+            // Split set
+            //
+            ttrnsize = 0;
+            tvalsize = 0;
+            for(ti = 0; ti <= npoints-1; ti++)
+            {
+                if( trnflags(tk,ti) )
+                {
+                    ap::vmove(&trnxy(ttrnsize, 0), 1, &xy(ti, 0), 1, ap::vlen(0,ccount-1));
+                    ttrnsize = ttrnsize+1;
+                }
+                else
+                {
+                    ap::vmove(&valxy(tvalsize, 0), 1, &xy(ti, 0), 1, ap::vlen(0,ccount-1));
+                    tvalsize = tvalsize+1;
+                }
+            }
+            
+            //
+            // Train, save results
+            //
+            hqrndsubstream(rs, tk, trs);
+            mlptrainesinternal(network, trnxy, ttrnsize, valxy, tvalsize, decay, restarts, trs, infos(tk), tmprep);
+            reps(tk,0) = tmprep.ngrad;
+            reps(tk,1) = tmprep.nhess;
+            reps(tk,2) = tmprep.ncholesky;
+            if( infos(tk)>=0 )
+            {
+                ap::vmove(&ensemble.weights(tk*ensemble.wcount), 1, &network.weights(0), 1, ap::vlen(tk*ensemble.wcount,(tk+1)*ensemble.wcount-1));
+                ap::vmove(&ensemble.columnmeans(tk*pcount), 1, &network.columnmeans(0), 1, ap::vlen(tk*pcount,(tk+1)*pcount-1));
+                ap::vmove(&ensemble.columnsigmas(tk*pcount), 1, &network.columnsigmas(0), 1, ap::vlen(tk*pcount,(tk+1)*pcount-1));
+            }
+        }
+    }
+    for(k = 0; k <= ensemble.ensemblesize-1; k++)
+    {
+        if( infos(k)<0 )
+        {
+            info = infos(k);
             return;
         }
-        
-        //
-        // save results
-        //
-        ap::vmove(&ensemble.weights(k*ensemble.wcount), 1, &network.weights(0), 1, ap::vlen(k*ensemble.wcount,(k+1)*ensemble.wcount-1));
-        ap::vmove(&ensemble.columnmeans(k*pcount), 1, &network.columnmeans(0), 1, ap::vlen(k*pcount,(k+1)*pcount-1));
-        ap::vmove(&ensemble.columnsigmas(k*pcount), 1, &network.columnsigmas(0), 1, ap::vlen(k*pcount,(k+1)*pcount-1));
-        rep.ngrad = rep.ngrad+tmprep.ngrad;
-        rep.nhess = rep.nhess+tmprep.nhess;
-        rep.ncholesky = rep.ncholesky+tmprep.ncholesky;
+        rep.ngrad = rep.ngrad+reps(k,0);
+        rep.nhess = rep.nhess+reps(k,1);
+        rep.ncholesky = rep.ncholesky+reps(k,2);
     }
 }
 
@@ -1156,11 +1205,14 @@ static void mlpebagginginternal(mlpensemble& ensemble,
      mlpreport& rep,
      mlpcvreport& ooberrors)
 {
+    ap::integer_2d_array idx;
+    ap::integer_1d_array infos;
+    ap::integer_2d_array reps;
     ap::real_2d_array xys;
+    ap::real_2d_array ys;
     ap::boolean_1d_array s;
     ap::real_2d_array oobbuf;
     ap::integer_1d_array oobcntbuf;
-    ap::real_1d_array x;
     ap::real_1d_array y;
     ap::real_1d_array dy;
     ap::real_1d_array dsbuf;
@@ -1171,8 +1223,10 @@ static void mlpebagginginternal(mlpensemble& ensemble,
     int i;
     int j;
     int k;
+    int cnt;
     double v;
-    mlpreport tmprep;
+    bool parallel;
+    hqrndstate rs;
     multilayerperceptron network;
 
     
@@ -1225,11 +1279,13 @@ static void mlpebagginginternal(mlpensemble& ensemble,
         ccnt = nin+nout;
         pcnt = nin+nout;
     }
-    xys.setbounds(0, npoints-1, 0, ccnt-1);
+    idx.setbounds(0, ensemble.ensemblesize-1, 0, npoints-1);
+    infos.setbounds(0, ensemble.ensemblesize-1);
+    reps.setbounds(0, ensemble.ensemblesize-1, 0, 2);
+    xys.setbounds(0, npoints-1, 0, nin-1);
     s.setbounds(0, npoints-1);
     oobbuf.setbounds(0, npoints-1, 0, nout-1);
     oobcntbuf.setbounds(0, npoints-1);
-    x.setbounds(0, nin-1);
     y.setbounds(0, nout-1);
     if( ensemble.issoftmax )
     {
@@ -1253,62 +1309,124 @@ static void mlpebagginginternal(mlpensemble& ensemble,
     mlpunserialize(ensemble.serializedmlp, network);
     
     //
-    // main bagging cycle
+    // Bootstrap samples are generated before training and K-th network uses
+    // K-th substream of the counter-based generator, so the ensemble does
+    // not depend on the order in which its networks are trained.
     //
     for(k = 0; k <= ensemble.ensemblesize-1; k++)
     {
-        
-        //
-        // prepare dataset
-        //
         for(i = 0; i <= npoints-1; i++)
         {
-            s(i) = false;
+            idx(k,i) = ap::randominteger(npoints);
         }
-        for(i = 0; i <= npoints-1; i++)
+    }
+    hqrndphiloxrandomize(rs);
+    
+    //
+    // main bagging cycle.
+    //
+    // K-th network is saved in the K-th slot of the ensemble, so networks
+    // may be trained by different threads. Each thread has its own copy of
+    // the network and its own bootstrap sample.
+    //
+    parallel = ensemble.ensemblesize>1&&mlpeparallel(double(ensemble.ensemblesize)*double(npoints)*double(ensemble.wcount)*double(restarts));
+    #pragma omp parallel if( parallel )
+    {
+        multilayerperceptron tnetwork;
+        ap::real_2d_array txys;
+        hqrndstate trs;
+        mlpreport tmprep;
+        int tk;
+        int ti;
+
+        mlpunserialize(ensemble.serializedmlp, tnetwork);
+        txys.setbounds(0, npoints-1, 0, ccnt-1);
+        #pragma omp for schedule(dynamic,1)
+        for(tk = 0; tk <= ensemble.ensemblesize-1; tk++)
         {
-            j = ap::randominteger(npoints);
-            s(j) = true;
-            ap::vmove(&xys(i, 0), 1, &xy(j, 0), 1, ap::vlen(0,ccnt-1));
+            
+            //
+            // prepare dataset
+            //
+            for(ti = 0; ti <= npoints-1; ti++)
+            {
+                ap::vmove(&txys(ti, 0), 1, &xy(idx(tk,ti), 0), 1, ap::vlen(0,ccnt-1));
+            }
+            
+            //
+            // train
+            //
+            hqrndsubstream(rs, tk, trs);
+            if( lmalgorithm )
+            {
+                mlptrainlminternal(tnetwork, txys, npoints, decay, restarts, trs, infos(tk), tmprep);
+            }
+            else
+            {
+                mlptrainlbfgsinternal(tnetwork, txys, npoints, decay, restarts, wstep, maxits, trs, infos(tk), tmprep);
+            }
+            
+            //
+            // save results
+            //
+            reps(tk,0) = tmprep.ngrad;
+            reps(tk,1) = tmprep.nhess;
+            reps(tk,2) = tmprep.ncholesky;
+            if( infos(tk)>=0 )
+            {
+                ap::vmove(&ensemble.weights(tk*ensemble.wcount), 1, &tnetwork.weights(0), 1, ap::vlen(tk*ensemble.wcount,(tk+1)*ensemble.wcount-1));
+                ap::vmove(&ensemble.columnmeans(tk*pcnt), 1, &tnetwork.columnmeans(0), 1, ap::vlen(tk*pcnt,(tk+1)*pcnt-1));
+                ap::vmove(&ensemble.columnsigmas(tk*pcnt), 1, &tnetwork.columnsigmas(0), 1, ap::vlen(tk*pcnt,(tk+1)*pcnt-1));
+            }
         }
-        
-        //
-        // train
-        //
-        if( lmalgorithm )
+    }
+    for(k = 0; k <= ensemble.ensemblesize-1; k++)
+    {
+        info = infos(k);
+        if( info<0 )
         {
-            mlptrainlm(network, xys, npoints, decay, restarts, info, tmprep);
+            return;
         }
-        else
+        rep.ngrad = rep.ngrad+reps(k,0);
+        rep.nhess = rep.nhess+reps(k,1);
+        rep.ncholesky = rep.ncholesky+reps(k,2);
+    }
+    
+    //
+    // OOB estimates: out-of-bag points of the K-th network are
+    // processed by one call to MLPProcessBatch
+    //
+    for(k = 0; k <= ensemble.ensemblesize-1; k++)
+    {
+        for(i = 0; i <= npoints-1; i++)
         {
-            mlptrainlbfgs(network, xys, npoints, decay, restarts, wstep, maxits, info, tmprep);
+            s(i) = false;
         }
-        if( info<0 )
+        for(i = 0; i <= npoints-1; i++)
         {
-            return;
+            s(idx(k,i)) = true;
         }
-        
-        //
-        // save results
-        //
-        rep.ngrad = rep.ngrad+tmprep.ngrad;
-        rep.nhess = rep.nhess+tmprep.nhess;
-        rep.ncholesky = rep.ncholesky+tmprep.ncholesky;
-        ap::vmove(&ensemble.weights(k*ensemble.wcount), 1, &network.weights(0), 1, ap::vlen(k*ensemble.wcount,(k+1)*ensemble.wcount-1));
-        ap::vmove(&ensemble.columnmeans(k*pcnt), 1, &network.columnmeans(0), 1, ap::vlen(k*pcnt,(k+1)*pcnt-1));
-        ap::vmove(&ensemble.columnsigmas(k*pcnt), 1, &network.columnsigmas(0), 1, ap::vlen(k*pcnt,(k+1)*pcnt-1));
-        
-        //
-        // OOB estimates
-        //
+        ap::vmove(&network.weights(0), 1, &ensemble.weights(k*ensemble.wcount), 1, ap::vlen(0,ensemble.wcount-1));
+        ap::vmove(&network.columnmeans(0), 1, &ensemble.columnmeans(k*pcnt), 1, ap::vlen(0,pcnt-1));
+        ap::vmove(&network.columnsigmas(0), 1, &ensemble.columnsigmas(k*pcnt), 1, ap::vlen(0,pcnt-1));
+        cnt = 0;
         for(i = 0; i <= npoints-1; i++)
         {
             if( !s(i) )
             {
-                ap::vmove(&x(0), 1, &xy(i, 0), 1, ap::vlen(0,nin-1));
-                mlpprocess(network, x, y);
-                ap::vadd(&oobbuf(i, 0), 1, &y(0), 1, ap::vlen(0,nout-1));
+                ap::vmove(&xys(cnt, 0), 1, &xy(i, 0), 1, ap::vlen(0,nin-1));
+                cnt = cnt+1;
+            }
+        }
+        mlpprocessbatch(network, xys, cnt, ys);
+        cnt = 0;
+        for(i = 0; i <= npoints-1; i++)
+        {
+            if( !s(i) )
+            {
+                ap::vadd(&oobbuf(i, 0), 1, &ys(cnt, 0), 1, ap::vlen(0,nout-1));
                 oobcntbuf(i) = oobcntbuf(i)+1;
+                cnt = cnt+1;
             }
         }
     }
@@ -1350,5 +1468,21 @@ static void mlpebagginginternal(mlpensemble& ensemble,
 }
 
 
+/*************************************************************************
+True if networks should be trained by several threads: OpenMP is available,
+there are several threads, we are not in the parallel region already and
+problem is large enough. WORK is a number of operations per epoch, training
+of one network takes tens or hundreds of epochs.
+*************************************************************************/
+static bool mlpeparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,mlpeparallelwork);
+#endif
+    return result;
+}
 
 
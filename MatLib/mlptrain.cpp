@@ -41,6 +41,8 @@ static void mlpkfoldsplit(const ap::real_2d_array& xy,
      int foldscount,
      bool stratifiedsplits,
      ap::integer_1d_array& folds);
+static void mlptrainrandomize(multilayerperceptron& network,
+     hqrndstate& state);
 
 /*************************************************************************
 Neural network training  using  modified  Levenberg-Marquardt  with  exact
@@ -80,6 +82,27 @@ void mlptrainlm(multilayerperceptron& network,
      int restarts,
      int& info,
      mlpreport& rep)
+{
+    hqrndstate rs;
+
+    hqrndrandomize(rs);
+    mlptrainlminternal(network, xy, npoints, decay, restarts, rs, info, rep);
+}
+
+
+/*************************************************************************
+Internal subroutine: same as MLPTrainLM, but random initial
+weights are taken from the RS generator, so several networks may be
+trained at once.
+*************************************************************************/
+void mlptrainlminternal(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int npoints,
+     double decay,
+     int restarts,
+     hqrndstate& rs,
+     int& info,
+     mlpreport& rep)
 {
     int nin;
     int nout;
@@ -178,7 +201,7 @@ void mlptrainlm(multilayerperceptron& network,
         //
         // Initialize weights
         //
-        mlprandomize(network);
+        mlptrainrandomize(network, rs);
         
         //
         // First stage of the hybrid algorithm: LBFGS
@@ -433,6 +456,29 @@ void mlptrainlbfgs(multilayerperceptron& network,
      int maxits,
      int& info,
      mlpreport& rep)
+{
+    hqrndstate rs;
+
+    hqrndrandomize(rs);
+    mlptrainlbfgsinternal(network, xy, npoints, decay, restarts, wstep, maxits, rs, info, rep);
+}
+
+
+/*************************************************************************
+Internal subroutine: same as MLPTrainLBFGS, but random initial
+weights are taken from the RS generator, so several networks may be
+trained at once.
+*************************************************************************/
+void mlptrainlbfgsinternal(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int npoints,
+     double decay,
+     int restarts,
+     double wstep,
+     int maxits,
+     hqrndstate& rs,
+     int& info,
+     mlpreport& rep)
 {
     int i;
     int pass;
@@ -496,7 +542,7 @@ void mlptrainlbfgs(multilayerperceptron& network,
         //
         // Process
         //
-        mlprandomize(network);
+        mlptrainrandomize(network, rs);
         ap::vmove(&w(0), 1, &network.weights(0), 1, ap::vlen(0,wcount-1));
         minlbfgscreate(wcount, ap::minint(wcount, 10), w, state);
         minlbfgssetcond(state, 0.0, 0.0, wstep, maxits);
@@ -582,6 +628,29 @@ void mlptraines(multilayerperceptron& network,
      int restarts,
      int& info,
      mlpreport& rep)
+{
+    hqrndstate rs;
+
+    hqrndrandomize(rs);
+    mlptrainesinternal(network, trnxy, trnsize, valxy, valsize, decay, restarts, rs, info, rep);
+}
+
+
+/*************************************************************************
+Internal subroutine: same as MLPTrainES, but random initial
+weights are taken from the RS generator, so several networks may be
+trained at once.
+*************************************************************************/
+void mlptrainesinternal(multilayerperceptron& network,
+     const ap::real_2d_array& trnxy,
+     int trnsize,
+     const ap::real_2d_array& valxy,
+     int valsize,
+     double decay,
+     int restarts,
+     hqrndstate& rs,
+     int& info,
+     mlpreport& rep)
 {
     int i;
     int pass;
@@ -657,7 +726,7 @@ void mlptraines(multilayerperceptron& network,
         //
         // Process
         //
-        mlprandomize(network);
+        mlptrainrandomize(network, rs);
         ebest = mlperror(network, valxy, valsize);
         ap::vmove(&wbest(0), 1, &network.weights(0), 1, ap::vlen(0,wcount-1));
         itbest = 0;
@@ -689,9 +758,9 @@ void mlptraines(multilayerperceptron& network,
                 {
                     ebest = e;
                     ap::vmove(&wbest(0), 1, &network.weights(0), 1, ap::vlen(0,wcount-1));
-                    itbest = internalrep.iterationscount;
+                    itbest = state.repiterationscount;
                 }
-                if( internalrep.iterationscount>30&&ap::fp_greater(internalrep.iterationscount,1.5*itbest) )
+                if( state.repiterationscount>30&&ap::fp_greater(state.repiterationscount,1.5*itbest) )
                 {
                     info = 6;
                     break;
@@ -1045,5 +1114,23 @@ static void mlpkfoldsplit(const ap::real_2d_array& xy,
 }
 
 
+/*************************************************************************
+Randomization of neural network weights, same as MLPRandomize, but  with
+the given random number generator.
+*************************************************************************/
+static void mlptrainrandomize(multilayerperceptron& network,
+     hqrndstate& state)
+{
+    int i;
+    int nin;
+    int nout;
+    int wcount;
+
+    mlpproperties(network, nin, nout, wcount);
+    for(i = 0; i <= wcount-1; i++)
+    {
+        network.weights(i) = hqrnduniformr(state)-0.5;
+    }
+}
 
 
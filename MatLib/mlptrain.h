@@ -299,5 +299,54 @@ void mlpkfoldcvlm(const multilayerperceptron& network,
      mlpcvreport& cvrep);
 
 
+/*************************************************************************
+Internal subroutine: same as MLPTrainLM, but random initial
+weights are taken from the RS generator, so several networks may be
+trained at once.
+*************************************************************************/
+void mlptrainlminternal(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int npoints,
+     double decay,
+     int restarts,
+     hqrndstate& rs,
+     int& info,
+     mlpreport& rep);
+
+
+/*************************************************************************
+Internal subroutine: same as MLPTrainLBFGS, but random initial
+weights are taken from the RS generator, so several networks may be
+trained at once.
+*************************************************************************/
+void mlptrainlbfgsinternal(multilayerperceptron& network,
+     const ap::real_2d_array& xy,
+     int npoints,
+     double decay,
+     int restarts,
+     double wstep,
+     int maxits,
+     hqrndstate& rs,
+     int& info,
+     mlpreport& rep);
+
+
+/*************************************************************************
+Internal subroutine: same as MLPTrainES, but random initial
+weights are taken from the RS generator, so several networks may be
+trained at once.
+*************************************************************************/
+void mlptrainesinternal(multilayerperceptron& network,
+     const ap::real_2d_array& trnxy,
+     int trnsize,
+     const ap::real_2d_array& valxy,
+     int valsize,
+     double decay,
+     int restarts,
+     hqrndstate& rs,
+     int& info,
+     mlpreport& rep);
+
+
 #endif
 
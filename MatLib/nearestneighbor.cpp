@@ -22,6 +22,8 @@ http://www.fsf.org/licensing/licenses
 #include "nearestneighbor.h"
 
 static const int splitnodesize = 6;
+static const int leafmaxsize = 8;
+static const int batchminsize = 256;
 
 static void kdtreesplit(kdtree& kdt, int i1, int i2, int d, double s, int& i3);
 static void kdtreegeneratetreerec(kdtree& kdt,
@@ -30,8 +32,18 @@ static void kdtreegeneratetreerec(kdtree& kdt,
      int i1,
      int i2,
      int maxleafsize);
-static void kdtreequerynnrec(kdtree& kdt, int offs);
-static void kdtreeinitbox(kdtree& kdt, const ap::real_1d_array& x);
+static void kdtreecheckrequestbuffer(const kdtree& kdt,
+     kdtreerequestbuffer& buf);
+static void kdtreequerynnrec(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     int offs);
+static void kdtreeleafdistances(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     int i1,
+     int cnt);
+static void kdtreeinitbox(const kdtree& kdt,
+     const ap::real_1d_array& x,
+     kdtreerequestbuffer& buf);
 static double vrootfreenorm(const ap::real_1d_array& x, int n, int normtype);
 static double vrootfreecomponentnorm(double x, int normtype);
 static double vrangedist(double x, double a, double b);
@@ -158,12 +170,11 @@ void kdtreebuildtagged(const ap::real_2d_array& xy,
     kdt.ny = ny;
     kdt.normtype = normtype;
     kdt.distmatrixtype = 0;
+    kdt.layout = 0;
+    kdt.soax.setlength(0);
     kdt.xy.setlength(n, 2*nx+ny);
     kdt.tags.setlength(n);
-    kdt.idx.setlength(n);
-    kdt.r.setlength(n);
-    kdt.x.setlength(nx);
-    kdt.buf.setlength(ap::maxint(n, nx));
+    kdtreecreaterequestbuffer(kdt, kdt.innerbuf);
     
     //
     // Initial fill
@@ -180,8 +191,6 @@ void kdtreebuildtagged(const ap::real_2d_array& xy,
     //
     kdt.boxmin.setlength(nx);
     kdt.boxmax.setlength(nx);
-    kdt.curboxmin.setlength(nx);
-    kdt.curboxmax.setlength(nx);
     ap::vmove(&kdt.boxmin(0), 1, &kdt.xy(0, 0), 1, ap::vlen(0,nx-1));
     ap::vmove(&kdt.boxmax(0), 1, &kdt.xy(0, 0), 1, ap::vlen(0,nx-1));
     for(i = 1; i <= n-1; i++)
@@ -203,14 +212,122 @@ void kdtreebuildtagged(const ap::real_2d_array& xy,
     kdt.splits.setlength(2*maxnodes);
     nodesoffs = 0;
     splitsoffs = 0;
-    ap::vmove(&kdt.curboxmin(0), 1, &kdt.boxmin(0), 1, ap::vlen(0,nx-1));
-    ap::vmove(&kdt.curboxmax(0), 1, &kdt.boxmax(0), 1, ap::vlen(0,nx-1));
-    kdtreegeneratetreerec(kdt, nodesoffs, splitsoffs, 0, n, 8);
+    ap::vmove(&kdt.innerbuf.curboxmin(0), 1, &kdt.boxmin(0), 1, ap::vlen(0,nx-1));
+    ap::vmove(&kdt.innerbuf.curboxmax(0), 1, &kdt.boxmax(0), 1, ap::vlen(0,nx-1));
+    kdtreegeneratetreerec(kdt, nodesoffs, splitsoffs, 0, n, leafmaxsize);
     
     //
     // Set current query size to 0
     //
-    kdt.kcur = 0;
+    kdt.innerbuf.kcur = 0;
+}
+
+
+/*************************************************************************
+KD-tree creation, flat layout
+
+Same as KDTreeBuildTagged(), but nodes are stored in breadth-first order
+and X-values of each leaf are stored column-wise in SoaX[]:  X-values  of
+leaf [I1,I1+Cnt) take SoaX[NX*I1..NX*(I1+Cnt)-1], J-th coordinate of all
+points of the leaf being at SoaX[NX*I1+J*Cnt..NX*I1+(J+1)*Cnt-1].
+*************************************************************************/
+void kdtreebuildtaggedflat(const ap::real_2d_array& xy,
+     const ap::integer_1d_array& tags,
+     int n,
+     int nx,
+     int ny,
+     int normtype,
+     kdtree& kdt)
+{
+    ap::integer_1d_array nodes;
+    ap::real_1d_array splits;
+    ap::integer_1d_array queue;
+    ap::integer_1d_array newoffs;
+    int qhead;
+    int qtail;
+    int offs;
+    int o;
+    int splitsoffs;
+    int i;
+    int j;
+    int t;
+    int i1;
+    int cnt;
+
+    kdtreebuildtagged(xy, tags, n, nx, ny, normtype, kdt);
+    
+    //
+    // Breadth-first traversal:
+    // * Queue[] gets offsets of nodes in breadth-first order
+    // * NewOffs[] maps old offsets to new ones
+    //
+    // There are at most N leaves and N-1 split nodes.
+    //
+    queue.setlength(2*n);
+    newoffs.setlength(kdt.nodes.gethighbound()+1);
+    queue(0) = 0;
+    qhead = 0;
+    qtail = 1;
+    offs = 0;
+    while(qhead<qtail)
+    {
+        o = queue(qhead);
+        qhead = qhead+1;
+        newoffs(o) = offs;
+        if( kdt.nodes(o)>0 )
+        {
+            offs = offs+2;
+        }
+        else
+        {
+            offs = offs+splitnodesize;
+            queue(qtail+0) = kdt.nodes(o+3);
+            queue(qtail+1) = kdt.nodes(o+4);
+            qtail = qtail+2;
+        }
+    }
+    
+    //
+    // Copy nodes to their new places, splits are renumbered
+    // in the same order. Leaves are copied to SoaX[].
+    //
+    nodes.setlength(kdt.nodes.gethighbound()+1);
+    splits.setlength(kdt.splits.gethighbound()+1);
+    kdt.soax.setlength(n*nx);
+    splitsoffs = 0;
+    for(i = 0; i <= qtail-1; i++)
+    {
+        o = queue(i);
+        offs = newoffs(o);
+        if( kdt.nodes(o)>0 )
+        {
+            cnt = kdt.nodes(o);
+            i1 = kdt.nodes(o+1);
+            nodes(offs+0) = cnt;
+            nodes(offs+1) = i1;
+            for(j = 0; j <= nx-1; j++)
+            {
+                for(t = 0; t <= cnt-1; t++)
+                {
+                    kdt.soax(nx*i1+j*cnt+t) = kdt.xy(i1+t,j);
+                }
+            }
+        }
+        else
+        {
+            nodes(offs+0) = 0;
+            nodes(offs+1) = kdt.nodes(o+1);
+            nodes(offs+2) = splitsoffs;
+            nodes(offs+3) = newoffs(kdt.nodes(o+3));
+            nodes(offs+4) = newoffs(kdt.nodes(o+4));
+            nodes(offs+5) = 0;
+            splits(splitsoffs) = kdt.splits(kdt.nodes(o+2));
+            splitsoffs = splitsoffs+1;
+        }
+    }
+    kdt.nodes = nodes;
+    kdt.splits = splits;
+    kdt.layout = 1;
 }
 
 
@@ -286,53 +403,8 @@ int kdtreequeryrnn(kdtree& kdt,
      bool selfmatch)
 {
     int result;
-    int i;
-    int j;
-    double vx;
-    double vmin;
-    double vmax;
 
-    ap::ap_error::make_assertion(ap::fp_greater(r,0), "KDTreeQueryRNN: incorrect R!");
-    
-    //
-    // Prepare parameters
-    //
-    kdt.kneeded = 0;
-    if( kdt.normtype!=2 )
-    {
-        kdt.rneeded = r;
-    }
-    else
-    {
-        kdt.rneeded = ap::sqr(r);
-    }
-    kdt.selfmatch = selfmatch;
-    kdt.approxf = 1;
-    kdt.kcur = 0;
-    
-    //
-    // calculate distance from point to current bounding box
-    //
-    kdtreeinitbox(kdt, x);
-    
-    //
-    // call recursive search
-    // results are returned as heap
-    //
-    kdtreequerynnrec(kdt, 0);
-    
-    //
-    // pop from heap to generate ordered representation
-    //
-    // last element is non pop'ed because it is already in
-    // its place
-    //
-    result = kdt.kcur;
-    j = kdt.kcur;
-    for(i = kdt.kcur; i >= 2; i--)
-    {
-        tagheappopi(kdt.r, kdt.idx, j);
-    }
+    result = kdtreetsqueryrnn(kdt, kdt.innerbuf, x, r, selfmatch);
     return result;
 }
 
@@ -378,55 +450,8 @@ int kdtreequeryaknn(kdtree& kdt,
      double eps)
 {
     int result;
-    int i;
-    int j;
-    double vx;
-    double vmin;
-    double vmax;
 
-    ap::ap_error::make_assertion(k>0, "KDTreeQueryKNN: incorrect K!");
-    ap::ap_error::make_assertion(ap::fp_greater_eq(eps,0), "KDTreeQueryKNN: incorrect Eps!");
-    
-    //
-    // Prepare parameters
-    //
-    k = ap::minint(k, kdt.n);
-    kdt.kneeded = k;
-    kdt.rneeded = 0;
-    kdt.selfmatch = selfmatch;
-    if( kdt.normtype==2 )
-    {
-        kdt.approxf = 1/ap::sqr(1+eps);
-    }
-    else
-    {
-        kdt.approxf = 1/(1+eps);
-    }
-    kdt.kcur = 0;
-    
-    //
-    // calculate distance from point to current bounding box
-    //
-    kdtreeinitbox(kdt, x);
-    
-    //
-    // call recursive search
-    // results are returned as heap
-    //
-    kdtreequerynnrec(kdt, 0);
-    
-    //
-    // pop from heap to generate ordered representation
-    //
-    // last element is non pop'ed because it is already in
-    // its place
-    //
-    result = kdt.kcur;
-    j = kdt.kcur;
-    for(i = kdt.kcur; i >= 2; i--)
-    {
-        tagheappopi(kdt.r, kdt.idx, j);
-    }
+    result = kdtreetsqueryaknn(kdt, kdt.innerbuf, x, k, selfmatch, eps);
     return result;
 }
 
@@ -455,13 +480,7 @@ SEE ALSO
 *************************************************************************/
 void kdtreequeryresultsx(const kdtree& kdt, ap::real_2d_array& x, int& k)
 {
-    int i;
-
-    k = kdt.kcur;
-    for(i = 0; i <= k-1; i++)
-    {
-        ap::vmove(&x(i, 0), 1, &kdt.xy(kdt.idx(i), kdt.nx), 1, ap::vlen(0,kdt.nx-1));
-    }
+    kdtreetsqueryresultsx(kdt, kdt.innerbuf, x, k);
 }
 
 
@@ -490,13 +509,7 @@ SEE ALSO
 *************************************************************************/
 void kdtreequeryresultsxy(const kdtree& kdt, ap::real_2d_array& xy, int& k)
 {
-    int i;
-
-    k = kdt.kcur;
-    for(i = 0; i <= k-1; i++)
-    {
-        ap::vmove(&xy(i, 0), 1, &kdt.xy(kdt.idx(i), kdt.nx), 1, ap::vlen(0,kdt.nx+kdt.ny-1));
-    }
+    kdtreetsqueryresultsxy(kdt, kdt.innerbuf, xy, k);
 }
 
 
@@ -527,13 +540,7 @@ void kdtreequeryresultstags(const kdtree& kdt,
      ap::integer_1d_array& tags,
      int& k)
 {
-    int i;
-
-    k = kdt.kcur;
-    for(i = 0; i <= k-1; i++)
-    {
-        tags(i) = kdt.tags(kdt.idx(i));
-    }
+    kdtreetsqueryresultstags(kdt, kdt.innerbuf, tags, k);
 }
 
 
@@ -564,9 +571,324 @@ void kdtreequeryresultsdistances(const kdtree& kdt,
      ap::real_1d_array& r,
      int& k)
 {
+    kdtreetsqueryresultsdistances(kdt, kdt.innerbuf, r, k);
+}
+
+
+/*************************************************************************
+Request buffer for thread-safe queries
+
+Allocates arrays for queries to KDT. One buffer serves any number of
+queries, but only one at a time (one buffer for each thread).
+*************************************************************************/
+void kdtreecreaterequestbuffer(const kdtree& kdt, kdtreerequestbuffer& buf)
+{
+
+    buf.x.setlength(kdt.nx);
+    buf.curboxmin.setlength(kdt.nx);
+    buf.curboxmax.setlength(kdt.nx);
+    buf.idx.setlength(kdt.n);
+    buf.r.setlength(kdt.n);
+    buf.buf.setlength(ap::maxint(kdt.n, kdt.nx));
+    buf.kcur = 0;
+}
+
+
+/*************************************************************************
+K-NN query: K nearest neighbors, thread-safe version
+
+Same as KDTreeQueryKNN(), but query state and results are stored in Buf,
+which must be created with KDTreeCreateRequestBuffer(). KDT is  not
+modified, so different threads may query the same tree, each one  with
+its own buffer.
+
+Results are obtained with KDTreeTsQueryResultsX(), KDTreeTsQueryResultsXY(),
+KDTreeTsQueryResultsTags() and KDTreeTsQueryResultsDistances().
+*************************************************************************/
+int kdtreetsqueryknn(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     const ap::real_1d_array& x,
+     int k,
+     bool selfmatch)
+{
+    int result;
+
+    result = kdtreetsqueryaknn(kdt, buf, x, k, selfmatch, 0.0);
+    return result;
+}
+
+
+/*************************************************************************
+R-NN query: all points within R-sphere centered at X, thread-safe version
+
+See KDTreeQueryRNN() and KDTreeTsQueryKNN().
+*************************************************************************/
+int kdtreetsqueryrnn(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     const ap::real_1d_array& x,
+     double r,
+     bool selfmatch)
+{
+    int result;
     int i;
+    int j;
 
-    k = kdt.kcur;
+    ap::ap_error::make_assertion(ap::fp_greater(r,0), "KDTreeTsQueryRNN: incorrect R!");
+    
+    //
+    // Prepare parameters
+    //
+    kdtreecheckrequestbuffer(kdt, buf);
+    buf.kneeded = 0;
+    if( kdt.normtype!=2 )
+    {
+        buf.rneeded = r;
+    }
+    else
+    {
+        buf.rneeded = ap::sqr(r);
+    }
+    buf.selfmatch = selfmatch;
+    buf.approxf = 1;
+    buf.kcur = 0;
+    
+    //
+    // calculate distance from point to current bounding box
+    //
+    kdtreeinitbox(kdt, x, buf);
+    
+    //
+    // call recursive search
+    // results are returned as heap
+    //
+    kdtreequerynnrec(kdt, buf, 0);
+    
+    //
+    // pop from heap to generate ordered representation
+    //
+    // last element is non pop'ed because it is already in
+    // its place
+    //
+    result = buf.kcur;
+    j = buf.kcur;
+    for(i = buf.kcur; i >= 2; i--)
+    {
+        tagheappopi(buf.r, buf.idx, j);
+    }
+    return result;
+}
+
+
+/*************************************************************************
+K-NN query: approximate K nearest neighbors, thread-safe version
+
+See KDTreeQueryAKNN() and KDTreeTsQueryKNN().
+*************************************************************************/
+int kdtreetsqueryaknn(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     const ap::real_1d_array& x,
+     int k,
+     bool selfmatch,
+     double eps)
+{
+    int result;
+    int i;
+    int j;
+
+    ap::ap_error::make_assertion(k>0, "KDTreeTsQueryAKNN: incorrect K!");
+    ap::ap_error::make_assertion(ap::fp_greater_eq(eps,0), "KDTreeTsQueryAKNN: incorrect Eps!");
+    
+    //
+    // Prepare parameters
+    //
+    kdtreecheckrequestbuffer(kdt, buf);
+    k = ap::minint(k, kdt.n);
+    buf.kneeded = k;
+    buf.rneeded = 0;
+    buf.selfmatch = selfmatch;
+    if( kdt.normtype==2 )
+    {
+        buf.approxf = 1/ap::sqr(1+eps);
+    }
+    else
+    {
+        buf.approxf = 1/(1+eps);
+    }
+    buf.kcur = 0;
+    
+    //
+    // calculate distance from point to current bounding box
+    //
+    kdtreeinitbox(kdt, x, buf);
+    
+    //
+    // call recursive search
+    // results are returned as heap
+    //
+    kdtreequerynnrec(kdt, buf, 0);
+    
+    //
+    // pop from heap to generate ordered representation
+    //
+    // last element is non pop'ed because it is already in
+    // its place
+    //
+    result = buf.kcur;
+    j = buf.kcur;
+    for(i = buf.kcur; i >= 2; i--)
+    {
+        tagheappopi(buf.r, buf.idx, j);
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Batch of K-NN queries
+
+Finds K nearest neighbors of each row of X[0..M-1,0..NX-1]. Queries are
+split between OpenMP threads (when compiled with OpenMP support),  each
+thread having its own request buffer, so the tree itself is shared  and
+not modified.
+
+OUTPUT PARAMETERS
+    Cnt         -   array[0..M-1], number of neighbors found for each point
+    Tags        -   array[0..M-1,0..min(K,N)-1], first Cnt[I] elements  of
+                    I-th row are tags of neighbors of X[I],  ordered  by
+                    distance (first = closest)
+    R           -   array[0..M-1,0..min(K,N)-1], distances to neighbors
+*************************************************************************/
+void kdtreequeryknnbatch(const kdtree& kdt,
+     const ap::real_2d_array& x,
+     int m,
+     int k,
+     bool selfmatch,
+     ap::integer_1d_array& cnt,
+     ap::integer_2d_array& tags,
+     ap::real_2d_array& r)
+{
+    int kk;
+
+    ap::ap_error::make_assertion(m>=0, "KDTreeQueryKNNBatch: M<0!");
+    ap::ap_error::make_assertion(k>0, "KDTreeQueryKNNBatch: incorrect K!");
+    if( m==0 )
+    {
+        return;
+    }
+    kk = ap::minint(k, kdt.n);
+    cnt.setlength(m);
+    tags.setlength(m, kk);
+    r.setlength(m, kk);
+    
+    //
+    // Small batches are not worth starting threads:
+    // * each thread needs O(N) request buffer
+    // * each query takes about O(K*logN) operations
+    //
+    #pragma omp parallel if( m>=batchminsize )
+    {
+        kdtreerequestbuffer buf;
+        ap::real_1d_array xi;
+        ap::real_1d_array ri;
+        ap::integer_1d_array ti;
+        int i;
+        int j;
+        int c;
+
+        kdtreecreaterequestbuffer(kdt, buf);
+        xi.setlength(kdt.nx);
+        ri.setlength(kk);
+        ti.setlength(kk);
+        #pragma omp for schedule(dynamic,64)
+        for(i = 0; i <= m-1; i++)
+        {
+            ap::vmove(&xi(0), 1, &x(i, 0), 1, ap::vlen(0,kdt.nx-1));
+            cnt(i) = kdtreetsqueryknn(kdt, buf, xi, kk, selfmatch);
+            kdtreetsqueryresultstags(kdt, buf, ti, c);
+            kdtreetsqueryresultsdistances(kdt, buf, ri, c);
+            for(j = 0; j <= c-1; j++)
+            {
+                tags(i,j) = ti(j);
+                r(i,j) = ri(j);
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+X-values from last query made with request buffer Buf
+
+See KDTreeQueryResultsX()
+*************************************************************************/
+void kdtreetsqueryresultsx(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::real_2d_array& x,
+     int& k)
+{
+    int i;
+
+    k = buf.kcur;
+    for(i = 0; i <= k-1; i++)
+    {
+        ap::vmove(&x(i, 0), 1, &kdt.xy(buf.idx(i), kdt.nx), 1, ap::vlen(0,kdt.nx-1));
+    }
+}
+
+
+/*************************************************************************
+X- and Y-values from last query made with request buffer Buf
+
+See KDTreeQueryResultsXY()
+*************************************************************************/
+void kdtreetsqueryresultsxy(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::real_2d_array& xy,
+     int& k)
+{
+    int i;
+
+    k = buf.kcur;
+    for(i = 0; i <= k-1; i++)
+    {
+        ap::vmove(&xy(i, 0), 1, &kdt.xy(buf.idx(i), kdt.nx), 1, ap::vlen(0,kdt.nx+kdt.ny-1));
+    }
+}
+
+
+/*************************************************************************
+Point tags from last query made with request buffer Buf
+
+See KDTreeQueryResultsTags()
+*************************************************************************/
+void kdtreetsqueryresultstags(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::integer_1d_array& tags,
+     int& k)
+{
+    int i;
+
+    k = buf.kcur;
+    for(i = 0; i <= k-1; i++)
+    {
+        tags(i) = kdt.tags(buf.idx(i));
+    }
+}
+
+
+/*************************************************************************
+Distances from last query made with request buffer Buf
+
+See KDTreeQueryResultsDistances()
+*************************************************************************/
+void kdtreetsqueryresultsdistances(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::real_1d_array& r,
+     int& k)
+{
+    int i;
+
+    k = buf.kcur;
     
     //
     // unload norms
@@ -578,26 +900,40 @@ void kdtreequeryresultsdistances(const kdtree& kdt,
     {
         for(i = 0; i <= k-1; i++)
         {
-            r(i) = fabs(kdt.r(i));
+            r(i) = fabs(buf.r(i));
         }
     }
     if( kdt.normtype==1 )
     {
         for(i = 0; i <= k-1; i++)
         {
-            r(i) = fabs(kdt.r(i));
+            r(i) = fabs(buf.r(i));
         }
     }
     if( kdt.normtype==2 )
     {
         for(i = 0; i <= k-1; i++)
         {
-            r(i) = sqrt(fabs(kdt.r(i)));
+            r(i) = sqrt(fabs(buf.r(i)));
         }
     }
 }
 
 
+/*************************************************************************
+Reallocates Buf when it was created for another tree (different N or NX).
+*************************************************************************/
+static void kdtreecheckrequestbuffer(const kdtree& kdt,
+     kdtreerequestbuffer& buf)
+{
+
+    if( buf.x.gethighbound()!=kdt.nx-1||buf.idx.gethighbound()!=kdt.n-1 )
+    {
+        kdtreecreaterequestbuffer(kdt, buf);
+    }
+}
+
+
 /*************************************************************************
 Rearranges nodes [I1,I2) using partition in D-th dimension with S as threshold.
 Returns split position I3: [I1,I3) and [I3,I2) are created as result.
@@ -735,10 +1071,10 @@ static void kdtreegeneratetreerec(kdtree& kdt,
     // * D is a dimension number
     //
     d = 0;
-    ds = kdt.curboxmax(0)-kdt.curboxmin(0);
+    ds = kdt.innerbuf.curboxmax(0)-kdt.innerbuf.curboxmin(0);
     for(i = 1; i <= nx-1; i++)
     {
-        v = kdt.curboxmax(i)-kdt.curboxmin(i);
+        v = kdt.innerbuf.curboxmax(i)-kdt.innerbuf.curboxmin(i);
         if( ap::fp_greater(v,ds) )
         {
             ds = v;
@@ -750,18 +1086,18 @@ static void kdtreegeneratetreerec(kdtree& kdt,
     // Select split position S using sliding midpoint rule,
     // rearrange points into [I1,I3) and [I3,I2)
     //
-    s = kdt.curboxmin(d)+0.5*ds;
-    ap::vmove(&kdt.buf(0), 1, &kdt.xy(i1, d), kdt.xy.getstride(), ap::vlen(0,i2-i1-1));
+    s = kdt.innerbuf.curboxmin(d)+0.5*ds;
+    ap::vmove(&kdt.innerbuf.buf(0), 1, &kdt.xy(i1, d), kdt.xy.getstride(), ap::vlen(0,i2-i1-1));
     n = i2-i1;
     cntless = 0;
     cntgreater = 0;
-    minv = kdt.buf(0);
-    maxv = kdt.buf(0);
+    minv = kdt.innerbuf.buf(0);
+    maxv = kdt.innerbuf.buf(0);
     minidx = i1;
     maxidx = i1;
     for(i = 0; i <= n-1; i++)
     {
-        v = kdt.buf(i);
+        v = kdt.innerbuf.buf(i);
         if( ap::fp_less(v,minv) )
         {
             minv = v;
@@ -861,15 +1197,15 @@ static void kdtreegeneratetreerec(kdtree& kdt,
     // * restore CurBox
     //
     kdt.nodes(oldoffs+3) = nodesoffs;
-    v = kdt.curboxmax(d);
-    kdt.curboxmax(d) = s;
+    v = kdt.innerbuf.curboxmax(d);
+    kdt.innerbuf.curboxmax(d) = s;
     kdtreegeneratetreerec(kdt, nodesoffs, splitsoffs, i1, i3, maxleafsize);
-    kdt.curboxmax(d) = v;
+    kdt.innerbuf.curboxmax(d) = v;
     kdt.nodes(oldoffs+4) = nodesoffs;
-    v = kdt.curboxmin(d);
-    kdt.curboxmin(d) = s;
+    v = kdt.innerbuf.curboxmin(d);
+    kdt.innerbuf.curboxmin(d) = s;
     kdtreegeneratetreerec(kdt, nodesoffs, splitsoffs, i3, i2, maxleafsize);
-    kdt.curboxmin(d) = v;
+    kdt.innerbuf.curboxmin(d) = v;
 }
 
 
@@ -879,14 +1215,14 @@ Recursive subroutine for NN queries.
   -- ALGLIB --
      Copyright 28.02.2010 by Bochkanov Sergey
 *************************************************************************/
-static void kdtreequerynnrec(kdtree& kdt, int offs)
+static void kdtreequerynnrec(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     int offs)
 {
     double ptdist;
     int i;
-    int j;
     int k;
     int ti;
-    int nx;
     int i1;
     int i2;
     int k1;
@@ -914,40 +1250,15 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
     {
         i1 = kdt.nodes(offs+1);
         i2 = i1+kdt.nodes(offs);
+        kdtreeleafdistances(kdt, buf, i1, i2-i1);
         for(i = i1; i <= i2-1; i++)
         {
-            
-            //
-            // Calculate distance
-            //
-            ptdist = 0;
-            nx = kdt.nx;
-            if( kdt.normtype==0 )
-            {
-                for(j = 0; j <= nx-1; j++)
-                {
-                    ptdist = ap::maxreal(ptdist, fabs(kdt.xy(i,j)-kdt.x(j)));
-                }
-            }
-            if( kdt.normtype==1 )
-            {
-                for(j = 0; j <= nx-1; j++)
-                {
-                    ptdist = ptdist+fabs(kdt.xy(i,j)-kdt.x(j));
-                }
-            }
-            if( kdt.normtype==2 )
-            {
-                for(j = 0; j <= nx-1; j++)
-                {
-                    ptdist = ptdist+ap::sqr(kdt.xy(i,j)-kdt.x(j));
-                }
-            }
+            ptdist = buf.buf(i-i1);
             
             //
             // Skip points with zero distance if self-matches are turned off
             //
-            if( ap::fp_eq(ptdist,0)&&!kdt.selfmatch )
+            if( ap::fp_eq(ptdist,0)&&!buf.selfmatch )
             {
                 continue;
             }
@@ -956,7 +1267,7 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
             // We CAN'T process point if R-criterion isn't satisfied,
             // i.e. (RNeeded<>0) AND (PtDist>R).
             //
-            if( ap::fp_eq(kdt.rneeded,0)||ap::fp_less_eq(ptdist,kdt.rneeded) )
+            if( ap::fp_eq(buf.rneeded,0)||ap::fp_less_eq(ptdist,buf.rneeded) )
             {
                 
                 //
@@ -965,13 +1276,13 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
                 //   (or skip, if worst point is better)
                 // * add point without replacement otherwise
                 //
-                if( kdt.kcur<kdt.kneeded||kdt.kneeded==0 )
+                if( buf.kcur<buf.kneeded||buf.kneeded==0 )
                 {
                     
                     //
                     // add current point to heap without replacement
                     //
-                    tagheappushi(kdt.r, kdt.idx, kdt.kcur, ptdist, i);
+                    tagheappushi(buf.r, buf.idx, buf.kcur, ptdist, i);
                 }
                 else
                 {
@@ -980,16 +1291,16 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
                     // New points are added or not, depending on their distance.
                     // If added, they replace element at the top of the heap
                     //
-                    if( ap::fp_less(ptdist,kdt.r(0)) )
+                    if( ap::fp_less(ptdist,buf.r(0)) )
                     {
-                        if( kdt.kneeded==1 )
+                        if( buf.kneeded==1 )
                         {
-                            kdt.idx(0) = i;
-                            kdt.r(0) = ptdist;
+                            buf.idx(0) = i;
+                            buf.r(0) = ptdist;
                         }
                         else
                         {
-                            tagheapreplacetopi(kdt.r, kdt.idx, kdt.kneeded, ptdist, i);
+                            tagheapreplacetopi(buf.r, buf.idx, buf.kneeded, ptdist, i);
                         }
                     }
                 }
@@ -1017,7 +1328,7 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
         // * ChildBestOffs      child box with best chances
         // * ChildWorstOffs     child box with worst chances
         //
-        if( ap::fp_less_eq(kdt.x(d),s) )
+        if( ap::fp_less_eq(buf.x(d),s) )
         {
             childbestoffs = kdt.nodes(offs+3);
             childworstoffs = kdt.nodes(offs+4);
@@ -1058,59 +1369,59 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
             //
             if( updatemin )
             {
-                prevdist = kdt.curdist;
-                t1 = kdt.x(d);
-                v = kdt.curboxmin(d);
+                prevdist = buf.curdist;
+                t1 = buf.x(d);
+                v = buf.curboxmin(d);
                 if( ap::fp_less_eq(t1,s) )
                 {
                     if( kdt.normtype==0 )
                     {
-                        kdt.curdist = ap::maxreal(kdt.curdist, s-t1);
+                        buf.curdist = ap::maxreal(buf.curdist, s-t1);
                     }
                     if( kdt.normtype==1 )
                     {
-                        kdt.curdist = kdt.curdist-ap::maxreal(v-t1, double(0))+s-t1;
+                        buf.curdist = buf.curdist-ap::maxreal(v-t1, double(0))+s-t1;
                     }
                     if( kdt.normtype==2 )
                     {
-                        kdt.curdist = kdt.curdist-ap::sqr(ap::maxreal(v-t1, double(0)))+ap::sqr(s-t1);
+                        buf.curdist = buf.curdist-ap::sqr(ap::maxreal(v-t1, double(0)))+ap::sqr(s-t1);
                     }
                 }
-                kdt.curboxmin(d) = s;
+                buf.curboxmin(d) = s;
             }
             else
             {
-                prevdist = kdt.curdist;
-                t1 = kdt.x(d);
-                v = kdt.curboxmax(d);
+                prevdist = buf.curdist;
+                t1 = buf.x(d);
+                v = buf.curboxmax(d);
                 if( ap::fp_greater_eq(t1,s) )
                 {
                     if( kdt.normtype==0 )
                     {
-                        kdt.curdist = ap::maxreal(kdt.curdist, t1-s);
+                        buf.curdist = ap::maxreal(buf.curdist, t1-s);
                     }
                     if( kdt.normtype==1 )
                     {
-                        kdt.curdist = kdt.curdist-ap::maxreal(t1-v, double(0))+t1-s;
+                        buf.curdist = buf.curdist-ap::maxreal(t1-v, double(0))+t1-s;
                     }
                     if( kdt.normtype==2 )
                     {
-                        kdt.curdist = kdt.curdist-ap::sqr(ap::maxreal(t1-v, double(0)))+ap::sqr(t1-s);
+                        buf.curdist = buf.curdist-ap::sqr(ap::maxreal(t1-v, double(0)))+ap::sqr(t1-s);
                     }
                 }
-                kdt.curboxmax(d) = s;
+                buf.curboxmax(d) = s;
             }
             
             //
             // Decide: to dive into cell or not to dive
             //
-            if( ap::fp_neq(kdt.rneeded,0)&&ap::fp_greater(kdt.curdist,kdt.rneeded) )
+            if( ap::fp_neq(buf.rneeded,0)&&ap::fp_greater(buf.curdist,buf.rneeded) )
             {
                 todive = false;
             }
             else
             {
-                if( kdt.kcur<kdt.kneeded||kdt.kneeded==0 )
+                if( buf.kcur<buf.kneeded||buf.kneeded==0 )
                 {
                     
                     //
@@ -1125,12 +1436,12 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
                     // KCur=KNeeded, decide to dive or not to dive
                     // using point position relative to bounding box.
                     //
-                    todive = ap::fp_less_eq(kdt.curdist,kdt.r(0)*kdt.approxf);
+                    todive = ap::fp_less_eq(buf.curdist,buf.r(0)*buf.approxf);
                 }
             }
             if( todive )
             {
-                kdtreequerynnrec(kdt, childoffs);
+                kdtreequerynnrec(kdt, buf, childoffs);
             }
             
             //
@@ -1138,28 +1449,123 @@ static void kdtreequerynnrec(kdtree& kdt, int offs)
             //
             if( updatemin )
             {
-                kdt.curboxmin(d) = v;
+                buf.curboxmin(d) = v;
             }
             else
             {
-                kdt.curboxmax(d) = v;
+                buf.curboxmax(d) = v;
+            }
+            buf.curdist = prevdist;
+        }
+        return;
+    }
+}
+
+
+/*************************************************************************
+Root-free distances from Buf.X[] to points [I1,I1+Cnt) of a leaf,
+stored in Buf.Buf[0..Cnt-1].
+*************************************************************************/
+static void kdtreeleafdistances(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     int i1,
+     int cnt)
+{
+    int i;
+    int j;
+    int nx;
+    double ptdist;
+    double v;
+    double t;
+    const double *px;
+    const double *x;
+    double *d;
+
+    nx = kdt.nx;
+    if( kdt.layout==0 )
+    {
+        for(i = 0; i <= cnt-1; i++)
+        {
+            ptdist = 0;
+            if( kdt.normtype==0 )
+            {
+                for(j = 0; j <= nx-1; j++)
+                {
+                    ptdist = ap::maxreal(ptdist, fabs(kdt.xy(i1+i,j)-buf.x(j)));
+                }
+            }
+            if( kdt.normtype==1 )
+            {
+                for(j = 0; j <= nx-1; j++)
+                {
+                    ptdist = ptdist+fabs(kdt.xy(i1+i,j)-buf.x(j));
+                }
+            }
+            if( kdt.normtype==2 )
+            {
+                for(j = 0; j <= nx-1; j++)
+                {
+                    ptdist = ptdist+ap::sqr(kdt.xy(i1+i,j)-buf.x(j));
+                }
             }
-            kdt.curdist = prevdist;
+            buf.buf(i) = ptdist;
         }
         return;
     }
+    
+    //
+    // Flat layout: J-th coordinates of the points are contiguous,
+    // inner loops have unit stride and no calls
+    //
+    px = kdt.soax.getcontent()+nx*i1;
+    x = buf.x.getcontent();
+    d = buf.buf.getcontent();
+    for(i = 0; i <= cnt-1; i++)
+    {
+        d[i] = 0;
+    }
+    for(j = 0; j <= nx-1; j++)
+    {
+        v = x[j];
+        if( kdt.normtype==0 )
+        {
+            for(i = 0; i <= cnt-1; i++)
+            {
+                t = fabs(px[i]-v);
+                d[i] = t>d[i] ? t : d[i];
+            }
+        }
+        if( kdt.normtype==1 )
+        {
+            for(i = 0; i <= cnt-1; i++)
+            {
+                d[i] = d[i]+fabs(px[i]-v);
+            }
+        }
+        if( kdt.normtype==2 )
+        {
+            for(i = 0; i <= cnt-1; i++)
+            {
+                t = px[i]-v;
+                d[i] = d[i]+t*t;
+            }
+        }
+        px = px+cnt;
+    }
 }
 
 
 /*************************************************************************
-Copies X[] to KDT.X[]
+Copies X[] to Buf.X[]
 Loads distance from X[] to bounding box.
 Initializes CurBox[].
 
   -- ALGLIB --
      Copyright 28.02.2010 by Bochkanov Sergey
 *************************************************************************/
-static void kdtreeinitbox(kdtree& kdt, const ap::real_1d_array& x)
+static void kdtreeinitbox(const kdtree& kdt,
+     const ap::real_1d_array& x,
+     kdtreerequestbuffer& buf)
 {
     int i;
     double vx;
@@ -1170,7 +1576,7 @@ static void kdtreeinitbox(kdtree& kdt, const ap::real_1d_array& x)
     //
     // calculate distance from point to current bounding box
     //
-    kdt.curdist = 0;
+    buf.curdist = 0;
     if( kdt.normtype==0 )
     {
         for(i = 0; i <= kdt.nx-1; i++)
@@ -1178,18 +1584,18 @@ static void kdtreeinitbox(kdtree& kdt, const ap::real_1d_array& x)
             vx = x(i);
             vmin = kdt.boxmin(i);
             vmax = kdt.boxmax(i);
-            kdt.x(i) = vx;
-            kdt.curboxmin(i) = vmin;
-            kdt.curboxmax(i) = vmax;
+            buf.x(i) = vx;
+            buf.curboxmin(i) = vmin;
+            buf.curboxmax(i) = vmax;
             if( ap::fp_less(vx,vmin) )
             {
-                kdt.curdist = ap::maxreal(kdt.curdist, vmin-vx);
+                buf.curdist = ap::maxreal(buf.curdist, vmin-vx);
             }
             else
             {
                 if( ap::fp_greater(vx,vmax) )
                 {
-                    kdt.curdist = ap::maxreal(kdt.curdist, vx-vmax);
+                    buf.curdist = ap::maxreal(buf.curdist, vx-vmax);
                 }
             }
         }
@@ -1201,18 +1607,18 @@ static void kdtreeinitbox(kdtree& kdt, const ap::real_1d_array& x)
             vx = x(i);
             vmin = kdt.boxmin(i);
             vmax = kdt.boxmax(i);
-            kdt.x(i) = vx;
-            kdt.curboxmin(i) = vmin;
-            kdt.curboxmax(i) = vmax;
+            buf.x(i) = vx;
+            buf.curboxmin(i) = vmin;
+            buf.curboxmax(i) = vmax;
             if( ap::fp_less(vx,vmin) )
             {
-                kdt.curdist = kdt.curdist+vmin-vx;
+                buf.curdist = buf.curdist+vmin-vx;
             }
             else
             {
                 if( ap::fp_greater(vx,vmax) )
                 {
-                    kdt.curdist = kdt.curdist+vx-vmax;
+                    buf.curdist = buf.curdist+vx-vmax;
                 }
             }
         }
@@ -1224,18 +1630,18 @@ static void kdtreeinitbox(kdtree& kdt, const ap::real_1d_array& x)
             vx = x(i);
             vmin = kdt.boxmin(i);
             vmax = kdt.boxmax(i);
-            kdt.x(i) = vx;
-            kdt.curboxmin(i) = vmin;
-            kdt.curboxmax(i) = vmax;
+            buf.x(i) = vx;
+            buf.curboxmin(i) = vmin;
+            buf.curboxmax(i) = vmax;
             if( ap::fp_less(vx,vmin) )
             {
-                kdt.curdist = kdt.curdist+ap::sqr(vmin-vx);
+                buf.curdist = buf.curdist+ap::sqr(vmin-vx);
             }
             else
             {
                 if( ap::fp_greater(vx,vmax) )
                 {
-                    kdt.curdist = kdt.curdist+ap::sqr(vx-vmax);
+                    buf.curdist = buf.curdist+ap::sqr(vx-vmax);
                 }
             }
         }
@@ -27,6 +27,29 @@ http://www.fsf.org/licensing/licenses
 #include "tsort.h"
 
 
+/*************************************************************************
+Query state: query point, current box, heap of results.
+
+A separate buffer for each thread allows concurrent queries to one tree,
+see KDTreeCreateRequestBuffer() and KDTreeTsQueryKNN().
+*************************************************************************/
+struct kdtreerequestbuffer
+{
+    ap::real_1d_array x;
+    ap::real_1d_array curboxmin;
+    ap::real_1d_array curboxmax;
+    double curdist;
+    int kneeded;
+    double rneeded;
+    bool selfmatch;
+    double approxf;
+    int kcur;
+    ap::integer_1d_array idx;
+    ap::real_1d_array r;
+    ap::real_1d_array buf;
+};
+
+
 struct kdtree
 {
     int n;
@@ -38,20 +61,11 @@ struct kdtree
     ap::integer_1d_array tags;
     ap::real_1d_array boxmin;
     ap::real_1d_array boxmax;
-    ap::real_1d_array curboxmin;
-    ap::real_1d_array curboxmax;
-    double curdist;
     ap::integer_1d_array nodes;
     ap::real_1d_array splits;
-    ap::real_1d_array x;
-    int kneeded;
-    double rneeded;
-    bool selfmatch;
-    double approxf;
-    int kcur;
-    ap::integer_1d_array idx;
-    ap::real_1d_array r;
-    ap::real_1d_array buf;
+    int layout;
+    ap::real_1d_array soax;
+    kdtreerequestbuffer innerbuf;
     int debugcounter;
 };
 
@@ -147,6 +161,35 @@ void kdtreebuildtagged(const ap::real_2d_array& xy,
      kdtree& kdt);
 
 
+/*************************************************************************
+KD-tree creation, flat layout
+
+Same as KDTreeBuildTagged(), but the tree is stored in a layout  tuned
+for queries with larger NX:
+* nodes are stored in breadth-first order, so the top levels  of  the
+  tree, visited by each query, are packed in a few cache lines
+* X-values of each leaf are also stored column-wise (all 1st coordinates,
+  then all 2nd coordinates, ...), so distances to  the  points  of  a
+  leaf are computed with unit-stride loops which the compiler vectorizes
+
+Queries and results are the same  as  with  the  default  layout,  all
+query functions may be used. The tree takes N*NX more memory.
+
+INPUT PARAMETERS
+    same as KDTreeBuildTagged()
+
+OUTPUT PARAMETERS
+    KDT     -   KD-tree
+*************************************************************************/
+void kdtreebuildtaggedflat(const ap::real_2d_array& xy,
+     const ap::integer_1d_array& tags,
+     int n,
+     int nx,
+     int ny,
+     int normtype,
+     kdtree& kdt);
+
+
 /*************************************************************************
 K-NN query: K nearest neighbors
 
@@ -254,6 +297,108 @@ int kdtreequeryaknn(kdtree& kdt,
      double eps);
 
 
+/*************************************************************************
+Request buffer for thread-safe queries
+
+This subroutine creates a buffer which holds the state of one query (query
+point, current box, results). Queries made with such  buffer  don't  modify
+the tree, so several threads may query one tree at the same time, each one
+with its own buffer.
+
+INPUT PARAMETERS
+    KDT     -   KD-tree
+
+OUTPUT PARAMETERS
+    Buf     -   request buffer, may be reused by any number of queries
+*************************************************************************/
+void kdtreecreaterequestbuffer(const kdtree& kdt, kdtreerequestbuffer& buf);
+
+
+/*************************************************************************
+K-NN query: K nearest neighbors, thread-safe version
+
+Same as KDTreeQueryKNN(), except that query state and results are  stored
+in Buf, not in KDT.
+
+INPUT PARAMETERS
+    KDT         -   KD-tree
+    Buf         -   request buffer, created by KDTreeCreateRequestBuffer()
+    X           -   point, array[0..NX-1].
+    K           -   number of neighbors to return, K>=1
+    SelfMatch   -   whether self-matches are allowed
+
+RESULT
+    number of actual neighbors found (either K or N, if K>N).
+
+Results are obtained with KDTreeTsQueryResultsX(), KDTreeTsQueryResultsXY(),
+KDTreeTsQueryResultsTags() and KDTreeTsQueryResultsDistances().
+*************************************************************************/
+int kdtreetsqueryknn(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     const ap::real_1d_array& x,
+     int k,
+     bool selfmatch);
+
+
+/*************************************************************************
+R-NN query: all points within R-sphere centered at X, thread-safe version
+
+Same as KDTreeQueryRNN(), except that query state and results are  stored
+in Buf, not in KDT.
+*************************************************************************/
+int kdtreetsqueryrnn(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     const ap::real_1d_array& x,
+     double r,
+     bool selfmatch);
+
+
+/*************************************************************************
+K-NN query: approximate K nearest neighbors, thread-safe version
+
+Same as KDTreeQueryAKNN(), except that query state and results are stored
+in Buf, not in KDT.
+*************************************************************************/
+int kdtreetsqueryaknn(const kdtree& kdt,
+     kdtreerequestbuffer& buf,
+     const ap::real_1d_array& x,
+     int k,
+     bool selfmatch,
+     double eps);
+
+
+/*************************************************************************
+Batch of K-NN queries
+
+Finds K nearest neighbors of each row of X. When compiled  with  OpenMP,
+queries are split between threads, each one with its own request buffer.
+The tree is not modified.
+
+INPUT PARAMETERS
+    KDT         -   KD-tree
+    X           -   points, array[0..M-1,0..NX-1].
+    M           -   number of points, M>=0
+    K           -   number of neighbors to return, K>=1
+    SelfMatch   -   whether self-matches are allowed
+
+OUTPUT PARAMETERS
+    Cnt         -   array[0..M-1], number of neighbors found for each point
+    Tags        -   array[0..M-1,0..min(K,N)-1], first Cnt[I] elements  of
+                    I-th row are tags of neighbors of X[I], ordered by
+                    distance (first = closest)
+    R           -   array[0..M-1,0..min(K,N)-1], distances to neighbors,
+                    in the same order
+*************************************************************************/
+void kdtreequeryknnbatch(const kdtree& kdt,
+     const ap::real_2d_array& x,
+     int m,
+     int k,
+     bool selfmatch,
+     ap::integer_1d_array& cnt,
+     ap::integer_2d_array& tags,
+     ap::real_2d_array& r);
+
+
 /*************************************************************************
 X-values from last query
 
@@ -361,5 +506,45 @@ void kdtreequeryresultsdistances(const kdtree& kdt,
      int& k);
 
 
+/*************************************************************************
+X-values from last query made with request buffer Buf,
+see KDTreeQueryResultsX()
+*************************************************************************/
+void kdtreetsqueryresultsx(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::real_2d_array& x,
+     int& k);
+
+
+/*************************************************************************
+X- and Y-values from last query made with request buffer Buf,
+see KDTreeQueryResultsXY()
+*************************************************************************/
+void kdtreetsqueryresultsxy(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::real_2d_array& xy,
+     int& k);
+
+
+/*************************************************************************
+Point tags from last query made with request buffer Buf,
+see KDTreeQueryResultsTags()
+*************************************************************************/
+void kdtreetsqueryresultstags(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::integer_1d_array& tags,
+     int& k);
+
+
+/*************************************************************************
+Distances from last query made with request buffer Buf,
+see KDTreeQueryResultsDistances()
+*************************************************************************/
+void kdtreetsqueryresultsdistances(const kdtree& kdt,
+     const kdtreerequestbuffer& buf,
+     ap::real_1d_array& r,
+     int& k);
+
+
 #endif
 
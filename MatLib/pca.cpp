@@ -21,6 +21,20 @@ http://www.fsf.org/licensing/licenses
  
 #include "pca.h"
 
+static const int pcaoversampling = 10;
+static const int pcablocksize = 256;
+static const int pcaseed1 = 7542;
+static const int pcaseed2 = 1264;
+
+static void pcastreamproduct(const ap::real_2d_array& x,
+     int npoints,
+     int nvars,
+     const ap::real_1d_array& m,
+     const ap::real_2d_array& q,
+     int l,
+     bool needy,
+     ap::real_2d_array& y);
+
 /*************************************************************************
 Principal components analysis
 
@@ -153,5 +167,214 @@ void pcabuildbasis(const ap::real_2d_array& x,
 }
 
 
+/*************************************************************************
+Truncated principal components analysis
+
+Subroutine calculates NNeeded principal components (directions with
+largest variance) by randomized subspace iteration (Halko, Martinsson,
+Tropp): random subspace of dimension NNeeded+10 is multiplied by the
+covariance matrix PowerItsCount+1 times (with orthogonalization after each
+multiplication), then principal components are extracted from this
+subspace (Rayleigh-Ritz procedure).
+
+Dataset is read by blocks of rows, centered copy of the whole dataset is
+never made; each multiplication is two matrix-matrix products per block
+(RMatrixGEMM). Work is O(NPoints*NVars*NNeeded*PowerItsCount) instead of
+O(NPoints*NVars^2) for PCABuildBasis(), memory is O(NVars*NNeeded).
+
+Result is approximate: components whose variances are well separated from
+the rest are found with high precision, precision grows with the
+PowerItsCount. When NNeeded is comparable with NVars or NPoints, exact
+PCABuildBasis() is used.
+
+Random subspace is generated with fixed seed, so results are reproducible:
+same dataset gives same basis from call to call.
+
+INPUT PARAMETERS:
+    X           -   dataset, array[0..NPoints-1,0..NVars-1].
+                    matrix contains ONLY INDEPENDENT VARIABLES.
+    NPoints     -   dataset size, NPoints>=0
+    NVars       -   number of independent variables, NVars>=1
+    NNeeded     -   number of components, 1<=NNeeded<=NVars
+    PowerItsCount-  number of power iterations, PowerItsCount>=0.
+                    Recommended value is 2, use more iterations when the
+                    variances decay slowly.
+
+OUTPUT PARAMETERS:
+    Info        -   return code:
+                    * -4, if SVD subroutine haven't converged
+                    * -1, if wrong parameters has been passed
+                    *  1, if task is solved
+    S2          -   array[0..NNeeded-1]. variance values corresponding
+                    to basis vectors, in descending order.
+    V           -   array[0..NVars-1,0..NNeeded-1]
+                    matrix, whose columns store basis vectors.
+*************************************************************************/
+void pcatruncatedsubspace(const ap::real_2d_array& x,
+     int npoints,
+     int nvars,
+     int nneeded,
+     int poweritscount,
+     int& info,
+     ap::real_1d_array& s2,
+     ap::real_2d_array& v)
+{
+    ap::real_1d_array m;
+    ap::real_2d_array q;
+    ap::real_2d_array y;
+    ap::real_2d_array c;
+    ap::real_2d_array u;
+    ap::real_2d_array vt;
+    ap::real_1d_array tau;
+    ap::real_1d_array w;
+    hqrndstate rs;
+    int l;
+    int i;
+    int j;
+    int it;
+
+    
+    //
+    // Check input data
+    //
+    if( npoints<0||nvars<1||nneeded<1||nneeded>nvars||poweritscount<0 )
+    {
+        info = -1;
+        return;
+    }
+    info = 1;
+    
+    //
+    // Small problems, NNeeded is comparable with NVars or NPoints:
+    // exact PCA, first NNeeded components
+    //
+    l = nneeded+pcaoversampling;
+    if( 2*l>=nvars||2*l>=npoints )
+    {
+        pcabuildbasis(x, npoints, nvars, info, w, c);
+        if( info!=1 )
+        {
+            return;
+        }
+        s2.setlength(nneeded);
+        v.setlength(nvars, nneeded);
+        ap::vmove(&s2(0), 1, &w(0), 1, ap::vlen(0,nneeded-1));
+        for(i = 0; i <= nvars-1; i++)
+        {
+            ap::vmove(&v(i, 0), 1, &c(i, 0), 1, ap::vlen(0,nneeded-1));
+        }
+        return;
+    }
+    
+    //
+    // Means
+    //
+    m.setlength(nvars);
+    for(j = 0; j <= nvars-1; j++)
+    {
+        m(j) = 0;
+    }
+    for(i = 0; i <= npoints-1; i++)
+    {
+        ap::vadd(&m(0), 1, &x(i, 0), 1, ap::vlen(0,nvars-1));
+    }
+    ap::vmul(&m(0), 1, ap::vlen(0,nvars-1), double(1)/double(npoints));
+    
+    //
+    // Subspace iteration: Q := orth(A'*A*Q), starting from the random
+    // Gaussian matrix (A is centered dataset).
+    //
+    hqrndseed(pcaseed1, pcaseed2, rs);
+    q.setlength(nvars, l);
+    for(i = 0; i <= nvars-1; i++)
+    {
+        for(j = 0; j <= l-1; j++)
+        {
+            q(i,j) = hqrndnormal(rs);
+        }
+    }
+    for(it = 0; it <= poweritscount; it++)
+    {
+        pcastreamproduct(x, npoints, nvars, m, q, l, true, y);
+        rmatrixqr(y, nvars, l, tau);
+        rmatrixqrunpackq(y, nvars, l, tau, l, q);
+    }
+    
+    //
+    // Rayleigh-Ritz: C = (A*Q)'*(A*Q) = W*S*W', components are Q*W,
+    // variances are S/(NPoints-1).
+    //
+    pcastreamproduct(x, npoints, nvars, m, q, l, false, c);
+    if( !rmatrixsvd(c, l, l, 0, 1, 2, w, u, vt) )
+    {
+        info = -4;
+        return;
+    }
+    s2.setlength(nneeded);
+    for(i = 0; i <= nneeded-1; i++)
+    {
+        s2(i) = w(i)/(npoints-1);
+    }
+    v.setlength(nvars, nneeded);
+    rmatrixgemm(nvars, nneeded, l, 1.0, q, 0, 0, 0, vt, 0, 0, 1, 0.0, v, 0, 0);
+}
+
+
+/*************************************************************************
+Product with the centered dataset A = X - 1*M', read by blocks of rows:
+* NeedY=True:  Y = A'*A*Q,   array[0..NVars-1,0..L-1]
+* NeedY=False: Y = (A*Q)'*(A*Q), array[0..L-1,0..L-1]
+Q is array[0..NVars-1,0..L-1].
+*************************************************************************/
+static void pcastreamproduct(const ap::real_2d_array& x,
+     int npoints,
+     int nvars,
+     const ap::real_1d_array& m,
+     const ap::real_2d_array& q,
+     int l,
+     bool needy,
+     ap::real_2d_array& y)
+{
+    ap::real_2d_array blk;
+    ap::real_2d_array z;
+    int i1;
+    int cnt;
+    int i;
+    double beta;
+
+    if( needy )
+    {
+        y.setlength(nvars, l);
+    }
+    else
+    {
+        y.setlength(l, l);
+    }
+    blk.setlength(ap::minint(pcablocksize, npoints), nvars);
+    z.setlength(ap::minint(pcablocksize, npoints), l);
+    for(i1 = 0; i1 <= npoints-1; i1 = i1+pcablocksize)
+    {
+        cnt = ap::minint(pcablocksize, npoints-i1);
+        for(i = 0; i <= cnt-1; i++)
+        {
+            ap::vmove(&blk(i, 0), 1, &x(i1+i, 0), 1, ap::vlen(0,nvars-1));
+            ap::vsub(&blk(i, 0), 1, &m(0), 1, ap::vlen(0,nvars-1));
+        }
+        beta = 1.0;
+        if( i1==0 )
+        {
+            beta = 0.0;
+        }
+        rmatrixgemm(cnt, l, nvars, 1.0, blk, 0, 0, 0, q, 0, 0, 0, 0.0, z, 0, 0);
+        if( needy )
+        {
+            rmatrixgemm(nvars, l, cnt, 1.0, blk, 0, 0, 1, z, 0, 0, 0, beta, y, 0, 0);
+        }
+        else
+        {
+            rmatrixgemm(l, l, cnt, 1.0, z, 0, 0, 1, z, 0, 0, 0, beta, y, 0, 0);
+        }
+    }
+}
 
 
@@ -36,6 +36,7 @@ http://www.fsf.org/licensing/licenses
 #include "bdsvd.h"
 #include "svd.h"
 #include "descriptivestatistics.h"
+#include "hqrnd.h"
 
 
 /*************************************************************************
@@ -75,5 +76,58 @@ void pcabuildbasis(const ap::real_2d_array& x,
      ap::real_2d_array& v);
 
 
+/*************************************************************************
+Truncated principal components analysis
+
+Subroutine calculates NNeeded principal components (directions with
+largest variance) by randomized subspace iteration (Halko, Martinsson,
+Tropp): random subspace of dimension NNeeded+10 is multiplied by the
+covariance matrix PowerItsCount+1 times (with orthogonalization after each
+multiplication), then principal components are extracted from this
+subspace (Rayleigh-Ritz procedure).
+
+Dataset is read by blocks of rows, centered copy of the whole dataset is
+never made; each multiplication is two matrix-matrix products per block
+(RMatrixGEMM). Work is O(NPoints*NVars*NNeeded*PowerItsCount) instead of
+O(NPoints*NVars^2) for PCABuildBasis(), memory is O(NVars*NNeeded).
+
+Result is approximate: components whose variances are well separated from
+the rest are found with high precision, precision grows with the
+PowerItsCount. When NNeeded is comparable with NVars or NPoints, exact
+PCABuildBasis() is used.
+
+Random subspace is generated with fixed seed, so results are reproducible:
+same dataset gives same basis from call to call.
+
+INPUT PARAMETERS:
+    X           -   dataset, array[0..NPoints-1,0..NVars-1].
+                    matrix contains ONLY INDEPENDENT VARIABLES.
+    NPoints     -   dataset size, NPoints>=0
+    NVars       -   number of independent variables, NVars>=1
+    NNeeded     -   number of components, 1<=NNeeded<=NVars
+    PowerItsCount-  number of power iterations, PowerItsCount>=0.
+                    Recommended value is 2, use more iterations when the
+                    variances decay slowly.
+
+OUTPUT PARAMETERS:
+    Info        -   return code:
+                    * -4, if SVD subroutine haven't converged
+                    * -1, if wrong parameters has been passed
+                    *  1, if task is solved
+    S2          -   array[0..NNeeded-1]. variance values corresponding
+                    to basis vectors, in descending order.
+    V           -   array[0..NVars-1,0..NNeeded-1]
+                    matrix, whose columns store basis vectors.
+*************************************************************************/
+void pcatruncatedsubspace(const ap::real_2d_array& x,
+     int npoints,
+     int nvars,
+     int nneeded,
+     int poweritscount,
+     int& info,
+     ap::real_1d_array& s2,
+     ap::real_2d_array& v);
+
+
 #endif
 
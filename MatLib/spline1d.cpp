@@ -20,8 +20,14 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "spline1d.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static const int spline1dvnum = 11;
+static const int spline1dbatchblocksize = 1024;
+static const int spline1dgallopmax = 8;
+static const double spline1dparallelwork = 65536.0;
 
 static void spline1dfitinternal(int st,
      ap::real_1d_array x,
@@ -54,6 +60,7 @@ static double diffthreepoint(double t,
      double f1,
      double x2,
      double f2);
+static bool spline1dparallel(double work);
 
 /*************************************************************************
 This subroutine builds linear spline interpolant
@@ -721,6 +728,121 @@ double spline1dcalc(const spline1dinterpolant& c, double x)
 }
 
 
+/*************************************************************************
+This subroutine calculates the values of the spline at the points X[0..N-1].
+
+Same as Spline1DCalc() called for each point, result is the same too, but
+the interval search is cheaper:
+* on the uniform grid interval is guessed in O(1) from the point itself
+* on the non-uniform grid search starts from the interval of the previous
+  point, so the sorted (or nearly sorted) X costs O(1) per point, and the
+  random X costs O(log(N)) as before.
+Points are processed by blocks: all intervals of the block are found first,
+then the polynomials are evaluated in the separate branch-free loop  which
+can be vectorized by compiler. Blocks are distributed between threads when
+OpenMP is on.
+
+INPUT PARAMETERS:
+    C   -   spline interpolant
+    X   -   points, array[0..N-1], in any order
+    N   -   number of points, N>=0
+
+OUTPUT PARAMETERS:
+    Y   -   S(X[i]), array[0..N-1]. Allocated by the subroutine.
+*************************************************************************/
+void spline1dcalcv(const spline1dinterpolant& c,
+     const ap::real_1d_array& x,
+     int n,
+     ap::real_1d_array& y)
+{
+    bool uniform;
+    double x0;
+    double invh;
+    int nblocks;
+    int b;
+
+    ap::ap_error::make_assertion(c.k==3, "Spline1DCalcV: internal error");
+    ap::ap_error::make_assertion(n>=0, "Spline1DCalcV: N<0!");
+    if( n==0 )
+    {
+        return;
+    }
+    y.setlength(n);
+    uniform = spline1duniforminternal(c.x, 0, c.n, x0, invh);
+    nblocks = (n+spline1dbatchblocksize-1)/spline1dbatchblocksize;
+    #pragma omp parallel if( nblocks>1&&spline1dparallel(double(n)) )
+    {
+        ap::integer_1d_array idx;
+        const double *pc;
+        const double *pcx;
+        const double *px;
+        const int *pidx;
+        double *py;
+        double t;
+        int i1;
+        int cnt;
+        int i;
+        int l;
+        int m;
+        int hint;
+        int lprev;
+
+        idx.setlength(spline1dbatchblocksize);
+        #pragma omp for schedule(static)
+        for(b = 0; b <= nblocks-1; b++)
+        {
+            i1 = b*spline1dbatchblocksize;
+            cnt = ap::minint(spline1dbatchblocksize, n-i1);
+            
+            //
+            // Intervals. Search on the non-uniform grid starts from the
+            // interval of the previous point while the points go from one
+            // interval to the neighboring one (sorted X).
+            //
+            hint = -1;
+            lprev = -2;
+            for(i = 0; i <= cnt-1; i++)
+            {
+                if( uniform )
+                {
+                    hint = spline1dhintinternal(x(i1+i), x0, invh, c.n);
+                }
+                l = spline1dsearchinternal(c.x, 0, c.n, x(i1+i), hint);
+                if( !uniform )
+                {
+                    if( abs(l-lprev)<=1 )
+                    {
+                        hint = l;
+                    }
+                    else
+                    {
+                        hint = -1;
+                    }
+                    lprev = l;
+                }
+                idx(i) = l;
+            }
+            
+            //
+            // Interpolation, same formula as in Spline1DCalc()
+            //
+            pc = &c.c(0);
+            pcx = &c.x(0);
+            px = &x(i1);
+            py = &y(i1);
+            pidx = &idx(0);
+            for(i = 0; i <= cnt-1; i++)
+            {
+                l = pidx[i];
+                m = 4*l;
+                t = px[i]-pcx[l];
+                py[i] = pc[m]+t*(pc[m+1]+t*(pc[m+2]+t*pc[m+3]));
+            }
+        }
+    }
+}
+
+
 /*************************************************************************
 This subroutine differentiates the spline.
 
@@ -1071,6 +1193,188 @@ double spline1dintegrate(const spline1dinterpolant& c, double x)
 }
 
 
+/*************************************************************************
+Internal subroutine: interval search in the grid A[Offs..Offs+N-1].
+
+Returns the same L as the binary search of Spline1DCalc(): the largest L
+in [0,N-2] with A[Offs+L]<X, or 0 if there is no such L. Search starts from
+the interval Hint (Hint<0 means "no hint", any other value is accepted),
+makes a few galloping steps in the direction of X and finishes with the
+binary search, so it costs O(1) when L is close to Hint and O(log(N))
+otherwise.
+*************************************************************************/
+int spline1dsearchinternal(const ap::real_1d_array& a,
+     int offs,
+     int n,
+     double x,
+     int hint)
+{
+    int result;
+    int l;
+    int r;
+    int m;
+    int s;
+
+    if( hint<0 )
+    {
+        
+        //
+        // No hint
+        //
+        l = 0;
+        r = n-1;
+        while(l!=r-1)
+        {
+            m = (l+r)/2;
+            if( ap::fp_greater_eq(a(offs+m),x) )
+            {
+                r = m;
+            }
+            else
+            {
+                l = m;
+            }
+        }
+        result = l;
+        return result;
+    }
+    if( hint>n-2 )
+    {
+        hint = n-2;
+    }
+    if( !ap::fp_greater_eq(a(offs+hint),x) )
+    {
+        
+        //
+        // A[Hint]<X: gallop forward until A[R]>=X or R=N-1
+        //
+        l = hint;
+        r = l+1;
+        s = 1;
+        while(r<=n-2&&!ap::fp_greater_eq(a(offs+r),x))
+        {
+            l = r;
+            if( s>=spline1dgallopmax )
+            {
+                r = n-1;
+                break;
+            }
+            s = 2*s;
+            r = l+s;
+        }
+        if( r>n-1 )
+        {
+            r = n-1;
+        }
+    }
+    else
+    {
+        
+        //
+        // A[Hint]>=X: gallop backward until A[L]<X or L=0
+        //
+        if( hint==0 )
+        {
+            result = 0;
+            return result;
+        }
+        r = hint;
+        l = r-1;
+        s = 1;
+        while(l>0&&ap::fp_greater_eq(a(offs+l),x))
+        {
+            r = l;
+            if( s>=spline1dgallopmax )
+            {
+                l = 0;
+                break;
+            }
+            s = 2*s;
+            l = r-s;
+        }
+        if( l<0 )
+        {
+            l = 0;
+        }
+    }
+    
+    //
+    // Binary search in [L,R), same as in Spline1DCalc()
+    //
+    while(l!=r-1)
+    {
+        m = (l+r)/2;
+        if( ap::fp_greater_eq(a(offs+m),x) )
+        {
+            r = m;
+        }
+        else
+        {
+            l = m;
+        }
+    }
+    result = l;
+    return result;
+}
+
+
+/*************************************************************************
+Internal subroutine: checks whether the grid A[Offs..Offs+N-1] is uniform
+(every node is within 1/4 of the step from its position on the uniform
+grid), returns its origin X0 and inverse step InvH.
+*************************************************************************/
+bool spline1duniforminternal(const ap::real_1d_array& a,
+     int offs,
+     int n,
+     double& x0,
+     double& invh)
+{
+    bool result;
+    double h;
+    int i;
+
+    x0 = a(offs);
+    h = (a(offs+n-1)-a(offs))/(n-1);
+    invh = 1/h;
+    result = true;
+    for(i = 1; i <= n-2; i++)
+    {
+        if( ap::fp_greater(fabs(a(offs+i)-(x0+i*h)),0.25*h) )
+        {
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Internal subroutine: interval of the uniform grid (X0, InvH, N nodes)
+which contains X, clamped to [0,N-2]. Used as a hint for the
+Spline1DSearchInternal().
+*************************************************************************/
+int spline1dhintinternal(double x, double x0, double invh, int n)
+{
+    int result;
+    double t;
+
+    t = (x-x0)*invh;
+    if( !(t>=0) )
+    {
+        result = 0;
+        return result;
+    }
+    if( t>=n-2 )
+    {
+        result = n-2;
+        return result;
+    }
+    result = int(t);
+    return result;
+}
+
+
 /*************************************************************************
 Internal spline fitting subroutine
 
@@ -1744,5 +2048,20 @@ static double diffthreepoint(double t,
 }
 
 
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool spline1dparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,spline1dparallelwork);
+#endif
+    return result;
+}
 
 
@@ -447,6 +447,34 @@ Result:
 double spline1dcalc(const spline1dinterpolant& c, double x);
 
 
+/*************************************************************************
+This subroutine calculates the values of the spline at the points X[0..N-1].
+
+Same as Spline1DCalc() called for each point, result is the same too, but
+the interval search is cheaper:
+* on the uniform grid interval is guessed in O(1) from the point itself
+* on the non-uniform grid search starts from the interval of the previous
+  point, so the sorted (or nearly sorted) X costs O(1) per point, and the
+  random X costs O(log(N)) as before.
+Points are processed by blocks: all intervals of the block are found first,
+then the polynomials are evaluated in the separate branch-free loop  which
+can be vectorized by compiler. Blocks are distributed between threads when
+OpenMP is on.
+
+INPUT PARAMETERS:
+    C   -   spline interpolant
+    X   -   points, array[0..N-1], in any order
+    N   -   number of points, N>=0
+
+OUTPUT PARAMETERS:
+    Y   -   S(X[i]), array[0..N-1]. Allocated by the subroutine.
+*************************************************************************/
+void spline1dcalcv(const spline1dinterpolant& c,
+     const ap::real_1d_array& x,
+     int n,
+     ap::real_1d_array& y);
+
+
 /*************************************************************************
 This subroutine differentiates the spline.
 
@@ -591,5 +619,42 @@ Result:
 double spline1dintegrate(const spline1dinterpolant& c, double x);
 
 
+/*************************************************************************
+Internal subroutine: interval search in the grid A[Offs..Offs+N-1].
+
+Returns the same L as the binary search of Spline1DCalc(): the largest L
+in [0,N-2] with A[Offs+L]<X, or 0 if there is no such L. Search starts from
+the interval Hint (Hint<0 means "no hint", any other value is accepted),
+makes a few galloping steps in the direction of X and finishes with the
+binary search, so it costs O(1) when L is close to Hint and O(log(N))
+otherwise.
+*************************************************************************/
+int spline1dsearchinternal(const ap::real_1d_array& a,
+     int offs,
+     int n,
+     double x,
+     int hint);
+
+
+/*************************************************************************
+Internal subroutine: checks whether the grid A[Offs..Offs+N-1] is uniform
+(every node is within 1/4 of the step from its position on the uniform
+grid), returns its origin X0 and inverse step InvH.
+*************************************************************************/
+bool spline1duniforminternal(const ap::real_1d_array& a,
+     int offs,
+     int n,
+     double& x0,
+     double& invh);
+
+
+/*************************************************************************
+Internal subroutine: interval of the uniform grid (X0, InvH, N nodes)
+which contains X, clamped to [0,N-2]. Used as a hint for the
+Spline1DSearchInternal().
+*************************************************************************/
+int spline1dhintinternal(double x, double x0, double invh, int n);
+
+
 #endif
 
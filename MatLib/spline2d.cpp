@@ -20,8 +20,13 @@ http://www.fsf.org/licensing/licenses
 
  
 #include "spline2d.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static const int spline2dvnum = 12;
+static const int spline2dbatchblocksize = 1024;
+static const double spline2dparallelwork = 16384.0;
 
 static void bicubiccalcderivatives(const ap::real_2d_array& a,
      const ap::real_1d_array& x,
@@ -31,6 +36,7 @@ static void bicubiccalcderivatives(const ap::real_2d_array& a,
      ap::real_2d_array& dx,
      ap::real_2d_array& dy,
      ap::real_2d_array& dxy);
+static bool spline2dparallel(double work);
 
 /*************************************************************************
 This subroutine builds bilinear spline coefficients table.
@@ -327,6 +333,241 @@ double spline2dcalc(const spline2dinterpolant& c, double x, double y)
 }
 
 
+/*************************************************************************
+This subroutine calculates the values of the bilinear or bicubic spline at
+the points (X[i],Y[i]), i=0..NPoints-1.
+
+Same as Spline2DCalc() called for each point, result is the same too, but:
+* interval search on uniform grids is O(1), on non-uniform ones it starts
+  from the cell of the previous point, so the points which are sorted (or
+  close to each other, like scanlines of the image) are located in O(1)
+* coefficients of the bicubic polynomial are calculated once per cell and
+  reused while the following points stay in the same cell
+Points are processed by blocks, blocks are distributed between threads when
+OpenMP is on.
+
+Input parameters:
+    C       -   spline interpolant.
+    X, Y    -   points, array[0..NPoints-1], in any order
+    NPoints -   number of points, NPoints>=0
+
+Output parameters:
+    F       -   S(X[i],Y[i]), array[0..NPoints-1]. Allocated by the
+                subroutine.
+*************************************************************************/
+void spline2dcalcv(const spline2dinterpolant& c,
+     const ap::real_1d_array& x,
+     const ap::real_1d_array& y,
+     int npoints,
+     ap::real_1d_array& f)
+{
+    int n;
+    int m;
+    bool bicubic;
+    bool uniformx;
+    bool uniformy;
+    double x0;
+    double invhx;
+    double y0;
+    double invhy;
+    int nblocks;
+    int b;
+
+    ap::ap_error::make_assertion(ap::round(c.c(1))==-1||ap::round(c.c(1))==-3, "Spline2DCalcV: incorrect C!");
+    ap::ap_error::make_assertion(npoints>=0, "Spline2DCalcV: NPoints<0!");
+    if( npoints==0 )
+    {
+        return;
+    }
+    f.setlength(npoints);
+    n = ap::round(c.c(2));
+    m = ap::round(c.c(3));
+    bicubic = ap::round(c.c(1))==-3;
+    uniformx = spline1duniforminternal(c.c, 4, n, x0, invhx);
+    uniformy = spline1duniforminternal(c.c, 4+n, m, y0, invhy);
+    nblocks = (npoints+spline2dbatchblocksize-1)/spline2dbatchblocksize;
+    #pragma omp parallel if( nblocks>1&&spline2dparallel(double(npoints)) )
+    {
+        ap::real_1d_array a;
+        double t;
+        double dt;
+        double u;
+        double du;
+        double t0;
+        double t1;
+        double t2;
+        double t3;
+        double u0;
+        double u1;
+        double u2;
+        double u3;
+        double y1;
+        double y2;
+        double y3;
+        double y4;
+        double v;
+        int ix;
+        int iy;
+        int cx;
+        int cy;
+        int hintx;
+        int hinty;
+        int ixprev;
+        int iyprev;
+        int l;
+        int i;
+        int i1;
+        int i2;
+        int shift1;
+        int s1;
+        int s2;
+        int s3;
+        int s4;
+        int sf;
+        int sfx;
+        int sfy;
+        int sfxy;
+
+        a.setlength(16);
+        sf = 4+n+m;
+        sfx = 4+n+m+n*m;
+        sfy = 4+n+m+2*n*m;
+        sfxy = 4+n+m+3*n*m;
+        #pragma omp for schedule(static)
+        for(b = 0; b <= nblocks-1; b++)
+        {
+            i1 = b*spline2dbatchblocksize;
+            i2 = ap::minint(i1+spline2dbatchblocksize, npoints)-1;
+            hintx = -1;
+            hinty = -1;
+            ixprev = -2;
+            iyprev = -2;
+            cx = -1;
+            cy = -1;
+            for(i = i1; i <= i2; i++)
+            {
+                
+                //
+                // Cell. Search on the non-uniform grid starts from the cell
+                // of the previous point while the points go from one cell to
+                // the neighboring one.
+                //
+                if( uniformx )
+                {
+                    hintx = spline1dhintinternal(x(i), x0, invhx, n);
+                }
+                if( uniformy )
+                {
+                    hinty = spline1dhintinternal(y(i), y0, invhy, m);
+                }
+                ix = spline1dsearchinternal(c.c, 4, n, x(i), hintx);
+                iy = spline1dsearchinternal(c.c, 4+n, m, y(i), hinty);
+                if( !uniformx )
+                {
+                    if( abs(ix-ixprev)<=1 )
+                    {
+                        hintx = ix;
+                    }
+                    else
+                    {
+                        hintx = -1;
+                    }
+                    ixprev = ix;
+                }
+                if( !uniformy )
+                {
+                    if( abs(iy-iyprev)<=1 )
+                    {
+                        hinty = iy;
+                    }
+                    else
+                    {
+                        hinty = -1;
+                    }
+                    iyprev = iy;
+                }
+                l = 4+ix;
+                t = (x(i)-c.c(l))/(c.c(l+1)-c.c(l));
+                dt = 1.0/(c.c(l+1)-c.c(l));
+                l = 4+n+iy;
+                u = (y(i)-c.c(l))/(c.c(l+1)-c.c(l));
+                du = 1.0/(c.c(l+1)-c.c(l));
+                
+                //
+                // Bilinear interpolation
+                //
+                if( !bicubic )
+                {
+                    shift1 = 4+n+m;
+                    y1 = c.c(shift1+n*iy+ix);
+                    y2 = c.c(shift1+n*iy+(ix+1));
+                    y3 = c.c(shift1+n*(iy+1)+(ix+1));
+                    y4 = c.c(shift1+n*(iy+1)+ix);
+                    f(i) = (1-t)*(1-u)*y1+t*(1-u)*y2+t*u*y3+(1-t)*u*y4;
+                    continue;
+                }
+                
+                //
+                // Bicubic interpolation. Coefficients are the same as in
+                // Spline2DDiff() and are summed in the same order.
+                //
+                if( ix!=cx||iy!=cy )
+                {
+                    s1 = n*iy+ix;
+                    s2 = n*iy+(ix+1);
+                    s3 = n*(iy+1)+(ix+1);
+                    s4 = n*(iy+1)+ix;
+                    a(0) = +1*c.c(sf+s1);
+                    a(1) = +1*c.c(sfy+s1)/du;
+                    a(2) = -3*c.c(sf+s1)+3*c.c(sf+s4)-2*c.c(sfy+s1)/du-1*c.c(sfy+s4)/du;
+                    a(3) = +2*c.c(sf+s1)-2*c.c(sf+s4)+1*c.c(sfy+s1)/du+1*c.c(sfy+s4)/du;
+                    a(4) = +1*c.c(sfx+s1)/dt;
+                    a(5) = +1*c.c(sfxy+s1)/(dt*du);
+                    a(6) = -3*c.c(sfx+s1)/dt+3*c.c(sfx+s4)/dt-2*c.c(sfxy+s1)/(dt*du)-1*c.c(sfxy+s4)/(dt*du);
+                    a(7) = +2*c.c(sfx+s1)/dt-2*c.c(sfx+s4)/dt+1*c.c(sfxy+s1)/(dt*du)+1*c.c(sfxy+s4)/(dt*du);
+                    a(8) = -3*c.c(sf+s1)+3*c.c(sf+s2)-2*c.c(sfx+s1)/dt-1*c.c(sfx+s2)/dt;
+                    a(9) = -3*c.c(sfy+s1)/du+3*c.c(sfy+s2)/du-2*c.c(sfxy+s1)/(dt*du)-1*c.c(sfxy+s2)/(dt*du);
+                    a(10) = +9*c.c(sf+s1)-9*c.c(sf+s2)+9*c.c(sf+s3)-9*c.c(sf+s4)+6*c.c(sfx+s1)/dt+3*c.c(sfx+s2)/dt-3*c.c(sfx+s3)/dt-6*c.c(sfx+s4)/dt+6*c.c(sfy+s1)/du-6*c.c(sfy+s2)/du-3*c.c(sfy+s3)/du+3*c.c(sfy+s4)/du+4*c.c(sfxy+s1)/(dt*du)+2*c.c(sfxy+s2)/(dt*du)+1*c.c(sfxy+s3)/(dt*du)+2*c.c(sfxy+s4)/(dt*du);
+                    a(11) = -6*c.c(sf+s1)+6*c.c(sf+s2)-6*c.c(sf+s3)+6*c.c(sf+s4)-4*c.c(sfx+s1)/dt-2*c.c(sfx+s2)/dt+2*c.c(sfx+s3)/dt+4*c.c(sfx+s4)/dt-3*c.c(sfy+s1)/du+3*c.c(sfy+s2)/du+3*c.c(sfy+s3)/du-3*c.c(sfy+s4)/du-2*c.c(sfxy+s1)/(dt*du)-1*c.c(sfxy+s2)/(dt*du)-1*c.c(sfxy+s3)/(dt*du)-2*c.c(sfxy+s4)/(dt*du);
+                    a(12) = +2*c.c(sf+s1)-2*c.c(sf+s2)+1*c.c(sfx+s1)/dt+1*c.c(sfx+s2)/dt;
+                    a(13) = +2*c.c(sfy+s1)/du-2*c.c(sfy+s2)/du+1*c.c(sfxy+s1)/(dt*du)+1*c.c(sfxy+s2)/(dt*du);
+                    a(14) = -6*c.c(sf+s1)+6*c.c(sf+s2)-6*c.c(sf+s3)+6*c.c(sf+s4)-3*c.c(sfx+s1)/dt-3*c.c(sfx+s2)/dt+3*c.c(sfx+s3)/dt+3*c.c(sfx+s4)/dt-4*c.c(sfy+s1)/du+4*c.c(sfy+s2)/du+2*c.c(sfy+s3)/du-2*c.c(sfy+s4)/du-2*c.c(sfxy+s1)/(dt*du)-2*c.c(sfxy+s2)/(dt*du)-1*c.c(sfxy+s3)/(dt*du)-1*c.c(sfxy+s4)/(dt*du);
+                    a(15) = +4*c.c(sf+s1)-4*c.c(sf+s2)+4*c.c(sf+s3)-4*c.c(sf+s4)+2*c.c(sfx+s1)/dt+2*c.c(sfx+s2)/dt-2*c.c(sfx+s3)/dt-2*c.c(sfx+s4)/dt+2*c.c(sfy+s1)/du-2*c.c(sfy+s2)/du-2*c.c(sfy+s3)/du+2*c.c(sfy+s4)/du+1*c.c(sfxy+s1)/(dt*du)+1*c.c(sfxy+s2)/(dt*du)+1*c.c(sfxy+s3)/(dt*du)+1*c.c(sfxy+s4)/(dt*du);
+                    cx = ix;
+                    cy = iy;
+                }
+                t0 = 1;
+                t1 = t;
+                t2 = ap::sqr(t);
+                t3 = t*t2;
+                u0 = 1;
+                u1 = u;
+                u2 = ap::sqr(u);
+                u3 = u*u2;
+                v = 0;
+                v = v+a(0)*t0*u0;
+                v = v+a(1)*t0*u1;
+                v = v+a(2)*t0*u2;
+                v = v+a(3)*t0*u3;
+                v = v+a(4)*t1*u0;
+                v = v+a(5)*t1*u1;
+                v = v+a(6)*t1*u2;
+                v = v+a(7)*t1*u3;
+                v = v+a(8)*t2*u0;
+                v = v+a(9)*t2*u1;
+                v = v+a(10)*t2*u2;
+                v = v+a(11)*t2*u3;
+                v = v+a(12)*t3*u0;
+                v = v+a(13)*t3*u1;
+                v = v+a(14)*t3*u2;
+                v = v+a(15)*t3*u3;
+                f(i) = v;
+            }
+        }
+    }
+}
+
+
 /*************************************************************************
 This subroutine calculates the value of the bilinear or bicubic spline  at
 the given point X and its derivatives.
@@ -1202,5 +1443,20 @@ static void bicubiccalcderivatives(const ap::real_2d_array& a,
 }
 
 
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool spline2dparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,spline2dparallelwork);
+#endif
+    return result;
+}
 
 
@@ -128,6 +128,35 @@ Result:
 double spline2dcalc(const spline2dinterpolant& c, double x, double y);
 
 
+/*************************************************************************
+This subroutine calculates the values of the bilinear or bicubic spline at
+the points (X[i],Y[i]), i=0..NPoints-1.
+
+Same as Spline2DCalc() called for each point, result is the same too, but:
+* interval search on uniform grids is O(1), on non-uniform ones it starts
+  from the cell of the previous point, so the points which are sorted (or
+  close to each other, like scanlines of the image) are located in O(1)
+* coefficients of the bicubic polynomial are calculated once per cell and
+  reused while the following points stay in the same cell
+Points are processed by blocks, blocks are distributed between threads when
+OpenMP is on.
+
+Input parameters:
+    C       -   spline interpolant.
+    X, Y    -   points, array[0..NPoints-1], in any order
+    NPoints -   number of points, NPoints>=0
+
+Output parameters:
+    F       -   S(X[i],Y[i]), array[0..NPoints-1]. Allocated by the
+                subroutine.
+*************************************************************************/
+void spline2dcalcv(const spline2dinterpolant& c,
+     const ap::real_1d_array& x,
+     const ap::real_1d_array& y,
+     int npoints,
+     ap::real_1d_array& f);
+
+
 /*************************************************************************
 This subroutine calculates the value of the bilinear or bicubic spline  at
 the given point X and its derivatives.
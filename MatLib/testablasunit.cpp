@@ -29,6 +29,7 @@ static bool testtrans(int minn, int maxn);
 static bool testrank1(int minn, int maxn);
 static bool testmv(int minn, int maxn);
 static bool testcopy(int minn, int maxn);
+static bool testlarge(int minn, int maxn, int passcount);
 
 bool testablas(bool silent)
 {
@@ -41,6 +42,7 @@ bool testablas(bool silent)
     bool rank1errors;
     bool mverrors;
     bool copyerrors;
+    bool largeerrors;
     bool waserrors;
     ap::real_2d_array ra;
 
@@ -51,6 +53,7 @@ bool testablas(bool silent)
     rank1errors = false;
     mverrors = false;
     copyerrors = false;
+    largeerrors = false;
     waserrors = false;
     threshold = 10000*ap::machineepsilon;
     trsmerrors = trsmerrors||testtrsm(1, 3*ablasblocksize(ra)+1);
@@ -60,11 +63,12 @@ bool testablas(bool silent)
     rank1errors = rank1errors||testrank1(1, 3*ablasblocksize(ra)+1);
     mverrors = mverrors||testmv(1, 3*ablasblocksize(ra)+1);
     copyerrors = copyerrors||testcopy(1, 3*ablasblocksize(ra)+1);
+    largeerrors = largeerrors||testlarge(4*ablasblocksize(ra), 10*ablasblocksize(ra), 3);
     
     //
     // report
     //
-    waserrors = trsmerrors||syrkerrors||gemmerrors||transerrors||rank1errors||mverrors||copyerrors;
+    waserrors = trsmerrors||syrkerrors||gemmerrors||transerrors||rank1errors||mverrors||copyerrors||largeerrors;
     if( !silent )
     {
         printf("TESTING ABLAS\n");
@@ -131,6 +135,15 @@ bool testablas(bool silent)
         {
             printf("OK\n");
         }
+        printf("* LARGE (PACKED/PARALLEL):               ");
+        if( largeerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
         if( waserrors )
         {
             printf("TEST FAILED\n");
@@ -2483,6 +2496,135 @@ static bool testcopy(int minn, int maxn)
 }
 
 
+/*************************************************************************
+Real GEMM/SYRK/TRSM on large matrices, where packed kernel and parallel
+splitting of the problem are used.
+
+Returns False for passed test, True - for failed
+*************************************************************************/
+static bool testlarge(int minn, int maxn, int passcount)
+{
+    bool result;
+    int pass;
+    int m;
+    int n;
+    int k;
+    int i;
+    int j;
+    int optypea;
+    int optypeb;
+    bool isupper;
+    bool isunit;
+    double alpha;
+    double beta;
+    ap::real_2d_array a;
+    ap::real_2d_array b;
+    ap::real_2d_array c1;
+    ap::real_2d_array c2;
+    double threshold;
+
+    threshold = ap::sqr(double(maxn))*100*ap::machineepsilon;
+    result = false;
+    for(pass = 1; pass <= passcount; pass++)
+    {
+        m = minn+ap::randominteger(maxn-minn+1);
+        n = minn+ap::randominteger(maxn-minn+1);
+        k = minn+ap::randominteger(maxn-minn+1);
+        
+        //
+        // A/B/C are (MaxN+1)x(MaxN+1) matrices, submatrices start at (1,1)
+        //
+        a.setlength(maxn+1, maxn+1);
+        b.setlength(maxn+1, maxn+1);
+        c1.setlength(maxn+1, maxn+1);
+        c2.setlength(maxn+1, maxn+1);
+        alpha = 2*ap::randomreal()-1;
+        beta = ap::randominteger(2)*(2*ap::randomreal()-1);
+        for(i = 0; i <= maxn; i++)
+        {
+            for(j = 0; j <= maxn; j++)
+            {
+                a(i,j) = 2*ap::randomreal()-1;
+                b(i,j) = 2*ap::randomreal()-1;
+                c1(i,j) = 2*ap::randomreal()-1;
+                c2(i,j) = c1(i,j);
+            }
+        }
+        
+        //
+        // GEMM
+        //
+        optypea = ap::randominteger(2);
+        optypeb = ap::randominteger(2);
+        rmatrixgemm(m, n, k, alpha, a, 1, 1, optypea, b, 1, 1, optypeb, beta, c1, 1, 1);
+        refrmatrixgemm(m, n, k, alpha, a, 1, 1, optypea, b, 1, 1, optypeb, beta, c2, 1, 1);
+        for(i = 0; i <= maxn; i++)
+        {
+            for(j = 0; j <= maxn; j++)
+            {
+                result = result||ap::fp_greater(fabs(c1(i,j)-c2(i,j)),threshold);
+            }
+        }
+        
+        //
+        // SYRK
+        //
+        optypea = ap::randominteger(2);
+        isupper = ap::fp_greater(ap::randomreal(),0.5);
+        for(i = 0; i <= maxn; i++)
+        {
+            for(j = 0; j <= maxn; j++)
+            {
+                c2(i,j) = c1(i,j);
+            }
+        }
+        rmatrixsyrk(n, k, alpha, a, 1, 1, optypea, beta, c1, 1, 1, isupper);
+        refrmatrixsyrk(n, k, alpha, a, 1, 1, optypea, beta, c2, 1, 1, isupper);
+        for(i = 0; i <= maxn; i++)
+        {
+            for(j = 0; j <= maxn; j++)
+            {
+                result = result||ap::fp_greater(fabs(c1(i,j)-c2(i,j)),threshold);
+            }
+        }
+        
+        //
+        // TRSM: A is diagonally dominant
+        //
+        optypea = ap::randominteger(2);
+        isupper = ap::fp_greater(ap::randomreal(),0.5);
+        isunit = ap::fp_greater(ap::randomreal(),0.5);
+        for(i = 0; i <= maxn; i++)
+        {
+            for(j = 0; j <= maxn; j++)
+            {
+                a(i,j) = 0.2*ap::randomreal()-0.1;
+            }
+            a(i,i) = (2*ap::randominteger(2)-1)*(2*maxn+ap::randomreal());
+        }
+        for(i = 0; i <= maxn; i++)
+        {
+            for(j = 0; j <= maxn; j++)
+            {
+                c2(i,j) = c1(i,j);
+            }
+        }
+        rmatrixlefttrsm(m, n, a, 1, 1, isupper, isunit, optypea, c1, 1, 1);
+        refrmatrixlefttrsm(m, n, a, 1, 1, isupper, isunit, optypea, c2, 1, 1);
+        rmatrixrighttrsm(m, n, a, 1, 1, isupper, isunit, optypea, c1, 1, 1);
+        refrmatrixrighttrsm(m, n, a, 1, 1, isupper, isunit, optypea, c2, 1, 1);
+        for(i = 0; i <= maxn; i++)
+        {
+            for(j = 0; j <= maxn; j++)
+            {
+                result = result||ap::fp_greater(fabs(c1(i,j)-c2(i,j)),threshold);
+            }
+        }
+    }
+    return result;
+}
+
+
 /*************************************************************************
 Silent unit test
 *************************************************************************/
@@ -3,6 +3,13 @@
 #include <stdio.h>
 #include "testautogk.h"
 
+static void testbatch(bool& batcherrors, bool& vectorerrors);
+static void initproblem(int mode,
+     double a,
+     double b,
+     double alpha,
+     autogkstate& state);
+
 /*************************************************************************
 Test
 *************************************************************************/
@@ -21,10 +28,14 @@ bool testautogkunit(bool silent)
     double errtol;
     bool simpleerrors;
     bool sngenderrors;
+    bool batcherrors;
+    bool vectorerrors;
     bool waserrors;
 
     simpleerrors = false;
     sngenderrors = false;
+    batcherrors = false;
+    vectorerrors = false;
     waserrors = false;
     errtol = 10000*ap::machineepsilon;
     
@@ -116,6 +127,41 @@ bool testautogkunit(bool silent)
         simpleerrors = simpleerrors||ap::fp_greater(fabs(exact-v),errtol*eabs);
     }
     
+    //
+    // Simple test: integral(|x-0.3|,-1,3) and integral(|x-0.3|,-2,0.5),
+    // XWidth=0.1 (many subintervals in the initial partition, the worst
+    // one is not the first)
+    //
+    for(pkind = 0; pkind <= 1; pkind++)
+    {
+        if( pkind==0 )
+        {
+            a = -1;
+            b = 3;
+        }
+        else
+        {
+            a = -2;
+            b = 0.5;
+        }
+        autogksmoothw(a, b, 0.1, state);
+        while(autogkiteration(state))
+        {
+            state.f = fabs(state.x-0.3);
+        }
+        autogkresults(state, v, rep);
+        exact = 0.5*(ap::sqr(0.3-a)+ap::sqr(b-0.3));
+        eabs = exact;
+        if( rep.terminationtype<=0 )
+        {
+            simpleerrors = true;
+        }
+        else
+        {
+            simpleerrors = simpleerrors||ap::fp_greater(fabs(exact-v),errtol*eabs);
+        }
+    }
+    
     //
     // singular problem on [a,b] = [0.1, 0.5]
     //     f2(x) = (1+x)*(b-x)^alpha, -1 < alpha < 1
@@ -254,10 +300,15 @@ bool testautogkunit(bool silent)
         }
     }
     
+    //
+    // batch and vector modes
+    //
+    testbatch(batcherrors, vectorerrors);
+    
     //
     // end
     //
-    waserrors = simpleerrors||sngenderrors;
+    waserrors = simpleerrors||sngenderrors||batcherrors||vectorerrors;
     if( !silent )
     {
         printf("TESTING AUTOGK\n");
@@ -288,6 +339,24 @@ bool testautogkunit(bool silent)
         {
             printf("OK\n");
         }
+        printf("BATCH MODE:                               ");
+        if( batcherrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("VECTOR MODE:                              ");
+        if( vectorerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
         if( waserrors )
         {
             printf("TEST FAILED\n");
@@ -327,5 +396,196 @@ bool testautogk_test()
 }
 
 
+/*************************************************************************
+Batch mode with one integrand must give same results as point-by-point
+mode, vector mode is tested against exact integrals of several functions
+of very different magnitudes (one of them is zero).
+
+Modes: 0 - smooth, 1 - smooth with XWidth, 2 - singular at A.
+Integrands are (1+J*x)*(x-A)^Alpha for singular problems, exp(C_J*x)
+otherwise.
+*************************************************************************/
+static void testbatch(bool& batcherrors, bool& vectorerrors)
+{
+    autogkstate state;
+    autogkreport rep;
+    autogkreport rep2;
+    ap::real_1d_array vv;
+    ap::real_1d_array sc;
+    double v;
+    double v2;
+    double a;
+    double b;
+    double alpha;
+    double exact;
+    double errtol;
+    int mode;
+    int pass;
+    int nfunc;
+    int i;
+    int j;
+
+    errtol = 10000*ap::machineepsilon;
+    for(pass = 1; pass <= 30; pass++)
+    {
+        mode = ap::randominteger(3);
+        a = 2*ap::randomreal()-1;
+        b = a+0.5+ap::randomreal();
+        alpha = -0.9+1.8*ap::randomreal();
+        
+        //
+        // point-by-point vs. batch
+        //
+        initproblem(mode, a, b, alpha, state);
+        while(autogkiteration(state))
+        {
+            if( mode==2 )
+            {
+                state.f = (1+state.x)*pow(state.xminusa, alpha);
+            }
+            else
+            {
+                state.f = exp(state.x);
+            }
+        }
+        autogkresults(state, v, rep);
+        initproblem(mode, a, b, alpha, state);
+        autogksetbatch(state, 1);
+        while(autogkiteration(state))
+        {
+            batcherrors = batcherrors||state.nx<1;
+            for(i = 0; i <= state.nx-1; i++)
+            {
+                batcherrors = batcherrors||ap::fp_greater(fabs(state.xb(i)-a-state.xminusab(i)),1.0E-14);
+                batcherrors = batcherrors||ap::fp_greater(fabs(b-state.xb(i)-state.bminusxb(i)),1.0E-14);
+                if( mode==2 )
+                {
+                    state.fb(i,0) = (1+state.xb(i))*pow(state.xminusab(i), alpha);
+                }
+                else
+                {
+                    state.fb(i,0) = exp(state.xb(i));
+                }
+            }
+        }
+        autogkresults(state, v2, rep2);
+        batcherrors = batcherrors||ap::fp_neq(v,v2);
+        batcherrors = batcherrors||rep.terminationtype!=rep2.terminationtype;
+        batcherrors = batcherrors||rep.nfev!=rep2.nfev;
+        batcherrors = batcherrors||rep.nintervals!=rep2.nintervals;
+        
+        //
+        // vector mode
+        //
+        nfunc = 1+ap::randominteger(6);
+        sc.setlength(nfunc);
+        for(j = 0; j <= nfunc-1; j++)
+        {
+            sc(j) = pow(double(10), -3*ap::randominteger(3));
+        }
+        if( nfunc>=3 )
+        {
+            sc(nfunc-1) = 0;
+        }
+        initproblem(mode, a, b, alpha, state);
+        autogksetbatch(state, nfunc);
+        while(autogkiteration(state))
+        {
+            for(i = 0; i <= state.nx-1; i++)
+            {
+                for(j = 0; j <= nfunc-1; j++)
+                {
+                    if( mode==2 )
+                    {
+                        state.fb(i,j) = sc(j)*(1+j*state.xb(i))*pow(state.xminusab(i), alpha);
+                    }
+                    else
+                    {
+                        state.fb(i,j) = sc(j)*exp(0.5*(j+1)*state.xb(i));
+                    }
+                }
+            }
+        }
+        autogkresultsv(state, vv, rep);
+        if( rep.terminationtype<=0||vv.gethighbound()!=nfunc-1 )
+        {
+            vectorerrors = true;
+            continue;
+        }
+        for(j = 0; j <= nfunc-1; j++)
+        {
+            if( mode==2 )
+            {
+                exact = sc(j)*(j*pow(b-a, alpha+2)/(alpha+2)+(1+j*a)*pow(b-a, alpha+1)/(alpha+1));
+            }
+            else
+            {
+                exact = sc(j)*(exp(0.5*(j+1)*b)-exp(0.5*(j+1)*a))/(0.5*(j+1));
+            }
+            vectorerrors = vectorerrors||ap::fp_greater(fabs(vv(j)-exact),errtol*fabs(exact));
+        }
+    }
+    
+    //
+    // same state is reused with one integrand, then with 30 integrands
+    // (J+1)*|x-0.3|: bisections leave buffers with less rows than the
+    // initial partition needs, they must be reallocated for 30 columns
+    //
+    for(pass = 0; pass <= 1; pass++)
+    {
+        nfunc = 1+29*pass;
+        a = 0;
+        b = 1;
+        initproblem(1, a, b, 0.0, state);
+        autogksetbatch(state, nfunc);
+        while(autogkiteration(state))
+        {
+            for(i = 0; i <= state.nx-1; i++)
+            {
+                for(j = 0; j <= nfunc-1; j++)
+                {
+                    state.fb(i,j) = (j+1)*fabs(state.xb(i)-0.3);
+                }
+            }
+        }
+        autogkresultsv(state, vv, rep);
+        if( rep.terminationtype<=0||vv.gethighbound()!=nfunc-1 )
+        {
+            vectorerrors = true;
+            continue;
+        }
+        for(j = 0; j <= nfunc-1; j++)
+        {
+            exact = (j+1)*0.5*(ap::sqr(0.3-a)+ap::sqr(b-0.3));
+            vectorerrors = vectorerrors||ap::fp_greater(fabs(vv(j)-exact),errtol*fabs(exact));
+        }
+    }
+}
+
+
+/*************************************************************************
+Initializes integrator: 0 - smooth, 1 - smooth with XWidth, 2 - singular
+at A
+*************************************************************************/
+static void initproblem(int mode,
+     double a,
+     double b,
+     double alpha,
+     autogkstate& state)
+{
+
+    if( mode==0 )
+    {
+        autogksmooth(a, b, state);
+    }
+    if( mode==1 )
+    {
+        autogksmoothw(a, b, 0.1, state);
+    }
+    if( mode==2 )
+    {
+        autogksingular(a, b, alpha, 0.0, state);
+    }
+}
 
 
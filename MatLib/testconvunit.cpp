@@ -53,7 +53,16 @@ bool testconv(bool silent)
     bool refrerrors;
     bool inverrors;
     bool invrerrors;
+    bool streamerrors;
     bool waserrors;
+    double streamerr;
+    int method;
+    int k;
+    int cnt;
+    int l;
+    convr1dstream stream;
+    ap::real_1d_array rx;
+    ap::real_1d_array ry;
 
     maxn = 32;
     errtol = 100000*pow(double(maxn), double(3)/double(2))*ap::machineepsilon;
@@ -61,6 +70,7 @@ bool testconv(bool silent)
     refrerrors = false;
     inverrors = false;
     invrerrors = false;
+    streamerrors = false;
     waserrors = false;
     
     //
@@ -323,10 +333,71 @@ bool testconv(bool silent)
     inverrors = inverrors||ap::fp_greater(inverr,errtol);
     invrerrors = invrerrors||ap::fp_greater(invrerr,errtol);
     
+    //
+    // Test streaming convolution against reference implementation:
+    // * signal of length N is followed by zeros, so the whole
+    //   convolution is returned (with delay L)
+    // * signal is passed in chunks of random length
+    //
+    streamerr = 0;
+    for(m = 1; m <= maxn; m++)
+    {
+        for(method = 0; method <= 1; method++)
+        {
+            ra.setlength(m);
+            for(i = 0; i <= m-1; i++)
+            {
+                ra(i) = 2*ap::randomreal()-1;
+            }
+            if( ap::fp_greater(ap::randomreal(),0.5) )
+            {
+                convr1dstreamcreate(ra, m, 0, method, stream);
+            }
+            else
+            {
+                convr1dstreamcreate(ra, m, 1+ap::randominteger(2*m), method, stream);
+            }
+            l = stream.blocksize;
+            n = 1+ap::randominteger(8*maxn);
+            rb.setlength(n);
+            for(i = 0; i <= n-1; i++)
+            {
+                rb(i) = 2*ap::randomreal()-1;
+            }
+            refconvr1d(ra, m, rb, n, rr2);
+            rx.setlength(n+m+l);
+            ry.setlength(n+m+l);
+            for(i = 0; i <= n+m+l-1; i++)
+            {
+                rx(i) = 0;
+            }
+            ap::vmove(&rx(0), 1, &rb(0), 1, ap::vlen(0,n-1));
+            rr1.setlength(n+m+l);
+            k = 0;
+            while(k<n+m+l)
+            {
+                cnt = ap::minint(1+ap::randominteger(3*l), n+m+l-k);
+                ap::vmove(&ry(0), 1, &rx(k), 1, ap::vlen(0,cnt-1));
+                convr1dstreamprocess(stream, ry, cnt, ry);
+                ap::vmove(&rr1(k), 1, &ry(0), 1, ap::vlen(k,k+cnt-1));
+                k = k+cnt;
+            }
+            for(i = 0; i <= l-1; i++)
+            {
+                streamerr = ap::maxreal(streamerr, fabs(rr1(i)));
+            }
+            for(i = 0; i <= m+n-2; i++)
+            {
+                streamerr = ap::maxreal(streamerr, fabs(rr1(l+i)-rr2(i)));
+            }
+        }
+    }
+    streamerrors = streamerrors||ap::fp_greater(streamerr,errtol);
+    
     //
     // end
     //
-    waserrors = referrors||refrerrors||inverrors||invrerrors;
+    waserrors = referrors||refrerrors||inverrors||invrerrors||streamerrors;
     if( !silent )
     {
         printf("TESTING CONVOLUTION\n");
@@ -375,6 +446,15 @@ bool testconv(bool silent)
         {
             printf("OK\n");
         }
+        printf("* STREAMING REAL CONV:                    ");
+        if( streamerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
         if( waserrors )
         {
             printf("TEST FAILED\n");
@@ -0,0 +1,276 @@
+
+
+ 
+#include <stdio.h>
+#include "testcorrelationunit.h"
+
+static void generatesample(ap::real_2d_array& x, int n, int m, bool ties);
+static bool testtopk(const ap::real_2d_array& x,
+     int n,
+     int m,
+     int k,
+     bool ranks,
+     const ap::real_2d_array& c);
+
+/*************************************************************************
+Testing correlation matrices
+*************************************************************************/
+bool testcorrelation(bool silent)
+{
+    bool result;
+    bool waserrors;
+    bool pcerrors;
+    bool sperrors;
+    bool tkerrors;
+    int n;
+    int m;
+    int k;
+    int i;
+    int j;
+    int pass;
+    double threshold;
+    ap::real_2d_array x;
+    ap::real_2d_array c;
+    ap::real_2d_array c2;
+    ap::real_1d_array x1;
+    ap::real_1d_array x2;
+
+    pcerrors = false;
+    sperrors = false;
+    tkerrors = false;
+    threshold = 1.0E-12;
+    
+    //
+    // Correlation matrices vs. PearsonCorrelation/SpearmanRankCorrelation
+    // (Spearman: with and without ties)
+    //
+    for(pass = 1; pass <= 20; pass++)
+    {
+        n = ap::randominteger(30);
+        m = 1+ap::randominteger(12);
+        generatesample(x, n, m, pass%2==0);
+        x1.setlength(ap::maxint(n, 1));
+        x2.setlength(ap::maxint(n, 1));
+        pearsoncorrm(x, n, m, c);
+        spearmancorrm(x, n, m, c2);
+        for(i = 0; i <= m-1; i++)
+        {
+            for(j = 0; j <= m-1; j++)
+            {
+                if( n>0 )
+                {
+                    ap::vmove(&x1(0), 1, &x(0, i), x.getstride(), ap::vlen(0,n-1));
+                    ap::vmove(&x2(0), 1, &x(0, j), x.getstride(), ap::vlen(0,n-1));
+                }
+                pcerrors = pcerrors||ap::fp_greater(fabs(c(i,j)-pearsoncorrelation(x1, x2, n)),threshold);
+                sperrors = sperrors||ap::fp_greater(fabs(c2(i,j)-spearmanrankcorrelation(x1, x2, n)),threshold);
+                pcerrors = pcerrors||ap::fp_neq(c(i,j),c(j,i));
+                sperrors = sperrors||ap::fp_neq(c2(i,j),c2(j,i));
+            }
+        }
+    }
+    
+    //
+    // Top-K: compared with full matrix. Large M to test several blocks.
+    //
+    for(pass = 1; pass <= 10; pass++)
+    {
+        n = ap::randominteger(20);
+        m = 2+ap::randominteger(20);
+        if( pass>=9 )
+        {
+            m = 300;
+        }
+        k = 1+ap::randominteger(m-1);
+        generatesample(x, n, m, pass%2==0);
+        pearsoncorrm(x, n, m, c);
+        tkerrors = tkerrors||!testtopk(x, n, m, k, false, c);
+        spearmancorrm(x, n, m, c);
+        tkerrors = tkerrors||!testtopk(x, n, m, k, true, c);
+    }
+    
+    //
+    // report
+    //
+    waserrors = pcerrors||sperrors||tkerrors;
+    if( !silent )
+    {
+        printf("TESTING CORRELATION\n");
+        printf("PEARSON MATRIX:                          ");
+        if( pcerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("SPEARMAN MATRIX:                         ");
+        if( sperrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("TOP-K:                                   ");
+        if( tkerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        if( waserrors )
+        {
+            printf("TEST FAILED\n");
+        }
+        else
+        {
+            printf("TEST PASSED\n");
+        }
+        printf("\n\n");
+    }
+    result = !waserrors;
+    return result;
+}
+
+
+/*************************************************************************
+Silent unit test
+*************************************************************************/
+bool testcorrelationunit_test_silent()
+{
+    bool result;
+
+    result = testcorrelation(true);
+    return result;
+}
+
+
+/*************************************************************************
+Unit test
+*************************************************************************/
+bool testcorrelationunit_test()
+{
+    bool result;
+
+    result = testcorrelation(false);
+    return result;
+}
+
+
+/*************************************************************************
+Sample: correlated variables (random combinations of two factors plus
+noise), with Ties=True values are rounded to few distinct levels. Some
+columns are constant.
+*************************************************************************/
+static void generatesample(ap::real_2d_array& x, int n, int m, bool ties)
+{
+    int i;
+    int j;
+    double a;
+    double b;
+    ap::real_1d_array f1;
+    ap::real_1d_array f2;
+
+    x.setlength(ap::maxint(n, 1), m);
+    f1.setlength(ap::maxint(n, 1));
+    f2.setlength(ap::maxint(n, 1));
+    for(i = 0; i <= n-1; i++)
+    {
+        f1(i) = 2*ap::randomreal()-1;
+        f2(i) = 2*ap::randomreal()-1;
+    }
+    for(j = 0; j <= m-1; j++)
+    {
+        a = 2*ap::randomreal()-1;
+        b = 2*ap::randomreal()-1;
+        for(i = 0; i <= n-1; i++)
+        {
+            x(i,j) = a*f1(i)+b*f2(i)+0.3*(2*ap::randomreal()-1);
+            if( ties )
+            {
+                x(i,j) = ap::round(3*x(i,j));
+            }
+            if( ap::randominteger(10)==0 )
+            {
+                x(i,j) = 5;
+            }
+        }
+        if( ap::randominteger(8)==0 )
+        {
+            for(i = 0; i <= n-1; i++)
+            {
+                x(i,j) = 1;
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+Top-K test: K distinct indexes different from I, values are equal to those
+from the full matrix C, sorted by absolute value, and K-th absolute value
+is not less than absolute value of any correlation which wasn't selected.
+*************************************************************************/
+static bool testtopk(const ap::real_2d_array& x,
+     int n,
+     int m,
+     int k,
+     bool ranks,
+     const ap::real_2d_array& c)
+{
+    bool result;
+    ap::integer_2d_array idx;
+    ap::real_2d_array ck;
+    ap::boolean_1d_array sel;
+    double threshold;
+    int i;
+    int j;
+
+    threshold = 1.0E-12;
+    if( ranks )
+    {
+        spearmancorrtopk(x, n, m, k, idx, ck);
+    }
+    else
+    {
+        pearsoncorrtopk(x, n, m, k, idx, ck);
+    }
+    result = true;
+    sel.setlength(m);
+    for(i = 0; i <= m-1; i++)
+    {
+        for(j = 0; j <= m-1; j++)
+        {
+            sel(j) = false;
+        }
+        for(j = 0; j <= k-1; j++)
+        {
+            if( idx(i,j)<0||idx(i,j)>=m||idx(i,j)==i||sel(idx(i,j)) )
+            {
+                result = false;
+                return result;
+            }
+            sel(idx(i,j)) = true;
+            result = result&&ap::fp_less_eq(fabs(ck(i,j)-c(i,idx(i,j))),threshold);
+            if( j>0 )
+            {
+                result = result&&ap::fp_less_eq(fabs(ck(i,j)),fabs(ck(i,j-1)));
+            }
+        }
+        for(j = 0; j <= m-1; j++)
+        {
+            if( j!=i&&!sel(j) )
+            {
+                result = result&&ap::fp_less_eq(fabs(c(i,j)),fabs(ck(i,k-1))+threshold);
+            }
+        }
+    }
+    return result;
+}
+
+
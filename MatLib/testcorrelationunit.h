@@ -0,0 +1,32 @@
+
+#ifndef _testcorrelationunit_h
+#define _testcorrelationunit_h
+
+#include "ap.h"
+#include "ialglib.h"
+
+#include "tsort.h"
+#include "ablasf.h"
+#include "ablas.h"
+#include "correlation.h"
+
+
+/*************************************************************************
+Testing correlation matrices
+*************************************************************************/
+bool testcorrelation(bool silent);
+
+
+/*************************************************************************
+Silent unit test
+*************************************************************************/
+bool testcorrelationunit_test_silent();
+
+
+/*************************************************************************
+Unit test
+*************************************************************************/
+bool testcorrelationunit_test();
+
+
+#endif
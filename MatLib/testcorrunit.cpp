@@ -72,6 +72,8 @@ bool testcorr(bool silent)
     bool inverrors;
     bool invrerrors;
     bool waserrors;
+    int l;
+    convr1dstream stream;
 
     maxn = 32;
     errtol = 100000*pow(double(maxn), double(3)/double(2))*ap::machineepsilon;
@@ -148,6 +150,25 @@ bool testcorr(bool silent)
             {
                 refrerr = ap::maxreal(refrerr, fabs(rr1(i)-rr2(i)));
             }
+            
+            //
+            // Streaming correlation: after delay L, Z[t]=R[t-N+1]
+            // for all t in [N-1,M-1]
+            //
+            corrr1dstreamcreate(rb, n, 0, ap::randominteger(2), stream);
+            l = stream.blocksize;
+            refcorrr1d(ra, m, rb, n, rr2);
+            rr1.setlength(m+l);
+            for(i = 0; i <= m+l-1; i++)
+            {
+                rr1(i) = 0;
+            }
+            ap::vmove(&rr1(0), 1, &ra(0), 1, ap::vlen(0,m-1));
+            convr1dstreamprocess(stream, rr1, m+l, rr1);
+            for(i = n-1; i <= m-1; i++)
+            {
+                refrerr = ap::maxreal(refrerr, fabs(rr1(l+i)-rr2(i-n+1)));
+            }
         }
     }
     referrors = referrors||ap::fp_greater(referr,errtol);
@@ -0,0 +1,495 @@
+
+
+
+#include <stdio.h>
+#include "testdescriptivestatisticsunit.h"
+
+static void refmoments(const ap::real_1d_array& x,
+     int n,
+     double& mean,
+     double& variance,
+     double& skewness,
+     double& kurtosis);
+static void generatesample(ap::real_1d_array& x, int n, int kind);
+static double rankerror(const ap::real_1d_array& xs, int n, double v, double p);
+
+/*************************************************************************
+Testing descriptive statistics
+*************************************************************************/
+bool testdescriptivestatistics(bool silent)
+{
+    bool result;
+    bool waserrors;
+    bool mmerrors;
+    bool aderrors;
+    bool mderrors;
+    bool pcerrors;
+    bool tderrors;
+    int pass;
+    int passcount;
+    int n;
+    int i;
+    int j;
+    int k;
+    int kind;
+    ap::real_1d_array x;
+    ap::real_1d_array x2;
+    ap::real_1d_array xs;
+    ap::real_1d_array p;
+    statmomentsstate ms;
+    statmomentsstate ms2;
+    tdigeststate td;
+    tdigeststate td2;
+    double mean;
+    double variance;
+    double skewness;
+    double kurtosis;
+    double mean2;
+    double variance2;
+    double skewness2;
+    double kurtosis2;
+    double v;
+    double v2;
+    double t;
+    double err;
+    double threshold;
+
+    waserrors = false;
+    mmerrors = false;
+    aderrors = false;
+    mderrors = false;
+    pcerrors = false;
+    tderrors = false;
+    passcount = 20;
+    threshold = 1.0E-10;
+    p.setlength(9);
+    p(0) = 0.0;
+    p(1) = 0.001;
+    p(2) = 0.01;
+    p(3) = 0.1;
+    p(4) = 0.5;
+    p(5) = 0.9;
+    p(6) = 0.99;
+    p(7) = 0.999;
+    p(8) = 1.0;
+    
+    //
+    // Moments and ADev: CalculateMoments() and accumulator (points added
+    // by arrays, one by one, merged from parts) against the reference
+    // implementation. Sizes include several chunks.
+    //
+    for(pass = 1; pass <= passcount; pass++)
+    {
+        for(kind = 0; kind <= 3; kind++)
+        {
+            if( pass%4==0 )
+            {
+                n = 1+ap::randominteger(20000);
+            }
+            else
+            {
+                n = 1+ap::randominteger(50);
+            }
+            generatesample(x, n, kind);
+            refmoments(x, n, mean, variance, skewness, kurtosis);
+            calculatemoments(x, n, mean2, variance2, skewness2, kurtosis2);
+            err = fabs(mean-mean2)/ap::maxreal(fabs(mean), 1);
+            err = ap::maxreal(err, fabs(variance-variance2)/ap::maxreal(variance, 1));
+            err = ap::maxreal(err, fabs(skewness-skewness2)/ap::maxreal(fabs(skewness), 1));
+            err = ap::maxreal(err, fabs(kurtosis-kurtosis2)/ap::maxreal(fabs(kurtosis), 1));
+            mmerrors = mmerrors||ap::fp_greater(err,threshold);
+            
+            //
+            // One by one
+            //
+            statmomentscreate(ms);
+            for(i = 0; i <= n-1; i++)
+            {
+                statmomentsadd(ms, x(i));
+            }
+            statmomentsresults(ms, mean2, variance2, skewness2, kurtosis2);
+            err = fabs(mean-mean2)/ap::maxreal(fabs(mean), 1);
+            err = ap::maxreal(err, fabs(variance-variance2)/ap::maxreal(variance, 1));
+            err = ap::maxreal(err, fabs(skewness-skewness2)/ap::maxreal(fabs(skewness), 1));
+            err = ap::maxreal(err, fabs(kurtosis-kurtosis2)/ap::maxreal(fabs(kurtosis), 1));
+            mmerrors = mmerrors||ap::fp_greater(err,threshold);
+            
+            //
+            // Two parts merged; the second one may be empty
+            //
+            k = ap::randominteger(n+1);
+            statmomentscreate(ms);
+            statmomentscreate(ms2);
+            statmomentsupdate(ms, x, k);
+            x2.setlength(n);
+            for(i = k; i <= n-1; i++)
+            {
+                x2(i-k) = x(i);
+            }
+            statmomentsupdate(ms2, x2, n-k);
+            statmomentsmerge(ms, ms2);
+            statmomentsresults(ms, mean2, variance2, skewness2, kurtosis2);
+            err = fabs(mean-mean2)/ap::maxreal(fabs(mean), 1);
+            err = ap::maxreal(err, fabs(variance-variance2)/ap::maxreal(variance, 1));
+            err = ap::maxreal(err, fabs(skewness-skewness2)/ap::maxreal(fabs(skewness), 1));
+            err = ap::maxreal(err, fabs(kurtosis-kurtosis2)/ap::maxreal(fabs(kurtosis), 1));
+            mmerrors = mmerrors||ap::fp_greater(err,threshold);
+            
+            //
+            // ADev
+            //
+            v = 0;
+            for(i = 0; i <= n-1; i++)
+            {
+                v = v+fabs(x(i)-mean);
+            }
+            v = v/n;
+            calculateadev(x, n, v2);
+            aderrors = aderrors||ap::fp_greater(fabs(v-v2)/ap::maxreal(v, 1),threshold);
+        }
+    }
+    
+    //
+    // Degenerate cases
+    //
+    x.setlength(1);
+    x(0) = 3;
+    calculatemoments(x, 0, mean, variance, skewness, kurtosis);
+    mmerrors = mmerrors||ap::fp_neq(mean,0)||ap::fp_neq(variance,0)||ap::fp_neq(skewness,0)||ap::fp_neq(kurtosis,0);
+    calculatemoments(x, 1, mean, variance, skewness, kurtosis);
+    mmerrors = mmerrors||ap::fp_neq(mean,3)||ap::fp_neq(variance,0)||ap::fp_neq(skewness,0)||ap::fp_neq(kurtosis,0);
+    
+    //
+    // Median and percentiles: exact order statistics, compared with the
+    // sorted sample. Samples with many equal values, sorted, reversed
+    // and organ-pipe ones are included. X must not be changed.
+    //
+    for(pass = 1; pass <= passcount; pass++)
+    {
+        for(kind = 0; kind <= 5; kind++)
+        {
+            if( pass%4==0 )
+            {
+                n = 2+ap::randominteger(20000);
+            }
+            else
+            {
+                n = 2+ap::randominteger(100);
+            }
+            generatesample(x, n, kind);
+            x2.setlength(n);
+            xs.setlength(n);
+            ap::vmove(&x2(0), 1, &x(0), 1, ap::vlen(0,n-1));
+            ap::vmove(&xs(0), 1, &x(0), 1, ap::vlen(0,n-1));
+            tagsortfast(xs, n);
+            calculatemedian(x, n, v);
+            if( n%2==1 )
+            {
+                v2 = xs(n/2);
+            }
+            else
+            {
+                v2 = 0.5*(xs(n/2-1)+xs(n/2));
+            }
+            mderrors = mderrors||ap::fp_neq(v,v2);
+            for(j = 0; j <= 8; j++)
+            {
+                calculatepercentile(x, n, p(j), v);
+                if( j==8 )
+                {
+                    v2 = xs(n-1);
+                }
+                else
+                {
+                    t = p(j)*(n-1);
+                    i = ap::ifloor(t);
+                    t = t-i;
+                    v2 = xs(i)*(1-t)+xs(i+1)*t;
+                }
+                pcerrors = pcerrors||ap::fp_greater(fabs(v-v2),1.0E-14*ap::maxreal(fabs(v2), 1));
+            }
+            for(i = 0; i <= n-1; i++)
+            {
+                mderrors = mderrors||ap::fp_neq(x(i),x2(i));
+            }
+        }
+    }
+    x.setlength(1);
+    x(0) = 5;
+    calculatemedian(x, 1, v);
+    mderrors = mderrors||ap::fp_neq(v,5);
+    
+    //
+    // t-digest: rank error of the quantile estimates, exact minimum and
+    // maximum, sketch merged from several parts.
+    //
+    for(pass = 1; pass <= 5; pass++)
+    {
+        for(kind = 0; kind <= 2; kind++)
+        {
+            n = 20000+ap::randominteger(20000);
+            generatesample(x, n, kind);
+            xs.setlength(n);
+            ap::vmove(&xs(0), 1, &x(0), 1, ap::vlen(0,n-1));
+            tagsortfast(xs, n);
+            tdigestcreate(100, td);
+            if( pass%2==0 )
+            {
+                tdigestupdate(td, x, n);
+            }
+            else
+            {
+                
+                //
+                // Four parts: three merged sketches, and points
+                // added one by one
+                //
+                k = n/4;
+                x2.setlength(k);
+                for(j = 0; j <= 2; j++)
+                {
+                    tdigestcreate(50+50*j, td2);
+                    ap::vmove(&x2(0), 1, &x(j*k), 1, ap::vlen(0,k-1));
+                    tdigestupdate(td2, x2, k);
+                    tdigestmerge(td, td2);
+                }
+                for(i = 3*k; i <= n-1; i++)
+                {
+                    tdigestadd(td, x(i));
+                }
+            }
+            tderrors = tderrors||ap::fp_neq(tdigestquantile(td, 0.0),xs(0));
+            tderrors = tderrors||ap::fp_neq(tdigestquantile(td, 1.0),xs(n-1));
+            for(j = 1; j <= 7; j++)
+            {
+                v = tdigestquantile(td, p(j));
+                err = rankerror(xs, n, v, p(j));
+                if( j==4 )
+                {
+                    tderrors = tderrors||ap::fp_greater(err,0.01);
+                }
+                else
+                {
+                    tderrors = tderrors||ap::fp_greater(err,0.5*ap::minreal(p(j), 1-p(j))+0.002);
+                }
+            }
+        }
+    }
+    
+    //
+    // report
+    //
+    waserrors = mmerrors||aderrors||mderrors||pcerrors||tderrors;
+    if( !silent )
+    {
+        printf("TESTING DESCRIPTIVE STATISTICS\n");
+        printf("MOMENTS:                                 ");
+        if( mmerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("ADEV:                                    ");
+        if( aderrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("MEDIAN:                                  ");
+        if( mderrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("PERCENTILES:                             ");
+        if( pcerrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        printf("T-DIGEST:                                ");
+        if( tderrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
+        if( waserrors )
+        {
+            printf("TEST FAILED\n");
+        }
+        else
+        {
+            printf("TEST PASSED\n");
+        }
+        printf("\n\n");
+    }
+    result = !waserrors;
+    return result;
+}
+
+
+/*************************************************************************
+Silent unit test
+*************************************************************************/
+bool testdescriptivestatisticsunit_test_silent()
+{
+    bool result;
+
+    result = testdescriptivestatistics(true);
+    return result;
+}
+
+
+/*************************************************************************
+Unit test
+*************************************************************************/
+bool testdescriptivestatisticsunit_test()
+{
+    bool result;
+
+    result = testdescriptivestatistics(false);
+    return result;
+}
+
+
+/*************************************************************************
+Reference moments: two-pass algorithm
+*************************************************************************/
+static void refmoments(const ap::real_1d_array& x,
+     int n,
+     double& mean,
+     double& variance,
+     double& skewness,
+     double& kurtosis)
+{
+    int i;
+    double v;
+    double stddev;
+
+    mean = 0;
+    variance = 0;
+    skewness = 0;
+    kurtosis = 0;
+    for(i = 0; i <= n-1; i++)
+    {
+        mean = mean+x(i);
+    }
+    mean = mean/n;
+    if( n>1 )
+    {
+        for(i = 0; i <= n-1; i++)
+        {
+            variance = variance+ap::sqr(x(i)-mean);
+        }
+        variance = variance/(n-1);
+    }
+    stddev = sqrt(variance);
+    if( ap::fp_neq(stddev,0) )
+    {
+        for(i = 0; i <= n-1; i++)
+        {
+            v = (x(i)-mean)/stddev;
+            skewness = skewness+v*v*v;
+            kurtosis = kurtosis+ap::sqr(v*v);
+        }
+        skewness = skewness/n;
+        kurtosis = kurtosis/n-3;
+    }
+}
+
+
+/*************************************************************************
+Sample of size N:
+* Kind=0    uniform in [-1,+1]
+* Kind=1    skewed (exponential), shifted far from zero
+* Kind=2    sorted
+* Kind=3    few distinct values
+* Kind=4    reversed
+* Kind=5    organ-pipe
+*************************************************************************/
+static void generatesample(ap::real_1d_array& x, int n, int kind)
+{
+    int i;
+
+    x.setlength(n);
+    for(i = 0; i <= n-1; i++)
+    {
+        if( kind==0 )
+        {
+            x(i) = 2*ap::randomreal()-1;
+        }
+        if( kind==1 )
+        {
+            x(i) = 1000-log(1-ap::randomreal());
+        }
+        if( kind==2 )
+        {
+            x(i) = i;
+        }
+        if( kind==3 )
+        {
+            x(i) = ap::randominteger(5);
+        }
+        if( kind==4 )
+        {
+            x(i) = n-i;
+        }
+        if( kind==5 )
+        {
+            x(i) = ap::minint(i, n-1-i);
+        }
+    }
+}
+
+
+/*************************************************************************
+Distance between P and the range of ranks of V in the sorted sample XS
+*************************************************************************/
+static double rankerror(const ap::real_1d_array& xs, int n, double v, double p)
+{
+    double result;
+    int i;
+    int cntless;
+    int cntle;
+
+    cntless = 0;
+    cntle = 0;
+    for(i = 0; i <= n-1; i++)
+    {
+        if( ap::fp_less(xs(i),v) )
+        {
+            cntless = cntless+1;
+        }
+        if( ap::fp_less_eq(xs(i),v) )
+        {
+            cntle = cntle+1;
+        }
+    }
+    result = 0;
+    if( ap::fp_less(p,double(cntless)/double(n)) )
+    {
+        result = double(cntless)/double(n)-p;
+    }
+    if( ap::fp_greater(p,double(cntle)/double(n)) )
+    {
+        result = p-double(cntle)/double(n);
+    }
+    return result;
+}
+
+
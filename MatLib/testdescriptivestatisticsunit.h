@@ -0,0 +1,31 @@
+
+#ifndef _testdescriptivestatisticsunit_h
+#define _testdescriptivestatisticsunit_h
+
+#include "ap.h"
+#include "ialglib.h"
+
+#include "tsort.h"
+#include "descriptivestatistics.h"
+
+
+/*************************************************************************
+Testing descriptive statistics
+*************************************************************************/
+bool testdescriptivestatistics(bool silent);
+
+
+/*************************************************************************
+Silent unit test
+*************************************************************************/
+bool testdescriptivestatisticsunit_test_silent();
+
+
+/*************************************************************************
+Unit test
+*************************************************************************/
+bool testdescriptivestatisticsunit_test();
+
+
+#endif
+
@@ -38,7 +38,16 @@ bool testfft(bool silent)
     bool refrerrors;
     bool bidirerrors;
     bool reinterrors;
+    bool batcherrors;
     bool waserrors;
+    double batcherr;
+    double v;
+    int m;
+    int j;
+    fftplan fplan;
+    ap::complex_1d_array ba;
+    ap::complex_1d_array bb;
+    ap::real_1d_array br;
 
     maxn = 128;
     errtol = 100000*pow(double(maxn), double(3)/double(2))*ap::machineepsilon;
@@ -47,6 +56,7 @@ bool testfft(bool silent)
     bidirerrors = false;
     refrerrors = false;
     reinterrors = false;
+    batcherrors = false;
     waserrors = false;
     
     //
@@ -245,10 +255,107 @@ bool testfft(bool silent)
     }
     reinterrors = reinterrors||ap::fp_greater(reinterr,errtol);
     
+    //
+    // test batch transforms with plans: M signals are transformed
+    // with one plan, results are compared with FFTC1D/FFTR1D  and
+    // their inverses applied to each signal
+    //
+    batcherr = 0;
+    for(n = 1; n <= maxn; n++)
+    {
+        m = 1+ap::randominteger(3);
+        ba.setlength(m*n);
+        bb.setlength(m*n);
+        br.setlength(m*n);
+        for(i = 0; i <= m*n-1; i++)
+        {
+            ba(i).x = 2*ap::randomreal()-1;
+            ba(i).y = 2*ap::randomreal()-1;
+            br(i) = 2*ap::randomreal()-1;
+        }
+        
+        //
+        // complex FFT and inverse FFT
+        //
+        fftc1dcreateplan(n, fplan);
+        for(i = 0; i <= m*n-1; i++)
+        {
+            bb(i) = ba(i);
+        }
+        fftc1dbatch(fplan, bb, m);
+        for(k = 0; k <= m-1; k++)
+        {
+            a1.setlength(n);
+            for(i = 0; i <= n-1; i++)
+            {
+                a1(i) = ba(k*n+i);
+            }
+            fftc1d(a1, n);
+            for(i = 0; i <= n-1; i++)
+            {
+                batcherr = ap::maxreal(batcherr, ap::abscomplex(a1(i)-bb(k*n+i)));
+            }
+        }
+        fftc1dinvbatch(fplan, bb, m);
+        for(i = 0; i <= m*n-1; i++)
+        {
+            batcherr = ap::maxreal(batcherr, ap::abscomplex(ba(i)-bb(i)));
+        }
+        
+        //
+        // real FFT and inverse FFT
+        //
+        fftr1dcreateplan(n, fplan);
+        fftr1dbatch(fplan, br, m, bb);
+        for(k = 0; k <= m-1; k++)
+        {
+            r1.setlength(n);
+            ap::vmove(&r1(0), 1, &br(k*n), 1, ap::vlen(0,n-1));
+            fftr1d(r1, n, a1);
+            for(i = 0; i <= n-1; i++)
+            {
+                batcherr = ap::maxreal(batcherr, ap::abscomplex(a1(i)-bb(k*n+i)));
+            }
+        }
+        fftr1dinvbatch(fplan, bb, m, r2);
+        for(i = 0; i <= m*n-1; i++)
+        {
+            batcherr = ap::maxreal(batcherr, fabs(br(i)-r2(i)));
+        }
+    }
+    
+    //
+    // concurrent FFT's of different sizes share the plan cache,
+    // results are compared with the reference FFT
+    //
+    #pragma omp parallel for private(n, i, j, a1, a2, v) schedule(dynamic,1)
+    for(k = 0; k <= 4*maxn-1; k++)
+    {
+        n = 1+k%maxn;
+        a1.setlength(n);
+        a2.setlength(n);
+        for(i = 0; i <= n-1; i++)
+        {
+            a1(i).x = sin(double(k+i));
+            a1(i).y = cos(double(k*i));
+            a2(i) = a1(i);
+        }
+        fftc1d(a1, n);
+        reffftc1d(a2, n);
+        v = 0;
+        for(j = 0; j <= n-1; j++)
+        {
+            v = ap::maxreal(v, ap::abscomplex(a1(j)-a2(j)));
+        }
+        #pragma omp critical (testfft_batcherr)
+        batcherr = ap::maxreal(batcherr, v);
+    }
+    batcherrors = batcherrors||ap::fp_greater(batcherr,errtol);
+    
     //
     // end
     //
-    waserrors = bidierrors||bidirerrors||referrors||refrerrors||reinterrors;
+    waserrors = bidierrors||bidirerrors||referrors||refrerrors||reinterrors||batcherrors;
     if( !silent )
     {
         printf("TESTING FFT\n");
@@ -306,6 +413,15 @@ bool testfft(bool silent)
         {
             printf("OK\n");
         }
+        printf("* BATCH FFT WITH PLANS:                   ");
+        if( batcherrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
         if( waserrors )
         {
             printf("TEST FAILED\n");
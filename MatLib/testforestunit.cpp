@@ -2,6 +2,9 @@
  
 #include <stdio.h>
 #include "testforestunit.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static void testprocessing(bool& err);
 static void basictest1(int nvars, int nclasses, int passcount, bool& err);
@@ -9,6 +12,7 @@ static void basictest2(bool& err);
 static void basictest3(bool& err);
 static void basictest4(bool& err);
 static void basictest5(bool& err);
+static void basictest6(bool& err);
 static double rnormal();
 static double rsphere(ap::real_2d_array& xy, int n, int i);
 static void unsetdf(decisionforest& df);
@@ -53,6 +57,7 @@ bool testforest(bool silent)
     basictest3(basicerrors);
     basictest4(basicerrors);
     basictest5(basicerrors);
+    basictest6(basicerrors);
     
     //
     // Final report
@@ -132,6 +137,9 @@ static void testprocessing(bool& err)
     ap::real_1d_array y2;
     ap::real_1d_array ra;
     ap::real_1d_array ra2;
+    ap::real_2d_array xb;
+    ap::real_2d_array yb;
+    int nb;
     double v;
 
     passcount = 100;
@@ -297,6 +305,39 @@ static void testprocessing(bool& err)
             }
             err = err||ap::fp_greater(fabs(v-1),1000*ap::machineepsilon);
         }
+        
+        //
+        // Batch processing gives same outputs as DFProcess
+        // (several blocks of rows, inputs from the training set and random ones)
+        //
+        nb = 1+ap::randominteger(300);
+        xb.setbounds(0, nb-1, 0, nvars-1);
+        for(i = 0; i <= nb-1; i++)
+        {
+            for(j = 0; j <= nvars-1; j++)
+            {
+                if( i<npoints )
+                {
+                    xb(i,j) = xy(i,j);
+                }
+                else
+                {
+                    xb(i,j) = 2*ap::randomreal()-1;
+                }
+            }
+        }
+        dfprocessbatch(df1, xb, nb, yb);
+        allsame = true;
+        for(i = 0; i <= nb-1; i++)
+        {
+            ap::vmove(&x1(0), 1, &xb(i, 0), 1, ap::vlen(0,nvars-1));
+            dfprocess(df1, x1, y1);
+            for(j = 0; j <= nclasses-1; j++)
+            {
+                allsame = allsame&&ap::fp_eq(yb(i,j),y1(j));
+            }
+        }
+        err = err||!allsame;
     }
 }
 
@@ -868,6 +909,89 @@ static void basictest5(bool& err)
 }
 
 
+/*************************************************************************
+Forest and OOB estimates do not depend on the number of threads: forest
+built by one thread is compared with the one built by all threads (task is
+large enough to be split between threads). Regression task, so OOB sums
+depend on the order of summation.
+*************************************************************************/
+static void basictest6(bool& err)
+{
+    ap::real_2d_array xy;
+    int nvars;
+    int nclasses;
+    int npoints;
+    int ntrees;
+    int nsample;
+    int nfeatures;
+    int i;
+    int j;
+    int info1;
+    int info2;
+    decisionforest df1;
+    decisionforest df2;
+    dfreport rep1;
+    dfreport rep2;
+#ifdef _OPENMP
+    int nthreads;
+#endif
+
+    
+    //
+    // Prepare task
+    //
+    npoints = 2000;
+    nvars = 3;
+    nclasses = 1;
+    ntrees = 100;
+    nsample = npoints/2;
+    nfeatures = 3;
+    xy.setbounds(0, npoints-1, 0, nvars);
+    for(i = 0; i <= npoints-1; i++)
+    {
+        for(j = 0; j <= nvars-1; j++)
+        {
+            xy(i,j) = 2*ap::randomreal()-1;
+        }
+        xy(i,nvars) = xy(i,0)*xy(i,1)+0.1*ap::randomreal();
+    }
+    
+    //
+    // Build with one thread and with all threads, same seed
+    //
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    srand(7);
+    dfbuildinternal(xy, npoints, nvars, nclasses, ntrees, nsample, nfeatures, 0, info1, df1, rep1);
+#ifdef _OPENMP
+    omp_set_num_threads(nthreads);
+#endif
+    srand(7);
+    dfbuildinternal(xy, npoints, nvars, nclasses, ntrees, nsample, nfeatures, 0, info2, df2, rep2);
+    if( info1<=0||info2<=0 )
+    {
+        err = true;
+        return;
+    }
+    
+    //
+    // Compare (exact)
+    //
+    err = err||df1.bufsize!=df2.bufsize;
+    for(i = 0; i <= ap::minint(df1.bufsize, df2.bufsize)-1; i++)
+    {
+        err = err||ap::fp_neq(df1.trees(i),df2.trees(i));
+    }
+    err = err||ap::fp_neq(rep1.oobrelclserror,rep2.oobrelclserror);
+    err = err||ap::fp_neq(rep1.oobavgce,rep2.oobavgce);
+    err = err||ap::fp_neq(rep1.oobrmserror,rep2.oobrmserror);
+    err = err||ap::fp_neq(rep1.oobavgerror,rep2.oobavgerror);
+    err = err||ap::fp_neq(rep1.oobavgrelerror,rep2.oobavgrelerror);
+}
+
+
 /*************************************************************************
 Random normal number
 *************************************************************************/
@@ -4,6 +4,10 @@
 #include "testhqrndunit.h"
 
 static void unsetstate(hqrndstate& state);
+static void testcounterbased(int samplesize,
+     double sigmathreshold,
+     bool& cberrors,
+     bool& skiperrors);
 
 void calculatemv(const ap::real_1d_array& x,
      int n,
@@ -100,6 +104,8 @@ bool testhqrnd(bool silent)
     double normsigmaerr;
     bool experrors;
     double expsigmaerr;
+    bool cberrors;
+    bool skiperrors;
     hqrndstate state;
 
     waserrors = false;
@@ -312,10 +318,15 @@ bool testhqrnd(bool silent)
     }
     experrors = experrors||ap::fp_greater(expsigmaerr,sigmathreshold);
     
+    //
+    // Counter-based generator, skip-ahead and substreams
+    //
+    testcounterbased(samplesize, sigmathreshold, cberrors, skiperrors);
+    
     //
     // Final report
     //
-    waserrors = seederrors||urerrors||uierrors||normerrors||experrors;
+    waserrors = seederrors||urerrors||uierrors||normerrors||experrors||cberrors||skiperrors;
     if( !silent )
     {
         printf("RNG TEST\n");
@@ -364,6 +375,24 @@ bool testhqrnd(bool silent)
         {
             printf("FAILED\n");
         }
+        printf("COUNTER-BASED:                           ");
+        if( !cberrors )
+        {
+            printf("OK\n");
+        }
+        else
+        {
+            printf("FAILED\n");
+        }
+        printf("SKIP-AHEAD AND SUBSTREAMS:               ");
+        if( !skiperrors )
+        {
+            printf("OK\n");
+        }
+        else
+        {
+            printf("FAILED\n");
+        }
         if( waserrors )
         {
             printf("TEST SUMMARY: FAILED\n");
@@ -389,6 +418,202 @@ static void unsetstate(hqrndstate& state)
     state.s2 = 0;
     state.v = 0;
     state.magicv = 0;
+    state.counterbased = false;
+    state.key0 = 0;
+    state.key1 = 0;
+    state.ctr0 = 0;
+    state.ctr1 = 0;
+    state.stream = 0;
+    state.bufpos = 0;
+    state.buf0 = 0;
+    state.buf1 = 0;
+}
+
+
+/*************************************************************************
+Counter-based generator test:
+* first number for zero key is compared with Philox4x32-10 known answer
+* uniform, normal and exponential bulk generation: statistical tests
+* bulk generation gives same numbers as calls of scalar functions
+* skip-ahead gives same numbers as generation (for both generators)
+* substreams are reproducible and differ from each other
+*************************************************************************/
+static void testcounterbased(int samplesize,
+     double sigmathreshold,
+     bool& cberrors,
+     bool& skiperrors)
+{
+    hqrndstate state;
+    hqrndstate state2;
+    ap::real_1d_array x;
+    ap::real_1d_array y;
+    double mean;
+    double means;
+    double stddev;
+    double stddevs;
+    double sigmaerr;
+    double lambda;
+    double v;
+    int kind;
+    int n;
+    int k;
+    int i;
+    int s1;
+    int s2;
+
+    cberrors = false;
+    skiperrors = false;
+    
+    //
+    // Known answer: Philox4x32-10(0,0) = (0x6627E8D5, 0xE169C58D, ...)
+    //
+    unsetstate(state);
+    hqrndphiloxseed(0, 0, state);
+    v = (double(0x6627E8D5u>>6)*67108864.0+double(0xE169C58Du>>6)+0.5)/4503599627370496.0;
+    cberrors = cberrors||ap::fp_neq(hqrnduniformr(state),v);
+    
+    //
+    // Statistical tests of the bulk generation
+    //
+    lambda = 2+5*ap::randomreal();
+    for(kind = 0; kind <= 2; kind++)
+    {
+        unsetstate(state);
+        hqrndphiloxrandomize(state);
+        if( kind==0 )
+        {
+            hqrndfilluniform(state, samplesize, x);
+        }
+        if( kind==1 )
+        {
+            hqrndfillnormal(state, samplesize, x);
+        }
+        if( kind==2 )
+        {
+            hqrndfillexponential(state, lambda, samplesize, x);
+        }
+        for(i = 0; i <= samplesize-1; i++)
+        {
+            cberrors = cberrors||(kind!=1&&ap::fp_less_eq(x(i),0))||(kind==0&&ap::fp_greater_eq(x(i),1));
+        }
+        calculatemv(x, samplesize, mean, means, stddev, stddevs);
+        if( ap::fp_eq(means,0)||ap::fp_eq(stddevs,0) )
+        {
+            cberrors = true;
+            continue;
+        }
+        if( kind==0 )
+        {
+            sigmaerr = ap::maxreal(fabs((mean-0.5)/means), fabs((stddev-sqrt(double(1)/double(12)))/stddevs));
+        }
+        if( kind==1 )
+        {
+            sigmaerr = ap::maxreal(fabs(mean/means), fabs((stddev-1)/stddevs));
+        }
+        if( kind==2 )
+        {
+            sigmaerr = ap::maxreal(fabs((mean-1/lambda)/means), fabs((stddev-1/lambda)/stddevs));
+        }
+        cberrors = cberrors||ap::fp_greater(sigmaerr,sigmathreshold);
+    }
+    
+    //
+    // Bulk generation vs scalar functions, started at random position
+    //
+    for(kind = 0; kind <= 2; kind++)
+    {
+        for(n = 0; n <= 10; n++)
+        {
+            s1 = 1+ap::randominteger(32000);
+            s2 = 1+ap::randominteger(32000);
+            k = ap::randominteger(5);
+            hqrndphiloxseed(s1, s2, state);
+            hqrndskip(state, k);
+            state2 = state;
+            if( kind==0 )
+            {
+                hqrndfilluniform(state, n, x);
+            }
+            if( kind==1 )
+            {
+                hqrndfillnormal(state, n, x);
+            }
+            if( kind==2 )
+            {
+                hqrndfillexponential(state, lambda, n, x);
+            }
+            for(i = 0; i <= n-1; i++)
+            {
+                if( kind==0 )
+                {
+                    v = hqrnduniformr(state2);
+                }
+                if( kind==1 )
+                {
+                    v = hqrndnormal(state2);
+                }
+                if( kind==2 )
+                {
+                    v = hqrndexponential(lambda, state2);
+                }
+                cberrors = cberrors||ap::fp_neq(x(i),v);
+            }
+            cberrors = cberrors||ap::fp_neq(hqrnduniformr(state),hqrnduniformr(state2));
+        }
+    }
+    
+    //
+    // Skip-ahead: counter-based generator
+    //
+    n = 1000;
+    hqrndphiloxrandomize(state);
+    state2 = state;
+    hqrndfilluniform(state, n, x);
+    for(k = 0; k <= n-1; k++)
+    {
+        state = state2;
+        hqrndskip(state, k);
+        skiperrors = skiperrors||ap::fp_neq(hqrnduniformr(state),x(k));
+    }
+    
+    //
+    // Skip-ahead: L'Ecuyer generator
+    //
+    hqrndrandomize(state);
+    state2 = state;
+    hqrndfilluniform(state, n, x);
+    for(k = 0; k <= n-1; k = k+7)
+    {
+        state = state2;
+        hqrndskip(state, k);
+        skiperrors = skiperrors||ap::fp_neq(hqrnduniformr(state),x(k));
+    }
+    
+    //
+    // Substreams: same substream gives same numbers, different ones
+    // give different numbers, substream starts from the beginning
+    //
+    hqrndphiloxrandomize(state);
+    hqrndsubstream(state, 1, state2);
+    hqrndfilluniform(state2, n, x);
+    hqrndskip(state, 5);
+    hqrndsubstream(state, 1, state2);
+    hqrndfilluniform(state2, n, y);
+    for(i = 0; i <= n-1; i++)
+    {
+        skiperrors = skiperrors||ap::fp_neq(x(i),y(i));
+    }
+    hqrndsubstream(state, 2, state2);
+    hqrndfilluniform(state2, n, y);
+    k = 0;
+    for(i = 0; i <= n-1; i++)
+    {
+        if( ap::fp_eq(x(i),y(i)) )
+        {
+            k = k+1;
+        }
+    }
+    skiperrors = skiperrors||k>1;
 }
 
 
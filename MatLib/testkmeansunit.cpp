@@ -9,6 +9,9 @@ static void simpletest1(int nvars,
      bool& converrors,
      bool& othererrors,
      bool& simpleerrors);
+static void minibatchtest(int nvars,
+     int nc,
+     bool& minibatcherrors);
 static double rnormal();
 static double rsphere(ap::real_2d_array& xy, int n, int i);
 
@@ -26,6 +29,7 @@ bool testkmeans(bool silent)
     bool simpleerrors;
     bool complexerrors;
     bool othererrors;
+    bool minibatcherrors;
 
     
     //
@@ -39,6 +43,7 @@ bool testkmeans(bool silent)
     othererrors = false;
     simpleerrors = false;
     complexerrors = false;
+    minibatcherrors = false;
     
     //
     //
@@ -51,10 +56,27 @@ bool testkmeans(bool silent)
         }
     }
     
+    //
+    // Many clusters (most points are not rechecked against all centers)
+    //
+    simpletest1(2, 20, passcount, converrors, othererrors, simpleerrors);
+    simpletest1(8, 30, passcount, converrors, othererrors, simpleerrors);
+    
+    //
+    // Mini-batch
+    //
+    for(nf = 1; nf <= maxnf; nf++)
+    {
+        for(nc = 1; nc <= maxnc; nc++)
+        {
+            minibatchtest(nf, nc, minibatcherrors);
+        }
+    }
+    
     //
     // Final report
     //
-    waserrors = converrors||othererrors||simpleerrors||complexerrors;
+    waserrors = converrors||othererrors||simpleerrors||complexerrors||minibatcherrors;
     if( !silent )
     {
         printf("K-MEANS TEST\n");
@@ -103,6 +125,15 @@ bool testkmeans(bool silent)
         {
             printf("FAILED\n");
         }
+        printf("* MINI-BATCH:                            ");
+        if( !minibatcherrors )
+        {
+            printf("OK\n");
+        }
+        else
+        {
+            printf("FAILED\n");
+        }
         if( waserrors )
         {
             printf("TEST SUMMARY: FAILED\n");
@@ -145,6 +176,8 @@ static void simpletest1(int nvars,
     double erandom;
     double dclosest;
     int cclosest;
+    ap::real_2d_array cm;
+    ap::integer_1d_array csizes;
 
     npoints = nc*100;
     restarts = 5;
@@ -199,6 +232,42 @@ static void simpletest1(int nvars,
             }
         }
         
+        //
+        // Test that centers are centroids of their clusters
+        // (algorithm has converged)
+        //
+        cm.setbounds(0, nc-1, 0, nvars-1);
+        csizes.setbounds(0, nc-1);
+        for(i = 0; i <= nc-1; i++)
+        {
+            csizes(i) = 0;
+            for(j = 0; j <= nvars-1; j++)
+            {
+                cm(i,j) = 0;
+            }
+        }
+        for(i = 0; i <= npoints-1; i++)
+        {
+            csizes(xyc(i)) = csizes(xyc(i))+1;
+            ap::vadd(&cm(xyc(i), 0), 1, &xy(i, 0), 1, ap::vlen(0,nvars-1));
+        }
+        for(i = 0; i <= nc-1; i++)
+        {
+            if( csizes(i)==0 )
+            {
+                othererrors = true;
+                return;
+            }
+            for(j = 0; j <= nvars-1; j++)
+            {
+                if( ap::fp_greater(fabs(cm(i,j)/csizes(i)-c(j,i)),1.0E-10*nc) )
+                {
+                    othererrors = true;
+                    return;
+                }
+            }
+        }
+        
         //
         // Use first NC rows of XY as random centers
         // (XY is totally random, so it is as good as any other choice).
@@ -238,6 +307,143 @@ static void simpletest1(int nvars,
 }
 
 
+/*************************************************************************
+Mini-batch test: NC well separated clusters (unit simplex scaled by 10,
+noise 0.01), dataset is passed by batches of 20 points. First batch has
+10 points from each cluster (k-means++ selects centers from it, so it
+must be representative).
+
+Each center must be close to one of the cluster means and each mean must
+have a center close to it.
+*************************************************************************/
+static void minibatchtest(int nvars,
+     int nc,
+     bool& minibatcherrors)
+{
+    kmeansminibatchstate state;
+    ap::real_2d_array means;
+    ap::real_2d_array xy;
+    ap::real_2d_array c;
+    ap::real_1d_array tmp;
+    ap::boolean_1d_array found;
+    int batchsize;
+    int nbatches;
+    int batch;
+    int info;
+    int i;
+    int j;
+    int t;
+    double v;
+    double dclosest;
+    int cclosest;
+
+    batchsize = 20;
+    nbatches = 50*nc;
+    means.setbounds(0, nc-1, 0, nvars-1);
+    for(i = 0; i <= nc-1; i++)
+    {
+        for(j = 0; j <= nvars-1; j++)
+        {
+            means(i,j) = 0;
+        }
+        if( i<nvars )
+        {
+            means(i,i) = 10;
+        }
+        else
+        {
+            means(i,0) = -10*(i-nvars+1);
+        }
+    }
+    xy.setbounds(0, ap::maxint(batchsize, 10*nc)-1, 0, nvars-1);
+    tmp.setbounds(0, nvars-1);
+    found.setbounds(0, nc-1);
+    
+    //
+    // Invalid first batch
+    //
+    kmeansminibatchcreate(nvars, nc, state);
+    if( nc>1 )
+    {
+        kmeansminibatchupdate(state, xy, nc-1, info);
+        if( info!=-1 )
+        {
+            minibatcherrors = true;
+            return;
+        }
+    }
+    
+    //
+    // Process the data
+    //
+    for(i = 0; i <= 10*nc-1; i++)
+    {
+        for(j = 0; j <= nvars-1; j++)
+        {
+            xy(i,j) = means(i%nc,j)+0.01*rnormal();
+        }
+    }
+    kmeansminibatchupdate(state, xy, 10*nc, info);
+    if( info!=1 )
+    {
+        minibatcherrors = true;
+        return;
+    }
+    for(batch = 0; batch <= nbatches-1; batch++)
+    {
+        for(i = 0; i <= batchsize-1; i++)
+        {
+            t = ap::randominteger(nc);
+            for(j = 0; j <= nvars-1; j++)
+            {
+                xy(i,j) = means(t,j)+0.01*rnormal();
+            }
+        }
+        kmeansminibatchupdate(state, xy, batchsize, info);
+        if( info!=1 )
+        {
+            minibatcherrors = true;
+            return;
+        }
+    }
+    kmeansminibatchresults(state, c);
+    
+    //
+    // Compare centers with means
+    //
+    for(i = 0; i <= nc-1; i++)
+    {
+        found(i) = false;
+    }
+    for(i = 0; i <= nc-1; i++)
+    {
+        cclosest = -1;
+        dclosest = ap::maxrealnumber;
+        for(j = 0; j <= nc-1; j++)
+        {
+            ap::vmove(&tmp(0), 1, &means(j, 0), 1, ap::vlen(0,nvars-1));
+            ap::vsub(&tmp(0), 1, &c(0, i), c.getstride(), ap::vlen(0,nvars-1));
+            v = ap::vdotproduct(&tmp(0), 1, &tmp(0), 1, ap::vlen(0,nvars-1));
+            if( ap::fp_less(v,dclosest) )
+            {
+                cclosest = j;
+                dclosest = v;
+            }
+        }
+        if( ap::fp_greater(dclosest,ap::sqr(0.5)) )
+        {
+            minibatcherrors = true;
+            return;
+        }
+        found(cclosest) = true;
+    }
+    for(i = 0; i <= nc-1; i++)
+    {
+        minibatcherrors = minibatcherrors||!found(i);
+    }
+}
+
+
 /*************************************************************************
 Random normal number
 *************************************************************************/
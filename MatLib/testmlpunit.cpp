@@ -397,6 +397,10 @@ static void testprocessing(int nkind,
     ap::real_1d_array y2;
     ap::real_1d_array ra;
     ap::real_1d_array ra2;
+    int j;
+    int npoints;
+    ap::real_2d_array xb;
+    ap::real_2d_array yb;
     double v;
 
     ap::ap_error::make_assertion(passcount>=2, "PassCount<2!");
@@ -522,6 +526,30 @@ static void testprocessing(int nkind,
         }
         err = err||!allsame;
         
+        //
+        // Batch processing leads to same outputs as MLPProcess
+        // (up to rounding errors, batch is split into several chunks)
+        //
+        npoints = 1+ap::randominteger(200);
+        xb.setbounds(0, npoints-1, 0, nin-1);
+        for(i = 0; i <= npoints-1; i++)
+        {
+            for(j = 0; j <= nin-1; j++)
+            {
+                xb(i,j) = 2*ap::randomreal()-1;
+            }
+        }
+        mlpprocessbatch(network, xb, npoints, yb);
+        for(i = 0; i <= npoints-1; i++)
+        {
+            ap::vmove(&x1(0), 1, &xb(i, 0), 1, ap::vlen(0,nin-1));
+            mlpprocess(network, x1, y1);
+            for(j = 0; j <= nout-1; j++)
+            {
+                err = err||ap::fp_greater(fabs(yb(i,j)-y1(j)),1000*ap::machineepsilon*ap::maxreal(fabs(y1(j)), double(1)));
+            }
+        }
+        
         //
         // Different inputs leads to different outputs (non-zero network)
         //
@@ -934,7 +962,7 @@ static void testgradient(int nkind,
         //
         // Test gradient calculation: batch (least squares)
         //
-        ssize = 1+ap::randominteger(10);
+        ssize = 1+ap::randominteger(150);
         xy.setbounds(0, ssize-1, 0, nin+nout-1);
         for(i = 0; i <= wcount-1; i++)
         {
@@ -971,6 +999,7 @@ static void testgradient(int nkind,
         }
         mlpgradbatch(network, xy, ssize, e2, grad2);
         err = err||ap::fp_greater(fabs(e1-e2)/e1,0.01);
+        err = err||ap::fp_greater(fabs(e1-mlperror(network, xy, ssize))/e1,etol);
         for(i = 0; i <= wcount-1; i++)
         {
             if( ap::fp_neq(grad1(i),0) )
@@ -986,7 +1015,7 @@ static void testgradient(int nkind,
         //
         // Test gradient calculation: batch (natural error func)
         //
-        ssize = 1+ap::randominteger(10);
+        ssize = 1+ap::randominteger(150);
         xy.setbounds(0, ssize-1, 0, nin+nout-1);
         for(i = 0; i <= wcount-1; i++)
         {
@@ -1023,6 +1052,7 @@ static void testgradient(int nkind,
         }
         mlpgradnbatch(network, xy, ssize, e2, grad2);
         err = err||ap::fp_greater(fabs(e1-e2)/e1,etol);
+        err = err||ap::fp_greater(fabs(e1-mlperrorn(network, xy, ssize))/e1,etol);
         for(i = 0; i <= wcount-1; i++)
         {
             if( ap::fp_neq(grad1(i),0) )
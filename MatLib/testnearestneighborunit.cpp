@@ -267,6 +267,7 @@ static void testkdtuniform(const ap::real_2d_array& xy,
     kdtree treex;
     kdtree treexy;
     kdtree treext;
+    kdtree treef;
     ap::real_2d_array qx;
     ap::real_2d_array qxy;
     ap::integer_1d_array qtags;
@@ -284,6 +285,12 @@ static void testkdtuniform(const ap::real_2d_array& xy,
     double r;
     int q;
     int qcount;
+    kdtreerequestbuffer buf;
+    ap::integer_1d_array tstags;
+    ap::real_1d_array tsr;
+    ap::integer_1d_array bcnt;
+    ap::integer_2d_array btags;
+    ap::real_2d_array br;
 
     qcount = 10;
     
@@ -307,6 +314,7 @@ static void testkdtuniform(const ap::real_2d_array& xy,
     kdtreebuild(xy, n, nx, 0, normtype, treex);
     kdtreebuild(xy, n, nx, ny, normtype, treexy);
     kdtreebuildtagged(xy, tags, n, nx, 0, normtype, treext);
+    kdtreebuildtaggedflat(xy, tags, n, nx, ny, normtype, treef);
     
     //
     // allocate arrays
@@ -318,6 +326,8 @@ static void testkdtuniform(const ap::real_2d_array& xy,
     qtags.setlength(n);
     qr.setlength(n);
     ptx.setlength(nx);
+    tstags.setlength(n);
+    tsr.setlength(n);
     
     //
     // test general K-NN queries (with self-matches):
@@ -654,6 +664,80 @@ static void testkdtuniform(const ap::real_2d_array& xy,
             }
         }
     }
+    
+    //
+    // Test flat layout: K-NN and R-NN queries must return
+    // the same results as queries to the default layout
+    //
+    for(q = 1; q <= qcount; q++)
+    {
+        k = 1+ap::randominteger(n);
+        for(i = 0; i <= nx-1; i++)
+        {
+            ptx(i) = 2*ap::randomreal()-1;
+        }
+        for(task = 0; task <= 1; task++)
+        {
+            if( task==0 )
+            {
+                kt = kdtreequeryknn(treext, ptx, k, true);
+                kx = kdtreequeryknn(treef, ptx, k, true);
+            }
+            else
+            {
+                r = ap::randomreal();
+                kt = kdtreequeryrnn(treext, ptx, r, true);
+                kx = kdtreequeryrnn(treef, ptx, r, true);
+            }
+            if( kt!=kx )
+            {
+                kdterrors = true;
+                return;
+            }
+            kdtreequeryresultstags(treext, qtags, kt);
+            kdtreequeryresultsdistances(treext, qr, kr);
+            kdtreequeryresultstags(treef, tstags, kt);
+            kdtreequeryresultsdistances(treef, tsr, kr);
+            kdtreequeryresultsxy(treef, qxy, kxy);
+            for(i = 0; i <= kx-1; i++)
+            {
+                kdterrors = kdterrors||tstags(i)!=qtags(i)||ap::fp_neq(tsr(i),qr(i));
+            }
+            kdterrors = kdterrors||kdtresultsdifferent(xy, n, qxy, qxy, tstags, kx, nx, ny);
+        }
+    }
+    
+    //
+    // Test thread-safe and batch queries:
+    // * query with request buffer, interleaved with queries
+    //   to the internal buffer, must return the same results
+    // * batch query must return the same results as queries
+    //   for each point
+    //
+    kdtreecreaterequestbuffer(treext, buf);
+    k = 1+ap::randominteger(n);
+    kdtreequeryknnbatch(treext, xy, n, k, false, bcnt, btags, br);
+    for(i = 0; i <= n-1; i++)
+    {
+        ap::vmove(&ptx(0), 1, &xy(i, 0), 1, ap::vlen(0,nx-1));
+        kt = kdtreetsqueryknn(treext, buf, ptx, k, false);
+        kx = kdtreequeryknn(treext, tmpx, k, false);
+        kx = kdtreequeryknn(treext, ptx, k, false);
+        if( kt!=kx||bcnt(i)!=kx )
+        {
+            kdterrors = true;
+            return;
+        }
+        kdtreetsqueryresultstags(treext, buf, tstags, kt);
+        kdtreetsqueryresultsdistances(treext, buf, tsr, kr);
+        kdtreequeryresultstags(treext, qtags, kt);
+        kdtreequeryresultsdistances(treext, qr, kr);
+        for(j = 0; j <= kx-1; j++)
+        {
+            kdterrors = kdterrors||tstags(j)!=qtags(j)||btags(i,j)!=qtags(j);
+            kdterrors = kdterrors||ap::fp_neq(tsr(j),qr(j))||ap::fp_neq(br(i,j),qr(j));
+        }
+    }
 }
 
 
@@ -9,6 +9,7 @@ static void calculatemv(const ap::real_1d_array& x,
      double& means,
      double& stddev,
      double& stddevs);
+static void testtruncatedsubspace(bool& converrors, bool& trnerrors);
 
 bool testpca(bool silent)
 {
@@ -43,6 +44,7 @@ bool testpca(bool silent)
     bool pcaorterrors;
     bool pcavarerrors;
     bool pcaopterrors;
+    bool pcatrnerrors;
     bool waserrors;
 
     
@@ -58,6 +60,7 @@ bool testpca(bool silent)
     pcaorterrors = false;
     pcavarerrors = false;
     pcaopterrors = false;
+    pcatrnerrors = false;
     
     //
     // Test 1: N random points in M-dimensional space
@@ -211,10 +214,15 @@ bool testpca(bool silent)
         }
     }
     
+    //
+    // Truncated PCA
+    //
+    testtruncatedsubspace(pcaconverrors, pcatrnerrors);
+    
     //
     // Final report
     //
-    waserrors = pcaconverrors||pcaorterrors||pcavarerrors||pcaopterrors;
+    waserrors = pcaconverrors||pcaorterrors||pcavarerrors||pcaopterrors||pcatrnerrors;
     if( !silent )
     {
         printf("PCA TEST\n");
@@ -263,6 +271,15 @@ bool testpca(bool silent)
         {
             printf("FAILED\n");
         }
+        printf("* TRUNCATED PCA                          ");
+        if( !pcatrnerrors )
+        {
+            printf("OK\n");
+        }
+        else
+        {
+            printf("FAILED\n");
+        }
         if( waserrors )
         {
             printf("TEST SUMMARY: FAILED\n");
@@ -369,5 +386,126 @@ bool testpcaunit_test()
 }
 
 
+/*************************************************************************
+Truncated PCA test: NNeeded strong components plus weak noise, results of
+PCATruncatedSubspace are compared with first NNeeded components calculated
+by PCABuildBasis. Small NVars test exact fallback, larger NVars - subspace
+iteration.
+*************************************************************************/
+static void testtruncatedsubspace(bool& converrors, bool& trnerrors)
+{
+    int nvarstab[] = {8, 60};
+    int n;
+    int m;
+    int nneeded;
+    int its;
+    int info;
+    int i;
+    int j;
+    int k;
+    int t;
+    double g;
+    double v;
+    double threshold;
+    ap::real_2d_array x;
+    ap::real_2d_array u;
+    ap::real_2d_array v1;
+    ap::real_2d_array v2;
+    ap::real_1d_array s1;
+    ap::real_1d_array s2;
+
+    threshold = 1.0E-6;
+    n = 300;
+    for(t = 0; t <= 1; t++)
+    {
+        m = nvarstab[t];
+        for(nneeded = 1; nneeded <= 5; nneeded++)
+        {
+            
+            //
+            // Generate task: X = 1*Means' + G*diag(10/(k+1))*U' + noise,
+            // with random loading vectors U.
+            //
+            u.setlength(m, nneeded);
+            for(i = 0; i <= m-1; i++)
+            {
+                for(k = 0; k <= nneeded-1; k++)
+                {
+                    u(i,k) = 2*ap::randomreal()-1;
+                }
+            }
+            x.setlength(n, m);
+            for(i = 0; i <= n-1; i++)
+            {
+                for(j = 0; j <= m-1; j++)
+                {
+                    x(i,j) = 5+0.1*(2*ap::randomreal()-1);
+                }
+                for(k = 0; k <= nneeded-1; k++)
+                {
+                    g = 10.0/(k+1)*(2*ap::randomreal()-1);
+                    ap::vadd(&x(i, 0), 1, &u(0, k), u.getstride(), ap::vlen(0,m-1), g);
+                }
+            }
+            
+            //
+            // Reference solution
+            //
+            pcabuildbasis(x, n, m, info, s1, v1);
+            if( info!=1 )
+            {
+                converrors = true;
+                continue;
+            }
+            
+            //
+            // Compare variances and vectors (up to sign), test orthogonality
+            //
+            for(its = 1; its <= 2; its++)
+            {
+                pcatruncatedsubspace(x, n, m, nneeded, its, info, s2, v2);
+                if( info!=1 )
+                {
+                    converrors = true;
+                    continue;
+                }
+                for(k = 0; k <= nneeded-1; k++)
+                {
+                    trnerrors = trnerrors||ap::fp_greater(fabs(s2(k)-s1(k)),threshold*s1(0));
+                    v = ap::vdotproduct(&v1(0, k), v1.getstride(), &v2(0, k), v2.getstride(), ap::vlen(0,m-1));
+                    trnerrors = trnerrors||ap::fp_greater(1-fabs(v),threshold);
+                    for(j = 0; j <= nneeded-1; j++)
+                    {
+                        v = ap::vdotproduct(&v2(0, k), v2.getstride(), &v2(0, j), v2.getstride(), ap::vlen(0,m-1));
+                        if( j==k )
+                        {
+                            v = v-1;
+                        }
+                        trnerrors = trnerrors||ap::fp_greater(fabs(v),threshold);
+                    }
+                }
+            }
+        }
+    }
+    
+    //
+    // Results are reproducible (last task, approximate solution)
+    //
+    pcatruncatedsubspace(x, n, m, 1, 0, info, s1, v1);
+    pcatruncatedsubspace(x, n, m, 1, 0, info, s2, v2);
+    trnerrors = trnerrors||ap::fp_neq(s1(0),s2(0));
+    for(i = 0; i <= m-1; i++)
+    {
+        trnerrors = trnerrors||ap::fp_neq(v1(i,0),v2(i,0));
+    }
+    
+    //
+    // Wrong parameters
+    //
+    pcatruncatedsubspace(x, n, m, m+1, 2, info, s2, v2);
+    trnerrors = trnerrors||info!=-1;
+    pcatruncatedsubspace(x, n, m, 1, -1, info, s2, v2);
+    trnerrors = trnerrors||info!=-1;
+}
 
 
@@ -17,6 +17,7 @@
 #include "bdsvd.h"
 #include "svd.h"
 #include "descriptivestatistics.h"
+#include "hqrnd.h"
 #include "pca.h"
 
 
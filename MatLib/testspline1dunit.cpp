@@ -33,6 +33,7 @@ bool testsplineinterpolation(bool silent)
     bool lterrors;
     bool ierrors;
     bool fiterrors;
+    bool cverrors;
     double nonstrictthreshold;
     double threshold;
     int passcount;
@@ -117,6 +118,7 @@ bool testsplineinterpolation(bool silent)
     lterrors = false;
     ierrors = false;
     fiterrors = false;
+    cverrors = false;
     
     //
     // General test: linear, cubic, Hermite, Akima
@@ -470,6 +472,56 @@ bool testsplineinterpolation(bool silent)
         }
         cperrors = cperrors||ap::fp_greater(err,threshold);
         
+        //
+        // Test batch calculation: points are sorted or random, some of
+        // them are out of [A,B] or exactly at the nodes. Grid is uniform,
+        // then it is perturbed.
+        //
+        for(k = 0; k <= 1; k++)
+        {
+            w.setlength(n);
+            ap::vmove(&w(0), 1, &x(0), 1, ap::vlen(0,n-1));
+            if( k==1 )
+            {
+                for(i = 1; i <= n-2; i++)
+                {
+                    w(i) = w(i)+0.4*(b-a)/(n-1)*(2*ap::randomreal()-1);
+                }
+            }
+            spline1dbuildcubic(w, y, n, 2, 0.0, 2, 0.0, c2);
+            for(pass = 1; pass <= passcount; pass++)
+            {
+                m = 1+ap::randominteger(3000);
+                xc.setlength(m);
+                for(i = 0; i <= m-1; i++)
+                {
+                    if( pass%2==0 )
+                    {
+                        xc(i) = a-0.5+(b-a+1)*i/m;
+                    }
+                    else
+                    {
+                        if( ap::fp_greater(ap::randomreal(),0.1) )
+                        {
+                            xc(i) = a-0.5+(b-a+1)*ap::randomreal();
+                        }
+                        else
+                        {
+                            xc(i) = w(ap::randominteger(n));
+                        }
+                    }
+                }
+                spline1dcalcv(c2, xc, m, yc);
+                err = 0;
+                for(i = 0; i <= m-1; i++)
+                {
+                    v = spline1dcalc(c2, xc(i));
+                    err = ap::maxreal(err, fabs(yc(i)-v)/ap::maxreal(fabs(v), 1.0));
+                }
+                cverrors = cverrors||ap::fp_greater(err,threshold);
+            }
+        }
+        
         //
         // Test unpack
         //
@@ -1101,7 +1153,7 @@ bool testsplineinterpolation(bool silent)
     //
     // report
     //
-    waserrors = lserrors||cserrors||hserrors||aserrors||dserrors||cperrors||uperrors||lterrors||ierrors||fiterrors;
+    waserrors = lserrors||cserrors||hserrors||aserrors||dserrors||cperrors||uperrors||lterrors||ierrors||fiterrors||cverrors;
     if( !silent )
     {
         printf("TESTING SPLINE INTERPOLATION\n");
@@ -1163,6 +1215,15 @@ bool testsplineinterpolation(bool silent)
         {
             printf("OK\n");
         }
+        printf("BATCH CALCULATION TEST:                  ");
+        if( cverrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
         printf("UNPACK TEST:                             ");
         if( uperrors )
         {
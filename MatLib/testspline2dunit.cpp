@@ -29,6 +29,11 @@ static bool testlintrans(const spline2dinterpolant& c,
      double bx,
      double ay,
      double by);
+static bool testcalcv(const spline2dinterpolant& c,
+     double ax,
+     double bx,
+     double ay,
+     double by);
 static void unsetspline2d(spline2dinterpolant& c);
 
 bool test2dinterpolation(bool silent)
@@ -44,6 +49,7 @@ bool test2dinterpolation(bool silent)
     bool syerrors;
     bool rlerrors;
     bool rcerrors;
+    bool cverrors;
     int pass;
     int passcount;
     int jobtype;
@@ -51,6 +57,8 @@ bool test2dinterpolation(bool silent)
     double h;
     ap::real_1d_array x;
     ap::real_1d_array y;
+    ap::real_1d_array ux;
+    ap::real_1d_array uy;
     spline2dinterpolant c;
     spline2dinterpolant c2;
     ap::real_1d_array lx;
@@ -112,6 +120,7 @@ bool test2dinterpolation(bool silent)
     syerrors = false;
     rlerrors = false;
     rcerrors = false;
+    cverrors = false;
     
     //
     // Test: bilinear, bicubic
@@ -122,6 +131,8 @@ bool test2dinterpolation(bool silent)
         {
             x.setbounds(0, n-1);
             y.setbounds(0, m-1);
+            ux.setbounds(0, n-1);
+            uy.setbounds(0, m-1);
             lx.setbounds(0, 2*n-2);
             ly.setbounds(0, 2*m-2);
             f.setbounds(0, m-1, 0, n-1);
@@ -341,6 +352,24 @@ bool test2dinterpolation(bool silent)
                 }
                 cperrors = cperrors||ap::fp_greater(err,10000*ap::machineepsilon);
                 
+                //
+                // Batch calculation test: spline from the copy test
+                // (non-uniform grid) and splines on the uniform grid
+                //
+                cverrors = cverrors||!testcalcv(c, ax, bx, ay, by);
+                for(j = 0; j <= n-1; j++)
+                {
+                    ux(j) = ax+(bx-ax)*j/(n-1);
+                }
+                for(i = 0; i <= m-1; i++)
+                {
+                    uy(i) = ay+(by-ay)*i/(m-1);
+                }
+                spline2dbuildbilinear(ux, uy, f, m, n, c);
+                cverrors = cverrors||!testcalcv(c, ax, bx, ay, by);
+                spline2dbuildbicubic(ux, uy, f, m, n, c);
+                cverrors = cverrors||!testcalcv(c, ax, bx, ay, by);
+                
                 //
                 // Special symmetry test
                 //
@@ -457,7 +486,7 @@ bool test2dinterpolation(bool silent)
     //
     // report
     //
-    waserrors = blerrors||bcerrors||dserrors||cperrors||uperrors||lterrors||syerrors||rlerrors||rcerrors;
+    waserrors = blerrors||bcerrors||dserrors||cperrors||uperrors||lterrors||syerrors||rlerrors||rcerrors||cverrors;
     if( !silent )
     {
         printf("TESTING 2D INTERPOLATION\n");
@@ -519,6 +548,15 @@ bool test2dinterpolation(bool silent)
         {
             printf("OK\n");
         }
+        printf("BATCH CALCULATION TEST:                  ");
+        if( cverrors )
+        {
+            printf("FAILED\n");
+        }
+        else
+        {
+            printf("OK\n");
+        }
         printf("SPECIAL SYMMETRY TEST:                   ");
         if( syerrors )
         {
@@ -852,6 +890,55 @@ static bool testlintrans(const spline2dinterpolant& c,
 }
 
 
+/*************************************************************************
+Tests Spline2DCalcV() against Spline2DCalc() on the random points and on
+the scanlines of the image covering [AX,BX]x[AY,BY] (and a bit more).
+*************************************************************************/
+static bool testcalcv(const spline2dinterpolant& c,
+     double ax,
+     double bx,
+     double ay,
+     double by)
+{
+    bool result;
+    ap::real_1d_array x;
+    ap::real_1d_array y;
+    ap::real_1d_array f;
+    int npoints;
+    int nx;
+    int i;
+    int j;
+    double err;
+
+    nx = 1+ap::randominteger(60);
+    npoints = nx*(1+ap::randominteger(40));
+    x.setlength(npoints);
+    y.setlength(npoints);
+    for(i = 0; i <= npoints-1; i++)
+    {
+        if( ap::fp_greater(ap::randomreal(),0.5) )
+        {
+            x(i) = ax-0.2+(bx-ax+0.4)*ap::randomreal();
+            y(i) = ay-0.2+(by-ay+0.4)*ap::randomreal();
+        }
+        else
+        {
+            j = i%nx;
+            x(i) = ax-0.2+(bx-ax+0.4)*j/nx;
+            y(i) = ay-0.2+(by-ay+0.4)*(i/nx)/(npoints/nx);
+        }
+    }
+    spline2dcalcv(c, x, y, npoints, f);
+    err = 0;
+    for(i = 0; i <= npoints-1; i++)
+    {
+        err = ap::maxreal(err, fabs(f(i)-spline2dcalc(c, x(i), y(i)))/ap::maxreal(fabs(f(i)), 1.0));
+    }
+    result = ap::fp_less_eq(err,10000*ap::machineepsilon);
+    return result;
+}
+
+
 /*************************************************************************
 Unset spline, i.e. initialize it with random garbage
 *************************************************************************/
@@ -12,6 +12,7 @@ static void testsortresults(const ap::real_1d_array& asorted,
      const ap::real_1d_array& aoriginal,
      int n,
      bool& waserrors);
+static void testlargesort(bool& waserrors);
 
 /*************************************************************************
 Testing tag sort
@@ -75,6 +76,11 @@ bool testsort(bool silent)
         }
     }
     
+    //
+    // Large N (radix sort, sample sort)
+    //
+    testlargesort(waserrors);
+    
     //
     // report
     //
@@ -195,6 +201,85 @@ static void testsortresults(const ap::real_1d_array& asorted,
 }
 
 
+/*************************************************************************
+Tests for large N, when radix sort (and, for the largest N, parallel
+sample sort) is used: distinct, non-distinct and mixed-sign data with
+signed zeros, results of TagSort, TagSortFastI, TagSortFastR and
+TagSortFast are compared with each other.
+*************************************************************************/
+static void testlargesort(bool& waserrors)
+{
+    int sizes[] = {255, 256, 257, 1000, 4097, 300001};
+    int n;
+    int s;
+    int i;
+    int mode;
+    ap::real_1d_array a;
+    ap::real_1d_array a0;
+    ap::real_1d_array a1;
+    ap::real_1d_array br;
+    ap::integer_1d_array bi;
+    ap::integer_1d_array p1;
+    ap::integer_1d_array p2;
+
+    for(s = 0; s <= 5; s++)
+    {
+        n = sizes[s];
+        for(mode = 0; mode <= 2; mode++)
+        {
+            a.setlength(n);
+            for(i = 0; i <= n-1; i++)
+            {
+                if( mode==0 )
+                {
+                    a(i) = 2*ap::randomreal()-1;
+                }
+                if( mode==1 )
+                {
+                    a(i) = (n-i)/3;
+                }
+                if( mode==2 )
+                {
+                    a(i) = (ap::randominteger(3)-1)*pow(10.0, double(ap::randominteger(100)-50));
+                    if( ap::randominteger(10)==0 )
+                    {
+                        a(i) = -0.0;
+                    }
+                }
+            }
+            a0 = a;
+            tagsort(a0, n, p1, p2);
+            testsortresults(a0, p1, p2, a, n, waserrors);
+            a1 = a;
+            bi.setlength(n);
+            br.setlength(n);
+            for(i = 0; i <= n-1; i++)
+            {
+                bi(i) = i;
+                br(i) = i;
+            }
+            tagsortfastr(a1, br, n);
+            for(i = 0; i <= n-1; i++)
+            {
+                waserrors = waserrors||ap::fp_neq(a1(i),a0(i))||ap::fp_neq(a(ap::round(br(i))),a1(i));
+            }
+            a1 = a;
+            tagsortfasti(a1, bi, n);
+            for(i = 0; i <= n-1; i++)
+            {
+                waserrors = waserrors||ap::fp_neq(a1(i),a0(i))||ap::fp_neq(a(bi(i)),a1(i));
+            }
+            a1 = a;
+            tagsortfast(a1, n);
+            for(i = 0; i <= n-1; i++)
+            {
+                waserrors = waserrors||ap::fp_neq(a1(i),a0(i));
+            }
+        }
+    }
+}
+
+
 /*************************************************************************
 Silent unit test
 *************************************************************************/
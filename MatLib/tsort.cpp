@@ -19,7 +19,37 @@ http://www.fsf.org/licensing/licenses
 *************************************************************************/
 
  
+#include <string.h>
 #include "tsort.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const int tsortradixmin = 256;
+static const int tsortdigitbits = 8;
+static const int tsortdigits = 256;
+static const int tsortpasses = 8;
+static const int tsortoversampling = 64;
+static const double tsortparallelwork = 262144.0;
+
+static void tsortbykeys(ap::real_1d_array& a,
+     int n,
+     bool needp,
+     ap::integer_1d_array& p);
+static unsigned long long tsortkey(double v);
+static double tsortvalue(unsigned long long k);
+static void tsortradix(unsigned long long* k,
+     int* p,
+     unsigned long long* k2,
+     int* p2,
+     int n);
+static void tsortsamplesort(unsigned long long* k,
+     int* p,
+     unsigned long long* k2,
+     int* p2,
+     int n,
+     int nb);
+static bool tsortparallel(double work);
 
 void tagsort(ap::real_1d_array& a,
      int n,
@@ -119,6 +149,8 @@ void tagsortfasti(ap::real_1d_array& a, ap::integer_1d_array& b, int n)
     int t;
     double tmp;
     int tmpi;
+    ap::integer_1d_array p;
+    ap::integer_1d_array bi;
 
     
     //
@@ -129,6 +161,24 @@ void tagsortfasti(ap::real_1d_array& a, ap::integer_1d_array& b, int n)
         return;
     }
     
+    //
+    // Large N: radix sort
+    //
+    if( n>=tsortradixmin )
+    {
+        tsortbykeys(a, n, true, p);
+        bi.setlength(n);
+        for(i = 0; i <= n-1; i++)
+        {
+            bi(i) = b(i);
+        }
+        for(i = 0; i <= n-1; i++)
+        {
+            b(i) = bi(p(i));
+        }
+        return;
+    }
+    
     //
     // General case, N>1: sort, update B
     //
@@ -212,6 +262,8 @@ void tagsortfastr(ap::real_1d_array& a, ap::real_1d_array& b, int n)
     int t;
     double tmp;
     double tmpr;
+    ap::integer_1d_array p;
+    ap::real_1d_array br;
 
     
     //
@@ -222,6 +274,21 @@ void tagsortfastr(ap::real_1d_array& a, ap::real_1d_array& b, int n)
         return;
     }
     
+    //
+    // Large N: radix sort
+    //
+    if( n>=tsortradixmin )
+    {
+        tsortbykeys(a, n, true, p);
+        br.setlength(n);
+        ap::vmove(&br(0), 1, &b(0), 1, ap::vlen(0,n-1));
+        for(i = 0; i <= n-1; i++)
+        {
+            b(i) = br(p(i));
+        }
+        return;
+    }
+    
     //
     // General case, N>1: sort, update B
     //
@@ -304,6 +371,7 @@ void tagsortfast(ap::real_1d_array& a, int n)
     int k;
     int t;
     double tmp;
+    ap::integer_1d_array p;
 
     
     //
@@ -314,6 +382,15 @@ void tagsortfast(ap::real_1d_array& a, int n)
         return;
     }
     
+    //
+    // Large N: radix sort
+    //
+    if( n>=tsortradixmin )
+    {
+        tsortbykeys(a, n, false, p);
+        return;
+    }
+    
     //
     // General case, N>1: sort, update B
     //
@@ -626,5 +703,379 @@ void tagheappopi(ap::real_1d_array& a, ap::integer_1d_array& b, int& n)
 }
 
 
+/*************************************************************************
+Sorting of A[0..N-1] by LSD radix sort of 64-bit keys (parallel sample sort
+for large N). If NeedP is True, P[0..N-1] stores permutation: I-th element
+of the sorted array is P[I]-th element of the original one.
+
+Sort is stable, so results don't depend on the number of threads.
+*************************************************************************/
+static void tsortbykeys(ap::real_1d_array& a,
+     int n,
+     bool needp,
+     ap::integer_1d_array& p)
+{
+    ap::template_1d_array<unsigned long long> k;
+    ap::template_1d_array<unsigned long long> k2;
+    ap::integer_1d_array p2;
+    bool parallel;
+    int nb;
+    int i;
+
+    k.setlength(n);
+    k2.setlength(n);
+    if( needp )
+    {
+        p.setlength(n);
+        p2.setlength(n);
+    }
+    parallel = tsortparallel(double(n));
+    #pragma omp parallel for schedule(static) if( parallel )
+    for(i = 0; i <= n-1; i++)
+    {
+        k(i) = tsortkey(a(i));
+        if( needp )
+        {
+            p(i) = i;
+        }
+    }
+    nb = 1;
+#ifdef _OPENMP
+    if( parallel )
+    {
+        nb = 4*omp_get_max_threads();
+    }
+#endif
+    if( nb>1 )
+    {
+        tsortsamplesort(&k(0), needp ? &p(0) : NULL, &k2(0), needp ? &p2(0) : NULL, n, nb);
+    }
+    else
+    {
+        tsortradix(&k(0), needp ? &p(0) : NULL, &k2(0), needp ? &p2(0) : NULL, n);
+    }
+    #pragma omp parallel for schedule(static) if( parallel )
+    for(i = 0; i <= n-1; i++)
+    {
+        a(i) = tsortvalue(k(i));
+    }
+}
+
+
+/*************************************************************************
+Order-preserving mapping of doubles to unsigned 64-bit integers: sign bit
+is flipped for positive numbers, all bits - for negative ones.
+*************************************************************************/
+static unsigned long long tsortkey(double v)
+{
+    unsigned long long result;
+
+    memcpy(&result, &v, sizeof(result));
+    if( (result>>63)!=0 )
+    {
+        result = ~result;
+    }
+    else
+    {
+        result = result|((unsigned long long)1<<63);
+    }
+    return result;
+}
+
+
+/*************************************************************************
+Inverse of TSortKey()
+*************************************************************************/
+static double tsortvalue(unsigned long long k)
+{
+    double result;
+
+    if( (k>>63)!=0 )
+    {
+        k = k&~((unsigned long long)1<<63);
+    }
+    else
+    {
+        k = ~k;
+    }
+    memcpy(&result, &k, sizeof(result));
+    return result;
+}
+
+
+/*************************************************************************
+Stable LSD radix sort of keys K[0..N-1] (and tags P[0..N-1], if P is not
+NULL), 8-bit digits. K2/P2 are buffers of the same size. Histograms of all
+digits are calculated by one pass, passes in which all keys have the same
+digit are skipped. Result is returned in K/P.
+*************************************************************************/
+static void tsortradix(unsigned long long* k,
+     int* p,
+     unsigned long long* k2,
+     int* p2,
+     int n)
+{
+    ap::integer_1d_array cnt;
+    unsigned long long* ks;
+    unsigned long long* kd;
+    unsigned long long* kt;
+    int* ps;
+    int* pd;
+    int* pt;
+    int* c;
+    int pass;
+    int shift;
+    int i;
+    int j;
+    int d;
+    int s;
+    int t;
+    unsigned long long v;
+
+    if( n<=1 )
+    {
+        return;
+    }
+    cnt.setlength(tsortpasses*tsortdigits);
+    for(i = 0; i <= tsortpasses*tsortdigits-1; i++)
+    {
+        cnt(i) = 0;
+    }
+    c = &cnt(0);
+    for(i = 0; i <= n-1; i++)
+    {
+        v = k[i];
+        for(pass = 0; pass <= tsortpasses-1; pass++)
+        {
+            c[pass*tsortdigits+int((v>>(pass*tsortdigitbits))&(tsortdigits-1))]++;
+        }
+    }
+    ks = k;
+    kd = k2;
+    ps = p;
+    pd = p2;
+    for(pass = 0; pass <= tsortpasses-1; pass++)
+    {
+        shift = pass*tsortdigitbits;
+        c = &cnt(pass*tsortdigits);
+        if( c[int((ks[0]>>shift)&(tsortdigits-1))]==n )
+        {
+            continue;
+        }
+        s = 0;
+        for(d = 0; d <= tsortdigits-1; d++)
+        {
+            t = c[d];
+            c[d] = s;
+            s = s+t;
+        }
+        if( ps!=NULL )
+        {
+            for(i = 0; i <= n-1; i++)
+            {
+                j = c[int((ks[i]>>shift)&(tsortdigits-1))]++;
+                kd[j] = ks[i];
+                pd[j] = ps[i];
+            }
+        }
+        else
+        {
+            for(i = 0; i <= n-1; i++)
+            {
+                j = c[int((ks[i]>>shift)&(tsortdigits-1))]++;
+                kd[j] = ks[i];
+            }
+        }
+        kt = ks;
+        ks = kd;
+        kd = kt;
+        pt = ps;
+        ps = pd;
+        pd = pt;
+    }
+    if( ks!=k )
+    {
+        memcpy(k, ks, n*sizeof(*k));
+        if( p!=NULL )
+        {
+            memcpy(p, ps, n*sizeof(*p));
+        }
+    }
+}
+
+
+/*************************************************************************
+Parallel sample sort: keys are distributed between NB buckets bounded by
+splitters (chosen from the regular sample of the keys), then buckets are
+sorted by TSortRadix() independently. Distribution preserves order of the
+keys within each bucket, so sort is stable. Arguments are the same as
+those of TSortRadix().
+*************************************************************************/
+static void tsortsamplesort(unsigned long long* k,
+     int* p,
+     unsigned long long* k2,
+     int* p2,
+     int n,
+     int nb)
+{
+    ap::template_1d_array<unsigned long long> smp;
+    ap::template_1d_array<unsigned long long> smpbuf;
+    ap::template_1d_array<unsigned long long> spl;
+    ap::integer_1d_array bid;
+    ap::integer_1d_array cnt;
+    ap::integer_1d_array bstart;
+    int ns;
+    int nc;
+    int chunk;
+    int c;
+    int b;
+    int i;
+    int s;
+    int t;
+
+    
+    //
+    // Splitters: every TSortOversampling-th element of the sorted
+    // regular sample
+    //
+    ns = nb*tsortoversampling;
+    smp.setlength(ns);
+    smpbuf.setlength(ns);
+    for(i = 0; i <= ns-1; i++)
+    {
+        smp(i) = k[int(double(i)*n/ns)];
+    }
+    tsortradix(&smp(0), NULL, &smpbuf(0), NULL, ns);
+    spl.setlength(nb-1);
+    for(b = 0; b <= nb-2; b++)
+    {
+        spl(b) = smp((b+1)*tsortoversampling);
+    }
+    
+    //
+    // Bucket of each key (number of splitters which are <= key), counts
+    // of keys in the buckets for each of NC chunks of the array
+    //
+    nc = nb;
+    chunk = (n+nc-1)/nc;
+    bid.setlength(n);
+    cnt.setlength(nc*nb);
+    #pragma omp parallel for schedule(static)
+    for(c = 0; c <= nc-1; c++)
+    {
+        int i1;
+        int i2;
+        int lo;
+        int hi;
+        int mid;
+        int j;
+
+        for(j = 0; j <= nb-1; j++)
+        {
+            cnt(c*nb+j) = 0;
+        }
+        i1 = c*chunk;
+        i2 = ap::minint(i1+chunk, n);
+        for(j = i1; j <= i2-1; j++)
+        {
+            lo = 0;
+            hi = nb-1;
+            while( lo<hi )
+            {
+                mid = (lo+hi)/2;
+                if( spl(mid)<=k[j] )
+                {
+                    lo = mid+1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            bid(j) = lo;
+            cnt(c*nb+lo)++;
+        }
+    }
+    
+    //
+    // Offsets: bucket-major, chunk-minor order
+    //
+    bstart.setlength(nb+1);
+    s = 0;
+    for(b = 0; b <= nb-1; b++)
+    {
+        bstart(b) = s;
+        for(c = 0; c <= nc-1; c++)
+        {
+            t = cnt(c*nb+b);
+            cnt(c*nb+b) = s;
+            s = s+t;
+        }
+    }
+    bstart(nb) = n;
+    
+    //
+    // Distribution to K2/P2
+    //
+    #pragma omp parallel for schedule(static)
+    for(c = 0; c <= nc-1; c++)
+    {
+        int i1;
+        int i2;
+        int j;
+        int d;
+
+        i1 = c*chunk;
+        i2 = ap::minint(i1+chunk, n);
+        for(j = i1; j <= i2-1; j++)
+        {
+            d = cnt(c*nb+bid(j))++;
+            k2[d] = k[j];
+            if( p!=NULL )
+            {
+                p2[d] = p[j];
+            }
+        }
+    }
+    
+    //
+    // Sort buckets, K/P are used as buffers, then copy back
+    //
+    #pragma omp parallel for schedule(dynamic,1)
+    for(b = 0; b <= nb-1; b++)
+    {
+        int i1;
+        int m;
+
+        i1 = bstart(b);
+        m = bstart(b+1)-i1;
+        if( m>0 )
+        {
+            tsortradix(k2+i1, p!=NULL ? p2+i1 : NULL, k+i1, p!=NULL ? p+i1 : NULL, m);
+            memcpy(k+i1, k2+i1, m*sizeof(*k));
+            if( p!=NULL )
+            {
+                memcpy(p+i1, p2+i1, m*sizeof(*p));
+            }
+        }
+    }
+}
+
+
+/*************************************************************************
+True if loop with WORK operations should be split between threads:
+OpenMP is available, there are several threads, we are not in the parallel
+region already and problem is large enough.
+*************************************************************************/
+static bool tsortparallel(double work)
+{
+    bool result;
+
+    result = false;
+#ifdef _OPENMP
+    result = !omp_in_parallel()&&omp_get_max_threads()>1&&ap::fp_greater_eq(work,tsortparallelwork);
+#endif
+    return result;
+}
 
 
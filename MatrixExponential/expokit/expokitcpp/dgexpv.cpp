@@ -27,8 +27,9 @@ static integer c__6 = 6;
 static doublereal c_b65 = 0.;
 
 /* ----------------------------------------------------------------------| */
-/* Subroutine */ int dgexpv(integer *n, integer *m, doublereal *t, 
-	doublereal *v, doublereal *w, doublereal *tol, doublereal *anorm, 
+/* Subroutine */ int dgexpvd(integer *n, integer *m, doublereal *t, 
+	doublereal *v, doublereal *w, integer *nout, 
+	doublereal *tout, doublereal *wout, doublereal *tol, doublereal *anorm, 
 	doublereal *wsp, integer *lwsp, integer *iwsp, integer *liwsp, S_fp 
 	matvec, void* matvecdata, integer *itrace, integer *iflag)
 {
@@ -47,49 +48,50 @@ static doublereal c_b65 = 0.;
 	    e_wsle();
 
     /* Local variables */
-    static integer ibrkflag;
-    static doublereal step_min__, step_max__;
-    static integer i__, j;
-    static doublereal break_tol__;
-    static integer k1;
-    static doublereal p1, p2, p3;
-    static integer ih, mh, iv, ns, mx;
-    static doublereal xm;
-    static integer j1v;
-    static doublereal hij, sgn, eps, hj1j, sqr1, beta;
+    integer ibrkflag;
+    doublereal step_min__, step_max__;
+    integer i__, j;
+    doublereal break_tol__;
+    integer k1;
+    doublereal p1, p2, p3;
+    integer ih, mh, iv, ns, mx;
+    doublereal xm;
+    integer j1v;
+    doublereal hij, sgn, eps, hj1j, sqr1, beta;
     extern doublereal ddot_(integer *, doublereal *, integer *, doublereal *, 
 	    integer *);
-    static doublereal hump;
+    doublereal hump;
     extern doublereal dnrm2_(integer *, doublereal *, integer *);
     extern /* Subroutine */ int dscal_(integer *, doublereal *, doublereal *, 
 	    integer *);
-    static integer ifree, lfree;
-    static doublereal t_old__;
+    integer ifree, lfree;
+    doublereal t_old__;
     extern /* Subroutine */ int dgemv_(char *, integer *, integer *, 
 	    doublereal *, doublereal *, integer *, doublereal *, integer *, 
 	    doublereal *, doublereal *, integer *, ftnlen);
-    static integer iexph;
-    static doublereal t_new__;
+    integer iexph;
+    doublereal t_new__;
     extern /* Subroutine */ int dcopy_(integer *, doublereal *, integer *, 
 	    doublereal *, integer *);
-    static integer nexph;
+    integer nexph;
     extern /* Subroutine */ int daxpy_(integer *, doublereal *, doublereal *, 
 	    integer *, doublereal *, integer *);
-    static doublereal t_now__;
-    static integer nstep;
-    static doublereal t_out__;
-    static integer nmult;
-    static doublereal vnorm;
+    doublereal t_now__;
+    integer nstep;
+    doublereal t_out__;
+    integer nmult;
+    doublereal vnorm;
     extern /* Subroutine */ int dgpadm_(integer *, integer *, doublereal *, 
 	    doublereal *, integer *, doublereal *, integer *, integer *, 
 	    integer *, integer *, integer *), dnchbv_(integer *, doublereal *,
 	     doublereal *, integer *, doublereal *, doublereal *);
-    static integer nscale;
-    static doublereal rndoff, t_step__, avnorm;
-    static integer ireject;
-    static doublereal err_loc__;
-    static integer nreject, mbrkdwn;
-    static doublereal tbrkdwn, s_error__, x_error__;
+    integer nscale;
+    doublereal rndoff, t_step__, avnorm;
+    integer ireject;
+    integer iout, wout_dim1, wout_offset;
+    doublereal err_loc__;
+    integer nreject, mbrkdwn;
+    doublereal tbrkdwn, s_error__, x_error__;
 
     /* Fortran I/O blocks */
     static cilist io___40 = { 0, 6, 0, 0, 0 };
@@ -133,6 +135,15 @@ static doublereal c_b65 = 0.;
 
 /*     w(n)   : (output) computed approximation of exp(t*A)*v. */
 
+/*     nout   : (input) number of output times (may be 0). */
+
+/*  tout(nout): (input) output times, of the sign of t, sorted by */
+/*              increasing magnitude, with |tout(nout)| .le. |t|. */
+
+/* wout(n,nout): (output) wout(:,i) approximates exp(tout(i)*A)*v. */
+/*              Output times inside a step are evaluated from the */
+/*              Krylov basis of the step, without new matvecs. */
+
 /*     tol    : (input/output) the requested accuracy tolerance on w. */
 /*              If on input tol=0.0d0 or tol is too small (tol.le.eps) */
 /*              the internal value sqrt(eps) is used, and tol is set to */
@@ -220,6 +231,10 @@ static doublereal c_b65 = 0.;
 /* ---  check restrictions on input parameters ... */
     /* Parameter adjustments */
     --w;
+    wout_dim1 = *n;
+    wout_offset = 1 + wout_dim1;
+    wout -= wout_offset;
+    --tout;
     --v;
     --wsp;
     --iwsp;
@@ -240,6 +255,14 @@ static doublereal c_b65 = 0.;
     if (*iflag != 0) {
 	s_stop("bad sizes (in input of DGEXPV)", (ftnlen)30);
     }
+    i__1 = *nout;
+    for (iout = 1; iout <= i__1; ++iout) {
+	if (tout[iout] * *t < 0. || abs(tout[iout]) > abs(*t) || (iout > 1 && 
+		abs(tout[iout]) < abs(tout[iout - 1]))) {
+	    s_stop("bad output times (in input of DGEXPV)", (ftnlen)37);
+	}
+    }
+    iout = 1;
 
 /* ---  initialisations ... */
 
@@ -303,6 +326,15 @@ L1:
 /* ---  step-by-step integration ... */
 
 L100:
+
+/* ---  output times reached: wout(:,iout) = w ... */
+
+    for (; iout <= *nout; ++iout) {
+	if (abs(tout[iout]) > t_now__) {
+	    break;
+	}
+	dcopy_(n, &w[1], &c__1, &wout[iout * wout_dim1 + 1], &c__1);
+    }
     if (t_now__ >= t_out__) {
 	goto L500;
     }
@@ -339,12 +371,14 @@ L100:
 	hj1j = dnrm2_(n, &wsp[j1v], &c__1);
 /* ---     if `happy breakdown' go straightforward at the end ... */
 	if (hj1j <= break_tol__) {
-	    s_wsle(&io___40);
-	    do_lio(&c__9, &c__1, "happy breakdown: mbrkdwn =", (ftnlen)26);
-	    do_lio(&c__3, &c__1, (char *)&j, (ftnlen)sizeof(integer));
-	    do_lio(&c__9, &c__1, " h =", (ftnlen)4);
-	    do_lio(&c__5, &c__1, (char *)&hj1j, (ftnlen)sizeof(doublereal));
-	    e_wsle();
+	    if (*itrace != 0) {
+		s_wsle(&io___40);
+		do_lio(&c__9, &c__1, "happy breakdown: mbrkdwn =", (ftnlen)26);
+		do_lio(&c__3, &c__1, (char *)&j, (ftnlen)sizeof(integer));
+		do_lio(&c__9, &c__1, " h =", (ftnlen)4);
+		do_lio(&c__5, &c__1, (char *)&hj1j, (ftnlen)sizeof(doublereal));
+		e_wsle();
+	    }
 	    k1 = 0;
 	    ibrkflag = 1;
 	    mbrkdwn = j;
@@ -475,6 +509,23 @@ L401:
     mx = mbrkdwn + max(i__1,i__2);
     dgemv_("n", n, &mx, &beta, &wsp[iv], n, &wsp[iexph], &c__1, &c_b65, &w[1],
 	     &c__1, (ftnlen)1);
+
+/* ---  dense output: wout(:,iout) = beta*V*exp(s*H)*e1 for the output */
+/*      times inside the step, s = |tout(iout)|-t_now ... */
+
+    for (; iout <= *nout; ++iout) {
+	if (abs(tout[iout]) >= t_now__ + t_step__) {
+	    break;
+	}
+	i__1 = mbrkdwn + k1;
+	d__1 = sgn * (abs(tout[iout]) - t_now__);
+	dgpadm_(&c__6, &i__1, &d__1, &wsp[ih], &mh, &wsp[ifree], &lfree, &iwsp[
+		1], &iexph, &ns, iflag);
+	iexph = ifree + iexph - 1;
+	++nexph;
+	dgemv_("n", n, &mx, &beta, &wsp[iv], n, &wsp[iexph], &c__1, &c_b65, &wout[
+		iout * wout_dim1 + 1], &c__1, (ftnlen)1);
+    }
     beta = dnrm2_(n, &w[1], &c__1);
     hump = max(hump,beta);
 
@@ -545,6 +596,20 @@ L500:
     wsp[9] = hump / vnorm;
     wsp[10] = beta / vnorm;
     return 0;
+} /* dgexpvd_ */
+
+/* ----------------------------------------------------------------------| */
+/* Subroutine */ int dgexpv(integer *n, integer *m, doublereal *t, 
+	doublereal *v, doublereal *w, doublereal *tol, doublereal *anorm, 
+	doublereal *wsp, integer *lwsp, integer *iwsp, integer *liwsp, S_fp 
+	matvec, void* matvecdata, integer *itrace, integer *iflag)
+{
+    integer nout = 0;
+
+/* ---  DGEXPV without output times ... */
+
+    return dgexpvd(n, m, t, v, w, &nout, t, w, tol, anorm, wsp, 
+	    lwsp, iwsp, liwsp, matvec, matvecdata, itrace, iflag);
 } /* dgexpv_ */
 
 #ifdef __cplusplus
@@ -39,23 +39,23 @@ static doublereal c_b23 = 2.;
     integer pow_ii(integer *, integer *);
 
     /* Local variables */
-    static integer i__, j, k;
-    static doublereal cp, cq;
-    static integer ip, mm, iq, ih2, iodd, iget, iput, icoef;
+    integer i__, j, k;
+    doublereal cp, cq;
+    integer ip, mm, iq, ih2, iodd, iget, iput, icoef;
     extern /* Subroutine */ int dscal_(integer *, doublereal *, doublereal *, 
 	    integer *);
-    static doublereal scale;
+    doublereal scale;
     extern /* Subroutine */ int dgemm_(char *, char *, integer *, integer *, 
 	    integer *, doublereal *, doublereal *, integer *, doublereal *, 
 	    integer *, doublereal *, doublereal *, integer *, ftnlen, ftnlen);
-    static integer ifree;
+    integer ifree;
     extern /* Subroutine */ int dgesv_(integer *, integer *, doublereal *, 
 	    integer *, integer *, doublereal *, integer *, integer *);
-    static integer iused;
-    static doublereal hnorm;
+    integer iused;
+    doublereal hnorm;
     extern /* Subroutine */ int daxpy_(integer *, doublereal *, doublereal *, 
 	    integer *, doublereal *, integer *);
-    static doublereal scale2;
+    doublereal scale2;
 
 /* -----Purpose----------------------------------------------------------| */
 
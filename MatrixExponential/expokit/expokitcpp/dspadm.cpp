@@ -39,22 +39,22 @@ static doublereal c_b24 = 2.;
     integer pow_ii(integer *, integer *);
 
     /* Local variables */
-    static integer i__, j, k;
-    static doublereal cp, cq;
-    static integer ip, mm, iq, ih2, iodd, iget, iput, icoef;
+    integer i__, j, k;
+    doublereal cp, cq;
+    integer ip, mm, iq, ih2, iodd, iget, iput, icoef;
     extern /* Subroutine */ int dscal_(integer *, doublereal *, doublereal *, 
 	    integer *);
-    static doublereal scale;
+    doublereal scale;
     extern /* Subroutine */ int dgemm_(char *, char *, integer *, integer *, 
 	    integer *, doublereal *, doublereal *, integer *, doublereal *, 
 	    integer *, doublereal *, doublereal *, integer *, ftnlen, ftnlen);
-    static integer ifree, iused;
-    static doublereal hnorm;
+    integer ifree, iused;
+    doublereal hnorm;
     extern /* Subroutine */ int daxpy_(integer *, doublereal *, doublereal *, 
 	    integer *, doublereal *, integer *), dsysv_(char *, integer *, 
 	    integer *, doublereal *, integer *, integer *, doublereal *, 
 	    integer *, doublereal *, integer *, integer *, ftnlen);
-    static doublereal scale2;
+    doublereal scale2;
 
 /* -----Purpose----------------------------------------------------------| */
 
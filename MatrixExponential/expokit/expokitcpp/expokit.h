@@ -29,6 +29,10 @@ int dgpadm_(int *ideg, int *m, double *t,
 	double *h__, int *ldh, double *wsp, int *lwsp, 
 	int *ipiv, int *iexph, int *ns, int *iflag);
 
+int zgpadm_(int *ideg, int *m, double *t,
+	cplx *h__, int *ldh, cplx *wsp, int *lwsp,
+	int *ipiv, int *iexph, int *ns, int *iflag);
+
 //int dgpadm(int *ideg, int *m, double *t, 
 //	double *h__, int *ldh, double *wsp, int *lwsp, 
 //	int *ipiv, int *iexph, int *ns, int *iflag);
@@ -48,6 +52,28 @@ int zhexpv(int *n, int *m, double *t,
 	anorm, cplx *wsp, int *lwsp, int *iwsp, int *
 	liwsp, matvecfunc_cplx matvec, void *matvecdata, int *itrace, int *iflag);
 
+//As above, also giving exp(tout[i]*A)*v in wout[i*n...] at the nout
+//sorted output times tout, taken from the Krylov basis of each step
+int dgexpvd(int *n, int *m, double *t,
+	double *v, double *w, int *nout, double *tout, double *wout,
+	double *tol, double *anorm, double *wsp, int *lwsp, int *iwsp,
+	int *liwsp, matvecfunc_double matvec, void *matvecdata, int *itrace, int *iflag);
+
+int dsexpvd(int *n, int *m, double *t,
+	double *v, double *w, int *nout, double *tout, double *wout,
+	double *tol, double *anorm, double *wsp, int *lwsp, int *iwsp,
+	int *liwsp, matvecfunc_double matvec, void *matvecdata, int *itrace, int *iflag);
+
+int zgexpvd(int *n, int *m, double *t,
+	cplx *v, cplx *w, int *nout, double *tout, cplx *wout,
+	double *tol, double *anorm, cplx *wsp, int *lwsp, int *iwsp,
+	int *liwsp, matvecfunc_cplx matvec, void *matvecdata, int *itrace, int *iflag);
+
+int zhexpvd(int *n, int *m, double *t,
+	cplx *v, cplx *w, int *nout, double *tout, cplx *wout,
+	double *tol, double *anorm, cplx *wsp, int *lwsp, int *iwsp,
+	int *liwsp, matvecfunc_cplx matvec, void *matvecdata, int *itrace, int *iflag);
+
 }
 
 };
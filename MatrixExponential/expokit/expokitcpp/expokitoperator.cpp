@@ -0,0 +1,189 @@
+#include "expokitoperator.h"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace expokit
+{
+
+//Products with fewer non-zeros than this run on one thread
+const int OmpMinNonZeros = 32768;
+
+
+//Splits 0..n-1 into nparts ranges holding about the same number of
+//non-zeros (ptr is the row or column start index array), returns part
+static void Partition(const std::vector<int> &ptr, int n, int part, int nparts, int &k0, int &k1)
+{
+	long long nz = ptr[n];
+	k0 = std::lower_bound(ptr.begin(), ptr.begin() + n, (int)(nz * part / nparts)) - ptr.begin();
+	k1 = std::lower_bound(ptr.begin(), ptr.begin() + n, (int)(nz * (part + 1) / nparts)) - ptr.begin();
+	if (part == nparts - 1)
+	{
+		k1 = n;
+	}
+}
+
+
+static void Compress(int n, const int *ptr, const int *index, int indexBase, std::vector<int> &outPtr, std::vector<int> &outIndex)
+{
+	int nz = ptr[n] - ptr[0];
+	outPtr.resize(n + 1);
+	outIndex.resize(nz);
+	for (int i = 0; i <= n; i++)
+	{
+		outPtr[i] = ptr[i] - ptr[0];
+	}
+	for (int k = 0; k < nz; k++)
+	{
+		outIndex[k] = index[k] - indexBase;
+	}
+}
+
+
+template<class T>
+CsrMatrix<T>::CsrMatrix(int n, const int *rowPtr, const int *colIndex, const T *values, int indexBase)
+	: N(n)
+{
+	Compress(n, rowPtr, colIndex, indexBase, RowPtr, ColIndex);
+	Values.assign(values, values + RowPtr[n]);
+}
+
+
+template<class T>
+double CsrMatrix<T>::NormInf() const
+{
+	double norm = 0;
+	for (int i = 0; i < N; i++)
+	{
+		double sum = 0;
+		for (int k = RowPtr[i]; k < RowPtr[i+1]; k++)
+		{
+			sum += std::abs(Values[k]);
+		}
+		norm = std::max(norm, sum);
+	}
+	return norm;
+}
+
+
+template<class T>
+void CsrMatrix<T>::Multiply(const T *in, T *out) const
+{
+	const int *rowPtr = &RowPtr[0];
+	const int *colIndex = NonZeros() > 0 ? &ColIndex[0] : 0;
+	const T *values = NonZeros() > 0 ? &Values[0] : 0;
+
+	#pragma omp parallel if (NonZeros() >= OmpMinNonZeros)
+	{
+		int i0 = 0, i1 = N;
+#ifdef _OPENMP
+		Partition(RowPtr, N, omp_get_thread_num(), omp_get_num_threads(), i0, i1);
+#endif
+		for (int i = i0; i < i1; i++)
+		{
+			T sum = 0;
+			for (int k = rowPtr[i]; k < rowPtr[i+1]; k++)
+			{
+				sum += values[k] * in[colIndex[k]];
+			}
+			out[i] = sum;
+		}
+	}
+}
+
+
+template<class T>
+CscMatrix<T>::CscMatrix(int n, const int *colPtr, const int *rowIndex, const T *values, int indexBase)
+	: N(n)
+{
+	Compress(n, colPtr, rowIndex, indexBase, ColPtr, RowIndex);
+	Values.assign(values, values + ColPtr[n]);
+}
+
+
+template<class T>
+double CscMatrix<T>::NormInf() const
+{
+	std::vector<double> sum(N, 0.0);
+	for (int j = 0; j < N; j++)
+	{
+		for (int k = ColPtr[j]; k < ColPtr[j+1]; k++)
+		{
+			sum[RowIndex[k]] += std::abs(Values[k]);
+		}
+	}
+	return N > 0 ? *std::max_element(sum.begin(), sum.end()) : 0.0;
+}
+
+
+template<class T>
+void CscMatrix<T>::Multiply(const T *in, T *out) const
+{
+	int threads = 1;
+#ifdef _OPENMP
+	if (NonZeros() >= OmpMinNonZeros && !omp_in_parallel())
+	{
+		threads = omp_get_max_threads();
+	}
+#endif
+
+	if (threads == 1)
+	{
+		std::fill(out, out + N, T(0));
+		for (int j = 0; j < N; j++)
+		{
+			T x = in[j];
+			for (int k = ColPtr[j]; k < ColPtr[j+1]; k++)
+			{
+				out[RowIndex[k]] += Values[k] * x;
+			}
+		}
+		return;
+	}
+
+	Partial.resize((size_t)N * threads);
+
+	#pragma omp parallel num_threads(threads)
+	{
+		int j0 = 0, j1 = N, part = 0, parts = 1;
+#ifdef _OPENMP
+		part = omp_get_thread_num();
+		parts = omp_get_num_threads();
+#endif
+		T *buffer = &Partial[(size_t)N * part];
+		std::fill(buffer, buffer + N, T(0));
+		Partition(ColPtr, N, part, parts, j0, j1);
+		for (int j = j0; j < j1; j++)
+		{
+			T x = in[j];
+			for (int k = ColPtr[j]; k < ColPtr[j+1]; k++)
+			{
+				buffer[RowIndex[k]] += Values[k] * x;
+			}
+		}
+
+		#pragma omp barrier
+		#pragma omp for schedule(static)
+		for (int i = 0; i < N; i++)
+		{
+			T sum = 0;
+			for (int p = 0; p < parts; p++)
+			{
+				sum += Partial[(size_t)N * p + i];
+			}
+			out[i] = sum;
+		}
+	}
+}
+
+
+template class CsrMatrix<double>;
+template class CsrMatrix<cplx>;
+template class CscMatrix<double>;
+template class CscMatrix<cplx>;
+
+} //Namespace
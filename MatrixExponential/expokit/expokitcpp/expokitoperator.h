@@ -0,0 +1,88 @@
+#ifndef EXPOKITOPERATOR_H
+#define EXPOKITOPERATOR_H
+
+#include <complex>
+#include <vector>
+
+typedef std::complex<double> cplx;
+
+namespace expokit
+{
+
+/*
+ * Linear operator A, as seen by the Krylov routines: only the product
+ * out = A*in is needed. MatVec is the callback passed to dgexpv & co,
+ * with the operator itself as matvecdata.
+ */
+template<class T>
+class LinearOperator
+{
+public:
+	virtual ~LinearOperator() {}
+
+	virtual int Size() const = 0;
+	virtual double NormInf() const = 0;
+	virtual void Multiply(const T *in, T *out) const = 0;
+
+	static void MatVec(void *data, T *in, T *out)
+	{
+		static_cast<const LinearOperator<T>*>(data)->Multiply(in, out);
+	}
+};
+
+
+/*
+ * Sparse matrix in compressed sparse row format. The product is a
+ * gather per row; rows are split between threads by number of non-zeros.
+ * Indices may be 0-based (C) or 1-based (Fortran, as in the expokit
+ * sample loaders), they are stored 0-based.
+ */
+template<class T>
+class CsrMatrix : public LinearOperator<T>
+{
+public:
+	CsrMatrix(int n, const int *rowPtr, const int *colIndex, const T *values, int indexBase = 0);
+
+	int Size() const { return N; }
+	int NonZeros() const { return RowPtr[N]; }
+	double NormInf() const;
+	void Multiply(const T *in, T *out) const;
+
+private:
+	int N;
+	std::vector<int> RowPtr;
+	std::vector<int> ColIndex;
+	std::vector<T> Values;
+};
+
+
+/*
+ * Sparse matrix in compressed sparse column format. The product is a
+ * scatter per column; with several threads, each one scatters its share
+ * of the columns into a buffer of its own and the buffers are summed.
+ * The buffers are kept between products, so a CscMatrix must not be
+ * multiplied by several threads at once, except from inside an OpenMP
+ * parallel region (where the product runs serially without buffers).
+ */
+template<class T>
+class CscMatrix : public LinearOperator<T>
+{
+public:
+	CscMatrix(int n, const int *colPtr, const int *rowIndex, const T *values, int indexBase = 0);
+
+	int Size() const { return N; }
+	int NonZeros() const { return ColPtr[N]; }
+	double NormInf() const;
+	void Multiply(const T *in, T *out) const;
+
+private:
+	int N;
+	std::vector<int> ColPtr;
+	std::vector<int> RowIndex;
+	std::vector<T> Values;
+	mutable std::vector<T> Partial;
+};
+
+} // Namespace
+
+#endif
@@ -0,0 +1,508 @@
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+#include "expokitpadm.h"
+#include "expokit.h"
+
+//f2c.h macros
+#undef abs
+#undef min
+#undef max
+
+namespace expokit
+{
+
+//Matrices handled together by the unrolled kernels, one per SIMD lane
+const int BatchWidth = 8;
+
+//Largest order with an unrolled kernel
+const int MaxUnrolledOrder = 8;
+
+//Batches with fewer flops than this run on one thread
+const double OmpMinFlops = 262144.0;
+
+
+//Complex products written out, so that they do not go through the
+//NaN checks of the library operator, which keep loops from vectorizing
+inline double Mul(double a, double b)
+{
+	return a * b;
+}
+
+inline cplx Mul(const cplx &a, const cplx &b)
+{
+	return cplx(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+inline double Inv(double a)
+{
+	return 1.0 / a;
+}
+
+inline cplx Inv(const cplx &a)
+{
+	double s = 1.0 / (a.real() * a.real() + a.imag() * a.imag());
+	return cplx(a.real() * s, -a.imag() * s);
+}
+
+
+//Pade coefficients, as in dgpadm
+static void PadeCoefficients(int degree, double *coef)
+{
+	coef[0] = 1.0;
+	for (int k = 1; k <= degree; k++)
+	{
+		coef[k] = coef[k-1] * (double)(degree + 1 - k) / (double)(k * (2*degree + 1 - k));
+	}
+}
+
+
+//|t|*||H||inf, summed in the order of dgpadm
+template<class T>
+static double ScaledNorm(int m, double t, const T *h)
+{
+	double hnorm = 0;
+	for (int i = 0; i < m; i++)
+	{
+		double sum = 0;
+		for (int j = 0; j < m; j++)
+		{
+			sum += std::abs(h[i + (size_t)j * m]);
+		}
+		hnorm = std::max(hnorm, sum);
+	}
+	return std::abs(t * hnorm);
+}
+
+
+//Number of squarings ns such that ||t*H/2^ns|| < 1/2, as in dgpadm
+static int ScalingPower(double hnorm)
+{
+	if (hnorm == 0)
+	{
+		return 0;
+	}
+	return std::max(0, (int)(std::log(hnorm) / std::log(2.0)) + 2);
+}
+
+
+template<class T>
+static void Identity(int m, T *a)
+{
+	std::fill(a, a + (size_t)m * m, T(0));
+	for (int i = 0; i < m; i++)
+	{
+		a[i + (size_t)i * m] = 1;
+	}
+}
+
+
+/*
+ * Kernels of order M. A block holds entry e of matrix l of the batch at
+ * [e][l], so that every step is a loop over the lanes.
+ */
+
+//c = a*b
+template<int M, class T>
+static void Multiply(const T (*a)[BatchWidth], const T (*b)[BatchWidth], T (*c)[BatchWidth])
+{
+	for (int j = 0; j < M; j++)
+	{
+		for (int i = 0; i < M; i++)
+		{
+			T sum[BatchWidth];
+			#pragma omp simd
+			for (int l = 0; l < BatchWidth; l++)
+			{
+				sum[l] = 0;
+			}
+			for (int k = 0; k < M; k++)
+			{
+				#pragma omp simd
+				for (int l = 0; l < BatchWidth; l++)
+				{
+					sum[l] += Mul(a[i + k*M][l], b[k + j*M][l]);
+				}
+			}
+			#pragma omp simd
+			for (int l = 0; l < BatchWidth; l++)
+			{
+				c[i + j*M][l] = sum[l];
+			}
+		}
+	}
+}
+
+
+//Complex lanes as interleaved real and imaginary parts, with separate
+//real and imaginary sums
+template<int M>
+static void Multiply(const cplx (*a)[BatchWidth], const cplx (*b)[BatchWidth], cplx (*c)[BatchWidth])
+{
+	for (int j = 0; j < M; j++)
+	{
+		for (int i = 0; i < M; i++)
+		{
+			double re[BatchWidth], im[BatchWidth];
+			#pragma omp simd
+			for (int l = 0; l < BatchWidth; l++)
+			{
+				re[l] = 0;
+				im[l] = 0;
+			}
+			for (int k = 0; k < M; k++)
+			{
+				const double *x = reinterpret_cast<const double*>(a[i + k*M]);
+				const double *y = reinterpret_cast<const double*>(b[k + j*M]);
+				#pragma omp simd
+				for (int l = 0; l < BatchWidth; l++)
+				{
+					re[l] += x[2*l] * y[2*l] - x[2*l+1] * y[2*l+1];
+					im[l] += x[2*l] * y[2*l+1] + x[2*l+1] * y[2*l];
+				}
+			}
+			double *z = reinterpret_cast<double*>(c[i + j*M]);
+			#pragma omp simd
+			for (int l = 0; l < BatchWidth; l++)
+			{
+				z[2*l] = re[l];
+				z[2*l+1] = im[l];
+			}
+		}
+	}
+}
+
+template<int M, class T>
+static void Scale(const double *s, T (*a)[BatchWidth])
+{
+	for (int e = 0; e < M*M; e++)
+	{
+		#pragma omp simd
+		for (int l = 0; l < BatchWidth; l++)
+		{
+			a[e][l] *= s[l];
+		}
+	}
+}
+
+
+template<int M, class T>
+static void AddDiagonal(double c, T (*a)[BatchWidth])
+{
+	for (int i = 0; i < M; i++)
+	{
+		#pragma omp simd
+		for (int l = 0; l < BatchWidth; l++)
+		{
+			a[i + i*M][l] += c;
+		}
+	}
+}
+
+
+//b = a\b. After the scaling, the matrix is +/- the Pade denominator of
+//a matrix of norm < 1/2, which is strictly diagonally dominant: the
+//elimination needs no row exchanges, and all the lanes take the same steps.
+template<int M, class T>
+static void Solve(T (*a)[BatchWidth], T (*b)[BatchWidth])
+{
+	T inv[M][BatchWidth];
+	for (int c = 0; c < M; c++)
+	{
+		#pragma omp simd
+		for (int l = 0; l < BatchWidth; l++)
+		{
+			inv[c][l] = Inv(a[c + c*M][l]);
+		}
+		for (int r = c+1; r < M; r++)
+		{
+			T f[BatchWidth];
+			#pragma omp simd
+			for (int l = 0; l < BatchWidth; l++)
+			{
+				f[l] = Mul(a[r + c*M][l], inv[c][l]);
+			}
+			for (int j = c+1; j < M; j++)
+			{
+				#pragma omp simd
+				for (int l = 0; l < BatchWidth; l++)
+				{
+					a[r + j*M][l] -= Mul(f[l], a[c + j*M][l]);
+				}
+			}
+			for (int j = 0; j < M; j++)
+			{
+				#pragma omp simd
+				for (int l = 0; l < BatchWidth; l++)
+				{
+					b[r + j*M][l] -= Mul(f[l], b[c + j*M][l]);
+				}
+			}
+		}
+	}
+
+	for (int j = 0; j < M; j++)
+	{
+		for (int r = M-1; r >= 0; r--)
+		{
+			for (int k = r+1; k < M; k++)
+			{
+				#pragma omp simd
+				for (int l = 0; l < BatchWidth; l++)
+				{
+					b[r + j*M][l] -= Mul(a[r + k*M][l], b[k + j*M][l]);
+				}
+			}
+			#pragma omp simd
+			for (int l = 0; l < BatchWidth; l++)
+			{
+				b[r + j*M][l] = Mul(b[r + j*M][l], inv[r][l]);
+			}
+		}
+	}
+}
+
+
+//The steps of dgpadm for count <= BatchWidth matrices; missing
+//matrices are taken as null
+template<int M, class T>
+static void PadeKernel(int count, const double *t, const T *h, T *expH, int degree, const double *coef)
+{
+	const int MM = M*M;
+	T H[MM][BatchWidth];
+	T buffer[4][MM][BatchWidth];
+	double scale[BatchWidth], scale2[BatchWidth], sign[BatchWidth];
+	int ns[BatchWidth];
+	int maxns = 0;
+
+	for (int l = 0; l < BatchWidth; l++)
+	{
+		ns[l] = 0;
+		scale[l] = 0;
+		for (int e = 0; e < MM; e++)
+		{
+			H[e][l] = l < count ? h[(size_t)l * MM + e] : T(0);
+		}
+		if (l < count)
+		{
+			ns[l] = ScalingPower(ScaledNorm(M, t[l], h + (size_t)l * MM));
+			scale[l] = std::ldexp(t[l], -ns[l]);
+		}
+		scale2[l] = scale[l] * scale[l];
+		maxns = std::max(maxns, ns[l]);
+	}
+
+	//H2 = scale2*H*H
+	T (*h2)[BatchWidth] = buffer[0];
+	Multiply<M>(H, H, h2);
+	Scale<M>(scale2, h2);
+
+	//Numerator and denominator, Horner rule
+	T (*p)[BatchWidth] = buffer[1];
+	T (*q)[BatchWidth] = buffer[2];
+	T (*spare)[BatchWidth] = buffer[3];
+	for (int e = 0; e < MM; e++)
+	{
+		#pragma omp simd
+		for (int l = 0; l < BatchWidth; l++)
+		{
+			p[e][l] = 0;
+			q[e][l] = 0;
+		}
+	}
+	AddDiagonal<M>(coef[degree-1], p);
+	AddDiagonal<M>(coef[degree], q);
+
+	bool odd = true;
+	for (int k = degree-1; k > 0; k--)
+	{
+		T (*used)[BatchWidth] = odd ? q : p;
+		Multiply<M>(used, h2, spare);
+		AddDiagonal<M>(coef[k-1], spare);
+		if (odd)
+		{
+			q = spare;
+		}
+		else
+		{
+			p = spare;
+		}
+		spare = used;
+		odd = !odd;
+	}
+
+	//(+/-)(I + 2*(q-p)\p)
+	if (odd)
+	{
+		Multiply<M>(q, H, spare);
+		Scale<M>(scale, spare);
+		q = spare;
+	}
+	else
+	{
+		Multiply<M>(p, H, spare);
+		Scale<M>(scale, spare);
+		p = spare;
+	}
+	for (int e = 0; e < MM; e++)
+	{
+		#pragma omp simd
+		for (int l = 0; l < BatchWidth; l++)
+		{
+			q[e][l] -= p[e][l];
+		}
+	}
+	Solve<M>(q, p);
+
+	for (int l = 0; l < BatchWidth; l++)
+	{
+		sign[l] = (odd && ns[l] == 0) ? -2.0 : 2.0;
+	}
+	Scale<M>(sign, p);
+	for (int l = 0; l < BatchWidth; l++)
+	{
+		sign[l] = (odd && ns[l] == 0) ? -1.0 : 1.0;
+	}
+	for (int i = 0; i < M; i++)
+	{
+		#pragma omp simd
+		for (int l = 0; l < BatchWidth; l++)
+		{
+			p[i + i*M][l] += sign[l];
+		}
+	}
+
+	//Squaring, each lane keeps its result after its own ns squarings
+	T (*x)[BatchWidth] = p;
+	T (*y)[BatchWidth] = q;
+	for (int s = 0; s < maxns; s++)
+	{
+		Multiply<M>(x, x, y);
+		for (int e = 0; e < MM; e++)
+		{
+			#pragma omp simd
+			for (int l = 0; l < BatchWidth; l++)
+			{
+				y[e][l] = s < ns[l] ? y[e][l] : x[e][l];
+			}
+		}
+		std::swap(x, y);
+	}
+
+	for (int l = 0; l < count; l++)
+	{
+		for (int e = 0; e < MM; e++)
+		{
+			expH[(size_t)l * MM + e] = x[e][l];
+		}
+	}
+}
+
+
+template<int M, class T>
+static void PadeUnrolled(int count, const double *t, const T *h, T *expH, int degree, const double *coef)
+{
+	const size_t MM = M*M;
+	int blocks = (count + BatchWidth - 1) / BatchWidth;
+
+	#pragma omp parallel for schedule(static) if ((double)count * MM * M * (degree + 4) >= OmpMinFlops)
+	for (int b = 0; b < blocks; b++)
+	{
+		size_t k = (size_t)b * BatchWidth;
+		PadeKernel<M>(std::min(BatchWidth, count - (int)k), t + k, h + k * MM, expH + k * MM, degree, coef);
+	}
+}
+
+
+static void Padm(int degree, int m, double t, double *h, double *wsp, int lwsp, int *ipiv, int *iexph)
+{
+	int ns = 0;
+	int flag = 0;
+	dgpadm_(&degree, &m, &t, h, &m, wsp, &lwsp, ipiv, iexph, &ns, &flag);
+}
+
+
+static void Padm(int degree, int m, double t, cplx *h, cplx *wsp, int lwsp, int *ipiv, int *iexph)
+{
+	int ns = 0;
+	int flag = 0;
+	zgpadm_(&degree, &m, &t, h, &m, wsp, &lwsp, ipiv, iexph, &ns, &flag);
+}
+
+
+//One dgpadm/zgpadm per matrix, with a workspace per thread
+template<class T>
+static void PadeGeneral(int m, int count, const double *t, const T *h, T *expH, int degree)
+{
+	const size_t mm = (size_t)m * m;
+
+	#pragma omp parallel if ((double)count * mm * m * (degree + 4) >= OmpMinFlops)
+	{
+		std::vector<T> wsp(4 * mm + degree + 1);
+		std::vector<int> ipiv(m);
+		int lwsp = wsp.size();
+
+		#pragma omp for schedule(dynamic, 1)
+		for (int k = 0; k < count; k++)
+		{
+			const T *hk = h + k * mm;
+			T *ek = expH + k * mm;
+			if (ScaledNorm(m, t[k], hk) == 0)
+			{
+				Identity(m, ek);
+			}
+			else
+			{
+				int iexph = 0;
+				Padm(degree, m, t[k], const_cast<T*>(hk), &wsp[0], lwsp, &ipiv[0], &iexph);
+				std::copy(wsp.begin() + (iexph - 1), wsp.begin() + (iexph - 1 + mm), ek);
+			}
+		}
+	}
+}
+
+
+template<class T>
+static void Pade(int m, int count, const double *t, const T *h, T *expH, int degree)
+{
+	if (m < 1 || count < 0 || degree < 2)
+	{
+		throw std::runtime_error("Invalid arguments to PadeBatch");
+	}
+	if (m > MaxUnrolledOrder)
+	{
+		PadeGeneral(m, count, t, h, expH, degree);
+		return;
+	}
+
+	std::vector<double> coef(degree + 1);
+	PadeCoefficients(degree, &coef[0]);
+	switch (m)
+	{
+	case 1: PadeUnrolled<1>(count, t, h, expH, degree, &coef[0]); break;
+	case 2: PadeUnrolled<2>(count, t, h, expH, degree, &coef[0]); break;
+	case 3: PadeUnrolled<3>(count, t, h, expH, degree, &coef[0]); break;
+	case 4: PadeUnrolled<4>(count, t, h, expH, degree, &coef[0]); break;
+	case 5: PadeUnrolled<5>(count, t, h, expH, degree, &coef[0]); break;
+	case 6: PadeUnrolled<6>(count, t, h, expH, degree, &coef[0]); break;
+	case 7: PadeUnrolled<7>(count, t, h, expH, degree, &coef[0]); break;
+	case 8: PadeUnrolled<8>(count, t, h, expH, degree, &coef[0]); break;
+	}
+}
+
+
+void PadeBatch(int m, int count, const double *t, const double *h, double *expH, int degree)
+{
+	Pade(m, count, t, h, expH, degree);
+}
+
+
+void PadeBatch(int m, int count, const double *t, const cplx *h, cplx *expH, int degree)
+{
+	Pade(m, count, t, h, expH, degree);
+}
+
+} //Namespace
@@ -0,0 +1,28 @@
+#ifndef EXPOKITPADM_H
+#define EXPOKITPADM_H
+
+#include <complex>
+
+typedef std::complex<double> cplx;
+
+namespace expokit
+{
+
+/*
+ * Computes exp(t[k]*H_k), k = 0..count-1, for a batch of dense matrices
+ * of order m with the irreducible Pade approximation and scaling and
+ * squaring of dgpadm/zgpadm. The matrices are stored consecutively,
+ * column major with m*m entries each, and so are the exponentials
+ * (expH may be h).
+ *
+ * Orders up to 8 use kernels unrolled for the order, which work on
+ * several matrices at a time, one per SIMD lane. Larger orders call
+ * dgpadm/zgpadm for each matrix. The batch is split between OpenMP
+ * threads. A null t*H_k gives the identity (dgpadm stops instead).
+ */
+void PadeBatch(int m, int count, const double *t, const double *h, double *expH, int degree = 6);
+void PadeBatch(int m, int count, const double *t, const cplx *h, cplx *expH, int degree = 6);
+
+} // Namespace
+
+#endif
@@ -0,0 +1,205 @@
+#include <complex>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "expokitsolver.h"
+#include "expokit.h"
+
+//f2c.h macros
+#undef abs
+#undef min
+#undef max
+
+namespace expokit
+{
+
+template<class T>
+void KrylovWorkspace<T>::Resize(int n, int m)
+{
+	//wsp:  n*(m+1)+n+(m+2)^2+4*(m+2)^2+ideg+1 with ideg=6 (see dgexpv)
+	//iwsp: m+2, and at least the 7 accounts written on exit
+	size_t wspSize = (size_t)n * (m+2) + 5 * (size_t)(m+2) * (m+2) + 7;
+	size_t iwspSize = std::max(m+2, 7);
+	if (Wsp.size() < wspSize)
+	{
+		Wsp.resize(wspSize);
+	}
+	if (Iwsp.size() < iwspSize)
+	{
+		Iwsp.resize(iwspSize);
+	}
+}
+
+
+static int Expv(MatrixStructure structure, int n, int m, double t, double *v, double *w, int nout, double *tout, double *wout, double *tol, double anorm, KrylovWorkspace<double> &ws, const LinearOperator<double> *op)
+{
+	int trace = 0;
+	int flag = 0;
+	int wspSize = ws.Wsp.size();
+	int iwspSize = ws.Iwsp.size();
+	void *data = const_cast<LinearOperator<double>*>(op);
+	if (nout == 0)
+	{
+		tout = &t;
+		wout = w;
+	}
+
+	if (structure == Symmetric)
+	{
+		dsexpvd(&n, &m, &t, v, w, &nout, tout, wout, tol, &anorm, &ws.Wsp[0], &wspSize, &ws.Iwsp[0], &iwspSize, LinearOperator<double>::MatVec, data, &trace, &flag);
+	}
+	else
+	{
+		dgexpvd(&n, &m, &t, v, w, &nout, tout, wout, tol, &anorm, &ws.Wsp[0], &wspSize, &ws.Iwsp[0], &iwspSize, LinearOperator<double>::MatVec, data, &trace, &flag);
+	}
+	return flag;
+}
+
+
+static int Expv(MatrixStructure structure, int n, int m, double t, cplx *v, cplx *w, int nout, double *tout, cplx *wout, double *tol, double anorm, KrylovWorkspace<cplx> &ws, const LinearOperator<cplx> *op)
+{
+	int trace = 0;
+	int flag = 0;
+	int wspSize = ws.Wsp.size();
+	int iwspSize = ws.Iwsp.size();
+	void *data = const_cast<LinearOperator<cplx>*>(op);
+	if (nout == 0)
+	{
+		tout = &t;
+		wout = w;
+	}
+
+	if (structure == Symmetric)
+	{
+		zhexpvd(&n, &m, &t, v, w, &nout, tout, wout, tol, &anorm, &ws.Wsp[0], &wspSize, &ws.Iwsp[0], &iwspSize, LinearOperator<cplx>::MatVec, data, &trace, &flag);
+	}
+	else
+	{
+		zgexpvd(&n, &m, &t, v, w, &nout, tout, wout, tol, &anorm, &ws.Wsp[0], &wspSize, &ws.Iwsp[0], &iwspSize, LinearOperator<cplx>::MatVec, data, &trace, &flag);
+	}
+	return flag;
+}
+
+
+template<class T>
+ExpvSolver<T>::ExpvSolver(const LinearOperator<T> &op, int basisSize, double tolerance, MatrixStructure structure)
+	: BasisSize(basisSize)
+	, Tolerance(tolerance)
+	, MatrixNorm(op.NormInf())
+	, Structure(structure)
+	, Operator(&op)
+	, LastMatVecCount(0)
+{
+	//The workspace of the calling thread is set up front
+	Workspaces.resize(1);
+	Workspaces[0].Resize(op.Size(), std::max(1, std::min(basisSize, op.Size()-1)));
+}
+
+
+template<class T>
+int ExpvSolver<T>::Propagate(double t, const T *v, T *w, KrylovWorkspace<T> &workspace, int nout, const double *tout, T *wout)
+{
+	int n = Operator->Size();
+	int m = std::min(BasisSize, n-1);
+	double tol = Tolerance;
+
+	//The Krylov routines need 0 < m < n
+	if (n == 1)
+	{
+		T one = 1, a;
+		Operator->Multiply(&one, &a);
+		for (int k = 0; k < nout; k++)
+		{
+			wout[k] = std::exp(tout[k] * a) * v[0];
+		}
+		w[0] = std::exp(t * a) * v[0];
+		return 1;
+	}
+
+	workspace.Resize(n, m);
+	int flag = Expv(Structure, n, m, t, const_cast<T*>(v), w, nout, const_cast<double*>(tout), wout, &tol, MatrixNorm, workspace, Operator);
+	if (flag != 0)
+	{
+		throw std::runtime_error("Expokit returned nonzero value");
+	}
+	return workspace.MatVecCount();
+}
+
+
+template<class T>
+void ExpvSolver<T>::Apply(double t, const T *v, T *w)
+{
+	LastMatVecCount = Propagate(t, v, w, Workspaces[0]);
+}
+
+
+template<class T>
+void ExpvSolver<T>::ApplyTimes(int count, const double *t, const T *v, T *w)
+{
+	if (count < 1)
+	{
+		LastMatVecCount = 0;
+		return;
+	}
+
+	//The last time is the end of the propagation, the others are output
+	//times within it
+	int n = Operator->Size();
+	LastMatVecCount = Propagate(t[count-1], v, w + (size_t)(count-1) * n, Workspaces[0], count-1, t, w);
+}
+
+
+template<class T>
+void ExpvSolver<T>::ApplyBlock(double t, int count, const T *v, T *w)
+{
+	int n = Operator->Size();
+	int threads = 1;
+#ifdef _OPENMP
+	threads = std::max(1, std::min(count, omp_get_max_threads()));
+#endif
+	if (Workspaces.size() < (size_t)threads)
+	{
+		Workspaces.resize(threads);
+	}
+
+	int matVecCount = 0;
+	bool failed = false;
+
+	//Exceptions must not leave the parallel region
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(threads) reduction(+:matVecCount) if (threads > 1)
+	for (int k = 0; k < count; k++)
+	{
+		int thread = 0;
+#ifdef _OPENMP
+		thread = omp_get_thread_num();
+#endif
+		try
+		{
+			matVecCount += Propagate(t, v + (size_t)k * n, w + (size_t)k * n, Workspaces[thread]);
+		}
+		catch (const std::exception &)
+		{
+			#pragma omp critical (expokit_solver_failed)
+			failed = true;
+		}
+	}
+
+	LastMatVecCount = matVecCount;
+	if (failed)
+	{
+		throw std::runtime_error("Expokit returned nonzero value");
+	}
+}
+
+
+template class KrylovWorkspace<double>;
+template class KrylovWorkspace<cplx>;
+template class ExpvSolver<double>;
+template class ExpvSolver<cplx>;
+
+} //Namespace
@@ -0,0 +1,79 @@
+#ifndef EXPOKITSOLVER_H
+#define EXPOKITSOLVER_H
+
+#include <vector>
+
+#include "expokitoperator.h"
+
+namespace expokit
+{
+
+/*
+ * Workspace of the Krylov routines (wsp/iwsp). It only grows, so one
+ * workspace serves all the time steps of a propagation without being
+ * reallocated. After a call, the accounts of the computation are found
+ * at the start of the workspace (see dgexpv).
+ */
+template<class T>
+class KrylovWorkspace
+{
+public:
+	std::vector<T> Wsp;
+	std::vector<int> Iwsp;
+
+	void Resize(int n, int m);
+
+	int MatVecCount() const { return Iwsp.empty() ? 0 : Iwsp[0]; }
+	int StepCount() const { return Iwsp.empty() ? 0 : Iwsp[3]; }
+};
+
+
+enum MatrixStructure
+{
+	General,	//dgexpv, zgexpv
+	Symmetric	//dsexpv, zhexpv (Hermitian if complex)
+};
+
+
+/*
+ * Computes w = exp(t*A)*v with the Krylov routines of expokit for a
+ * fixed operator A, reusing the workspace from call to call.
+ *
+ * Apply handles one vector; the operator product may then use several
+ * threads. ApplyBlock handles many starting vectors in one call: the
+ * vectors are propagated concurrently, one thread (and one cached
+ * workspace) per vector, each one with a serial operator product.
+ */
+template<class T>
+class ExpvSolver
+{
+public:
+	int BasisSize;
+	double Tolerance;
+	double MatrixNorm;
+	MatrixStructure Structure;
+
+	ExpvSolver(const LinearOperator<T> &op, int basisSize = 30, double tolerance = 0.0, MatrixStructure structure = General);
+
+	void Apply(double t, const T *v, T *w);
+
+	//w + k*n = exp(t[k]*A)*v for the count times t, of one sign and sorted
+	//by increasing magnitude, in one propagation: the times falling inside
+	//a Krylov step are evaluated from the basis of that step
+	void ApplyTimes(int count, const double *t, const T *v, T *w);
+	void ApplyBlock(double t, int count, const T *v, T *w);
+
+	//Number of operator products in the last Apply/ApplyBlock
+	int MatVecCount() const { return LastMatVecCount; }
+
+private:
+	const LinearOperator<T> *Operator;
+	std::vector< KrylovWorkspace<T> > Workspaces;
+	int LastMatVecCount;
+
+	int Propagate(double t, const T *v, T *w, KrylovWorkspace<T> &workspace, int nout = 0, const double *tout = 0, T *wout = 0);
+};
+
+} // Namespace
+
+#endif
@@ -0,0 +1,141 @@
+//Test of PadeBatch against dgpadm_/zgpadm_ called one matrix at a time.
+//Not part of the library project, build it with the library sources, e.g.
+//  g++ -O2 -fopenmp testexpokitpadm.cpp expokitpadm.cpp dgpadm.cpp zgpadm.cpp
+//      -lf2c -llapack -lblas
+//Returns 0 when every batch agrees with the scalar routines.
+
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "expokitpadm.h"
+#include "expokit.h"
+
+//f2c.h macros
+#undef abs
+#undef min
+#undef max
+
+using namespace expokit;
+
+//Relative error allowed, with respect to the largest entry of exp(t*H),
+//before the squarings (each one may double the difference in rounding)
+const double Tolerance = 1.0e-14;
+
+//Matrices per batch, not a multiple of the SIMD width of the kernels
+const int Count = 37;
+
+
+static double Random()
+{
+	return 2.0 * rand() / RAND_MAX - 1.0;
+}
+
+static void Random(double &x)
+{
+	x = Random();
+}
+
+static void Random(cplx &x)
+{
+	x = cplx(Random(), Random());
+}
+
+//Returns the number of squarings
+static int Padm(int degree, int m, double t, double *h, double *wsp, int lwsp, int *ipiv, int *iexph)
+{
+	int ns, flag;
+	dgpadm_(&degree, &m, &t, h, &m, wsp, &lwsp, ipiv, iexph, &ns, &flag);
+	return ns;
+}
+
+static int Padm(int degree, int m, double t, cplx *h, cplx *wsp, int lwsp, int *ipiv, int *iexph)
+{
+	int ns, flag;
+	zgpadm_(&degree, &m, &t, h, &m, wsp, &lwsp, ipiv, iexph, &ns, &flag);
+	return ns;
+}
+
+
+//Largest error of PadeBatch on Count random matrices of order m, each
+//with the scaling scale times a random factor in [0.5, 1], relative to
+//the error allowed for its number of squarings
+template <class T>
+static double Compare(int m, int degree, double scale)
+{
+	int mm = m * m;
+	int lwsp = 4 * mm + degree + 1;
+	int iexph;
+	std::vector<double> t(Count);
+	std::vector<T> h(Count * mm), expH(Count * mm), wsp(lwsp);
+	std::vector<int> ipiv(m);
+	double err = 0.0;
+
+	for (int k = 0; k < Count; k++)
+	{
+		t[k] = scale * (0.75 + 0.25 * Random());
+		for (int i = 0; i < mm; i++)
+		{
+			Random(h[k * mm + i]);
+		}
+	}
+
+	PadeBatch(m, Count, &t[0], &h[0], &expH[0], degree);
+
+	for (int k = 0; k < Count; k++)
+	{
+		std::vector<T> hk(h.begin() + k * mm, h.begin() + (k + 1) * mm);
+		int ns = Padm(degree, m, t[k], &hk[0], &wsp[0], lwsp, &ipiv[0], &iexph);
+
+		const T *e = &wsp[iexph - 1];
+		double norm = 0.0, diff = 0.0;
+		for (int i = 0; i < mm; i++)
+		{
+			norm = std::max(norm, std::abs(e[i]));
+			diff = std::max(diff, std::abs(e[i] - expH[k * mm + i]));
+		}
+		err = std::max(err, diff / (norm * Tolerance * std::ldexp(1.0, ns)));
+	}
+	return err;
+}
+
+
+int main()
+{
+	const int degrees[] = { 2, 6, 9 };
+	const double scales[] = { 1.0e-3, 0.3, 2.0, -5.0, 40.0 };
+	int failed = 0;
+
+	srand(1);
+	for (int m = 1; m <= 12; m++)
+	{
+		for (int d = 0; d < 3; d++)
+		{
+			for (int s = 0; s < 5; s++)
+			{
+				double err = Compare<double>(m, degrees[d], scales[s]);
+				double errc = Compare<cplx>(m, degrees[d], scales[s]);
+				if (!(err <= 1.0 && errc <= 1.0))
+				{
+					printf("order %2d degree %d t ~ %-6g real %.2f complex %.2f of tolerance, FAILED\n", m, degrees[d], scales[s], err, errc);
+					failed++;
+				}
+			}
+		}
+	}
+
+	//A null t*H gives the identity
+	double t0 = 0.0, h0[4] = { 1.0, 2.0, 3.0, 4.0 }, e0[4];
+	PadeBatch(2, 1, &t0, h0, e0);
+	if (e0[0] != 1.0 || e0[1] != 0.0 || e0[2] != 0.0 || e0[3] != 1.0)
+	{
+		printf("null t*H FAILED\n");
+		failed++;
+	}
+
+	printf(failed ? "PadeBatch: %d FAILED\n" : "PadeBatch: OK\n", failed);
+	return failed ? 1 : 0;
+}
@@ -29,8 +29,9 @@ static integer c__5 = 5;
 static integer c__6 = 6;
 
 /* ----------------------------------------------------------------------| */
-/* Subroutine */ int zgexpv(integer *n, integer *m, doublereal *t, 
-	doublecomplex *v, doublecomplex *w, doublereal *tol, doublereal *
+/* Subroutine */ int zgexpvd(integer *n, integer *m, doublereal *t, 
+	doublecomplex *v, doublecomplex *w, integer *nout, 
+	doublereal *tout, doublecomplex *wout, doublereal *tol, doublereal *
 	anorm, doublecomplex *wsp, integer *lwsp, integer *iwsp, integer *
 	liwsp, S_fp matvec, void *matvecdata, integer *itrace, integer *iflag)
 {
@@ -52,49 +53,50 @@ static integer c__6 = 6;
     double z_abs(doublecomplex *);
 
     /* Local variables */
-    static integer ibrkflag;
-    static doublereal step_min__, step_max__;
-    static integer i__, j;
-    static doublereal break_tol__;
-    static integer k1;
-    static doublereal p1, p2, p3;
-    static integer ih, mh, iv, ns, mx;
-    static doublereal xm;
-    static integer j1v;
-    static doublecomplex hij;
-    static doublereal sgn, eps, hj1j, sqr1, beta, hump;
-    static integer ifree, lfree;
-    static doublereal t_old__;
-    static integer iexph;
-    static doublereal t_new__;
-    static integer nexph;
+    integer ibrkflag;
+    doublereal step_min__, step_max__;
+    integer i__, j;
+    doublereal break_tol__;
+    integer k1;
+    doublereal p1, p2, p3;
+    integer ih, mh, iv, ns, mx;
+    doublereal xm;
+    integer j1v;
+    doublecomplex hij;
+    doublereal sgn, eps, hj1j, sqr1, beta, hump;
+    integer ifree, lfree;
+    doublereal t_old__;
+    integer iexph;
+    doublereal t_new__;
+    integer nexph;
     extern /* Double Complex */ VOID zdotc_(doublecomplex *, integer *, 
 	    doublecomplex *, integer *, doublecomplex *, integer *);
-    static doublereal t_now__;
+    doublereal t_now__;
     extern /* Subroutine */ int zgemv_(char *, integer *, integer *, 
 	    doublecomplex *, doublecomplex *, integer *, doublecomplex *, 
 	    integer *, doublecomplex *, doublecomplex *, integer *, ftnlen);
-    static integer nstep;
-    static doublereal t_out__;
-    static integer nmult;
-    static doublereal vnorm;
+    integer nstep;
+    doublereal t_out__;
+    integer nmult;
+    doublereal vnorm;
     extern /* Subroutine */ int zcopy_(integer *, doublecomplex *, integer *, 
 	    doublecomplex *, integer *), zaxpy_(integer *, doublecomplex *, 
 	    doublecomplex *, integer *, doublecomplex *, integer *);
     extern doublereal dznrm2_(integer *, doublecomplex *, integer *);
-    static integer nscale;
-    static doublereal rndoff;
+    integer nscale;
+    doublereal rndoff;
     extern /* Subroutine */ int zdscal_(integer *, doublereal *, 
 	    doublecomplex *, integer *), zgpadm_(integer *, integer *, 
 	    doublereal *, doublecomplex *, integer *, doublecomplex *, 
 	    integer *, integer *, integer *, integer *, integer *), znchbv_(
 	    integer *, doublereal *, doublecomplex *, integer *, 
 	    doublecomplex *, doublecomplex *);
-    static doublereal t_step__, avnorm;
-    static integer ireject;
-    static doublereal err_loc__;
-    static integer nreject, mbrkdwn;
-    static doublereal tbrkdwn, s_error__, x_error__;
+    doublereal t_step__, avnorm;
+    integer ireject;
+    integer iout, wout_dim1, wout_offset;
+    doublereal err_loc__;
+    integer nreject, mbrkdwn;
+    doublereal tbrkdwn, s_error__, x_error__;
 
     /* Fortran I/O blocks */
     static cilist io___40 = { 0, 6, 0, 0, 0 };
@@ -139,6 +141,15 @@ static integer c__6 = 6;
 
 /*     w(n)   : (output) computed approximation of exp(t*A)*v. */
 
+/*     nout   : (input) number of output times (may be 0). */
+
+/*  tout(nout): (input) output times, of the sign of t, sorted by */
+/*              increasing magnitude, with |tout(nout)| .le. |t|. */
+
+/* wout(n,nout): (output) wout(:,i) approximates exp(tout(i)*A)*v. */
+/*              Output times inside a step are evaluated from the */
+/*              Krylov basis of the step, without new matvecs. */
+
 /*     tol    : (input/output) the requested accuracy tolerance on w. */
 /*              If on input tol=0.0d0 or tol is too small (tol.le.eps) */
 /*              the internal value sqrt(eps) is used, and tol is set to */
@@ -228,6 +239,10 @@ static integer c__6 = 6;
 
     /* Parameter adjustments */
     --w;
+    wout_dim1 = *n;
+    wout_offset = 1 + wout_dim1;
+    wout -= wout_offset;
+    --tout;
     --v;
     --wsp;
     --iwsp;
@@ -248,6 +263,14 @@ static integer c__6 = 6;
     if (*iflag != 0) {
 	s_stop("bad sizes (in input of ZGEXPV)", (ftnlen)30);
     }
+    i__1 = *nout;
+    for (iout = 1; iout <= i__1; ++iout) {
+	if (tout[iout] * *t < 0. || abs(tout[iout]) > abs(*t) || (iout > 1 && 
+		abs(tout[iout]) < abs(tout[iout - 1]))) {
+	    s_stop("bad output times (in input of ZGEXPV)", (ftnlen)37);
+	}
+    }
+    iout = 1;
 
 /* ---  initialisations ... */
 
@@ -312,6 +335,15 @@ L1:
 /* ---  step-by-step integration ... */
 
 L100:
+
+/* ---  output times reached: wout(:,iout) = w ... */
+
+    for (; iout <= *nout; ++iout) {
+	if (abs(tout[iout]) > t_now__) {
+	    break;
+	}
+	zcopy_(n, &w[1], &c__1, &wout[iout * wout_dim1 + 1], &c__1);
+    }
     if (t_now__ >= t_out__) {
 	goto L500;
     }
@@ -354,12 +386,14 @@ L100:
 	hj1j = dznrm2_(n, &wsp[j1v], &c__1);
 /* ---     if `happy breakdown' go straightforward at the end ... */
 	if (hj1j <= break_tol__) {
-	    s_wsle(&io___40);
-	    do_lio(&c__9, &c__1, "happy breakdown: mbrkdwn =", (ftnlen)26);
-	    do_lio(&c__3, &c__1, (char *)&j, (ftnlen)sizeof(integer));
-	    do_lio(&c__9, &c__1, " h =", (ftnlen)4);
-	    do_lio(&c__5, &c__1, (char *)&hj1j, (ftnlen)sizeof(doublereal));
-	    e_wsle();
+	    if (*itrace != 0) {
+		s_wsle(&io___40);
+		do_lio(&c__9, &c__1, "happy breakdown: mbrkdwn =", (ftnlen)26);
+		do_lio(&c__3, &c__1, (char *)&j, (ftnlen)sizeof(integer));
+		do_lio(&c__9, &c__1, " h =", (ftnlen)4);
+		do_lio(&c__5, &c__1, (char *)&hj1j, (ftnlen)sizeof(doublereal));
+		e_wsle();
+	    }
 	    k1 = 0;
 	    ibrkflag = 1;
 	    mbrkdwn = j;
@@ -497,6 +531,23 @@ L401:
     hij.r = q__1.r, hij.i = q__1.i;
     zgemv_("n", n, &mx, &hij, &wsp[iv], n, &wsp[iexph], &c__1, &c_b1, &w[1], &
 	    c__1, (ftnlen)1);
+
+/* ---  dense output: wout(:,iout) = beta*V*exp(s*H)*e1 for the output */
+/*      times inside the step, s = |tout(iout)|-t_now ... */
+
+    for (; iout <= *nout; ++iout) {
+	if (abs(tout[iout]) >= t_now__ + t_step__) {
+	    break;
+	}
+	i__1 = mbrkdwn + k1;
+	d__1 = sgn * (abs(tout[iout]) - t_now__);
+	zgpadm_(&c__6, &i__1, &d__1, &wsp[ih], &mh, &wsp[ifree], &lfree, &iwsp[
+		1], &iexph, &ns, iflag);
+	iexph = ifree + iexph - 1;
+	++nexph;
+	zgemv_("n", n, &mx, &hij, &wsp[iv], n, &wsp[iexph], &c__1, &c_b1, &wout[
+		iout * wout_dim1 + 1], &c__1, (ftnlen)1);
+    }
     beta = dznrm2_(n, &w[1], &c__1);
     hump = max(hump,beta);
 
@@ -578,6 +629,20 @@ L500:
     q__1.r = d__1, q__1.i = (float)0.;
     wsp[10].r = q__1.r, wsp[10].i = q__1.i;
     return 0;
+} /* zgexpvd_ */
+
+/* ----------------------------------------------------------------------| */
+/* Subroutine */ int zgexpv(integer *n, integer *m, doublereal *t, 
+	doublecomplex *v, doublecomplex *w, doublereal *tol, doublereal *
+	anorm, doublecomplex *wsp, integer *lwsp, integer *iwsp, integer *
+	liwsp, S_fp matvec, void *matvecdata, integer *itrace, integer *iflag)
+{
+    integer nout = 0;
+
+/* ---  ZGEXPV without output times ... */
+
+    return zgexpvd(n, m, t, v, w, &nout, t, w, tol, anorm, wsp, 
+	    lwsp, iwsp, liwsp, matvec, matvecdata, itrace, iflag);
 } /* zgexpv_ */
 
 #ifdef __cplusplus
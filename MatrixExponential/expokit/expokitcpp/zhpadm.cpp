@@ -40,20 +40,20 @@ static doublereal c_b22 = -1.;
     integer pow_ii(integer *, integer *);
 
     /* Local variables */
-    static integer i__, j, k;
-    static doublecomplex cp, cq;
-    static integer ip, mm, iq, ih2, iodd, iget, iput, icoef;
-    static doublecomplex scale;
-    static integer ifree, iused;
+    integer i__, j, k;
+    doublecomplex cp, cq;
+    integer ip, mm, iq, ih2, iodd, iget, iput, icoef;
+    doublecomplex scale;
+    integer ifree, iused;
     extern /* Subroutine */ int zgemm_(char *, char *, integer *, integer *, 
 	    integer *, doublecomplex *, doublecomplex *, integer *, 
 	    doublecomplex *, integer *, doublecomplex *, doublecomplex *, 
 	    integer *, ftnlen, ftnlen);
-    static doublereal hnorm;
+    doublereal hnorm;
     extern /* Subroutine */ int zhesv_(char *, integer *, integer *, 
 	    doublecomplex *, integer *, integer *, doublecomplex *, integer *,
 	     doublecomplex *, integer *, integer *, ftnlen);
-    static doublecomplex scale2;
+    doublecomplex scale2;
     extern /* Subroutine */ int zaxpy_(integer *, doublecomplex *, 
 	    doublecomplex *, integer *, doublecomplex *, integer *), zdscal_(
 	    integer *, doublereal *, doublecomplex *, integer *);